@@ -13,7 +13,11 @@ USEFILE=$(PROJECT_ROOT)/discreteEventSimulator.use
 #===== EXTRA_SRCVPATH - a space-separated list of directories to search for source files.
 EXTRA_SRCVPATH+= \
 	$(PROJECT_ROOT)/src  \
-	$(PROJECT_ROOT_brushstring)/src
+	$(PROJECT_ROOT_brushstring)/src  \
+	$(PROJECT_ROOT_parsePolicy)/src
+
+#===== EXCLUDE_OBJS - the policy parsers are linked without the defdp command.
+EXCLUDE_OBJS+=defdp.o
 
 #===== EXTRA_LIBVPATH - a space-separated list of directories to search for library files.
 EXTRA_LIBVPATH+= \
@@ -21,12 +25,13 @@ EXTRA_LIBVPATH+= \
 	$(PROJECT_ROOT_minicloud)/$(CPU)/$(patsubst o%,so%,$(notdir $(CURDIR)))
 
 #===== LIBS - a space-separated list of library items to be included in the link.
-LIBS+=^brushstring ^minicloud m
+LIBS+=^brushstring ^minicloud expat m
 
 #===== EXTRA_INCVPATH - a space-separated list of directories to search for include files.
 EXTRA_INCVPATH+= \
 	$(PROJECT_ROOT_brushstring)/inc  \
 	$(PROJECT_ROOT_minicloud)/inc  \
+	$(PROJECT_ROOT_parsePolicy)/inc  \
 	$(PROJECT_ROOT)/inc
 
 include $(MKFILES_ROOT)/qmacros.mk
@@ -0,0 +1,105 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+MiniCloud Project. List all data points in target system.
+
+==============================================================================*/
+
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+/*!
+ * @file histogram.h
+ * @brief High dynamic range histogram of the simulator latencies
+ *
+ * @defgroup histogram latency percentiles of the queue, service and
+ *           response times
+ * @brief high dynamic range histogram
+ *
+ *  A value is counted in a bucket of a log-linear scale: values below
+ *  2^(HISTOGRAM_SUB_BITS + 1) have a bucket each, above that every power
+ *  of two is split in 2^HISTOGRAM_SUB_BITS buckets.  A value is recorded in
+ *  constant time, and a percentile is within one part in
+ *  2^HISTOGRAM_SUB_BITS of the recorded value whatever its magnitude, from
+ *  a nanosecond to HISTOGRAM_MAX_VALUE.
+ *
+ */
+
+ /*! @{ */
+/*==============================================================================
+                              Includes
+==============================================================================*/
+#include <stdint.h>
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+/*! buckets of every power of two are 2^HISTOGRAM_SUB_BITS, 0.1% precision */
+#define HISTOGRAM_SUB_BITS     ( 10 )
+
+/*! largest value counted, larger ones are counted as this, about 73 minutes
+ *  in nanoseconds */
+#define HISTOGRAM_MAX_VALUE    ( ( UINT64_C(1) << 42 ) - 1 )
+
+/*! number of buckets up to HISTOGRAM_MAX_VALUE */
+#define HISTOGRAM_BUCKETS      ( ( 42 - HISTOGRAM_SUB_BITS + 1 ) << \
+                                 HISTOGRAM_SUB_BITS )
+
+/*==============================================================================
+                                Enums
+==============================================================================*/
+
+/*==============================================================================
+                            Type Definitions
+==============================================================================*/
+
+/*=============================================================================
+                              Structures
+==============================================================================*/
+
+/*! counts of the values recorded */
+typedef struct zHISTOGRAM
+{
+    /*! number of values of every bucket */
+    uint64_t counts[ HISTOGRAM_BUCKETS ];
+
+    /*! number of values recorded */
+    uint64_t total;
+
+    /*! smallest value recorded */
+    uint64_t min;
+
+    /*! largest value recorded */
+    uint64_t max;
+
+    /*! lowest bucket counted, the buckets outside low and high are 0 */
+    uint32_t low;
+
+    /*! highest bucket counted */
+    uint32_t high;
+
+} tzHISTOGRAM;
+
+/*==============================================================================
+                          External/Public Constants
+==============================================================================*/
+
+/*==============================================================================
+                          External/Public Variables
+==============================================================================*/
+
+/*==============================================================================
+                      External/Public Function Prototypes
+==============================================================================*/
+
+void HISTOGRAM_fnReset( tzHISTOGRAM *pHist );
+void HISTOGRAM_fnRecord( tzHISTOGRAM *pHist, uint64_t value );
+uint64_t HISTOGRAM_fnPercentile( const tzHISTOGRAM *pHist, double percentile );
+
+#endif /* HISTOGRAM_H_ */
+
+/*! @} */
+
+//EoF
@@ -33,8 +33,9 @@ MiniCloud Project. List all data points in target system.
 /*==============================================================================
                               Defines
 ==============================================================================*/
-/*! name of each object that is going in the queue */
-#define OBJ_NAME_SIZE       ( 512 )
+/*! name identifier of an Unmanned Aircraft System (UAS), see
+ *  QUEUE_fnObjName */
+#define OBJ_NAME_DRONE      ( 0 )
 
 /*! billion granularity */
 #define BILLION  1000000000L;
@@ -42,8 +43,11 @@ MiniCloud Project. List all data points in target system.
 /*! million granularity */
 #define MILLION  1000000L;
 
-/*! maximum number of objects */
-#define MAX_NUM_OF_OBJECTS ( 100000 )
+/*! objects allocated at once when the object pool is empty */
+#define QUEUE_POOL_SLAB    ( 256 )
+
+/*! most objects the server takes from the queue at once */
+#define QUEUE_DRAIN_MAX    ( 32 )
 
 /*==============================================================================
                                 Enums
@@ -68,30 +72,17 @@ typedef struct zDOUBLY_LIST
     struct zOBJECT* prev;
 } tzDOUBLY_LIST;
 
-/*! Elements needed for keeping an inventory track in the queue for
- * our autonomous objects */
-typedef struct zQUEUE
-{
-    /*! mutex for protecting access to the queue*/
-    pthread_mutex_t mutex;
-    /*! mutex attributes */
-    pthread_mutexattr_t mutexattr;
-    /*! object count */
-    uint16_t uiObjCount;
-    /*! first item in the queue
-     * property of the queue */
-    struct zOBJECT* pFirst;
-    /*! last item in the queue
-     * property of the queue */
-    struct zOBJECT* pLast;
-
-} tzQUEUE, *ptzQUEUE;
-
 /*! Register instance information */
 typedef struct zOBJECT
 {
-    /*! Pointer to register class definition */
-    char ObjName[OBJ_NAME_SIZE];
+    /*! OBJ_NAME_ identifier of the object name */
+    uint16_t nameId;
+
+    /*! number of objects of the batch the object arrived with */
+    uint32_t batchSize;
+
+    /* time the object was scheduled to arrive */
+    uint64_t tIntended;
 
     /* time object got in the queue*/
     uint64_t tStartQ;
@@ -132,6 +123,41 @@ typedef struct zOBJECT
 
 } tzOBJECT;
 
+/*! Elements needed for keeping an inventory track in the queue for
+ * our autonomous objects.
+ *
+ * The queue is a lock-free multi-producer queue of the objects linked by
+ * their queue.next: an arrival swaps itself in as pLast and links the
+ * object before it to itself, without a lock.  The servers remove from
+ * pFirst one at a time under the mutex, which they also sleep on when the
+ * queue is empty.  A producer takes the mutex only to wake a sleeping
+ * server. */
+typedef struct zQUEUE
+{
+    /*! mutex of the server removing objects, and of the sleeping servers */
+    pthread_mutex_t mutex;
+    /*! mutex attributes */
+    pthread_mutexattr_t mutexattr;
+    /*! signalled when an object is added to an empty queue with a sleeping
+     * server, or when the queue is closed */
+    pthread_cond_t cond;
+    /*! no more objects will be added, see QUEUE_fnClose */
+    bool closed;
+    /*! number of servers sleeping on cond */
+    uint32_t waiters;
+    /*! object count, incremented once the object is linked */
+    uint32_t uiObjCount;
+    /*! oldest item in the queue, or the stub
+     * property of the server removing objects */
+    struct zOBJECT* pFirst;
+    /*! last item in the queue, or the stub
+     * property of the producers */
+    struct zOBJECT* pLast;
+    /*! placeholder keeping the list non-empty, never handed out */
+    struct zOBJECT stub;
+
+} tzQUEUE, *ptzQUEUE;
+
 /*! discreate event simulator program parameters to be set before running the
  * algorithm code  */
 typedef struct zParams
@@ -177,12 +203,33 @@ typedef struct zParams
     /* file that keeps the record of each epoch cycle sums */
     FILE* fCycleSums;
 
+    /* file of the intended and actual time of every release */
+    FILE* fArrivals;
+
+    /* intended arrival time of the objects being added, in clock cycles */
+    uint64_t tIntended;
+
+    /* file of the latency percentiles of every window and of the run */
+    FILE* fPercentiles;
+
+    /* epochs of a window of the percentile tables, 0 for none */
+    int windowEpochs;
+
+    /* time the queue and response times from the intended arrival */
+    bool correctOmission;
+
+    /* release the objects of an epoch together at its start */
+    bool batchArrivals;
+
     /* show output stream datapoints and their values */
     bool showOutput;
 
     /* verbosity level */
     int verbose;
 
+    /* number of servers taking objects from the queue, M/M/c */
+    int numServers;
+
 } tzParams;
 
 
@@ -200,9 +247,19 @@ typedef struct zParams
 
 int  QUEUE_fnInitialize( void );
 int QUEUE_fnAdd( tzQUEUE *pQueue, int num, void* arg );
+int QUEUE_fnAddArrival( tzQUEUE *pQueue, int index, int num, void* arg );
 tzOBJECT* QUEUE_fnGetFirstObj( tzQUEUE *pQueue );
 tzOBJECT* QUEUE_fnGetNextObj( tzOBJECT *pObj );
 tzOBJECT* QUEUE_fnGetAndRemoveFirstObj( tzQUEUE *pQueue, void* arg );
+int QUEUE_fnWaitAndRemove( tzQUEUE *pQueue,
+                           tzOBJECT **ppObjects,
+                           int max );
+void QUEUE_fnLeave( tzOBJECT *pObj, void* arg );
+void QUEUE_fnClose( tzQUEUE *pQueue );
+tzOBJECT* QUEUE_fnAllocObj( void );
+void QUEUE_fnFreeObj( tzOBJECT *pObj );
+const char* QUEUE_fnObjName( const tzOBJECT *pObj );
+void QUEUE_fnTerminate( void );
 
 #endif /* OBJQUEUE_H_ */
 
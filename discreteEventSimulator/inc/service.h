@@ -28,6 +28,8 @@ MiniCloud Project. List all data points in target system.
 /*==============================================================================
                               Defines
 ==============================================================================*/
+/*! most server connections, see SERVICE_fnInit */
+#define SERVICE_MAX_CONNECTIONS  ( 64 )
 
 
 /*==============================================================================
@@ -58,10 +60,12 @@ typedef void (*outputFn)(DPRM_HANDLE hDPRM,
 /*==============================================================================
                       External/Public Function Prototypes
 ==============================================================================*/
-void SERVICE_fnProcess( DPRM_HANDLE hDPRM,
-		                char* key,
-		                teMatchType matchType,
-		                void* arg );
+int SERVICE_fnInit( DPRM_HANDLE hDPRM, void* arg );
+void SERVICE_fnShutdown( void );
+uint64_t SERVICE_fnProcess( DPRM_HANDLE hDPRM,
+		                    char* key,
+		                    teMatchType matchType,
+		                    void* arg );
 
 
 #endif /* SERVICE_H_ */
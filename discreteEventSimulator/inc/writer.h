@@ -0,0 +1,104 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+MiniCloud Project. List all data points in target system.
+
+==============================================================================*/
+
+#ifndef WRITER_H_
+#define WRITER_H_
+
+/*!
+ * @file writer.h
+ * @brief Asynchronous writer of the simulator result files
+ *
+ * @defgroup writer result files written off the measured threads
+ * @brief asynchronous CSV writer
+ *
+ *  The arrival and server threads hand their results to the writer as
+ *  binary records in a lock-free ring, which costs a copy of the record.
+ *  The writer thread formats the CSV lines and lets them accumulate in
+ *  large stdio buffers, flushed every WRITER_FLUSH_MS and when the writer
+ *  stops.
+ *
+ */
+
+ /*! @{ */
+/*==============================================================================
+                              Includes
+==============================================================================*/
+#include <stdio.h>
+#include <stdint.h>
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+/*! records of the ring, a power of two */
+#define WRITER_RING_SIZE     ( 4096 )
+
+/*! size of the stdio buffer of a result file */
+#define WRITER_BUFFER_SIZE   ( 64 * 1024 )
+
+/*! the writer sleeps this long when the ring is empty */
+#define WRITER_POLL_MS       ( 10 )
+
+/*! the result files are flushed at least this often */
+#define WRITER_FLUSH_MS      ( 1000 )
+
+/*! most result files */
+#define WRITER_MAX_FILES     ( 8 )
+
+/*==============================================================================
+                                Enums
+==============================================================================*/
+
+/*==============================================================================
+                            Type Definitions
+==============================================================================*/
+
+/*=============================================================================
+                              Structures
+==============================================================================*/
+
+/*==============================================================================
+                          External/Public Constants
+==============================================================================*/
+
+/*==============================================================================
+                          External/Public Variables
+==============================================================================*/
+
+/*==============================================================================
+                      External/Public Function Prototypes
+==============================================================================*/
+
+int WRITER_fnBuffer( FILE* fp );
+int WRITER_fnStart( void );
+void WRITER_fnStop( void );
+void WRITER_fnEpoch( FILE* fp, int epoch, int objects );
+void WRITER_fnCycleSum( FILE* fp, int cycle, float sum );
+void WRITER_fnSteadyState( FILE* fp,
+                           int epoch,
+                           float mean,
+                           float confidence );
+void WRITER_fnArrival( FILE* fp,
+                       int epoch,
+                       int objects,
+                       double intended,
+                       double actual,
+                       double lag );
+void WRITER_fnPercentile( FILE* fp,
+                          const char* window,
+                          int lastEpoch,
+                          const char* latency,
+                          uint64_t count,
+                          const double* pValues,
+                          int numValues );
+
+#endif /* WRITER_H_ */
+
+/*! @} */
+
+//EoF
@@ -55,6 +55,8 @@ MiniCloud Project. List all data points in target system.
 
 #include "service.h"
 #include "objqueue.h"
+#include "histogram.h"
+#include "writer.h"
 
 
 /*==============================================================================
@@ -72,15 +74,87 @@ MiniCloud Project. List all data points in target system.
 #define STEADY_STATE_PERFORMANCE "/ubc/Mehdi/SteadyStatePerformance.csv"
 /*! file to record the cycle sums */
 #define CYCLE_SUMS_FILE "/ubc/Mehdi/CycleSums.csv"
+/*! file to record the intended and actual arrival times */
+#define ARRIVALS_FILE "/ubc/Mehdi/Arrivals.csv"
+
+/*! nanoseconds in a second */
+#define NANOSECONDS ( 1000000000L )
+/*! microseconds in a second */
+#define MICROSECONDS ( 1000000.0 )
+/*! nanoseconds in a millisecond */
+#define NANOSECONDS_PER_MS ( 1000000.0 )
 /*! file to record Queueing times */
 #define QUEUE_TIME_FILE "/ubc/Mehdi/QueueTime.csv"
 /*! file to record Service times (policy + ) */
 #define SERVICE_TIME_FILE "/ubc/Mehdi/ServiceTime.csv"
+/*! file to record the latency percentiles */
+#define PERCENTILES_FILE "/ubc/Mehdi/Percentiles.csv"
+
+/*! epochs of a window of the percentile tables */
+#define PERCENTILE_WINDOW ( 100 )
+
+/*! longest spin of the arrival thread before an arrival, the spin is at
+ *  most the resolution of the clock */
+#define ARRIVAL_SPIN_NS ( 20000L )
+
+/*==============================================================================
+                                Enums
+ =============================================================================*/
+
+/*! latencies with a histogram */
+typedef enum eLatency
+{
+    /*! time in the queue */
+    eLatencyQueue = 0,
+
+    /*! time in the server */
+    eLatencyService,
+
+    /*! time in the system, with the network latency */
+    eLatencyResponse,
+
+    /*! number of latencies */
+    eLatencyMax
+
+} teLatency;
 
 /*==============================================================================
                                 Structs
  =============================================================================*/
 
+/*! server of the M/M/c queue, takes objects from the shared queue */
+typedef struct zServer
+{
+    /*! connection of the server to the data point resource manager */
+    DPRM_HANDLE hDPRM;
+
+    /*! thread of the server */
+    pthread_t thread;
+
+    /*! search key of the queries */
+    char* key;
+
+    /*! match type of the search key */
+    teMatchType matchType;
+
+    /*! program parameters */
+    tzParams* params;
+
+    /*! number of objects served */
+    uint64_t numServed;
+
+    /*! clock cycles spent serving objects */
+    uint64_t busyCycles;
+
+    /*! seconds the served objects spent in the queue */
+    double sumQueue;
+
+    /*! seconds the served objects spent in the system, without the
+     *  network latency */
+    double sumResponse;
+
+} tzServer;
+
 /*==============================================================================
                          Local Module Variables
  =============================================================================*/
@@ -96,21 +170,15 @@ tzQUEUE* pQueue;
 /*! switch to test the normal distribution density */
 static bool testDistribition = false;
 
-/*! external object counter to keep the simulation running */
-extern int objCounter;
-
-/*! an epoch cycle sum */
-float y[ MAX_NUM_OF_OBJECTS ];
+/*! cycle sum of the epoch being served */
+float y;
 
 /*! difference between expected and observed cycle sums */
-float w[ MAX_NUM_OF_OBJECTS ];
+float w;
 
 /*! variance of the difference */
 float Var_w;
 
-/*! number of drones that have arrived every time */
-int numberArrived[ MAX_NUM_OF_OBJECTS ];
-
 /*! live calculation of the overall mean employing Regeneration Method */
 float overalMean;
 
@@ -132,6 +200,32 @@ int sumOfNumbers;
 /*! index of the cycle to calculate the sum */
 static int cycleIdx = 0;
 
+/*! servers of the queue */
+static tzServer servers[ SERVICE_MAX_CONNECTIONS ];
+
+/*! protects the cycle sums and the steady state statistics */
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*! latencies of the current window of epochs, in nanoseconds */
+static tzHISTOGRAM windowHist[ eLatencyMax ];
+
+/*! latencies of the whole run, in nanoseconds */
+static tzHISTOGRAM runHist[ eLatencyMax ];
+
+/*! lateness of the arrivals on their schedule, in nanoseconds */
+static tzHISTOGRAM lagHist;
+
+/*! names of the latencies */
+static const char* latencyNames[ eLatencyMax ] =
+{
+    "queue",
+    "service",
+    "response"
+};
+
+/*! percentiles of the tables */
+static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+
 /*==============================================================================
                       Local/Private Function Prototypes
  =============================================================================*/
@@ -146,6 +240,26 @@ static void discreteEventSimulator_fnOutputVarValue( DPRM_HANDLE hDPRM,
 
 static void* discreteEventSimulator_fnArrival( void* arg );
 
+static void discreteEventSimulator_fnSleepUntil( const struct timespec* pStart,
+                                                 uint64_t offset,
+                                                 long spinNs );
+
+static void* discreteEventSimulator_fnServer( void* arg );
+
+static void discreteEventSimulator_fnReport( tzParams* params,
+                                             double elapsed );
+
+static double discreteEventSimulator_fnErlangC( int c, double load );
+
+static void discreteEventSimulator_fnRecordLatency( tzParams* params,
+                                                    tzOBJECT* pServiceObject,
+                                                    float NL );
+
+static void discreteEventSimulator_fnPercentiles( tzParams* params,
+                                                  const char* window,
+                                                  tzHISTOGRAM* pHists,
+                                                  bool print );
+
 static void discreteEventSimulator_fnCalcRT( tzParams* arg,
         tzOBJECT* pServiceObject,
         float NL );
@@ -177,6 +291,11 @@ static void discreteEventSimulator_fnCalcRT( tzParams* arg,
               [-l <lambda is the mean arrival rate>]
               [-E <Number of Epochs>]
               [-o <show output data streams>]
+              [-c <number of servers taking objects from the queue, M/M/c>]
+              [-w <epochs of a window of the percentile tables>]
+              [-C <correct coordinated omission, time from the intended
+                  arrival>]
+              [-B <release the objects of an epoch together at its start>]
               Sensitivity options:
               [-p <path to save the SteadyStatePerformance file>]
               [-f <sensitivity analysis: fix lambda factor (arrival rate)
@@ -224,15 +343,16 @@ int main(int argc, char *argv[])
     tzParams params;
     DPRM_HANDLE hDPRM;
     int shmem_fd = -1;
-    tzOBJECT* pServiceObject = (tzOBJECT*)NULL;
+    uint64_t tStart;
+    int i;
 
     /* thread scheduler attributes */
     pthread_attr_t schedAttr;
+    pthread_t arrivalThread;
 
     memset( &params, 0, sizeof(struct zParams) );
-    memset( y, 0, sizeof(y) );
-    memset( w, 0, sizeof(w) );
-    memset( numberArrived, 0, sizeof(numberArrived) );
+    y = 0.0;
+    w = 0.0;
     overalMean = 0.0;
     sumOfCycleSums = 0.0;
     sumOfNumbers = 0;
@@ -240,19 +360,20 @@ int main(int argc, char *argv[])
     sumOf_w = 0;
     meanCycleLength = 0;
     confidenceInterval = 0.0;
-
-    /* Network Latency */
-    float NL = NETWORK_LATENCY;
+    params.numServers = 1;
+    params.windowEpochs = PERCENTILE_WINDOW;
 
     /* create file handlers */
     char* normalDistFile  = NORMAL_DIST_FILE;
     char* steadyStateFile = STEADY_STATE_PERFORMANCE;
     char* cycleSumsFile   = CYCLE_SUMS_FILE;
+    char* arrivalsFile    = ARRIVALS_FILE;
+    char* percentilesFile = PERCENTILES_FILE;
 //    const char* queueTimeFile   = QUEUE_TIME_FILE;
 //    const char* serviceTimeFile = SERVICE_TIME_FILE;
 
     /* process the command line options */
-    while ((opt = getopt(argc, argv, "vs:m:l:E:of:p:n:q:")) != -1)
+    while ((opt = getopt(argc, argv, "vs:m:l:E:of:p:n:q:c:w:CB")) != -1)
     {
         switch (opt)
         {
@@ -304,6 +425,26 @@ int main(int argc, char *argv[])
             params.showOutput = true;
             break;
 
+        case 'c':
+            /* number of servers */
+            params.numServers = atoi(optarg);
+            break;
+
+        case 'w':
+            /* epochs of a percentile window, 0 for the whole run only */
+            params.windowEpochs = atoi(optarg);
+            break;
+
+        case 'C':
+            /* coordinated omission correction */
+            params.correctOmission = true;
+            break;
+
+        case 'B':
+            /* batch arrivals, an epoch released at once */
+            params.batchArrivals = true;
+            break;
+
         case '?':
             ++errflag;
             break;
@@ -313,6 +454,13 @@ int main(int argc, char *argv[])
         }
     }
 
+    if( ( params.numServers < 1 ) ||
+        ( params.numServers > SERVICE_MAX_CONNECTIONS ) )
+    {
+        fprintf(stderr, "-c takes 1 to %d servers\n", SERVICE_MAX_CONNECTIONS );
+        ++errflag;
+    }
+
     if( errflag )
     {
         return EXIT_FAILURE;
@@ -330,16 +478,31 @@ int main(int argc, char *argv[])
     {
         return EXIT_FAILURE;
     }
+    WRITER_fnBuffer( params.fNormalDist );
     params.fSteadyState = fopen( steadyStateFile, "w" );
     if( !params.fSteadyState )
     {
         return EXIT_FAILURE;
     }
+    WRITER_fnBuffer( params.fSteadyState );
     params.fCycleSums   = fopen( cycleSumsFile, "w" );
     if( !params.fCycleSums )
     {
         return EXIT_FAILURE;
     }
+    WRITER_fnBuffer( params.fCycleSums );
+    params.fArrivals    = fopen( arrivalsFile, "w" );
+    if( !params.fArrivals )
+    {
+        return EXIT_FAILURE;
+    }
+    WRITER_fnBuffer( params.fArrivals );
+    params.fPercentiles = fopen( percentilesFile, "w" );
+    if( !params.fPercentiles )
+    {
+        return EXIT_FAILURE;
+    }
+    WRITER_fnBuffer( params.fPercentiles );
 //    FILE* fQueueTime   = fopen( queueTimeFile, "w" );
 //    if( !fQueueTime )
 //    {
@@ -353,12 +516,32 @@ int main(int argc, char *argv[])
     fprintf( params.fNormalDist,  "Epoch,Object\n");
     fprintf( params.fSteadyState, "Epoch,Overall mean,confidence interval\n");
     fprintf( params.fCycleSums, "cycle sums(ms)\n");
+    fprintf( params.fArrivals, "Epoch,Objects,Intended(us),Actual(us),Lag(us)\n");
+    fprintf( params.fPercentiles,
+             "Window,Last epoch,Latency,Count,Min(ms),p50(ms),p90(ms),"
+             "p99(ms),p99.9(ms),p99.99(ms),Max(ms)\n");
     fflush( params.fNormalDist );
     fflush( params.fSteadyState );
     fflush( params.fCycleSums );
+    fflush( params.fArrivals );
+    fflush( params.fPercentiles );
 
-    /* find out how many cycles per second */
-    params.cps = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+    /* the results of the measuring threads are written by the result
+     * writer, the verbose output is written in large blocks too */
+    if( params.verbose )
+    {
+        WRITER_fnBuffer( stdout );
+    }
+    if( EOK != WRITER_fnStart( ) )
+    {
+        fprintf(stderr, "Unable to start the result writer\n");
+        return EXIT_FAILURE;
+    }
+    for( i = 0; i < eLatencyMax; i++ )
+    {
+        HISTOGRAM_fnReset( &windowHist[ i ] );
+        HISTOGRAM_fnReset( &runHist[ i ] );
+    }
 
     /* virtual function pointer can be used later to add more functions
      * based on the input keys */
@@ -372,6 +555,33 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    /* find out how many cycles per second, the local resource manager
+     * sets up its system page when it is opened */
+    params.cps = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+
+    /* parse the policy files once, the service time then measures the
+     * policy registration without a defdp process per service */
+    if( EOK != SERVICE_fnInit( hDPRM, &params ) )
+    {
+        fprintf(stderr, "Unable to open the policy loader\n");
+        DP_fnClose(hDPRM);
+        return EXIT_FAILURE;
+    }
+
+    /* every server has its own connection, the first one shares the
+     * connection of the program */
+    servers[ 0 ].hDPRM = hDPRM;
+    for( i = 1; i < params.numServers; i++ )
+    {
+        servers[ i ].hDPRM = DP_fnOpen();
+        if( ( NULL == servers[ i ].hDPRM ) ||
+            ( EOK != SERVICE_fnInit( servers[ i ].hDPRM, &params ) ) )
+        {
+            fprintf(stderr, "Unable to open the connection of server %d\n", i );
+            return EXIT_FAILURE;
+        }
+    }
+
     /* create a shared memory object so we can print the query result */
     pSharedMemBuffer = DP_fnCreateMem( hDPRM, 16384L, &shmem_fd );
 
@@ -384,7 +594,11 @@ int main(int argc, char *argv[])
     {
         printf("Initialising the Queue...");
     }
-    QUEUE_fnInitialize( );
+    if( EOK != QUEUE_fnInitialize( ) )
+    {
+        fprintf(stderr, "Unable to initialise the queue\n");
+        return EXIT_FAILURE;
+    }
     if(params.verbose)
     {
         printf("Queue Initialised.\n");
@@ -392,69 +606,69 @@ int main(int argc, char *argv[])
 
 
     /* Create a thread for generating arrival rate */
+    tStart = ClockCycles( );
     pthread_attr_init( &schedAttr );
     pthread_attr_setdetachstate( &schedAttr, PTHREAD_CREATE_DETACHED );
-    pthread_create( NULL,
+    pthread_create( &arrivalThread,
                     &schedAttr,
                     &discreteEventSimulator_fnArrival,
                     &params );
 
-
-    while( objCounter <= MAX_NUM_OF_OBJECTS )
+    /* 4- the servers sleep until objects arrive and service them in arrival
+     *    order, the arrival thread closes the queue after the last epoch */
+    for( i = 0; i < params.numServers; i++ )
     {
-        if( !testDistribition )
-        {
-            /* 4- get the item from the queue and service the request */
-            while( (struct zOBJECT*)NULL != pQueue->pFirst )
-            {
-                pServiceObject =
-                        QUEUE_fnGetAndRemoveFirstObj( pQueue, &params );
-
-                if( NULL == pServiceObject)
-                {
-                    break;
-                }
-
-                /* ----- snap time in the server ----- */
-                pServiceObject->tStartService = ClockCycles( );
-
-
-                /* == service request one by one: Policy + Query  == */
-
-                SERVICE_fnProcess( hDPRM, key, matchType, &params );
+        servers[ i ].key = key;
+        servers[ i ].matchType = matchType;
+        servers[ i ].params = &params;
+        pthread_create( &servers[ i ].thread,
+                        NULL,
+                        &discreteEventSimulator_fnServer,
+                        &servers[ i ] );
+    }
 
-                /* ================================================= */
+    for( i = 0; i < params.numServers; i++ )
+    {
+        pthread_join( servers[ i ].thread, NULL );
+    }
 
-                /* --- snap the time again --- */
-                pServiceObject->tEndService = ClockCycles( );
-                pServiceObject->deltaService =
-                        pServiceObject->tEndService -
-                        pServiceObject->tStartService;
+    /* utilization and delays of the servers against the M/M/c model */
+    discreteEventSimulator_fnReport( &params,
+                                     (double)( ClockCycles( ) - tStart ) /
+                                     params.cps );
 
-                pServiceObject->secondsService =(double)
-                        pServiceObject->deltaService/params.cps;
+    /* percentiles of the last, partial, window and of the whole run */
+    if( 0 != windowHist[ eLatencyResponse ].total )
+    {
+        discreteEventSimulator_fnPercentiles( &params,
+                                              NULL,
+                                              windowHist,
+                                              false );
+    }
+    discreteEventSimulator_fnPercentiles( &params, "all", runHist, true );
 
+    /* write the results left and flush the files */
+    WRITER_fnStop( );
 
-                /* log the response time for the corresponding object */
-                discreteEventSimulator_fnCalcRT( &params,
-                                                 pServiceObject,
-                                                 NL );
-            }
-        }
+    /* release the queue and its objects */
+    QUEUE_fnTerminate( );
 
-        /* exit simulation if exceeded requested number of simulation */
-        if( params.currEpoch > params.Epoch )
-        {
-            break;
-        }
-    }
+    /* release the parsed policy files */
+    SERVICE_fnShutdown( );
 
     /* close the data point manager */
+    for( i = 1; i < params.numServers; i++ )
+    {
+        DP_fnClose( servers[ i ].hDPRM );
+    }
     DP_fnClose(hDPRM);
 
     /* closing all files */
     fclose( params.fNormalDist );
     fclose( params.fSteadyState );
+    fclose( params.fCycleSums );
+    fclose( params.fArrivals );
+    fclose( params.fPercentiles );
 //    fclose( fQueueTime );
 //    fclose( fServiceTime );
 
@@ -463,6 +677,410 @@ int main(int argc, char *argv[])
 }
 
 
+/*============================================================================*/
+/*!
+    this is the thread of a server taking objects from the queue
+
+    A single server drains the queue in batches.  With several servers each
+    takes one object at a time, so an idle server starts on the next object
+    while the others are busy, as in an M/M/c queue.  The servers query the
+    rule set together, the service of an object starts when its server has
+    the rule set, the time waiting for a policy swap counts in the queue
+    time.
+
+@param[in]
+    arg
+        the server
+
+@retval - NULL
+
+*/
+/*============================================================================*/
+static void* discreteEventSimulator_fnServer( void* arg )
+{
+    tzServer* pServer = (tzServer*)arg;
+    tzParams* params = pServer->params;
+    tzOBJECT* pServiceObject = (tzOBJECT*)NULL;
+    tzOBJECT* pBatch[ QUEUE_DRAIN_MAX ];
+    int max = ( 1 == params->numServers ) ? QUEUE_DRAIN_MAX : 1;
+    int numObjects = 0;
+    int i;
+
+    while( 0 < ( numObjects = QUEUE_fnWaitAndRemove( pQueue,
+                                                      pBatch,
+                                                      max ) ) )
+    {
+        for( i = 0; i < numObjects; i++ )
+        {
+            pServiceObject = pBatch[ i ];
+
+            /* the object waited in the queue until its service starts */
+            QUEUE_fnLeave( pServiceObject, params );
+
+
+            /* == service request one by one: Policy + Query  == */
+
+            /* ----- snap time in the server, rule set taken ----- */
+            pServiceObject->tStartService =
+                    SERVICE_fnProcess( pServer->hDPRM,
+                                       pServer->key,
+                                       pServer->matchType,
+                                       params );
+
+            /* ================================================= */
+
+            /* the object waited for the rule set in the queue too */
+            pServiceObject->tEndQ = pServiceObject->tStartService;
+            pServiceObject->deltaInQueue =
+                    pServiceObject->tEndQ - pServiceObject->tStartQ;
+            pServiceObject->secondsQueue =(double)
+                    pServiceObject->deltaInQueue/params->cps;
+
+            /* --- snap the time again --- */
+            pServiceObject->tEndService = ClockCycles( );
+            pServiceObject->deltaService =
+                    pServiceObject->tEndService -
+                    pServiceObject->tStartService;
+
+            pServiceObject->secondsService =(double)
+                    pServiceObject->deltaService/params->cps;
+
+            pServer->numServed++;
+            pServer->busyCycles += pServiceObject->deltaService;
+            pServer->sumQueue += pServiceObject->secondsQueue;
+            pServer->sumResponse += pServiceObject->secondsQueue +
+                                    pServiceObject->secondsService;
+
+            /* log the response time for the corresponding object */
+            pthread_mutex_lock( &statsLock );
+            discreteEventSimulator_fnCalcRT( params,
+                                             pServiceObject,
+                                             NETWORK_LATENCY );
+            pthread_mutex_unlock( &statsLock );
+
+            /* the object leaves the system, back to the object pool */
+            QUEUE_fnFreeObj( pServiceObject );
+        }
+    }
+
+    return( NULL );
+}
+
+/*============================================================================*/
+/*!
+    Report the servers and the M/M/c prediction
+
+    The utilization, mean queueing delay and mean response time of every
+    server and of all of them are printed next to the values of an M/M/c
+    queue with the measured arrival and service rates:
+
+        a = lambda / mu,  rho = a / c
+        P(wait) = C(c, a), the Erlang C formula
+        Wq = P(wait) / ( c mu - lambda ),  W = Wq + 1 / mu
+
+    The arrivals are spread over their epochs, or come in batches with -B,
+    the prediction is the Poisson arrival reference.  The response times are without the
+    network latency.
+
+@param[in]
+    params
+        program parameters
+
+@param[in]
+    elapsed
+        seconds from the first arrival to the end of the last service
+
+*/
+/*============================================================================*/
+static void discreteEventSimulator_fnReport( tzParams* params,
+                                             double elapsed )
+{
+    tzServer* pServer;
+    uint64_t numServed = 0;
+    uint64_t busyCycles = 0;
+    double sumQueue = 0.0;
+    double sumResponse = 0.0;
+    double lambda;
+    double mu;
+    double load;
+    double pWait;
+    double Wq;
+    int c = params->numServers;
+    int i;
+
+    if( elapsed <= 0.0 )
+    {
+        return;
+    }
+
+    fprintf(stdout,
+            "\nM/M/%d queue over %.2f s\n"
+            "%8s %10s %12s %14s %14s\n",
+            c,
+            elapsed,
+            "server",
+            "objects",
+            "utilization",
+            "queue(ms)",
+            "response(ms)");
+
+    for( i = 0; i < c; i++ )
+    {
+        pServer = &servers[ i ];
+        numServed += pServer->numServed;
+        busyCycles += pServer->busyCycles;
+        sumQueue += pServer->sumQueue;
+        sumResponse += pServer->sumResponse;
+
+        fprintf(stdout,
+                "%8d %10" PRIu64 " %12.3f %14.3f %14.3f\n",
+                i,
+                pServer->numServed,
+                (double)pServer->busyCycles / params->cps / elapsed,
+                ( 0 == pServer->numServed ) ? 0.0 :
+                    pServer->sumQueue * 1000 / pServer->numServed,
+                ( 0 == pServer->numServed ) ? 0.0 :
+                    pServer->sumResponse * 1000 / pServer->numServed );
+    }
+
+    if( ( 0 == numServed ) || ( 0 == busyCycles ) )
+    {
+        return;
+    }
+
+    fprintf(stdout,
+            "%8s %10" PRIu64 " %12.3f %14.3f %14.3f\n",
+            "all",
+            numServed,
+            (double)busyCycles / params->cps / elapsed / c,
+            sumQueue * 1000 / numServed,
+            sumResponse * 1000 / numServed );
+
+    /* measured arrival and service rates */
+    lambda = (double)numServed / elapsed;
+    mu = (double)numServed / ( (double)busyCycles / params->cps );
+    load = lambda / mu;
+
+    fprintf(stdout,
+            "%8s lambda %.2f/s mu %.2f/s rho %.3f",
+            "M/M/c",
+            lambda,
+            mu,
+            load / c );
+
+    if( load >= c )
+    {
+        fprintf(stdout, " unstable, the queue grows without bound\n");
+    }
+    else
+    {
+        pWait = discreteEventSimulator_fnErlangC( c, load );
+        Wq = pWait / ( c * mu - lambda );
+        fprintf(stdout,
+                " P(wait) %.4f\n"
+                "%8s %10s %12.3f %14.3f %14.3f\n",
+                pWait,
+                "predict",
+                "",
+                load / c,
+                Wq * 1000,
+                ( Wq + 1 / mu ) * 1000 );
+    }
+
+    fflush(stdout);
+}
+
+/*============================================================================*/
+/*!
+    Probability that an object waits in an M/M/c queue, Erlang C
+
+    Computed from the Erlang B recursion B(k) = a B(k-1) / ( k + a B(k-1) ),
+    B(0) = 1, which does not overflow for large c:
+
+        C(c, a) = B(c) / ( 1 - a / c ( 1 - B(c) ) )
+
+@param[in]
+    c
+        number of servers
+
+@param[in]
+    load
+        offered load a = lambda / mu, less than c
+
+@retval - the probability of waiting
+
+*/
+/*============================================================================*/
+static double discreteEventSimulator_fnErlangC( int c, double load )
+{
+    double B = 1.0;
+    int k;
+
+    for( k = 1; k <= c; k++ )
+    {
+        B = load * B / ( k + load * B );
+    }
+
+    return B / ( 1.0 - load / c * ( 1.0 - B ) );
+}
+
+/*============================================================================*/
+/*!
+    Record the latencies of an object in the histograms
+
+    The queue and response times start at the actual arrival of the object.
+    With the coordinated omission correction they start at its intended
+    arrival, so an arrival released late because the generator was held
+    up counts the delay it would have seen on time.
+
+@param[in]
+    params
+        program parameters
+
+@param[in]
+    pServiceObject
+        the object served
+
+@param[in]
+    NL
+        Network Latency in seconds
+
+*/
+/*============================================================================*/
+static void discreteEventSimulator_fnRecordLatency( tzParams* params,
+                                                    tzOBJECT* pServiceObject,
+                                                    float NL )
+{
+    uint64_t tArrival = pServiceObject->tStartQ;
+    double toNano = (double)NANOSECONDS / params->cps;
+    uint64_t queueNs;
+    uint64_t serviceNs;
+    uint64_t responseNs;
+    int i;
+
+    if( ( params->correctOmission ) &&
+        ( 0 != pServiceObject->tIntended ) &&
+        ( pServiceObject->tIntended < tArrival ) )
+    {
+        tArrival = pServiceObject->tIntended;
+    }
+
+    queueNs = (uint64_t)( (double)( pServiceObject->tEndQ - tArrival ) *
+                          toNano );
+    serviceNs = (uint64_t)( (double)pServiceObject->deltaService * toNano );
+    responseNs = queueNs + serviceNs + (uint64_t)( NL * NANOSECONDS );
+
+    for( i = 0; i < 2; i++ )
+    {
+        tzHISTOGRAM* pHists = ( 0 == i ) ? windowHist : runHist;
+
+        HISTOGRAM_fnRecord( &pHists[ eLatencyQueue ], queueNs );
+        HISTOGRAM_fnRecord( &pHists[ eLatencyService ], serviceNs );
+        HISTOGRAM_fnRecord( &pHists[ eLatencyResponse ], responseNs );
+    }
+}
+
+/*============================================================================*/
+/*!
+    Write the percentile table of the latencies
+
+    One row per latency goes to the percentiles file through the result
+    writer.  The histograms of a window are emptied for the next window.
+
+@param[in]
+    params
+        program parameters
+
+@param[in]
+    window
+        label of the rows, NULL for the number of the window
+
+@param[in]
+    pHists
+        the histograms, windowHist or runHist
+
+@param[in]
+    print
+        also print the table
+
+*/
+/*============================================================================*/
+static void discreteEventSimulator_fnPercentiles( tzParams* params,
+                                                  const char* window,
+                                                  tzHISTOGRAM* pHists,
+                                                  bool print )
+{
+    static int windowIdx = 0;
+    const size_t numPercentiles = sizeof( percentiles ) /
+                                  sizeof( percentiles[0] );
+    double values[ sizeof( percentiles ) / sizeof( percentiles[0] ) + 2 ];
+    char label[ 16 ];
+    tzHISTOGRAM* pHist;
+    size_t k;
+    int i;
+
+    if( NULL == window )
+    {
+        snprintf( label, sizeof( label ), "%d", ++windowIdx );
+        window = label;
+    }
+
+    if( print )
+    {
+        fprintf(stdout,
+                "\nlatency percentiles (ms)%s\n"
+                "%10s %10s %10s %10s %10s %10s %10s %10s\n",
+                params->correctOmission ?
+                    ", from the intended arrival" : "",
+                "latency", "count", "p50", "p90", "p99", "p99.9", "p99.99",
+                "max");
+    }
+
+    for( i = 0; i < eLatencyMax; i++ )
+    {
+        pHist = &pHists[ i ];
+
+        /* minimum, percentiles and maximum in ms */
+        values[ 0 ] = ( 0 == pHist->total ) ? 0.0 :
+                      (double)pHist->min / NANOSECONDS_PER_MS;
+        for( k = 0; k < numPercentiles; k++ )
+        {
+            values[ k + 1 ] =
+                    (double)HISTOGRAM_fnPercentile( pHist, percentiles[k] ) /
+                    NANOSECONDS_PER_MS;
+        }
+        values[ numPercentiles + 1 ] = (double)pHist->max / NANOSECONDS_PER_MS;
+
+        WRITER_fnPercentile( params->fPercentiles,
+                             window,
+                             cycleIdx,
+                             latencyNames[ i ],
+                             pHist->total,
+                             values,
+                             (int)numPercentiles + 2 );
+
+        if( print )
+        {
+            fprintf(stdout, "%10s %10" PRIu64, latencyNames[ i ], pHist->total );
+            for( k = 1; k < numPercentiles + 2; k++ )
+            {
+                fprintf(stdout, " %10.3f", values[ k ] );
+            }
+            fprintf(stdout, "\n");
+        }
+
+        if( pHists == windowHist )
+        {
+            HISTOGRAM_fnReset( pHist );
+        }
+    }
+
+    if( print )
+    {
+        fflush(stdout);
+    }
+}
+
 /*============================================================================*/
 /*!
     Calculate and log the response Time
@@ -494,31 +1112,31 @@ static void discreteEventSimulator_fnCalcRT( tzParams* params,
     float milliSecondsQ = (float)pServiceObject->secondsQueue * 1000;
     float milliSecondsS = (float)pServiceObject->secondsService * 1000;
 
+    discreteEventSimulator_fnRecordLatency( params, pServiceObject, NL );
+
     /* compute cycle sums in an epoch */
     if( !pServiceObject->endBatch )
     {
-        y[ cycleIdx ] += ( milliSecondsQ + milliSecondsS );
+        y += ( milliSecondsQ + milliSecondsS );
     }
     else if( pServiceObject->endBatch )
     {
         /* Finalise computation of cycle sums in an epoch */
-        y[ cycleIdx ] += ( milliSecondsQ + milliSecondsS );
-        fprintf( params->fCycleSums, "%d,%0.4f\n",
-                cycleIdx,
-                y[ cycleIdx ] );
-        fflush( params->fCycleSums );
+        y += ( milliSecondsQ + milliSecondsS );
+        WRITER_fnCycleSum( params->fCycleSums, cycleIdx, y );
 
-        /* calculating the sum of cycle sums lively */
-        sumOfCycleSums += y[ cycleIdx ];
-        sumOfNumbers += numberArrived[ cycleIdx];
+        /* calculating the sum of cycle sums lively, the objects of the
+         * epoch arrived together */
+        sumOfCycleSums += y;
+        sumOfNumbers += pServiceObject->batchSize;
 
         /* calculating the overall Mean lively */
         overalMean = (float)sumOfCycleSums / (float)sumOfNumbers;
 
         /* calculate the difference between expected and observed cycle sums */
-        w[ cycleIdx ] = y[ cycleIdx ] - (numberArrived[ cycleIdx] * overalMean);
+        w = y - (pServiceObject->batchSize * overalMean);
 
-        sumOf_w += ( w[ cycleIdx ] * w[ cycleIdx ] );
+        sumOf_w += ( w * w );
 
 
         /* Regeneration method, step 4. p435 - calculate the variance of diff.
@@ -541,15 +1159,26 @@ static void discreteEventSimulator_fnCalcRT( tzParams* params,
             if( ( 0 == ( params->currEpoch % 100 ) ) ||
                     ( params->currEpoch < 1000 ) )
             {
-                fprintf( params->fSteadyState, "%d,%0.2f,%0.2f\n",
-                        params->currEpoch,
-                        overalMean,
-                        confidenceInterval );
-                fflush( params->fSteadyState );
+                WRITER_fnSteadyState( params->fSteadyState,
+                                      params->currEpoch,
+                                      overalMean,
+                                      confidenceInterval );
             }
         }
 
+        /* the next epoch starts a new cycle sum */
+        y = 0.0;
         cycleIdx++;
+
+        /* percentile table of the window ending with the epoch */
+        if( ( params->windowEpochs > 0 ) &&
+            ( 0 == ( cycleIdx % params->windowEpochs ) ) )
+        {
+            discreteEventSimulator_fnPercentiles( params,
+                                                  NULL,
+                                                  windowHist,
+                                                  false );
+        }
     }
 
     if( params->verbose )
@@ -559,7 +1188,6 @@ static void discreteEventSimulator_fnCalcRT( tzParams* params,
                 (float)milliSecondsS,
                 (float)ResponseTime * 1000,
                 (float)(1/(float)ResponseTime) );
-        fflush(stdout);
     }
 
 }
@@ -568,6 +1196,22 @@ static void discreteEventSimulator_fnCalcRT( tzParams* params,
 /*!
     this is the first thread for creation of objects arriving
 
+    The arrivals are open loop: epoch k starts at the absolute time
+    k lambda seconds after the first one, whatever the time spent adding
+    and printing the objects before it.  The n objects of an epoch arrive
+    one by one, object j at j lambda / n seconds into its epoch, each with
+    its own intended arrival.  With -B the objects of an epoch are released
+    together at its start instead.
+
+    The thread sleeps with clock_nanosleep on CLOCK_MONOTONIC until shortly
+    before an arrival and spins on the clock through the rest, the spin is
+    the resolution of the clock up to ARRIVAL_SPIN_NS.  A sleep wakes late
+    by up to a timer tick, the lateness is measured and reported, not
+    hidden: an arrival late on its schedule is released at once and the
+    next ones keep their times.  The lag between the intended and the
+    actual release of every arrival goes to the arrivals file, its mean,
+    percentiles and maximum are printed at the end.
+
 @param[in]
     arg
         passing parameter of the thread
@@ -585,9 +1229,37 @@ static void* discreteEventSimulator_fnArrival( void* arg )
     int numberOfArrivals = 0;
     float lambda = params->lambda;
 
-    float lambdaMilli = lambda * 1000;
+    /* nanoseconds between the epochs */
+    uint64_t interval = (uint64_t)( (double)lambda * NANOSECONDS + 0.5 );
+    struct timespec start;
+    struct timespec res;
+    long spinNs = ARRIVAL_SPIN_NS;
+    uint64_t tFirst;
+    uint64_t intended = 0;
+    uint64_t offset;
+    uint64_t tIntended;
+    uint64_t tActual;
+    uint64_t lag;
+    uint64_t sumLag = 0;
+    int numReleased = 0;
+    int numReleases;
+    int i;
+
+    /* spin no longer than the resolution of the clock */
+    if( ( 0 == clock_getres( CLOCK_MONOTONIC, &res ) ) &&
+        ( 0 == res.tv_sec ) &&
+        ( res.tv_nsec < spinNs ) )
+    {
+        spinNs = res.tv_nsec;
+    }
+    HISTOGRAM_fnReset( &lagHist );
 
-    while( objCounter <= MAX_NUM_OF_OBJECTS )
+    /* the schedule starts now, on both clocks */
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    tFirst = ClockCycles( );
+
+    /* the objects are recycled, the run is bounded by its epochs only */
+    while( true )
     {
         if( 0 == params->rate )
         {
@@ -603,15 +1275,11 @@ static void* discreteEventSimulator_fnArrival( void* arg )
         }
 
 
-        /* array list of number of arrivals every time */
-        numberArrived[ params->currEpoch ] = numberOfArrivals;
-
         params->currEpoch++;
 
-        fprintf( params->fNormalDist, "%d,%d\n",
-                 params->currEpoch,
-                 numberOfArrivals );
-        fflush( params->fNormalDist );
+        WRITER_fnEpoch( params->fNormalDist,
+                        params->currEpoch,
+                        numberOfArrivals );
 
         if( !testDistribition )
         {
@@ -642,15 +1310,61 @@ static void* discreteEventSimulator_fnArrival( void* arg )
                         (float)numberOfArrivals/lambda );
             }
 
-            /* queue the number of arrived drones */
-            ret = QUEUE_fnAdd( pQueue, numberOfArrivals, arg );
+            /* one release of the epoch with -B, one per object otherwise */
+            numReleases = ( params->batchArrivals ) ? 1 : numberOfArrivals;
+
+            for( i = 0; i < numReleases; i++ )
+            {
+                /* sleep until the intended arrival */
+                offset = intended + interval * (uint64_t)i /
+                                    (uint64_t)numberOfArrivals;
+                discreteEventSimulator_fnSleepUntil( &start, offset, spinNs );
+
+                tActual = ClockCycles( );
+                tIntended = tFirst + (uint64_t)( (double)offset *
+                                                 params->cps / NANOSECONDS );
+                lag = ( tActual > tIntended ) ? tActual - tIntended : 0;
+                sumLag += lag;
+                HISTOGRAM_fnRecord( &lagHist,
+                                    (uint64_t)( (double)lag * NANOSECONDS /
+                                                params->cps ) );
+                numReleased++;
+
+                /* the objects released keep their intended arrival time */
+                params->tIntended = tIntended;
+
+                WRITER_fnArrival( params->fArrivals,
+                                  params->currEpoch,
+                                  ( params->batchArrivals ) ? numberOfArrivals
+                                                            : 1,
+                                  (double)( tIntended - tFirst ) *
+                                      MICROSECONDS / params->cps,
+                                  (double)( tActual - tFirst ) *
+                                      MICROSECONDS / params->cps,
+                                  (double)lag * MICROSECONDS / params->cps );
+
+                /* queue the arrived drones */
+                ret = ( params->batchArrivals )
+                        ? QUEUE_fnAdd( pQueue, numberOfArrivals, arg )
+                        : QUEUE_fnAddArrival( pQueue,
+                                              i,
+                                              numberOfArrivals,
+                                              arg );
+                if( ret != EOK )
+                {
+                    break;
+                }
+            }
+
             if( ret != EOK )
             {
                 printf("could not add an object, exiting.\n");
                 break;
             }
 
-            delay(lambdaMilli);
+            /* the next epoch is due one interval after this one was, not
+             * after its last object was released */
+            intended += interval;
         }
 
         /* exit simulation if exceeded requested number of simulation */
@@ -660,9 +1374,86 @@ static void* discreteEventSimulator_fnArrival( void* arg )
         }
     }
 
+    if( 0 < numReleased )
+    {
+        fprintf(stdout,
+                "\n%d releases in epochs every %.3f ms, spin %ld ns\n"
+                "schedule lag mean %.3f us p50 %.3f us p99 %.3f us "
+                "p99.9 %.3f us max %.3f us\n",
+                numReleased,
+                (double)interval / MICROSECONDS,
+                spinNs,
+                (double)sumLag * MICROSECONDS / params->cps / numReleased,
+                (double)HISTOGRAM_fnPercentile( &lagHist, 50.0 ) / 1000.0,
+                (double)HISTOGRAM_fnPercentile( &lagHist, 99.0 ) / 1000.0,
+                (double)HISTOGRAM_fnPercentile( &lagHist, 99.9 ) / 1000.0,
+                (double)lagHist.max / 1000.0 );
+    }
+
+    /* the server finishes the objects queued and stops */
+    QUEUE_fnClose( pQueue );
+
     return( NULL );
 }
 
+/*============================================================================*/
+/*!
+    Wait until a time of the arrival schedule
+
+    Sleeps until spinNs before the time, then spins on the clock until it.
+
+@param[in]
+    pStart
+        start of the schedule on CLOCK_MONOTONIC
+
+@param[in]
+    offset
+        nanoseconds from the start of the schedule
+
+@param[in]
+    spinNs
+        nanoseconds spun before the time
+
+*/
+/*============================================================================*/
+static void discreteEventSimulator_fnSleepUntil( const struct timespec* pStart,
+                                                 uint64_t offset,
+                                                 long spinNs )
+{
+    struct timespec next;
+    struct timespec now;
+    uint64_t wake = ( offset > (uint64_t)spinNs ) ? offset - spinNs : 0;
+
+    next.tv_sec = pStart->tv_sec + (time_t)( wake / NANOSECONDS );
+    next.tv_nsec = pStart->tv_nsec + (long)( wake % NANOSECONDS );
+    if( next.tv_nsec >= NANOSECONDS )
+    {
+        next.tv_sec++;
+        next.tv_nsec -= NANOSECONDS;
+    }
+    while( EINTR == clock_nanosleep( CLOCK_MONOTONIC,
+                                     TIMER_ABSTIME,
+                                     &next,
+                                     NULL ) )
+    {
+    }
+
+    /* spin through the last tick */
+    next.tv_sec = pStart->tv_sec + (time_t)( offset / NANOSECONDS );
+    next.tv_nsec = pStart->tv_nsec + (long)( offset % NANOSECONDS );
+    if( next.tv_nsec >= NANOSECONDS )
+    {
+        next.tv_sec++;
+        next.tv_nsec -= NANOSECONDS;
+    }
+    do
+    {
+        clock_gettime( CLOCK_MONOTONIC, &now );
+    } while( ( now.tv_sec < next.tv_sec ) ||
+             ( ( now.tv_sec == next.tv_sec ) &&
+               ( now.tv_nsec < next.tv_nsec ) ) );
+}
+
 /*============================================================================*/
 /*!
 
@@ -0,0 +1,234 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+MiniCloud Project. List all data points in target system.
+
+==============================================================================*/
+
+/*!
+ * @file histogram.c
+ * @brief High dynamic range histogram of the simulator latencies
+ *
+ * @addtogroup histogram latency percentiles of the queue, service and
+ *             response times
+ * @brief high dynamic range histogram
+ *
+ *  The bucket of a value v is v itself below 2^(S + 1), S being
+ *  HISTOGRAM_SUB_BITS.  Above that, with m the index of the highest bit of
+ *  v and shift = m - S, it is (shift + 1) 2^S + ( v >> shift ) - 2^S, the
+ *  S bits below the highest one select the bucket in its power of two.
+ *
+ */
+
+ /*! @{ */
+/*==============================================================================
+                              Includes
+==============================================================================*/
+#include <string.h>
+#include <math.h>
+
+#include "histogram.h"
+
+/*==============================================================================
+                                Defines
+==============================================================================*/
+
+/*==============================================================================
+                                Enums
+==============================================================================*/
+
+/*==============================================================================
+                              Structures
+==============================================================================*/
+
+/*==============================================================================
+                           Local/Private Variables
+==============================================================================*/
+
+/*==============================================================================
+                        Local/Private Function Prototypes
+==============================================================================*/
+static uint32_t histogram_fnBucket( uint64_t value );
+static uint64_t histogram_fnHighest( uint32_t bucket );
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*!
+    Empty a histogram
+
+    Only the buckets counted since the last reset are cleared, a histogram
+    of a short window is reset in the time of its few buckets.
+
+@param[in]
+    pHist
+        the histogram
+
+*/
+/*============================================================================*/
+void HISTOGRAM_fnReset( tzHISTOGRAM *pHist )
+{
+    if( (tzHISTOGRAM*)NULL != pHist )
+    {
+        if( 0 != pHist->total )
+        {
+            memset( &pHist->counts[ pHist->low ],
+                    0,
+                    ( pHist->high - pHist->low + 1 ) * sizeof( uint64_t ) );
+        }
+
+        pHist->total = 0;
+        pHist->min   = UINT64_MAX;
+        pHist->max   = 0;
+        pHist->low   = HISTOGRAM_BUCKETS - 1;
+        pHist->high  = 0;
+    }
+}
+
+/*============================================================================*/
+/*!
+    Count a value
+
+@param[in]
+    pHist
+        the histogram
+
+@param[in]
+    value
+        the value, HISTOGRAM_MAX_VALUE if it is larger
+
+*/
+/*============================================================================*/
+void HISTOGRAM_fnRecord( tzHISTOGRAM *pHist, uint64_t value )
+{
+    uint32_t bucket;
+
+    if( value > HISTOGRAM_MAX_VALUE )
+    {
+        value = HISTOGRAM_MAX_VALUE;
+    }
+
+    bucket = histogram_fnBucket( value );
+    pHist->counts[ bucket ]++;
+    pHist->total++;
+
+    pHist->min  = ( value < pHist->min ) ? value : pHist->min;
+    pHist->max  = ( value > pHist->max ) ? value : pHist->max;
+    pHist->low  = ( bucket < pHist->low ) ? bucket : pHist->low;
+    pHist->high = ( bucket > pHist->high ) ? bucket : pHist->high;
+}
+
+/*============================================================================*/
+/*!
+    Get the value at a percentile
+
+@param[in]
+    pHist
+        the histogram
+
+@param[in]
+    percentile
+        from 0 to 100
+
+@return
+    the largest value of the bucket holding the percentile, at most the
+    largest value recorded, 0 for an empty histogram
+
+*/
+/*============================================================================*/
+uint64_t HISTOGRAM_fnPercentile( const tzHISTOGRAM *pHist, double percentile )
+{
+    uint64_t value = 0;
+    uint64_t rank;
+    uint64_t count = 0;
+    uint32_t bucket;
+
+    if( ( (tzHISTOGRAM*)NULL != pHist ) && ( 0 != pHist->total ) )
+    {
+        percentile = ( percentile < 0.0 ) ? 0.0 :
+                     ( percentile > 100.0 ) ? 100.0 : percentile;
+
+        /* the value below which the percentile of the values are */
+        rank = (uint64_t)ceil( percentile / 100.0 * (double)pHist->total );
+        rank = ( rank < 1 ) ? 1 : rank;
+
+        value = pHist->max;
+        for( bucket = pHist->low; bucket <= pHist->high; bucket++ )
+        {
+            count += pHist->counts[ bucket ];
+            if( count >= rank )
+            {
+                value = histogram_fnHighest( bucket );
+                value = ( value > pHist->max ) ? pHist->max : value;
+                break;
+            }
+        }
+    }
+
+    return( value );
+}
+
+/*============================================================================*/
+/*!
+    Bucket of a value
+
+@param[in]
+    value
+        the value, at most HISTOGRAM_MAX_VALUE
+
+@return
+    the bucket
+
+*/
+/*============================================================================*/
+static uint32_t histogram_fnBucket( uint64_t value )
+{
+    uint32_t bucket = (uint32_t)value;
+    uint32_t shift;
+
+    if( value >= ( UINT64_C(1) << ( HISTOGRAM_SUB_BITS + 1 ) ) )
+    {
+        shift = 63 - __builtin_clzll( value ) - HISTOGRAM_SUB_BITS;
+        bucket = ( ( shift + 1 ) << HISTOGRAM_SUB_BITS ) +
+                 (uint32_t)( value >> shift ) - ( 1u << HISTOGRAM_SUB_BITS );
+    }
+
+    return( bucket );
+}
+
+/*============================================================================*/
+/*!
+    Largest value of a bucket
+
+@param[in]
+    bucket
+        the bucket
+
+@return
+    the largest value counted in the bucket
+
+*/
+/*============================================================================*/
+static uint64_t histogram_fnHighest( uint32_t bucket )
+{
+    uint64_t value = bucket;
+    uint32_t shift;
+
+    if( bucket >= ( 1u << ( HISTOGRAM_SUB_BITS + 1 ) ) )
+    {
+        shift = ( bucket >> HISTOGRAM_SUB_BITS ) - 1;
+        value = ( (uint64_t)( ( bucket & ( ( 1u << HISTOGRAM_SUB_BITS ) - 1 ) ) +
+                              ( 1u << HISTOGRAM_SUB_BITS ) ) << shift ) +
+                ( ( UINT64_C(1) << shift ) - 1 );
+    }
+
+    return( value );
+}
+
+/*! @} */
+
+//EoF
@@ -31,6 +31,7 @@ MiniCloud Project. List all data points in target system.
 #include <sys/neutrino.h>
 #include <inttypes.h>
 #include <sys/syspage.h>
+#include <sched.h>
 
 #include "objqueue.h"
 
@@ -46,17 +47,44 @@ MiniCloud Project. List all data points in target system.
                               Structures
 ==============================================================================*/
 
+/*! objects allocated together by the object pool */
+typedef struct zOBJSLAB
+{
+    /*! slab allocated before this one */
+    struct zOBJSLAB* next;
+
+    /*! objects of the slab */
+    tzOBJECT objects[QUEUE_POOL_SLAB];
+
+} tzOBJSLAB;
+
 /*==============================================================================
                            Local/Private Variables
 ==============================================================================*/
 extern tzQUEUE* pQueue;
-//tzOBJECT** pObj;
-tzOBJECT* pObj[MAX_NUM_OF_OBJECTS];
-int objCounter = 0;
+
+/*! names of the objects, indexed by OBJ_NAME_ */
+static const char* objNames[] =
+{
+    /* Unmanned Aircraft System (UAS) Name Registration */
+    "Drone"
+};
+
+/*! protects the object pool */
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*! slabs of the object pool, freed by QUEUE_fnTerminate */
+static tzOBJSLAB* pSlabs = (tzOBJSLAB*)NULL;
+
+/*! objects of the pool not in use, linked by queue.next */
+static tzOBJECT* pFreeObjs = (tzOBJECT*)NULL;
 /*==============================================================================
                         Local/Private Function Prototypes
 ==============================================================================*/
 static int queue_fnAddObj( tzQUEUE *pQueue, tzOBJECT *pObj, void* arg );
+static int queue_fnGrowPool( void );
+static void queue_fnLink( tzQUEUE *pQ, tzOBJECT *pObj );
+static tzOBJECT* queue_fnRemove( tzQUEUE *pQ );
 
 /*==============================================================================
                            Function Definitions
@@ -89,46 +117,82 @@ int QUEUE_fnAdd( tzQUEUE *pQueue, int num, void* arg )
     int ret = EINVAL;
     int i = 0;
 
-
     for(i=0; i<num; i++)
     {
-        pObj[objCounter] = calloc(1, sizeof(struct zOBJECT) );
-        if( NULL == pObj[objCounter])
+        ret = QUEUE_fnAddArrival( pQueue, i, num, arg );
+        if( EOK != ret )
         {
-            printf("cannot calloc pObj[%d]\n", objCounter );
+            break;
         }
-        else
-        {
-            /* Unmanned Aircraft System (UAS) Name Registration */
-            strncpy(pObj[objCounter]->ObjName, "Drone", strlen( "Drone" ) + 1 );
-            if( 0 == i )
-            {
-                pObj[objCounter]->beginBatch = true;
-            }
-            if( ( num - 1 ) == i )
-            {
-                pObj[objCounter]->endBatch = true;
-            }
+    }
 
-            /* add objects one by one to the queue */
-            queue_fnAddObj( pQueue,  pObj[objCounter], arg );
+    return ( ret );
 
-            objCounter++;
+}
 
-            ret = ( EOK );
+/*============================================================================*/
+/*!
+    Add one object of an epoch to the queue
 
-        }
+    The objects of an epoch may arrive one by one, each at its own time.
+    The first and the last object of the epoch close its cycle sum.
+
+@param[in]
+    pQueue
+        the queue handle
+
+@param[in]
+    index
+        number of the object in its epoch, from 0
+
+@param[in]
+    num
+        number of objects of the epoch
+
+@param[in]
+    arg
+        system parameters, tIntended is the intended arrival of the object
+
+@retval EOK or errno.h upon any errors
+
+*/
+/*============================================================================*/
+int QUEUE_fnAddArrival( tzQUEUE *pQueue, int index, int num, void* arg )
+{
+    tzOBJECT* pObj;
+    tzParams* params = (tzParams*)arg;
+
+    pObj = QUEUE_fnAllocObj( );
+    if( NULL == pObj )
+    {
+        printf("cannot allocate object %d of %d\n", index, num );
+        return ( ENOMEM );
     }
 
-    return ( ret );
+    pObj->nameId = OBJ_NAME_DRONE;
+    pObj->tIntended = params->tIntended;
+    pObj->batchSize = num;
+    if( 0 == index )
+    {
+        pObj->beginBatch = true;
+    }
+    if( ( num - 1 ) == index )
+    {
+        pObj->endBatch = true;
+    }
+
+    /* add the object to the queue */
+    queue_fnAddObj( pQueue,  pObj, arg );
 
+    return ( EOK );
 }
 
 /*============================================================================*/
 /*!
     Get first object from the queue
 
-    This function gets the first object from the specified queue
+    This function gets the first object from the specified queue, without
+    removing it.  Call it from the server removing objects only.
 
 @param[in]
     pQueue
@@ -146,9 +210,10 @@ tzOBJECT* QUEUE_fnGetFirstObj( tzQUEUE *pQueue )
 
     if( (tzQUEUE*)NULL != pQueue )
     {
-        if( (tzOBJECT*)NULL != pQueue->pFirst )
+        pObject = pQueue->pFirst;
+        if( &pQueue->stub == pObject )
         {
-            pObject = pQueue->pFirst;
+            pObject = __atomic_load_n( &pObject->queue.next, __ATOMIC_ACQUIRE );
         }
     }
     return( pObject );
@@ -174,7 +239,13 @@ tzOBJECT* QUEUE_fnGetNextObj( tzOBJECT *pObject )
 
     if( (tzOBJECT*)NULL != pObject )
     {
-        retObj = (tzOBJECT*)pObject->queue.next;
+        retObj = __atomic_load_n( &pObject->queue.next, __ATOMIC_ACQUIRE );
+
+        /* the stub is not an object, skip it */
+        if( ( (tzQUEUE*)NULL != pQueue ) && ( &pQueue->stub == retObj ) )
+        {
+            retObj = __atomic_load_n( &retObj->queue.next, __ATOMIC_ACQUIRE );
+        }
     }
     return( retObj );
 }
@@ -191,7 +262,7 @@ tzOBJECT* QUEUE_fnGetNextObj( tzOBJECT *pObject )
         here the service discipline is first-come-first-serve (FCFS)
 
     Essentially this function is for taking out items from the queue one
-    by one.
+    by one.  It does not wait for an object, see QUEUE_fnWaitAndRemove.
 
 @param[in]
     pQ Pointer to the block
@@ -207,59 +278,279 @@ tzOBJECT* QUEUE_fnGetNextObj( tzOBJECT *pObject )
 /*============================================================================*/
 tzOBJECT* QUEUE_fnGetAndRemoveFirstObj( tzQUEUE *pQ, void* arg )
 {
-    tzOBJECT *pSecondObj;
     tzOBJECT *pToBeRemoved = (tzOBJECT *)NULL;
-    tzParams* params = (tzParams*)arg;
 
     if(  pQ != (tzQUEUE*)NULL )
     {
         pthread_mutex_lock( &pQ->mutex );
 
-        if( (tzOBJECT*)NULL != pQ->pFirst )
+        if( 0 != __atomic_load_n( &pQ->uiObjCount, __ATOMIC_ACQUIRE ) )
         {
-            pToBeRemoved = pQ->pFirst;
+            pToBeRemoved = queue_fnRemove( pQ );
+            __atomic_sub_fetch( &pQ->uiObjCount, 1, __ATOMIC_RELAXED );
+        }
 
-            /* Check if the queue has only one element*/
-            if( pQ->pFirst == pQ->pLast )
-            {
-                pQ->pFirst = (tzOBJECT*)NULL;
-                pQ->pLast  = (tzOBJECT*)NULL;
-            }
-            else
+        pthread_mutex_unlock( &pQ->mutex );
+    }
+
+    /* --- end time going out of the queue --- */
+    if( (tzOBJECT*)NULL != pToBeRemoved )
+    {
+        QUEUE_fnLeave( pToBeRemoved, arg );
+    }
+
+    return( pToBeRemoved );
+}
+
+/*============================================================================*/
+/*!
+    Wait for objects in the queue and remove them
+
+    This function blocks until the queue holds an object or is closed, then
+    removes up to max objects from the front of the queue in FCFS order.
+    The server thread sleeps while the queue is empty instead of polling
+    it, so its CPU time is the service of the objects.
+
+    The server announces itself in waiters before it checks the count for
+    the last time, and an arrival counts its object before it reads
+    waiters, so either the server sees the object or the arrival wakes it.
+
+    The objects are not timed out of the queue, they wait for the server
+    until the ones before them are served.  Call QUEUE_fnLeave for each
+    object when its service starts.
+
+@param[in]
+    pQ
+        Pointer to the queue
+
+@param[out]
+    ppObjects
+        the removed objects, in arrival order
+
+@param[in]
+    max
+        most objects to remove, 1 takes one object at a time
+
+@return
+    number of objects removed,
+    0 once the queue is closed and empty or upon an invalid argument
+
+*/
+/*============================================================================*/
+int QUEUE_fnWaitAndRemove( tzQUEUE *pQ, tzOBJECT **ppObjects, int max )
+{
+    uint32_t count;
+    int num = 0;
+
+    if( ( pQ != (tzQUEUE*)NULL ) && ( ppObjects != NULL ) && ( max > 0 ) )
+    {
+        pthread_mutex_lock( &pQ->mutex );
+
+        while( ( 0 == ( count = __atomic_load_n( &pQ->uiObjCount,
+                                                 __ATOMIC_SEQ_CST ) ) ) &&
+               ( false == __atomic_load_n( &pQ->closed, __ATOMIC_SEQ_CST ) ) )
+        {
+            __atomic_add_fetch( &pQ->waiters, 1, __ATOMIC_SEQ_CST );
+            if( ( 0 == __atomic_load_n( &pQ->uiObjCount, __ATOMIC_SEQ_CST ) ) &&
+                ( false == __atomic_load_n( &pQ->closed, __ATOMIC_SEQ_CST ) ) )
             {
-                pSecondObj             = pQ->pFirst->queue.next;
-                pSecondObj->queue.prev = (tzOBJECT*)NULL;
-                pQ->pFirst             = pSecondObj;
+                pthread_cond_wait( &pQ->cond, &pQ->mutex );
             }
-            pToBeRemoved->queue.next   = (tzOBJECT*)NULL;
-            pToBeRemoved->queue.prev   = (tzOBJECT*)NULL;
-
-            pQ->uiObjCount--;
+            __atomic_sub_fetch( &pQ->waiters, 1, __ATOMIC_SEQ_CST );
+        }
 
+        /* the objects counted are linked or about to be */
+        while( ( num < max ) && ( (uint32_t)num < count ) )
+        {
+            ppObjects[ num++ ] = queue_fnRemove( pQ );
         }
 
-        /* --- end time going out of the queue --- */
-        pToBeRemoved->tEndQ = ClockCycles( );
-        /* ------------------------------ */
+        __atomic_sub_fetch( &pQ->uiObjCount, (uint32_t)num, __ATOMIC_RELAXED );
 
         pthread_mutex_unlock( &pQ->mutex );
     }
 
+    return( num );
+}
+
+/*============================================================================*/
+/*!
+    Time an object out of the queue
+
+    This function stamps the time the object leaves the queue for the
+    server and updates its time spent in the queue.
+
+@param[in]
+    pObj
+        the object taken from the queue
+
+@param[in]
+    arg
+        system parameters like the verbosity and the clock rate
+
+*/
+/*============================================================================*/
+void QUEUE_fnLeave( tzOBJECT *pObj, void* arg )
+{
+    tzParams* params = (tzParams*)arg;
+
+    /* --- end time going out of the queue --- */
+    pObj->tEndQ = ClockCycles( );
+    /* ------------------------------ */
+
     /* update time spent in queue for each object */
 
-    pToBeRemoved->deltaInQueue = pToBeRemoved->tEndQ - pToBeRemoved->tStartQ;
+    pObj->deltaInQueue = pObj->tEndQ - pObj->tStartQ;
 
-    pToBeRemoved->secondsQueue =(double)pToBeRemoved->deltaInQueue/params->cps;
+    pObj->secondsQueue =(double)pObj->deltaInQueue/params->cps;
 
     if( params->verbose)
     {
         fprintf( stdout,
                  "%45.2lf ms",
-                 pToBeRemoved->secondsQueue*1000 );
+                 pObj->secondsQueue*1000 );
     }
+}
+
+/*============================================================================*/
+/*!
+    Close the queue
 
+    No more objects will be added.  The threads waiting in
+    QUEUE_fnWaitAndRemove take the objects left, then return 0.
 
-    return( pToBeRemoved );
+@param[in]
+    pQ
+        Pointer to the queue
+
+*/
+/*============================================================================*/
+void QUEUE_fnClose( tzQUEUE *pQ )
+{
+    if( pQ != (tzQUEUE*)NULL )
+    {
+        __atomic_store_n( &pQ->closed, true, __ATOMIC_SEQ_CST );
+        pthread_mutex_lock( &pQ->mutex );
+        pthread_cond_broadcast( &pQ->cond );
+        pthread_mutex_unlock( &pQ->mutex );
+    }
+}
+
+/*============================================================================*/
+/*!
+    Take an object from the object pool
+
+    The objects are recycled, so a run holds as many objects as were in the
+    system at once whatever its number of epochs.  The pool grows by a slab
+    of QUEUE_POOL_SLAB objects when it is empty.
+
+@return
+    the object, cleared, or NULL if the pool cannot grow
+
+*/
+/*============================================================================*/
+tzOBJECT* QUEUE_fnAllocObj( void )
+{
+    tzOBJECT* pObj = (tzOBJECT*)NULL;
+
+    pthread_mutex_lock( &poolMutex );
+
+    if( ( (tzOBJECT*)NULL != pFreeObjs ) || ( EOK == queue_fnGrowPool( ) ) )
+    {
+        pObj = pFreeObjs;
+        pFreeObjs = pObj->queue.next;
+    }
+
+    pthread_mutex_unlock( &poolMutex );
+
+    if( (tzOBJECT*)NULL != pObj )
+    {
+        memset( pObj, 0, sizeof( tzOBJECT ) );
+    }
+
+    return( pObj );
+}
+
+/*============================================================================*/
+/*!
+    Return an object to the object pool
+
+    Call it once the object has been served and its response time logged.
+
+@param[in]
+    pObj
+        the object, out of the queue
+
+*/
+/*============================================================================*/
+void QUEUE_fnFreeObj( tzOBJECT *pObj )
+{
+    if( (tzOBJECT*)NULL != pObj )
+    {
+        pthread_mutex_lock( &poolMutex );
+        pObj->queue.prev = (tzOBJECT*)NULL;
+        pObj->queue.next = pFreeObjs;
+        pFreeObjs = pObj;
+        pthread_mutex_unlock( &poolMutex );
+    }
+}
+
+/*============================================================================*/
+/*!
+    Get the name of an object
+
+@param[in]
+    pObj
+        the object
+
+@return
+    the name of its OBJ_NAME_ identifier, "" if it is unknown
+
+*/
+/*============================================================================*/
+const char* QUEUE_fnObjName( const tzOBJECT *pObj )
+{
+    const char* pName = "";
+
+    if( ( (tzOBJECT*)NULL != pObj ) &&
+        ( pObj->nameId < sizeof( objNames ) / sizeof( objNames[0] ) ) )
+    {
+        pName = objNames[ pObj->nameId ];
+    }
+
+    return( pName );
+}
+
+/*============================================================================*/
+/*!
+    Release the queue and the object pool
+
+    Call it once the threads using the queue and the objects have ended.
+
+*/
+/*============================================================================*/
+void QUEUE_fnTerminate( void )
+{
+    tzOBJSLAB* pSlab;
+
+    pthread_mutex_lock( &poolMutex );
+    while( (tzOBJSLAB*)NULL != pSlabs )
+    {
+        pSlab = pSlabs;
+        pSlabs = pSlab->next;
+        free( pSlab );
+    }
+    pFreeObjs = (tzOBJECT*)NULL;
+    pthread_mutex_unlock( &poolMutex );
+
+    if( (tzQUEUE*)NULL != pQueue )
+    {
+        pthread_cond_destroy( &pQueue->cond );
+        pthread_mutex_destroy( &pQueue->mutex );
+        pthread_mutexattr_destroy( &pQueue->mutexattr );
+        free( pQueue );
+        pQueue = (tzQUEUE*)NULL;
+    }
 }
 
 /*============================================================================*/
@@ -269,6 +560,12 @@ tzOBJECT* QUEUE_fnGetAndRemoveFirstObj( tzQUEUE *pQ, void* arg )
     This function adds a new object to the queue
     the clock starts ticking from the time the object has been added to the q
 
+    The object is stamped before it is linked, the time stamp does not
+    include waiting on the other arrivals or on the server.  The arrival
+    swaps the object in as the last one and links the previous last object
+    to it; the server waits for that link if it reaches the previous object
+    first.
+
 @param[in]
     pQueue
         the queue handle
@@ -288,62 +585,166 @@ tzOBJECT* QUEUE_fnGetAndRemoveFirstObj( tzQUEUE *pQ, void* arg )
 static int queue_fnAddObj( tzQUEUE *pQueue, tzOBJECT *pObj, void* arg )
 {
     int ret = EINVAL;
-    tzOBJECT* pTmpObj;
+    uint32_t count;
     tzParams* params = (tzParams*)arg;
 
     if( ( pQueue != (tzQUEUE *)NULL ) && ( pObj != (tzOBJECT*)NULL ) )
     {
-        pthread_mutex_lock( &pQueue->mutex );
-
         /* ----- start time in the queue ----- */
         pObj->tStartQ = ClockCycles( );
         /* ------------------------ */
 
         /* Add the item to the end of the list */
-        if( (tzOBJECT*)NULL == pQueue->pFirst )
-        {
-            /* this is the first object */
-            pQueue->pFirst    = pObj;
-            pQueue->pLast     = pObj;
-            pObj->queue.prev  = NULL;
-            pObj->queue.next  = NULL;
-        }
-        else
+        queue_fnLink( pQueue, pObj );
+        count = __atomic_add_fetch( &pQueue->uiObjCount, 1, __ATOMIC_SEQ_CST );
+
+        /* wake a server waiting for an object */
+        if( 0 != __atomic_load_n( &pQueue->waiters, __ATOMIC_SEQ_CST ) )
         {
-            /* Handling of the doubly linked list */
-            pTmpObj               = pQueue->pLast;
-            pTmpObj->queue.next   = (void*)pObj;
-            pObj->queue.prev      = (void*)pTmpObj;
-            pObj->queue.next      = (void*)NULL;
-            pQueue->pLast         = pObj;
+            pthread_mutex_lock( &pQueue->mutex );
+            pthread_cond_signal( &pQueue->cond );
+            pthread_mutex_unlock( &pQueue->mutex );
         }
-        pQueue->uiObjCount++;
 
         /* print to stdout if verbosity is set */
         if( params->verbose )
         {
-            if( pQueue->uiObjCount < 2 )
+            if( count < 2 )
             {
                 fprintf(stdout,
                         "%10u\n",
-                        pQueue->uiObjCount );
+                        count );
             }
             else
             {
                 fprintf(stdout,
                         "%37u\n",
-                        pQueue->uiObjCount );
+                        count );
             }
         }
 
-        pthread_mutex_unlock( &pQueue->mutex );
-
         ret = EOK;
     }
 
     return ( ret );
 }
 
+/*============================================================================*/
+/*!
+    Link an object at the end of the queue
+
+    Any number of threads link objects at once, without a lock.
+
+@param[in]
+    pQ
+        the queue
+
+@param[in]
+    pObj
+        the object
+
+*/
+/*============================================================================*/
+static void queue_fnLink( tzQUEUE *pQ, tzOBJECT *pObj )
+{
+    tzOBJECT* pPrev;
+
+    pObj->queue.prev = (tzOBJECT*)NULL;
+    __atomic_store_n( &pObj->queue.next, (tzOBJECT*)NULL, __ATOMIC_RELAXED );
+    pPrev = __atomic_exchange_n( &pQ->pLast, pObj, __ATOMIC_ACQ_REL );
+    __atomic_store_n( &pPrev->queue.next, pObj, __ATOMIC_RELEASE );
+}
+
+/*============================================================================*/
+/*!
+    Remove the first object of the queue
+
+    Call it with the mutex of the queue locked, after the object has been
+    counted.  An arrival which swapped itself in but has not yet linked the
+    object before it is waited for.
+
+@param[in]
+    pQ
+        the queue
+
+@return
+    the first object
+
+*/
+/*============================================================================*/
+static tzOBJECT* queue_fnRemove( tzQUEUE *pQ )
+{
+    tzOBJECT* pFirst;
+    tzOBJECT* pNext;
+
+    while( true )
+    {
+        pFirst = pQ->pFirst;
+        pNext = __atomic_load_n( &pFirst->queue.next, __ATOMIC_ACQUIRE );
+
+        if( &pQ->stub == pFirst )
+        {
+            /* step over the stub */
+            if( (tzOBJECT*)NULL != pNext )
+            {
+                pQ->pFirst = pNext;
+                continue;
+            }
+        }
+        else if( (tzOBJECT*)NULL != pNext )
+        {
+            pQ->pFirst = pNext;
+            break;
+        }
+        else if( pFirst == __atomic_load_n( &pQ->pLast, __ATOMIC_ACQUIRE ) )
+        {
+            /* the last object, the stub takes its place at the end */
+            queue_fnLink( pQ, &pQ->stub );
+            continue;
+        }
+
+        /* an arrival is linking the next object */
+        sched_yield( );
+    }
+
+    pFirst->queue.next = (tzOBJECT*)NULL;
+
+    return( pFirst );
+}
+
+/*============================================================================*/
+/*!
+    Add a slab of objects to the object pool
+
+    Call it with the pool mutex locked.
+
+@retval EOK or ENOMEM
+
+*/
+/*============================================================================*/
+static int queue_fnGrowPool( void )
+{
+    int ret = ENOMEM;
+    int i;
+    tzOBJSLAB* pSlab = (tzOBJSLAB*)malloc( sizeof( tzOBJSLAB ) );
+
+    if( (tzOBJSLAB*)NULL != pSlab )
+    {
+        for( i = 0; i < QUEUE_POOL_SLAB; i++ )
+        {
+            pSlab->objects[ i ].queue.next = pFreeObjs;
+            pFreeObjs = &pSlab->objects[ i ];
+        }
+
+        pSlab->next = pSlabs;
+        pSlabs = pSlab;
+
+        ret = EOK;
+    }
+
+    return( ret );
+}
+
 /*============================================================================*/
 /*!
     Initialise a queue for autonomous objects
@@ -374,8 +775,16 @@ int  QUEUE_fnInitialize( void )
     {
         pthread_mutexattr_init( &pQueue->mutexattr );
         pthread_mutex_init( &pQueue->mutex, &pQueue->mutexattr );
+        pthread_cond_init( &pQueue->cond, NULL );
 
-        ret = EOK;
+        /* an empty queue holds the stub only */
+        pQueue->pFirst = &pQueue->stub;
+        pQueue->pLast  = &pQueue->stub;
+
+        /* the first slab of objects is allocated before the run */
+        pthread_mutex_lock( &poolMutex );
+        ret = ( NULL == pFreeObjs ) ? queue_fnGrowPool( ) : EOK;
+        pthread_mutex_unlock( &poolMutex );
     }
 
     return( ret );
@@ -24,11 +24,35 @@ MiniCloud Project. List all data points in target system.
  =============================================================================*/
 #include "service.h"
 #include "objqueue.h"
+#include "policyset.h"
+
+/*==============================================================================
+                                  Defines
+ =============================================================================*/
+/*! policy committed before every policy registration */
+#define SERVICE_VOID_POLICY   "/etc/voidPolicy.xml"
+
+/*! number of handmade policy files picked from by the free run */
+#define SERVICE_NUM_POLICIES  ( 6 )
 
 /*==============================================================================
                                   Structs
  =============================================================================*/
 
+/*! policy loader of a server connection */
+typedef struct zServiceLoader
+{
+    /*! data point resource manager connection of the server */
+    DPRM_HANDLE hDPRM;
+
+    /*! loader applying the policy files on that connection */
+    POLICYSET_HANDLE hPolicySet;
+
+    /*! state of the policy choice of the server, see uniform_distribution */
+    unsigned int seed;
+
+} tzServiceLoader;
+
 /*==============================================================================
                          Local Module Variables
  =============================================================================*/
@@ -36,6 +60,20 @@ MiniCloud Project. List all data points in target system.
  * and values */
 extern outputFn outputFCN;
 
+/*! loaders keeping the policy files parsed, one per connection, see
+ *  SERVICE_fnInit */
+static tzServiceLoader loaders[ SERVICE_MAX_CONNECTIONS ];
+
+/*! number of loaders */
+static int numLoaders = 0;
+
+/*! the servers register their policies in the one rule set of the data
+ *  point manager: the queries share it, a policy swap takes it alone */
+static pthread_rwlock_t ruleSetLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*! policy file number code applied to the rule set, 0 for none */
+static int appliedPolicy = 0;
+
 /*==============================================================================
                  Local/Private Function Prototypes
  =============================================================================*/
@@ -65,7 +103,12 @@ static void service_fnQueryStatic( DPRM_HANDLE hDPRM,
                                      tzDataPointValueData tzDataPointValueData,
                                      outputFn outputFCN, //virtual fcn typedef
                                      void* arg );
-static int uniform_distribution(int rangeLow, int rangeHigh);
+static int uniform_distribution( unsigned int *pSeed,
+                                 int rangeLow,
+                                 int rangeHigh );
+static void service_fnPolicyPath( int policyNum, char *path, size_t len );
+static tzServiceLoader* service_fnLoader( DPRM_HANDLE hDPRM );
+static void service_fnApplyPolicy( tzServiceLoader *pLoader, char *path );
 static int service_fnTimestampMatch( int checkTimestamp,
                                      struct timespec *pMatchTime,
                                      struct timespec *pVarTime );
@@ -75,11 +118,106 @@ static int service_fnTimestampMatch( int checkTimestamp,
                             Function Definitions
  =============================================================================*/
 
+/*============================================================================*/
+/*!
+
+    Open the policy loader of the service factory and parse the policy
+    files the simulation registers, outside of the measured service time
+
+    Every server connection has its loader, the policy rules of a service
+    are registered on the connection of the server processing it.  The
+    connections are initialised before the servers start, the policy
+    choice of every server is seeded with its connection number.
+
+@param[in]
+    hDPRM
+        data point resource manager
+
+@param[in]
+    arg
+        application parameters, the policy file number code
+
+@return
+    EOK on success, ENOMEM if the loader cannot be opened,
+    ENOSPC if SERVICE_MAX_CONNECTIONS are initialised
+
+ */
+/*============================================================================*/
+int SERVICE_fnInit( DPRM_HANDLE hDPRM, void* arg )
+{
+    tzParams* params = (tzParams*)arg;
+    tzPolicySet *pSet = NULL;
+    char policy[512];
+    int first;
+    int last;
+    POLICYSET_HANDLE hPolicySet;
+    int i;
+
+    if( numLoaders >= SERVICE_MAX_CONNECTIONS )
+    {
+        return ENOSPC;
+    }
+
+    hPolicySet = POLICYSET_fnOpen( hDPRM );
+    if( NULL == hPolicySet )
+    {
+        return ENOMEM;
+    }
+
+    loaders[ numLoaders ].hDPRM = hDPRM;
+    loaders[ numLoaders ].hPolicySet = hPolicySet;
+    loaders[ numLoaders ].seed = (unsigned int)numLoaders + 1u;
+    numLoaders++;
+
+    /* the free run picks any of the handmade files */
+    first = ( 0 == params->policyRuleNum ) ? 1 : params->policyRuleNum;
+    last  = ( 0 == params->policyRuleNum ) ? SERVICE_NUM_POLICIES
+                                           : params->policyRuleNum;
+
+    /* a file which cannot be parsed now is tried again when applied */
+    POLICYSET_fnLoad( hPolicySet,
+                      PARSE_fnPolicyCreate,
+                      SERVICE_VOID_POLICY,
+                      &pSet );
+    for( i = first; i <= last; i++ )
+    {
+        service_fnPolicyPath( i, policy, sizeof(policy) );
+        POLICYSET_fnLoad( hPolicySet, PARSE_fnPolicyCreate, policy, &pSet );
+    }
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Close the policy loaders of the service factory
+
+ */
+/*============================================================================*/
+void SERVICE_fnShutdown( void )
+{
+    while( numLoaders > 0 )
+    {
+        numLoaders--;
+        POLICYSET_fnClose( loaders[ numLoaders ].hPolicySet );
+        loaders[ numLoaders ].hPolicySet = NULL;
+    }
+}
+
 /*============================================================================*/
 /*!
 
     Entry point for service factory: policy registration and the query
 
+    The connections of the servers share the rule set of the data point
+    manager.  The queries of the servers run together under the shared
+    side of the rule set lock, the policy they query with cannot change
+    under them.  A service which needs another policy than the one applied
+    takes the rule set alone to apply the void policy and its own, then
+    queries under the shared side.  With -n the policy is applied once for
+    the run.
+
 @param[in]
     hDPRM
         data point resource manager
@@ -98,14 +236,20 @@ static int service_fnTimestampMatch( int checkTimestamp,
     arg
         application parameters like showing the outputstream switch
 
+@return
+    clock cycles when the rule set was first taken, the service started
+    then, a swap of the policy by the server counts in its service
+
  */
 /*============================================================================*/
-void SERVICE_fnProcess( DPRM_HANDLE hDPRM,
-                        char* key,
-                        teMatchType matchType,
-                        void* arg )
+uint64_t SERVICE_fnProcess( DPRM_HANDLE hDPRM,
+                            char* key,
+                            teMatchType matchType,
+                            void* arg )
 {
     tzParams* params = (tzParams*)arg;
+    tzServiceLoader *pLoader = service_fnLoader( hDPRM );
+    uint64_t tStart = 0;
     char *tag = NULL;
     uint16_t flags = 0;
     uint32_t contextID1 = 0;
@@ -119,52 +263,42 @@ void SERVICE_fnProcess( DPRM_HANDLE hDPRM,
 
     memset(policy, 0, sizeof(policy) );
 
-
-    /* bring back to default first */
-    system("defdp -p /etc/voidPolicy.xml");
-
     /* choose for sensitivity simulation or free run */
-    if( 0 == params->policyRuleNum )
+    if( ( 0 == params->policyRuleNum ) && ( NULL != pLoader ) )
     {
         /* policy registration
          * NOTE: based on varying the data base we get different query size */
-        choice = uniform_distribution(1, 6);
-        switch(choice)
-        {
-        case 1:
-            system("defdp -p /sim/policyTesla.xml");
-            break;
-        case 2:
-            system("defdp -p /sim/2policy.xml");
-            break;
-        case 3:
-            system("defdp -p /sim/3policy.xml");
-            break;
-        case 4:
-            system("defdp -p /sim/4policy.xml");
-            break;
-        case 5:
-            system("defdp -p /sim/5policy.xml");
-            break;
-        case 6:
-            system("defdp -p /sim/6policy.xml");
-            break;
-        }
+        choice = uniform_distribution( &pLoader->seed,
+                                       1,
+                                       SERVICE_NUM_POLICIES );
     }
     else
     {
-        if( 1 == params->policyRuleNum )
+        choice = params->policyRuleNum;
+    }
+
+    service_fnPolicyPath( choice, policy, sizeof(policy) );
+
+    /* query under the shared side once the policy chosen is applied */
+    while( true )
+    {
+        pthread_rwlock_rdlock( &ruleSetLock );
+        tStart = ( 0 == tStart ) ? ClockCycles( ) : tStart;
+        if( choice == appliedPolicy )
         {
-            system("defdp -p /sim/policyTesla.xml");
+            break;
         }
-        else
+        pthread_rwlock_unlock( &ruleSetLock );
+
+        pthread_rwlock_wrlock( &ruleSetLock );
+        if( choice != appliedPolicy )
         {
-            /* scale is in 8 rules per file so 2policy means 2 x 8*/
-            sprintf( policy,
-                     "defdp -p /sim/%upolicy.xml",
-                     params->policyRuleNum );
-            system(policy);
+            /* bring back to default first */
+            service_fnApplyPolicy( pLoader, SERVICE_VOID_POLICY );
+            service_fnApplyPolicy( pLoader, policy );
+            appliedPolicy = choice;
         }
+        pthread_rwlock_unlock( &ruleSetLock );
     }
 
 
@@ -204,6 +338,10 @@ void SERVICE_fnProcess( DPRM_HANDLE hDPRM,
                                outputFCN,
                                arg );
     }
+
+    pthread_rwlock_unlock( &ruleSetLock );
+
+    return tStart;
 }
 
 /*============================================================================*/
@@ -508,11 +646,107 @@ static void service_fnQueryStatic( DPRM_HANDLE hDPRM,
 }
 
 
+/*============================================================================*/
+/*!
+
+    Path of a handmade policy file
+
+@param[in]
+    policyNum
+        policy file number code, 1 is the Tesla policy, n the file of n x 8
+        rules
+
+@param[out]
+    path
+        path of the file
+
+@param[in]
+    len
+        size of the path buffer
+
+*/
+/*============================================================================*/
+static void service_fnPolicyPath( int policyNum, char *path, size_t len )
+{
+    if( 1 == policyNum )
+    {
+        snprintf( path, len, "/sim/policyTesla.xml" );
+    }
+    else
+    {
+        /* scale is in 8 rules per file so 2policy means 2 x 8*/
+        snprintf( path, len, "/sim/%upolicy.xml", (unsigned)policyNum );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Find the policy loader of a server connection
+
+@param[in]
+    hDPRM
+        connection of the server
+
+@return
+    the loader, NULL if the connection was not initialised
+
+*/
+/*============================================================================*/
+static tzServiceLoader* service_fnLoader( DPRM_HANDLE hDPRM )
+{
+    int i;
+
+    for( i = 0; i < numLoaders; i++ )
+    {
+        if( hDPRM == loaders[ i ].hDPRM )
+        {
+            return &loaders[ i ];
+        }
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*!
+
+    Register a policy file and commit it, as "defdp -p <path>" did
+
+@param[in]
+    pLoader
+        loader of the server connection, it applies the file
+
+@param[in]
+    path
+        path of the policy file
+
+*/
+/*============================================================================*/
+static void service_fnApplyPolicy( tzServiceLoader *pLoader, char *path )
+{
+    if( NULL == pLoader )
+    {
+        return;
+    }
+
+    if( EOK != POLICYSET_fnApplyFile( pLoader->hPolicySet,
+                                      PARSE_fnPolicyCreate,
+                                      path ) )
+    {
+        fprintf( stderr, "Failed to apply policy %s\n", path );
+    }
+}
+
 /*============================================================================*/
 /*!
 
     uniform distribution
 
+@param[in,out]
+    pSeed
+        state of the generator of the calling server
+
 @param[in]
     rangeLow
         giving the low range value
@@ -526,9 +760,11 @@ static void service_fnQueryStatic( DPRM_HANDLE hDPRM,
 
 */
 /*============================================================================*/
-static int uniform_distribution(int rangeLow, int rangeHigh)
+static int uniform_distribution( unsigned int *pSeed,
+                                 int rangeLow,
+                                 int rangeHigh )
 {
-    double myRand = rand()/(1.0 + RAND_MAX);
+    double myRand = rand_r( pSeed )/(1.0 + RAND_MAX);
 
     int range = rangeHigh - rangeLow + 1;
 
@@ -0,0 +1,678 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+MiniCloud Project. List all data points in target system.
+
+==============================================================================*/
+
+/*!
+ * @file writer.c
+ * @brief Asynchronous writer of the simulator result files
+ *
+ * @addtogroup writer result files written off the measured threads
+ * @brief asynchronous CSV writer
+ *
+ *  The ring is a bounded multi-producer queue: every slot has a sequence
+ *  number.  A producer claims the slot of the tail position by moving the
+ *  tail on with a compare and swap, fills it and sets its sequence to one
+ *  past the position, which publishes it to the writer.  The writer
+ *  empties the slot and sets its sequence to the position of the next lap.
+ *  A producer finding the ring full yields until the writer frees a slot,
+ *  the results are not dropped.
+ *
+ */
+
+ /*! @{ */
+/*==============================================================================
+                              Includes
+==============================================================================*/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "writer.h"
+
+/*==============================================================================
+                                Defines
+==============================================================================*/
+/*! most values of a percentile record: the minimum, the percentiles and the
+ *  maximum */
+#define WRITER_MAX_VALUES    ( 8 )
+
+/*==============================================================================
+                                Enums
+==============================================================================*/
+
+/*! kinds of records */
+typedef enum eRecordType
+{
+    /*! number of objects of an epoch, NormalDist.csv */
+    eRecordEpoch = 0,
+
+    /*! cycle sum of an epoch, CycleSums.csv */
+    eRecordCycleSum,
+
+    /*! overall mean and its confidence interval, the steady state file */
+    eRecordSteadyState,
+
+    /*! intended and actual release of an epoch, Arrivals.csv */
+    eRecordArrival,
+
+    /*! percentiles of a latency, Percentiles.csv */
+    eRecordPercentile
+
+} teRecordType;
+
+/*==============================================================================
+                              Structures
+==============================================================================*/
+
+/*! result of a measuring thread */
+typedef struct zRecord
+{
+    /*! file of the record */
+    FILE* fp;
+
+    /*! kind of the record, selects its fields */
+    teRecordType type;
+
+    /*! epoch, cycle or last epoch of a window */
+    int epoch;
+
+    /*! number of objects */
+    int objects;
+
+    /*! number of values, percentile record */
+    int numValues;
+
+    /*! number of samples, percentile record */
+    uint64_t count;
+
+    /*! name of the latency, a constant string */
+    const char* latency;
+
+    /*! label of the window, percentile record */
+    char window[ 16 ];
+
+    /*! values of the record */
+    double values[ WRITER_MAX_VALUES ];
+
+} tzRecord;
+
+/*! slot of the ring */
+typedef struct zSlot
+{
+    /*! position the slot is free for, or one past the position it holds */
+    uint64_t seq;
+
+    /*! the record */
+    tzRecord record;
+
+} tzSlot;
+
+/*==============================================================================
+                           Local/Private Variables
+==============================================================================*/
+
+/*! the ring */
+static tzSlot ring[ WRITER_RING_SIZE ];
+
+/*! position of the next record to add */
+static uint64_t tail = 0;
+
+/*! position of the next record to write, property of the writer thread */
+static uint64_t head = 0;
+
+/*! the writer thread */
+static pthread_t writerThread;
+
+/*! the writer thread is running */
+static bool running = false;
+
+/*! the writer thread empties the ring and ends */
+static bool stopping = false;
+
+/*! times a producer found the ring full */
+static uint64_t stalls = 0;
+
+/*! files written since they were last flushed */
+static FILE* dirtyFiles[ WRITER_MAX_FILES ];
+
+/*! number of dirtyFiles */
+static int numDirty = 0;
+
+/*==============================================================================
+                        Local/Private Function Prototypes
+==============================================================================*/
+static void writer_fnAdd( const tzRecord* pRecord );
+static void* writer_fnThread( void* arg );
+static int writer_fnDrain( void );
+static void writer_fnFormat( const tzRecord* pRecord );
+static void writer_fnFlush( void );
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*!
+    Give a result file a large buffer
+
+    Call it after the file is opened, before anything is written to it.
+
+@param[in]
+    fp
+        the file
+
+@retval EOK or errno.h upon any errors
+
+*/
+/*============================================================================*/
+int WRITER_fnBuffer( FILE* fp )
+{
+    int ret = EINVAL;
+
+    if( NULL != fp )
+    {
+        ret = ( 0 == setvbuf( fp, NULL, _IOFBF, WRITER_BUFFER_SIZE ) ) ?
+              EOK : ENOMEM;
+    }
+
+    return( ret );
+}
+
+/*============================================================================*/
+/*!
+    Start the writer thread
+
+    Call it before the measuring threads add records.
+
+@retval EOK or errno.h upon any errors
+
+*/
+/*============================================================================*/
+int WRITER_fnStart( void )
+{
+    int ret = EOK;
+    uint64_t i;
+
+    if( !running )
+    {
+        for( i = 0; i < WRITER_RING_SIZE; i++ )
+        {
+            ring[ i ].seq = i;
+        }
+        tail = 0;
+        head = 0;
+        stopping = false;
+
+        ret = pthread_create( &writerThread, NULL, &writer_fnThread, NULL );
+        running = ( EOK == ret );
+    }
+
+    return( ret );
+}
+
+/*============================================================================*/
+/*!
+    Stop the writer thread
+
+    Call it once the measuring threads have ended.  The records in the ring
+    are written and the result files flushed before it returns.
+
+*/
+/*============================================================================*/
+void WRITER_fnStop( void )
+{
+    if( running )
+    {
+        __atomic_store_n( &stopping, true, __ATOMIC_RELEASE );
+        pthread_join( writerThread, NULL );
+        running = false;
+
+        if( 0 != stalls )
+        {
+            fprintf(stderr,
+                    "result writer: ring full %" PRIu64 " times\n",
+                    stalls );
+        }
+    }
+}
+
+/*============================================================================*/
+/*!
+    Record the number of objects of an epoch
+
+@param[in]
+    fp
+        the file
+
+@param[in]
+    epoch
+        the epoch
+
+@param[in]
+    objects
+        number of objects arrived
+
+*/
+/*============================================================================*/
+void WRITER_fnEpoch( FILE* fp, int epoch, int objects )
+{
+    tzRecord record;
+
+    record.fp = fp;
+    record.type = eRecordEpoch;
+    record.epoch = epoch;
+    record.objects = objects;
+    writer_fnAdd( &record );
+}
+
+/*============================================================================*/
+/*!
+    Record the cycle sum of an epoch
+
+@param[in]
+    fp
+        the file
+
+@param[in]
+    cycle
+        the cycle
+
+@param[in]
+    sum
+        the cycle sum in ms
+
+*/
+/*============================================================================*/
+void WRITER_fnCycleSum( FILE* fp, int cycle, float sum )
+{
+    tzRecord record;
+
+    record.fp = fp;
+    record.type = eRecordCycleSum;
+    record.epoch = cycle;
+    record.values[ 0 ] = sum;
+    writer_fnAdd( &record );
+}
+
+/*============================================================================*/
+/*!
+    Record the overall mean and its confidence interval
+
+@param[in]
+    fp
+        the file
+
+@param[in]
+    epoch
+        the epoch
+
+@param[in]
+    mean
+        the overall mean
+
+@param[in]
+    confidence
+        the confidence interval
+
+*/
+/*============================================================================*/
+void WRITER_fnSteadyState( FILE* fp,
+                           int epoch,
+                           float mean,
+                           float confidence )
+{
+    tzRecord record;
+
+    record.fp = fp;
+    record.type = eRecordSteadyState;
+    record.epoch = epoch;
+    record.values[ 0 ] = mean;
+    record.values[ 1 ] = confidence;
+    writer_fnAdd( &record );
+}
+
+/*============================================================================*/
+/*!
+    Record the intended and actual release of an epoch
+
+@param[in]
+    fp
+        the file
+
+@param[in]
+    epoch
+        the epoch
+
+@param[in]
+    objects
+        number of objects of the epoch
+
+@param[in]
+    intended
+        intended release in us
+
+@param[in]
+    actual
+        actual release in us
+
+@param[in]
+    lag
+        schedule lag in us
+
+*/
+/*============================================================================*/
+void WRITER_fnArrival( FILE* fp,
+                       int epoch,
+                       int objects,
+                       double intended,
+                       double actual,
+                       double lag )
+{
+    tzRecord record;
+
+    record.fp = fp;
+    record.type = eRecordArrival;
+    record.epoch = epoch;
+    record.objects = objects;
+    record.values[ 0 ] = intended;
+    record.values[ 1 ] = actual;
+    record.values[ 2 ] = lag;
+    writer_fnAdd( &record );
+}
+
+/*============================================================================*/
+/*!
+    Record the percentiles of a latency
+
+@param[in]
+    fp
+        the file
+
+@param[in]
+    window
+        label of the window
+
+@param[in]
+    lastEpoch
+        last epoch of the window
+
+@param[in]
+    latency
+        name of the latency, a constant string
+
+@param[in]
+    count
+        number of samples
+
+@param[in]
+    pValues
+        the minimum, the percentiles and the maximum in ms
+
+@param[in]
+    numValues
+        number of values, at most WRITER_MAX_VALUES
+
+*/
+/*============================================================================*/
+void WRITER_fnPercentile( FILE* fp,
+                          const char* window,
+                          int lastEpoch,
+                          const char* latency,
+                          uint64_t count,
+                          const double* pValues,
+                          int numValues )
+{
+    tzRecord record;
+
+    record.fp = fp;
+    record.type = eRecordPercentile;
+    record.epoch = lastEpoch;
+    record.latency = latency;
+    record.count = count;
+    record.numValues = ( numValues > WRITER_MAX_VALUES ) ?
+                       WRITER_MAX_VALUES : numValues;
+    snprintf( record.window, sizeof( record.window ), "%s", window );
+    memcpy( record.values, pValues, record.numValues * sizeof( double ) );
+    writer_fnAdd( &record );
+}
+
+/*============================================================================*/
+/*!
+    Add a record to the ring
+
+    Any number of threads add records at once, without a lock.
+
+@param[in]
+    pRecord
+        the record
+
+*/
+/*============================================================================*/
+static void writer_fnAdd( const tzRecord* pRecord )
+{
+    tzSlot* pSlot;
+    uint64_t pos = __atomic_load_n( &tail, __ATOMIC_RELAXED );
+    uint64_t seq;
+
+    while( true )
+    {
+        pSlot = &ring[ pos & ( WRITER_RING_SIZE - 1 ) ];
+        seq = __atomic_load_n( &pSlot->seq, __ATOMIC_ACQUIRE );
+
+        if( seq == pos )
+        {
+            /* the slot is free, claim it */
+            if( __atomic_compare_exchange_n( &tail,
+                                             &pos,
+                                             pos + 1,
+                                             true,
+                                             __ATOMIC_RELAXED,
+                                             __ATOMIC_RELAXED ) )
+            {
+                break;
+            }
+        }
+        else if( seq < pos )
+        {
+            /* the writer has not emptied the slot of the last lap */
+            __atomic_add_fetch( &stalls, 1, __ATOMIC_RELAXED );
+            sched_yield( );
+            pos = __atomic_load_n( &tail, __ATOMIC_RELAXED );
+        }
+        else
+        {
+            /* another producer took the position */
+            pos = __atomic_load_n( &tail, __ATOMIC_RELAXED );
+        }
+    }
+
+    pSlot->record = *pRecord;
+    __atomic_store_n( &pSlot->seq, pos + 1, __ATOMIC_RELEASE );
+}
+
+/*============================================================================*/
+/*!
+    this is the writer thread
+
+@param[in]
+    arg
+        unused
+
+@retval - NULL
+
+*/
+/*============================================================================*/
+static void* writer_fnThread( void* arg )
+{
+    struct timespec poll = { 0, WRITER_POLL_MS * 1000000L };
+    struct timespec now;
+    struct timespec flushed;
+    long elapsed;
+
+    (void)arg;
+    clock_gettime( CLOCK_MONOTONIC, &flushed );
+
+    while( true )
+    {
+        if( 0 == writer_fnDrain( ) )
+        {
+            /* the producers are done once stopping is set, a last drain
+             * takes their records */
+            if( __atomic_load_n( &stopping, __ATOMIC_ACQUIRE ) )
+            {
+                writer_fnDrain( );
+                break;
+            }
+
+            clock_gettime( CLOCK_MONOTONIC, &now );
+            elapsed = ( now.tv_sec - flushed.tv_sec ) * 1000L +
+                      ( now.tv_nsec - flushed.tv_nsec ) / 1000000L;
+            if( elapsed >= WRITER_FLUSH_MS )
+            {
+                writer_fnFlush( );
+                flushed = now;
+            }
+
+            nanosleep( &poll, NULL );
+        }
+    }
+
+    writer_fnFlush( );
+
+    return( NULL );
+}
+
+/*============================================================================*/
+/*!
+    Write the records of the ring
+
+@return
+    number of records written
+
+*/
+/*============================================================================*/
+static int writer_fnDrain( void )
+{
+    tzSlot* pSlot;
+    int num = 0;
+
+    while( true )
+    {
+        pSlot = &ring[ head & ( WRITER_RING_SIZE - 1 ) ];
+        if( ( head + 1 ) != __atomic_load_n( &pSlot->seq, __ATOMIC_ACQUIRE ) )
+        {
+            break;
+        }
+
+        writer_fnFormat( &pSlot->record );
+
+        /* the slot is free for the next lap */
+        __atomic_store_n( &pSlot->seq,
+                          head + WRITER_RING_SIZE,
+                          __ATOMIC_RELEASE );
+        head++;
+        num++;
+    }
+
+    return( num );
+}
+
+/*============================================================================*/
+/*!
+    Format a record in its file
+
+@param[in]
+    pRecord
+        the record
+
+*/
+/*============================================================================*/
+static void writer_fnFormat( const tzRecord* pRecord )
+{
+    FILE* fp = pRecord->fp;
+    int i;
+
+    switch( pRecord->type )
+    {
+    case eRecordEpoch:
+        fprintf( fp, "%d,%d\n", pRecord->epoch, pRecord->objects );
+        break;
+
+    case eRecordCycleSum:
+        fprintf( fp, "%d,%0.4f\n", pRecord->epoch, pRecord->values[ 0 ] );
+        break;
+
+    case eRecordSteadyState:
+        fprintf( fp, "%d,%0.2f,%0.2f\n",
+                 pRecord->epoch,
+                 pRecord->values[ 0 ],
+                 pRecord->values[ 1 ] );
+        break;
+
+    case eRecordArrival:
+        fprintf( fp, "%d,%d,%.3f,%.3f,%.3f\n",
+                 pRecord->epoch,
+                 pRecord->objects,
+                 pRecord->values[ 0 ],
+                 pRecord->values[ 1 ],
+                 pRecord->values[ 2 ] );
+        break;
+
+    case eRecordPercentile:
+        fprintf( fp, "%s,%d,%s,%" PRIu64,
+                 pRecord->window,
+                 pRecord->epoch,
+                 pRecord->latency,
+                 pRecord->count );
+        for( i = 0; i < pRecord->numValues; i++ )
+        {
+            fprintf( fp, ",%.4f", pRecord->values[ i ] );
+        }
+        fprintf( fp, "\n" );
+        break;
+
+    default:
+        return;
+    }
+
+    /* remember the file for the next flush */
+    for( i = 0; ( i < numDirty ) && ( dirtyFiles[ i ] != fp ); i++ )
+    {
+    }
+    if( ( i == numDirty ) && ( numDirty < WRITER_MAX_FILES ) )
+    {
+        dirtyFiles[ numDirty++ ] = fp;
+    }
+}
+
+/*============================================================================*/
+/*!
+    Flush the files written since the last flush
+
+*/
+/*============================================================================*/
+static void writer_fnFlush( void )
+{
+    int i;
+
+    for( i = 0; i < numDirty; i++ )
+    {
+        fflush( dirtyFiles[ i ] );
+    }
+    numDirty = 0;
+}
+
+/*! @} */
+
+//EoF
@@ -37,12 +37,21 @@ Policy implementation
 #include <syslog.h>
 #include <ctype.h>
 #include <sys/mman.h>
+#include <sys/syspage.h>
+#include <pthread.h>
+#include <sched.h>
 #include "minicloudmsg.h"
+#include "policymsg.h"
 
 /*==============================================================================
                               Defines
 ==============================================================================*/
 
+/*! maximum number of connections with a policy check ring */
+#define POLICY_RING_MAX_CONNECTIONS  ( 16 )
+
+/*! prefix of the shared memory object names of the rings */
+#define POLICY_RING_NAME_PREFIX      "/dynpolac.ring"
 
 /*==============================================================================
                                Macros
@@ -81,9 +90,60 @@ typedef struct zDPRM
     int shmem_fd;
 } tzDPRM;
 
+/*! policy check ring of a connection, the tzDPRM is allocated by the
+ *  Data Point Resource Manager library so the rings are kept aside */
+typedef struct zPolicyRingConnection
+{
+    /*! connection the ring belongs to, NULL if the entry is free */
+    tzDPRM *ptzDPRM;
+
+    /*! mapping of the ring */
+    tzPolicyRing *pRing;
+
+    /*! size of the mapping */
+    size_t size;
+
+    /*! checks running on the ring, the ring is unmapped once none is */
+    uint32_t inFlight;
+
+} tzPolicyRingConnection;
+
+/*==============================================================================
+                        Local/Private Variables
+==============================================================================*/
+
+/*! policy check rings of the connections, looked up without a lock */
+static tzPolicyRingConnection ringConnections[ POLICY_RING_MAX_CONNECTIONS ];
+
+/*! serializes the ring opens and closes */
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*! number of rings created by the process, makes the ring names unique */
+static uint32_t ringCount = 0;
+
 /*==============================================================================
                         Local/Private Function Prototypes
 ==============================================================================*/
+static int policy_fnSend( tzDPRM *ptzDPRM,
+                          tzPOLICY *pPolicy,
+                          char *pUsers,
+                          char *pGroups,
+                          tzPolicyProgram *pProgram );
+static int policy_fnHousekeepRequest( tzDPRM *ptzDPRM,
+                                      int name,
+                                      int max,
+                                      const void *pPayload,
+                                      size_t payloadLen );
+static int policy_fnHousekeepReply( tzDPRM *ptzDPRM,
+                                    int name,
+                                    int max,
+                                    const void *pPayload,
+                                    size_t payloadLen,
+                                    iov_t *pReply,
+                                    int numReply );
+static tzPolicyRingConnection* policy_fnRingAcquire( tzDPRM *ptzDPRM );
+static int policy_fnRingCheck( tzPolicyRing *pRing,
+                               const tzPolicyCheckRequest *pRequest );
 
 /*==============================================================================
                         Function Definitions
@@ -111,7 +171,150 @@ typedef struct zDPRM
 /*============================================================================*/
 int DP_fnRegisterPolicy( DPRM_HANDLE dprm_handle, tzPOLICY *pPolicy )
 {
-    tzDPRM *ptzDPRM = (tzDPRM *)dprm_handle;
+    return policy_fnSend( (tzDPRM *)dprm_handle, pPolicy, NULL, NULL, NULL );
+}
+
+/*============================================================================*/
+//fn  DP_fnRegisterPolicySubjects
+/*!
+
+    Add or modify the policy information with user and group sets
+
+    The user and group codes in the policy structure are ignored, instead the
+    comma separated user and group name lists are sent to the server which
+    interns each name and stores the rule subjects as bit sets.
+    An empty list is a wild card.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pPolicy
+        pointer to the policy data structure
+
+@param[in]
+    pUsers
+        comma separated list of user names, e.g. "bob,gus"
+
+@param[in]
+    pGroups
+        comma separated list of group names, e.g. "manager,technician"
+
+@return
+    EOK : The policy was registered successfully
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnRegisterPolicySubjects( DPRM_HANDLE dprm_handle,
+                                 tzPOLICY *pPolicy,
+                                 char *pUsers,
+                                 char *pGroups )
+{
+    return policy_fnSend( (tzDPRM *)dprm_handle,
+                          pPolicy,
+                          ( NULL != pUsers ) ? pUsers : "",
+                          ( NULL != pGroups ) ? pGroups : "",
+                          NULL );
+}
+
+/*============================================================================*/
+//fn  DP_fnRegisterPolicyProgram
+/*!
+
+    Add or modify the policy information with user and group sets and a
+    condition program
+
+    Like DP_fnRegisterPolicySubjects, and the compiled condition of the rule
+    is sent after the subject lists.  The server validates the program and
+    runs it after the attribute checks of the rule have passed.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pPolicy
+        pointer to the policy data structure
+
+@param[in]
+    pUsers
+        comma separated list of user names, e.g. "bob,gus"
+
+@param[in]
+    pGroups
+        comma separated list of group names, e.g. "manager,technician"
+
+@param[in]
+    pProgram
+        compiled condition, NULL or an empty program if the rule has none
+
+@return
+    EOK : The policy was registered successfully
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnRegisterPolicyProgram( DPRM_HANDLE dprm_handle,
+                                tzPOLICY *pPolicy,
+                                char *pUsers,
+                                char *pGroups,
+                                tzPolicyProgram *pProgram )
+{
+    if( ( NULL != pProgram ) && ( 0 == pProgram->numCode ) )
+    {
+        pProgram = NULL;
+    }
+
+    return policy_fnSend( (tzDPRM *)dprm_handle,
+                          pPolicy,
+                          ( NULL != pUsers ) ? pUsers : "",
+                          ( NULL != pGroups ) ? pGroups : "",
+                          pProgram );
+}
+
+/*============================================================================*/
+/*!
+
+    Send the policy registration message to the server
+
+    strings are being sent separately since their length are dynamic, the
+    location is always sent and the subject lists follow it only when they
+    are specified.
+
+@param[in]
+    ptzDPRM
+        Data Point Resource Manager
+
+@param[in]
+    pPolicy
+        pointer to the policy data structure
+
+@param[in]
+    pUsers
+        comma separated list of user names or NULL to send the user code
+
+@param[in]
+    pGroups
+        comma separated list of group names or NULL to send the group code
+
+@param[in]
+    pProgram
+        condition program sent after the subject lists, or NULL
+
+@return
+    EOK : The policy was registered successfully
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+static int policy_fnSend( tzDPRM *ptzDPRM,
+                          tzPOLICY *pPolicy,
+                          char *pUsers,
+                          char *pGroups,
+                          tzPolicyProgram *pProgram )
+{
     int ret = EINVAL;
     datapoint_policy_msg_t msg;
 
@@ -120,7 +323,7 @@ int DP_fnRegisterPolicy( DPRM_HANDLE dprm_handle, tzPOLICY *pPolicy )
     char pLocation[256] = "\0"; //  physical location of IoT variables
 
     int numIOV = 2;
-    iov_t iov[numIOV];
+    iov_t iov[5];
 
     if( (NULL != ptzDPRM) && (NULL != pPolicy) )
     {
@@ -152,12 +355,33 @@ int DP_fnRegisterPolicy( DPRM_HANDLE dprm_handle, tzPOLICY *pPolicy )
 		msg.group = pPolicy->group;
 
 		/* strings are being sent separately since their length are dynamic */
-		strncpy(pLocation, pPolicy->Location, strlen(pPolicy->Location) + 1 );
+		strncpy( pLocation, pPolicy->Location, sizeof(pLocation) - 1 );
 
 		/* Send the data to the server and get a reply */
 		SETIOV (iov + 0, &msg, sizeof (msg));
 		SETIOV (iov + 1, pLocation, strlen(pLocation)+1);
 
+		if( ( NULL != pUsers ) && ( NULL != pGroups ) )
+		{
+			/* the subject lists follow the location */
+			msg.user  = POLICY_SUBJECT_LIST;
+			msg.group = POLICY_SUBJECT_LIST;
+
+			SETIOV (iov + 2, pUsers, strlen(pUsers)+1);
+			SETIOV (iov + 3, pGroups, strlen(pGroups)+1);
+			numIOV = 4;
+
+			if( NULL != pProgram )
+			{
+				/* the condition program follows the subject lists */
+				pProgram->magic = POLICY_PROGRAM_MAGIC;
+				msg.group = POLICY_SUBJECT_PROGRAM;
+
+				SETIOV (iov + 4, pProgram, sizeof(tzPolicyProgram));
+				numIOV = 5;
+			}
+		}
+
 		ret = MsgSendv( ptzDPRM->handle, iov, numIOV, NULL, 0);
 		if( ret == -1 )
 		{
@@ -193,12 +417,397 @@ int DP_fnRegisterPolicy( DPRM_HANDLE dprm_handle, tzPOLICY *pPolicy )
 /*============================================================================*/
 int DP_fnPolicyHousekeeping( DPRM_HANDLE dprm_handle )
 {
-    tzDPRM *ptzDPRM = (tzDPRM *)dprm_handle;
+    return policy_fnHousekeepRequest( (tzDPRM *)dprm_handle, 0, 0, NULL, 0 );
+}
+
+/*============================================================================*/
+/*!
+
+    message to the server to ask to load a policy rule set compiled to
+    native code.  The server swaps it in atomically, it decides the checks
+    until the next policy housekeeping.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pPath
+        path of the shared object on the server
+
+@return
+    EOK : The native rule set was loaded successfully
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicyLoadNative( DPRM_HANDLE dprm_handle, const char *pPath )
+{
+    if( NULL == pPath )
+    {
+        return EINVAL;
+    }
+
+    return policy_fnHousekeepRequest( (tzDPRM *)dprm_handle,
+                                      POLICY_HOUSEKEEP_LOAD_NATIVE,
+                                      0,
+                                      pPath,
+                                      strlen( pPath ) + 1 );
+}
+
+/*============================================================================*/
+/*!
+
+    message to the server to ask to benchmark its policy check engines on
+    the committed rules.  The results are printed by the server.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    iterations
+        number of passes over the rules per engine
+
+@return
+    EOK : The engines made the same decisions
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicyBenchmark( DPRM_HANDLE dprm_handle, int iterations )
+{
+    return policy_fnHousekeepRequest( (tzDPRM *)dprm_handle,
+                                      POLICY_HOUSEKEEP_BENCHMARK,
+                                      iterations,
+                                      NULL,
+                                      0 );
+}
+
+/*============================================================================*/
+/*!
+
+    message to the server to ask to select the engine of its policy checks.
+    The rules do not change, the engine decides the checks from the next one.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    engine
+        POLICY_ENGINE_ID_HASH, POLICY_ENGINE_ID_DD or POLICY_ENGINE_ID_NATIVE
+
+@return
+    EOK : The engine was selected
+    EINVAL : The engine is unknown
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicySelectEngine( DPRM_HANDLE dprm_handle, int engine )
+{
+    return policy_fnHousekeepRequest( (tzDPRM *)dprm_handle,
+                                      POLICY_HOUSEKEEP_SELECT_ENGINE,
+                                      engine,
+                                      NULL,
+                                      0 );
+}
+
+/*============================================================================*/
+/*!
+
+    message to the server to ask to save a snapshot of its data points and
+    rules.  A server restarted with the snapshot loads it instead of the
+    data point and policy files, then replays the changes made since.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@return
+    EOK : The snapshot was saved
+    ENOTSUP : The server was not started with a snapshot
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicySnapshot( DPRM_HANDLE dprm_handle )
+{
+    return policy_fnHousekeepRequest( (tzDPRM *)dprm_handle,
+                                      POLICY_HOUSEKEEP_SNAPSHOT,
+                                      0,
+                                      NULL,
+                                      0 );
+}
+
+/*============================================================================*/
+/*!
+
+    message to the server to ask for the fingerprints of the committed
+    rules.  A client compares them with its rule set to send only the rules
+    which changed, see DP_fnPolicyDeltaCommit.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[out]
+    pFingerprints
+        array receiving the fingerprints
+
+@param[in]
+    maxFingerprints
+        number of fingerprints the array holds
+
+@param[out]
+    pNumFingerprints
+        number of rules committed on the server
+
+@return
+    EOK : The fingerprints were received
+    EOVERFLOW : The server has more than maxFingerprints rules, the first
+                maxFingerprints were received
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicyFingerprints( DPRM_HANDLE dprm_handle,
+                             tzPolicyFingerprint *pFingerprints,
+                             uint32_t maxFingerprints,
+                             uint32_t *pNumFingerprints )
+{
+    tzPolicyFingerprintHeader header;
+    iov_t reply[2];
+    int ret;
+
+    if( ( NULL == pFingerprints ) || ( NULL == pNumFingerprints ) )
+    {
+        return EINVAL;
+    }
+
+    memset( &header, 0, sizeof(header) );
+    SETIOV (reply + 0, &header, sizeof(header));
+    SETIOV (reply + 1, pFingerprints,
+            maxFingerprints * sizeof(tzPolicyFingerprint));
+
+    ret = policy_fnHousekeepReply( (tzDPRM *)dprm_handle,
+                                   POLICY_HOUSEKEEP_FINGERPRINTS,
+                                   0,
+                                   NULL,
+                                   0,
+                                   reply,
+                                   2 );
+    if( EOK == ret )
+    {
+        *pNumFingerprints = header.numRules;
+        if( header.numRules > maxFingerprints )
+        {
+            ret = EOVERFLOW;
+        }
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    message to the server to commit the rules registered since the last
+    commit and remove the listed ones.  Unlike DP_fnPolicyHousekeeping the
+    rules which were not registered again are kept.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pRemove
+        keys of the rules to remove, see POLICYDELTA_fnKey
+
+@param[in]
+    numRemove
+        number of keys
+
+@return
+    EOK : The rules were committed
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicyDeltaCommit( DPRM_HANDLE dprm_handle,
+                            const uint64_t *pRemove,
+                            uint32_t numRemove )
+{
+    if( ( numRemove > POLICY_DELTA_MAX_RULES ) ||
+        ( ( 0u != numRemove ) && ( NULL == pRemove ) ) )
+    {
+        return EINVAL;
+    }
+
+    return policy_fnHousekeepRequest( (tzDPRM *)dprm_handle,
+                                      POLICY_HOUSEKEEP_DELTA_COMMIT,
+                                      (int)numRemove,
+                                      ( 0u != numRemove ) ? pRemove : NULL,
+                                      numRemove * sizeof(uint64_t) );
+}
+
+/*============================================================================*/
+/*!
+
+    Create the data points of a batch on the server
+
+    The batch is sent in one message and the server creates its data
+    points with their aliases, tags and meta data in one pass.  The batch
+    is left as it is, the caller clears it.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pBulk
+        the data points, see DP_fnBulkAdd
+
+@param[out]
+    pResults
+        result of each data point, in the order of the batch: EOK, or an
+        errno such as EEXIST when the data point already exists
+
+@return
+    EOK : The batch was handled, pResults holds the result of each point
+    ENOSYS : The server cannot create data points in bulk
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnRegisterBulk( DPRM_HANDLE dprm_handle,
+                       tzDpBulk *pBulk,
+                       int32_t *pResults )
+{
+    iov_t reply[1];
+
+    if( ( NULL == pBulk ) || ( NULL == pResults ) ||
+        ( pBulk->numPoints > DP_BULK_MAX_POINTS ) ||
+        ( pBulk->length > DP_BULK_MAX_LENGTH ) )
+    {
+        return EINVAL;
+    }
+
+    if( 0u == pBulk->numPoints )
+    {
+        return EOK;
+    }
+
+    SETIOV (reply + 0, pResults, pBulk->numPoints * sizeof(int32_t));
+
+    return policy_fnHousekeepReply( (tzDPRM *)dprm_handle,
+                                    POLICY_HOUSEKEEP_DP_BULK,
+                                    (int)pBulk->length,
+                                    pBulk->pBuf,
+                                    pBulk->length,
+                                    reply,
+                                    1 );
+}
+
+/*============================================================================*/
+/*!
+
+    Send a housekeeping message to the server
+
+@param[in]
+    ptzDPRM
+        pointer to the DPRM connection
+
+@param[in]
+    name
+        0 for the policy housekeeping or one of the POLICY_HOUSEKEEP_ requests
+
+@param[in]
+    max
+        argument of the request
+
+@param[in]
+    pPayload
+        payload sent after the message, or NULL
+
+@param[in]
+    payloadLen
+        length of the payload
+
+@return
+    EOK : The request was handled successfully
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+static int policy_fnHousekeepRequest( tzDPRM *ptzDPRM,
+                                      int name,
+                                      int max,
+                                      const void *pPayload,
+                                      size_t payloadLen )
+{
+    return policy_fnHousekeepReply( ptzDPRM,
+                                    name,
+                                    max,
+                                    pPayload,
+                                    payloadLen,
+                                    NULL,
+                                    0 );
+}
+
+/*============================================================================*/
+/*!
+
+    Send a housekeeping message to the server and receive its reply
+
+@param[in]
+    ptzDPRM
+        pointer to the DPRM connection
+
+@param[in]
+    name
+        0 for the policy housekeeping or one of the POLICY_HOUSEKEEP_ requests
+
+@param[in]
+    max
+        argument of the request
+
+@param[in]
+    pPayload
+        payload sent after the message, or NULL
+
+@param[in]
+    payloadLen
+        length of the payload
+
+@param[out]
+    pReply
+        vectors receiving the reply, or NULL
+
+@param[in]
+    numReply
+        number of reply vectors
+
+@return
+    EOK : The request was handled successfully
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+static int policy_fnHousekeepReply( tzDPRM *ptzDPRM,
+                                    int name,
+                                    int max,
+                                    const void *pPayload,
+                                    size_t payloadLen,
+                                    iov_t *pReply,
+                                    int numReply )
+{
     int ret = EINVAL;
     datapoint_policy_msg_t msg;
 
     int numIOV = 1;
-    iov_t iov[numIOV];
+    iov_t iov[2];
 
     if( NULL != ptzDPRM)
     {
@@ -210,14 +819,25 @@ int DP_fnPolicyHousekeeping( DPRM_HANDLE dprm_handle )
 
 		/* Set up the message code to send to the server */
 		msg.code = MSG_DP_POLICY_HOUSEKEEPING;
+		msg.Name = name;
+		msg.max  = max;
 
 		/* Send the data to the server and get a reply */
 		SETIOV (iov + 0, &msg, sizeof (msg));
 
-		ret = MsgSendv( ptzDPRM->handle, iov, numIOV, NULL, 0);
+		if( NULL != pPayload )
+		{
+			SETIOV (iov + 1, pPayload, payloadLen);
+			numIOV = 2;
+		}
+
+		ret = MsgSendv( ptzDPRM->handle, iov, numIOV, pReply, numReply );
 		if( ret == -1 )
 		{
-			if( errno != EEXIST )
+			/* a denied policy check is not an error, a server without a
+			 * data point store is left to the caller to fall back */
+			if( ( errno != EEXIST ) && ( errno != EACCES ) &&
+			    ( errno != ENOSYS ) )
 			{
 				fprintf( stderr,
 						 "%s: %s\n",
@@ -231,5 +851,418 @@ int DP_fnPolicyHousekeeping( DPRM_HANDLE dprm_handle )
     return ret;
 }
 
+/*============================================================================*/
+/*!
+
+    Open a policy check ring to the server
+
+    The ring is created in a shared memory object and attached by the
+    server, DP_fnPolicyCheck then posts the checks of the connection on the
+    ring instead of sending them.  The ring must be closed with
+    DP_fnPolicyRingClose before the connection is closed.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    numSlots
+        number of slots of the ring, a power of two, 0 for the default
+
+@return
+    EOK : The ring is attached by the server
+    EEXIST : The connection already has a ring
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicyRingOpen( DPRM_HANDLE dprm_handle, uint32_t numSlots )
+{
+    tzDPRM *ptzDPRM = (tzDPRM *)dprm_handle;
+    tzPolicyRingConnection *pConnection = NULL;
+    tzPolicyRing *pRing = NULL;
+    pthread_mutexattr_t mutexAttr;
+    pthread_condattr_t condAttr;
+    char name[ POLICY_RING_NAME_LENGTH ];
+    size_t size;
+    uint32_t spin;
+    uint32_t i;
+    int fd;
+    int ret = EOK;
+
+    if( 0u == numSlots )
+    {
+        numSlots = POLICY_RING_SLOTS;
+    }
+
+    if( ( NULL == ptzDPRM ) ||
+        ( numSlots < 4u ) ||
+        ( 0u != ( numSlots & ( numSlots - 1u ) ) ) )
+    {
+        return EINVAL;
+    }
+
+    pthread_mutex_lock( &ringLock );
+
+    for( i = 0; i < POLICY_RING_MAX_CONNECTIONS; i++ )
+    {
+        if( ptzDPRM == ringConnections[i].ptzDPRM )
+        {
+            ret = EEXIST;
+            break;
+        }
+        if( ( NULL == pConnection ) && ( NULL == ringConnections[i].ptzDPRM ) )
+        {
+            pConnection = &ringConnections[i];
+        }
+    }
+
+    if( ( EOK == ret ) && ( NULL == pConnection ) )
+    {
+        ret = ENOSPC;
+    }
+
+    if( EOK == ret )
+    {
+        snprintf( name,
+                  sizeof(name),
+                  "%s.%d.%u",
+                  POLICY_RING_NAME_PREFIX,
+                  (int)getpid(),
+                  ++ringCount );
+
+        size = POLICYRING_fnSize( numSlots );
+
+        fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR );
+        if( -1 == fd )
+        {
+            ret = errno;
+        }
+        else
+        {
+            if( -1 == ftruncate( fd, (off_t)size ) )
+            {
+                ret = errno;
+            }
+            else
+            {
+                pRing = mmap( NULL,
+                              size,
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED,
+                              fd,
+                              0 );
+                if( MAP_FAILED == pRing )
+                {
+                    pRing = NULL;
+                    ret = errno;
+                }
+            }
+            close( fd );
+
+            if( NULL == pRing )
+            {
+                shm_unlink( name );
+            }
+        }
+    }
+
+    if( NULL != pRing )
+    {
+        /* the object is new and zero filled */
+        pthread_mutexattr_init( &mutexAttr );
+        pthread_mutexattr_setpshared( &mutexAttr, PTHREAD_PROCESS_SHARED );
+        pthread_mutexattr_setrobust( &mutexAttr, PTHREAD_MUTEX_ROBUST );
+        pthread_mutex_init( &pRing->lock, &mutexAttr );
+        pthread_mutexattr_destroy( &mutexAttr );
+
+        pthread_condattr_init( &condAttr );
+        pthread_condattr_setpshared( &condAttr, PTHREAD_PROCESS_SHARED );
+        pthread_condattr_setclock( &condAttr, CLOCK_MONOTONIC );
+        pthread_cond_init( &pRing->requestCond, &condAttr );
+        pthread_cond_init( &pRing->responseCond, &condAttr );
+        pthread_condattr_destroy( &condAttr );
+
+        pRing->numSlots = numSlots;
+        pRing->clientPid = (int32_t)getpid();
+        /* spinning only helps when the other side runs on another CPU */
+        spin = ( _syspage_ptr->num_cpu > 1 ) ? POLICY_RING_SPIN_DEFAULT : 0u;
+        pRing->clientSpin = spin;
+        pRing->serverSpin = spin;
+        for( i = 0; i < numSlots; i++ )
+        {
+            pRing->slots[i].seq = i;
+        }
+        __atomic_store_n( &pRing->magic, POLICY_RING_MAGIC, __ATOMIC_RELEASE );
+
+        ret = policy_fnHousekeepRequest( ptzDPRM,
+                                         POLICY_HOUSEKEEP_RING_ATTACH,
+                                         0,
+                                         name,
+                                         strlen( name ) + 1 );
+
+        /* the server holds its own mapping, the name is not needed */
+        shm_unlink( name );
+
+        if( EOK == ret )
+        {
+            pConnection->pRing = pRing;
+            pConnection->size = size;
+            __atomic_store_n( &pConnection->ptzDPRM,
+                              ptzDPRM,
+                              __ATOMIC_RELEASE );
+        }
+        else
+        {
+            munmap( pRing, size );
+        }
+    }
+
+    if( ( EOK != ret ) && ( EEXIST != ret ) && ( ENOSPC != ret ) &&
+        ( EINVAL != ret ) )
+    {
+        fprintf( stderr, "%s: %s\n", __func__, strerror( ret ) );
+    }
+
+    pthread_mutex_unlock( &ringLock );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Close the policy check ring of a connection
+
+    The serving thread of the server exits, the checks of the connection
+    are sent as messages again.  The checks running on the ring are woken
+    and send their check as a message, the ring is unmapped once the last
+    of them left it.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@return
+    EOK : The ring was closed
+    ENOENT : The connection has no ring
+
+*/
+/*============================================================================*/
+int DP_fnPolicyRingClose( DPRM_HANDLE dprm_handle )
+{
+    tzDPRM *ptzDPRM = (tzDPRM *)dprm_handle;
+    tzPolicyRing *pRing;
+    int ret = ENOENT;
+    int i;
+
+    pthread_mutex_lock( &ringLock );
+
+    for( i = 0; i < POLICY_RING_MAX_CONNECTIONS; i++ )
+    {
+        if( ( NULL != ptzDPRM ) && ( ptzDPRM == ringConnections[i].ptzDPRM ) )
+        {
+            pRing = ringConnections[i].pRing;
+
+            /* no new check finds the ring, see policy_fnRingAcquire */
+            __atomic_store_n( &ringConnections[i].ptzDPRM,
+                              NULL,
+                              __ATOMIC_SEQ_CST );
+
+            /* wake the server thread and the checks so they see the stop */
+            POLICYRING_fnLocked( pRing, pthread_mutex_lock( &pRing->lock ) );
+            __atomic_store_n( &pRing->stop, 1u, __ATOMIC_SEQ_CST );
+            pthread_cond_broadcast( &pRing->requestCond );
+            pthread_cond_broadcast( &pRing->responseCond );
+            pthread_mutex_unlock( &pRing->lock );
+
+            while( 0u != __atomic_load_n( &ringConnections[i].inFlight,
+                                          __ATOMIC_SEQ_CST ) )
+            {
+                sched_yield();
+            }
+
+            munmap( pRing, ringConnections[i].size );
+            ringConnections[i].pRing = NULL;
+            ret = EOK;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock( &ringLock );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Check a data point against the policy of the server
+
+    The check is posted on the ring of the connection if it has one,
+    otherwise it is sent in a housekeeping message.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pRequest
+        type, value, timestamp, location and subjects of the data point
+
+@return
+    EOK : The check passed
+    EACCES : The policy denied the data point
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicyCheck( DPRM_HANDLE dprm_handle,
+                      const tzPolicyCheckRequest *pRequest )
+{
+    tzDPRM *ptzDPRM = (tzDPRM *)dprm_handle;
+    tzPolicyRingConnection *pConnection;
+    int ret = EINVAL;
+
+    if( ( NULL != ptzDPRM ) && ( NULL != pRequest ) )
+    {
+        ret = ENOTCONN;
+        pConnection = policy_fnRingAcquire( ptzDPRM );
+        if( NULL != pConnection )
+        {
+            ret = policy_fnRingCheck( pConnection->pRing, pRequest );
+            __atomic_sub_fetch( &pConnection->inFlight, 1u, __ATOMIC_SEQ_CST );
+        }
+
+        if( ENOTCONN == ret )
+        {
+            ret = policy_fnHousekeepRequest( ptzDPRM,
+                                             POLICY_HOUSEKEEP_CHECK,
+                                             0,
+                                             pRequest,
+                                             sizeof(tzPolicyCheckRequest) );
+        }
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Find the policy check ring of a connection and count a check running
+    on it
+
+    The check is counted before the connection of the entry is checked
+    again, so either DP_fnPolicyRingClose sees the count and waits for the
+    check, or the check sees the entry closed.
+
+@param[in]
+    ptzDPRM
+        pointer to the DPRM connection
+
+@return
+    the ring entry whose inFlight count the caller must decrement once
+    done with the ring, NULL if the connection has none
+
+*/
+/*============================================================================*/
+static tzPolicyRingConnection* policy_fnRingAcquire( tzDPRM *ptzDPRM )
+{
+    tzPolicyRingConnection *pConnection;
+    int i;
+
+    for( i = 0; i < POLICY_RING_MAX_CONNECTIONS; i++ )
+    {
+        pConnection = &ringConnections[i];
+        if( ptzDPRM == __atomic_load_n( &pConnection->ptzDPRM,
+                                        __ATOMIC_ACQUIRE ) )
+        {
+            __atomic_add_fetch( &pConnection->inFlight, 1u, __ATOMIC_SEQ_CST );
+            if( ptzDPRM == __atomic_load_n( &pConnection->ptzDPRM,
+                                            __ATOMIC_SEQ_CST ) )
+            {
+                return pConnection;
+            }
+
+            /* closed meanwhile */
+            __atomic_sub_fetch( &pConnection->inFlight, 1u, __ATOMIC_SEQ_CST );
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*!
+
+    Post a policy check on a ring and wait for its response
+
+@param[in]
+    pRing
+        ring of the connection
+
+@param[in]
+    pRequest
+        check request
+
+@return
+    the response of the server, ENOTCONN if the ring was closed
+
+*/
+/*============================================================================*/
+static int policy_fnRingCheck( tzPolicyRing *pRing,
+                               const tzPolicyCheckRequest *pRequest )
+{
+    tzPolicyRingSlot *pSlot;
+    uint32_t ticket;
+    int status;
+
+    ticket = __atomic_fetch_add( &pRing->head, 1u, __ATOMIC_RELAXED );
+    pSlot = &pRing->slots[ ticket & ( pRing->numSlots - 1u ) ];
+
+    /* wait for the slot of the previous lap to be freed */
+    if( false == POLICYRING_fnWait( pRing,
+                                    &pSlot->seq,
+                                    ticket,
+                                    &pRing->responseCond,
+                                    &pRing->clientSpin,
+                                    &pRing->clientSleepers,
+                                    0 ) )
+    {
+        return ENOTCONN;
+    }
+
+    memcpy( &pSlot->request, pRequest, sizeof(tzPolicyCheckRequest) );
+    POLICYRING_fnPost( pRing,
+                       &pSlot->seq,
+                       ticket + 1u,
+                       &pRing->requestCond,
+                       &pRing->serverSleepers );
+
+    if( false == POLICYRING_fnWait( pRing,
+                                    &pSlot->seq,
+                                    ticket + 2u,
+                                    &pRing->responseCond,
+                                    &pRing->clientSpin,
+                                    &pRing->clientSleepers,
+                                    0 ) )
+    {
+        return ENOTCONN;
+    }
+
+    status = pSlot->status;
+
+    /* free the slot for the ticket of the next lap */
+    POLICYRING_fnPost( pRing,
+                       &pSlot->seq,
+                       ticket + pRing->numSlots,
+                       &pRing->responseCond,
+                       &pRing->clientSleepers );
+
+    return status;
+}
+
 /*! @}
  * end of dynpolac group */
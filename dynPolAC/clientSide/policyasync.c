@@ -0,0 +1,931 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+Policy implementation
+==============================================================================*/
+
+/*!
+ * @addtogroup policyasync
+ * @{
+ */
+
+/*============================================================================*/
+
+/*!
+@file  policyasync.c
+
+    The requests of a connection are kept in a ring of depth slots.  The
+    submitters fill the slot of the next ticket and the sender thread sends
+    the requests in ticket order with the blocking client calls, so the
+    tickets complete in order and a ticket is complete once the completed
+    count passed it.  A slot is reused by the ticket depth later, which
+    waits until the request in the slot has completed.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include "minicloudmsg.h"
+#include "minicloudpolicy.h"
+#include "policymsg.h"
+#include "policyasync.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+/*! maximum number of connections with a sender thread */
+#define POLICY_ASYNC_MAX_CONNECTIONS  ( 16 )
+
+/*==============================================================================
+                                Enums
+==============================================================================*/
+
+/*! kind of an asynchronous request */
+typedef enum ePolicyAsyncKind
+{
+    /*! DP_fnRegisterPolicy, DP_fnRegisterPolicySubjects or
+     *  DP_fnRegisterPolicyProgram */
+    ePolicyAsyncRegister = 0,
+
+    /*! DP_fnPolicyHousekeeping */
+    ePolicyAsyncHousekeeping,
+
+    /*! a data point operation of the caller */
+    ePolicyAsyncCall
+
+} tePolicyAsyncKind;
+
+/*=============================================================================
+                              Structures
+==============================================================================*/
+
+/*! asynchronous request */
+typedef struct zPolicyAsyncOp
+{
+    /*! kind of the request */
+    tePolicyAsyncKind kind;
+
+    /*! copy of the policy of a registration */
+    tzPOLICY policy;
+
+    /*! copy of the user list of a registration, or NULL */
+    char *pUsers;
+
+    /*! copy of the group list of a registration, or NULL */
+    char *pGroups;
+
+    /*! copy of the condition program of a registration, or NULL */
+    tzPolicyProgram *pProgram;
+
+    /*! operation of a call request */
+    tfnPolicyAsyncCall pfnCall;
+
+    /*! completion callback, or NULL */
+    tfnPolicyAsyncDone pfnDone;
+
+    /*! argument of the operation and the callback */
+    void *pArg;
+
+    /*! result of the request once completed */
+    int status;
+
+} tzPolicyAsyncOp;
+
+/*! sender of a connection */
+typedef struct zPolicyAsync
+{
+    /*! connection the requests are sent on */
+    DPRM_HANDLE dprm_handle;
+
+    /*! sender thread */
+    pthread_t thread;
+
+    /*! protects the counters and the slots */
+    pthread_mutex_t lock;
+
+    /*! signalled when a request is submitted or completed */
+    pthread_cond_t cond;
+
+    /*! slots of the requests */
+    tzPolicyAsyncOp *pOps;
+
+    /*! number of slots */
+    uint32_t depth;
+
+    /*! ticket of the next request submitted */
+    DP_TICKET next;
+
+    /*! tickets below this one have completed */
+    DP_TICKET completed;
+
+    /*! first error since the last wait for all the requests */
+    int firstError;
+
+    /*! the connection is closing, send the queued requests and stop */
+    bool stop;
+
+} tzPolicyAsync;
+
+/*==============================================================================
+                        Local/Private Variables
+==============================================================================*/
+
+/*! senders of the connections */
+static tzPolicyAsync *asyncConnections[ POLICY_ASYNC_MAX_CONNECTIONS ];
+
+/*! serializes the opens and closes of the senders */
+static pthread_mutex_t asyncLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*==============================================================================
+                        Local/Private Function Prototypes
+==============================================================================*/
+
+static tzPolicyAsync* policyasync_fnFind( DPRM_HANDLE dprm_handle );
+static int policyasync_fnSubmit( tzPolicyAsync *pAsync,
+                                 tzPolicyAsyncOp *pOp,
+                                 DP_TICKET *pTicket );
+static void *policyasync_fnThread( void *arg );
+static int policyasync_fnRun( tzPolicyAsync *pAsync, tzPolicyAsyncOp *pOp );
+
+/*==============================================================================
+                        Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+//fn  DP_fnPolicyAsyncOpen
+/*!
+
+    Start the sender thread of a connection
+
+    The sender must be closed with DP_fnPolicyAsyncClose before the
+    connection is closed.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    depth
+        number of requests in flight, 0 for POLICY_ASYNC_DEPTH
+
+@return
+    EOK : The sender is running
+    EEXIST : The connection already has a sender
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnPolicyAsyncOpen( DPRM_HANDLE dprm_handle, uint32_t depth )
+{
+    tzPolicyAsync *pAsync = NULL;
+    int slot = -1;
+    int ret = EOK;
+    int i;
+
+    if( NULL == dprm_handle )
+    {
+        return EINVAL;
+    }
+
+    if( 0u == depth )
+    {
+        depth = POLICY_ASYNC_DEPTH;
+    }
+
+    pthread_mutex_lock( &asyncLock );
+
+    for( i = 0; i < POLICY_ASYNC_MAX_CONNECTIONS; i++ )
+    {
+        if( ( NULL != asyncConnections[i] ) &&
+            ( dprm_handle == asyncConnections[i]->dprm_handle ) )
+        {
+            ret = EEXIST;
+            break;
+        }
+        if( ( -1 == slot ) && ( NULL == asyncConnections[i] ) )
+        {
+            slot = i;
+        }
+    }
+
+    if( ( EOK == ret ) && ( -1 == slot ) )
+    {
+        ret = ENOSPC;
+    }
+
+    if( EOK == ret )
+    {
+        pAsync = calloc( 1, sizeof(tzPolicyAsync) );
+        if( NULL != pAsync )
+        {
+            pAsync->pOps = calloc( depth, sizeof(tzPolicyAsyncOp) );
+        }
+
+        if( ( NULL == pAsync ) || ( NULL == pAsync->pOps ) )
+        {
+            ret = ENOMEM;
+        }
+    }
+
+    if( EOK == ret )
+    {
+        pAsync->dprm_handle = dprm_handle;
+        pAsync->depth = depth;
+        pAsync->next = 1u;
+        pAsync->completed = 1u;
+        pthread_mutex_init( &pAsync->lock, NULL );
+        pthread_cond_init( &pAsync->cond, NULL );
+
+        ret = pthread_create( &pAsync->thread,
+                              NULL,
+                              policyasync_fnThread,
+                              pAsync );
+        if( EOK == ret )
+        {
+            asyncConnections[ slot ] = pAsync;
+        }
+        else
+        {
+            pthread_cond_destroy( &pAsync->cond );
+            pthread_mutex_destroy( &pAsync->lock );
+        }
+    }
+
+    if( ( EOK != ret ) && ( NULL != pAsync ) )
+    {
+        free( pAsync->pOps );
+        free( pAsync );
+    }
+
+    pthread_mutex_unlock( &asyncLock );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  DP_fnPolicyAsyncClose
+/*!
+
+    Send the queued requests of a connection and stop its sender thread
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@return
+    EOK : The requests were sent and the sender stopped
+    ENOENT : The connection has no sender
+
+*/
+/*============================================================================*/
+int DP_fnPolicyAsyncClose( DPRM_HANDLE dprm_handle )
+{
+    tzPolicyAsync *pAsync = NULL;
+    int i;
+
+    pthread_mutex_lock( &asyncLock );
+
+    for( i = 0; i < POLICY_ASYNC_MAX_CONNECTIONS; i++ )
+    {
+        if( ( NULL != asyncConnections[i] ) &&
+            ( dprm_handle == asyncConnections[i]->dprm_handle ) )
+        {
+            pAsync = asyncConnections[i];
+            asyncConnections[i] = NULL;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock( &asyncLock );
+
+    if( NULL == pAsync )
+    {
+        return ENOENT;
+    }
+
+    pthread_mutex_lock( &pAsync->lock );
+    pAsync->stop = true;
+    pthread_cond_broadcast( &pAsync->cond );
+    pthread_mutex_unlock( &pAsync->lock );
+
+    pthread_join( pAsync->thread, NULL );
+
+    pthread_cond_destroy( &pAsync->cond );
+    pthread_mutex_destroy( &pAsync->lock );
+    free( pAsync->pOps );
+    free( pAsync );
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  DP_fnRegisterPolicyAsync
+/*!
+
+    Queue a policy registration
+
+    Like DP_fnRegisterPolicyProgram, or DP_fnRegisterPolicy when no subject
+    lists are given.  The policy, the lists and the program are copied, the
+    caller may reuse them when the function returns.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pPolicy
+        pointer to the policy data structure
+
+@param[in]
+    pUsers
+        comma separated list of user names, NULL to send the user code
+
+@param[in]
+    pGroups
+        comma separated list of group names, NULL to send the group code
+
+@param[in]
+    pProgram
+        compiled condition, NULL or an empty program if the rule has none
+
+@param[in]
+    pfnDone
+        completion callback, or NULL
+
+@param[in]
+    pArg
+        argument of the callback
+
+@param[out]
+    pTicket
+        ticket of the request, may be NULL
+
+@return
+    EOK : The registration was queued
+    ENOTCONN : The connection has no sender, see DP_fnPolicyAsyncOpen
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnRegisterPolicyAsync( DPRM_HANDLE dprm_handle,
+                              tzPOLICY *pPolicy,
+                              char *pUsers,
+                              char *pGroups,
+                              tzPolicyProgram *pProgram,
+                              tfnPolicyAsyncDone pfnDone,
+                              void *pArg,
+                              DP_TICKET *pTicket )
+{
+    tzPolicyAsync *pAsync;
+    tzPolicyAsyncOp op;
+
+    if( NULL == pPolicy )
+    {
+        return EINVAL;
+    }
+
+    pAsync = policyasync_fnFind( dprm_handle );
+    if( NULL == pAsync )
+    {
+        return ENOTCONN;
+    }
+
+    memset( &op, 0, sizeof(op) );
+    op.kind = ePolicyAsyncRegister;
+    op.policy = *pPolicy;
+    op.pfnDone = pfnDone;
+    op.pArg = pArg;
+
+    if( ( NULL != pUsers ) && ( NULL != pGroups ) )
+    {
+        op.pUsers = strdup( pUsers );
+        op.pGroups = strdup( pGroups );
+        if( ( NULL != pProgram ) && ( 0 != pProgram->numCode ) )
+        {
+            op.pProgram = malloc( sizeof(tzPolicyProgram) );
+            if( NULL != op.pProgram )
+            {
+                memcpy( op.pProgram, pProgram, sizeof(tzPolicyProgram) );
+            }
+        }
+
+        if( ( NULL == op.pUsers ) || ( NULL == op.pGroups ) ||
+            ( ( NULL == op.pProgram ) &&
+              ( NULL != pProgram ) && ( 0 != pProgram->numCode ) ) )
+        {
+            free( op.pUsers );
+            free( op.pGroups );
+            free( op.pProgram );
+            return ENOMEM;
+        }
+    }
+
+    return policyasync_fnSubmit( pAsync, &op, pTicket );
+}
+
+/*============================================================================*/
+//fn  DP_fnPolicyHousekeepingAsync
+/*!
+
+    Queue a policy housekeeping
+
+    The housekeeping is sent after all the registrations queued before it,
+    so it commits them.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pfnDone
+        completion callback, or NULL
+
+@param[in]
+    pArg
+        argument of the callback
+
+@param[out]
+    pTicket
+        ticket of the request, may be NULL
+
+@return
+    EOK : The housekeeping was queued
+    ENOTCONN : The connection has no sender, see DP_fnPolicyAsyncOpen
+
+*/
+/*============================================================================*/
+int DP_fnPolicyHousekeepingAsync( DPRM_HANDLE dprm_handle,
+                                  tfnPolicyAsyncDone pfnDone,
+                                  void *pArg,
+                                  DP_TICKET *pTicket )
+{
+    tzPolicyAsync *pAsync;
+    tzPolicyAsyncOp op;
+
+    pAsync = policyasync_fnFind( dprm_handle );
+    if( NULL == pAsync )
+    {
+        return ENOTCONN;
+    }
+
+    memset( &op, 0, sizeof(op) );
+    op.kind = ePolicyAsyncHousekeeping;
+    op.pfnDone = pfnDone;
+    op.pArg = pArg;
+
+    return policyasync_fnSubmit( pAsync, &op, pTicket );
+}
+
+/*============================================================================*/
+//fn  DP_fnPolicyAsyncCall
+/*!
+
+    Queue a data point operation
+
+    The operation is run by the sender thread in order with the other
+    requests of the connection, e.g. a function doing a DP_fnRegister and
+    its DP_fnSetTagsByName.  Its return value is the status of the ticket.
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    pfnCall
+        operation, called with the connection and pArg
+
+@param[in]
+    pfnDone
+        completion callback, or NULL
+
+@param[in]
+    pArg
+        argument of the operation and the callback, must stay valid until
+        the request completed
+
+@param[out]
+    pTicket
+        ticket of the request, may be NULL
+
+@return
+    EOK : The operation was queued
+    ENOTCONN : The connection has no sender, see DP_fnPolicyAsyncOpen
+
+*/
+/*============================================================================*/
+int DP_fnPolicyAsyncCall( DPRM_HANDLE dprm_handle,
+                          tfnPolicyAsyncCall pfnCall,
+                          tfnPolicyAsyncDone pfnDone,
+                          void *pArg,
+                          DP_TICKET *pTicket )
+{
+    tzPolicyAsync *pAsync;
+    tzPolicyAsyncOp op;
+
+    if( NULL == pfnCall )
+    {
+        return EINVAL;
+    }
+
+    pAsync = policyasync_fnFind( dprm_handle );
+    if( NULL == pAsync )
+    {
+        return ENOTCONN;
+    }
+
+    memset( &op, 0, sizeof(op) );
+    op.kind = ePolicyAsyncCall;
+    op.pfnCall = pfnCall;
+    op.pfnDone = pfnDone;
+    op.pArg = pArg;
+
+    return policyasync_fnSubmit( pAsync, &op, pTicket );
+}
+
+/*============================================================================*/
+//fn  DP_fnPolicyAsyncPoll
+/*!
+
+    Get the result of a request without blocking
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    ticket
+        ticket of the request
+
+@param[out]
+    pStatus
+        result of the request once completed
+
+@return
+    EOK : The request completed, its result is in pStatus
+    EAGAIN : The request is still in flight
+    ENOENT : The ticket is unknown, or depth newer tickets were submitted
+             since and its result was dropped
+
+*/
+/*============================================================================*/
+int DP_fnPolicyAsyncPoll( DPRM_HANDLE dprm_handle,
+                          DP_TICKET ticket,
+                          int *pStatus )
+{
+    tzPolicyAsync *pAsync;
+    int ret;
+
+    pAsync = policyasync_fnFind( dprm_handle );
+    if( ( NULL == pAsync ) || ( POLICY_ASYNC_ALL == ticket ) )
+    {
+        return ENOENT;
+    }
+
+    pthread_mutex_lock( &pAsync->lock );
+
+    if( ( ticket >= pAsync->next ) ||
+        ( pAsync->next - ticket > pAsync->depth ) )
+    {
+        /* not submitted yet, or its slot was reused */
+        ret = ENOENT;
+    }
+    else if( ticket >= pAsync->completed )
+    {
+        ret = EAGAIN;
+    }
+    else
+    {
+        if( NULL != pStatus )
+        {
+            *pStatus = pAsync->pOps[ ticket % pAsync->depth ].status;
+        }
+        ret = EOK;
+    }
+
+    pthread_mutex_unlock( &pAsync->lock );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  DP_fnPolicyAsyncWait
+/*!
+
+    Wait for a request to complete
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@param[in]
+    ticket
+        ticket of the request, or POLICY_ASYNC_ALL to wait for all the
+        requests submitted so far
+
+@param[out]
+    pStatus
+        result of the request, for POLICY_ASYNC_ALL the first error of the
+        requests since the previous wait for all, or EOK
+
+@return
+    EOK : The request completed, its result is in pStatus
+    ENOENT : The ticket is unknown, or its result was dropped
+
+*/
+/*============================================================================*/
+int DP_fnPolicyAsyncWait( DPRM_HANDLE dprm_handle,
+                          DP_TICKET ticket,
+                          int *pStatus )
+{
+    tzPolicyAsync *pAsync;
+    DP_TICKET last;
+    int ret = EOK;
+
+    pAsync = policyasync_fnFind( dprm_handle );
+    if( NULL == pAsync )
+    {
+        return ENOENT;
+    }
+
+    pthread_mutex_lock( &pAsync->lock );
+
+    last = ( POLICY_ASYNC_ALL == ticket ) ? pAsync->next - 1u : ticket;
+
+    if( ( POLICY_ASYNC_ALL != ticket ) &&
+        ( ( ticket >= pAsync->next ) ||
+          ( pAsync->next - ticket > pAsync->depth ) ) )
+    {
+        ret = ENOENT;
+    }
+    else
+    {
+        /* the tickets complete in order */
+        while( last >= pAsync->completed )
+        {
+            pthread_cond_wait( &pAsync->cond, &pAsync->lock );
+        }
+
+        if( POLICY_ASYNC_ALL == ticket )
+        {
+            if( NULL != pStatus )
+            {
+                *pStatus = pAsync->firstError;
+            }
+            pAsync->firstError = EOK;
+        }
+        else if( pAsync->next - ticket > pAsync->depth )
+        {
+            /* reused while waiting */
+            ret = ENOENT;
+        }
+        else if( NULL != pStatus )
+        {
+            *pStatus = pAsync->pOps[ ticket % pAsync->depth ].status;
+        }
+    }
+
+    pthread_mutex_unlock( &pAsync->lock );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Find the sender of a connection
+
+@param[in]
+    dprm_handle
+        Data Point Resource Manager Handle (returned by DP_fnOpen())
+
+@return
+    the sender, NULL if the connection has none
+
+*/
+/*============================================================================*/
+static tzPolicyAsync* policyasync_fnFind( DPRM_HANDLE dprm_handle )
+{
+    tzPolicyAsync *pAsync = NULL;
+    int i;
+
+    pthread_mutex_lock( &asyncLock );
+
+    for( i = 0; ( i < POLICY_ASYNC_MAX_CONNECTIONS ) && ( NULL == pAsync ); i++ )
+    {
+        if( ( NULL != asyncConnections[i] ) &&
+            ( dprm_handle == asyncConnections[i]->dprm_handle ) )
+        {
+            pAsync = asyncConnections[i];
+        }
+    }
+
+    pthread_mutex_unlock( &asyncLock );
+
+    return pAsync;
+}
+
+/*============================================================================*/
+/*!
+
+    Queue a request, blocks while depth requests are in flight
+
+@param[in]
+    pAsync
+        sender of the connection
+
+@param[in]
+    pOp
+        request, copied into its slot
+
+@param[out]
+    pTicket
+        ticket of the request, may be NULL
+
+@return
+    EOK : The request was queued
+    ENOTCONN : The sender is closing
+
+*/
+/*============================================================================*/
+static int policyasync_fnSubmit( tzPolicyAsync *pAsync,
+                                 tzPolicyAsyncOp *pOp,
+                                 DP_TICKET *pTicket )
+{
+    DP_TICKET ticket;
+    int ret = EOK;
+
+    pthread_mutex_lock( &pAsync->lock );
+
+    while( ( pAsync->next - pAsync->completed >= pAsync->depth ) &&
+           ( false == pAsync->stop ) )
+    {
+        pthread_cond_wait( &pAsync->cond, &pAsync->lock );
+    }
+
+    if( true == pAsync->stop )
+    {
+        ret = ENOTCONN;
+    }
+    else
+    {
+        ticket = pAsync->next++;
+        pAsync->pOps[ ticket % pAsync->depth ] = *pOp;
+        pthread_cond_broadcast( &pAsync->cond );
+
+        if( NULL != pTicket )
+        {
+            *pTicket = ticket;
+        }
+    }
+
+    pthread_mutex_unlock( &pAsync->lock );
+
+    if( EOK != ret )
+    {
+        free( pOp->pUsers );
+        free( pOp->pGroups );
+        free( pOp->pProgram );
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Send the requests of a connection in ticket order
+
+@param[in]
+    arg
+        the tzPolicyAsync of the connection
+
+@return
+    NULL
+
+*/
+/*============================================================================*/
+static void *policyasync_fnThread( void *arg )
+{
+    tzPolicyAsync *pAsync = (tzPolicyAsync *)arg;
+    tzPolicyAsyncOp *pOp;
+    DP_TICKET ticket;
+    int status;
+
+    pthread_mutex_lock( &pAsync->lock );
+
+    for( ;; )
+    {
+        while( ( pAsync->completed == pAsync->next ) &&
+               ( false == pAsync->stop ) )
+        {
+            pthread_cond_wait( &pAsync->cond, &pAsync->lock );
+        }
+
+        if( pAsync->completed == pAsync->next )
+        {
+            /* closing and nothing left to send */
+            break;
+        }
+
+        ticket = pAsync->completed;
+        pOp = &pAsync->pOps[ ticket % pAsync->depth ];
+
+        /* the slot is not reused before the ticket completed */
+        pthread_mutex_unlock( &pAsync->lock );
+
+        status = policyasync_fnRun( pAsync, pOp );
+        if( NULL != pOp->pfnDone )
+        {
+            pOp->pfnDone( ticket, status, pOp->pArg );
+        }
+
+        pthread_mutex_lock( &pAsync->lock );
+
+        pOp->status = status;
+        if( ( EOK != status ) && ( EOK == pAsync->firstError ) )
+        {
+            pAsync->firstError = status;
+        }
+
+        pAsync->completed++;
+        pthread_cond_broadcast( &pAsync->cond );
+    }
+
+    pthread_mutex_unlock( &pAsync->lock );
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*!
+
+    Send a request with the blocking client call and release its copies
+
+@param[in]
+    pAsync
+        sender of the connection
+
+@param[in]
+    pOp
+        request
+
+@return
+    result of the request
+
+*/
+/*============================================================================*/
+static int policyasync_fnRun( tzPolicyAsync *pAsync, tzPolicyAsyncOp *pOp )
+{
+    int status = EINVAL;
+
+    switch( pOp->kind )
+    {
+    case ePolicyAsyncRegister:
+        if( NULL == pOp->pUsers )
+        {
+            status = DP_fnRegisterPolicy( pAsync->dprm_handle, &pOp->policy );
+        }
+        else
+        {
+            status = DP_fnRegisterPolicyProgram( pAsync->dprm_handle,
+                                                 &pOp->policy,
+                                                 pOp->pUsers,
+                                                 pOp->pGroups,
+                                                 pOp->pProgram );
+        }
+        break;
+    case ePolicyAsyncHousekeeping:
+        status = DP_fnPolicyHousekeeping( pAsync->dprm_handle );
+        break;
+    case ePolicyAsyncCall:
+        status = pOp->pfnCall( pAsync->dprm_handle, pOp->pArg );
+        break;
+    default:
+        break;
+    }
+
+    free( pOp->pUsers );
+    free( pOp->pGroups );
+    free( pOp->pProgram );
+    pOp->pUsers = NULL;
+    pOp->pGroups = NULL;
+    pOp->pProgram = NULL;
+
+    return status;
+}
+
+/*! @}
+ * end of policyasync group */
@@ -0,0 +1,98 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+Policy implementation
+==============================================================================*/
+
+#ifndef POLICYASYNC_H_
+#define POLICYASYNC_H_
+
+/*!
+ * @file policyasync.h
+ * @brief Asynchronous policy and data point requests
+ *
+ * The policyasync.h file contains the APIs which queue the policy and data
+ * point requests of a connection instead of blocking the caller until the
+ * server replied.
+ *
+ * @defgroup policyasync Asynchronous Policy Requests
+ * @brief Pipelined policy and data point requests
+ *
+ * DP_fnPolicyAsyncOpen starts a sender thread for a connection.  Every
+ * request submitted on the connection returns a ticket at once and is sent
+ * by the sender thread in submission order, so a housekeeping request
+ * still commits all the rules submitted before it.  The completion of a
+ * ticket is reported to its callback, and can be polled or waited for
+ * while fewer than depth newer tickets were submitted.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include "minicloud.h"
+#include "policyprog.h"
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! default number of requests in flight on a connection */
+#define POLICY_ASYNC_DEPTH       ( 256 )
+
+/*! ticket of DP_fnPolicyAsyncWait waiting for all the submitted requests */
+#define POLICY_ASYNC_ALL         ( 0u )
+
+/*==============================================================================
+                                  Types
+ =============================================================================*/
+
+/*! ticket of an asynchronous request */
+typedef uint64_t DP_TICKET;
+
+/*! completion callback, called on the sender thread with the result of the
+ *  request, EOK or an error code from errno.h */
+typedef void (*tfnPolicyAsyncDone)( DP_TICKET ticket, int status, void *pArg );
+
+/*! data point operation run by the sender thread, see DP_fnPolicyAsyncCall */
+typedef int (*tfnPolicyAsyncCall)( DPRM_HANDLE dprm_handle, void *pArg );
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int DP_fnPolicyAsyncOpen( DPRM_HANDLE dprm_handle, uint32_t depth );
+int DP_fnPolicyAsyncClose( DPRM_HANDLE dprm_handle );
+int DP_fnRegisterPolicyAsync( DPRM_HANDLE dprm_handle,
+                              tzPOLICY *pPolicy,
+                              char *pUsers,
+                              char *pGroups,
+                              tzPolicyProgram *pProgram,
+                              tfnPolicyAsyncDone pfnDone,
+                              void *pArg,
+                              DP_TICKET *pTicket );
+int DP_fnPolicyHousekeepingAsync( DPRM_HANDLE dprm_handle,
+                                  tfnPolicyAsyncDone pfnDone,
+                                  void *pArg,
+                                  DP_TICKET *pTicket );
+int DP_fnPolicyAsyncCall( DPRM_HANDLE dprm_handle,
+                          tfnPolicyAsyncCall pfnCall,
+                          tfnPolicyAsyncDone pfnDone,
+                          void *pArg,
+                          DP_TICKET *pTicket );
+int DP_fnPolicyAsyncPoll( DPRM_HANDLE dprm_handle,
+                          DP_TICKET ticket,
+                          int *pStatus );
+int DP_fnPolicyAsyncWait( DPRM_HANDLE dprm_handle,
+                          DP_TICKET ticket,
+                          int *pStatus );
+
+/*! @} */
+
+#endif /* POLICYASYNC_H_ */
@@ -0,0 +1,406 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+Policy implementation
+==============================================================================*/
+
+/*!
+ * @addtogroup policybulk
+ * @{
+ */
+
+/*============================================================================*/
+
+/*!
+@file  policybulk.c
+
+    A batch is built in one buffer in the layout of the message payload, so
+    DP_fnRegisterBulk sends it without a copy.  The meta data pairs of a
+    point come before the point itself in the data point files, they are
+    kept apart until DP_fnBulkAdd appends them to the record of the point.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include "policybulk.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+/*! initial size of the record buffer */
+#define DP_BULK_INITIAL_SIZE   ( 16 * 1024 )
+
+/*==============================================================================
+                       Local/Private Function Prototypes
+==============================================================================*/
+
+static int bulk_fnReserve( char **ppBuf, size_t *pSize, size_t needed );
+static char* bulk_fnCopy( char *p, const char *pString );
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Initialize an empty batch
+
+@param[out]
+    pBulk
+        the batch
+
+*/
+/*============================================================================*/
+void DP_fnBulkInit( tzDpBulk *pBulk )
+{
+    if( NULL != pBulk )
+    {
+        memset( pBulk, 0, sizeof(*pBulk) );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Add a meta data key / value pair to the next data point of a batch
+
+@param[in]
+    pBulk
+        the batch
+
+@param[in]
+    pKey
+        meta data key
+
+@param[in]
+    pValue
+        meta data value
+
+@return
+    EOK : the pair is kept for the next DP_fnBulkAdd
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnBulkAddMeta( tzDpBulk *pBulk, const char *pKey, const char *pValue )
+{
+    size_t needed;
+    char *p;
+
+    if( ( NULL == pBulk ) || ( NULL == pKey ) || ( NULL == pValue ) ||
+        ( UINT16_MAX == pBulk->numMeta ) )
+    {
+        return EINVAL;
+    }
+
+    needed = pBulk->metaLength + strlen( pKey ) + strlen( pValue ) + 2u;
+    if( needed > DP_BULK_MAX_LENGTH )
+    {
+        return EMSGSIZE;
+    }
+
+    if( EOK != bulk_fnReserve( &pBulk->pMeta, &pBulk->metaSize, needed ) )
+    {
+        return ENOMEM;
+    }
+
+    p = bulk_fnCopy( pBulk->pMeta + pBulk->metaLength, pKey );
+    bulk_fnCopy( p, pValue );
+    pBulk->metaLength = needed;
+    pBulk->numMeta++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Add a data point to a batch
+
+    The meta data pairs added since the last data point go with it.
+
+@param[in]
+    pBulk
+        the batch
+
+@param[in]
+    instanceID
+        instance identifier of the data point
+
+@param[in]
+    pInfo
+        name, GUID, type, flags, format, length and default value
+
+@param[in]
+    ppAliases
+        aliases of the data point, NULL entries are skipped
+
+@param[in]
+    numAliases
+        number of entries of ppAliases
+
+@param[in]
+    pTags
+        comma separated tags, or NULL
+
+@return
+    EOK : the data point is in the batch
+    ENOSPC : the batch is full, send it and add the data point again
+    EMSGSIZE : the data point does not fit in an empty batch
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DP_fnBulkAdd( tzDpBulk *pBulk,
+                  uint32_t instanceID,
+                  const DP_tzINFO *pInfo,
+                  char * const *ppAliases,
+                  int numAliases,
+                  const char *pTags )
+{
+    tzDpBulkRecord record;
+    size_t length;
+    char *p;
+    int i;
+
+    if( ( NULL == pBulk ) || ( NULL == pInfo ) || ( NULL == pInfo->pName ) ||
+        ( '\0' == pInfo->pName[0] ) || ( NULL == pInfo->fmt ) ||
+        ( NULL == pInfo->pDefaultValue ) || ( numAliases < 0 ) ||
+        ( numAliases > UINT16_MAX ) ||
+        ( ( numAliases > 0 ) && ( NULL == ppAliases ) ) )
+    {
+        return EINVAL;
+    }
+
+    memset( &record, 0, sizeof(record) );
+    record.instanceID = instanceID;
+    record.ulName = pInfo->ulName;
+    record.dpLength = (uint32_t)pInfo->length;
+    record.type = (uint32_t)pInfo->type;
+    record.flags = pInfo->flags;
+    record.numMeta = pBulk->numMeta;
+
+    length = sizeof(record) +
+             strlen( pInfo->pName ) + 1u +
+             strlen( pInfo->fmt ) + 1u +
+             strlen( pInfo->pDefaultValue ) + 1u +
+             ( ( NULL != pTags ) ? strlen( pTags ) : 0u ) + 1u +
+             pBulk->metaLength;
+
+    for( i = 0; i < numAliases; i++ )
+    {
+        if( NULL != ppAliases[i] )
+        {
+            length += strlen( ppAliases[i] ) + 1u;
+            record.numAliases++;
+        }
+    }
+
+    length = ( length + DP_BULK_ALIGN - 1u ) & ~( (size_t)DP_BULK_ALIGN - 1u );
+    if( length > DP_BULK_MAX_LENGTH )
+    {
+        return EMSGSIZE;
+    }
+
+    if( ( pBulk->numPoints >= DP_BULK_MAX_POINTS ) ||
+        ( pBulk->length + length > DP_BULK_MAX_LENGTH ) )
+    {
+        return ENOSPC;
+    }
+
+    if( EOK != bulk_fnReserve( &pBulk->pBuf,
+                               &pBulk->size,
+                               pBulk->length + length ) )
+    {
+        return ENOMEM;
+    }
+
+    record.length = (uint32_t)length;
+    p = pBulk->pBuf + pBulk->length;
+    memset( p, 0, length );
+    memcpy( p, &record, sizeof(record) );
+    p += sizeof(record);
+
+    p = bulk_fnCopy( p, pInfo->pName );
+    p = bulk_fnCopy( p, pInfo->fmt );
+    p = bulk_fnCopy( p, pInfo->pDefaultValue );
+    p = bulk_fnCopy( p, ( NULL != pTags ) ? pTags : "" );
+
+    for( i = 0; i < numAliases; i++ )
+    {
+        if( NULL != ppAliases[i] )
+        {
+            p = bulk_fnCopy( p, ppAliases[i] );
+        }
+    }
+
+    if( pBulk->metaLength > 0u )
+    {
+        memcpy( p, pBulk->pMeta, pBulk->metaLength );
+    }
+
+    pBulk->length += length;
+    pBulk->numPoints++;
+    pBulk->metaLength = 0u;
+    pBulk->numMeta = 0u;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Remove the data points of a batch once it was sent.  The meta data
+    pairs of the next data point and the buffers are kept.
+
+@param[in]
+    pBulk
+        the batch
+
+*/
+/*============================================================================*/
+void DP_fnBulkClear( tzDpBulk *pBulk )
+{
+    if( NULL != pBulk )
+    {
+        pBulk->length = 0u;
+        pBulk->numPoints = 0u;
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Drop the meta data pairs added for a data point which is not added
+
+@param[in]
+    pBulk
+        the batch
+
+*/
+/*============================================================================*/
+void DP_fnBulkDropMeta( tzDpBulk *pBulk )
+{
+    if( NULL != pBulk )
+    {
+        pBulk->metaLength = 0u;
+        pBulk->numMeta = 0u;
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Release the buffers of a batch
+
+@param[in]
+    pBulk
+        the batch
+
+*/
+/*============================================================================*/
+void DP_fnBulkFree( tzDpBulk *pBulk )
+{
+    if( NULL != pBulk )
+    {
+        free( pBulk->pBuf );
+        free( pBulk->pMeta );
+        DP_fnBulkInit( pBulk );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Grow a buffer to hold a number of bytes
+
+@param[in,out]
+    ppBuf
+        the buffer
+
+@param[in,out]
+    pSize
+        size of the buffer
+
+@param[in]
+    needed
+        number of bytes
+
+@return
+    EOK or ENOMEM
+
+*/
+/*============================================================================*/
+static int bulk_fnReserve( char **ppBuf, size_t *pSize, size_t needed )
+{
+    size_t size = *pSize;
+    char *pGrown;
+
+    if( needed <= size )
+    {
+        return EOK;
+    }
+
+    if( 0u == size )
+    {
+        size = DP_BULK_INITIAL_SIZE;
+    }
+
+    while( size < needed )
+    {
+        size *= 2u;
+    }
+
+    pGrown = realloc( *ppBuf, size );
+    if( NULL == pGrown )
+    {
+        return ENOMEM;
+    }
+
+    *ppBuf = pGrown;
+    *pSize = size;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Copy a string with its terminator
+
+@param[out]
+    p
+        destination
+
+@param[in]
+    pString
+        string to copy
+
+@return
+    the byte after the terminator
+
+*/
+/*============================================================================*/
+static char* bulk_fnCopy( char *p, const char *pString )
+{
+    size_t len = strlen( pString ) + 1u;
+
+    memcpy( p, pString, len );
+
+    return p + len;
+}
+
+/*! @} */
@@ -0,0 +1,309 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+Policy implementation
+==============================================================================*/
+
+#ifndef POLICYBULK_H_
+#define POLICYBULK_H_
+
+/*!
+ * @file policybulk.h
+ * @brief Bulk data point registration shared by the client and the server
+ *
+ * The policybulk.h file contains the layout of the message which creates
+ * many data points in one request.
+ *
+ * @defgroup policybulk Bulk Data Point Registration
+ * @brief Data points created in batches
+ *
+ * Creating a data point one call at a time costs a round trip for the
+ * registration, one for its handle, one per alias, one for its tags and
+ * one for its meta data.  A client collects complete data points in a
+ * tzDpBulk (DP_fnBulkAdd) and sends them with DP_fnRegisterBulk.  The
+ * server decodes the batch with DP_fnBulkNext and hands the points to the
+ * data point store in one call, which replies the result of every point.
+ * A server without a store replies ENOSYS and the client falls back to
+ * the single calls.
+ *
+ * A batch is a sequence of records, each a tzDpBulkRecord followed by the
+ * NUL terminated strings: name, format, default value, tags ("" for
+ * none), numAliases aliases and numMeta key / value pairs.  Records start
+ * on a 4 byte boundary.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include "minicloud.h"
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! Name of a housekeeping message creating data points.  max holds the
+ *  length of the records following the message, the reply is one int32_t
+ *  result (an errno) per record */
+#define POLICY_HOUSEKEEP_DP_BULK   ( -8 )
+
+/*! most data points in one batch */
+#define DP_BULK_MAX_POINTS         ( 1024 )
+
+/*! most bytes of records in one batch */
+#define DP_BULK_MAX_LENGTH         ( 256 * 1024 )
+
+/*! alignment of the records */
+#define DP_BULK_ALIGN              ( 4u )
+
+/*==============================================================================
+                                Structures
+ =============================================================================*/
+
+/*! header of a data point record */
+typedef struct zDpBulkRecord
+{
+    /*! length of the record with its strings and padding */
+    uint32_t length;
+
+    /*! instance identifier of the data point */
+    uint32_t instanceID;
+
+    /*! GUID of the data point, 0 for none */
+    uint32_t ulName;
+
+    /*! length of the data point value */
+    uint32_t dpLength;
+
+    /*! DP_TYPE_ type of the data point */
+    uint32_t type;
+
+    /*! DP_FLAG_ flags of the data point */
+    uint16_t flags;
+
+    /*! number of aliases following the tags */
+    uint16_t numAliases;
+
+    /*! number of meta data key / value pairs following the aliases */
+    uint16_t numMeta;
+
+    /*! unused */
+    uint16_t reserved;
+
+} tzDpBulkRecord;
+
+/*! data point of a batch, decoded by DP_fnBulkNext.  The strings point
+ *  into the batch */
+typedef struct zDpBulkPoint
+{
+    /*! instance identifier of the data point */
+    uint32_t instanceID;
+
+    /*! name, GUID, type, flags, format, length and default value */
+    DP_tzINFO info;
+
+    /*! comma separated tags, NULL for none */
+    char *pTags;
+
+    /*! first alias, the others follow it */
+    char *pAliases;
+
+    /*! number of aliases */
+    uint16_t numAliases;
+
+    /*! first meta data key, each key is followed by its value */
+    char *pMeta;
+
+    /*! number of meta data key / value pairs */
+    uint16_t numMeta;
+
+} tzDpBulkPoint;
+
+/*! batch of data points built by a client */
+typedef struct zDpBulk
+{
+    /*! records */
+    char *pBuf;
+
+    /*! length of the records */
+    size_t length;
+
+    /*! size of the buffer */
+    size_t size;
+
+    /*! number of records */
+    uint32_t numPoints;
+
+    /*! meta data pairs for the next record */
+    char *pMeta;
+
+    /*! length of the meta data pairs */
+    size_t metaLength;
+
+    /*! size of the meta data buffer */
+    size_t metaSize;
+
+    /*! number of meta data pairs */
+    uint16_t numMeta;
+
+} tzDpBulk;
+
+/*==============================================================================
+                            Inline Functions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Skip a number of strings of a record
+
+@param[in]
+    p
+        first string
+
+@param[in]
+    pEnd
+        end of the record
+
+@param[in]
+    count
+        number of strings
+
+@return
+    the string after them, NULL if they are not terminated in the record
+
+*/
+/*============================================================================*/
+static inline char* DP_fnBulkSkip( char *p, const char *pEnd, uint32_t count )
+{
+    char *pNul;
+
+    while( ( count-- > 0u ) && ( NULL != p ) )
+    {
+        pNul = memchr( p, '\0', (size_t)( pEnd - p ) );
+        p = ( NULL != pNul ) ? pNul + 1 : NULL;
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*!
+
+    Decode the next record of a batch
+
+@param[in]
+    pBuf
+        records of the batch
+
+@param[in]
+    length
+        length of the records
+
+@param[in,out]
+    pOffset
+        offset of the record, set to the offset of the next one
+
+@param[out]
+    pPoint
+        the data point of the record
+
+@return
+    EOK : pPoint holds the record
+    ENOENT : there are no more records
+    EBADMSG : the record is malformed, the rest of the batch is unusable
+
+*/
+/*============================================================================*/
+static inline int DP_fnBulkNext( char *pBuf,
+                                 size_t length,
+                                 size_t *pOffset,
+                                 tzDpBulkPoint *pPoint )
+{
+    tzDpBulkRecord record;
+    char *pEnd;
+    char *p;
+
+    if( *pOffset >= length )
+    {
+        return ENOENT;
+    }
+
+    if( length - *pOffset < sizeof(record) )
+    {
+        return EBADMSG;
+    }
+
+    memcpy( &record, pBuf + *pOffset, sizeof(record) );
+    if( ( record.length < sizeof(record) ) ||
+        ( record.length > length - *pOffset ) ||
+        ( 0u != ( record.length % DP_BULK_ALIGN ) ) )
+    {
+        return EBADMSG;
+    }
+
+    p = pBuf + *pOffset + sizeof(record);
+    pEnd = pBuf + *pOffset + record.length;
+
+    memset( pPoint, 0, sizeof(*pPoint) );
+    pPoint->instanceID = record.instanceID;
+    pPoint->info.ulName = record.ulName;
+    pPoint->info.length = record.dpLength;
+    pPoint->info.type = record.type;
+    pPoint->info.flags = record.flags;
+    pPoint->numAliases = record.numAliases;
+    pPoint->numMeta = record.numMeta;
+
+    pPoint->info.pName = p;
+    pPoint->info.fmt = p = DP_fnBulkSkip( p, pEnd, 1u );
+    pPoint->info.pDefaultValue = p = DP_fnBulkSkip( p, pEnd, 1u );
+    pPoint->pTags = p = DP_fnBulkSkip( p, pEnd, 1u );
+    pPoint->pAliases = p = DP_fnBulkSkip( p, pEnd, 1u );
+    pPoint->pMeta = p = DP_fnBulkSkip( p, pEnd, record.numAliases );
+    p = DP_fnBulkSkip( p, pEnd, 2u * record.numMeta );
+    if( ( NULL == p ) || ( '\0' == pPoint->info.pName[0] ) )
+    {
+        return EBADMSG;
+    }
+
+    if( '\0' == pPoint->pTags[0] )
+    {
+        pPoint->pTags = NULL;
+    }
+
+    *pOffset += record.length;
+
+    return EOK;
+}
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+void DP_fnBulkInit( tzDpBulk *pBulk );
+int DP_fnBulkAddMeta( tzDpBulk *pBulk, const char *pKey, const char *pValue );
+int DP_fnBulkAdd( tzDpBulk *pBulk,
+                  uint32_t instanceID,
+                  const DP_tzINFO *pInfo,
+                  char * const *ppAliases,
+                  int numAliases,
+                  const char *pTags );
+void DP_fnBulkClear( tzDpBulk *pBulk );
+void DP_fnBulkDropMeta( tzDpBulk *pBulk );
+void DP_fnBulkFree( tzDpBulk *pBulk );
+int DP_fnRegisterBulk( DPRM_HANDLE dprm_handle,
+                       tzDpBulk *pBulk,
+                       int32_t *pResults );
+
+/*! @} */
+
+#endif /* POLICYBULK_H_ */
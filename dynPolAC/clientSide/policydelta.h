@@ -0,0 +1,282 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+Policy implementation
+==============================================================================*/
+
+#ifndef POLICYDELTA_H_
+#define POLICYDELTA_H_
+
+/*!
+ * @file policydelta.h
+ * @brief Policy rule fingerprints shared by the client and the server
+ *
+ * The policydelta.h file contains the fingerprints which let a client
+ * reload a policy file by sending only the rules that changed.
+ *
+ * @defgroup policydelta Incremental Policy Reload
+ * @brief Rule fingerprints and delta commit
+ *
+ * Every rule committed on the server keeps two FNV-1a hashes: the key of
+ * the rule (name, type and lower case location, the identity of the rule
+ * in the policy hash) and the fingerprint of everything the client sent
+ * for it.  A client fetches the pairs with DP_fnPolicyFingerprints,
+ * registers the rules whose key is new or whose fingerprint differs, and
+ * commits with DP_fnPolicyDeltaCommit listing the keys to remove.  The
+ * delta commit leaves the other rules as they are, unlike the housekeeping
+ * which removes every rule not registered again since the last commit.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include "policyprog.h"
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! Name of a housekeeping message asking the server for the fingerprints of
+ *  the committed rules, replied as a tzPolicyFingerprintHeader followed by
+ *  numRules tzPolicyFingerprint */
+#define POLICY_HOUSEKEEP_FINGERPRINTS  ( -6 )
+
+/*! Name of a housekeeping message committing the rules registered since the
+ *  last commit without removing the others.  max holds the number of rule
+ *  keys following the message, the rules to remove */
+#define POLICY_HOUSEKEEP_DELTA_COMMIT  ( -7 )
+
+/*! most rules a server keeps, see MAX_NUM_POLICY */
+#define POLICY_DELTA_MAX_RULES         ( 16384 )
+
+/*! FNV-1a 64 bit offset basis */
+#define POLICY_DELTA_FNV_BASIS         ( 14695981039346656037ull )
+
+/*! FNV-1a 64 bit prime */
+#define POLICY_DELTA_FNV_PRIME         ( 1099511628211ull )
+
+/*==============================================================================
+                                Structures
+ =============================================================================*/
+
+/*! fingerprint of a committed rule */
+typedef struct zPolicyFingerprint
+{
+    /*! hash of the rule name, type and lower case location */
+    uint64_t key;
+
+    /*! hash of the rule content */
+    uint64_t fingerprint;
+
+} tzPolicyFingerprint;
+
+/*! header of the POLICY_HOUSEKEEP_FINGERPRINTS reply */
+typedef struct zPolicyFingerprintHeader
+{
+    /*! number of committed rules, the fingerprints which follow */
+    uint32_t numRules;
+
+    /*! unused, keeps the fingerprints aligned */
+    uint32_t reserved;
+
+} tzPolicyFingerprintHeader;
+
+/*==============================================================================
+                            Inline Functions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Add bytes to an FNV-1a hash
+
+@param[in]
+    hash
+        hash so far
+
+@param[in]
+    pData
+        bytes to add
+
+@param[in]
+    len
+        number of bytes
+
+@return
+    the new hash
+
+*/
+/*============================================================================*/
+static inline uint64_t POLICYDELTA_fnHash( uint64_t hash,
+                                           const void *pData,
+                                           size_t len )
+{
+    const uint8_t *p = (const uint8_t *)pData;
+
+    while( len-- > 0u )
+    {
+        hash ^= *p++;
+        hash *= POLICY_DELTA_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/*============================================================================*/
+/*!
+
+    Key of a rule
+
+@param[in]
+    name
+        rule name, POLICY_NAME_
+
+@param[in]
+    type
+        rule type, POLICY_TYPE_
+
+@param[in]
+    pLocation
+        location of the rule, in any case
+
+@return
+    key of the rule
+
+*/
+/*============================================================================*/
+static inline uint64_t POLICYDELTA_fnKey( int32_t name,
+                                          int32_t type,
+                                          const char *pLocation )
+{
+    uint64_t hash = POLICY_DELTA_FNV_BASIS;
+    uint8_t c;
+
+    hash = POLICYDELTA_fnHash( hash, &name, sizeof(name) );
+    hash = POLICYDELTA_fnHash( hash, &type, sizeof(type) );
+
+    for( ; '\0' != *pLocation; pLocation++ )
+    {
+        c = (uint8_t)tolower( (unsigned char)*pLocation );
+        hash = POLICYDELTA_fnHash( hash, &c, 1u );
+    }
+
+    return hash;
+}
+
+/*============================================================================*/
+/*!
+
+    Fingerprint of a rule as sent to the server
+
+@param[in]
+    name
+        rule name
+
+@param[in]
+    type
+        rule type
+
+@param[in]
+    max
+        max of the rule
+
+@param[in]
+    min
+        min of the rule
+
+@param[in]
+    since
+        time of the rule in seconds
+
+@param[in]
+    user
+        user code, used when the subject lists are NULL
+
+@param[in]
+    group
+        group code, used when the subject lists are NULL
+
+@param[in]
+    pLocation
+        location of the rule as sent
+
+@param[in]
+    pUsers
+        user list, or NULL
+
+@param[in]
+    pGroups
+        group list, or NULL
+
+@param[in]
+    pProgram
+        condition program, or NULL
+
+@return
+    fingerprint of the rule
+
+*/
+/*============================================================================*/
+static inline uint64_t POLICYDELTA_fnFingerprint( int32_t name,
+                                                  int32_t type,
+                                                  int32_t max,
+                                                  int32_t min,
+                                                  int64_t since,
+                                                  uint32_t user,
+                                                  uint32_t group,
+                                                  const char *pLocation,
+                                                  const char *pUsers,
+                                                  const char *pGroups,
+                                                  const tzPolicyProgram *pProgram )
+{
+    uint64_t hash = POLICY_DELTA_FNV_BASIS;
+
+    hash = POLICYDELTA_fnHash( hash, &name, sizeof(name) );
+    hash = POLICYDELTA_fnHash( hash, &type, sizeof(type) );
+    hash = POLICYDELTA_fnHash( hash, &max, sizeof(max) );
+    hash = POLICYDELTA_fnHash( hash, &min, sizeof(min) );
+    hash = POLICYDELTA_fnHash( hash, &since, sizeof(since) );
+    hash = POLICYDELTA_fnHash( hash, pLocation, strlen( pLocation ) + 1u );
+
+    if( ( NULL != pUsers ) && ( NULL != pGroups ) )
+    {
+        hash = POLICYDELTA_fnHash( hash, pUsers, strlen( pUsers ) + 1u );
+        hash = POLICYDELTA_fnHash( hash, pGroups, strlen( pGroups ) + 1u );
+    }
+    else
+    {
+        hash = POLICYDELTA_fnHash( hash, &user, sizeof(user) );
+        hash = POLICYDELTA_fnHash( hash, &group, sizeof(group) );
+    }
+
+    if( ( NULL != pProgram ) && ( pProgram->numCode > 0u ) &&
+        ( pProgram->numCode <= POLICY_PROGRAM_MAX_CODE ) &&
+        ( pProgram->numConst <= POLICY_PROGRAM_MAX_CONST ) )
+    {
+        hash = POLICYDELTA_fnHash( hash,
+                                   pProgram->code,
+                                   pProgram->numCode * sizeof(uint32_t) );
+        hash = POLICYDELTA_fnHash( hash,
+                                   pProgram->konst,
+                                   pProgram->numConst * sizeof(double) );
+        hash = POLICYDELTA_fnHash( hash,
+                                   pProgram->names,
+                                   strnlen( pProgram->names,
+                                            POLICY_PROGRAM_NAMES_LENGTH ) );
+    }
+
+    return hash;
+}
+
+/*! @} */
+
+#endif /* POLICYDELTA_H_ */
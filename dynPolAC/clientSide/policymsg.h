@@ -0,0 +1,113 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+Policy implementation
+==============================================================================*/
+
+#ifndef POLICYMSG_H_
+#define POLICYMSG_H_
+
+/*!
+ * @file policymsg.h
+ * @brief Policy message extensions shared by the client and the server
+ *
+ * The policymsg.h file contains the definitions which extend the
+ * datapoint_policy_msg_t message with data that does not fit in its
+ * fixed fields.  Both the policy client library and the MiniCloud server
+ * include this file so they agree on the layout of the message payload.
+ *
+ * @defgroup policymsg Policy Message Extensions
+ * @brief Policy message payload layout
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include "minicloudmsg.h"
+#include "policyprog.h"
+#include "policyring.h"
+#include "policydelta.h"
+#include "policybulk.h"
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! marker placed in the user and group fields of datapoint_policy_msg_t when
+ *  the subjects are sent as comma separated name lists.  The payload following
+ *  the message is then: "<location>\0<user list>\0<group list>\0" */
+#define POLICY_SUBJECT_LIST         ( 0xFFFFFFFEu )
+
+/*! marker placed in the group field instead of POLICY_SUBJECT_LIST when a
+ *  condition program follows the subject lists, the payload is then:
+ *  "<location>\0<user list>\0<group list>\0" followed by a tzPolicyProgram */
+#define POLICY_SUBJECT_PROGRAM      ( 0xFFFFFFFDu )
+
+/*! Name of a housekeeping message asking the server to load a native rule
+ *  set, the payload following the message is the path of the shared object */
+#define POLICY_HOUSEKEEP_LOAD_NATIVE  ( -2 )
+
+/*! Name of a housekeeping message asking the server to benchmark its policy
+ *  check engines on the committed rules, max holds the number of passes */
+#define POLICY_HOUSEKEEP_BENCHMARK    ( -3 )
+
+/*! Name of a housekeeping message asking the server to select the engine of
+ *  its policy checks, max holds one of the POLICY_ENGINE_ID values */
+#define POLICY_HOUSEKEEP_SELECT_ENGINE  ( -10 )
+
+/*! policy check engine looking up the rule in the policy hash */
+#define POLICY_ENGINE_ID_HASH       ( 0 )
+
+/*! policy check engine walking the decision diagram of the committed rules */
+#define POLICY_ENGINE_ID_DD         ( 1 )
+
+/*! policy check engine running the native rule set, see
+ *  DP_fnPolicyLoadNative, the decision diagram decides while none is loaded */
+#define POLICY_ENGINE_ID_NATIVE     ( 2 )
+
+/*! Name of a housekeeping message asking the server to save a snapshot of
+ *  its data points and rules and to empty its write-ahead log */
+#define POLICY_HOUSEKEEP_SNAPSHOT     ( -9 )
+
+/*! maximum length of a comma separated user or group list */
+#define POLICY_SUBJECT_LIST_LENGTH  ( 512 )
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int DP_fnRegisterPolicySubjects( DPRM_HANDLE dprm_handle,
+                                 tzPOLICY *pPolicy,
+                                 char *pUsers,
+                                 char *pGroups );
+int DP_fnRegisterPolicyProgram( DPRM_HANDLE dprm_handle,
+                                tzPOLICY *pPolicy,
+                                char *pUsers,
+                                char *pGroups,
+                                tzPolicyProgram *pProgram );
+int DP_fnPolicyLoadNative( DPRM_HANDLE dprm_handle, const char *pPath );
+int DP_fnPolicyBenchmark( DPRM_HANDLE dprm_handle, int iterations );
+int DP_fnPolicySelectEngine( DPRM_HANDLE dprm_handle, int engine );
+int DP_fnPolicySnapshot( DPRM_HANDLE dprm_handle );
+int DP_fnPolicyFingerprints( DPRM_HANDLE dprm_handle,
+                             tzPolicyFingerprint *pFingerprints,
+                             uint32_t maxFingerprints,
+                             uint32_t *pNumFingerprints );
+int DP_fnPolicyDeltaCommit( DPRM_HANDLE dprm_handle,
+                            const uint64_t *pRemove,
+                            uint32_t numRemove );
+int DP_fnPolicyRingOpen( DPRM_HANDLE dprm_handle, uint32_t numSlots );
+int DP_fnPolicyRingClose( DPRM_HANDLE dprm_handle );
+int DP_fnPolicyCheck( DPRM_HANDLE dprm_handle,
+                      const tzPolicyCheckRequest *pRequest );
+
+/*! @} */
+
+#endif /* POLICYMSG_H_ */
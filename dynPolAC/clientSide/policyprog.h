@@ -0,0 +1,151 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+Policy implementation
+==============================================================================*/
+
+#ifndef POLICYPROG_H_
+#define POLICYPROG_H_
+
+/*!
+ * @file policyprog.h
+ * @brief Policy condition bytecode shared by the client and the server
+ *
+ * The policyprog.h file contains the instruction set and the program layout
+ * of the policy rule conditions.  A condition such as
+ *
+ *     value ge 10 and value le 20 and age lt 60 or user in (bob, gus)
+ *
+ * is compiled by the policy parser into a short register based program
+ * which is sent to the server with the rule and run by the policy check.
+ *
+ * Every instruction is a 32-bit word holding an opcode and either three
+ * register operands or a register and a 16-bit immediate.  The programs
+ * have no jumps, so a program runs at most POLICY_PROGRAM_MAX_CODE
+ * instructions.
+ *
+ * @defgroup policyprog Policy Condition Programs
+ * @brief Policy condition bytecode
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! identifies a policy condition program */
+#define POLICY_PROGRAM_MAGIC         ( 0x50564D31u )
+
+/*! maximum number of instructions of a program */
+#define POLICY_PROGRAM_MAX_CODE      ( 64 )
+
+/*! maximum number of constants of a program */
+#define POLICY_PROGRAM_MAX_CONST     ( 16 )
+
+/*! number of registers of the condition machine */
+#define POLICY_PROGRAM_REGISTERS     ( 8 )
+
+/*! size of the subject name lists of a program */
+#define POLICY_PROGRAM_NAMES_LENGTH  ( 256 )
+
+/*! the program reads the previous value of the data point */
+#define POLICY_PROGRAM_FLAG_DELTA    ( 0x0001u )
+
+/*! R[a] = R[a] != 0, stop */
+#define POLICY_OP_RET                ( 0 )
+/*! R[a] = K[imm] */
+#define POLICY_OP_LDK                ( 1 )
+/*! R[a] = data point value */
+#define POLICY_OP_LDVAL              ( 2 )
+/*! R[a] = age of the data point value in seconds */
+#define POLICY_OP_LDAGE              ( 3 )
+/*! R[a] = value - previous value of the data point */
+#define POLICY_OP_LDDELTA            ( 4 )
+/*! R[a] = R[b] < R[c] */
+#define POLICY_OP_LT                 ( 5 )
+/*! R[a] = R[b] <= R[c] */
+#define POLICY_OP_LE                 ( 6 )
+/*! R[a] = R[b] > R[c] */
+#define POLICY_OP_GT                 ( 7 )
+/*! R[a] = R[b] >= R[c] */
+#define POLICY_OP_GE                 ( 8 )
+/*! R[a] = R[b] == R[c] */
+#define POLICY_OP_EQ                 ( 9 )
+/*! R[a] = R[b] != R[c] */
+#define POLICY_OP_NE                 ( 10 )
+/*! R[a] = R[b] && R[c] */
+#define POLICY_OP_AND                ( 11 )
+/*! R[a] = R[b] || R[c] */
+#define POLICY_OP_OR                 ( 12 )
+/*! R[a] = !R[b] */
+#define POLICY_OP_NOT                ( 13 )
+/*! R[a] = data point users in the list at names[imm] (client) or in the
+ *  set interned from the list at names[K[imm]] (server) */
+#define POLICY_OP_INUSER             ( 14 )
+/*! R[a] = data point groups in the list at names[imm] (client) or in the
+ *  set interned from the list at names[K[imm]] (server) */
+#define POLICY_OP_INGROUP            ( 15 )
+/*! number of opcodes */
+#define POLICY_OP_COUNT              ( 16 )
+
+/*! encode a three register instruction */
+#define POLICY_INSN( op, a, b, c )   ( (uint32_t)(op) |                 \
+                                       ( (uint32_t)(a) << 8 ) |         \
+                                       ( (uint32_t)(b) << 16 ) |        \
+                                       ( (uint32_t)(c) << 24 ) )
+
+/*! encode a register and immediate instruction */
+#define POLICY_INSN_IMM( op, a, imm )  ( (uint32_t)(op) |               \
+                                         ( (uint32_t)(a) << 8 ) |       \
+                                         ( (uint32_t)(imm) << 16 ) )
+
+/*! instruction fields */
+#define POLICY_INSN_OP( insn )       ( (insn) & 0xFFu )
+#define POLICY_INSN_A( insn )        ( ( (insn) >> 8 ) & 0xFFu )
+#define POLICY_INSN_B( insn )        ( ( (insn) >> 16 ) & 0xFFu )
+#define POLICY_INSN_C( insn )        ( ( (insn) >> 24 ) & 0xFFu )
+#define POLICY_INSN_IMM16( insn )    ( ( (insn) >> 16 ) & 0xFFFFu )
+
+/*=============================================================================
+                              Structures
+==============================================================================*/
+
+/*! policy condition program */
+typedef struct zPolicyProgram
+{
+    /*! POLICY_PROGRAM_MAGIC */
+    uint32_t magic;
+
+    /*! number of instructions, 0 if the rule has no condition */
+    uint16_t numCode;
+
+    /*! number of constants */
+    uint16_t numConst;
+
+    /*! POLICY_PROGRAM_FLAG_xxx, set by the server when loading */
+    uint32_t flags;
+
+    /*! instructions */
+    uint32_t code[ POLICY_PROGRAM_MAX_CODE ];
+
+    /*! constants */
+    double konst[ POLICY_PROGRAM_MAX_CONST ];
+
+    /*! nul terminated, comma separated subject name lists */
+    char names[ POLICY_PROGRAM_NAMES_LENGTH ];
+
+} tzPolicyProgram;
+
+/*! @} */
+
+#endif /* POLICYPROG_H_ */
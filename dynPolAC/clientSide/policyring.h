@@ -0,0 +1,423 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+Policy implementation
+==============================================================================*/
+
+#ifndef POLICYRING_H_
+#define POLICYRING_H_
+
+/*!
+ * @file policyring.h
+ * @brief Shared memory policy check ring shared by the client and the server
+ *
+ * The policyring.h file contains the layout of the ring a client and the
+ * server use to exchange policy checks without a message pass.  The client
+ * creates a shared memory object holding the ring and asks the server to
+ * attach it, a thread of the server then serves the checks of the ring.
+ *
+ * Every slot of the ring holds a fixed size request and its response.  The
+ * slot sequence number tells who owns the slot, for the slot taken with
+ * ticket t:
+ *
+ *     seq == t                      free, the client writes the request
+ *     seq == t + 1                  request posted, the server decides it
+ *     seq == t + 2                  response posted, the client reads it
+ *     seq == t + numSlots           free for the ticket of the next lap
+ *
+ * Any number of client threads take tickets from the head of the ring, the
+ * single server thread consumes the slots in ticket order.
+ *
+ * A waiting side first spins on the sequence number, the number of spins
+ * adapts to how long the recent waits took, then sleeps on a process
+ * shared condition variable of the ring.  The posting side only takes the
+ * ring mutex when a waiter sleeps, so a busy ring runs without a system
+ * call.
+ *
+ * The ring mutex is robust: a process dying while holding it stops the
+ * ring instead of blocking the other side forever.  A sleeping server also
+ * wakes every POLICY_RING_LIVENESS_MS to check that the client process is
+ * still alive, and stops serving the ring of a client which died without
+ * closing it.
+ *
+ * @defgroup policyring Policy Check Ring
+ * @brief Shared memory policy check transport
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! identifies a policy check ring */
+#define POLICY_RING_MAGIC            ( 0x50524732u )
+
+/*! default number of slots of a ring, a power of two */
+#define POLICY_RING_SLOTS            ( 64 )
+
+/*! maximum length of the shared memory object name of a ring */
+#define POLICY_RING_NAME_LENGTH      ( 64 )
+
+/*! length of the location of a check */
+#define POLICY_RING_LOCATION_LENGTH  ( 64 )
+
+/*! length of the user and group names of a check */
+#define POLICY_RING_SUBJECT_LENGTH   ( 32 )
+
+/*! spins of a wait before the adaptation */
+#define POLICY_RING_SPIN_DEFAULT     ( 1000 )
+
+/*! most spins of a wait */
+#define POLICY_RING_SPIN_MAX         ( 20000 )
+
+/*! fewest spins of a wait, a ring created with no spins never spins */
+#define POLICY_RING_SPIN_MIN         ( 50 )
+
+/*! a sleeping waiter checks the other process this often */
+#define POLICY_RING_LIVENESS_MS      ( 1000 )
+
+/*! Name of a housekeeping message asking the server to serve a ring, the
+ *  payload following the message is the shared memory object name */
+#define POLICY_HOUSEKEEP_RING_ATTACH ( -4 )
+
+/*! Name of a housekeeping message carrying a policy check, the payload
+ *  following the message is a tzPolicyCheckRequest.  The server replies
+ *  EOK if the check passed */
+#define POLICY_HOUSEKEEP_CHECK       ( -5 )
+
+/*! cache line of the ring structures */
+#define POLICY_RING_CACHE_LINE       ( 64 )
+
+#if defined(__i386__) || defined(__x86_64__)
+#define POLICY_RING_RELAX()          __builtin_ia32_pause()
+#elif defined(__arm__) || defined(__aarch64__)
+#define POLICY_RING_RELAX()          __asm__ __volatile__( "yield" )
+#else
+#define POLICY_RING_RELAX()          do { } while( 0 )
+#endif
+
+/*==============================================================================
+                                Structures
+ =============================================================================*/
+
+/*! policy check of a data point */
+typedef struct zPolicyCheckRequest
+{
+    /*! category type of the data point, POLICY_TYPE_ */
+    int32_t type;
+
+    /*! type of the data point value, DP_TYPE_ */
+    int32_t dpType;
+
+    /*! last updated time of the data point value, in seconds */
+    int64_t timestamp;
+
+    /*! value of the data point, scalar types only */
+    union
+    {
+        uint16_t uiVal;
+        int16_t  siVal;
+        uint32_t ulVal;
+        int32_t  slVal;
+        float    fVal;
+    } val;
+
+    /*! location of the data point */
+    char location[ POLICY_RING_LOCATION_LENGTH ];
+
+    /*! user of the data point, empty if none */
+    char user[ POLICY_RING_SUBJECT_LENGTH ];
+
+    /*! group of the data point, empty if none */
+    char group[ POLICY_RING_SUBJECT_LENGTH ];
+
+} tzPolicyCheckRequest;
+
+/*! slot of a ring */
+typedef struct zPolicyRingSlot
+{
+    /*! sequence number of the slot, see policyring.h */
+    uint32_t seq;
+
+    /*! response, EOK if the check passed or an errno */
+    int32_t status;
+
+    /*! request */
+    tzPolicyCheckRequest request;
+
+} __attribute__(( aligned( POLICY_RING_CACHE_LINE ) )) tzPolicyRingSlot;
+
+/*! ring header, the slots follow it */
+typedef struct zPolicyRing
+{
+    /*! POLICY_RING_MAGIC */
+    uint32_t magic;
+
+    /*! number of slots, a power of two */
+    uint32_t numSlots;
+
+    /*! the client closed the ring, or one side died */
+    uint32_t stop;
+
+    /*! process of the client */
+    int32_t clientPid;
+
+    /*! protects the sleeps on the condition variables, robust */
+    pthread_mutex_t lock;
+
+    /*! signalled when a request is posted, on CLOCK_MONOTONIC */
+    pthread_cond_t requestCond;
+
+    /*! signalled when a response is posted or a slot is freed */
+    pthread_cond_t responseCond;
+
+    /*! next ticket of the clients */
+    uint32_t head __attribute__(( aligned( POLICY_RING_CACHE_LINE ) ));
+
+    /*! spins of the client waits */
+    uint32_t clientSpin;
+
+    /*! number of client threads sleeping */
+    uint32_t clientSleepers;
+
+    /*! next ticket of the server */
+    uint32_t tail __attribute__(( aligned( POLICY_RING_CACHE_LINE ) ));
+
+    /*! spins of the server waits */
+    uint32_t serverSpin;
+
+    /*! number of server threads sleeping */
+    uint32_t serverSleepers;
+
+    /*! slots of the ring */
+    tzPolicyRingSlot slots[] __attribute__(( aligned( POLICY_RING_CACHE_LINE ) ));
+
+} tzPolicyRing;
+
+/*==============================================================================
+                            Inline Functions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Size of the shared memory of a ring
+
+@param[in]
+    numSlots
+        number of slots of the ring
+
+@return
+    size in bytes
+
+*/
+/*============================================================================*/
+static inline size_t POLICYRING_fnSize( uint32_t numSlots )
+{
+    return sizeof(tzPolicyRing) + (size_t)numSlots * sizeof(tzPolicyRingSlot);
+}
+
+/*============================================================================*/
+/*!
+
+    Take the lock of a ring, or stop the ring if the lock owner died
+
+@param[in]
+    pRing
+        ring
+
+@param[in]
+    ret
+        result of the pthread_mutex_lock or pthread_cond_timedwait which
+        took the lock
+
+*/
+/*============================================================================*/
+static inline void POLICYRING_fnLocked( tzPolicyRing *pRing, int ret )
+{
+    if( EOWNERDEAD == ret )
+    {
+        /* the state shared under the lock is only the sleeper counts, the
+         * process which died cannot post anymore so the ring stops */
+        __atomic_store_n( &pRing->stop, 1u, __ATOMIC_SEQ_CST );
+        pthread_mutex_consistent( &pRing->lock );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Wait until a slot sequence number reaches a value or the ring stops
+
+    The wait spins up to *pSpin times, the spins grow when a spin wait
+    succeeds and shrink when the wait has to sleep.
+
+@param[in]
+    pRing
+        ring
+
+@param[in]
+    pSeq
+        sequence number to wait on
+
+@param[in]
+    expected
+        value to wait for
+
+@param[in]
+    pCond
+        condition variable to sleep on
+
+@param[in,out]
+    pSpin
+        spins of this side of the ring
+
+@param[in,out]
+    pSleepers
+        number of threads sleeping on this side of the ring
+
+@param[in]
+    peer
+        process of the other side, checked every POLICY_RING_LIVENESS_MS
+        of sleep, 0 not to check
+
+@return
+    true when the sequence number reached the value, false if the ring
+    stopped
+
+*/
+/*============================================================================*/
+static inline bool POLICYRING_fnWait( tzPolicyRing *pRing,
+                                      uint32_t *pSeq,
+                                      uint32_t expected,
+                                      pthread_cond_t *pCond,
+                                      uint32_t *pSpin,
+                                      uint32_t *pSleepers,
+                                      pid_t peer )
+{
+    uint32_t spin = __atomic_load_n( pSpin, __ATOMIC_RELAXED );
+    struct timespec deadline;
+    uint32_t i;
+    int ret;
+
+    for( i = 0; i < spin; i++ )
+    {
+        if( expected == __atomic_load_n( pSeq, __ATOMIC_ACQUIRE ) )
+        {
+            if( spin < POLICY_RING_SPIN_MAX )
+            {
+                __atomic_store_n( pSpin, spin + ( spin >> 3 ) + 1,
+                                  __ATOMIC_RELAXED );
+            }
+            return true;
+        }
+
+        if( 0u != __atomic_load_n( &pRing->stop, __ATOMIC_RELAXED ) )
+        {
+            return false;
+        }
+
+        POLICY_RING_RELAX();
+    }
+
+    if( spin > POLICY_RING_SPIN_MIN )
+    {
+        __atomic_store_n( pSpin, spin - ( spin >> 2 ), __ATOMIC_RELAXED );
+    }
+
+    /* the poster reads the sleepers after its sequence number, so either it
+     * sees this sleeper or this sleeper sees the sequence number */
+    POLICYRING_fnLocked( pRing, pthread_mutex_lock( &pRing->lock ) );
+    __atomic_add_fetch( pSleepers, 1, __ATOMIC_SEQ_CST );
+
+    while( ( expected != __atomic_load_n( pSeq, __ATOMIC_SEQ_CST ) ) &&
+           ( 0u == __atomic_load_n( &pRing->stop, __ATOMIC_SEQ_CST ) ) )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &deadline );
+        deadline.tv_sec += POLICY_RING_LIVENESS_MS / 1000;
+        deadline.tv_nsec += ( POLICY_RING_LIVENESS_MS % 1000 ) * 1000000L;
+        if( deadline.tv_nsec >= 1000000000L )
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        ret = pthread_cond_timedwait( pCond, &pRing->lock, &deadline );
+        POLICYRING_fnLocked( pRing, ret );
+
+        /* a process which died without closing the ring never posts */
+        if( ( ETIMEDOUT == ret ) && ( 0 != peer ) &&
+            ( -1 == kill( peer, 0 ) ) && ( ESRCH == errno ) )
+        {
+            __atomic_store_n( &pRing->stop, 1u, __ATOMIC_SEQ_CST );
+        }
+    }
+
+    __atomic_sub_fetch( pSleepers, 1, __ATOMIC_RELAXED );
+    pthread_mutex_unlock( &pRing->lock );
+
+    return ( expected == __atomic_load_n( pSeq, __ATOMIC_ACQUIRE ) );
+}
+
+/*============================================================================*/
+/*!
+
+    Set a slot sequence number and wake the sleepers of the other side
+
+@param[in]
+    pRing
+        ring
+
+@param[in]
+    pSeq
+        sequence number to set
+
+@param[in]
+    value
+        new sequence number
+
+@param[in]
+    pCond
+        condition variable the other side sleeps on
+
+@param[in]
+    pSleepers
+        number of threads sleeping on the other side
+
+*/
+/*============================================================================*/
+static inline void POLICYRING_fnPost( tzPolicyRing *pRing,
+                                      uint32_t *pSeq,
+                                      uint32_t value,
+                                      pthread_cond_t *pCond,
+                                      uint32_t *pSleepers )
+{
+    __atomic_store_n( pSeq, value, __ATOMIC_SEQ_CST );
+
+    if( 0u != __atomic_load_n( pSleepers, __ATOMIC_SEQ_CST ) )
+    {
+        POLICYRING_fnLocked( pRing, pthread_mutex_lock( &pRing->lock ) );
+        pthread_cond_broadcast( pCond );
+        pthread_mutex_unlock( &pRing->lock );
+    }
+}
+
+/*! @} */
+
+#endif /* POLICYRING_H_ */
@@ -0,0 +1,80 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef DPRMLOCAL_H_
+#define DPRMLOCAL_H_
+
+/*!
+ * @file dprmlocal.h
+ * @brief Public APIs of the local Data Point Resource Manager
+ *
+ * The dprmlocal.h file contains the public APIs of the Linux stand-in for
+ * the Data Point Resource Manager.
+ *
+ * @defgroup dprmlocal Local Data Point Resource Manager
+ * @brief In-process Data Point Resource Manager for Linux build hosts
+ *
+ * The library links the server modules (policy.c, hash.c and the policy
+ * engines) into the client process.  DP_fnOpen sets the server up once
+ * and returns a connection whose MsgSendv calls the message handler of
+ * the server directly, so the client library (minicloudpolicy.c), defdp
+ * and the simulator run unchanged and the policy checks take the same
+ * code paths as on the QNX server, without a kernel or a context switch
+ * in between.
+ *
+ * The policy messages and the data point find messages are attached by
+ * default, other handlers can be attached with DPRMLOCAL_fnAttach.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <sys/neutrino.h>
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! connection identifier of the local server */
+#define DPRMLOCAL_COID          ( 1 )
+
+/*! number of message codes a handler can be attached to */
+#define DPRMLOCAL_MAX_CODES     ( 1024 )
+
+/*! environment variable naming the snapshot of the local server, see
+ *  snapshot.h.  The server is restored from it by the first DP_fnOpen and
+ *  logs its changes next to it */
+#define DPRMLOCAL_SNAPSHOT_ENV  "DPRMLOCAL_SNAPSHOT"
+
+/*! environment variable naming the directory of the native rule sets the
+ *  clients may load, see policynative.h.  None is loaded without it */
+#define DPRMLOCAL_NATIVE_DIR_ENV  "DPRMLOCAL_NATIVE_DIR"
+
+/*==============================================================================
+                                  Types
+ =============================================================================*/
+
+/*! message handler, same contract as a QNX message_attach handler: reply
+ *  with MsgReply, or return an errno which fails the MsgSendv */
+typedef int (*tfnDPRMLocalHandler)( int rcvid, void *msg );
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int DPRMLOCAL_fnSetup( void );
+int DPRMLOCAL_fnAttach( uint16_t code, tfnDPRMLocalHandler pHandler );
+
+/*! @} */
+
+#endif /* DPRMLOCAL_H_ */
@@ -0,0 +1,53 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef QNXCOMPAT_H_
+#define QNXCOMPAT_H_
+
+/*!
+ * @file qnxcompat.h
+ * @brief QNX C library extensions for the Linux build
+ *
+ * The qnxcompat.h file declares the QNX C library functions which the
+ * DynPolAC sources use without a QNX specific header.  On QNX they come
+ * with <string.h> and <unistd.h>, the Linux build includes this file in
+ * every translation unit (gcc -include qnxcompat.h).
+ *
+ * @defgroup dprmlocal Local Data Point Resource Manager
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <string.h>
+#include <strings.h>
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+#ifndef EOK
+/*! QNX success code */
+#define EOK    ( 0 )
+#endif
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+char* strlwr( char *s );
+int stricmp( const char *s1, const char *s2 );
+unsigned int delay( unsigned int duration );
+
+/*! @} */
+
+#endif /* QNXCOMPAT_H_ */
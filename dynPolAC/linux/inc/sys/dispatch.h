@@ -0,0 +1,25 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef DPRMLOCAL_DISPATCH_H_
+#define DPRMLOCAL_DISPATCH_H_
+
+/*!
+ * @file dispatch.h
+ * @brief Linux stand-in for <sys/dispatch.h>
+ *
+ * The DynPolAC sources built with the local Data Point Resource Manager
+ * include <sys/dispatch.h> but use none of its declarations.
+ *
+ * @addtogroup dprmlocal
+ */
+
+#include <sys/neutrino.h>
+
+#endif /* DPRMLOCAL_DISPATCH_H_ */
@@ -0,0 +1,25 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef DPRMLOCAL_IOFUNC_H_
+#define DPRMLOCAL_IOFUNC_H_
+
+/*!
+ * @file iofunc.h
+ * @brief Linux stand-in for <sys/iofunc.h>
+ *
+ * The DynPolAC sources built with the local Data Point Resource Manager
+ * include <sys/iofunc.h> but use none of its declarations.
+ *
+ * @addtogroup dprmlocal
+ */
+
+#include <sys/neutrino.h>
+
+#endif /* DPRMLOCAL_IOFUNC_H_ */
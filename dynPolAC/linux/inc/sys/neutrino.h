@@ -0,0 +1,69 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef DPRMLOCAL_NEUTRINO_H_
+#define DPRMLOCAL_NEUTRINO_H_
+
+/*!
+ * @file neutrino.h
+ * @brief QNX kernel calls of the local Data Point Resource Manager
+ *
+ * Linux stand-in for <sys/neutrino.h>.  The message passing calls do not
+ * enter a kernel, MsgSendv runs the server handler attached to the message
+ * code on the calling thread, MsgRead copies from the gathered message and
+ * MsgReply copies the reply into the reply vectors of that MsgSendv, see
+ * dprmlocal.h.
+ *
+ * @addtogroup dprmlocal
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include "qnxcompat.h"
+
+/*==============================================================================
+                                  Types
+ =============================================================================*/
+
+/*! message vector */
+typedef struct iovec iov_t;
+
+/*==============================================================================
+                                 Macros
+ =============================================================================*/
+
+#define SETIOV( _iov, _addr, _len ) \
+    ( (_iov)->iov_base = (void *)(_addr), (_iov)->iov_len = (_len) )
+#define GETIOVBASE( _iov )    ( (_iov)->iov_base )
+#define GETIOVLEN( _iov )     ( (_iov)->iov_len )
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int MsgSendv( int coid,
+              const iov_t *siov,
+              int sparts,
+              const iov_t *riov,
+              int rparts );
+int MsgReply( int rcvid, long status, const void *msg, int size );
+ssize_t MsgRead( int rcvid, void *msg, size_t bytes, size_t offset );
+int MsgError( int rcvid, int error );
+uint64_t ClockCycles( void );
+
+/*! @} */
+
+#endif /* DPRMLOCAL_NEUTRINO_H_ */
@@ -0,0 +1,66 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef DPRMLOCAL_SYSPAGE_H_
+#define DPRMLOCAL_SYSPAGE_H_
+
+/*!
+ * @file syspage.h
+ * @brief QNX system page of the local Data Point Resource Manager
+ *
+ * Linux stand-in for <sys/syspage.h>.  ClockCycles counts nanoseconds of
+ * CLOCK_MONOTONIC, so the cycles per second of the system page are 10^9.
+ *
+ * @addtogroup dprmlocal
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+
+/*==============================================================================
+                              Structures
+==============================================================================*/
+
+/*! time information of the system page */
+struct qtime_entry
+{
+    /*! rate of ClockCycles */
+    uint64_t cycles_per_sec;
+};
+
+/*! system page entries used by DynPolAC */
+struct syspage_entry
+{
+    /*! number of CPUs online */
+    uint16_t num_cpu;
+
+    /*! time information */
+    struct qtime_entry qtime;
+};
+
+/*==============================================================================
+                                 Macros
+ =============================================================================*/
+
+#define SYSPAGE_ENTRY( _entry )    ( &_syspage_ptr->_entry )
+
+/*==============================================================================
+                          External/Public Variables
+==============================================================================*/
+
+extern struct syspage_entry *_syspage_ptr;
+
+/*! @} */
+
+#endif /* DPRMLOCAL_SYSPAGE_H_ */
@@ -0,0 +1,25 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef DPRMLOCAL_TRACE_H_
+#define DPRMLOCAL_TRACE_H_
+
+/*!
+ * @file trace.h
+ * @brief Linux stand-in for <sys/trace.h>
+ *
+ * The DynPolAC sources built with the local Data Point Resource Manager
+ * include <sys/trace.h> but use none of its declarations.
+ *
+ * @addtogroup dprmlocal
+ */
+
+#include <sys/neutrino.h>
+
+#endif /* DPRMLOCAL_TRACE_H_ */
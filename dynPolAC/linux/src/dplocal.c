@@ -0,0 +1,2290 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup dprmlocal
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  dplocal.c
+
+ @brief
+    Data point API of the local Data Point Resource Manager
+
+ @details
+    This module implements the data point calls of the client library used
+    by defdp and the simulator on top of the local server.  The data points
+    are kept in process and added to the name and GUID hash tables of
+    hash.c, their tags are interned in the tag map used by the policy
+    check.  A search (DP_fnGetFirst / DP_fnGetNext) only returns the data
+    points which pass POLICY_fnCheck, like a query of the server.
+
+    Meta data and extended data objects are accepted and not kept, the
+    policy checks do not use them.
+
+    The local server is the data point store of the bulk registration
+    (dpbulk.c): a batch is created under one acquisition of the store lock
+    and its names are added to the hash tables under one acquisition of
+    theirs.
+
+    The data points are also a section of the server snapshot (snapshot.h)
+    when DPRMLOCAL_SNAPSHOT_ENV names a snapshot.  They are saved as bulk
+    registration records with their aliases and tags, and the single calls
+    changing them are logged: a data point as a batch of one, an alias and
+    tags as entries of their own.
+
+*/
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <time.h>
+#include <regex.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include "cfuhash.h"
+#include "minicloud.h"
+#include "dp.h"
+#include "hash.h"
+#include "policy.h"
+#include "dpbulk.h"
+#include "snapshot.h"
+#include "dprmlocal.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Defines
+==============================================================================*/
+
+/*! an estimate for the number of data points to be created */
+#define DPLOCAL_ESTIMATED_NUM_DPS    ( 30000 )
+
+/*! separator of the tags of DP_fnSetTagsByName */
+#define DPLOCAL_TAG_SEPARATOR        ","
+
+/*! log entry of DP_fnAlias: the instance identifier, then the name and the
+ *  alias, NUL terminated */
+#define DPLOCAL_LOG_ALIAS            ( SNAPSHOT_LOG_STORE )
+
+/*! log entry of DP_fnSetTagsByName: the name and the tags, NUL terminated */
+#define DPLOCAL_LOG_TAGS             ( SNAPSHOT_LOG_STORE + 1u )
+
+/*! meta data key of the creation time of a data point in the snapshot */
+#define DPLOCAL_META_TIMESTAMP       "dplocal.timestamp"
+
+/*! longest default value of a number in the snapshot */
+#define DPLOCAL_VALUE_LENGTH         ( 32 )
+
+/*=============================================================================
+ 	 	 	 	 	 	 	 	 Structures
+ =============================================================================*/
+
+/*! data point of the local server */
+typedef struct zLocalDp
+{
+    /*! identification added to the hash tables */
+    struct dp_id_t id;
+
+    /*! content checked by the policy */
+    struct dp_t dp;
+
+    /*! DP_FLAG flags of the data point */
+    uint16_t flags;
+
+    /*! position in the data point list */
+    int index;
+
+    /*! number of tags of the data point */
+    int numTags;
+
+    /*! aliases of the data point, NUL terminated one after the other */
+    char *pAliases;
+
+    /*! length of the aliases */
+    size_t aliasLength;
+
+    /*! number of aliases */
+    uint16_t numAliases;
+
+} tzLocalDp;
+
+/*! search of a connection */
+typedef struct zLocalSearch
+{
+    /*! identifier of the search, returned as the first context id */
+    uint32_t id;
+
+    /*! data point name to match, NULL matches all */
+    char *pKey;
+
+    /*! how the key matches the data point name */
+    teMatchType matchType;
+
+    /*! the key is a compiled regular expression */
+    bool isRegex;
+
+    /*! the search can return data points */
+    bool isValid;
+
+    /*! compiled key */
+    regex_t regex;
+
+    /*! tag to match, NULL matches all */
+    char *pTag;
+
+} tzLocalSearch;
+
+/*! connection to the local server, starts like the tzDPRM of the client
+ *  library */
+typedef struct zLocalDPRM
+{
+    /*! unused, no synchronisation signals */
+    int chid;
+
+    /*! unused, no synchronisation signals */
+    int coid;
+
+    /*! connection of the local server */
+    int handle;
+
+    /*! pointer to the client's shared memory buffer */
+    char *pSharedMem;
+
+    /*! length of the shared memory */
+    size_t shmem_size;
+
+    /* handle to the shared memory file descriptor */
+    int shmem_fd;
+
+    /*! active search of the connection */
+    tzLocalSearch search;
+
+} tzLocalDPRM;
+
+/*==============================================================================
+ 	 	 	 	 	 	 External/Public Variables
+ =============================================================================*/
+
+/*! data point tags, see policy.c */
+extern char *tagMap[];
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Variables
+ =============================================================================*/
+
+/*! the store is set up by the first connection */
+static pthread_once_t storeOnce = PTHREAD_ONCE_INIT;
+
+/*! lock of the data point list and the tag table */
+static pthread_rwlock_t storeLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*! data points in the order of their registration */
+static tzLocalDp **dps = NULL;
+
+/*! number of data points */
+static int numDps = 0;
+
+/*! size of the data point list */
+static int maxDps = 0;
+
+/*! hash table mapping a data point name or alias to its data point */
+static cfuhash_table_t *names = NULL;
+
+/*! hash table mapping a tag to its tag map index */
+static cfuhash_table_t *tags = NULL;
+
+/*! number of interned tags */
+static int numTags = 0;
+
+/*! last search identifier */
+static uint32_t lastSearch = 0;
+
+/*==============================================================================
+ Local/Private Function Prototypes
+ =============================================================================*/
+
+static void dplocal_fnInit( void );
+static int dplocal_fnCreate( uint32_t instanceID,
+                             DP_tzINFO *pInfo,
+                             tzLocalDp **ppLocal );
+static void dplocal_fnDestroy( tzLocalDp *pLocal );
+static int dplocal_fnGrow( int num );
+static void dplocal_fnInsert( tzLocalDp *pLocal );
+static int dplocal_fnAddTags( tzLocalDp *pLocal, const char *pTags );
+static int dplocal_fnAlias( tzLocalDp *pLocal, char *pAlias );
+static int dplocal_fnKeepAlias( tzLocalDp *pLocal, const char *pAlias );
+static int dplocal_fnSetTags( char *pName, char *pTags );
+static int dplocal_fnStore( const tzDpBulkPoint *pPoints,
+                            uint32_t numPoints,
+                            int32_t *pResults,
+                            const struct timespec *pTimes );
+static int dplocal_fnBulkStore( const tzDpBulkPoint *pPoints,
+                                uint32_t numPoints,
+                                int32_t *pResults,
+                                void *pContext );
+static int dplocal_fnSave( FILE *fp, void *pContext );
+static int dplocal_fnLoad( void *pData, size_t length, void *pContext );
+static int dplocal_fnAddRecord( tzDpBulk *pBulk, FILE *fp, tzLocalDp *pLocal );
+static char* dplocal_fnFormat( tzLocalDp *pLocal, char *pBuf, size_t len );
+static int dplocal_fnReplayAlias( void *pData, size_t length, void *pContext );
+static int dplocal_fnReplayTags( void *pData, size_t length, void *pContext );
+static int dplocal_fnSetValue( tzLocalDp *pLocal, int type, char *pValue );
+static int dplocal_fnInternTag( char *pTag );
+static void dplocal_fnEndSearch( tzLocalSearch *pSearch );
+static tzLocalDp* dplocal_fnSearch( tzLocalSearch *pSearch, int first );
+static bool dplocal_fnMatch( tzLocalSearch *pSearch, tzLocalDp *pLocal );
+
+/*==============================================================================
+ Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+//fn  DP_fnOpen
+/*!
+
+@brief
+    Open a connection to the local server
+
+    The local server is set up, and restored from its snapshot, by the
+    first connection.
+
+@return
+    handle of the connection, NULL on failure
+
+*/
+/*============================================================================*/
+DPRM_HANDLE DP_fnOpen( void )
+{
+    tzLocalDPRM *pDPRM;
+
+    DPRMLOCAL_fnSetup();
+    pthread_once( &storeOnce, dplocal_fnInit );
+
+    pDPRM = calloc( 1, sizeof(tzLocalDPRM) );
+    if( NULL != pDPRM )
+    {
+        pDPRM->chid = -1;
+        pDPRM->coid = -1;
+        pDPRM->handle = DPRMLOCAL_COID;
+        pDPRM->shmem_fd = -1;
+    }
+
+    return (DPRM_HANDLE)pDPRM;
+}
+
+/*============================================================================*/
+//fn  DP_fnClose
+/*!
+
+@brief
+    Close a connection to the local server
+
+    The data points stay in the server.
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+*/
+/*============================================================================*/
+void DP_fnClose( DPRM_HANDLE hDPRM )
+{
+    tzLocalDPRM *pDPRM = (tzLocalDPRM *)hDPRM;
+
+    if( NULL != pDPRM )
+    {
+        dplocal_fnEndSearch( &pDPRM->search );
+
+        if( NULL != pDPRM->pSharedMem )
+        {
+            munmap( pDPRM->pSharedMem, pDPRM->shmem_size );
+        }
+
+        free( pDPRM );
+    }
+}
+
+/*============================================================================*/
+//fn  DP_fnCreateMem
+/*!
+
+@brief
+    Create the buffer shared with the server
+
+    The local server runs in the client process, the buffer is anonymous
+    memory.
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+@param[in]
+    size
+        size of the buffer
+
+@param[out]
+    pFd
+        file descriptor of the buffer, always -1
+
+@return
+    pointer to the buffer, NULL on failure
+
+*/
+/*============================================================================*/
+char* DP_fnCreateMem( DPRM_HANDLE hDPRM, long size, int *pFd )
+{
+    tzLocalDPRM *pDPRM = (tzLocalDPRM *)hDPRM;
+    void *pMem;
+
+    if( ( NULL == pDPRM ) || ( size <= 0 ) || ( NULL != pDPRM->pSharedMem ) )
+    {
+        return NULL;
+    }
+
+    pMem = mmap( NULL,
+                 (size_t)size,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS,
+                 -1,
+                 0 );
+    if( MAP_FAILED == pMem )
+    {
+        return NULL;
+    }
+
+    pDPRM->pSharedMem = pMem;
+    pDPRM->shmem_size = (size_t)size;
+
+    if( NULL != pFd )
+    {
+        *pFd = pDPRM->shmem_fd;
+    }
+
+    return pDPRM->pSharedMem;
+}
+
+/*============================================================================*/
+//fn  DP_fnRegister
+/*!
+
+@brief
+    Create a data point
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+@param[in]
+    instanceID
+        instance identifier of the data point
+
+@param[in]
+    pInfo
+        name, GUID, type, flags and default value of the data point
+
+@return
+    EOK on success, EEXIST if the data point already exists, or any other
+    error code from errno.h
+
+*/
+/*============================================================================*/
+int DP_fnRegister( DPRM_HANDLE hDPRM, uint32_t instanceID, DP_tzINFO *pInfo )
+{
+    DP_tzINFO info;
+    tzDpBulk bulk;
+    tzDpBulkPoint point;
+    size_t offset = 0;
+    int32_t result = EOK;
+    int ret;
+
+    if( ( NULL == hDPRM ) || ( NULL == pInfo ) || ( NULL == pInfo->pName ) )
+    {
+        return EINVAL;
+    }
+
+    if( NULL != HASH_fnLookupByName( pInfo->pName, instanceID ) )
+    {
+        return EEXIST;
+    }
+
+    /* the data point is created as a batch of one, which is logged like the
+     * batches of the bulk registration */
+    info = *pInfo;
+    info.fmt = ( NULL != pInfo->fmt ) ? pInfo->fmt : "";
+    info.pDefaultValue = ( NULL != pInfo->pDefaultValue )
+                         ? pInfo->pDefaultValue
+                         : "";
+
+    DP_fnBulkInit( &bulk );
+    ret = DP_fnBulkAdd( &bulk, instanceID, &info, NULL, 0, NULL );
+    if( EOK == ret )
+    {
+        ret = DP_fnBulkNext( bulk.pBuf, bulk.length, &offset, &point );
+    }
+
+    if( EOK == ret )
+    {
+        ret = SNAPSHOT_fnBegin( SNAPSHOT_LOG_DP_BULK, bulk.pBuf, bulk.length );
+        if( EOK == ret )
+        {
+            ret = dplocal_fnStore( &point, 1u, &result, NULL );
+        }
+
+        SNAPSHOT_fnEnd();
+    }
+
+    DP_fnBulkFree( &bulk );
+
+    return ( EOK == ret ) ? result : ret;
+}
+
+/*============================================================================*/
+//fn  DP_fnFindByName
+/*!
+
+@brief
+    Find a data point by its name or one of its aliases
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+@param[in]
+    pName
+        name of the data point
+
+@return
+    handle of the data point, NULL if not found
+
+*/
+/*============================================================================*/
+DP_HANDLE DP_fnFindByName( DPRM_HANDLE hDPRM, char *pName )
+{
+    tzLocalDp *pLocal = NULL;
+
+    if( ( NULL != hDPRM ) && ( NULL != pName ) )
+    {
+        pthread_rwlock_rdlock( &storeLock );
+        pLocal = cfuhash_get( names, pName );
+        pthread_rwlock_unlock( &storeLock );
+    }
+
+    return (DP_HANDLE)pLocal;
+}
+
+/*============================================================================*/
+//fn  DP_fnAlias
+/*!
+
+@brief
+    Add another name of a data point
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+@param[in]
+    hDataPoint
+        handle of the data point
+
+@param[in]
+    pAlias
+        other name of the data point
+
+@param[in]
+    options
+        DP_OPTIONS_NONE
+
+@return
+    EOK on success, EEXIST if the name is already used
+
+*/
+/*============================================================================*/
+int DP_fnAlias( DPRM_HANDLE hDPRM,
+                DP_HANDLE hDataPoint,
+                char *pAlias,
+                int options )
+{
+    tzLocalDp *pLocal = (tzLocalDp *)hDataPoint;
+    size_t nameLength;
+    size_t length;
+    char *pEntry;
+    int ret = EOK;
+
+    (void)options;
+
+    if( ( NULL == hDPRM ) || ( NULL == pLocal ) || ( NULL == pAlias ) )
+    {
+        return EINVAL;
+    }
+
+    nameLength = strlen( pLocal->id.pName ) + 1u;
+    length = sizeof(uint32_t) + nameLength + strlen( pAlias ) + 1u;
+    pEntry = malloc( length );
+    if( NULL == pEntry )
+    {
+        return ENOMEM;
+    }
+
+    memcpy( pEntry, &pLocal->id.instanceID, sizeof(uint32_t) );
+    memcpy( pEntry + sizeof(uint32_t), pLocal->id.pName, nameLength );
+    strcpy( pEntry + sizeof(uint32_t) + nameLength, pAlias );
+
+    ret = SNAPSHOT_fnBegin( DPLOCAL_LOG_ALIAS, pEntry, length );
+    if( EOK == ret )
+    {
+        ret = dplocal_fnAlias( pLocal, pAlias );
+    }
+
+    SNAPSHOT_fnEnd();
+
+    free( pEntry );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  DP_fnSetTagsByName
+/*!
+
+@brief
+    Add tags to a data point
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+@param[in]
+    pName
+        name of the data point
+
+@param[in]
+    pTags
+        comma separated tags, e.g. "type:temperature,location:Tesla"
+
+@param[in]
+    options
+        unused
+
+@return
+    EOK on success, ENOENT if the data point does not exist, ENOSPC if the
+    data point or the tag map is full
+
+*/
+/*============================================================================*/
+int DP_fnSetTagsByName( DPRM_HANDLE hDPRM,
+                        char *pName,
+                        char *pTags,
+                        int options )
+{
+    size_t nameLength;
+    size_t length;
+    char *pEntry;
+    int ret;
+
+    (void)options;
+
+    if( ( NULL == DP_fnFindByName( hDPRM, pName ) ) || ( NULL == pTags ) )
+    {
+        return ENOENT;
+    }
+
+    nameLength = strlen( pName ) + 1u;
+    length = nameLength + strlen( pTags ) + 1u;
+    pEntry = malloc( length );
+    if( NULL == pEntry )
+    {
+        return ENOMEM;
+    }
+
+    memcpy( pEntry, pName, nameLength );
+    strcpy( pEntry + nameLength, pTags );
+
+    ret = SNAPSHOT_fnBegin( DPLOCAL_LOG_TAGS, pEntry, length );
+    if( EOK == ret )
+    {
+        ret = dplocal_fnSetTags( pName, pTags );
+    }
+
+    SNAPSHOT_fnEnd();
+
+    free( pEntry );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  DP_fnMetaDataInit
+/*!
+
+@brief
+    Create a meta data object, the local server does not keep meta data
+
+@return
+    an empty meta data object, NULL on failure
+
+*/
+/*============================================================================*/
+tzDataPointMetaData* DP_fnMetaDataInit( DPRM_HANDLE hDPRM, int options )
+{
+    (void)hDPRM;
+    (void)options;
+
+    return calloc( 1, sizeof(tzDataPointMetaData) );
+}
+
+/*============================================================================*/
+//fn  DP_fnMetaDataAdd
+/*!
+
+@brief
+    Add a meta data item, the local server does not keep meta data
+
+@return
+    EOK
+
+*/
+/*============================================================================*/
+int DP_fnMetaDataAdd( DPRM_HANDLE hDPRM,
+                      tzDataPointMetaData *pMetaData,
+                      char *pName,
+                      char *pValue,
+                      int options )
+{
+    (void)hDPRM;
+    (void)pMetaData;
+    (void)pName;
+    (void)pValue;
+    (void)options;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  DP_fnMetaDataAssign
+/*!
+
+@brief
+    Assign meta data to a data point, the local server does not keep meta
+    data
+
+@return
+    EOK
+
+*/
+/*============================================================================*/
+int DP_fnMetaDataAssign( DPRM_HANDLE hDPRM,
+                         DP_HANDLE hDataPoint,
+                         tzDataPointMetaData *pMetaData,
+                         int options )
+{
+    (void)hDPRM;
+    (void)hDataPoint;
+    (void)pMetaData;
+    (void)options;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  DP_fnSetExtData
+/*!
+
+@brief
+    Set an extended data object, the local server does not keep extended
+    data objects
+
+@return
+    EOK
+
+*/
+/*============================================================================*/
+int DP_fnSetExtData( DPRM_HANDLE hDPRM,
+                     DP_HANDLE hDataPoint,
+                     void *pExtData,
+                     size_t size,
+                     int options )
+{
+    (void)hDPRM;
+    (void)hDataPoint;
+    (void)pExtData;
+    (void)size;
+    (void)options;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  DP_fnGetFirst
+/*!
+
+@brief
+    Start a search of the data points
+
+    The search returns the data points whose name matches the key and which
+    have a tag containing the tag, and which pass the policy check.  A new
+    search of the connection ends the previous one.
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+@param[in]
+    options
+        unused
+
+@param[in]
+    key
+        data point name to match, NULL or empty matches all
+
+@param[in]
+    matchType
+        eMatchContains for a sub string of the name, eMatchRegex for an
+        extended regular expression, otherwise the exact name
+
+@param[in]
+    tag
+        sub string of a tag, NULL or empty matches all
+
+@param[in]
+    tagMatchType
+        unused, the tag is always a sub string
+
+@param[in]
+    value
+        unused
+
+@param[in]
+    valMatchType
+        unused
+
+@param[in]
+    flags
+        unused
+
+@param[out]
+    pContextID1
+        identifier of the search
+
+@param[out]
+    pContextID2
+        0
+
+@param[in]
+    pValueData
+        unused
+
+@return
+    handle of the first data point, NULL if none
+
+*/
+/*============================================================================*/
+DP_HANDLE DP_fnGetFirst( DPRM_HANDLE hDPRM,
+                         int options,
+                         char *key,
+                         teMatchType matchType,
+                         char *tag,
+                         teTagMatchType tagMatchType,
+                         char *value,
+                         teValMatchType valMatchType,
+                         uint16_t flags,
+                         uint32_t *pContextID1,
+                         uint32_t *pContextID2,
+                         tzDataPointValueData *pValueData )
+{
+    tzLocalDPRM *pDPRM = (tzLocalDPRM *)hDPRM;
+    tzLocalSearch *pSearch;
+
+    (void)options;
+    (void)tagMatchType;
+    (void)value;
+    (void)valMatchType;
+    (void)flags;
+    (void)pValueData;
+
+    if( NULL == pDPRM )
+    {
+        return NULL;
+    }
+
+    pSearch = &pDPRM->search;
+    dplocal_fnEndSearch( pSearch );
+
+    pSearch->id = __atomic_add_fetch( &lastSearch, 1, __ATOMIC_RELAXED );
+    pSearch->isValid = true;
+
+    if( ( NULL != key ) && ( '\0' != key[0] ) )
+    {
+        pSearch->pKey = strdup( key );
+        pSearch->matchType = matchType;
+
+        if( eMatchRegex == matchType )
+        {
+            /* a regular expression that does not compile matches nothing */
+            pSearch->isRegex = ( 0 == regcomp( &pSearch->regex,
+                                               key,
+                                               REG_EXTENDED | REG_NOSUB ) );
+            pSearch->isValid = pSearch->isRegex;
+        }
+    }
+
+    if( ( NULL != tag ) && ( '\0' != tag[0] ) )
+    {
+        pSearch->pTag = strdup( tag );
+    }
+
+    if( NULL != pContextID1 )
+    {
+        *pContextID1 = pSearch->id;
+    }
+
+    if( NULL != pContextID2 )
+    {
+        *pContextID2 = 0;
+    }
+
+    return (DP_HANDLE)dplocal_fnSearch( pSearch, 0 );
+}
+
+/*============================================================================*/
+//fn  DP_fnGetNext
+/*!
+
+@brief
+    Continue a search of the data points
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+@param[in]
+    options
+        unused
+
+@param[in]
+    hDataPoint
+        data point returned by the previous call
+
+@param[in]
+    key
+        unused, the key of DP_fnGetFirst is kept
+
+@param[in]
+    matchType
+        unused
+
+@param[in]
+    tagMatchType
+        unused
+
+@param[in]
+    flags
+        unused
+
+@param[in]
+    contextID1
+        identifier of the search returned by DP_fnGetFirst
+
+@param[in]
+    contextID2
+        unused
+
+@param[in]
+    pValueData
+        unused
+
+@return
+    handle of the next data point, NULL at the end of the search
+
+*/
+/*============================================================================*/
+DP_HANDLE DP_fnGetNext( DPRM_HANDLE hDPRM,
+                        int options,
+                        DP_HANDLE hDataPoint,
+                        char *key,
+                        teMatchType matchType,
+                        teTagMatchType tagMatchType,
+                        uint16_t flags,
+                        uint32_t contextID1,
+                        uint32_t contextID2,
+                        tzDataPointValueData *pValueData )
+{
+    tzLocalDPRM *pDPRM = (tzLocalDPRM *)hDPRM;
+    tzLocalDp *pLocal = (tzLocalDp *)hDataPoint;
+
+    (void)options;
+    (void)key;
+    (void)matchType;
+    (void)tagMatchType;
+    (void)flags;
+    (void)contextID2;
+    (void)pValueData;
+
+    if( ( NULL == pDPRM ) || ( NULL == pLocal ) ||
+        ( contextID1 != pDPRM->search.id ) )
+    {
+        return NULL;
+    }
+
+    return (DP_HANDLE)dplocal_fnSearch( &pDPRM->search, pLocal->index + 1 );
+}
+
+/*============================================================================*/
+//fn  DP_fnQuery
+/*!
+
+@brief
+    Query the information of a data point
+
+@param[in]
+    hDPRM
+        handle of the connection
+
+@param[in]
+    hDataPoint
+        handle of the data point
+
+@param[in]
+    queryType
+        eBasicQuery
+
+@param[out]
+    pQuery
+        flags, instance identifier, GUID and timestamp of the data point
+
+@param[in]
+    pBuf
+        unused
+
+@param[in]
+    bufLen
+        unused
+
+@return
+    EOK on success, EINVAL if an argument is missing
+
+*/
+/*============================================================================*/
+int DP_fnQuery( DPRM_HANDLE hDPRM,
+                DP_HANDLE hDataPoint,
+                int queryType,
+                DP_tzQUERY *pQuery,
+                void *pBuf,
+                int bufLen )
+{
+    tzLocalDp *pLocal = (tzLocalDp *)hDataPoint;
+
+    (void)queryType;
+    (void)pBuf;
+    (void)bufLen;
+
+    if( ( NULL == hDPRM ) || ( NULL == pLocal ) || ( NULL == pQuery ) )
+    {
+        return EINVAL;
+    }
+
+    pQuery->flags = pLocal->flags;
+    pQuery->instanceID = pLocal->id.instanceID;
+    pQuery->guid = pLocal->id.ulName;
+    pQuery->timestamp = pLocal->dp.dpdata.timestamp;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  DP_fnPrintName
+/*!
+
+@brief
+    Print the name of a data point
+
+*/
+/*============================================================================*/
+void DP_fnPrintName( DPRM_HANDLE hDPRM,
+                     FILE *fp,
+                     DP_HANDLE hDataPoint,
+                     int access )
+{
+    tzLocalDp *pLocal = (tzLocalDp *)hDataPoint;
+
+    (void)hDPRM;
+    (void)access;
+
+    if( ( NULL != fp ) && ( NULL != pLocal ) )
+    {
+        fprintf( fp, "%s", pLocal->id.pName );
+    }
+}
+
+/*============================================================================*/
+//fn  DP_fnPrint
+/*!
+
+@brief
+    Print the value of a data point
+
+*/
+/*============================================================================*/
+void DP_fnPrint( DPRM_HANDLE hDPRM,
+                 FILE *fp,
+                 DP_HANDLE hDataPoint,
+                 int options,
+                 int access )
+{
+    tzLocalDp *pLocal = (tzLocalDp *)hDataPoint;
+    struct dp_data_t *pData;
+
+    (void)hDPRM;
+    (void)options;
+    (void)access;
+
+    if( ( NULL == fp ) || ( NULL == pLocal ) )
+    {
+        return;
+    }
+
+    pData = &pLocal->dp.dpdata;
+
+    switch( pData->type )
+    {
+    case DP_TYPE_UINT16:
+        fprintf( fp, "%u", (unsigned)pData->val.uiVal );
+        break;
+    case DP_TYPE_SINT16:
+        fprintf( fp, "%d", (int)pData->val.siVal );
+        break;
+    case DP_TYPE_UINT32:
+        fprintf( fp, "%lu", (unsigned long)pData->val.ulVal );
+        break;
+    case DP_TYPE_SINT32:
+        fprintf( fp, "%ld", (long)pData->val.slVal );
+        break;
+    case DP_TYPE_FLOAT32:
+        fprintf( fp, "%f", (double)pData->val.fVal );
+        break;
+    case DP_TYPE_STR:
+        fprintf( fp, "%s", ( NULL != pData->val.pStr ) ? pData->val.pStr : "" );
+        break;
+    default:
+        fprintf( fp, "<%lu bytes>", (unsigned long)pData->len );
+        break;
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Set up the store, then restore it from the snapshot named by
+    DPRMLOCAL_SNAPSHOT_ENV if there is one
+
+    The store and its log entries are registered with the snapshot before
+    it is opened, the policy section is registered by SNAPSHOT_fnOpen.
+
+*/
+/*============================================================================*/
+static void dplocal_fnInit( void )
+{
+    char *pPath;
+    int ret;
+
+    names = cfuhash_new_with_initial_size( DPLOCAL_ESTIMATED_NUM_DPS );
+    tags = cfuhash_new_with_initial_size( DP_SERVER_MAX_TAGS );
+    cfuhash_set_flag( names, CFUHASH_NO_LOCKING );
+    cfuhash_set_flag( tags, CFUHASH_NO_LOCKING );
+    DPBULK_fnSetStore( dplocal_fnBulkStore, NULL );
+
+    SNAPSHOT_fnAddSection( SNAPSHOT_SECTION_STORE,
+                           dplocal_fnSave,
+                           dplocal_fnLoad,
+                           NULL );
+    SNAPSHOT_fnAttach( DPLOCAL_LOG_ALIAS, dplocal_fnReplayAlias, NULL );
+    SNAPSHOT_fnAttach( DPLOCAL_LOG_TAGS, dplocal_fnReplayTags, NULL );
+
+    pPath = getenv( DPRMLOCAL_SNAPSHOT_ENV );
+    if( ( NULL != pPath ) && ( '\0' != pPath[0] ) )
+    {
+        ret = SNAPSHOT_fnOpen( pPath );
+        if( EOK != ret )
+        {
+            syslog( LOG_ERR,
+                    "cannot restore the snapshot %s: %s",
+                    pPath,
+                    strerror( ret ) );
+        }
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Create a data point, it is not in the store yet
+
+@param[in]
+    instanceID
+        instance identifier of the data point
+
+@param[in]
+    pInfo
+        name, GUID, type, flags and default value of the data point
+
+@param[out]
+    ppLocal
+        the data point
+
+@return
+    EOK on success, or an error code from errno.h
+
+*/
+/*============================================================================*/
+static int dplocal_fnCreate( uint32_t instanceID,
+                             DP_tzINFO *pInfo,
+                             tzLocalDp **ppLocal )
+{
+    tzLocalDp *pLocal;
+    int ret;
+
+    pLocal = calloc( 1, sizeof(tzLocalDp) );
+    if( NULL == pLocal )
+    {
+        return ENOMEM;
+    }
+
+    pLocal->id.pName = strdup( pInfo->pName );
+    pLocal->id.ulName = pInfo->ulName;
+    pLocal->id.instanceID = instanceID;
+    pLocal->flags = pInfo->flags;
+    clock_gettime( CLOCK_REALTIME, &pLocal->dp.dpdata.timestamp );
+
+    ret = ( NULL == pLocal->id.pName )
+          ? ENOMEM
+          : dplocal_fnSetValue( pLocal, pInfo->type, pInfo->pDefaultValue );
+    if( EOK != ret )
+    {
+        dplocal_fnDestroy( pLocal );
+        pLocal = NULL;
+    }
+
+    *ppLocal = pLocal;
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Free a data point which is not in the store
+
+@param[in]
+    pLocal
+        the data point
+
+*/
+/*============================================================================*/
+static void dplocal_fnDestroy( tzLocalDp *pLocal )
+{
+    if( NULL != pLocal )
+    {
+        free( pLocal->id.pName );
+        free( pLocal->pAliases );
+        free( pLocal );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Make room in the data point list, the store lock is held for writing
+
+@param[in]
+    num
+        number of data points to be inserted
+
+@return
+    EOK or ENOMEM
+
+*/
+/*============================================================================*/
+static int dplocal_fnGrow( int num )
+{
+    tzLocalDp **pGrown;
+    int size = maxDps;
+
+    if( numDps + num <= maxDps )
+    {
+        return EOK;
+    }
+
+    while( size < numDps + num )
+    {
+        size = size * 2 + 64;
+    }
+
+    pGrown = realloc( dps, sizeof(tzLocalDp *) * size );
+    if( NULL == pGrown )
+    {
+        return ENOMEM;
+    }
+
+    dps = pGrown;
+    maxDps = size;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Insert a data point in the list and the name table, the store lock is
+    held for writing and dplocal_fnGrow made room for it
+
+@param[in]
+    pLocal
+        the data point
+
+*/
+/*============================================================================*/
+static void dplocal_fnInsert( tzLocalDp *pLocal )
+{
+    pLocal->index = numDps;
+    dps[ numDps++ ] = pLocal;
+
+    /* the first data point of a name is found by DP_fnFindByName */
+    if( NULL == cfuhash_get( names, pLocal->id.pName ) )
+    {
+        cfuhash_put( names, pLocal->id.pName, pLocal );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Add tags to a data point, the store lock is held for writing
+
+@param[in]
+    pLocal
+        the data point
+
+@param[in]
+    pTags
+        comma separated tags
+
+@return
+    EOK on success, ENOSPC if the data point or the tag map is full
+
+*/
+/*============================================================================*/
+static int dplocal_fnAddTags( tzLocalDp *pLocal, const char *pTags )
+{
+    const int maxTags = (int)( sizeof(((struct dp_t *)0)->dpdata.tags) /
+                               sizeof(((struct dp_t *)0)->dpdata.tags[0]) ) - 1;
+    char *pList;
+    char *pSave = NULL;
+    char *pTag;
+    int tagId;
+    int ret = EOK;
+
+    pList = strdup( pTags );
+    if( NULL == pList )
+    {
+        return ENOMEM;
+    }
+
+    for( pTag = strtok_r( pList, DPLOCAL_TAG_SEPARATOR, &pSave );
+         ( NULL != pTag ) && ( EOK == ret );
+         pTag = strtok_r( NULL, DPLOCAL_TAG_SEPARATOR, &pSave ) )
+    {
+        tagId = dplocal_fnInternTag( pTag );
+        if( ( 0 == tagId ) || ( pLocal->numTags >= maxTags ) )
+        {
+            ret = ENOSPC;
+        }
+        else
+        {
+            /* the tag list stays terminated by 0 */
+            pLocal->dp.dpdata.tags[ pLocal->numTags++ ] = tagId;
+        }
+    }
+
+    free( pList );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Add another name to a data point of the store
+
+@param[in]
+    pLocal
+        the data point
+
+@param[in]
+    pAlias
+        other name of the data point
+
+@return
+    EOK on success, EEXIST if the name is already used
+
+*/
+/*============================================================================*/
+static int dplocal_fnAlias( tzLocalDp *pLocal, char *pAlias )
+{
+    int ret = EOK;
+
+    pthread_rwlock_wrlock( &storeLock );
+    if( NULL != cfuhash_get( names, pAlias ) )
+    {
+        ret = EEXIST;
+    }
+    else
+    {
+        cfuhash_put( names, pAlias, pLocal );
+        if( EOK != dplocal_fnKeepAlias( pLocal, pAlias ) )
+        {
+            syslog( LOG_ERR, "alias %s is not kept in the snapshot", pAlias );
+        }
+    }
+    pthread_rwlock_unlock( &storeLock );
+
+    if( EOK == ret )
+    {
+        ret = HASH_fnAdd( &pLocal->id, pAlias );
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Append an alias to the aliases kept by a data point for the snapshot,
+    the store lock is held for writing
+
+@param[in]
+    pLocal
+        the data point
+
+@param[in]
+    pAlias
+        the alias
+
+@return
+    EOK or ENOMEM
+
+*/
+/*============================================================================*/
+static int dplocal_fnKeepAlias( tzLocalDp *pLocal, const char *pAlias )
+{
+    size_t len = strlen( pAlias ) + 1u;
+    char *pGrown;
+
+    if( UINT16_MAX == pLocal->numAliases )
+    {
+        return ENOSPC;
+    }
+
+    pGrown = realloc( pLocal->pAliases, pLocal->aliasLength + len );
+    if( NULL == pGrown )
+    {
+        return ENOMEM;
+    }
+
+    memcpy( pGrown + pLocal->aliasLength, pAlias, len );
+    pLocal->pAliases = pGrown;
+    pLocal->aliasLength += len;
+    pLocal->numAliases++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Add tags to a data point found by its name
+
+@param[in]
+    pName
+        name or alias of the data point
+
+@param[in]
+    pTags
+        comma separated tags
+
+@return
+    EOK on success, ENOENT if the data point does not exist, ENOSPC if the
+    data point or the tag map is full
+
+*/
+/*============================================================================*/
+static int dplocal_fnSetTags( char *pName, char *pTags )
+{
+    tzLocalDp *pLocal;
+    int ret = ENOENT;
+
+    pthread_rwlock_wrlock( &storeLock );
+    pLocal = cfuhash_get( names, pName );
+    if( NULL != pLocal )
+    {
+        ret = dplocal_fnAddTags( pLocal, pTags );
+    }
+    pthread_rwlock_unlock( &storeLock );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Create the data points of a bulk registration, see tfnDpBulkStore
+
+@param[in]
+    pPoints
+        the data points
+
+@param[in]
+    numPoints
+        number of data points
+
+@param[out]
+    pResults
+        result of each data point
+
+@param[in]
+    pContext
+        unused
+
+@return
+    EOK on success, ENOMEM if no data point could be created
+
+*/
+/*============================================================================*/
+static int dplocal_fnBulkStore( const tzDpBulkPoint *pPoints,
+                                uint32_t numPoints,
+                                int32_t *pResults,
+                                void *pContext )
+{
+    (void)pContext;
+
+    return dplocal_fnStore( pPoints, numPoints, pResults, NULL );
+}
+
+/*============================================================================*/
+/*!
+
+    Create a batch of data points
+
+    The data points are allocated before the store lock is taken, then
+    inserted with their aliases and tags under one acquisition of the lock,
+    and their names are added to the hash tables under one acquisition of
+    the hash lock.  A failed alias or tag does not fail its data point, it
+    is logged like the single calls of defdp do.
+
+@param[in]
+    pPoints
+        the data points
+
+@param[in]
+    numPoints
+        number of data points
+
+@param[out]
+    pResults
+        result of each data point
+
+@param[in]
+    pTimes
+        creation time of each data point, a zero time or a NULL array for
+        now
+
+@return
+    EOK on success, ENOMEM if no data point could be created
+
+*/
+/*============================================================================*/
+static int dplocal_fnStore( const tzDpBulkPoint *pPoints,
+                            uint32_t numPoints,
+                            int32_t *pResults,
+                            const struct timespec *pTimes )
+{
+    tzLocalDp **ppLocals;
+    struct dp_id_t **ppIds;
+    char **ppNames;
+    tzLocalDp *pFirst;
+    char *pAlias;
+    uint32_t maxNames = numPoints;
+    uint32_t numNames = 0;
+    uint32_t i;
+    uint16_t j;
+    int firstIndex;
+    int ret;
+
+    for( i = 0; i < numPoints; i++ )
+    {
+        maxNames += pPoints[i].numAliases;
+    }
+
+    ppLocals = calloc( numPoints, sizeof(tzLocalDp *) );
+    ppIds = malloc( maxNames * sizeof(struct dp_id_t *) );
+    ppNames = malloc( maxNames * sizeof(char *) );
+    if( ( NULL == ppLocals ) || ( NULL == ppIds ) || ( NULL == ppNames ) )
+    {
+        free( ppLocals );
+        free( ppIds );
+        free( ppNames );
+        return ENOMEM;
+    }
+
+    /* allocate the data points outside the lock */
+    for( i = 0; i < numPoints; i++ )
+    {
+        if( NULL != HASH_fnLookupByName( pPoints[i].info.pName,
+                                         pPoints[i].instanceID ) )
+        {
+            pResults[i] = EEXIST;
+        }
+        else
+        {
+            pResults[i] = dplocal_fnCreate( pPoints[i].instanceID,
+                                            (DP_tzINFO *)&pPoints[i].info,
+                                            &ppLocals[i] );
+        }
+
+        if( ( NULL != pTimes ) && ( NULL != ppLocals[i] ) &&
+            ( ( 0 != pTimes[i].tv_sec ) || ( 0 != pTimes[i].tv_nsec ) ) )
+        {
+            ppLocals[i]->dp.dpdata.timestamp = pTimes[i];
+        }
+    }
+
+    pthread_rwlock_wrlock( &storeLock );
+
+    firstIndex = numDps;
+    ret = dplocal_fnGrow( (int)numPoints );
+
+    for( i = 0; ( i < numPoints ) && ( EOK == ret ); i++ )
+    {
+        if( NULL == ppLocals[i] )
+        {
+            continue;
+        }
+
+        /* a name repeated in the batch */
+        pFirst = cfuhash_get( names, ppLocals[i]->id.pName );
+        if( ( NULL != pFirst ) && ( pFirst->index >= firstIndex ) &&
+            ( pFirst->id.instanceID == ppLocals[i]->id.instanceID ) )
+        {
+            pResults[i] = EEXIST;
+            dplocal_fnDestroy( ppLocals[i] );
+            ppLocals[i] = NULL;
+            continue;
+        }
+
+        dplocal_fnInsert( ppLocals[i] );
+        ppIds[ numNames ] = &ppLocals[i]->id;
+        ppNames[ numNames++ ] = NULL;
+
+        pAlias = pPoints[i].pAliases;
+        for( j = 0; j < pPoints[i].numAliases; j++ )
+        {
+            if( NULL != cfuhash_get( names, pAlias ) )
+            {
+                syslog( LOG_ERR, "unable to create alias %s", pAlias );
+            }
+            else
+            {
+                cfuhash_put( names, pAlias, ppLocals[i] );
+                ppIds[ numNames ] = &ppLocals[i]->id;
+                ppNames[ numNames++ ] = pAlias;
+                if( EOK != dplocal_fnKeepAlias( ppLocals[i], pAlias ) )
+                {
+                    syslog( LOG_ERR,
+                            "alias %s is not kept in the snapshot",
+                            pAlias );
+                }
+            }
+
+            pAlias += strlen( pAlias ) + 1u;
+        }
+
+        if( ( NULL != pPoints[i].pTags ) &&
+            ( EOK != dplocal_fnAddTags( ppLocals[i], pPoints[i].pTags ) ) )
+        {
+            syslog( LOG_ERR,
+                    "cannot set tags for variable: %s",
+                    ppLocals[i]->id.pName );
+        }
+    }
+
+    pthread_rwlock_unlock( &storeLock );
+
+    if( EOK == ret )
+    {
+        ret = HASH_fnAddMany( ppIds, ppNames, (int)numNames );
+    }
+    else
+    {
+        for( i = 0; i < numPoints; i++ )
+        {
+            dplocal_fnDestroy( ppLocals[i] );
+        }
+    }
+
+    free( ppLocals );
+    free( ppIds );
+    free( ppNames );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Write the data points to the snapshot, see tfnSnapshotSave
+
+    Every data point is a bulk registration record (policybulk.h) with its
+    default value set to its value, its aliases, its tags and its creation
+    time as a meta data pair.
+
+@param[in]
+    fp
+        the snapshot
+
+@param[in]
+    pContext
+        unused
+
+@return
+    EOK on success, or an error code from errno.h
+
+*/
+/*============================================================================*/
+static int dplocal_fnSave( FILE *fp, void *pContext )
+{
+    tzDpBulk bulk;
+    int i;
+    int ret = EOK;
+
+    (void)pContext;
+
+    DP_fnBulkInit( &bulk );
+
+    pthread_rwlock_rdlock( &storeLock );
+
+    for( i = 0; ( EOK == ret ) && ( i < numDps ); i++ )
+    {
+        ret = dplocal_fnAddRecord( &bulk, fp, dps[i] );
+    }
+
+    pthread_rwlock_unlock( &storeLock );
+
+    if( ( EOK == ret ) && ( bulk.length > 0u ) &&
+        ( 1u != fwrite( bulk.pBuf, bulk.length, 1u, fp ) ) )
+    {
+        ret = EIO;
+    }
+
+    DP_fnBulkFree( &bulk );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Add the record of a data point to the records being saved, the full
+    records are written first
+
+@param[in]
+    pBulk
+        records not written yet
+
+@param[in]
+    fp
+        the snapshot
+
+@param[in]
+    pLocal
+        the data point
+
+@return
+    EOK on success, or an error code from errno.h
+
+*/
+/*============================================================================*/
+static int dplocal_fnAddRecord( tzDpBulk *pBulk, FILE *fp, tzLocalDp *pLocal )
+{
+    char value[ DPLOCAL_VALUE_LENGTH ];
+    char timestamp[ DPLOCAL_VALUE_LENGTH ];
+    char **ppAliases = NULL;
+    char *pTags = NULL;
+    char *p;
+    size_t length = 1u;
+    DP_tzINFO info;
+    int i;
+    int ret = EOK;
+
+    memset( &info, 0, sizeof(info) );
+    info.pName = pLocal->id.pName;
+    info.ulName = pLocal->id.ulName;
+    info.flags = pLocal->flags;
+    info.type = pLocal->dp.dpdata.type;
+    info.length = pLocal->dp.dpdata.len;
+    info.fmt = "";
+    info.pDefaultValue = dplocal_fnFormat( pLocal, value, sizeof(value) );
+
+    for( i = 0; i < pLocal->numTags; i++ )
+    {
+        length += strlen( tagMap[ pLocal->dp.dpdata.tags[i] ] ) + 1u;
+    }
+
+    pTags = malloc( length );
+    if( pLocal->numAliases > 0u )
+    {
+        ppAliases = malloc( pLocal->numAliases * sizeof(char *) );
+    }
+
+    if( ( NULL == pTags ) ||
+        ( ( pLocal->numAliases > 0u ) && ( NULL == ppAliases ) ) )
+    {
+        free( pTags );
+        free( ppAliases );
+        return ENOMEM;
+    }
+
+    pTags[0] = '\0';
+    for( i = 0; i < pLocal->numTags; i++ )
+    {
+        if( i > 0 )
+        {
+            strcat( pTags, DPLOCAL_TAG_SEPARATOR );
+        }
+        strcat( pTags, tagMap[ pLocal->dp.dpdata.tags[i] ] );
+    }
+
+    p = pLocal->pAliases;
+    for( i = 0; i < pLocal->numAliases; i++ )
+    {
+        ppAliases[i] = p;
+        p += strlen( p ) + 1u;
+    }
+
+    snprintf( timestamp,
+              sizeof(timestamp),
+              "%lld.%09ld",
+              (long long)pLocal->dp.dpdata.timestamp.tv_sec,
+              (long)pLocal->dp.dpdata.timestamp.tv_nsec );
+
+    ret = DP_fnBulkAddMeta( pBulk, DPLOCAL_META_TIMESTAMP, timestamp );
+    if( EOK == ret )
+    {
+        ret = DP_fnBulkAdd( pBulk,
+                            pLocal->id.instanceID,
+                            &info,
+                            ppAliases,
+                            pLocal->numAliases,
+                            pTags );
+    }
+
+    if( ENOSPC == ret )
+    {
+        /* the meta data pair is kept for the record in the next batch */
+        ret = ( 1u == fwrite( pBulk->pBuf, pBulk->length, 1u, fp ) )
+              ? EOK
+              : EIO;
+        DP_fnBulkClear( pBulk );
+
+        if( EOK == ret )
+        {
+            ret = DP_fnBulkAdd( pBulk,
+                                pLocal->id.instanceID,
+                                &info,
+                                ppAliases,
+                                pLocal->numAliases,
+                                pTags );
+        }
+    }
+
+    free( pTags );
+    free( ppAliases );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Restore the data points of the snapshot, see tfnSnapshotLoad
+
+    The records are decoded in place and created in batches like a bulk
+    registration, with their creation time.
+
+@param[in]
+    pData
+        records of the data points
+
+@param[in]
+    length
+        length of the records
+
+@param[in]
+    pContext
+        unused
+
+@return
+    EOK on success, EBADMSG if a record is malformed, or any other error
+    code from errno.h
+
+*/
+/*============================================================================*/
+static int dplocal_fnLoad( void *pData, size_t length, void *pContext )
+{
+    tzDpBulkPoint *pPoints;
+    struct timespec *pTimes;
+    int32_t *pResults;
+    char *pMeta;
+    char *pEnd;
+    size_t offset = 0;
+    uint32_t numPoints = 0;
+    uint32_t failed = 0;
+    uint32_t i;
+    uint16_t j;
+    int ret = EOK;
+
+    (void)pContext;
+
+    pPoints = malloc( DP_BULK_MAX_POINTS * sizeof(tzDpBulkPoint) );
+    pTimes = calloc( DP_BULK_MAX_POINTS, sizeof(struct timespec) );
+    pResults = malloc( DP_BULK_MAX_POINTS * sizeof(int32_t) );
+    if( ( NULL == pPoints ) || ( NULL == pTimes ) || ( NULL == pResults ) )
+    {
+        ret = ENOMEM;
+    }
+
+    while( EOK == ret )
+    {
+        ret = DP_fnBulkNext( pData, length, &offset, &pPoints[ numPoints ] );
+        if( EOK == ret )
+        {
+            memset( &pTimes[ numPoints ], 0, sizeof(struct timespec) );
+            pMeta = pPoints[ numPoints ].pMeta;
+            for( j = 0; j < pPoints[ numPoints ].numMeta; j++ )
+            {
+                pEnd = pMeta + strlen( pMeta ) + 1u;
+                if( 0 == strcmp( pMeta, DPLOCAL_META_TIMESTAMP ) )
+                {
+                    pTimes[ numPoints ].tv_sec = (time_t)strtoll( pEnd,
+                                                                  &pMeta,
+                                                                  10 );
+                    if( '.' == *pMeta )
+                    {
+                        pTimes[ numPoints ].tv_nsec = strtol( pMeta + 1,
+                                                              NULL,
+                                                              10 );
+                    }
+                }
+
+                pMeta = pEnd + strlen( pEnd ) + 1u;
+            }
+
+            numPoints++;
+        }
+
+        if( ( numPoints > 0u ) &&
+            ( ( DP_BULK_MAX_POINTS == numPoints ) || ( EOK != ret ) ) )
+        {
+            if( EOK == dplocal_fnStore( pPoints, numPoints, pResults, pTimes ) )
+            {
+                for( i = 0; i < numPoints; i++ )
+                {
+                    failed += ( EOK != pResults[i] );
+                }
+            }
+            else
+            {
+                failed += numPoints;
+            }
+
+            numPoints = 0;
+        }
+    }
+
+    if( 0u != failed )
+    {
+        syslog( LOG_ERR, "%u data points of the snapshot not created", failed );
+    }
+
+    free( pPoints );
+    free( pTimes );
+    free( pResults );
+
+    return ( ENOENT == ret ) ? EOK : ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Replay a DPLOCAL_LOG_ALIAS entry, see tfnSnapshotReplay
+
+*/
+/*============================================================================*/
+static int dplocal_fnReplayAlias( void *pData, size_t length, void *pContext )
+{
+    struct dp_id_t *pId;
+    uint32_t instanceID;
+    char *pName = (char *)pData + sizeof(uint32_t);
+    char *pAlias;
+
+    (void)pContext;
+
+    if( ( length < sizeof(uint32_t) + 2u ) ||
+        ( '\0' != ((char *)pData)[ length - 1u ] ) )
+    {
+        return EBADMSG;
+    }
+
+    memcpy( &instanceID, pData, sizeof(uint32_t) );
+    pAlias = pName + strlen( pName ) + 1u;
+    if( pAlias >= (char *)pData + length )
+    {
+        return EBADMSG;
+    }
+
+    /* the identification is the first member of the data point */
+    pId = HASH_fnLookupByName( pName, instanceID );
+
+    return ( NULL != pId ) ? dplocal_fnAlias( (tzLocalDp *)pId, pAlias )
+                           : ENOENT;
+}
+
+/*============================================================================*/
+/*!
+
+    Replay a DPLOCAL_LOG_TAGS entry, see tfnSnapshotReplay
+
+*/
+/*============================================================================*/
+static int dplocal_fnReplayTags( void *pData, size_t length, void *pContext )
+{
+    char *pName = pData;
+    char *pTags;
+
+    (void)pContext;
+
+    if( ( length < 2u ) || ( '\0' != pName[ length - 1u ] ) )
+    {
+        return EBADMSG;
+    }
+
+    pTags = pName + strlen( pName ) + 1u;
+    if( pTags >= pName + length )
+    {
+        return EBADMSG;
+    }
+
+    return dplocal_fnSetTags( pName, pTags );
+}
+
+/*============================================================================*/
+/*!
+
+    Set the type and the value of a data point from its default value
+
+@param[in]
+    pLocal
+        data point
+
+@param[in]
+    type
+        DP_TYPE of the data point
+
+@param[in]
+    pValue
+        default value as written in the data point file, NULL for 0
+
+@return
+    EOK on success, ENOMEM if a string value cannot be copied
+
+*/
+/*============================================================================*/
+static int dplocal_fnSetValue( tzLocalDp *pLocal, int type, char *pValue )
+{
+    struct dp_data_t *pData = &pLocal->dp.dpdata;
+    const char *pText = ( NULL != pValue ) ? pValue : "0";
+
+    pData->type = type;
+
+    switch( type )
+    {
+    case DP_TYPE_UINT16:
+        pData->val.uiVal = (uint16_t)strtoul( pText, NULL, 0 );
+        pData->len = sizeof(uint16_t);
+        break;
+    case DP_TYPE_SINT16:
+        pData->val.siVal = (int16_t)strtol( pText, NULL, 0 );
+        pData->len = sizeof(int16_t);
+        break;
+    case DP_TYPE_UINT32:
+        pData->val.ulVal = (uint32_t)strtoul( pText, NULL, 0 );
+        pData->len = sizeof(uint32_t);
+        break;
+    case DP_TYPE_SINT32:
+        pData->val.slVal = (int32_t)strtol( pText, NULL, 0 );
+        pData->len = sizeof(int32_t);
+        break;
+    case DP_TYPE_FLOAT32:
+        pData->val.fVal = strtof( pText, NULL );
+        pData->len = sizeof(float);
+        break;
+    case DP_TYPE_STR:
+    default:
+        /* strings and the array types keep the text of the value */
+        pData->val.pStr = strdup( ( NULL != pValue ) ? pValue : "" );
+        if( NULL == pData->val.pStr )
+        {
+            return ENOMEM;
+        }
+        pData->len = strlen( pData->val.pStr );
+        break;
+    }
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Return the value of a data point as text the way dplocal_fnSetValue
+    reads it back
+
+@param[in]
+    pLocal
+        data point
+
+@param[out]
+    pBuf
+        buffer receiving the value of a number
+
+@param[in]
+    len
+        size of the buffer
+
+@return
+    the buffer, or the text kept by a string or an array data point
+
+*/
+/*============================================================================*/
+static char* dplocal_fnFormat( tzLocalDp *pLocal, char *pBuf, size_t len )
+{
+    struct dp_data_t *pData = &pLocal->dp.dpdata;
+
+    switch( pData->type )
+    {
+    case DP_TYPE_UINT16:
+        snprintf( pBuf, len, "%u", (unsigned)pData->val.uiVal );
+        break;
+    case DP_TYPE_SINT16:
+        snprintf( pBuf, len, "%d", (int)pData->val.siVal );
+        break;
+    case DP_TYPE_UINT32:
+        snprintf( pBuf, len, "%lu", (unsigned long)pData->val.ulVal );
+        break;
+    case DP_TYPE_SINT32:
+        snprintf( pBuf, len, "%ld", (long)pData->val.slVal );
+        break;
+    case DP_TYPE_FLOAT32:
+        snprintf( pBuf, len, "%.9g", (double)pData->val.fVal );
+        break;
+    default:
+        return pData->val.pStr;
+    }
+
+    return pBuf;
+}
+
+/*============================================================================*/
+/*!
+
+    Return the tag map index of a tag, the tag is added to the tag map the
+    first time.  Called with the store lock held exclusively.
+
+@param[in]
+    pTag
+        tag, e.g. "location:Tesla"
+
+@return
+    index of the tag in the tag map, 0 if the tag map is full
+
+*/
+/*============================================================================*/
+static int dplocal_fnInternTag( char *pTag )
+{
+    intptr_t id;
+
+    id = (intptr_t)cfuhash_get( tags, pTag );
+    if( 0 == id )
+    {
+        if( numTags >= DP_SERVER_MAX_TAGS )
+        {
+            return 0;
+        }
+
+        id = (intptr_t)( ++numTags );
+        tagMap[id] = strdup( pTag );
+        if( NULL == tagMap[id] )
+        {
+            numTags--;
+            return 0;
+        }
+
+        cfuhash_put( tags, pTag, (void *)id );
+    }
+
+    return (int)id;
+}
+
+/*============================================================================*/
+/*!
+
+    Release the key and the tag of a search
+
+@param[in]
+    pSearch
+        search of a connection
+
+*/
+/*============================================================================*/
+static void dplocal_fnEndSearch( tzLocalSearch *pSearch )
+{
+    if( true == pSearch->isRegex )
+    {
+        regfree( &pSearch->regex );
+    }
+
+    free( pSearch->pKey );
+    free( pSearch->pTag );
+
+    memset( pSearch, 0, sizeof(tzLocalSearch) );
+}
+
+/*============================================================================*/
+/*!
+
+    Return the first data point of a search from a position of the data
+    point list
+
+@param[in]
+    pSearch
+        search of a connection
+
+@param[in]
+    first
+        position of the data point list to start at
+
+@return
+    the data point, NULL at the end of the list
+
+*/
+/*============================================================================*/
+static tzLocalDp* dplocal_fnSearch( tzLocalSearch *pSearch, int first )
+{
+    tzLocalDp *pLocal = NULL;
+    int i;
+
+    for( i = first; NULL == pLocal; i++ )
+    {
+        pthread_rwlock_rdlock( &storeLock );
+        pLocal = ( i < numDps ) ? dps[i] : NULL;
+        pthread_rwlock_unlock( &storeLock );
+
+        if( NULL == pLocal )
+        {
+            break;
+        }
+
+        /* the data point must also pass the policy check */
+        if( ( false == dplocal_fnMatch( pSearch, pLocal ) ) ||
+            ( EOK != POLICY_fnCheck( &pLocal->dp ) ) )
+        {
+            pLocal = NULL;
+        }
+    }
+
+    return pLocal;
+}
+
+/*============================================================================*/
+/*!
+
+    Check if a data point matches the key and the tag of a search
+
+@param[in]
+    pSearch
+        search of a connection
+
+@param[in]
+    pLocal
+        data point
+
+@return
+    true if the data point matches
+
+*/
+/*============================================================================*/
+static bool dplocal_fnMatch( tzLocalSearch *pSearch, tzLocalDp *pLocal )
+{
+    bool match = true;
+    int i;
+
+    if( false == pSearch->isValid )
+    {
+        match = false;
+    }
+    else if( true == pSearch->isRegex )
+    {
+        match = ( 0 == regexec( &pSearch->regex,
+                                pLocal->id.pName,
+                                0,
+                                NULL,
+                                0 ) );
+    }
+    else if( NULL != pSearch->pKey )
+    {
+        match = ( eMatchContains == pSearch->matchType )
+                ? ( NULL != strstr( pLocal->id.pName, pSearch->pKey ) )
+                : ( 0 == strcmp( pLocal->id.pName, pSearch->pKey ) );
+    }
+
+    if( ( true == match ) && ( NULL != pSearch->pTag ) )
+    {
+        match = false;
+        for( i = 0; ( i < pLocal->numTags ) && ( false == match ); i++ )
+        {
+            match = ( NULL != strstr( tagMap[ pLocal->dp.dpdata.tags[i] ],
+                                      pSearch->pTag ) );
+        }
+    }
+
+    return match;
+}
+
+/*!
+ * @} // dprmlocal
+ */
@@ -0,0 +1,681 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup dprmlocal
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  dprmlocal.c
+
+ @brief
+    Message passing of the local Data Point Resource Manager
+
+ @details
+    This module provides the QNX kernel calls used by DynPolAC on Linux.
+    A MsgSendv to the local connection gathers the send vectors into one
+    message and runs the handler attached to the message code on the
+    calling thread.  The handler replies with MsgReply, which scatters the
+    reply into the reply vectors of the MsgSendv, or returns an errno which
+    fails the MsgSendv like the resource manager library of the server.
+
+    Every thread keeps its own receive context, so several client threads
+    can send at once, the server modules do their own locking.
+
+*/
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/neutrino.h>
+#include <sys/syspage.h>
+#include "minicloudmsg.h"
+#include "hash.h"
+#include "policy.h"
+#include "policynative.h"
+#include "name.h"
+#include "dprmlocal.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Defines
+==============================================================================*/
+
+/*! size of the message buffer on the stack, larger messages are allocated */
+#define DPRMLOCAL_STACK_MSG_SIZE    ( 1024 )
+
+/*=============================================================================
+ 	 	 	 	 	 	 	 	 Structures
+ =============================================================================*/
+
+/*! receive context of the message being handled by a thread */
+typedef struct zLocalReceive
+{
+    /*! receive identifier of the message */
+    int rcvid;
+
+    /*! the message gathered from the send vectors */
+    const uint8_t *pMsg;
+
+    /*! length of the message */
+    size_t size;
+
+    /*! reply vectors of the sender */
+    const iov_t *riov;
+
+    /*! number of reply vectors */
+    int rparts;
+
+    /*! the handler replied */
+    bool replied;
+
+    /*! reply status, or the error of MsgError */
+    long status;
+
+    /*! the reply is an error */
+    bool error;
+
+} tzLocalReceive;
+
+/*==============================================================================
+ 	 	 	 	 	 	 External/Public Variables
+ =============================================================================*/
+
+/*! system page of the local server */
+struct syspage_entry *_syspage_ptr;
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Variables
+ =============================================================================*/
+
+/*! system page entries, ClockCycles counts nanoseconds */
+static struct syspage_entry syspage = { 1, { 1000000000ull } };
+
+/*! message handlers by message code */
+static tfnDPRMLocalHandler handlers[ DPRMLOCAL_MAX_CODES ];
+
+/*! the server is set up once per process */
+static pthread_once_t setupOnce = PTHREAD_ONCE_INIT;
+
+/*! last receive identifier */
+static int lastRcvid = 0;
+
+/*! message being handled by the calling thread */
+static __thread tzLocalReceive *pReceive = NULL;
+
+/*==============================================================================
+ Local/Private Function Prototypes
+ =============================================================================*/
+
+static void dprmlocal_fnInit( void );
+static int dprmlocal_fnCreatePolicy( int rcvid, void *msg );
+static int dprmlocal_fnHouseKeepPolicy( int rcvid, void *msg );
+static int dprmlocal_fnFindByName( int rcvid, void *msg );
+static int dprmlocal_fnFindByGUID( int rcvid, void *msg );
+
+/*==============================================================================
+ Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+//fn  DPRMLOCAL_fnSetup
+/*!
+
+@brief
+    Set up the local server
+
+    The hash tables of the server are created and the default message
+    handlers are attached the first time, later calls do nothing.
+
+@return
+    EOK
+
+*/
+/*============================================================================*/
+int DPRMLOCAL_fnSetup( void )
+{
+    pthread_once( &setupOnce, dprmlocal_fnInit );
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  DPRMLOCAL_fnAttach
+/*!
+
+@brief
+    Attach a message handler to a message code
+
+    The handler replaces the handler attached to the code before, a NULL
+    handler detaches it.
+
+@param[in]
+    code
+        message code, the first 16 bits of the message
+
+@param[in]
+    pHandler
+        message handler
+
+@return
+    EOK on success, EINVAL if the code is out of range
+
+*/
+/*============================================================================*/
+int DPRMLOCAL_fnAttach( uint16_t code, tfnDPRMLocalHandler pHandler )
+{
+    if( code >= DPRMLOCAL_MAX_CODES )
+    {
+        return EINVAL;
+    }
+
+    __atomic_store_n( &handlers[code], pHandler, __ATOMIC_RELEASE );
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  MsgSendv
+/*!
+
+@brief
+    Send a message to the local server and wait for the reply
+
+@param[in]
+    coid
+        connection identifier, DPRMLOCAL_COID
+
+@param[in]
+    siov
+        send vectors
+
+@param[in]
+    sparts
+        number of send vectors
+
+@param[in]
+    riov
+        reply vectors
+
+@param[in]
+    rparts
+        number of reply vectors
+
+@return
+    the status of the reply, or -1 with errno set on failure
+
+*/
+/*============================================================================*/
+int MsgSendv( int coid,
+              const iov_t *siov,
+              int sparts,
+              const iov_t *riov,
+              int rparts )
+{
+    uint64_t stackMsg[ DPRMLOCAL_STACK_MSG_SIZE / sizeof(uint64_t) ];
+    tzLocalReceive receive;
+    tzLocalReceive *pSaved = pReceive;
+    tfnDPRMLocalHandler pHandler = NULL;
+    uint8_t *pMsg = (uint8_t *)stackMsg;
+    size_t size = 0;
+    size_t offset = 0;
+    uint16_t code = 0;
+    int ret;
+    int i;
+
+    memset( &receive, 0, sizeof(receive) );
+
+    if( DPRMLOCAL_COID != coid )
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    for( i = 0; i < sparts; i++ )
+    {
+        size += GETIOVLEN( &siov[i] );
+    }
+
+    if( size < sizeof(code) )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if( size > sizeof(stackMsg) )
+    {
+        pMsg = malloc( size );
+        if( NULL == pMsg )
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    for( i = 0; i < sparts; i++ )
+    {
+        memcpy( pMsg + offset,
+                GETIOVBASE( &siov[i] ),
+                GETIOVLEN( &siov[i] ) );
+        offset += GETIOVLEN( &siov[i] );
+    }
+
+    memcpy( &code, pMsg, sizeof(code) );
+    if( code < DPRMLOCAL_MAX_CODES )
+    {
+        pHandler = __atomic_load_n( &handlers[code], __ATOMIC_ACQUIRE );
+    }
+
+    if( NULL == pHandler )
+    {
+        ret = ENOSYS;
+    }
+    else
+    {
+        receive.rcvid = __atomic_add_fetch( &lastRcvid, 1, __ATOMIC_RELAXED );
+        receive.pMsg = pMsg;
+        receive.size = size;
+        receive.riov = riov;
+        receive.rparts = rparts;
+
+        pReceive = &receive;
+        ret = pHandler( receive.rcvid, pMsg );
+        pReceive = pSaved;
+
+        if( true == receive.replied )
+        {
+            ret = ( true == receive.error ) ? (int)receive.status : EOK;
+        }
+    }
+
+    if( pMsg != (uint8_t *)stackMsg )
+    {
+        free( pMsg );
+    }
+
+    if( EOK != ret )
+    {
+        errno = ret;
+        return -1;
+    }
+
+    return ( true == receive.replied ) ? (int)receive.status : EOK;
+}
+
+/*============================================================================*/
+//fn  MsgReply
+/*!
+
+@brief
+    Reply to the message being handled by the calling thread
+
+@param[in]
+    rcvid
+        receive identifier passed to the handler
+
+@param[in]
+    status
+        value returned by the MsgSendv
+
+@param[in]
+    msg
+        reply message
+
+@param[in]
+    size
+        size of the reply message
+
+@return
+    EOK on success, -1 with errno set to ESRCH if the message is not being
+    handled by the calling thread
+
+*/
+/*============================================================================*/
+int MsgReply( int rcvid, long status, const void *msg, int size )
+{
+    const uint8_t *pReply = (const uint8_t *)msg;
+    size_t len;
+    int i;
+
+    if( ( NULL == pReceive ) ||
+        ( rcvid != pReceive->rcvid ) ||
+        ( true == pReceive->replied ) )
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    for( i = 0; ( i < pReceive->rparts ) && ( size > 0 ); i++ )
+    {
+        len = GETIOVLEN( &pReceive->riov[i] );
+        if( len > (size_t)size )
+        {
+            len = (size_t)size;
+        }
+
+        memcpy( GETIOVBASE( &pReceive->riov[i] ), pReply, len );
+        pReply += len;
+        size -= (int)len;
+    }
+
+    pReceive->replied = true;
+    pReceive->status = status;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  MsgRead
+/*!
+
+@brief
+    Read from the message being handled by the calling thread
+
+    As on QNX, the number of bytes read is cut to the length of the
+    message sent, which tells the handler how much the client sent.
+
+@param[in]
+    rcvid
+        receive identifier passed to the handler
+
+@param[out]
+    msg
+        buffer receiving the bytes read
+
+@param[in]
+    bytes
+        size of the buffer
+
+@param[in]
+    offset
+        offset in the message of the first byte to read
+
+@return
+    the number of bytes read, or -1 with errno set to ESRCH if the message
+    is not being handled by the calling thread
+
+*/
+/*============================================================================*/
+ssize_t MsgRead( int rcvid, void *msg, size_t bytes, size_t offset )
+{
+    if( ( NULL == pReceive ) ||
+        ( rcvid != pReceive->rcvid ) ||
+        ( true == pReceive->replied ) )
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    if( offset >= pReceive->size )
+    {
+        return 0;
+    }
+
+    if( bytes > pReceive->size - offset )
+    {
+        bytes = pReceive->size - offset;
+    }
+
+    memcpy( msg, pReceive->pMsg + offset, bytes );
+
+    return (ssize_t)bytes;
+}
+
+/*============================================================================*/
+//fn  MsgError
+/*!
+
+@brief
+    Fail the message being handled by the calling thread
+
+@param[in]
+    rcvid
+        receive identifier passed to the handler
+
+@param[in]
+    error
+        errno of the failed MsgSendv
+
+@return
+    EOK on success, -1 with errno set to ESRCH if the message is not being
+    handled by the calling thread
+
+*/
+/*============================================================================*/
+int MsgError( int rcvid, int error )
+{
+    if( ( NULL == pReceive ) ||
+        ( rcvid != pReceive->rcvid ) ||
+        ( true == pReceive->replied ) )
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    pReceive->replied = true;
+    pReceive->error = true;
+    pReceive->status = error;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  ClockCycles
+/*!
+
+@brief
+    Return the free running cycle counter
+
+@return
+    nanoseconds of CLOCK_MONOTONIC
+
+*/
+/*============================================================================*/
+uint64_t ClockCycles( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( (uint64_t)now.tv_sec * 1000000000ull ) + (uint64_t)now.tv_nsec;
+}
+
+/*============================================================================*/
+//fn  delay
+/*!
+
+@brief
+    Suspend the calling thread for a number of milliseconds
+
+@param[in]
+    duration
+        milliseconds to sleep
+
+@return
+    0
+
+*/
+/*============================================================================*/
+unsigned int delay( unsigned int duration )
+{
+    struct timespec ts;
+
+    ts.tv_sec = duration / 1000;
+    ts.tv_nsec = (long)( duration % 1000 ) * 1000000L;
+
+    while( ( 0 != nanosleep( &ts, &ts ) ) && ( EINTR == errno ) )
+    {
+        /* sleep the rest */
+    }
+
+    return 0;
+}
+
+/*============================================================================*/
+//fn  strlwr
+/*!
+
+@brief
+    Convert a string to lower case in place
+
+@param[in,out]
+    s
+        string to convert
+
+@return
+    the string
+
+*/
+/*============================================================================*/
+char* strlwr( char *s )
+{
+    char *p;
+
+    for( p = s; '\0' != *p; p++ )
+    {
+        *p = (char)tolower( (unsigned char)*p );
+    }
+
+    return s;
+}
+
+/*============================================================================*/
+//fn  stricmp
+/*!
+
+@brief
+    Compare two strings ignoring the case
+
+@return
+    less than, equal to or greater than 0 like strcmp
+
+*/
+/*============================================================================*/
+int stricmp( const char *s1, const char *s2 )
+{
+    return strcasecmp( s1, s2 );
+}
+
+/*============================================================================*/
+//fn  NAME_fnConvert
+/*!
+
+@brief
+    Apply the character translations to a data point name
+
+    The local server has no translations configured, the name is kept.
+
+@param[in,out]
+    name
+        data point name
+
+*/
+/*============================================================================*/
+void NAME_fnConvert( char *name )
+{
+    (void)name;
+}
+
+/*============================================================================*/
+/*!
+
+    Set up the system page, the server hash tables, the directory of the
+    native rule sets and the default message handlers
+
+*/
+/*============================================================================*/
+static void dprmlocal_fnInit( void )
+{
+    long numCpu = sysconf( _SC_NPROCESSORS_ONLN );
+    char *pNativeDir = getenv( DPRMLOCAL_NATIVE_DIR_ENV );
+
+    syspage.num_cpu = ( numCpu > 0 ) ? (uint16_t)numCpu : 1;
+    _syspage_ptr = &syspage;
+
+    HASH_fnSetup();
+
+    if( ( NULL != pNativeDir ) &&
+        ( EOK != POLICYNATIVE_fnSetDirectory( pNativeDir ) ) )
+    {
+        fprintf( stderr,
+                 "cannot use the native rule set directory %s\n",
+                 pNativeDir );
+    }
+
+    DPRMLOCAL_fnAttach( MSG_DP_POLICY_REGISTER, dprmlocal_fnCreatePolicy );
+    DPRMLOCAL_fnAttach( MSG_DP_POLICY_HOUSEKEEPING,
+                        dprmlocal_fnHouseKeepPolicy );
+    DPRMLOCAL_fnAttach( MSG_DP_FIND_BY_NAME, dprmlocal_fnFindByName );
+    DPRMLOCAL_fnAttach( MSG_DP_FIND_BY_ID, dprmlocal_fnFindByGUID );
+}
+
+/*============================================================================*/
+/*!
+
+    MSG_DP_POLICY_REGISTER handler
+
+*/
+/*============================================================================*/
+static int dprmlocal_fnCreatePolicy( int rcvid, void *msg )
+{
+    return POLICY_fnCreatePolicy( rcvid, (datapoint_policy_msg_t *)msg );
+}
+
+/*============================================================================*/
+/*!
+
+    MSG_DP_POLICY_HOUSEKEEPING handler
+
+*/
+/*============================================================================*/
+static int dprmlocal_fnHouseKeepPolicy( int rcvid, void *msg )
+{
+    return POLICY_fnHouseKeepPolicy( rcvid, (datapoint_policy_msg_t *)msg );
+}
+
+/*============================================================================*/
+/*!
+
+    MSG_DP_FIND_BY_NAME handler, the local clients have no credentials
+
+*/
+/*============================================================================*/
+static int dprmlocal_fnFindByName( int rcvid, void *msg )
+{
+    return HASH_fnFindByName( rcvid, (datapoint_get_msg_t *)msg, NULL );
+}
+
+/*============================================================================*/
+/*!
+
+    MSG_DP_FIND_BY_ID handler, the local clients have no credentials
+
+*/
+/*============================================================================*/
+static int dprmlocal_fnFindByGUID( int rcvid, void *msg )
+{
+    return HASH_fnFindByGUID( rcvid, (datapoint_guid_msg_t *)msg, NULL );
+}
+
+/*!
+ * @} // dprmlocal
+ */
@@ -0,0 +1,457 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup comparator
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  comparator.c
+
+ @brief
+    Comparator rule range check kernels
+
+ @details
+    The range of a comparator rule is checked by a kernel selected by the
+    data point type from a table, against bounds converted to the type of
+    the data point when the rule was created.  The conversions keep the
+    semantics of comparing the value with the int min and max of the rule:
+
+        uint16, sint16   the range is clamped to the type, an empty range
+                         is stored as min 1 and max 0
+        uint32           min and max are converted to unsigned
+        float32          min and max are converted to float
+
+    Array data points hold len bytes of elements at val.pStr, int16_t
+    elements for DP_TYPE_ARRAY16 and int32_t elements for DP_TYPE_ARRAY32.
+    Every element must be in the range, an empty array is denied.  The
+    array kernels use NEON or SSE2 when the target has them and a scalar
+    loop otherwise and for the tail of the array.
+
+    A data point type without a kernel, e.g. DP_TYPE_STR or
+    DP_TYPE_CONJUGATE, fails the check of a rule with a range.
+
+*/
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "minicloud.h"
+#include "comparator.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Structures
+==============================================================================*/
+
+/*! range check kernel of a data point type */
+typedef bool (*tfnComparatorKernel)( const struct dp_t *pDp,
+                                     const tzPolicyBounds *pBounds );
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Function Prototypes
+==============================================================================*/
+
+static bool comparator_fnUint16( const struct dp_t *pDp,
+                                 const tzPolicyBounds *pBounds );
+static bool comparator_fnSint16( const struct dp_t *pDp,
+                                 const tzPolicyBounds *pBounds );
+static bool comparator_fnUint32( const struct dp_t *pDp,
+                                 const tzPolicyBounds *pBounds );
+static bool comparator_fnSint32( const struct dp_t *pDp,
+                                 const tzPolicyBounds *pBounds );
+static bool comparator_fnFloat32( const struct dp_t *pDp,
+                                  const tzPolicyBounds *pBounds );
+static bool comparator_fnArray16( const struct dp_t *pDp,
+                                  const tzPolicyBounds *pBounds );
+static bool comparator_fnArray32( const struct dp_t *pDp,
+                                  const tzPolicyBounds *pBounds );
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Constants
+==============================================================================*/
+
+/*! kernels indexed by the data point type, NULL if the type has none */
+static const tfnComparatorKernel kernels[] =
+{
+    [ DP_TYPE_UINT16 ]  = comparator_fnUint16,
+    [ DP_TYPE_SINT16 ]  = comparator_fnSint16,
+    [ DP_TYPE_UINT32 ]  = comparator_fnUint32,
+    [ DP_TYPE_SINT32 ]  = comparator_fnSint32,
+    [ DP_TYPE_FLOAT32 ] = comparator_fnFloat32,
+    [ DP_TYPE_ARRAY16 ] = comparator_fnArray16,
+    [ DP_TYPE_ARRAY32 ] = comparator_fnArray32
+};
+
+/*! number of entries of the kernel table */
+#define COMPARATOR_NUM_KERNELS  ( sizeof(kernels) / sizeof(kernels[0]) )
+
+/*==============================================================================
+ Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Convert the min and max of a comparator rule to the data point types
+
+@param[in]
+    min
+        min of the rule
+
+@param[in]
+    max
+        max of the rule
+
+@param[out]
+    pBounds
+        bounds of every data point type
+
+*/
+/*============================================================================*/
+void COMPARATOR_fnBind( int min, int max, tzPolicyBounds *pBounds )
+{
+    int32_t lo;
+    int32_t hi;
+
+    if( NULL == pBounds )
+    {
+        return;
+    }
+
+    memset( pBounds, 0, sizeof(tzPolicyBounds) );
+
+    /* wild card for the policy min max is either of them zero */
+    pBounds->wildcard = ( 0 == min ) || ( 0 == max );
+
+    /* 16 bit values are promoted to int, clamp the range to the type */
+    lo = ( min < 0 ) ? 0 : min;
+    hi = ( max > UINT16_MAX ) ? UINT16_MAX : max;
+    if( lo <= hi )
+    {
+        pBounds->u16Min = (uint16_t)lo;
+        pBounds->u16Max = (uint16_t)hi;
+    }
+    else
+    {
+        pBounds->u16Min = 1;
+        pBounds->u16Max = 0;
+    }
+
+    lo = ( min < INT16_MIN ) ? INT16_MIN : min;
+    hi = ( max > INT16_MAX ) ? INT16_MAX : max;
+    if( lo <= hi )
+    {
+        pBounds->s16Min = (int16_t)lo;
+        pBounds->s16Max = (int16_t)hi;
+    }
+    else
+    {
+        pBounds->s16Min = 1;
+        pBounds->s16Max = 0;
+    }
+
+    /* an int compared with an uint32_t is converted to unsigned */
+    pBounds->u32Min = (uint32_t)min;
+    pBounds->u32Max = (uint32_t)max;
+
+    pBounds->s32Min = min;
+    pBounds->s32Max = max;
+
+    /* an int compared with a float is converted to float */
+    pBounds->f32Min = (float)min;
+    pBounds->f32Max = (float)max;
+}
+
+/*============================================================================*/
+/*!
+
+    Check the value of a data point against the bounds of a rule
+
+@param[in]
+    pDp
+        data point structure
+
+@param[in]
+    pBounds
+        bounds of the rule, see COMPARATOR_fnBind()
+
+@return
+    true if the value is in the range or the rule has no range
+
+*/
+/*============================================================================*/
+bool COMPARATOR_fnCheck( const struct dp_t *pDp,
+                         const tzPolicyBounds *pBounds )
+{
+    int type = pDp->dpdata.type;
+
+    if( pBounds->wildcard )
+    {
+        return true;
+    }
+
+    if( ( type < 0 ) ||
+        ( (size_t)type >= COMPARATOR_NUM_KERNELS ) ||
+        ( NULL == kernels[ type ] ) )
+    {
+        return false;
+    }
+
+    return kernels[ type ]( pDp, pBounds );
+}
+
+/*============================================================================*/
+/*!
+
+    Check the value of a data point against a min and max
+
+    For the callers which do not keep the bounds of the rule, e.g. the
+    native rule sets for the array data points.
+
+@param[in]
+    pDp
+        data point structure
+
+@param[in]
+    min
+        min of the rule
+
+@param[in]
+    max
+        max of the rule
+
+@return
+    true if the value is in the range or the rule has no range
+
+*/
+/*============================================================================*/
+bool COMPARATOR_fnInRange( const struct dp_t *pDp, int min, int max )
+{
+    tzPolicyBounds bounds;
+
+    COMPARATOR_fnBind( min, max, &bounds );
+
+    return COMPARATOR_fnCheck( pDp, &bounds );
+}
+
+/*============================================================================*/
+/*!
+
+    Range check kernels of the scalar data point types
+
+*/
+/*============================================================================*/
+static bool comparator_fnUint16( const struct dp_t *pDp,
+                                 const tzPolicyBounds *pBounds )
+{
+    return ( pDp->dpdata.val.uiVal >= pBounds->u16Min ) &&
+           ( pDp->dpdata.val.uiVal <= pBounds->u16Max );
+}
+
+static bool comparator_fnSint16( const struct dp_t *pDp,
+                                 const tzPolicyBounds *pBounds )
+{
+    return ( pDp->dpdata.val.siVal >= pBounds->s16Min ) &&
+           ( pDp->dpdata.val.siVal <= pBounds->s16Max );
+}
+
+static bool comparator_fnUint32( const struct dp_t *pDp,
+                                 const tzPolicyBounds *pBounds )
+{
+    return ( pDp->dpdata.val.ulVal >= pBounds->u32Min ) &&
+           ( pDp->dpdata.val.ulVal <= pBounds->u32Max );
+}
+
+static bool comparator_fnSint32( const struct dp_t *pDp,
+                                 const tzPolicyBounds *pBounds )
+{
+    return ( pDp->dpdata.val.slVal >= pBounds->s32Min ) &&
+           ( pDp->dpdata.val.slVal <= pBounds->s32Max );
+}
+
+static bool comparator_fnFloat32( const struct dp_t *pDp,
+                                  const tzPolicyBounds *pBounds )
+{
+    return ( pDp->dpdata.val.fVal >= pBounds->f32Min ) &&
+           ( pDp->dpdata.val.fVal <= pBounds->f32Max );
+}
+
+/*============================================================================*/
+/*!
+
+    Range check kernel of the DP_TYPE_ARRAY16 data points
+
+    Eight elements are checked per vector, the out of range lanes are
+    accumulated and tested once after the loop.
+
+*/
+/*============================================================================*/
+static bool comparator_fnArray16( const struct dp_t *pDp,
+                                  const tzPolicyBounds *pBounds )
+{
+    const int16_t *p = (const int16_t *)pDp->dpdata.val.pStr;
+    size_t n = pDp->dpdata.len / sizeof(int16_t);
+    int16_t lo = pBounds->s16Min;
+    int16_t hi = pBounds->s16Max;
+    size_t i = 0;
+
+    if( ( NULL == p ) || ( 0 == n ) )
+    {
+        return false;
+    }
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    {
+        int16x8_t vlo = vdupq_n_s16( lo );
+        int16x8_t vhi = vdupq_n_s16( hi );
+        uint16x8_t out = vdupq_n_u16( 0 );
+        uint16x4_t fold;
+        int16x8_t v;
+
+        for( ; i + 8 <= n; i += 8 )
+        {
+            v = vld1q_s16( p + i );
+            out = vorrq_u16( out, vorrq_u16( vcltq_s16( v, vlo ),
+                                             vcgtq_s16( v, vhi ) ) );
+        }
+
+        fold = vorr_u16( vget_low_u16( out ), vget_high_u16( out ) );
+        fold = vpmax_u16( fold, fold );
+        fold = vpmax_u16( fold, fold );
+        if( 0 != vget_lane_u16( fold, 0 ) )
+        {
+            return false;
+        }
+    }
+#elif defined(__SSE2__)
+    {
+        __m128i vlo = _mm_set1_epi16( lo );
+        __m128i vhi = _mm_set1_epi16( hi );
+        __m128i out = _mm_setzero_si128();
+        __m128i v;
+
+        for( ; i + 8 <= n; i += 8 )
+        {
+            v = _mm_loadu_si128( (const __m128i *)( p + i ) );
+            out = _mm_or_si128( out, _mm_or_si128( _mm_cmplt_epi16( v, vlo ),
+                                                   _mm_cmpgt_epi16( v, vhi ) ) );
+        }
+
+        if( 0 != _mm_movemask_epi8( out ) )
+        {
+            return false;
+        }
+    }
+#endif
+
+    for( ; i < n; i++ )
+    {
+        if( ( p[i] < lo ) || ( p[i] > hi ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*============================================================================*/
+/*!
+
+    Range check kernel of the DP_TYPE_ARRAY32 data points
+
+    Four elements are checked per vector, the out of range lanes are
+    accumulated and tested once after the loop.
+
+*/
+/*============================================================================*/
+static bool comparator_fnArray32( const struct dp_t *pDp,
+                                  const tzPolicyBounds *pBounds )
+{
+    const int32_t *p = (const int32_t *)pDp->dpdata.val.pStr;
+    size_t n = pDp->dpdata.len / sizeof(int32_t);
+    int32_t lo = pBounds->s32Min;
+    int32_t hi = pBounds->s32Max;
+    size_t i = 0;
+
+    if( ( NULL == p ) || ( 0 == n ) )
+    {
+        return false;
+    }
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    {
+        int32x4_t vlo = vdupq_n_s32( lo );
+        int32x4_t vhi = vdupq_n_s32( hi );
+        uint32x4_t out = vdupq_n_u32( 0 );
+        uint32x2_t fold;
+        int32x4_t v;
+
+        for( ; i + 4 <= n; i += 4 )
+        {
+            v = vld1q_s32( p + i );
+            out = vorrq_u32( out, vorrq_u32( vcltq_s32( v, vlo ),
+                                             vcgtq_s32( v, vhi ) ) );
+        }
+
+        fold = vorr_u32( vget_low_u32( out ), vget_high_u32( out ) );
+        fold = vpmax_u32( fold, fold );
+        if( 0 != vget_lane_u32( fold, 0 ) )
+        {
+            return false;
+        }
+    }
+#elif defined(__SSE2__)
+    {
+        __m128i vlo = _mm_set1_epi32( lo );
+        __m128i vhi = _mm_set1_epi32( hi );
+        __m128i out = _mm_setzero_si128();
+        __m128i v;
+
+        for( ; i + 4 <= n; i += 4 )
+        {
+            v = _mm_loadu_si128( (const __m128i *)( p + i ) );
+            out = _mm_or_si128( out, _mm_or_si128( _mm_cmplt_epi32( v, vlo ),
+                                                   _mm_cmpgt_epi32( v, vhi ) ) );
+        }
+
+        if( 0 != _mm_movemask_epi8( out ) )
+        {
+            return false;
+        }
+    }
+#endif
+
+    for( ; i < n; i++ )
+    {
+        if( ( p[i] < lo ) || ( p[i] > hi ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * @} // comparator
+ */
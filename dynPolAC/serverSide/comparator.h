@@ -0,0 +1,84 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef COMPARATOR_H_
+#define COMPARATOR_H_
+
+/*!
+ * @file comparator.h
+ * @brief Public APIs for the comparator rule range checks
+ *
+ * The comparator.h file contains the public APIs and data structures for
+ * checking a data point value against the min and max of a comparator
+ * rule.
+ *
+ * @defgroup comparator Comparator Kernels
+ * @brief Range check kernels specialized per data point type
+ *
+ * The min and max of a rule are converted to every data point type once,
+ * when the rule is created, and the check of a data point is a single
+ * call through a table indexed by the data point type.  Array data points
+ * are checked element by element with SIMD kernels where available, the
+ * whole array must be in the range.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dp.h"
+
+/*=============================================================================
+                              Structures
+==============================================================================*/
+
+/*! min and max of a comparator rule converted to the data point types */
+typedef struct zPolicyBounds
+{
+    /*! the rule has no range, min or max is zero */
+    bool wildcard;
+
+    /*! range of DP_TYPE_UINT16 values */
+    uint16_t u16Min;
+    uint16_t u16Max;
+
+    /*! range of DP_TYPE_SINT16 values and DP_TYPE_ARRAY16 elements */
+    int16_t s16Min;
+    int16_t s16Max;
+
+    /*! range of DP_TYPE_UINT32 values */
+    uint32_t u32Min;
+    uint32_t u32Max;
+
+    /*! range of DP_TYPE_SINT32 values and DP_TYPE_ARRAY32 elements */
+    int32_t s32Min;
+    int32_t s32Max;
+
+    /*! range of DP_TYPE_FLOAT32 values */
+    float f32Min;
+    float f32Max;
+
+} tzPolicyBounds;
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+void COMPARATOR_fnBind( int min, int max, tzPolicyBounds *pBounds );
+bool COMPARATOR_fnCheck( const struct dp_t *pDp,
+                         const tzPolicyBounds *pBounds );
+bool COMPARATOR_fnInRange( const struct dp_t *pDp, int min, int max );
+
+/*! @} */
+
+#endif /* COMPARATOR_H_ */
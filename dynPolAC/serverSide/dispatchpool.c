@@ -0,0 +1,179 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup dispatchpool
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  dispatchpool.c
+
+ @brief
+    Dispatch the server messages on a thread pool
+
+ @details
+    This module runs the dispatch loop of the server either on the calling
+    thread only or on a QNX thread pool.  The pool keeps at least
+    DISPATCHPOOL_LO_WATER threads blocked on the channel, so a burst of
+    policy checks is received without waiting for a thread to be created,
+    and never grows beyond the requested number of threads.
+
+*/
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+/* the pool threads run with a dispatch context */
+#define THREAD_POOL_PARAM_T    dispatch_context_t
+
+#include <sys/iofunc.h>
+#include <sys/dispatch.h>
+#include <sys/syspage.h>
+#include "dispatchpool.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Defines
+==============================================================================*/
+
+/*! minimum number of threads blocked waiting for a message */
+#define DISPATCHPOOL_LO_WATER    ( 2 )
+
+/*==============================================================================
+ Local/Private Function Prototypes
+ =============================================================================*/
+
+static int dispatchpool_fnLoop( dispatch_t *dpp );
+
+/*==============================================================================
+ Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+//fn  DISPATCHPOOL_fnRun
+/*!
+
+@brief
+    Run the message dispatch of the server
+
+    The function takes over the calling thread, which becomes one of the
+    dispatch threads, and only returns if the dispatch cannot be started.
+
+@param[in]
+    dpp
+        dispatch handle with the message handlers of the server attached
+
+@param[in]
+    numThreads
+        number of dispatch threads, 1 for the single threaded server or
+        DISPATCHPOOL_THREADS_AUTO for one thread per CPU
+
+@return
+    an error code from errno.h if the dispatch could not be started
+
+*/
+/*============================================================================*/
+int DISPATCHPOOL_fnRun( dispatch_t *dpp, int numThreads )
+{
+    thread_pool_attr_t attr;
+    thread_pool_t *tpp;
+
+    if( ( NULL == dpp ) || ( numThreads < 0 ) )
+    {
+        return EINVAL;
+    }
+
+    if( DISPATCHPOOL_THREADS_AUTO == numThreads )
+    {
+        numThreads = _syspage_ptr->num_cpu;
+    }
+
+    if( numThreads <= 1 )
+    {
+        return dispatchpool_fnLoop( dpp );
+    }
+
+    memset( &attr, 0, sizeof(attr) );
+    attr.handle        = dpp;
+    attr.context_alloc = dispatch_context_alloc;
+    attr.block_func    = dispatch_block;
+    attr.unblock_func  = dispatch_unblock;
+    attr.handler_func  = dispatch_handler;
+    attr.context_free  = dispatch_context_free;
+    attr.lo_water      = ( numThreads < DISPATCHPOOL_LO_WATER )
+                         ? numThreads
+                         : DISPATCHPOOL_LO_WATER;
+    attr.increment     = 1;
+    attr.hi_water      = numThreads;
+    attr.maximum       = numThreads;
+
+    tpp = thread_pool_create( &attr, POOL_FLAG_USE_SELF );
+    if( NULL == tpp )
+    {
+        fprintf( stderr,
+                 "%s: cannot create the dispatch thread pool\n",
+                 __func__ );
+        return errno;
+    }
+
+    /* only returns on failure, the calling thread joins the pool */
+    thread_pool_start( tpp );
+
+    return errno;
+}
+
+/*============================================================================*/
+/*!
+
+    Block and handle the messages on the calling thread
+
+@param[in]
+    dpp
+        dispatch handle with the message handlers of the server attached
+
+@return
+    an error code from errno.h if the dispatch failed
+
+*/
+/*============================================================================*/
+static int dispatchpool_fnLoop( dispatch_t *dpp )
+{
+    dispatch_context_t *ctp;
+
+    ctp = dispatch_context_alloc( dpp );
+    if( NULL == ctp )
+    {
+        return ENOMEM;
+    }
+
+    for( ;; )
+    {
+        if( NULL == ( ctp = dispatch_block( ctp ) ) )
+        {
+            fprintf( stderr, "%s: dispatch_block failed\n", __func__ );
+            return errno;
+        }
+
+        dispatch_handler( ctp );
+    }
+
+    return EOK;
+}
+
+/*!
+ * @} // dispatchpool
+ */
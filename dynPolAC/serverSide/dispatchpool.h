@@ -0,0 +1,55 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef DISPATCHPOOL_H_
+#define DISPATCHPOOL_H_
+
+/*!
+ * @file dispatchpool.h
+ * @brief Public APIs for dispatching the server messages on a thread pool
+ *
+ * The dispatchpool.h file contains the public APIs for running the
+ * message dispatch loop of the server on several threads.
+ *
+ * @defgroup dispatchpool Dispatch Thread Pool
+ * @brief Multithreaded message dispatch
+ *
+ * The server attaches its message handlers (HASH_fnFindByName,
+ * POLICY_fnCreatePolicy, ...) to a dispatch handle as before and hands it
+ * to DISPATCHPOOL_fnRun instead of running its own receive loop.  With a
+ * single thread the loop is the classic block and handle loop, otherwise
+ * a QNX thread pool blocks and handles the messages on every thread.  The
+ * data point lookups and the policy checks run concurrently, the rule
+ * registration and the housekeeping are serialized by the policy module.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <sys/dispatch.h>
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! one dispatch thread per CPU */
+#define DISPATCHPOOL_THREADS_AUTO    ( 0 )
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int DISPATCHPOOL_fnRun( dispatch_t *dpp, int numThreads );
+
+/*! @} */
+
+#endif /* DISPATCHPOOL_H_ */
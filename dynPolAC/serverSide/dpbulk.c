@@ -0,0 +1,307 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup dpbulk
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  dpbulk.c
+
+ @brief
+    Bulk data point registration server
+
+    A data point file of a site holds tens of thousands of data points.
+    Created one call at a time, each point costs several message passes
+    and takes the locks of the store several times.  A client sends them
+    in batches instead (see policybulk.h), every batch is decoded here and
+    handed to the data point store in one call.
+
+    The batch is checked completely before the store sees it, a malformed
+    batch creates no data point.  A complete batch is logged for the
+    snapshot before the store creates it (see snapshot.h).
+
+ */
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/neutrino.h>
+#include "dpbulk.h"
+#include "snapshot.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Variables
+ =============================================================================*/
+
+/*! function of the data point store creating a batch */
+static tfnDpBulkStore pfnBulkStore = NULL;
+
+/*! context of the store function */
+static void *pBulkContext = NULL;
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Function Prototypes
+ =============================================================================*/
+
+static int dpbulk_fnDecode( char *pBuf,
+                            size_t length,
+                            tzDpBulkPoint *pPoints,
+                            int32_t *pResults,
+                            uint32_t *pNumPoints );
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+    Register the function of the data point store creating a batch
+
+    Called once by the store when the server starts, before the messages
+    are received.
+
+@param[in]
+    pfnStore
+        function creating the data points of a batch, NULL to refuse the
+        batches
+
+@param[in]
+    pContext
+        argument of the function
+
+*/
+/*============================================================================*/
+void DPBULK_fnSetStore( tfnDpBulkStore pfnStore, void *pContext )
+{
+    pBulkContext = pContext;
+    __atomic_store_n( &pfnBulkStore, pfnStore, __ATOMIC_RELEASE );
+}
+
+/*============================================================================*/
+/*!
+    Create the data points of a POLICY_HOUSEKEEP_DP_BULK message
+
+    The reply holds the result of every data point of the batch.
+
+@param[in]
+    rcvid
+        receive identifier used for message replies
+
+@param[in]
+    msg
+        pointer to the message, the records follow it and max holds their
+        length
+
+@param[in]
+    length
+        number of bytes received after the message, max may not exceed it
+
+@return
+    EOK : the batch was handled and replied
+    ENOSYS : the server has no data point store
+    EBADMSG : the batch is malformed
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DPBULK_fnRegister( int rcvid,
+                       datapoint_policy_msg_t *msg,
+                       size_t length )
+{
+    tfnDpBulkStore pfnStore;
+    tzDpBulkPoint *pPoints;
+    int32_t *pResults;
+    char *pBuf;
+    uint32_t numPoints = 0;
+    int ret = EOK;
+
+    pfnStore = __atomic_load_n( &pfnBulkStore, __ATOMIC_ACQUIRE );
+    if( NULL == pfnStore )
+    {
+        return ENOSYS;
+    }
+
+    /* the records must all have been received */
+    if( ( NULL == msg ) || ( msg->max < 0 ) ||
+        ( msg->max > DP_BULK_MAX_LENGTH ) || ( (size_t)msg->max > length ) )
+    {
+        return EINVAL;
+    }
+
+    pBuf = (char *)msg + sizeof(datapoint_policy_msg_t);
+    length = (size_t)msg->max;
+
+    pPoints = malloc( DP_BULK_MAX_POINTS * sizeof(tzDpBulkPoint) );
+    pResults = malloc( DP_BULK_MAX_POINTS * sizeof(int32_t) );
+    if( ( NULL == pPoints ) || ( NULL == pResults ) )
+    {
+        ret = ENOMEM;
+    }
+    else
+    {
+        ret = dpbulk_fnDecode( pBuf, length, pPoints, pResults, &numPoints );
+    }
+
+    if( ( EOK == ret ) && ( numPoints > 0u ) )
+    {
+        /* the records are logged before the store creates them */
+        ret = SNAPSHOT_fnBegin( SNAPSHOT_LOG_DP_BULK, pBuf, length );
+        if( EOK == ret )
+        {
+            ret = pfnStore( pPoints, numPoints, pResults, pBulkContext );
+        }
+
+        SNAPSHOT_fnEnd();
+    }
+
+    if( EOK == ret )
+    {
+        MsgReply( rcvid, EOK, pResults, numPoints * sizeof(int32_t) );
+    }
+
+    free( pPoints );
+    free( pResults );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Create the data points of a batch logged by DPBULK_fnRegister again,
+    see tfnSnapshotReplay
+
+@param[in]
+    pData
+        records of the batch
+
+@param[in]
+    length
+        length of the records
+
+@param[in]
+    pContext
+        unused
+
+@return
+    EOK : the batch was handed to the store, a data point which exists
+          already is not created again
+    ENOSYS : the server has no data point store
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int DPBULK_fnReplay( void *pData, size_t length, void *pContext )
+{
+    tfnDpBulkStore pfnStore;
+    tzDpBulkPoint *pPoints;
+    int32_t *pResults;
+    uint32_t numPoints = 0;
+    int ret;
+
+    (void)pContext;
+
+    pfnStore = __atomic_load_n( &pfnBulkStore, __ATOMIC_ACQUIRE );
+    if( NULL == pfnStore )
+    {
+        return ENOSYS;
+    }
+
+    pPoints = malloc( DP_BULK_MAX_POINTS * sizeof(tzDpBulkPoint) );
+    pResults = malloc( DP_BULK_MAX_POINTS * sizeof(int32_t) );
+    if( ( NULL == pPoints ) || ( NULL == pResults ) )
+    {
+        ret = ENOMEM;
+    }
+    else
+    {
+        ret = dpbulk_fnDecode( pData, length, pPoints, pResults, &numPoints );
+    }
+
+    if( ( EOK == ret ) && ( numPoints > 0u ) )
+    {
+        ret = pfnStore( pPoints, numPoints, pResults, pBulkContext );
+    }
+
+    free( pPoints );
+    free( pResults );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Decode every record of a batch
+
+@param[in]
+    pBuf
+        records of the batch
+
+@param[in]
+    length
+        length of the records
+
+@param[out]
+    pPoints
+        DP_BULK_MAX_POINTS data points
+
+@param[out]
+    pResults
+        DP_BULK_MAX_POINTS results, set to EOK for the decoded points
+
+@param[out]
+    pNumPoints
+        number of data points
+
+@return
+    EOK : the batch is complete
+    EMSGSIZE : the batch has more than DP_BULK_MAX_POINTS records
+    EBADMSG : the batch is malformed
+
+*/
+/*============================================================================*/
+static int dpbulk_fnDecode( char *pBuf,
+                            size_t length,
+                            tzDpBulkPoint *pPoints,
+                            int32_t *pResults,
+                            uint32_t *pNumPoints )
+{
+    size_t offset = 0;
+    uint32_t numPoints = 0;
+    int ret = EOK;
+
+    while( EOK == ret )
+    {
+        if( numPoints == DP_BULK_MAX_POINTS )
+        {
+            ret = ( offset < length ) ? EMSGSIZE : ENOENT;
+        }
+        else
+        {
+            ret = DP_fnBulkNext( pBuf, length, &offset, &pPoints[numPoints] );
+            if( EOK == ret )
+            {
+                pResults[numPoints++] = EOK;
+            }
+        }
+    }
+
+    *pNumPoints = numPoints;
+
+    return ( ENOENT == ret ) ? EOK : ret;
+}
+
+/*! @} */
@@ -0,0 +1,64 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef DPBULK_H_
+#define DPBULK_H_
+
+/*!
+ * @file dpbulk.h
+ * @brief Public APIs of the bulk data point registration server
+ *
+ * The dpbulk.h file contains the public APIs the server uses to create the
+ * data points of a POLICY_HOUSEKEEP_DP_BULK message (see policybulk.h).
+ *
+ * @defgroup dpbulk Bulk Data Point Registration Server
+ * @brief Server side of the bulk data point registration
+ *
+ * The data points are kept by the data point store of the server, not by
+ * the policy modules.  The store registers the function which creates a
+ * batch with DPBULK_fnSetStore when it starts, the message is refused with
+ * ENOSYS until then.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "minicloudmsg.h"
+#include "policybulk.h"
+
+/*==============================================================================
+                                  Types
+ =============================================================================*/
+
+/*! creates the data points of a batch in one pass, setting the result
+ *  (an errno) of each point, and returns EOK or the error failing the
+ *  whole batch */
+typedef int (*tfnDpBulkStore)( const tzDpBulkPoint *pPoints,
+                               uint32_t numPoints,
+                               int32_t *pResults,
+                               void *pContext );
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+void DPBULK_fnSetStore( tfnDpBulkStore pfnStore, void *pContext );
+int DPBULK_fnRegister( int rcvid,
+                       datapoint_policy_msg_t *msg,
+                       size_t length );
+int DPBULK_fnReplay( void *pData, size_t length, void *pContext );
+
+/*! @} */
+
+#endif /* DPBULK_H_ */
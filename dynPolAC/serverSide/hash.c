@@ -26,6 +26,14 @@ Mini Cloud Server Project.
     table or a name hash table.  data points can be quickly retrieved
     from the hash tables by name or GUID.
 
+    The tables may be used by several dispatch threads at once.  The data
+    point tables are guarded by a reader/writer lock, lookups share it and
+    only the registration of a data point takes it exclusively.  The policy
+    hash is split in shards by the hash of the key, each with its own
+    reader/writer lock, so a rule update only holds back the checks which
+    look up a rule in the same shard.  The tables are created without the
+    internal cfuhash mutex as the locks above already cover them.
+
 */
 
 /*==============================================================================
@@ -40,10 +48,12 @@ Mini Cloud Server Project.
 #include <errno.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include "cfuhash.h"
 #include "hash.h"
 #include "dp.h"
 #include "name.h"
+#include "subject.h"
 
 /*==============================================================================
  	 	 	 	 	 	 	 	 	 Defines
@@ -56,10 +66,28 @@ Mini Cloud Server Project.
 /*! an estimate for the number of data points to be created */
 #define ESTIMATED_NUM_DPS       ( 30000 )
 
+/*! number of shards of the policy hash, a power of two */
+#define POLICY_HASH_SHARDS      ( 16 )
+
+/*! FNV-1a offset basis and prime used to pick a policy hash shard */
+#define SHARD_FNV_BASIS         ( 2166136261u )
+#define SHARD_FNV_PRIME         ( 16777619u )
+
 /*=============================================================================
  	 	 	 	 	 	 	 	 Structures
  =============================================================================*/
 
+/*! shard of the policy hash */
+typedef struct zPolicyShard
+{
+    /*! hash table to store the policy hash string */
+    cfuhash_table_t *pHash;
+
+    /*! checks share the lock, rule updates take it exclusively */
+    pthread_rwlock_t lock;
+
+} tzPolicyShard;
+
 
 /*==============================================================================
  	 	 	 	 	 	 	 Local/Private Variables
@@ -71,11 +99,14 @@ static cfuhash_table_t *hash = NULL;
 /*! hash table to store the Globally Unique Identification Strings */
 static cfuhash_table_t *guidhash = NULL;
 
-/*! hash table to store the policy hash string */
-static cfuhash_table_t *hashPolicy = NULL;
+/*! lock of the data point name and GUID hash tables */
+static pthread_rwlock_t dpLock = PTHREAD_RWLOCK_INITIALIZER;
 
-/*! List of policy rule house keeper */
-static tzHouseKeep hs[ ESTIMATED_NUM_POLICY ];
+/*! shards of the policy hash */
+static tzPolicyShard policyShards[ POLICY_HASH_SHARDS ];
+
+/*! List of policy rule house keeper, only used by the policy writers */
+static tzHouseKeep hs[ MAX_NUM_POLICY ];
 
 /*==============================================================================
  Local/Private Function Prototypes
@@ -91,6 +122,11 @@ static int hash_fnBuildNameKey( char *name,
                                 char *key,
                                 size_t key_len );
 
+static void hash_fnInsert( struct dp_id_t *pDatapointID,
+                           char *optional_name );
+
+static tzPolicyShard* hash_fnPolicyShard( const char *hashString );
+
 /*==============================================================================
  Function Definitions
  =============================================================================*/
@@ -101,7 +137,7 @@ static int hash_fnBuildNameKey( char *name,
     initialise the hash tables
 
     The HASH_fnSetup function initialises the name, GUID, and policy
-    hash tables.
+    hash tables, and the policy user and group tables.
 
 @return
     None
@@ -110,13 +146,27 @@ static int hash_fnBuildNameKey( char *name,
 /*============================================================================*/
 void HASH_fnSetup(void)
 {
+    int i;
+
     /* create the hash table */
     hash = cfuhash_new_with_initial_size( ESTIMATED_NUM_DPS );
     guidhash = cfuhash_new_with_initial_size( ESTIMATED_NUM_DPS );
-    hashPolicy = cfuhash_new_with_initial_size( ESTIMATED_NUM_POLICY );
+    cfuhash_set_flag( hash, CFUHASH_NO_LOCKING );
+    cfuhash_set_flag( guidhash, CFUHASH_NO_LOCKING );
+
+    for( i = 0; i < POLICY_HASH_SHARDS; i++ )
+    {
+        policyShards[i].pHash =
+                cfuhash_new_with_initial_size( ESTIMATED_NUM_POLICY );
+        cfuhash_set_flag( policyShards[i].pHash, CFUHASH_NO_LOCKING );
+        pthread_rwlock_init( &policyShards[i].lock, NULL );
+    }
 
     /* reset the house keeping array for the policy */
     memset( hs, 0, sizeof(hs) );
+
+    /* intern the known policy users and groups */
+    SUBJECT_fnSetup();
 }
 
 /*============================================================================*/
@@ -183,7 +233,9 @@ int HASH_fnFindByName( int rcvid, datapoint_get_msg_t *msg,
                          sizeof(key) );
 
     /* search for the data point */
+    pthread_rwlock_rdlock( &dpLock );
     pDatapointID = cfuhash_get(hash, key );
+    pthread_rwlock_unlock( &dpLock );
     if( pDatapointID == NULL )
     {
         return ENOENT;
@@ -285,6 +337,7 @@ int HASH_fnFindByGUID( int rcvid, datapoint_guid_msg_t *msg,
 struct dp_id_t *HASH_fnLookupByName( char *name, uint32_t instanceID )
 {
     char key[DP_MAX_NAME_LENGTH + 10];
+    struct dp_id_t *pDatapointID;
 
     /* apply character translations (if any) to the name */
     NAME_fnConvert( name );
@@ -294,7 +347,11 @@ struct dp_id_t *HASH_fnLookupByName( char *name, uint32_t instanceID )
                          key,
                          sizeof(key));
 
-    return cfuhash_get( hash, key );
+    pthread_rwlock_rdlock( &dpLock );
+    pDatapointID = cfuhash_get( hash, key );
+    pthread_rwlock_unlock( &dpLock );
+
+    return pDatapointID;
 }
 
 /*============================================================================*/
@@ -339,13 +396,18 @@ Version: 1.02    Date: 17-Jun-2015    By:
 struct dp_id_t *HASH_fnLookupById( uint32_t guid, uint32_t instanceID )
 {
     char guidString[20];
+    struct dp_id_t *pDatapointID;
 
     hash_fnBuildGUIDKey( guid,
                            instanceID,
                            guidString,
                            sizeof(guidString));
 
-    return cfuhash_get(guidhash, guidString );
+    pthread_rwlock_rdlock( &dpLock );
+    pDatapointID = cfuhash_get(guidhash, guidString );
+    pthread_rwlock_unlock( &dpLock );
+
+    return pDatapointID;
 }
 
 /*============================================================================*/
@@ -550,6 +612,83 @@ static int hash_fnBuildNameKey( char *name,
 */
 /*============================================================================*/
 int HASH_fnAdd( struct dp_id_t *pDatapointID, char *optional_name )
+{
+    pthread_rwlock_wrlock( &dpLock );
+
+    hash_fnInsert( pDatapointID, optional_name );
+
+    pthread_rwlock_unlock( &dpLock );
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  HASH_fnAddMany
+/*!
+
+@brief
+    Add the names of many data points into the hash table(s) under one
+    lock, see HASH_fnAdd
+
+@param[in]
+    ppDatapointIDs
+        data point of each name
+
+@param[in]
+    ppNames
+        name of each entry, a NULL name uses the data point name
+
+@param[in]
+    num
+        number of entries
+
+@return
+    this function returns EOK on success or any other value from errno.h
+    on failure.
+
+*/
+/*============================================================================*/
+int HASH_fnAddMany( struct dp_id_t * const *ppDatapointIDs,
+                    char * const *ppNames,
+                    int num )
+{
+    int i;
+
+    if( ( num < 0 ) ||
+        ( ( num > 0 ) && ( ( NULL == ppDatapointIDs ) ||
+                           ( NULL == ppNames ) ) ) )
+    {
+        return EINVAL;
+    }
+
+    pthread_rwlock_wrlock( &dpLock );
+
+    for( i = 0; i < num; i++ )
+    {
+        hash_fnInsert( ppDatapointIDs[i], ppNames[i] );
+    }
+
+    pthread_rwlock_unlock( &dpLock );
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Insert a data point into the hash table(s), dpLock is held for writing
+
+@param[in]
+    pDatapointID
+        Pointer to a data point
+
+@param[in]
+    optional_name
+        name to use to create the hash key, NULL for the data point name
+
+*/
+/*============================================================================*/
+static void hash_fnInsert( struct dp_id_t *pDatapointID, char *optional_name )
 {
     char key[DP_MAX_NAME_LENGTH + 10];
     char *name = optional_name;
@@ -579,8 +718,6 @@ int HASH_fnAdd( struct dp_id_t *pDatapointID, char *optional_name )
         /* perform the insert */
         cfuhash_put( guidhash, key, pDatapointID );
     }
-
-    return EOK;
 }
 
 /*============================================================================*/
@@ -602,7 +739,14 @@ int HASH_fnAdd( struct dp_id_t *pDatapointID, char *optional_name )
 /*============================================================================*/
 bool POLICYHASH_fnCheck( char *hashString )
 {
-    return cfuhash_exists(hashPolicy, hashString);
+    tzPolicyShard *pShard = hash_fnPolicyShard( hashString );
+    bool exists;
+
+    pthread_rwlock_rdlock( &pShard->lock );
+    exists = cfuhash_exists( pShard->pHash, hashString );
+    pthread_rwlock_unlock( &pShard->lock );
+
+    return exists;
 }
 
 /*============================================================================*/
@@ -628,11 +772,16 @@ bool POLICYHASH_fnCheck( char *hashString )
 void* POLICYHASH_fnPut( struct policy_id_t* pPolicy, char* pHashString )
 {
 	void* ret = (int*)(-1);
+	tzPolicyShard *pShard = NULL;
 
 	if( (NULL != pPolicy) && ( NULL != pHashString) )
 	{
+	    pShard = hash_fnPolicyShard( pHashString );
+
 	    /* perform the insert */
-	    ret = cfuhash_put( hashPolicy, pHashString, pPolicy );
+	    pthread_rwlock_wrlock( &pShard->lock );
+	    ret = cfuhash_put( pShard->pHash, pHashString, pPolicy );
+	    pthread_rwlock_unlock( &pShard->lock );
 	}
 
     return ( ret );
@@ -658,11 +807,17 @@ void* POLICYHASH_fnPut( struct policy_id_t* pPolicy, char* pHashString )
 int POLICYHASH_fnRemove( char* pHashString )
 {
 	int ret = EINVAL;
+	tzPolicyShard *pShard = NULL;
 
 	if( NULL != pHashString )
 	{
-	    /*  delete from policy hash  */
-	    cfuhash_delete( hashPolicy, pHashString );
+	    pShard = hash_fnPolicyShard( pHashString );
+
+	    /*  delete from policy hash, the rule itself is retired by the
+	     *  caller as a check may still hold it */
+	    pthread_rwlock_wrlock( &pShard->lock );
+	    cfuhash_delete( pShard->pHash, pHashString );
+	    pthread_rwlock_unlock( &pShard->lock );
 	    ret = EOK;
 	}
 
@@ -694,7 +849,14 @@ int POLICYHASH_fnRemove( char* pHashString )
 /*============================================================================*/
 struct policy_id_t* POLICYHASH_fnFind( char* hashString )
 {
-    return cfuhash_get( hashPolicy, hashString );
+    tzPolicyShard *pShard = hash_fnPolicyShard( hashString );
+    struct policy_id_t* pPolicy;
+
+    pthread_rwlock_rdlock( &pShard->lock );
+    pPolicy = cfuhash_get( pShard->pHash, hashString );
+    pthread_rwlock_unlock( &pShard->lock );
+
+    return pPolicy;
 }
 
 /*============================================================================*/
@@ -702,6 +864,9 @@ struct policy_id_t* POLICYHASH_fnFind( char* hashString )
 	this is an accessor function, it returns the address of the array that
 	keeps the house keeping policies
 
+	The array is not locked, it is only used by the policy writers which the
+	policy module serializes.
+
 @return
     array handle keeping the house keeping policy structure array
 
@@ -712,6 +877,33 @@ tzHouseKeep* POLICYHASH_fnHouseKeepAccessor( void )
 	return ( hs );
 }
 
+/*============================================================================*/
+/*!
+
+    Select the shard of the policy hash holding a policy hash string
+
+@param[in]
+    hashString
+        policy hash string
+
+@return
+    shard of the policy hash
+
+*/
+/*============================================================================*/
+static tzPolicyShard* hash_fnPolicyShard( const char *hashString )
+{
+    uint32_t h = SHARD_FNV_BASIS;
+
+    while( '\0' != *hashString )
+    {
+        h ^= (uint8_t)*hashString++;
+        h *= SHARD_FNV_PRIME;
+    }
+
+    return &policyShards[ h & ( POLICY_HASH_SHARDS - 1 ) ];
+}
+
 /*!
  * @} // hash
  */
@@ -44,6 +44,9 @@ Mini Cloud Server Project.
 /*! an estimate for the number of distinct policy rule buckets */
 #define ESTIMATED_NUM_POLICY    ( 200 )
 
+/*! maximum number of policy rules kept by the policy housekeeping */
+#define MAX_NUM_POLICY          ( 16384 )
+
 /*==============================================================================
  	 	 	 	 	 	 	 	 Structures
  =============================================================================*/
@@ -68,6 +71,10 @@ void HASH_fnSetup(void);
 int HASH_fnAdd( struct dp_id_t *pDatapointID,
                 char *optional_name );
 
+int HASH_fnAddMany( struct dp_id_t * const *ppDatapointIDs,
+                    char * const *ppNames,
+                    int num );
+
 int HASH_fnFindByName( int rcvid, datapoint_get_msg_t *msg,
                        struct _cred_info *cred );
 
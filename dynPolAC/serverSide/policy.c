@@ -30,6 +30,15 @@ Mini Cloud Server Project.
 
     Functions are provided to manipulate data point timestamps and quality.
 
+    The policy check may run on several dispatch threads at once.  The rule
+    registration and the housekeeping are serialized by the policy write
+    lock, the check never takes it and only meets the short per shard and
+    per engine locks of the read path.  A rule taken out of the hash or
+    replaced is retired, not released, as a check which found it may still
+    be using it.  The commit rebuilds the decision diagram without the
+    retired rules, then waits for the hash checks holding the rule lock,
+    the way a native rule set is swapped, and releases them.
+
  */
 
 /*==============================================================================
@@ -43,10 +52,24 @@ Mini Cloud Server Project.
 #include <errno.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/neutrino.h>
 #include <sys/trace.h>
+#include <sys/syspage.h>
 #include "hash.h"
 #include "policy.h"
+#include "comparator.h"
+#include "policydd.h"
+#include "policynative.h"
+#include "policyvm.h"
+#include "policyserve.h"
+#include "dpbulk.h"
+#include "snapshot.h"
+#include "subject.h"
+#include "policymsg.h"
+#include "policydelta.h"
 #include "tags.h"
 
 /*==============================================================================
@@ -56,11 +79,120 @@ Mini Cloud Server Project.
 #define MAX_TAG_STRING_LENGTH        ( 128 )
 /*! maximum static length of the hashString construction */
 #define MAX_HASH_STRING_LENGTH       ( 1024 )
+/*! size of the location of a rule, its terminator included */
+#define POLICY_LOCATION_LENGTH       ( sizeof( ((struct zPOLICY *)0)->Location ) )
+/*! number of words of a wild card set in a snapshot */
+#define POLICY_SNAPSHOT_ANY          ( 0xFFFFFFFFu )
+/*! largest payload of a MSG_DP_POLICY_REGISTER message */
+#define POLICY_REGISTER_MAX_PAYLOAD  ( POLICY_LOCATION_LENGTH + \
+                                       2 * POLICY_SUBJECT_LIST_LENGTH + \
+                                       sizeof(tzPolicyProgram) )
 
 /*=============================================================================
  	 	 	 	 	 	 	 	 Structures
  =============================================================================*/
 
+/*! decision function of a policy check engine */
+typedef int (*tfnPolicyDecide)( struct dp_t *pDp,
+		                        int typeInt,
+		                        char *location,
+		                        const tzSubjectIds *pUsers,
+		                        const tzSubjectIds *pGroups );
+
+/*! header of the policy section of a snapshot, the subject names follow
+ *  it (the users then the groups, NUL terminated and padded to
+ *  SNAPSHOT_ALIGN), then the rules */
+typedef struct zPolicySnapshotHeader
+{
+	/*! size of a tzPolicySnapshotRule */
+	uint32_t ruleSize;
+
+	/*! size of a tzPolicyProgram */
+	uint32_t programSize;
+
+	/*! number of rules */
+	uint32_t numRules;
+
+	/*! length of the subject names with their padding */
+	uint32_t namesLength;
+
+	/*! number of user names */
+	uint32_t numUsers;
+
+	/*! number of group names */
+	uint32_t numGroups;
+
+} tzPolicySnapshotHeader;
+
+/*! rule of a snapshot, followed by the words of its user set, the words
+ *  of its group set and its tzPolicyProgram if it has one */
+typedef struct zPolicySnapshotRule
+{
+	/*! rule as registered */
+	struct zPOLICY policy;
+
+	/*! number of words of the user set, POLICY_SNAPSHOT_ANY for the wild
+	 *  card, the sets use the bits of the saved subjects */
+	uint32_t numUserWords;
+
+	/*! number of words of the group set, POLICY_SNAPSHOT_ANY for the wild
+	 *  card */
+	uint32_t numGroupWords;
+
+	/*! key of the rule */
+	uint64_t key;
+
+	/*! fingerprint of the rule */
+	uint64_t fingerprint;
+
+	/*! a condition program follows the rule */
+	uint32_t hasProgram;
+
+	/*! the rule was registered since the last commit */
+	uint32_t seen;
+
+} tzPolicySnapshotRule;
+
+/*! payload of a MSG_DP_POLICY_REGISTER message, see policy_fnParsePayload */
+typedef struct zPolicyPayload
+{
+	/*! location of the rule */
+	char *pLocation;
+
+	/*! comma separated user names, NULL if the subjects are codes */
+	char *pUsers;
+
+	/*! comma separated group names, NULL if the subjects are codes */
+	char *pGroups;
+
+	/*! tzPolicyProgram of the condition, unaligned, NULL if none */
+	const char *pProgram;
+
+	/*! length of the payload up to the end of its last part */
+	size_t length;
+
+} tzPolicyPayload;
+
+/*! data point synthesized from a rule by the rule benchmark */
+typedef struct zPolicyBenchQuery
+{
+	/*! data point with the value in the middle of the rule range */
+	struct dp_t dp;
+
+	/*! category type of the rule */
+	int typeInt;
+
+	/*! location of the rule */
+	char location[ MAX_LOCATION_STRING_LENGTH ];
+
+	/*! one of the users of the rule */
+	tzSubjectIds users;
+
+	/*! one of the groups of the rule */
+	tzSubjectIds groups;
+
+} tzPolicyBenchQuery;
+
 /*==============================================================================
  	 	 	 	 	 	 External/Public Variables
  =============================================================================*/
@@ -72,28 +204,83 @@ char *tagMap[DP_SERVER_MAX_TAGS+1];
  	 	 	 	 	 	 Local/Private Variables
  =============================================================================*/
 
+/*! engine used by the policy check, read by the checks without a lock */
+static tePolicyEngine policyEngine = POLICY_ENGINE_HASH;
+
+/*! serializes the rule registration and the housekeeping */
+static pthread_mutex_t policyWriteLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*! held for reading by the hash checks while they use a rule */
+static pthread_rwlock_t ruleLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*! rules taken out of the hash since the last commit, linked by pNext,
+ *  only used by the policy writers */
+static struct policy_id_t *pRetired = NULL;
+
 /*==============================================================================
  	 	 	 	 	 Local/Private Function Prototypes
 ==============================================================================*/
 //static char* policy_fnTypeVal2String( int Type );
 static int policy_fnTypeString2Val( char* Type );
-static bool policy_fnBoundChecking( struct dp_t *pDp,
-		                            struct policy_id_t* pPolicy );
-static int policy_fnCheckVal( struct dp_t *pDp,
-		                      struct policy_id_t* pPolicy);
+static int policy_fnRegister( datapoint_policy_msg_t *msg, size_t length );
+static int policy_fnCreate( datapoint_policy_msg_t *msg,
+                            const tzPolicyPayload *pPayload );
+static int policy_fnParsePayload( datapoint_policy_msg_t *msg,
+                                  size_t length,
+                                  tzPolicyPayload *pPayload );
+static char* policy_fnPayloadString( char **pp, char *pEnd, size_t size );
+static int policy_fnPublish( struct policy_id_t* newPolicy,
+                             char* hashString,
+                             bool seen );
+static void policy_fnFree( struct policy_id_t* pPolicy );
+static void policy_fnRetire( struct policy_id_t* pPolicy );
+static void policy_fnReclaim( void );
+static int policy_fnSaveSet( FILE *fp, const tzSubjectSet *pSet );
+static int policy_fnLoadSet( char **pp,
+                             char *pEnd,
+                             uint32_t numWords,
+                             tzSubjectSet *pSet );
+static int policy_fnRestoreSubjects( const char *pNames,
+                                     size_t length,
+                                     teSubjectKind kind,
+                                     uint32_t count,
+                                     const char **ppNext );
 static bool policy_fnCheckLoc( char* location,
                                struct policy_id_t* pPolicy );
-static bool policy_fnCheckUser( uint32_t user, struct policy_id_t* pPolicy );
-static bool policy_fnCheckGroup( uint32_t group, struct policy_id_t* pPolicy );
-static int policy_fnCheckAttr( char* location,
-		                       uint32_t userID,
-		                       uint32_t groupID,
+static bool policy_fnCheckUser( const tzSubjectIds *pUsers,
+                                struct policy_id_t* pPolicy );
+static bool policy_fnCheckGroup( const tzSubjectIds *pGroups,
+                                 struct policy_id_t* pPolicy );
+static int policy_fnCheckAttr( struct dp_t *pDp,
+		                       char* location,
+		                       const tzSubjectIds *pUsers,
+		                       const tzSubjectIds *pGroups,
 		                       struct policy_id_t* pPolicy );
+static int policy_fnHashDecide( struct dp_t *pDp,
+		                        int typeInt,
+		                        char *location,
+		                        const tzSubjectIds *pUsers,
+		                        const tzSubjectIds *pGroups );
 static int policy_fnTokenizeTags( struct dp_t* pDp,
-		                          int*         typeInt,
-		                          char*        location,
-		                          uint32_t*    userID,
-		                          uint32_t*    groupID  );
+		                          int*          typeInt,
+		                          char*         location,
+		                          tzSubjectIds* pUsers,
+		                          tzSubjectIds* pGroups  );
+static int policy_fnHouseKeep( int rcvid,
+                               datapoint_policy_msg_t *msg,
+                               size_t length );
+static size_t policy_fnPayloadLength( const datapoint_policy_msg_t *msg );
+static int policy_fnReadMessage( int rcvid,
+                                 const datapoint_policy_msg_t *msg,
+                                 size_t maxLength,
+                                 datapoint_policy_msg_t **ppCopy,
+                                 size_t *pLength );
+static int policy_fnFingerprints( int rcvid, tzHouseKeep* housekeeper );
+static int policy_fnDeltaRemove( tzHouseKeep* housekeeper,
+		                         const uint64_t *pRemove,
+		                         uint32_t numRemove );
+static int policy_fnKeyCompare( const void *pA, const void *pB );
+static void policy_fnCommit( tzHouseKeep* housekeeper );
 
 /*==============================================================================
  	 	 	 	 	 	 Function Definitions
@@ -121,13 +308,131 @@ static int policy_fnTokenizeTags( struct dp_t* pDp,
 */
 /*============================================================================*/
 int POLICY_fnCreatePolicy( int rcvid, datapoint_policy_msg_t *msg )
+{
+	datapoint_policy_msg_t *pCopy = NULL;
+	size_t length = 0;
+	int ret;
+
+	if( NULL == msg )
+	{
+		return EINVAL;
+	}
+
+	/* the location, the subject lists and the program are read from the
+	 * client, the receive buffer may hold only part of them */
+	ret = policy_fnReadMessage( rcvid,
+	                            msg,
+	                            POLICY_REGISTER_MAX_PAYLOAD,
+	                            &pCopy,
+	                            &length );
+	if( EOK == ret )
+	{
+		ret = policy_fnRegister( pCopy, length );
+		free( pCopy );
+	}
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Replay a rule registration logged by POLICY_fnCreatePolicy, see
+	tfnSnapshotReplay
+
+@param[in]
+    pData
+        the message followed by its payload
+
+@param[in]
+    length
+        length of the message and its payload
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+int POLICY_fnCreateReplay( void *pData, size_t length )
+{
+	if( ( NULL == pData ) || ( length < sizeof(datapoint_policy_msg_t) ) )
+	{
+		return EBADMSG;
+	}
+
+	return policy_fnRegister( (datapoint_policy_msg_t *)pData,
+	                          length - sizeof(datapoint_policy_msg_t) );
+}
+
+/*============================================================================*/
+/*!
+	Check, log and create a rule whose payload was received
+
+@param[in]
+    msg
+        pointer to the datapoint_policy_msg_t message type followed by its
+        payload
+
+@param[in]
+    length
+        length of the payload
+
+@return
+    EOK on success, EINVAL if the payload is not well formed, any other
+    standard error code on failure
+
+*/
+/*============================================================================*/
+static int policy_fnRegister( datapoint_policy_msg_t *msg, size_t length )
+{
+	tzPolicyPayload payload;
+	int ret;
+
+	ret = policy_fnParsePayload( msg, length, &payload );
+	if( EOK != ret )
+	{
+		return ret;
+	}
+
+	/* the rule is logged before it is registered, see snapshot.h */
+	ret = SNAPSHOT_fnBegin( SNAPSHOT_LOG_POLICY_CREATE,
+	                        msg,
+	                        sizeof(datapoint_policy_msg_t) + payload.length );
+	if( EOK == ret )
+	{
+		ret = policy_fnCreate( msg, &payload );
+	}
+
+	SNAPSHOT_fnEnd();
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Create a rule from a MSG_DP_POLICY_REGISTER message
+
+@param[in]
+    msg
+        pointer to the datapoint_policy_msg_t message type
+
+@param[in]
+    pPayload
+        the payload of the message, checked by policy_fnParsePayload
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+static int policy_fnCreate( datapoint_policy_msg_t *msg,
+                            const tzPolicyPayload *pPayload )
 {
 	struct policy_id_t* newPolicy = NULL;
-    char* pLocation = NULL;
+    char* pLocation = pPayload->pLocation;
+    char* pUsers = pPayload->pUsers;
+    char* pGroups = pPayload->pGroups;
+    tzPolicyProgram wire;
     char  hashString[ MAX_HASH_STRING_LENGTH ];
-    tzHouseKeep* housekeeper = NULL;
-    void* found;
-    int i = 0;
     int ret = EOK;
 
     memset( hashString, 0, sizeof(hashString) );
@@ -137,14 +442,8 @@ int POLICY_fnCreatePolicy( int rcvid, datapoint_policy_msg_t *msg )
     {
         ret = ENOMEM;
     }
-    else if( msg == NULL )
-    {
-        ret = EINVAL;
-    }
     else
     {
-    	pLocation = (char *)msg + sizeof(datapoint_policy_msg_t);
-
 		newPolicy->policy.Name        = msg->Name;
 		newPolicy->policy.Type        = msg->Type;
 		newPolicy->policy.max         = msg->max;
@@ -152,6 +451,59 @@ int POLICY_fnCreatePolicy( int rcvid, datapoint_policy_msg_t *msg )
 		newPolicy->policy.time.tv_sec = msg->time.tv_sec;
 		newPolicy->policy.user        = msg->user;
 		newPolicy->policy.group       = msg->group;
+		newPolicy->users.any          = true;
+		newPolicy->groups.any         = true;
+
+		/* convert the range to the data point types once */
+		COMPARATOR_fnBind( msg->min, msg->max, &newPolicy->bounds );
+
+		/* the rule subjects are kept as user and group sets */
+		if( NULL != pUsers )
+		{
+			/* the condition program follows the subject lists */
+			if( NULL != pPayload->pProgram )
+			{
+				memcpy( &wire, pPayload->pProgram, sizeof(wire) );
+				newPolicy->pProgram = POLICYVM_fnLoad( &wire );
+				if( NULL == newPolicy->pProgram )
+				{
+					/* an invalid condition is not registered */
+					ret = EINVAL;
+				}
+			}
+
+			if( EOK == ret )
+			{
+				ret = SUBJECT_fnInternSet( eSubjectUser,
+				                           pUsers,
+				                           &newPolicy->users );
+			}
+			if( EOK == ret )
+			{
+				ret = SUBJECT_fnInternSet( eSubjectGroup,
+				                           pGroups,
+				                           &newPolicy->groups );
+			}
+		}
+		else
+		{
+			ret = SUBJECT_fnCodeToSet( eSubjectUser,
+			                           msg->user,
+			                           &newPolicy->users );
+			if( EOK == ret )
+			{
+				ret = SUBJECT_fnCodeToSet( eSubjectGroup,
+				                           msg->group,
+				                           &newPolicy->groups );
+			}
+		}
+
+		if( EOK != ret )
+		{
+			/* a rule naming a subject which cannot be kept is refused */
+			policy_fnFree( newPolicy );
+			return ret;
+		}
 
 		/* check if timepec is valid */
 		if( 0 != msg->time.tv_sec )
@@ -161,6 +513,22 @@ int POLICY_fnCreatePolicy( int rcvid, datapoint_policy_msg_t *msg )
 					sizeof(struct timespec) );
 		}
 
+		/* the client compares the fingerprints to send only changed rules */
+		newPolicy->key = POLICYDELTA_fnKey( msg->Name, msg->Type, pLocation );
+		newPolicy->fingerprint = POLICYDELTA_fnFingerprint(
+		                    msg->Name,
+		                    msg->Type,
+		                    msg->max,
+		                    msg->min,
+		                    (int64_t)msg->time.tv_sec,
+		                    msg->user,
+		                    msg->group,
+		                    pLocation,
+		                    pUsers,
+		                    pGroups,
+		                    ( NULL != newPolicy->pProgram ) ? &wire : NULL );
+
+		/* the location fits, see policy_fnParsePayload */
 		strcpy(newPolicy->policy.Location, pLocation);
 
 		/* the order is name, type, location */
@@ -170,124 +538,1579 @@ int POLICY_fnCreatePolicy( int rcvid, datapoint_policy_msg_t *msg )
 				 newPolicy->policy.Type,
 				 strlwr(newPolicy->policy.Location) );
 
-		/* update the hash  */
-		found = POLICYHASH_fnPut( newPolicy, hashString );
-		if( (int*)(-1) == found )
+		pthread_mutex_lock( &policyWriteLock );
+		ret = policy_fnPublish( newPolicy, hashString, true );
+		pthread_mutex_unlock( &policyWriteLock );
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+	Find the location, the subject lists and the condition program of a
+	MSG_DP_POLICY_REGISTER message within the payload received
+
+	Every string must be terminated within the payload and within its
+	field, the program must be complete.  A field too long is refused,
+	not cut.
+
+@param[in]
+    msg
+        pointer to the datapoint_policy_msg_t message type followed by its
+        payload
+
+@param[in]
+    length
+        length of the payload received
+
+@param[out]
+    pPayload
+        the parts of the payload, its length without the bytes after them
+
+@return
+    EOK on success, EINVAL if the payload is not well formed
+
+*/
+/*============================================================================*/
+static int policy_fnParsePayload( datapoint_policy_msg_t *msg,
+                                  size_t length,
+                                  tzPolicyPayload *pPayload )
+{
+	char* p = (char *)msg + sizeof(datapoint_policy_msg_t);
+	char* pEnd = p + length;
+
+	memset( pPayload, 0, sizeof(tzPolicyPayload) );
+
+	pPayload->pLocation = policy_fnPayloadString( &p,
+	                                              pEnd,
+	                                              POLICY_LOCATION_LENGTH );
+	if( NULL == pPayload->pLocation )
+	{
+		return EINVAL;
+	}
+
+	if( ( POLICY_SUBJECT_LIST == msg->user ) &&
+		( ( POLICY_SUBJECT_LIST == msg->group ) ||
+		  ( POLICY_SUBJECT_PROGRAM == msg->group ) ) )
+	{
+		/* the user and the group lists */
+		pPayload->pUsers = policy_fnPayloadString( &p,
+		                                           pEnd,
+		                                           POLICY_SUBJECT_LIST_LENGTH );
+		pPayload->pGroups = ( NULL == pPayload->pUsers ) ? NULL :
+		                    policy_fnPayloadString( &p,
+		                                            pEnd,
+		                                            POLICY_SUBJECT_LIST_LENGTH );
+		if( NULL == pPayload->pGroups )
 		{
-			ret = EINVAL;
+			return EINVAL;
 		}
-		else
+
+		if( POLICY_SUBJECT_PROGRAM == msg->group )
 		{
-			housekeeper = POLICYHASH_fnHouseKeepAccessor(  );
-			if( NULL == housekeeper )
-			{
-				ret = EINVAL;
-			}
-			else
+			if( (size_t)( pEnd - p ) < sizeof(tzPolicyProgram) )
 			{
-				/* access the housekeeper for policy, policy is new */
-				if( (void*)NULL == (void*)found )
-				{
-					/* find an emery spot in the array and place */
-					for( i=0; i< ESTIMATED_NUM_POLICY; i++)
-					{
-						if( NULL == housekeeper[i].pPolicy )
-						{
-							housekeeper[i].pPolicy = newPolicy;
-							housekeeper[i].Seen = true;
-							break;
-						}
-					}
-				}
-				else
-				{
-					/* not new so mark is as seen in this iteration */
-					/* find an emery spot in the array and place */
-					for( i=0; i< ESTIMATED_NUM_POLICY; i++)
-					{
-						if( found == housekeeper[i].pPolicy )
-						{
-							housekeeper[i].Seen = true;
-							housekeeper[i].pPolicy = newPolicy;
-							break;
-						}
-					}
-				}
+				return EINVAL;
 			}
+			pPayload->pProgram = p;
+			p += sizeof(tzPolicyProgram);
 		}
-    }
+	}
 
-    return ret;
+	pPayload->length = (size_t)( p - ( (char *)msg +
+	                                   sizeof(datapoint_policy_msg_t) ) );
+
+	return EOK;
 }
 
 /*============================================================================*/
 /*!
-	remove the rules that has not been visited since the current time that
-	the new policy enforcement has happened.
+	Take a string of a payload
+
+@param[in,out]
+    pp
+        the string, moved past it
 
 @param[in]
-    rcvid
-        receive identifier used for message replies
+    pEnd
+        end of the payload
 
 @param[in]
-    msg
-        pointer to the datapoint_policy_msg_t message type
+    size
+        size of the field of the string, its terminator included
+
+@return
+    the string, NULL if it is not terminated within the payload or does not
+    fit its field
+
+*/
+/*============================================================================*/
+static char* policy_fnPayloadString( char **pp, char *pEnd, size_t size )
+{
+	char* p = *pp;
+	char* pNul;
+	size_t avail = (size_t)( pEnd - p );
+
+	pNul = memchr( p, '\0', ( avail < size ) ? avail : size );
+	if( NULL == pNul )
+	{
+		return NULL;
+	}
+
+	*pp = pNul + 1;
+
+	return p;
+}
+
+/*============================================================================*/
+/*!
+	Put a rule in the policy hash and in the housekeeper, called with the
+	policy write lock held
+
+	The rule it replaces is retired.  The rule is owned by the policy
+	module once published, it is retired or released on failure.
+
+@param[in]
+    newPolicy
+        the rule
+
+@param[in]
+    hashString
+        name, type and lower case location of the rule
+
+@param[in]
+    seen
+        the rule was registered since the last commit
 
 @return
     EOK on success, any other standard error code on failure
 
 */
 /*============================================================================*/
-int POLICY_fnHouseKeepPolicy( int rcvid, datapoint_policy_msg_t *msg )
+static int policy_fnPublish( struct policy_id_t* newPolicy,
+                             char* hashString,
+                             bool seen )
 {
-	char  hashString[ MAX_HASH_STRING_LENGTH ];
+	tzHouseKeep* housekeeper = NULL;
+	void* found;
+	int i = 0;
 	int ret = EOK;
-    tzHouseKeep* housekeeper = NULL;
-    int i = 0;
-
-    memset( hashString, 0, sizeof(hashString) );
 
-	housekeeper = POLICYHASH_fnHouseKeepAccessor(  );
-	if( NULL == housekeeper )
+	/* update the hash  */
+	found = POLICYHASH_fnPut( newPolicy, hashString );
+	if( (int*)(-1) == found )
 	{
+		/* never published */
+		policy_fnFree( newPolicy );
 		ret = EINVAL;
 	}
 	else
 	{
-		for( i=0; i< ESTIMATED_NUM_POLICY; i++)
+		housekeeper = POLICYHASH_fnHouseKeepAccessor(  );
+		if( NULL == housekeeper )
 		{
-			if( ( 0 != housekeeper[i].pPolicy ) &&
-			    ( NULL != housekeeper[i].pPolicy ) )
+			ret = EINVAL;
+		}
+		else
+		{
+			/* access the housekeeper for policy, policy is new */
+			if( (void*)NULL == (void*)found )
 			{
-				/* remove all that last time not visited */
-				if( false == housekeeper[i].Seen )
+				/* find an emery spot in the array and place */
+				for( i=0; i< MAX_NUM_POLICY; i++)
 				{
-					/* the order is name, type, location */
-					sprintf( hashString,
-							 "%d%d%s",
-							 housekeeper[i].pPolicy->policy.Name,
-							 housekeeper[i].pPolicy->policy.Type,
-							 strlwr(housekeeper[i].pPolicy->policy.Location) );
+					if( NULL == housekeeper[i].pPolicy )
+					{
+						housekeeper[i].pPolicy = newPolicy;
+						housekeeper[i].Seen = seen;
+						break;
+					}
+				}
+
+				if( MAX_NUM_POLICY == i )
+				{
+					/* a rule the housekeeping cannot track would never be
+					 * removed, a check may have found it already */
 					POLICYHASH_fnRemove( hashString );
-					housekeeper[i].pPolicy = NULL;
-					memset( hashString, 0, sizeof(hashString) );
+					policy_fnRetire( newPolicy );
+					ret = ENOSPC;
+				}
+			}
+			else
+			{
+				/* not new so mark is as seen in this iteration */
+				/* find an emery spot in the array and place */
+				for( i=0; i< MAX_NUM_POLICY; i++)
+				{
+					if( found == housekeeper[i].pPolicy )
+					{
+						housekeeper[i].Seen = seen;
+						housekeeper[i].pPolicy = newPolicy;
+						break;
+					}
 				}
+
+				/* the replaced rule is still in the decision diagram */
+				policy_fnRetire( (struct policy_id_t*)found );
 			}
 		}
+	}
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Release a rule, its subject sets and its condition
+
+@param[in]
+    pPolicy
+        the rule, no check may be using it
+
+*/
+/*============================================================================*/
+static void policy_fnFree( struct policy_id_t* pPolicy )
+{
+	if( NULL != pPolicy )
+	{
+		SUBJECT_fnFreeSet( &pPolicy->users );
+		SUBJECT_fnFreeSet( &pPolicy->groups );
+		POLICYVM_fnFree( pPolicy->pProgram );
+		free( pPolicy );
+	}
+}
+
+/*============================================================================*/
+/*!
+	Retire a rule taken out of the policy hash, called with the policy
+	write lock held
+
+	A check which found the rule may still be using it, and the decision
+	diagram keeps it until the next commit.  It is released by
+	policy_fnReclaim.
+
+@param[in]
+    pPolicy
+        the rule, no longer in the policy hash
+
+*/
+/*============================================================================*/
+static void policy_fnRetire( struct policy_id_t* pPolicy )
+{
+	pPolicy->pNext = pRetired;
+	pRetired = pPolicy;
+}
+
+/*============================================================================*/
+/*!
+	Release the retired rules, called with the policy write lock held once
+	the decision diagram was rebuilt without them
+
+*/
+/*============================================================================*/
+static void policy_fnReclaim( void )
+{
+	struct policy_id_t* pPolicy;
+
+	/* waits for the hash checks which may have found a retired rule */
+	pthread_rwlock_wrlock( &ruleLock );
+	pthread_rwlock_unlock( &ruleLock );
+
+	while( NULL != pRetired )
+	{
+		pPolicy = pRetired;
+		pRetired = pPolicy->pNext;
+		policy_fnFree( pPolicy );
+	}
+}
+
+/*============================================================================*/
+/*!
+	remove the rules that has not been visited since the current time that
+	the new policy enforcement has happened.
+
+	The payload of the housekeeping requests carrying one is read from the
+	client, as sent, before the request is handled.
+
+@param[in]
+    rcvid
+        receive identifier used for message replies
+
+@param[in]
+    msg
+        pointer to the datapoint_policy_msg_t message type
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+int POLICY_fnHouseKeepPolicy( int rcvid, datapoint_policy_msg_t *msg )
+{
+	datapoint_policy_msg_t *pCopy = NULL;
+	size_t maxLength;
+	size_t length = 0;
+	int ret;
+
+	maxLength = policy_fnPayloadLength( msg );
+	if( 0u == maxLength )
+	{
+		return policy_fnHouseKeep( rcvid, msg, 0 );
+	}
+
+	ret = policy_fnReadMessage( rcvid, msg, maxLength, &pCopy, &length );
+	if( EOK == ret )
+	{
+		ret = policy_fnHouseKeep( rcvid, pCopy, length );
+		free( pCopy );
+	}
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Replay a housekeeping request logged by POLICY_fnHouseKeepPolicy, see
+	tfnSnapshotReplay
+
+@param[in]
+    pData
+        the message followed by its payload
+
+@param[in]
+    length
+        length of the message and its payload
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+int POLICY_fnHouseKeepReplay( void *pData, size_t length )
+{
+	if( ( NULL == pData ) || ( length < sizeof(datapoint_policy_msg_t) ) )
+	{
+		return EBADMSG;
+	}
+
+	return policy_fnHouseKeep( 0,
+	                           (datapoint_policy_msg_t *)pData,
+	                           length - sizeof(datapoint_policy_msg_t) );
+}
+
+/*============================================================================*/
+/*!
+	Handle a housekeeping request whose payload was received
+
+@param[in]
+    rcvid
+        receive identifier used for message replies
+
+@param[in]
+    msg
+        pointer to the datapoint_policy_msg_t message type followed by its
+        payload
+
+@param[in]
+    length
+        length of the payload
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+static int policy_fnHouseKeep( int rcvid,
+                               datapoint_policy_msg_t *msg,
+                               size_t length )
+{
+	char  hashString[ MAX_HASH_STRING_LENGTH ];
+	int ret = EOK;
+    tzHouseKeep* housekeeper = NULL;
+    char* pPayload = NULL;
+    size_t logLength;
+    bool logged;
+    int i = 0;
+
+    memset( hashString, 0, sizeof(hashString) );
+
+    if( NULL != msg )
+    {
+    	pPayload = (char *)msg + sizeof(datapoint_policy_msg_t);
+    }
+
+	/* the ring requests do not change the rules, they run on the read path */
+	if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_RING_ATTACH == msg->Name ) )
+	{
+		/* the name of the shared memory object follows the message */
+		if( NULL == memchr( pPayload, '\0', length ) )
+		{
+			return EINVAL;
+		}
+		return POLICYSERVE_fnAttach( pPayload );
+	}
+	else if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_CHECK == msg->Name ) )
+	{
+		/* the check request follows the message */
+		if( length < sizeof(tzPolicyCheckRequest) )
+		{
+			return EINVAL;
+		}
+		return POLICYSERVE_fnCheck( (tzPolicyCheckRequest *)pPayload );
+	}
+	else if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_DP_BULK == msg->Name ) )
+	{
+		/* the data points are created by the data point store */
+		return DPBULK_fnRegister( rcvid, msg, length );
+	}
+	else if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_SNAPSHOT == msg->Name ) )
+	{
+		/* the snapshot waits for the changes in progress */
+		return SNAPSHOT_fnSave();
+	}
+	else if( ( NULL != msg ) &&
+	         ( POLICY_HOUSEKEEP_SELECT_ENGINE == msg->Name ) )
+	{
+		/* the engine is carried in the max field, the rules do not change */
+		return POLICY_fnSelectEngine( (tePolicyEngine)msg->max );
+	}
+
+	/* the commits are logged before they change the rules, the native
+	 * rule sets and the requests which change nothing are not */
+	logged = ( NULL != msg ) &&
+	         ( POLICY_HOUSEKEEP_LOAD_NATIVE != msg->Name ) &&
+	         ( POLICY_HOUSEKEEP_BENCHMARK != msg->Name ) &&
+	         ( POLICY_HOUSEKEEP_FINGERPRINTS != msg->Name );
+	/* the keys of the removed rules must all have been received */
+	if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_DELTA_COMMIT == msg->Name ) &&
+	    ( ( msg->max < 0 ) || ( msg->max > MAX_NUM_POLICY ) ||
+	      ( (size_t)msg->max * sizeof(uint64_t) > length ) ) )
+	{
+		return EINVAL;
+	}
+
+	/* the path of the shared object must be terminated within the
+	 * payload */
+	if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_LOAD_NATIVE == msg->Name ) &&
+	    ( NULL == memchr( pPayload, '\0', length ) ) )
+	{
+		return EINVAL;
+	}
+
+	if( true == logged )
+	{
+		logLength = sizeof(datapoint_policy_msg_t);
+		if( POLICY_HOUSEKEEP_DELTA_COMMIT == msg->Name )
+		{
+			logLength += (size_t)msg->max * sizeof(uint64_t);
+		}
+
+		ret = SNAPSHOT_fnBegin( SNAPSHOT_LOG_POLICY_COMMIT, msg, logLength );
+		if( EOK != ret )
+		{
+			SNAPSHOT_fnEnd();
+			return ret;
+		}
+	}
+
+	pthread_mutex_lock( &policyWriteLock );
+
+	housekeeper = POLICYHASH_fnHouseKeepAccessor(  );
+
+	/* the housekeeping message also carries the native rule set requests */
+	if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_LOAD_NATIVE == msg->Name ) )
+	{
+		/* the path of the shared object follows the message */
+		ret = POLICYNATIVE_fnLoad( pPayload );
+		if( EOK == ret )
+		{
+			__atomic_store_n( &policyEngine,
+			                  POLICY_ENGINE_NATIVE,
+			                  __ATOMIC_RELAXED );
+		}
+	}
+	else if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_BENCHMARK == msg->Name ) )
+	{
+		/* the number of passes is carried in the max field */
+		ret = POLICY_fnBenchmarkRules( msg->max );
+	}
+	else if( NULL == housekeeper )
+	{
+		ret = EINVAL;
+	}
+	else if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_FINGERPRINTS == msg->Name ) )
+	{
+		ret = policy_fnFingerprints( rcvid, housekeeper );
+	}
+	else if( ( NULL != msg ) && ( POLICY_HOUSEKEEP_DELTA_COMMIT == msg->Name ) )
+	{
+		/* the keys of the removed rules follow the message */
+		ret = policy_fnDeltaRemove( housekeeper,
+		                            (uint64_t *)pPayload,
+		                            (uint32_t)msg->max );
+		if( EOK == ret )
+		{
+			policy_fnCommit( housekeeper );
+		}
+	}
+	else
+	{
+		for( i=0; i< MAX_NUM_POLICY; i++)
+		{
+			if( ( 0 != housekeeper[i].pPolicy ) &&
+			    ( NULL != housekeeper[i].pPolicy ) )
+			{
+				/* remove all that last time not visited */
+				if( false == housekeeper[i].Seen )
+				{
+					/* the order is name, type, location, the location
+					 * was converted to lower case by the creation */
+					sprintf( hashString,
+							 "%d%d%s",
+							 housekeeper[i].pPolicy->policy.Name,
+							 housekeeper[i].pPolicy->policy.Type,
+							 housekeeper[i].pPolicy->policy.Location );
+					POLICYHASH_fnRemove( hashString );
+					policy_fnRetire( housekeeper[i].pPolicy );
+					housekeeper[i].pPolicy = NULL;
+					memset( hashString, 0, sizeof(hashString) );
+				}
+			}
+		}
+
+		policy_fnCommit( housekeeper );
+	}
+
+	pthread_mutex_unlock( &policyWriteLock );
+
+	if( true == logged )
+	{
+		SNAPSHOT_fnEnd();
+	}
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Largest payload of a housekeeping request
+
+@param[in]
+    msg
+        pointer to the datapoint_policy_msg_t message type
+
+@return
+    the largest payload the request may carry, 0 if it carries none
+
+*/
+/*============================================================================*/
+static size_t policy_fnPayloadLength( const datapoint_policy_msg_t *msg )
+{
+	size_t length = 0;
+
+	if( NULL != msg )
+	{
+		switch( msg->Name )
+		{
+		case POLICY_HOUSEKEEP_RING_ATTACH:
+			length = POLICY_RING_NAME_LENGTH;
+			break;
+		case POLICY_HOUSEKEEP_CHECK:
+			length = sizeof(tzPolicyCheckRequest);
+			break;
+		case POLICY_HOUSEKEEP_DP_BULK:
+			length = DP_BULK_MAX_LENGTH;
+			break;
+		case POLICY_HOUSEKEEP_LOAD_NATIVE:
+			length = PATH_MAX;
+			break;
+		case POLICY_HOUSEKEEP_DELTA_COMMIT:
+			length = MAX_NUM_POLICY * sizeof(uint64_t);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return length;
+}
+
+/*============================================================================*/
+/*!
+	Copy a housekeeping message and read its payload
+
+	The payload is read from the client rather than from the receive
+	buffer, which may hold only part of it.  The number of bytes read is
+	the number of bytes the client sent, up to the given maximum, the
+	request is checked against it.
+
+@param[in]
+    rcvid
+        receive identifier of the message
+
+@param[in]
+    msg
+        the message received
+
+@param[in]
+    maxLength
+        most payload bytes to read
+
+@param[out]
+    ppCopy
+        the message followed by its payload, to free
+
+@param[out]
+    pLength
+        number of payload bytes read
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+static int policy_fnReadMessage( int rcvid,
+                                 const datapoint_policy_msg_t *msg,
+                                 size_t maxLength,
+                                 datapoint_policy_msg_t **ppCopy,
+                                 size_t *pLength )
+{
+	datapoint_policy_msg_t *pCopy;
+	ssize_t length;
+
+	pCopy = malloc( sizeof(datapoint_policy_msg_t) + maxLength );
+	if( NULL == pCopy )
+	{
+		return ENOMEM;
+	}
+
+	memcpy( pCopy, msg, sizeof(datapoint_policy_msg_t) );
+
+	length = MsgRead( rcvid,
+	                  (char *)pCopy + sizeof(datapoint_policy_msg_t),
+	                  maxLength,
+	                  sizeof(datapoint_policy_msg_t) );
+	if( length < 0 )
+	{
+		free( pCopy );
+		return EBADMSG;
+	}
+
+	*ppCopy = pCopy;
+	*pLength = (size_t)length;
+
+	return EOK;
+}
+
+/*============================================================================*/
+/*!
+	Reply the fingerprints of the committed rules, the rules registered
+	since the last commit included
+
+@param[in]
+    rcvid
+        receive identifier used for message replies
+
+@param[in]
+    housekeeper
+        committed rules
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+static int policy_fnFingerprints( int rcvid, tzHouseKeep* housekeeper )
+{
+	tzPolicyFingerprintHeader *pHeader;
+	tzPolicyFingerprint *pFingerprints;
+	int i = 0;
+
+	pHeader = malloc( sizeof(tzPolicyFingerprintHeader) +
+	                  MAX_NUM_POLICY * sizeof(tzPolicyFingerprint) );
+	if( NULL == pHeader )
+	{
+		return ENOMEM;
+	}
+
+	pHeader->numRules = 0;
+	pHeader->reserved = 0;
+	pFingerprints = (tzPolicyFingerprint *)( pHeader + 1 );
+
+	for( i=0; i < MAX_NUM_POLICY; i++ )
+	{
+		if( NULL != housekeeper[i].pPolicy )
+		{
+			pFingerprints[ pHeader->numRules ].key =
+			                      housekeeper[i].pPolicy->key;
+			pFingerprints[ pHeader->numRules ].fingerprint =
+			                      housekeeper[i].pPolicy->fingerprint;
+			pHeader->numRules++;
+		}
+	}
+
+	MsgReply( rcvid,
+	          EOK,
+	          pHeader,
+	          sizeof(tzPolicyFingerprintHeader) +
+	          pHeader->numRules * sizeof(tzPolicyFingerprint) );
+
+	free( pHeader );
+
+	return EOK;
+}
+
+/*============================================================================*/
+/*!
+	Remove the rules of a delta commit, the other rules are kept whether
+	they were registered since the last commit or not
+
+@param[in]
+    housekeeper
+        committed rules
+
+@param[in]
+    pRemove
+        keys of the rules to remove
+
+@param[in]
+    numRemove
+        number of keys
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+static int policy_fnDeltaRemove( tzHouseKeep* housekeeper,
+		                         const uint64_t *pRemove,
+		                         uint32_t numRemove )
+{
+	char  hashString[ MAX_HASH_STRING_LENGTH ];
+	uint64_t *pKeys;
+	int i = 0;
+
+	if( 0u == numRemove )
+	{
+		return EOK;
+	}
+
+	if( numRemove > MAX_NUM_POLICY )
+	{
+		return EINVAL;
+	}
+
+	/* sort the keys once instead of scanning them for every rule */
+	pKeys = malloc( numRemove * sizeof(uint64_t) );
+	if( NULL == pKeys )
+	{
+		return ENOMEM;
+	}
+
+	memcpy( pKeys, pRemove, numRemove * sizeof(uint64_t) );
+	qsort( pKeys, numRemove, sizeof(uint64_t), policy_fnKeyCompare );
+
+	for( i=0; i < MAX_NUM_POLICY; i++ )
+	{
+		if( ( NULL != housekeeper[i].pPolicy ) &&
+		    ( NULL != bsearch( &housekeeper[i].pPolicy->key,
+		                       pKeys,
+		                       numRemove,
+		                       sizeof(uint64_t),
+		                       policy_fnKeyCompare ) ) )
+		{
+			/* the location was converted to lower case by the creation */
+			sprintf( hashString,
+					 "%d%d%s",
+					 housekeeper[i].pPolicy->policy.Name,
+					 housekeeper[i].pPolicy->policy.Type,
+					 housekeeper[i].pPolicy->policy.Location );
+			POLICYHASH_fnRemove( hashString );
+			policy_fnRetire( housekeeper[i].pPolicy );
+			housekeeper[i].pPolicy = NULL;
+		}
+	}
+
+	free( pKeys );
+
+	return EOK;
+}
+
+/*============================================================================*/
+/*!
+	Order two rule keys for qsort and bsearch
+
+@param[in]
+    pA
+        first key
+
+@param[in]
+    pB
+        second key
+
+@return
+    less than, equal to or greater than zero
+
+*/
+/*============================================================================*/
+static int policy_fnKeyCompare( const void *pA, const void *pB )
+{
+	uint64_t a = *(const uint64_t *)pA;
+	uint64_t b = *(const uint64_t *)pB;
+
+	return ( a > b ) - ( a < b );
+}
+
+/*============================================================================*/
+/*!
+	Commit the rule set, called with the policy write lock held after the
+	removed rules were taken out of the hash
+
+@param[in]
+    housekeeper
+        committed rules
+
+*/
+/*============================================================================*/
+static void policy_fnCommit( tzHouseKeep* housekeeper )
+{
+	int i = 0;
+
+	/* done with removal housekeeping,
+	 * now turn all flags false for next time */
+	for( i=0; i < MAX_NUM_POLICY; i++ )
+	{
+		if( NULL != housekeeper[i].pPolicy )
+		{
+			housekeeper[i].Seen = false; //reset them all to false
+		}
+	}
+
+	/* the rule set is committed, compile it for the diagram engine, the
+	 * previous diagram keeps the retired rules if it cannot be replaced */
+	if( EOK != POLICYDD_fnBuild( housekeeper, MAX_NUM_POLICY ) )
+	{
+		printf( "POLICY_fnHouseKeepPolicy:"
+				"cannot compile the policy decision diagram\n" );
+	}
+	else
+	{
+		policy_fnReclaim( );
+	}
+
+	/* the native rule set was built from the previous rules */
+	POLICYNATIVE_fnUnload( );
+}
+
+/*============================================================================*/
+/*!
+	Write the rules and the subjects to a snapshot, see tfnSnapshotSave
+
+	The subject names are saved in the order of their bits and the rule
+	sets with the words of bits they hold.  The condition programs are
+	saved with their name lists, they are interned again when loaded.
+
+@param[in]
+    fp
+        the snapshot
+
+@param[in]
+    pContext
+        unused
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+int POLICY_fnSnapshotSave( FILE *fp, void *pContext )
+{
+	static const char padding[ SNAPSHOT_ALIGN ] = { 0 };
+	tzPolicySnapshotHeader header;
+	tzPolicySnapshotRule rule;
+	struct policy_id_t* pPolicy;
+	tzHouseKeep* housekeeper;
+	const char *pName;
+	size_t namesLength = 0;
+	int kind;
+	int i = 0;
+	int ret = EOK;
+
+	(void)pContext;
+
+	memset( &header, 0, sizeof(header) );
+	header.ruleSize = sizeof(tzPolicySnapshotRule);
+	header.programSize = sizeof(tzPolicyProgram);
+	header.numUsers = (uint32_t)SUBJECT_fnCount( eSubjectUser );
+	header.numGroups = (uint32_t)SUBJECT_fnCount( eSubjectGroup );
+
+	for( kind = 0; kind < eSubjectKinds; kind++ )
+	{
+		for( i = 0; NULL != ( pName = SUBJECT_fnName( kind, i ) ); i++ )
+		{
+			namesLength += strlen( pName ) + 1;
+		}
+	}
+	header.namesLength = ( namesLength + SNAPSHOT_ALIGN - 1 ) &
+	                     ~( SNAPSHOT_ALIGN - 1 );
+
+	pthread_mutex_lock( &policyWriteLock );
+
+	housekeeper = POLICYHASH_fnHouseKeepAccessor(  );
+	for( i=0; ( NULL != housekeeper ) && ( i < MAX_NUM_POLICY ); i++ )
+	{
+		if( NULL != housekeeper[i].pPolicy )
+		{
+			header.numRules++;
+		}
+	}
+
+	fwrite( &header, sizeof(header), 1, fp );
+
+	for( kind = 0; kind < eSubjectKinds; kind++ )
+	{
+		for( i = 0; NULL != ( pName = SUBJECT_fnName( kind, i ) ); i++ )
+		{
+			fwrite( pName, strlen( pName ) + 1, 1, fp );
+		}
+	}
+	fwrite( padding, 1, header.namesLength - namesLength, fp );
+
+	for( i=0; ( NULL != housekeeper ) && ( i < MAX_NUM_POLICY ); i++ )
+	{
+		pPolicy = housekeeper[i].pPolicy;
+		if( NULL == pPolicy )
+		{
+			continue;
+		}
+
+		memset( &rule, 0, sizeof(rule) );
+		memcpy( &rule.policy, &pPolicy->policy, sizeof(rule.policy) );
+		rule.numUserWords = pPolicy->users.any ? POLICY_SNAPSHOT_ANY
+		                                       : pPolicy->users.numWords;
+		rule.numGroupWords = pPolicy->groups.any ? POLICY_SNAPSHOT_ANY
+		                                         : pPolicy->groups.numWords;
+		rule.key = pPolicy->key;
+		rule.fingerprint = pPolicy->fingerprint;
+		rule.hasProgram = ( NULL != pPolicy->pProgram );
+		rule.seen = housekeeper[i].Seen;
+
+		fwrite( &rule, sizeof(rule), 1, fp );
+		policy_fnSaveSet( fp, &pPolicy->users );
+		policy_fnSaveSet( fp, &pPolicy->groups );
+		if( NULL != pPolicy->pProgram )
+		{
+			fwrite( pPolicy->pProgram, sizeof(tzPolicyProgram), 1, fp );
+		}
+	}
+
+	pthread_mutex_unlock( &policyWriteLock );
+
+	if( 0 != ferror( fp ) )
+	{
+		ret = EIO;
+	}
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Restore the rules and the subjects of a snapshot, see tfnSnapshotLoad
+
+	Called when the server starts, before any rule is registered.  The
+	subjects must come back with the bits they were saved with, the rules
+	are put back as they were and the decision diagram is built from them;
+	a rule registered since the last commit is in the diagram now, and is
+	still removed by the next housekeeping if it is not registered again.
+
+@param[in]
+    pData
+        the section
+
+@param[in]
+    length
+        length of the section
+
+@param[in]
+    pContext
+        unused
+
+@return
+    EOK on success, EBADMSG if the section was saved by another build of
+    the server, any other standard error code on failure
+
+*/
+/*============================================================================*/
+int POLICY_fnSnapshotLoad( void *pData, size_t length, void *pContext )
+{
+	char  hashString[ MAX_HASH_STRING_LENGTH ];
+	tzPolicySnapshotHeader header;
+	tzPolicySnapshotRule rule;
+	struct policy_id_t* newPolicy;
+	tzHouseKeep* housekeeper;
+	const char *pNames;
+	char *p;
+	char *pEnd = (char *)pData + length;
+	uint32_t i = 0;
+	int ret = EOK;
+
+	(void)pContext;
+
+	if( length < sizeof(header) )
+	{
+		return EBADMSG;
+	}
+
+	memcpy( &header, pData, sizeof(header) );
+	if( ( sizeof(tzPolicySnapshotRule) != header.ruleSize ) ||
+	    ( sizeof(tzPolicyProgram) != header.programSize ) ||
+	    ( header.numRules > MAX_NUM_POLICY ) ||
+	    ( header.namesLength > length - sizeof(header) ) )
+	{
+		return EBADMSG;
+	}
+
+	pNames = (char *)pData + sizeof(header);
+	ret = policy_fnRestoreSubjects( pNames,
+	                                header.namesLength,
+	                                eSubjectUser,
+	                                header.numUsers,
+	                                &pNames );
+	if( EOK == ret )
+	{
+		ret = policy_fnRestoreSubjects( pNames,
+		                                (size_t)( (char *)pData +
+		                                          sizeof(header) +
+		                                          header.namesLength -
+		                                          pNames ),
+		                                eSubjectGroup,
+		                                header.numGroups,
+		                                &pNames );
+	}
+
+	if( EOK != ret )
+	{
+		return ret;
+	}
+
+	p = (char *)pData + sizeof(header) + header.namesLength;
+
+	pthread_mutex_lock( &policyWriteLock );
+
+	for( i = 0; ( EOK == ret ) && ( i < header.numRules ); i++ )
+	{
+		if( (size_t)( pEnd - p ) < sizeof(rule) )
+		{
+			ret = EBADMSG;
+			break;
+		}
+
+		memcpy( &rule, p, sizeof(rule) );
+		p += sizeof(rule);
+
+		newPolicy = calloc( 1, sizeof( struct policy_id_t ) );
+		if( NULL == newPolicy )
+		{
+			ret = ENOMEM;
+			break;
+		}
+
+		memcpy( &newPolicy->policy, &rule.policy, sizeof(rule.policy) );
+		newPolicy->policy.Location[ sizeof(newPolicy->policy.Location) - 1 ] =
+		                                                                '\0';
+		newPolicy->key = rule.key;
+		newPolicy->fingerprint = rule.fingerprint;
+		COMPARATOR_fnBind( rule.policy.min,
+		                   rule.policy.max,
+		                   &newPolicy->bounds );
+
+		ret = policy_fnLoadSet( &p, pEnd, rule.numUserWords, &newPolicy->users );
+		if( EOK == ret )
+		{
+			ret = policy_fnLoadSet( &p,
+			                        pEnd,
+			                        rule.numGroupWords,
+			                        &newPolicy->groups );
+		}
+
+		if( ( EOK == ret ) && ( 0u != rule.hasProgram ) )
+		{
+			if( (size_t)( pEnd - p ) < sizeof(tzPolicyProgram) )
+			{
+				ret = EBADMSG;
+			}
+			else
+			{
+				newPolicy->pProgram =
+				        POLICYVM_fnRestore( (tzPolicyProgram *)p );
+				p += sizeof(tzPolicyProgram);
+				if( NULL == newPolicy->pProgram )
+				{
+					ret = EBADMSG;
+				}
+			}
+		}
+
+		if( EOK != ret )
+		{
+			policy_fnFree( newPolicy );
+			break;
+		}
+
+		/* the location was saved in lower case */
+		snprintf( hashString,
+		          sizeof(hashString),
+		          "%d%d%s",
+		          newPolicy->policy.Name,
+		          newPolicy->policy.Type,
+		          newPolicy->policy.Location );
+
+		ret = policy_fnPublish( newPolicy, hashString, ( 0u != rule.seen ) );
+	}
+
+	housekeeper = POLICYHASH_fnHouseKeepAccessor(  );
+	if( NULL != housekeeper )
+	{
+		if( EOK != POLICYDD_fnBuild( housekeeper, MAX_NUM_POLICY ) )
+		{
+			printf( "POLICY_fnSnapshotLoad:"
+					"cannot compile the policy decision diagram\n" );
+		}
+		else
+		{
+			/* the rules replaced by the snapshot */
+			policy_fnReclaim( );
+		}
+	}
+
+	pthread_mutex_unlock( &policyWriteLock );
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Intern the subject names of a snapshot in the order of their bits
+
+@param[in]
+    pNames
+        NUL terminated names
+
+@param[in]
+    length
+        length of the names
+
+@param[in]
+    kind
+        subject kind of the names
+
+@param[in]
+    count
+        number of names
+
+@param[out]
+    ppNext
+        the byte after the last name
+
+@return
+    EOK on success, EBADMSG if a name did not get its saved bit back
+
+*/
+/*============================================================================*/
+static int policy_fnRestoreSubjects( const char *pNames,
+                                     size_t length,
+                                     teSubjectKind kind,
+                                     uint32_t count,
+                                     const char **ppNext )
+{
+	const char *pNul;
+	uint32_t id;
+	uint32_t i = 0;
+
+	for( i = 0; i < count; i++ )
+	{
+		pNul = memchr( pNames, '\0', length );
+		if( ( NULL == pNul ) ||
+		    ( EOK != SUBJECT_fnIntern( kind, pNames, &id ) ) ||
+		    ( i != id ) )
+		{
+			fprintf( stderr,
+			         "%s: the subjects of the snapshot do not match\n",
+			         __func__ );
+			return EBADMSG;
+		}
+
+		length -= (size_t)( pNul + 1 - pNames );
+		pNames = pNul + 1;
+	}
+
+	*ppNext = pNames;
+
+	return EOK;
+}
+
+/*============================================================================*/
+/*!
+	Write the words of a rule subject set to a snapshot
+
+@param[in]
+    fp
+        the snapshot
+
+@param[in]
+    pSet
+        subject set of the rule, nothing is written for the wild card
+
+@return
+    EOK on success, EIO if the words could not be written
+
+*/
+/*============================================================================*/
+static int policy_fnSaveSet( FILE *fp, const tzSubjectSet *pSet )
+{
+	int ret = EOK;
+
+	if( ( false == pSet->any ) && ( 0u != pSet->numWords ) &&
+	    ( pSet->numWords != fwrite( pSet->pWords,
+	                                sizeof(uint64_t),
+	                                pSet->numWords,
+	                                fp ) ) )
+	{
+		ret = EIO;
+	}
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Read the words of a rule subject set from a snapshot
+
+@param[in,out]
+    pp
+        the words in the snapshot, moved past them
+
+@param[in]
+    pEnd
+        the end of the section
+
+@param[in]
+    numWords
+        number of words saved, POLICY_SNAPSHOT_ANY for the wild card
+
+@param[out]
+    pSet
+        the subject set, release it with SUBJECT_fnFreeSet
+
+@return
+    EOK on success, EBADMSG if the words are not within the section,
+    ENOMEM if the set could not be stored
+
+*/
+/*============================================================================*/
+static int policy_fnLoadSet( char **pp,
+                             char *pEnd,
+                             uint32_t numWords,
+                             tzSubjectSet *pSet )
+{
+	memset( pSet, 0, sizeof(tzSubjectSet) );
+
+	if( POLICY_SNAPSHOT_ANY == numWords )
+	{
+		pSet->any = true;
+		return EOK;
+	}
+
+	if( (size_t)( pEnd - *pp ) / sizeof(uint64_t) < numWords )
+	{
+		return EBADMSG;
+	}
+
+	if( 0u != numWords )
+	{
+		pSet->pWords = malloc( numWords * sizeof(uint64_t) );
+		if( NULL == pSet->pWords )
+		{
+			return ENOMEM;
+		}
+
+		memcpy( pSet->pWords, *pp, numWords * sizeof(uint64_t) );
+		pSet->numWords = numWords;
+		*pp += numWords * sizeof(uint64_t);
+	}
+
+	return EOK;
+}
+
+/*============================================================================*/
+/*!
+	Select the engine used by the policy check
+
+@param[in]
+    engine
+        POLICY_ENGINE_HASH, POLICY_ENGINE_DD or POLICY_ENGINE_NATIVE
+
+@return
+    EOK on success, EINVAL if the engine is unknown
+
+*/
+/*============================================================================*/
+int POLICY_fnSelectEngine( tePolicyEngine engine )
+{
+	int ret = EINVAL;
+
+	if( ( POLICY_ENGINE_HASH == engine ) ||
+		( POLICY_ENGINE_DD == engine ) ||
+		( POLICY_ENGINE_NATIVE == engine ) )
+	{
+		__atomic_store_n( &policyEngine, engine, __ATOMIC_RELAXED );
+		ret = EOK;
+	}
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+	Compare the speed of the policy check engines
+
+	The tags of the data point are resolved once, then the data point is
+	decided the given number of times by each engine, called directly so
+	that the engine selected for the checks is left alone, and the average
+	time per decision is printed.  The native engine is only measured while
+	a native rule set is loaded.
+
+@param[in]
+    pDp
+        data point structure to check
+
+@param[in]
+    iterations
+        number of checks per engine
+
+@return
+    EOK if all engines made the same decision, EINVAL otherwise
+
+*/
+/*============================================================================*/
+int POLICY_fnBenchmark( struct dp_t *pDp, int iterations )
+{
+	static const char* engineNames[] = { "hash", "dd", "native" };
+	static const tfnPolicyDecide engines[] =
+	{
+		policy_fnHashDecide,
+		POLICYDD_fnDecide,
+		POLICYNATIVE_fnDecide
+	};
+	char location[ MAX_LOCATION_STRING_LENGTH ] = "\0";
+	tzSubjectIds users;
+	tzSubjectIds groups;
+	uint64_t cycle1;
+	uint64_t cycle2;
+	uint64_t cps;
+	int decision[ POLICY_ENGINE_NATIVE + 1 ];
+	int numEngines = POLICY_ENGINE_DD + 1;
+	int mismatches = 0;
+	int typeInt = -1;
+	int engine;
+	int i;
+
+	if( ( NULL == pDp ) || ( iterations <= 0 ) )
+	{
+		return EINVAL;
+	}
+
+	if( EOK != policy_fnTokenizeTags( pDp,
+	                                  &typeInt,
+	                                  location,
+	                                  &users,
+	                                  &groups ) )
+	{
+		return EINVAL;
+	}
+
+	if( true == POLICYNATIVE_fnIsLoaded( ) )
+	{
+		numEngines = POLICY_ENGINE_NATIVE + 1;
+	}
+
+	/* find out how many cycles per second */
+	cps = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
+
+	for( engine = POLICY_ENGINE_HASH; engine < numEngines; engine++ )
+	{
+		cycle1 = ClockCycles( );
+		for( i = 0; i < iterations; i++ )
+		{
+			decision[engine] = engines[engine]( pDp,
+			                                    typeInt,
+			                                    location,
+			                                    &users,
+			                                    &groups );
+		}
+		cycle2 = ClockCycles( );
+
+		printf( "%s engine: %f us per check, decision %d\n",
+				engineNames[engine],
+				( (double)( cycle2 - cycle1 ) / cps ) * 1e6 / iterations,
+				decision[engine] );
+
+		if( decision[engine] != decision[POLICY_ENGINE_HASH] )
+		{
+			mismatches++;
+		}
+	}
+
+	printf( "dd engine: %d nodes\n", POLICYDD_fnNodeCount() );
+
+	return ( 0 == mismatches ) ? EOK : EINVAL;
+}
+
+/*============================================================================*/
+/*!
+	Compare the speed of the policy check engines on the committed rules
+
+	A data point is synthesized for every committed rule, with the type,
+	location and one user and group of the rule and a value in the middle
+	of the rule range.  All the data points are decided the given number of
+	times by each engine and the average time per decision is printed.  The
+	native engine is only measured while a native rule set is loaded.
+
+@param[in]
+    iterations
+        number of passes over the rules per engine
+
+@return
+    EOK if the engines made the same decisions, EINVAL otherwise
+
+*/
+/*============================================================================*/
+int POLICY_fnBenchmarkRules( int iterations )
+{
+	static const char* engineNames[] = { "hash", "dd", "native" };
+	static const tfnPolicyDecide engines[] =
+	{
+		policy_fnHashDecide,
+		POLICYDD_fnDecide,
+		POLICYNATIVE_fnDecide
+	};
+	tzHouseKeep* housekeeper = NULL;
+	tzPolicyBenchQuery* pQueries = NULL;
+	tzPolicyBenchQuery* pQuery = NULL;
+	struct policy_id_t* pPolicy = NULL;
+	uint8_t* pDecisions = NULL;
+	uint64_t cycle1;
+	uint64_t cycle2;
+	uint64_t cps;
+	struct timespec now;
+	int numEngines = POLICY_ENGINE_DD + 1;
+	int numQueries = 0;
+	int mismatches = 0;
+	int permitted;
+	int engine;
+	int decision;
+	int i;
+	int j;
+
+	housekeeper = POLICYHASH_fnHouseKeepAccessor(  );
+	if( ( NULL == housekeeper ) || ( iterations <= 0 ) )
+	{
+		return EINVAL;
+	}
+
+	pQueries = calloc( MAX_NUM_POLICY, sizeof(tzPolicyBenchQuery) );
+	pDecisions = calloc( MAX_NUM_POLICY, sizeof(uint8_t) );
+	if( ( NULL == pQueries ) || ( NULL == pDecisions ) )
+	{
+		free( pQueries );
+		free( pDecisions );
+		return ENOMEM;
+	}
+
+	clock_gettime( CLOCK_REALTIME, &now );
+
+	for( i = 0; i < MAX_NUM_POLICY; i++ )
+	{
+		pPolicy = housekeeper[i].pPolicy;
+		if( NULL == pPolicy )
+		{
+			continue;
+		}
+
+		pQuery = &pQueries[ numQueries++ ];
+		pQuery->typeInt = pPolicy->policy.Type;
+		strncpy( pQuery->location,
+				 pPolicy->policy.Location,
+				 sizeof(pQuery->location) - 1 );
+
+		/* the lowest bit of a set is one of its subjects */
+		SUBJECT_fnFirst( &pPolicy->users, &pQuery->users );
+		SUBJECT_fnFirst( &pPolicy->groups, &pQuery->groups );
+
+		pQuery->dp.dpdata.type = DP_TYPE_SINT32;
+		pQuery->dp.dpdata.val.slVal = pPolicy->policy.min +
+				( pPolicy->policy.max - pPolicy->policy.min ) / 2;
+		pQuery->dp.dpdata.timestamp = now;
+	}
+
+	if( true == POLICYNATIVE_fnIsLoaded( ) )
+	{
+		numEngines = POLICY_ENGINE_NATIVE + 1;
+	}
+
+	/* find out how many cycles per second */
+	cps = SYSPAGE_ENTRY(qtime)->cycles_per_sec;
 
-		/* done with removal housekeeping,
-		 * now turn all flags false for next time */
-		for( i=0; i < ESTIMATED_NUM_POLICY; i++ )
+	for( engine = POLICY_ENGINE_HASH; engine < numEngines; engine++ )
+	{
+		permitted = 0;
+
+		cycle1 = ClockCycles( );
+		for( j = 0; j < iterations; j++ )
 		{
-			if( ( 0    != housekeeper[i].pPolicy ) &&
-				( NULL != housekeeper[i].pPolicy ) )
+			for( i = 0; i < numQueries; i++ )
 			{
-				housekeeper[i].Seen = false; //reset them all to false
+				pQuery = &pQueries[i];
+				decision = engines[engine]( &pQuery->dp,
+				                            pQuery->typeInt,
+				                            pQuery->location,
+				                            &pQuery->users,
+				                            &pQuery->groups );
+				if( POLICY_ENGINE_HASH == engine )
+				{
+					pDecisions[i] = (uint8_t)( EOK == decision );
+				}
+				else if( pDecisions[i] != (uint8_t)( EOK == decision ) )
+				{
+					mismatches++;
+				}
+				permitted += ( EOK == decision );
 			}
 		}
+		cycle2 = ClockCycles( );
+
+		printf( "%s engine: %d rules, %f ns per decision, %d permitted\n",
+				engineNames[engine],
+				numQueries,
+				( numQueries > 0 )
+					? ( (double)( cycle2 - cycle1 ) / cps ) * 1e9 /
+					  ( (double)iterations * numQueries )
+					: 0.0,
+				permitted / iterations );
 	}
 
-	return ret;
+	printf( "dd engine: %d nodes\n", POLICYDD_fnNodeCount() );
+	if( numEngines <= POLICY_ENGINE_NATIVE )
+	{
+		printf( "native engine: no native rule set loaded\n" );
+	}
+
+	free( pQueries );
+	free( pDecisions );
+
+	return ( 0 == mismatches ) ? EOK : EINVAL;
 }
 
 /*============================================================================*/
@@ -379,24 +2202,17 @@ static int policy_fnTypeString2Val( char* Type )
 /*============================================================================*/
 bool POLICY_fnCheck( struct dp_t *pDp )
 {
-
 	int ret = EACCES;
 	int typeInt = -1;
-    char hashString[ MAX_HASH_STRING_LENGTH ] = "\0";
 	char location[ MAX_LOCATION_STRING_LENGTH ]= "\0";
-    struct policy_id_t* pPolicy = NULL;
-    uint32_t userID = 0u;
-    uint32_t groupID = 0u;
-    struct timespec dpTime;
-
-	/* get the last updated time of the dp */
-	dpTime.tv_sec = pDp->dpdata.timestamp.tv_sec;
+    tzSubjectIds users;
+    tzSubjectIds groups;
 
 	if( EOK != policy_fnTokenizeTags( pDp,
 			                          &typeInt,
 			                          location,
-			                          &userID,
-			                          &groupID  ) )
+			                          &users,
+			                          &groups  ) )
 	{
 		printf( "POLICY_fnCheck:"
 				"cannot tokenize, something is wrong in the dp database\n");
@@ -405,92 +2221,221 @@ bool POLICY_fnCheck( struct dp_t *pDp )
 	}
 	else
 	{
-		/* based on the category type we decided if the data point must be
-		 * checked against the comparator rule or the accessor rule */
-		switch(typeInt)
+		ret = POLICY_fnDecide( pDp, typeInt, location, &users, &groups );
+	}
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Decide on a data point whose tags are already resolved
+
+    The decision is made by the engine selected with POLICY_fnSelectEngine.
+
+@param[in]
+    pDp
+        data point structure
+
+@param[in]
+    typeInt
+        category type of the data point
+
+@param[in]
+    location
+        location of the data point, may be lower cased by the check
+
+@param[in]
+    pUsers
+        subjects of the user tags of the data point
+
+@param[in]
+    pGroups
+        subjects of the group tags of the data point
+
+@retval EOK - if the policy check passed
+@retval EACCES - if the policy did not pass
+
+*/
+/*============================================================================*/
+int POLICY_fnDecide( struct dp_t *pDp,
+		             int typeInt,
+		             char *location,
+		             const tzSubjectIds *pUsers,
+		             const tzSubjectIds *pGroups )
+{
+	int ret;
+
+	switch( __atomic_load_n( &policyEngine, __ATOMIC_RELAXED ) )
+	{
+	case POLICY_ENGINE_DD:
+		ret = POLICYDD_fnDecide( pDp,
+		                         typeInt,
+		                         location,
+		                         pUsers,
+		                         pGroups );
+		break;
+	case POLICY_ENGINE_NATIVE:
+		/* falls back to the decision diagram if nothing is loaded */
+		ret = POLICYNATIVE_fnDecide( pDp,
+		                             typeInt,
+		                             location,
+		                             pUsers,
+		                             pGroups );
+		break;
+	case POLICY_ENGINE_HASH:
+	default:
+		ret = policy_fnHashDecide( pDp,
+		                           typeInt,
+		                           location,
+		                           pUsers,
+		                           pGroups );
+		break;
+	}
+
+	return ret;
+}
+
+/*============================================================================*/
+/*!
+    Decide on a data point using the policy hash
+
+    The rule of the data point type and location is looked up in the policy
+    hash, then its time, value and attributes are checked.
+
+@param[in]
+    pDp
+        data point structure
+
+@param[in]
+    typeInt
+        category type of the data point
+
+@param[in]
+    location
+        location of the data point, it is converted to lower case
+
+@param[in]
+    pUsers
+        subjects of the user tags of the data point
+
+@param[in]
+    pGroups
+        subjects of the group tags of the data point
+
+@retval EOK - if the policy check passed
+@retval EACCES - if the policy did not pass
+
+*/
+/*============================================================================*/
+static int policy_fnHashDecide( struct dp_t *pDp,
+		                        int typeInt,
+		                        char *location,
+		                        const tzSubjectIds *pUsers,
+		                        const tzSubjectIds *pGroups )
+{
+	int ret = EACCES;
+    char hashString[ MAX_HASH_STRING_LENGTH ] = "\0";
+    struct policy_id_t* pPolicy = NULL;
+    struct timespec dpTime;
+
+	/* get the last updated time of the dp */
+	dpTime.tv_sec = pDp->dpdata.timestamp.tv_sec;
+
+	/* a rule found is not released while the lock is held */
+	pthread_rwlock_rdlock( &ruleLock );
+
+	/* based on the category type we decided if the data point must be
+	 * checked against the comparator rule or the accessor rule */
+	switch(typeInt)
+	{
+	case POLICY_TYPE_INVALID:
+		/* if the policy type is unknown from the dp bank it means that
+		 * there is no policy for it yet therefore assume wild card ie.
+		 * pass it*/
+		ret = EOK;
+		break;
+	case POLICY_TYPE_PASS:
+	case POLICY_TYPE_HEAD:
+	case POLICY_TYPE_FUEL:
+		/* the order is name, type, location */
+		sprintf( hashString,
+				 "%d%d%s",
+				 POLICY_NAME_ACCESS,
+				 typeInt,
+				 strlwr(location) );
+
+		/* a single lookup, the rule may be removed between two */
+		pPolicy = POLICYHASH_fnFind( hashString );
+		if( NULL != pPolicy )
 		{
-		case POLICY_TYPE_INVALID:
-			/* if the policy type is unknown from the dp bank it means that
-			 * there is no policy for it yet therefore assume wild card ie.
-			 * pass it*/
-			ret = EOK;
-			break;
-		case POLICY_TYPE_PASS:
-		case POLICY_TYPE_HEAD:
-		case POLICY_TYPE_FUEL:
-			/* the order is name, type, location */
-			sprintf( hashString,
-					 "%d%d%s",
-					 POLICY_NAME_ACCESS,
-					 typeInt,
-					 strlwr(location) );
-			if( POLICYHASH_fnCheck( hashString ) )
+			/* check if the time is specified o/w assume wildcard for time*/
+			if( 0 != pPolicy->policy.time.tv_sec )
 			{
-				pPolicy = POLICYHASH_fnFind( hashString );
-
-				/* check if the time is specified o/w assume wildcard for time*/
-				if( 0 != pPolicy->policy.time.tv_sec )
-				{
-					/* check if the time is bigger than policy time (since) */
-					if( pPolicy->policy.time.tv_sec <= dpTime.tv_sec )
-					{
-						ret = policy_fnCheckAttr( location,
-												  userID,
-												  groupID,
-												  pPolicy );
-					}
-				}
-				else
+				/* check if the time is bigger than policy time (since) */
+				if( pPolicy->policy.time.tv_sec <= dpTime.tv_sec )
 				{
-					ret = policy_fnCheckAttr( location,
-											  userID,
-											  groupID,
+					ret = policy_fnCheckAttr( pDp,
+											  location,
+											  pUsers,
+											  pGroups,
 											  pPolicy );
 				}
 			}
-			break;
-		default:
-			/* we assume all other than password are default type which is the
-			 * comparator rule check */
-			/* the order is name, type, location */
-			sprintf( hashString,
-					 "%d%d%s",
-					 POLICY_NAME_COMP,
-					 typeInt,
-					 strlwr(location) );
-			if( POLICYHASH_fnCheck( hashString ) )
+			else
 			{
-				pPolicy = POLICYHASH_fnFind( hashString );
-
-				/* check if the time is specified o/w assume wildcard for time*/
-				if( 0 != pPolicy->policy.time.tv_sec )
+				ret = policy_fnCheckAttr( pDp,
+										  location,
+										  pUsers,
+										  pGroups,
+										  pPolicy );
+			}
+		}
+		break;
+	default:
+		/* we assume all other than password are default type which is the
+		 * comparator rule check */
+		/* the order is name, type, location */
+		sprintf( hashString,
+				 "%d%d%s",
+				 POLICY_NAME_COMP,
+				 typeInt,
+				 strlwr(location) );
+		pPolicy = POLICYHASH_fnFind( hashString );
+		if( NULL != pPolicy )
+		{
+			/* check if the time is specified o/w assume wildcard for time*/
+			if( 0 != pPolicy->policy.time.tv_sec )
+			{
+				if( pPolicy->policy.time.tv_sec <= dpTime.tv_sec )
 				{
-					if( pPolicy->policy.time.tv_sec <= dpTime.tv_sec )
+					if( EOK == POLICY_fnCheckVal( pDp, pPolicy ) )
 					{
-						if( EOK == policy_fnCheckVal( pDp, pPolicy ) )
-						{
-							ret = policy_fnCheckAttr( location,
-													  userID,
-													  groupID,
-													  pPolicy );
-						}
+						ret = policy_fnCheckAttr( pDp,
+												  location,
+												  pUsers,
+												  pGroups,
+												  pPolicy );
 					}
 				}
-				else
+			}
+			else
+			{
+				if( EOK == POLICY_fnCheckVal( pDp, pPolicy ) )
 				{
-					if( EOK == policy_fnCheckVal( pDp, pPolicy ) )
-					{
-						ret = policy_fnCheckAttr( location,
-												  userID,
-												  groupID,
-												  pPolicy );
-					}
+					ret = policy_fnCheckAttr( pDp,
+											  location,
+											  pUsers,
+											  pGroups,
+											  pPolicy );
 				}
 			}
-			break;
 		}
+		break;
 	}
 
+	pthread_rwlock_unlock( &ruleLock );
+
     return ret;
 }
 
@@ -515,13 +2460,15 @@ bool POLICY_fnCheck( struct dp_t *pDp )
     location
         location of the data point to check against the policy file
 
-@param[in]
-    user
-        user tag of the data point to check against the policy file
+@param[out]
+    pUsers
+        subjects of the user tags of the data point, none if the data point
+        has no user known by the policy rules
 
-@param[in]
-    group
-        group id annotated to the data point tag
+@param[out]
+    pGroups
+        subjects of the group tags of the data point, none if the data point
+        has no group known by the policy rules
 
 
 @retval - EOK if success in tokenizing or errno.h errors if failed.
@@ -529,18 +2476,20 @@ bool POLICY_fnCheck( struct dp_t *pDp )
 */
 /*============================================================================*/
 static int policy_fnTokenizeTags( struct dp_t* pDp,
-		                          int*         typeInt,
-		                          char*        location,
-		                          uint32_t*    userID,
-		                          uint32_t*    groupID  )
+		                          int*          typeInt,
+		                          char*         location,
+		                          tzSubjectIds* pUsers,
+		                          tzSubjectIds* pGroups  )
 {
 	int ret = EINVAL;
 	int i = 0;
     char tagString[ MAX_TAG_STRING_LENGTH ] = "\0";
-	char* user = NULL;
-	char* group = NULL;
+	char* pSave = NULL;
+	char* key = NULL;
 	char* token = NULL;
-	char* type = NULL;
+
+	pUsers->count = 0;
+	pGroups->count = 0;
 
 	/* check if the tag ID is within the valid range */
 	if( ( pDp->dpdata.tags[i] < 1 ) ||
@@ -553,99 +2502,47 @@ static int policy_fnTokenizeTags( struct dp_t* pDp,
 		/* tokenize data point tags */
 		while( pDp->dpdata.tags[i] != NULL)
 		{
-			/* copy so that the strtok does not manipulate the pointer */
+			/* the tag map is shared by the dispatch threads, split and
+			 * lower case a copy of the tag only */
 			strncpy( tagString,
 					 tagMap[pDp->dpdata.tags[i]],
-					 strlen(tagMap[pDp->dpdata.tags[i]]) + 1 );
-			if( strstr( strlwr(tagMap[pDp->dpdata.tags[i]]), "type") )
+					 sizeof(tagString) - 1 );
+			tagString[ sizeof(tagString) - 1 ] = '\0';
+
+			key = strtok_r( tagString, COLON, &pSave );
+			token = strtok_r( NULL, COLON, &pSave );
+			if( ( NULL == key ) || ( NULL == token ) )
 			{
-				strtok(tagString, COLON);
-				type = strtok(NULL, COLON);
-				*typeInt = policy_fnTypeString2Val( type );
+				i++;
+				continue;
 			}
-			else if( strstr( strlwr(tagMap[pDp->dpdata.tags[i]]), "location") )
+
+			strlwr( key );
+			if( strstr( key, "type") )
 			{
-				strtok(tagString, COLON);
-				token = strtok(NULL, COLON);
-				strncpy( location, token, strlen(token)+1 );
+				*typeInt = policy_fnTypeString2Val( token );
 			}
-			else if( strstr( strlwr(tagMap[pDp->dpdata.tags[i]]), "user") )
+			else if( strstr( key, "location") )
 			{
-				strtok(tagString, COLON);
-				user = strtok(NULL, COLON);
-
-				/* TODO --
-				 * July 17 2017: these are static and must change in future. */
-				if( 0 == stricmp(user, "gus") )
-				{
-					*userID = USER_CODE_GUS;
-				}
-				else if( 0 == stricmp(user, "doug") )
-				{
-					*userID = USER_CODE_DOUG;
-				}
-				else if( 0 == stricmp(user, "mike") )
-				{
-					*userID = USER_CODE_MIKE;
-				}
-				else if( 0 == stricmp(user, "tom") )
-				{
-					*userID = USER_CODE_TOM;
-				}
-				else if( 0 == stricmp(user, "jackie") )
-				{
-					*userID = USER_CODE_JACKIE;
-				}
-				else if( 0 == stricmp(user, "lilli") )
-				{
-					*userID = USER_CODE_LILLI;
-				}
-				else if( 0 == stricmp(user, "bob") )
-				{
-					*userID = USER_CODE_BOB;
-				}
-				else if( 0 == stricmp(user, "madi") )
-				{
-					*userID = USER_CODE_MADI;
-				}
-				else
-				{
-					*userID = USER_CODE_INVALID;
-				}
-
+				strncpy( location, token, MAX_LOCATION_STRING_LENGTH - 1 );
+				location[ MAX_LOCATION_STRING_LENGTH - 1 ] = '\0';
 			}
-			else if( strstr( strlwr(tagMap[pDp->dpdata.tags[i]]), "group") )
+			else if( strstr( key, "user") )
 			{
-				strtok(tagString, COLON);
-				group = strtok(NULL, COLON);
-
-				/* TODO --
-				 * July 17 2017: these are static and must change in future. */
-				if( 0 == stricmp(group, "manager") )
-				{
-					*groupID = GROUP_CODE_MANAGER;
-				}
-				else if( 0 == stricmp(group, "engineering") )
-				{
-					*groupID = GROUP_CODE_ENG;
-				}
-				else if( 0 == stricmp(group, "technician") )
-				{
-					*groupID = GROUP_CODE_TECH;
-				}
-				else if( 0 == stricmp(group, "customer") )
-				{
-					*groupID = GROUP_CODE_CUSTOMER;
-				}
-				else
-				{
-					*groupID = GROUP_CODE_INVALID;
-				}
+				/* a data point may carry several user tags */
+				SUBJECT_fnLookup( eSubjectUser, token, pUsers );
+			}
+			else if( strstr( key, "group") )
+			{
+				/* a data point may carry several group tags */
+				SUBJECT_fnLookup( eSubjectGroup, token, pGroups );
 			}
 			i++;
 		}
 	}
 
+	/* without a user or group tag known by the rules only a wild card
+	 * rule can match */
 	ret = EOK;
 
 	return ret;
@@ -654,19 +2551,23 @@ static int policy_fnTokenizeTags( struct dp_t* pDp,
 /*============================================================================*/
 /*!
 
-	Check the location, user and group
+	Check the location, user and group, and the condition of the rule
+
+@param[in]
+    pDp
+        data point structure
 
 @param[in]
     location
         location of the data point to check against the policy file
 
 @param[in]
-    user
-        user tag of the data point to check against the policy file
+    pUsers
+        subjects of the user tags of the data point
 
 @param[in]
-    group
-        group id annotated to the data point tag
+    pGroups
+        subjects of the group tags of the data point
 
 @param[in]
     pPolicy
@@ -677,9 +2578,10 @@ static int policy_fnTokenizeTags( struct dp_t* pDp,
 
 */
 /*============================================================================*/
-static int policy_fnCheckAttr( char* location,
-		                       uint32_t userID,
-		                       uint32_t groupID,
+static int policy_fnCheckAttr( struct dp_t *pDp,
+		                       char* location,
+		                       const tzSubjectIds *pUsers,
+		                       const tzSubjectIds *pGroups,
 		                       struct policy_id_t* pPolicy )
 {
 	int ret = EACCES;
@@ -687,11 +2589,19 @@ static int policy_fnCheckAttr( char* location,
 	/* check the location is matching or wild card */
 	if( policy_fnCheckLoc(location, pPolicy) )
 	{
-		if( policy_fnCheckUser(userID,pPolicy ) )
+		if( policy_fnCheckUser(pUsers,pPolicy ) )
 		{
-			if( policy_fnCheckGroup(groupID,pPolicy ) )
+			if( policy_fnCheckGroup(pGroups,pPolicy ) )
 			{
-				ret = EOK; /* pass ok */
+				/* the condition of the rule runs last */
+				if( ( NULL == pPolicy->pProgram ) ||
+					POLICYVM_fnRun( pPolicy->pProgram,
+									pDp,
+									pUsers,
+									pGroups ) )
+				{
+					ret = EOK; /* pass ok */
+				}
 			}
 		}
 	}
@@ -704,12 +2614,12 @@ static int policy_fnCheckAttr( char* location,
 
 @brief
     check if the group is matching with the policy file
-    wild card for group is -1
-    if wild card in the policy this check will pass true
+    the policy keeps its groups as a set, the wild card set matches every
+    data point so this check will pass true
 
 @param[in]
-    group
-        group id annotated to the data point tag
+    pGroups
+        subjects of the groups annotated to the data point tags
 
 @param[in]
     pPolicy
@@ -720,21 +2630,10 @@ static int policy_fnCheckAttr( char* location,
 
 */
 /*============================================================================*/
-static bool policy_fnCheckGroup( uint32_t group, struct policy_id_t* pPolicy )
+static bool policy_fnCheckGroup( const tzSubjectIds *pGroups,
+                                 struct policy_id_t* pPolicy )
 {
-	bool ret = true;
-
-	/* wild card for group is if the group is invalid meaning not specified in
-	 * the policy file ruleset */
-	if( GROUP_CODE_INVALID != pPolicy->policy.group )
-	{
-		if( group != pPolicy->policy.group )
-		{
-			ret = false;
-		}
-	}
-
-	return ret;
+	return SUBJECT_MATCH( &pPolicy->groups, pGroups );
 }
 
 /*============================================================================*/
@@ -742,10 +2641,12 @@ static bool policy_fnCheckGroup( uint32_t group, struct policy_id_t* pPolicy )
 
 @brief
     check user is matching with specified user policy
+    the policy keeps its users as a set, the wild card set matches every
+    data point so this check will pass true
 
 @param[in]
-    user
-        user id annotated to the data point tag
+    pUsers
+        subjects of the users annotated to the data point tags
 
 @param[in]
     pPolicy
@@ -756,20 +2657,10 @@ static bool policy_fnCheckGroup( uint32_t group, struct policy_id_t* pPolicy )
 
 */
 /*============================================================================*/
-static bool policy_fnCheckUser( uint32_t user, struct policy_id_t* pPolicy )
+static bool policy_fnCheckUser( const tzSubjectIds *pUsers,
+                                struct policy_id_t* pPolicy )
 {
-	bool ret = true;
-
-	/* wild card is if the user is invalid in policy, meaning not specified */
-	if( USER_CODE_INVALID != pPolicy->policy.user )
-	{
-		if( user != pPolicy->policy.user )
-		{
-			ret = false;
-		}
-	}
-
-	return ret;
+	return SUBJECT_MATCH( &pPolicy->users, pUsers );
 }
 
 /*============================================================================*/
@@ -817,6 +2708,9 @@ static bool policy_fnCheckLoc( char* location,
 @brief
     check if the data point value fits in the policy min max range
 
+    The range is checked by the kernel of the data point type, against the
+    bounds converted when the rule was created, see comparator.h.
+
 @param[in]
     pDp
         data point structure
@@ -826,16 +2720,16 @@ static bool policy_fnCheckLoc( char* location,
         policy data structure
 
 @return
-    true if the value is in the range otherwise false.
+    EOK if the value is in the range otherwise EACCES.
 
 */
 /*============================================================================*/
-static int policy_fnCheckVal( struct dp_t *pDp,
-		                      struct policy_id_t* pPolicy )
+int POLICY_fnCheckVal( struct dp_t *pDp,
+		               struct policy_id_t* pPolicy )
 {
 	int ret = EACCES;
 
-	if( true == policy_fnBoundChecking( pDp, pPolicy ) )
+	if( true == COMPARATOR_fnCheck( pDp, &pPolicy->bounds ) )
 	{
 		ret = EOK;
 	}
@@ -843,118 +2737,4 @@ static int policy_fnCheckVal( struct dp_t *pDp,
 	return ret;
 }
 
-/*============================================================================*/
-/*!
-
-@brief
-    Check the min max bound
-
-    Assumption: check the policy min/max are not set to wild card wild card for
-    the policy min max are both zero
-    this happens during the parsing of the policy
-
-@param[in]
-    pDp
-        data point structure
-
-@param[in]
-    pPolicy
-        policy data structure
-
-@return
-    true if the value is in the range otherwise false.
-
-*/
-/*============================================================================*/
-static bool policy_fnBoundChecking( struct dp_t *pDp,
-		                            struct policy_id_t* pPolicy )
-{
-	bool ret = true;
-
-	/* check the policy min/max are not set to wild card
-	 * wild card for the policy min max are both zero */
-	if( ( 0 != pPolicy->policy.min ) && ( 0 != pPolicy->policy.max ) )
-	{
-		/* get a pointer to the data point data and determine its length */
-		switch( pDp->dpdata.type )
-		{
-		/* this practice is for integer values only
-		 * so factoring strings out */
-		/*case DP_TYPE_STR:
-			pVar = pDp->dpdata.val.pStr;
-			len = pDp->dpdata.len;
-			break;*/
-
-		case DP_TYPE_UINT16:
-			if( pDp->dpdata.val.uiVal >= pPolicy->policy.min &&
-				pDp->dpdata.val.uiVal <= pPolicy->policy.max )
-			{
-				ret = true;
-			}
-			else
-			{
-				ret = false;
-			}
-			break;
-
-		case DP_TYPE_SINT16:
-			if( pDp->dpdata.val.siVal >= pPolicy->policy.min &&
-				pDp->dpdata.val.siVal <= pPolicy->policy.max )
-			{
-				ret = true;
-			}
-			else
-			{
-				ret = false;
-			}
-			break;
-
-		case DP_TYPE_UINT32:
-			if( pDp->dpdata.val.ulVal >= pPolicy->policy.min &&
-				pDp->dpdata.val.ulVal <= pPolicy->policy.max )
-			{
-				ret = true;
-			}
-			else
-			{
-				ret = false;
-			}
-			break;
-
-		case DP_TYPE_SINT32:
-			if( pDp->dpdata.val.slVal >= pPolicy->policy.min &&
-				pDp->dpdata.val.slVal <= pPolicy->policy.max )
-			{
-				ret = true;
-			}
-			else
-			{
-				ret = false;
-			}
-			break;
-
-		case DP_TYPE_FLOAT32:
-			if( pDp->dpdata.val.fVal >= pPolicy->policy.min &&
-				pDp->dpdata.val.fVal <= pPolicy->policy.max )
-			{
-				ret = true;
-			}
-			else
-			{
-				ret = false;
-			}
-			break;
-
-		case DP_TYPE_ARRAY32:
-		case DP_TYPE_ARRAY16:
-		case DP_TYPE_CONJUGATE:
-		default:
-			ret = false;
-			break;
-		}
-	}
-
-	return ret;
-}
-
 /*! @} */
@@ -34,7 +34,29 @@ Mini Cloud Server Project.
                                  Includes
  =============================================================================*/
 
+#include <stdio.h>
 #include "minicloudmsg.h"
+#include "policyprog.h"
+#include "comparator.h"
+#include "subject.h"
+
+/*=============================================================================
+                                 Enums
+==============================================================================*/
+
+/*! policy check engines, the values are the POLICY_ENGINE_ID of policymsg.h */
+typedef enum ePolicyEngine
+{
+    /*! look up the rule in the policy hash and check its attributes */
+    POLICY_ENGINE_HASH = 0,
+
+    /*! walk the decision diagram compiled at the last policy commit */
+    POLICY_ENGINE_DD,
+
+    /*! run the rule set compiled to native code, see policynative.h */
+    POLICY_ENGINE_NATIVE
+
+} tePolicyEngine;
 
 /*=============================================================================
                               Structures
@@ -47,6 +69,26 @@ struct policy_id_t
 	/*! policy data structure */
 	struct zPOLICY policy;
 
+    /*! range of the rule converted to the data point types */
+    tzPolicyBounds bounds;
+
+    /*! users of the rule, the user field of the policy keeps the code it
+     *  was registered with */
+    tzSubjectSet users;
+
+    /*! groups of the rule, the group field of the policy keeps the code it
+     *  was registered with */
+    tzSubjectSet groups;
+
+    /*! condition of the rule, NULL if the rule has none */
+    tzPolicyProgram *pProgram;
+
+    /*! key of the rule, see POLICYDELTA_fnKey */
+    uint64_t key;
+
+    /*! fingerprint of the rule as registered, see POLICYDELTA_fnFingerprint */
+    uint64_t fingerprint;
+
     /*! points to the next policy in the iterator list */
     struct policy_id_t *pNext;
 };
@@ -57,9 +99,22 @@ struct policy_id_t
 
 
 int POLICY_fnCreatePolicy( int rcvid, datapoint_policy_msg_t *msg );
+int POLICY_fnCreateReplay( void *pData, size_t length );
 int POLICY_fnHouseKeepPolicy( int rcvid, datapoint_policy_msg_t *msg );
+int POLICY_fnHouseKeepReplay( void *pData, size_t length );
 struct policy_id_t* POLICY_fnGetHead( void );
 bool POLICY_fnCheck( struct dp_t *pDp );
+int POLICY_fnDecide( struct dp_t *pDp,
+                     int typeInt,
+                     char *location,
+                     const tzSubjectIds *pUsers,
+                     const tzSubjectIds *pGroups );
+int POLICY_fnCheckVal( struct dp_t *pDp, struct policy_id_t* pPolicy );
+int POLICY_fnSelectEngine( tePolicyEngine engine );
+int POLICY_fnBenchmark( struct dp_t *pDp, int iterations );
+int POLICY_fnBenchmarkRules( int iterations );
+int POLICY_fnSnapshotSave( FILE *fp, void *pContext );
+int POLICY_fnSnapshotLoad( void *pData, size_t length, void *pContext );
 
 
 /*! @} */
@@ -0,0 +1,1033 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup policydd
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  policydd.c
+
+ @brief
+    Policy decision diagram compiler
+
+ @details
+    This module compiles the active policy rules into a reduced multi-valued
+    decision diagram (MDD).  The levels of the diagram are in the order:
+
+        type      switch node, one edge per rule type
+        location  switch node, one edge per interned rule location
+        user      set node, hi edge if a data point user is in the set
+        group     set node, hi edge if a data point group is in the set
+        time      threshold node, hi edge if the data point is not older
+        condition test node, hi edge if the rule condition program holds
+
+    and the leaves are deny, permit or a value range check.  Every node is
+    hash consed in a unique table while building, so identical sub graphs
+    (e.g. the same user, group and range in many locations) are stored once,
+    and a node whose edges all lead to the same child is removed.
+
+    The decisions are the same as the hash engine: the location of the data
+    point must be the location of the rule, and a rule is only found with
+    the rule name of its type.
+
+    A new diagram is compiled beside the active one, the decisions hold the
+    graph lock shared and the build only takes it exclusively to intern a
+    new location and to swap and release the diagram.  Builds are
+    serialized by the policy write lock.
+
+*/
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "cfuhash.h"
+#include "hash.h"
+#include "policy.h"
+#include "policydd.h"
+#include "policyvm.h"
+#include "subject.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Defines
+==============================================================================*/
+
+/*! number of fixed words of a node signature, the switch edges then the
+ *  words of the subject set follow */
+#define DD_SIGNATURE_HEADER      ( 9 )
+
+/*! an estimate for the number of distinct rule locations */
+#define ESTIMATED_NUM_LOCATIONS  ( 200 )
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Enums
+==============================================================================*/
+
+/*! decision diagram node kinds */
+typedef enum eDDKind
+{
+    /*! leaf, access is denied */
+    eDDDeny = 0,
+
+    /*! leaf, access is permitted */
+    eDDPermit,
+
+    /*! leaf, access is permitted if the value is in the rule range */
+    eDDRange,
+
+    /*! switch on the data point type */
+    eDDType,
+
+    /*! switch on the data point location */
+    eDDLocation,
+
+    /*! test of the data point user set */
+    eDDUser,
+
+    /*! test of the data point group set */
+    eDDGroup,
+
+    /*! test of the data point time stamp */
+    eDDTime,
+
+    /*! test of the rule condition */
+    eDDProgram
+
+} teDDKind;
+
+/*=============================================================================
+ 	 	 	 	 	 	 	 	 Structures
+ =============================================================================*/
+
+/*! switch node edge */
+typedef struct zDDEdge
+{
+    /*! type or interned location of the edge */
+    uint32_t key;
+
+    /*! child node */
+    struct zDDNode *pChild;
+
+} tzDDEdge;
+
+/*! decision diagram node */
+typedef struct zDDNode
+{
+    /*! node kind */
+    teDDKind kind;
+
+    /*! subject set of a user or group node, the set of a rule */
+    const tzSubjectSet *pSet;
+
+    /*! policy time of a time node */
+    time_t since;
+
+    /*! rule holding the min max of a range leaf or the condition of a
+     *  condition node */
+    struct policy_id_t *pRule;
+
+    /*! child if the test passed */
+    struct zDDNode *pHi;
+
+    /*! child if the test failed, default child of a switch node */
+    struct zDDNode *pLo;
+
+    /*! number of edges of a switch node */
+    int numEdges;
+
+    /*! edges of a switch node sorted by key */
+    tzDDEdge *pEdges;
+
+    /*! next node of the graph, used to release the graph */
+    struct zDDNode *pNext;
+
+} tzDDNode;
+
+/*! compiled decision diagram */
+typedef struct zDDGraph
+{
+    /*! root node, a type switch */
+    tzDDNode *pRoot;
+
+    /*! all nodes of the graph */
+    tzDDNode *pNodes;
+
+    /*! number of nodes of the graph */
+    int numNodes;
+
+} tzDDGraph;
+
+/*! rule collected for compiling */
+typedef struct zDDRule
+{
+    /*! rule type */
+    uint32_t type;
+
+    /*! interned rule location */
+    uint32_t location;
+
+    /*! user, group, time and value chain of the rule */
+    tzDDNode *pChain;
+
+} tzDDRule;
+
+/*! compiler state */
+typedef struct zDDBuild
+{
+    /*! graph being built */
+    tzDDGraph graph;
+
+    /*! unique table of the hash consed nodes */
+    cfuhash_table_t *pUnique;
+
+    /*! deny leaf */
+    tzDDNode *pDeny;
+
+    /*! permit leaf */
+    tzDDNode *pPermit;
+
+    /*! EOK or the first error of the build */
+    int ret;
+
+} tzDDBuild;
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Variables
+ =============================================================================*/
+
+/*! diagram of the committed rules */
+static tzDDGraph activeGraph;
+
+/*! hash table mapping a lower case location to its identifier */
+static cfuhash_table_t *locations = NULL;
+
+/*! number of interned locations */
+static uint32_t numLocations = 0;
+
+/*! lock of the active diagram and the location table */
+static pthread_rwlock_t graphLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*==============================================================================
+ Local/Private Function Prototypes
+ =============================================================================*/
+
+static tzDDNode* policydd_fnMake( tzDDBuild *pBuild, tzDDNode *pProto );
+static tzDDNode* policydd_fnMakeTest( tzDDBuild *pBuild,
+                                      teDDKind kind,
+                                      const tzSubjectSet *pSet,
+                                      time_t since,
+                                      tzDDNode *pHi );
+static tzDDNode* policydd_fnMakeSwitch( tzDDBuild *pBuild,
+                                        teDDKind kind,
+                                        tzDDEdge *pEdges,
+                                        int numEdges );
+static tzDDNode* policydd_fnRuleChain( tzDDBuild *pBuild,
+                                       struct policy_id_t *pPolicy );
+static tzDDNode* policydd_fnSelect( tzDDNode *pNode, uint32_t key );
+static uint32_t policydd_fnInternLocation( char *location );
+static int policydd_fnRuleName( int typeInt );
+static int policydd_fnCompareRule( const void *p1, const void *p2 );
+static void policydd_fnFree( tzDDGraph *pGraph );
+
+/*==============================================================================
+ Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Compile the policy rules into a decision diagram
+
+    The diagram replaces the active diagram only if it was built completely,
+    on failure the previous diagram stays in use.
+
+@param[in]
+    pRules
+        policy house keeping array holding the committed rules
+
+@param[in]
+    numRules
+        number of entries of the house keeping array
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+int POLICYDD_fnBuild( tzHouseKeep *pRules, int numRules )
+{
+    tzDDBuild build;
+    tzDDNode proto;
+    tzDDRule *pCollected = NULL;
+    tzDDEdge *pLocEdges = NULL;
+    tzDDEdge *pTypeEdges = NULL;
+    struct policy_id_t *pPolicy;
+    int numCollected = 0;
+    int numLocEdges = 0;
+    int numTypeEdges = 0;
+    int i;
+
+    if( ( NULL == pRules ) || ( numRules < 0 ) )
+    {
+        return EINVAL;
+    }
+
+    if( NULL == locations )
+    {
+        pthread_rwlock_wrlock( &graphLock );
+        locations = cfuhash_new_with_initial_size( ESTIMATED_NUM_LOCATIONS );
+        if( NULL != locations )
+        {
+            cfuhash_set_flag( locations, CFUHASH_NO_LOCKING );
+        }
+        pthread_rwlock_unlock( &graphLock );
+    }
+
+    memset( &build, 0, sizeof(build) );
+    build.ret = EOK;
+    build.pUnique = cfuhash_new_with_initial_size( numRules * 4 + 16 );
+
+    pCollected = calloc( numRules + 1, sizeof(tzDDRule) );
+    pLocEdges = calloc( numRules + 1, sizeof(tzDDEdge) );
+    pTypeEdges = calloc( numRules + 1, sizeof(tzDDEdge) );
+
+    if( ( NULL == locations ) || ( NULL == build.pUnique ) ||
+        ( NULL == pCollected ) || ( NULL == pLocEdges ) ||
+        ( NULL == pTypeEdges ) )
+    {
+        build.ret = ENOMEM;
+    }
+    else
+    {
+        memset( &proto, 0, sizeof(proto) );
+        proto.kind = eDDDeny;
+        build.pDeny = policydd_fnMake( &build, &proto );
+        proto.kind = eDDPermit;
+        build.pPermit = policydd_fnMake( &build, &proto );
+    }
+
+    /* collect the rules which the hash engine can find */
+    for( i = 0; ( EOK == build.ret ) && ( i < numRules ); i++ )
+    {
+        pPolicy = pRules[i].pPolicy;
+        if( ( NULL == pPolicy ) ||
+            ( pPolicy->policy.Name != policydd_fnRuleName( pPolicy->policy.Type ) ) )
+        {
+            continue;
+        }
+
+        pCollected[numCollected].type = (uint32_t)pPolicy->policy.Type;
+        pCollected[numCollected].location =
+                policydd_fnInternLocation( pPolicy->policy.Location );
+        pCollected[numCollected].pChain =
+                policydd_fnRuleChain( &build, pPolicy );
+        numCollected++;
+    }
+
+    if( EOK == build.ret )
+    {
+        qsort( pCollected,
+               numCollected,
+               sizeof(tzDDRule),
+               policydd_fnCompareRule );
+
+        /* one location switch per type, one type switch at the root */
+        for( i = 0; ( EOK == build.ret ) && ( i < numCollected ); i++ )
+        {
+            if( ( numLocEdges > 0 ) &&
+                ( pLocEdges[numLocEdges-1].key == pCollected[i].location ) )
+            {
+                /* the policy hash holds a single rule per type and
+                 * location, keep the first one */
+            }
+            else
+            {
+                pLocEdges[numLocEdges].key = pCollected[i].location;
+                pLocEdges[numLocEdges].pChild = pCollected[i].pChain;
+                numLocEdges++;
+            }
+
+            if( ( i + 1 == numCollected ) ||
+                ( pCollected[i+1].type != pCollected[i].type ) )
+            {
+                pTypeEdges[numTypeEdges].key = pCollected[i].type;
+                pTypeEdges[numTypeEdges].pChild =
+                        policydd_fnMakeSwitch( &build,
+                                               eDDLocation,
+                                               pLocEdges,
+                                               numLocEdges );
+                numTypeEdges++;
+                numLocEdges = 0;
+            }
+        }
+
+        build.graph.pRoot = policydd_fnMakeSwitch( &build,
+                                                   eDDType,
+                                                   pTypeEdges,
+                                                   numTypeEdges );
+    }
+
+    if( EOK == build.ret )
+    {
+        /* commit the new diagram */
+        pthread_rwlock_wrlock( &graphLock );
+        policydd_fnFree( &activeGraph );
+        activeGraph = build.graph;
+        pthread_rwlock_unlock( &graphLock );
+    }
+    else
+    {
+        policydd_fnFree( &build.graph );
+    }
+
+    if( NULL != build.pUnique )
+    {
+        cfuhash_destroy( build.pUnique );
+    }
+
+    free( pCollected );
+    free( pLocEdges );
+    free( pTypeEdges );
+
+    return build.ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Decide on a data point using the decision diagram
+
+@param[in]
+    pDp
+        data point structure
+
+@param[in]
+    typeInt
+        category type of the data point
+
+@param[in]
+    location
+        location of the data point, it is converted to lower case
+
+@param[in]
+    pUsers
+        subjects of the user tags of the data point
+
+@param[in]
+    pGroups
+        subjects of the group tags of the data point
+
+@retval EOK - if the policy check passed
+@retval EACCES - if the policy did not pass
+
+*/
+/*============================================================================*/
+int POLICYDD_fnDecide( struct dp_t *pDp,
+                       int typeInt,
+                       char *location,
+                       const tzSubjectIds *pUsers,
+                       const tzSubjectIds *pGroups )
+{
+    int ret = EACCES;
+    tzDDNode *pNode = NULL;
+    uint32_t locId = 0;
+    bool done = false;
+
+    /* no policy for the type yet, assume wild card */
+    if( POLICY_TYPE_INVALID == typeInt )
+    {
+        return EOK;
+    }
+
+    strlwr( location );
+
+    pthread_rwlock_rdlock( &graphLock );
+
+    pNode = activeGraph.pRoot;
+    if( ( NULL == pNode ) || ( NULL == locations ) )
+    {
+        done = true;
+    }
+    else
+    {
+        locId = (uint32_t)(uintptr_t)cfuhash_get( locations, location );
+    }
+
+    while( false == done )
+    {
+        switch( pNode->kind )
+        {
+        case eDDType:
+            pNode = policydd_fnSelect( pNode, (uint32_t)typeInt );
+            break;
+
+        case eDDLocation:
+            pNode = policydd_fnSelect( pNode, locId );
+            break;
+
+        case eDDUser:
+            pNode = SUBJECT_MATCH( pNode->pSet, pUsers ) ? pNode->pHi
+                                                         : pNode->pLo;
+            break;
+
+        case eDDGroup:
+            pNode = SUBJECT_MATCH( pNode->pSet, pGroups ) ? pNode->pHi
+                                                          : pNode->pLo;
+            break;
+
+        case eDDTime:
+            pNode = ( pNode->since <= pDp->dpdata.timestamp.tv_sec )
+                    ? pNode->pHi
+                    : pNode->pLo;
+            break;
+
+        case eDDProgram:
+            pNode = POLICYVM_fnRun( pNode->pRule->pProgram,
+                                    pDp,
+                                    pUsers,
+                                    pGroups )
+                    ? pNode->pHi
+                    : pNode->pLo;
+            break;
+
+        case eDDRange:
+            ret = POLICY_fnCheckVal( pDp, pNode->pRule );
+            done = true;
+            break;
+
+        case eDDPermit:
+            ret = EOK;
+            done = true;
+            break;
+
+        case eDDDeny:
+        default:
+            ret = EACCES;
+            done = true;
+            break;
+        }
+    }
+
+    pthread_rwlock_unlock( &graphLock );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Return the number of nodes of the active decision diagram
+
+@return
+    number of nodes, 0 if the diagram has not been built
+
+*/
+/*============================================================================*/
+int POLICYDD_fnNodeCount( void )
+{
+    return activeGraph.numNodes;
+}
+
+/*============================================================================*/
+/*!
+
+    Build the chain of tests of a single rule
+
+    The chain tests the users, the groups, the time, the condition and the
+    value range of the rule, tests which are a wild card in the rule are
+    left out.
+
+@param[in]
+    pBuild
+        compiler state
+
+@param[in]
+    pPolicy
+        policy rule
+
+@return
+    first node of the chain
+
+*/
+/*============================================================================*/
+static tzDDNode* policydd_fnRuleChain( tzDDBuild *pBuild,
+                                       struct policy_id_t *pPolicy )
+{
+    tzDDNode proto;
+    tzDDNode *pNode = pBuild->pPermit;
+
+    /* the min max wild card is when either bound is zero */
+    if( ( POLICY_NAME_COMP == pPolicy->policy.Name ) &&
+        ( 0 != pPolicy->policy.min ) &&
+        ( 0 != pPolicy->policy.max ) )
+    {
+        memset( &proto, 0, sizeof(proto) );
+        proto.kind = eDDRange;
+        proto.pRule = pPolicy;
+        pNode = policydd_fnMake( pBuild, &proto );
+    }
+
+    if( ( NULL != pPolicy->pProgram ) && ( pNode != pBuild->pDeny ) )
+    {
+        memset( &proto, 0, sizeof(proto) );
+        proto.kind = eDDProgram;
+        proto.pRule = pPolicy;
+        proto.pHi = pNode;
+        proto.pLo = pBuild->pDeny;
+        pNode = policydd_fnMake( pBuild, &proto );
+    }
+
+    if( 0 != pPolicy->policy.time.tv_sec )
+    {
+        pNode = policydd_fnMakeTest( pBuild,
+                                     eDDTime,
+                                     NULL,
+                                     pPolicy->policy.time.tv_sec,
+                                     pNode );
+    }
+
+    if( false == pPolicy->groups.any )
+    {
+        pNode = policydd_fnMakeTest( pBuild,
+                                     eDDGroup,
+                                     &pPolicy->groups,
+                                     0,
+                                     pNode );
+    }
+
+    if( false == pPolicy->users.any )
+    {
+        pNode = policydd_fnMakeTest( pBuild,
+                                     eDDUser,
+                                     &pPolicy->users,
+                                     0,
+                                     pNode );
+    }
+
+    return pNode;
+}
+
+/*============================================================================*/
+/*!
+
+    Make a test node whose failing edge denies the access
+
+@param[in]
+    pBuild
+        compiler state
+
+@param[in]
+    kind
+        eDDUser, eDDGroup or eDDTime
+
+@param[in]
+    pSet
+        subject set of a user or group node, NULL for a time node
+
+@param[in]
+    since
+        policy time of a time node
+
+@param[in]
+    pHi
+        child if the test passed
+
+@return
+    the shared node
+
+*/
+/*============================================================================*/
+static tzDDNode* policydd_fnMakeTest( tzDDBuild *pBuild,
+                                      teDDKind kind,
+                                      const tzSubjectSet *pSet,
+                                      time_t since,
+                                      tzDDNode *pHi )
+{
+    tzDDNode proto;
+
+    /* both edges deny, the test is redundant */
+    if( pHi == pBuild->pDeny )
+    {
+        return pHi;
+    }
+
+    memset( &proto, 0, sizeof(proto) );
+    proto.kind = kind;
+    proto.pSet = pSet;
+    proto.since = since;
+    proto.pHi = pHi;
+    proto.pLo = pBuild->pDeny;
+
+    return policydd_fnMake( pBuild, &proto );
+}
+
+/*============================================================================*/
+/*!
+
+    Make a switch node whose default edge denies the access
+
+@param[in]
+    pBuild
+        compiler state
+
+@param[in]
+    kind
+        eDDType or eDDLocation
+
+@param[in]
+    pEdges
+        edges sorted by key, copied into the node
+
+@param[in]
+    numEdges
+        number of edges
+
+@return
+    the shared node
+
+*/
+/*============================================================================*/
+static tzDDNode* policydd_fnMakeSwitch( tzDDBuild *pBuild,
+                                        teDDKind kind,
+                                        tzDDEdge *pEdges,
+                                        int numEdges )
+{
+    tzDDNode proto;
+    int i;
+    int n = 0;
+
+    memset( &proto, 0, sizeof(proto) );
+    proto.kind = kind;
+    proto.pLo = pBuild->pDeny;
+    proto.pEdges = calloc( numEdges + 1, sizeof(tzDDEdge) );
+    if( NULL == proto.pEdges )
+    {
+        pBuild->ret = ENOMEM;
+        return pBuild->pDeny;
+    }
+
+    /* edges to the default child are redundant */
+    for( i = 0; i < numEdges; i++ )
+    {
+        if( pEdges[i].pChild != pBuild->pDeny )
+        {
+            proto.pEdges[n++] = pEdges[i];
+        }
+    }
+    proto.numEdges = n;
+
+    /* the root always exists so an empty rule set denies */
+    if( ( 0 == n ) && ( eDDType != kind ) )
+    {
+        free( proto.pEdges );
+        return pBuild->pDeny;
+    }
+
+    return policydd_fnMake( pBuild, &proto );
+}
+
+/*============================================================================*/
+/*!
+
+    Return the shared node equal to the prototype
+
+    The signature of the node (its kind, parameters and children) is looked
+    up in the unique table, a user or group node is shared by the bits of
+    its set, a new node is only created if no equal node
+    exists.  The edges of a switch prototype are owned by the returned node
+    or released.
+
+@param[in]
+    pBuild
+        compiler state
+
+@param[in]
+    pProto
+        prototype of the node
+
+@return
+    the shared node, the deny leaf if the node could not be created
+
+*/
+/*============================================================================*/
+static tzDDNode* policydd_fnMake( tzDDBuild *pBuild, tzDDNode *pProto )
+{
+    uint64_t *pSig = NULL;
+    size_t sigLen;
+    void *pFound = NULL;
+    size_t foundSize = 0;
+    tzDDNode *pNode = NULL;
+    double bound;
+    uint32_t numSetWords = 0u;
+    uint64_t *pSetSig;
+    uint32_t w;
+    int i;
+
+    if( NULL != pProto->pSet )
+    {
+        numSetWords = pProto->pSet->numWords;
+    }
+
+    sigLen = ( DD_SIGNATURE_HEADER + 2 * pProto->numEdges + numSetWords ) *
+             sizeof(uint64_t);
+    pSig = calloc( 1, sigLen );
+    if( NULL == pSig )
+    {
+        free( pProto->pEdges );
+        pBuild->ret = ENOMEM;
+        return pBuild->pDeny;
+    }
+
+    pSig[0] = (uint64_t)pProto->kind;
+    pSig[1] = (uint64_t)numSetWords;
+    pSig[2] = (uint64_t)(int64_t)pProto->since;
+    pSig[3] = (uint64_t)(uintptr_t)pProto->pHi;
+    pSig[4] = (uint64_t)(uintptr_t)pProto->pLo;
+    if( eDDProgram == pProto->kind )
+    {
+        /* condition nodes are shared by their program */
+        pSig[8] = (uint64_t)(uintptr_t)pProto->pRule->pProgram;
+    }
+    else if( NULL != pProto->pRule )
+    {
+        /* range leaves are shared by their bounds, not by their rule */
+        bound = (double)pProto->pRule->policy.min;
+        memcpy( &pSig[5], &bound, sizeof(bound) );
+        bound = (double)pProto->pRule->policy.max;
+        memcpy( &pSig[6], &bound, sizeof(bound) );
+    }
+    pSig[7] = (uint64_t)pProto->numEdges;
+    for( i = 0; i < pProto->numEdges; i++ )
+    {
+        pSig[DD_SIGNATURE_HEADER + 2*i] = (uint64_t)pProto->pEdges[i].key;
+        pSig[DD_SIGNATURE_HEADER + 2*i + 1] =
+                (uint64_t)(uintptr_t)pProto->pEdges[i].pChild;
+    }
+    pSetSig = &pSig[ DD_SIGNATURE_HEADER + 2 * pProto->numEdges ];
+    for( w = 0u; w < numSetWords; w++ )
+    {
+        pSetSig[w] = pProto->pSet->pWords[w];
+    }
+
+    if( cfuhash_get_data( pBuild->pUnique,
+                          pSig,
+                          sigLen,
+                          &pFound,
+                          &foundSize ) )
+    {
+        free( pProto->pEdges );
+        pNode = (tzDDNode *)pFound;
+    }
+    else
+    {
+        pNode = calloc( 1, sizeof(tzDDNode) );
+        if( NULL == pNode )
+        {
+            free( pProto->pEdges );
+            pBuild->ret = ENOMEM;
+            pNode = pBuild->pDeny;
+        }
+        else
+        {
+            *pNode = *pProto;
+            pNode->pNext = pBuild->graph.pNodes;
+            pBuild->graph.pNodes = pNode;
+            pBuild->graph.numNodes++;
+
+            cfuhash_put_data( pBuild->pUnique,
+                              pSig,
+                              sigLen,
+                              pNode,
+                              sizeof(tzDDNode),
+                              NULL );
+        }
+    }
+
+    free( pSig );
+
+    return pNode;
+}
+
+/*============================================================================*/
+/*!
+
+    Follow the edge of a switch node
+
+@param[in]
+    pNode
+        switch node
+
+@param[in]
+    key
+        type or interned location
+
+@return
+    child of the edge with the key, or the default child
+
+*/
+/*============================================================================*/
+static tzDDNode* policydd_fnSelect( tzDDNode *pNode, uint32_t key )
+{
+    int lo = 0;
+    int hi = pNode->numEdges - 1;
+    int mid;
+
+    while( lo <= hi )
+    {
+        mid = ( lo + hi ) / 2;
+        if( pNode->pEdges[mid].key == key )
+        {
+            return pNode->pEdges[mid].pChild;
+        }
+        else if( pNode->pEdges[mid].key < key )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    return pNode->pLo;
+}
+
+/*============================================================================*/
+/*!
+
+    Intern a rule location and return its identifier
+
+    The identifiers are kept over the rebuilds of the diagram, 0 is never
+    used so it stands for a location which no rule mentions.
+
+@param[in]
+    location
+        location of the rule, lower case as stored by the policy creation
+
+@return
+    identifier of the location
+
+*/
+/*============================================================================*/
+static uint32_t policydd_fnInternLocation( char *location )
+{
+    uintptr_t id;
+
+    /* the build is the only writer, it reads the table without the lock */
+    id = (uintptr_t)cfuhash_get( locations, location );
+    if( 0 == id )
+    {
+        id = (uintptr_t)( ++numLocations );
+        pthread_rwlock_wrlock( &graphLock );
+        cfuhash_put( locations, location, (void *)id );
+        pthread_rwlock_unlock( &graphLock );
+    }
+
+    return (uint32_t)id;
+}
+
+/*============================================================================*/
+/*!
+
+    Return the rule name the policy check uses for a type
+
+@param[in]
+    typeInt
+        category type of the rule
+
+@return
+    POLICY_NAME_ACCESS for the accessor types, POLICY_NAME_COMP otherwise
+
+*/
+/*============================================================================*/
+static int policydd_fnRuleName( int typeInt )
+{
+    int name = POLICY_NAME_COMP;
+
+    switch( typeInt )
+    {
+    case POLICY_TYPE_PASS:
+    case POLICY_TYPE_HEAD:
+    case POLICY_TYPE_FUEL:
+        name = POLICY_NAME_ACCESS;
+        break;
+    default:
+        break;
+    }
+
+    return name;
+}
+
+/*============================================================================*/
+/*!
+
+    qsort comparison of the collected rules by type then location
+
+*/
+/*============================================================================*/
+static int policydd_fnCompareRule( const void *p1, const void *p2 )
+{
+    const tzDDRule *pRule1 = (const tzDDRule *)p1;
+    const tzDDRule *pRule2 = (const tzDDRule *)p2;
+
+    if( pRule1->type != pRule2->type )
+    {
+        return ( pRule1->type < pRule2->type ) ? -1 : 1;
+    }
+
+    if( pRule1->location != pRule2->location )
+    {
+        return ( pRule1->location < pRule2->location ) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/*============================================================================*/
+/*!
+
+    Release all nodes of a graph
+
+@param[in]
+    pGraph
+        graph to release
+
+*/
+/*============================================================================*/
+static void policydd_fnFree( tzDDGraph *pGraph )
+{
+    tzDDNode *pNode = pGraph->pNodes;
+    tzDDNode *pNext;
+
+    while( NULL != pNode )
+    {
+        pNext = pNode->pNext;
+        free( pNode->pEdges );
+        free( pNode );
+        pNode = pNext;
+    }
+
+    memset( pGraph, 0, sizeof(tzDDGraph) );
+}
+
+/*!
+ * @} // policydd
+ */
@@ -0,0 +1,59 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef POLICYDD_H_
+#define POLICYDD_H_
+
+/*!
+ * @file policydd.h
+ * @brief Public APIs for the policy decision diagram
+ *
+ * The policydd.h file contains the public APIs, types, and
+ * data structures for compiling the active policy rules into a
+ * decision diagram.
+ *
+ * @defgroup policydd Policy Decision Diagram
+ * @brief Compiled policy rule set
+ *
+ * The active rule set is compiled into a reduced multi-valued decision
+ * diagram ordered as type, location, user, group and time.  Identical sub
+ * graphs are shared, so a large rule set with many equal rules collapses
+ * into a small graph, and a policy decision is a walk of at most one node
+ * per level followed by the value check of the leaf.
+ *
+ * The diagram is rebuilt every time the policy rules are committed by the
+ * policy housekeeping.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "subject.h"
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int POLICYDD_fnBuild( tzHouseKeep *pRules, int numRules );
+int POLICYDD_fnDecide( struct dp_t *pDp,
+                       int typeInt,
+                       char *location,
+                       const tzSubjectIds *pUsers,
+                       const tzSubjectIds *pGroups );
+int POLICYDD_fnNodeCount( void );
+
+/*! @} */
+
+#endif /* POLICYDD_H_ */
@@ -0,0 +1,407 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup policynative
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  policynative.c
+
+ @brief
+    Load and run policy rule sets compiled to native code
+
+ @details
+    This module loads the shared objects generated by "defdp -g" and
+    forwards the policy checks to them.  The checks run in the active rule
+    set holding a read lock, the way the decision diagram is walked, so a
+    check sees either the old or the new rule set.  Swapping the rule set
+    takes the write lock, which waits for the checks still running in the
+    old one; its shared object is then closed.
+
+    dlopen returns the object already mapped for a path, so a rule set
+    rebuilt under the name of one still loaded would not be loaded at all.
+    Such a load is refused, the new rule set must be built under another
+    name or loaded once the old one is unloaded.
+
+    A client names the shared object to load, so the code the server runs
+    is restricted to the directory set by the server with
+    POLICYNATIVE_fnSetDirectory; the path is resolved first so that a
+    symbolic link or ".." cannot lead out of it.
+
+    While no native rule set is active the checks are decided by the
+    decision diagram of the committed rules.
+
+*/
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include "minicloud.h"
+#include "comparator.h"
+#include "policydd.h"
+#include "policynative.h"
+#include "policyvm.h"
+#include "subject.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Variables
+ =============================================================================*/
+
+/*! services offered to the native code */
+static const tzPolicyNativeHost host =
+{
+    SUBJECT_fnInternSet,
+    SUBJECT_fnFreeSet,
+    POLICYVM_fnLoad,
+    POLICYVM_fnFree,
+    POLICYVM_fnRun,
+    COMPARATOR_fnInRange
+};
+
+/*! active native rule set, NULL if none */
+static const tzPolicyNative *pActive = NULL;
+
+/*! shared object of the active native rule set */
+static void *pActiveHandle = NULL;
+
+/*! held for reading by the checks running in the active rule set */
+static pthread_rwlock_t nativeLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*! resolved directory of the native rule sets, NULL if none may be loaded */
+static char *pNativeDir = NULL;
+
+/*==============================================================================
+ Local/Private Function Prototypes
+ =============================================================================*/
+
+static void policynative_fnSwap( const tzPolicyNative *pNative,
+                                 void *pHandle );
+
+/*==============================================================================
+ Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Set the directory of the native rule sets
+
+    Called when the server starts, before any client asks to load a native
+    rule set.
+
+@param[in]
+    pDir
+        directory holding the shared objects the clients may load
+
+@return
+    EOK on success, any other standard error code on failure, no native
+    rule set can be loaded on failure
+
+*/
+/*============================================================================*/
+int POLICYNATIVE_fnSetDirectory( const char *pDir )
+{
+    char *pResolved;
+
+    if( ( NULL == pDir ) || ( '\0' == *pDir ) )
+    {
+        return EINVAL;
+    }
+
+    pResolved = realpath( pDir, NULL );
+    if( NULL == pResolved )
+    {
+        return errno;
+    }
+
+    free( pNativeDir );
+    pNativeDir = pResolved;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Load a native rule set and make it the active one
+
+@param[in]
+    pPath
+        path of the shared object built from the "defdp -g" output, in the
+        directory set with POLICYNATIVE_fnSetDirectory
+
+@return
+    EOK on success, EPERM if the shared object is not in the directory of
+    the native rule sets or there is none, EBUSY if it is loaded already,
+    any other standard error code on failure, the active rule set is
+    unchanged on failure
+
+*/
+/*============================================================================*/
+int POLICYNATIVE_fnLoad( const char *pPath )
+{
+    char resolved[ PATH_MAX ];
+    void *pHandle = NULL;
+    const tzPolicyNative *pNative = NULL;
+    size_t dirLength;
+    int ret = EOK;
+
+    if( ( NULL == pPath ) || ( '\0' == *pPath ) )
+    {
+        return EINVAL;
+    }
+
+    if( NULL == pNativeDir )
+    {
+        fprintf( stderr, "%s: no directory of native rule sets\n", __func__ );
+        return EPERM;
+    }
+
+    if( NULL == realpath( pPath, resolved ) )
+    {
+        return ENOENT;
+    }
+
+    /* the resolved path is the directory followed by a name */
+    dirLength = strlen( pNativeDir );
+    if( ( 0 != strncmp( resolved, pNativeDir, dirLength ) ) ||
+        ( '/' != resolved[ dirLength ] ) )
+    {
+        fprintf( stderr,
+                 "%s: %s is not in %s\n",
+                 __func__,
+                 resolved,
+                 pNativeDir );
+        return EPERM;
+    }
+
+    /* a shared object still mapped would be returned instead of the file */
+    pHandle = dlopen( resolved, RTLD_NOW | RTLD_NOLOAD );
+    if( NULL != pHandle )
+    {
+        dlclose( pHandle );
+        fprintf( stderr, "%s: %s is loaded already\n", __func__, resolved );
+        return EBUSY;
+    }
+
+    pHandle = dlopen( resolved, RTLD_NOW | RTLD_LOCAL );
+    if( NULL == pHandle )
+    {
+        fprintf( stderr, "%s: %s\n", __func__, dlerror() );
+        return ENOENT;
+    }
+
+    pNative = (const tzPolicyNative *)dlsym( pHandle, POLICY_NATIVE_SYMBOL );
+    if( ( NULL == pNative ) ||
+        ( POLICY_NATIVE_ABI != pNative->abi ) ||
+        ( NULL == pNative->pInit ) ||
+        ( NULL == pNative->pFini ) ||
+        ( NULL == pNative->pDecide ) )
+    {
+        fprintf( stderr, "%s: %s is not a native rule set\n", __func__, pPath );
+        ret = EINVAL;
+    }
+    else
+    {
+        ret = pNative->pInit( &host );
+        if( EOK != ret )
+        {
+            pNative->pFini( );
+        }
+    }
+
+    if( EOK != ret )
+    {
+        dlclose( pHandle );
+        return ret;
+    }
+
+    /* the rule set is ready, publish it */
+    policynative_fnSwap( pNative, pHandle );
+
+    printf( "%s: %d native rules from %s\n",
+            __func__,
+            pNative->numRules,
+            pPath );
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Stop using the active native rule set
+
+    Called when a new rule set is committed, the native code then no
+    longer matches the rules of the server.  Its shared object is closed
+    once the checks running in it are done.
+
+*/
+/*============================================================================*/
+void POLICYNATIVE_fnUnload( void )
+{
+    policynative_fnSwap( NULL, NULL );
+}
+
+/*============================================================================*/
+/*!
+
+    Make a rule set the active one and close the shared object of the
+    rule set it replaces
+
+    The loads and unloads are serialized by the policy write lock.
+
+@param[in]
+    pNative
+        the new active rule set, NULL for none
+
+@param[in]
+    pHandle
+        shared object of the new rule set, NULL for none
+
+*/
+/*============================================================================*/
+static void policynative_fnSwap( const tzPolicyNative *pNative,
+                                 void *pHandle )
+{
+    const tzPolicyNative *pOld;
+    void *pOldHandle;
+
+    /* waits for the checks running in the old rule set */
+    pthread_rwlock_wrlock( &nativeLock );
+
+    pOld = pActive;
+    pOldHandle = pActiveHandle;
+    pActiveHandle = pHandle;
+    __atomic_store_n( &pActive, pNative, __ATOMIC_RELEASE );
+
+    pthread_rwlock_unlock( &nativeLock );
+
+    /* no check can reach the old rule set anymore */
+    if( NULL != pOldHandle )
+    {
+        pOld->pFini( );
+        dlclose( pOldHandle );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Test if a native rule set is active
+
+@return
+    true if the native rule set decides the checks
+
+*/
+/*============================================================================*/
+bool POLICYNATIVE_fnIsLoaded( void )
+{
+    return ( NULL != __atomic_load_n( &pActive, __ATOMIC_ACQUIRE ) );
+}
+
+/*============================================================================*/
+/*!
+
+    Decide on a data point using the native rule set
+
+    Falls back to the decision diagram while no native rule set is active.
+
+@param[in]
+    pDp
+        data point structure
+
+@param[in]
+    typeInt
+        category type of the data point
+
+@param[in]
+    location
+        location of the data point, it is converted to lower case
+
+@param[in]
+    pUsers
+        subjects of the user tags of the data point
+
+@param[in]
+    pGroups
+        subjects of the group tags of the data point
+
+@retval EOK - if the policy check passed
+@retval EACCES - if the policy did not pass
+
+*/
+/*============================================================================*/
+int POLICYNATIVE_fnDecide( struct dp_t *pDp,
+                           int typeInt,
+                           char *location,
+                           const tzSubjectIds *pUsers,
+                           const tzSubjectIds *pGroups )
+{
+    const tzPolicyNative *pNative;
+    tzPolicyNativeQuery query;
+    const unsigned char *p;
+    int ret;
+
+    /* no policy for the type yet, assume wild card */
+    if( POLICY_TYPE_INVALID == typeInt )
+    {
+        return EOK;
+    }
+
+    query.pDp = pDp;
+    query.typeInt = typeInt;
+    query.location = strlwr( location );
+    query.dpTime = pDp->dpdata.timestamp.tv_sec;
+    query.pUsers = pUsers;
+    query.pGroups = pGroups;
+
+    query.locationHash = POLICY_NATIVE_FNV_BASIS;
+    for( p = (const unsigned char *)location; '\0' != *p; p++ )
+    {
+        query.locationHash = ( query.locationHash ^ *p ) *
+                             POLICY_NATIVE_FNV_PRIME;
+    }
+
+    /* the shared object is not closed while the lock is held */
+    pthread_rwlock_rdlock( &nativeLock );
+
+    pNative = __atomic_load_n( &pActive, __ATOMIC_ACQUIRE );
+    if( NULL != pNative )
+    {
+        ret = pNative->pDecide( &query );
+    }
+
+    pthread_rwlock_unlock( &nativeLock );
+
+    if( NULL == pNative )
+    {
+        ret = POLICYDD_fnDecide( pDp, typeInt, location, pUsers, pGroups );
+    }
+
+    return ret;
+}
+
+/*!
+ * @} // policynative
+ */
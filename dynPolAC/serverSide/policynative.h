@@ -0,0 +1,162 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef POLICYNATIVE_H_
+#define POLICYNATIVE_H_
+
+/*!
+ * @file policynative.h
+ * @brief Public APIs for the natively compiled policy rule sets
+ *
+ * The policynative.h file contains the public APIs and the interface
+ * between the server and a policy rule set compiled to native code.
+ *
+ * @defgroup policynative Native Policy Rule Sets
+ * @brief Policy rule sets compiled ahead of time
+ *
+ * "defdp -g" emits C code for a policy file, with a switch over the rule
+ * types and the location hashes and the rule checks inlined.  The code is
+ * built into a shared object which exports a tzPolicyNative structure
+ * named POLICY_NATIVE_SYMBOL.  The server loads the shared object on
+ * request and swaps it in atomically.  Only the shared objects of the
+ * directory given to POLICYNATIVE_fnSetDirectory are loaded, a server
+ * without one loads none.
+ *
+ * The native rule set only decides while it is the rule set committed to
+ * the server, the next policy commit unloads it and the checks fall back
+ * to the decision diagram until a new native rule set is loaded.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "dp.h"
+#include "policyprog.h"
+#include "subject.h"
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! version of the interface between the server and the native code */
+#define POLICY_NATIVE_ABI       ( 3 )
+
+/*! name of the tzPolicyNative structure exported by the shared object */
+#define POLICY_NATIVE_SYMBOL    "policy_native"
+
+/*! FNV-1a offset basis of the location hash */
+#define POLICY_NATIVE_FNV_BASIS ( 2166136261u )
+
+/*! FNV-1a prime of the location hash */
+#define POLICY_NATIVE_FNV_PRIME ( 16777619u )
+
+/*=============================================================================
+                              Structures
+==============================================================================*/
+
+/*! policy check query passed to the native code */
+typedef struct zPolicyNativeQuery
+{
+    /*! data point structure, for the range checks and the rule conditions */
+    struct dp_t *pDp;
+
+    /*! category type of the data point */
+    int typeInt;
+
+    /*! lower case location of the data point */
+    const char *location;
+
+    /*! FNV-1a hash of the location */
+    uint32_t locationHash;
+
+    /*! time stamp of the data point in seconds */
+    time_t dpTime;
+
+    /*! subjects of the user tags of the data point */
+    const tzSubjectIds *pUsers;
+
+    /*! subjects of the group tags of the data point */
+    const tzSubjectIds *pGroups;
+
+} tzPolicyNativeQuery;
+
+/*! server services used by the native code */
+typedef struct zPolicyNativeHost
+{
+    /*! intern a comma separated subject list, see SUBJECT_fnInternSet */
+    int (*pInternSet)( teSubjectKind kind,
+                       const char *pList,
+                       tzSubjectSet *pSet );
+
+    /*! release a subject set, see SUBJECT_fnFreeSet */
+    void (*pFreeSet)( tzSubjectSet *pSet );
+
+    /*! load a rule condition, see POLICYVM_fnLoad */
+    tzPolicyProgram* (*pLoadProgram)( const tzPolicyProgram *pWire );
+
+    /*! release a rule condition, see POLICYVM_fnFree */
+    void (*pFreeProgram)( tzPolicyProgram *pProgram );
+
+    /*! run a rule condition, see POLICYVM_fnRun */
+    bool (*pRunProgram)( const tzPolicyProgram *pProgram,
+                         struct dp_t *pDp,
+                         const tzSubjectIds *pUsers,
+                         const tzSubjectIds *pGroups );
+
+    /*! range check of the data point types not inlined, e.g. the arrays,
+     *  see COMPARATOR_fnInRange */
+    bool (*pInRange)( const struct dp_t *pDp, int min, int max );
+
+} tzPolicyNativeHost;
+
+/*! native rule set exported by the shared object */
+typedef struct zPolicyNative
+{
+    /*! POLICY_NATIVE_ABI the code was generated for */
+    uint32_t abi;
+
+    /*! number of rules compiled in */
+    int numRules;
+
+    /*! intern the rule subjects and load the rule conditions, EOK or an
+     *  errno.h code */
+    int (*pInit)( const tzPolicyNativeHost *pHost );
+
+    /*! release the rule subjects and conditions, also after a failed
+     *  pInit */
+    void (*pFini)( void );
+
+    /*! decide on a query, EOK to permit or EACCES */
+    int (*pDecide)( const tzPolicyNativeQuery *pQuery );
+
+} tzPolicyNative;
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int POLICYNATIVE_fnSetDirectory( const char *pDir );
+int POLICYNATIVE_fnLoad( const char *pPath );
+void POLICYNATIVE_fnUnload( void );
+bool POLICYNATIVE_fnIsLoaded( void );
+int POLICYNATIVE_fnDecide( struct dp_t *pDp,
+                           int typeInt,
+                           char *location,
+                           const tzSubjectIds *pUsers,
+                           const tzSubjectIds *pGroups );
+
+/*! @} */
+
+#endif /* POLICYNATIVE_H_ */
@@ -0,0 +1,315 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup policyserve
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  policyserve.c
+
+ @brief
+    Policy check ring server
+
+    A client which needs a high rate of policy checks creates a ring in a
+    shared memory object and asks the server to attach it.  The server maps
+    the ring and starts a thread which serves its checks, so a check costs
+    two cache line transfers instead of a message pass while the ring is
+    busy.  See policyring.h for the slot protocol.
+
+    The ring is written by the client, every request is copied out of the
+    ring and its strings are terminated before it is decided.
+
+    A client which dies without closing its ring never stops it, so the
+    serving thread checks the client process each time it slept
+    POLICY_RING_LIVENESS_MS, and exits once the process is gone.
+
+ */
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "policy.h"
+#include "policyserve.h"
+#include "subject.h"
+
+/*=============================================================================
+ 	 	 	 	 	 	 	 	 Structures
+ =============================================================================*/
+
+/*! ring attached to the server */
+typedef struct zPolicyServeRing
+{
+    /*! mapping of the ring */
+    tzPolicyRing *pRing;
+
+    /*! size of the mapping */
+    size_t size;
+
+    /*! process of the client, read when the ring was attached */
+    pid_t clientPid;
+
+} tzPolicyServeRing;
+
+/*==============================================================================
+ 	 	 	 	 	 Local/Private Function Prototypes
+==============================================================================*/
+
+static void *policyserve_fnThread( void *arg );
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+    Attach a policy check ring created by a client
+
+    The shared memory object is mapped and a thread is started to serve
+    the checks of the ring.
+
+@param[in]
+    pName
+        name of the shared memory object holding the ring
+
+@return
+    EOK on success, EINVAL if the object is not a ring, or any other
+    error code from errno.h
+
+*/
+/*============================================================================*/
+int POLICYSERVE_fnAttach( const char *pName )
+{
+    tzPolicyServeRing *pServe;
+    tzPolicyRing *pRing;
+    struct stat st;
+    pthread_attr_t attr;
+    pthread_t thread;
+    uint32_t numSlots;
+    int fd;
+    int ret = EOK;
+
+    if( ( NULL == pName ) ||
+        ( NULL == memchr( pName, '\0', POLICY_RING_NAME_LENGTH ) ) )
+    {
+        return EINVAL;
+    }
+
+    fd = shm_open( pName, O_RDWR, 0 );
+    if( -1 == fd )
+    {
+        return errno;
+    }
+
+    if( ( -1 == fstat( fd, &st ) ) ||
+        ( (size_t)st.st_size < sizeof(tzPolicyRing) ) )
+    {
+        close( fd );
+        return EINVAL;
+    }
+
+    pRing = mmap( NULL,
+                  (size_t)st.st_size,
+                  PROT_READ | PROT_WRITE,
+                  MAP_SHARED,
+                  fd,
+                  0 );
+    close( fd );
+    if( MAP_FAILED == pRing )
+    {
+        return errno;
+    }
+
+    /* the slots must fill the object exactly */
+    numSlots = pRing->numSlots;
+    if( ( POLICY_RING_MAGIC != pRing->magic ) ||
+        ( pRing->clientPid <= 0 ) ||
+        ( numSlots < 4u ) ||
+        ( 0u != ( numSlots & ( numSlots - 1u ) ) ) ||
+        ( POLICYRING_fnSize( numSlots ) != (size_t)st.st_size ) )
+    {
+        munmap( pRing, (size_t)st.st_size );
+        return EINVAL;
+    }
+
+    pServe = calloc( 1, sizeof(tzPolicyServeRing) );
+    if( NULL == pServe )
+    {
+        munmap( pRing, (size_t)st.st_size );
+        return ENOMEM;
+    }
+
+    pServe->pRing = pRing;
+    pServe->size = (size_t)st.st_size;
+    pServe->clientPid = (pid_t)pRing->clientPid;
+
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    ret = pthread_create( &thread, &attr, policyserve_fnThread, pServe );
+    pthread_attr_destroy( &attr );
+
+    if( EOK != ret )
+    {
+        munmap( pRing, pServe->size );
+        free( pServe );
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Decide a policy check request
+
+@param[in]
+    pRequest
+        check request, its strings are terminated by the function
+
+@retval EOK - if the policy check passed
+@retval EACCES - if the policy did not pass
+@retval EINVAL - if the value type cannot be checked from a request
+
+*/
+/*============================================================================*/
+int POLICYSERVE_fnCheck( tzPolicyCheckRequest *pRequest )
+{
+    struct dp_t dp;
+    char location[ MAX_LOCATION_STRING_LENGTH ] = "\0";
+    tzSubjectIds users;
+    tzSubjectIds groups;
+
+    if( NULL == pRequest )
+    {
+        return EINVAL;
+    }
+
+    memset( &dp, 0, sizeof(dp) );
+    dp.dpdata.type = pRequest->dpType;
+    dp.dpdata.timestamp.tv_sec = (time_t)pRequest->timestamp;
+
+    switch( pRequest->dpType )
+    {
+    case DP_TYPE_UINT16:
+        dp.dpdata.val.uiVal = pRequest->val.uiVal;
+        break;
+    case DP_TYPE_SINT16:
+        dp.dpdata.val.siVal = pRequest->val.siVal;
+        break;
+    case DP_TYPE_UINT32:
+        dp.dpdata.val.ulVal = pRequest->val.ulVal;
+        break;
+    case DP_TYPE_SINT32:
+        dp.dpdata.val.slVal = pRequest->val.slVal;
+        break;
+    case DP_TYPE_FLOAT32:
+        dp.dpdata.val.fVal = pRequest->val.fVal;
+        break;
+    case DP_TYPE_STR:
+        /* only the accessor rules check the string data points */
+        break;
+    default:
+        /* the array values do not fit in a request */
+        return EINVAL;
+    }
+
+    pRequest->location[ POLICY_RING_LOCATION_LENGTH - 1 ] = '\0';
+    pRequest->user[ POLICY_RING_SUBJECT_LENGTH - 1 ] = '\0';
+    pRequest->group[ POLICY_RING_SUBJECT_LENGTH - 1 ] = '\0';
+
+    /* the check may lower case its own copy of the location */
+    strncpy( location, pRequest->location, sizeof(location) - 1 );
+
+    /* a subject no rule names is left out, like a data point without
+     * user or group tags */
+    users.count = 0;
+    groups.count = 0;
+    SUBJECT_fnLookup( eSubjectUser, pRequest->user, &users );
+    SUBJECT_fnLookup( eSubjectGroup, pRequest->group, &groups );
+
+    return POLICY_fnDecide( &dp,
+                            pRequest->type,
+                            location,
+                            &users,
+                            &groups );
+}
+
+/*============================================================================*/
+/*!
+    Serve the checks of a ring until the client closes it or dies
+
+@param[in]
+    arg
+        the tzPolicyServeRing of the ring
+
+@return
+    NULL
+
+*/
+/*============================================================================*/
+static void *policyserve_fnThread( void *arg )
+{
+    tzPolicyServeRing *pServe = (tzPolicyServeRing *)arg;
+    tzPolicyRing *pRing = pServe->pRing;
+    tzPolicyRingSlot *pSlot;
+    tzPolicyCheckRequest request;
+    uint32_t mask = pRing->numSlots - 1u;
+    uint32_t tail = 0u;
+    int status;
+
+    for( ;; )
+    {
+        pSlot = &pRing->slots[ tail & mask ];
+
+        if( false == POLICYRING_fnWait( pRing,
+                                        &pSlot->seq,
+                                        tail + 1u,
+                                        &pRing->requestCond,
+                                        &pRing->serverSpin,
+                                        &pRing->serverSleepers,
+                                        pServe->clientPid ) )
+        {
+            /* the client closed the ring or died */
+            break;
+        }
+
+        memcpy( &request, &pSlot->request, sizeof(request) );
+        status = POLICYSERVE_fnCheck( &request );
+
+        pSlot->status = status;
+        POLICYRING_fnPost( pRing,
+                           &pSlot->seq,
+                           tail + 2u,
+                           &pRing->responseCond,
+                           &pRing->clientSleepers );
+
+        tail++;
+        __atomic_store_n( &pRing->tail, tail, __ATOMIC_RELAXED );
+    }
+
+    munmap( pRing, pServe->size );
+    free( pServe );
+
+    return NULL;
+}
+
+/*! @} */
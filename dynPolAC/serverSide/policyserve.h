@@ -0,0 +1,46 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef POLICYSERVE_H_
+#define POLICYSERVE_H_
+
+/*!
+ * @file policyserve.h
+ * @brief Public APIs of the policy check ring server
+ *
+ * The policyserve.h file contains the public APIs the server uses to
+ * serve the policy checks posted by the clients, on a shared memory ring
+ * (see policyring.h) or in a POLICY_HOUSEKEEP_CHECK message.
+ *
+ * @defgroup policyserve Policy Check Ring Server
+ * @brief Server side of the shared memory policy check transport
+ *
+ * Every attached ring is served by its own thread, which waits for the
+ * requests of the ring and decides them with POLICY_fnDecide.  The thread
+ * exits and unmaps the ring when the client closes it.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include "policyring.h"
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int POLICYSERVE_fnAttach( const char *pName );
+int POLICYSERVE_fnCheck( tzPolicyCheckRequest *pRequest );
+
+/*! @} */
+
+#endif /* POLICYSERVE_H_ */
@@ -0,0 +1,714 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup policyvm
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  policyvm.c
+
+ @brief
+    Policy condition interpreter
+
+ @details
+    This module loads and runs the condition programs of the policy rules.
+    Loading checks every instruction against the program limits, so running
+    a loaded program needs no checks, and interns the subject name lists of
+    the user and group tests into the subject sets kept after the program.
+
+    The previous value of every data point checked by a program using the
+    value delta is kept in a hash table keyed by the data point.
+
+*/
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "cfuhash.h"
+#include "minicloud.h"
+#include "policyvm.h"
+#include "subject.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Defines
+==============================================================================*/
+
+/*! an estimate for the number of data points checked with a delta */
+#define ESTIMATED_NUM_DELTA_DPS    ( 1000 )
+
+/*=============================================================================
+ 	 	 	 	 	 	 	 	 Structures
+ =============================================================================*/
+
+/*! condition program as loaded by the server */
+typedef struct zPolicyVMProgram
+{
+    /*! the program, first so the rules keep it as a tzPolicyProgram.  A
+     *  user or group test refers to a constant holding the offset of its
+     *  name list */
+    tzPolicyProgram program;
+
+    /*! subject set of the user or group test using the constant of the
+     *  same index */
+    tzSubjectSet sets[ POLICY_PROGRAM_MAX_CONST ];
+
+} tzPolicyVMProgram;
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Variables
+ =============================================================================*/
+
+/*! hash table of the previous values of the data points */
+static cfuhash_table_t *previous = NULL;
+
+/*! lock of the previous values, a delta reads and replaces the value */
+static pthread_mutex_t previousLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*==============================================================================
+ Local/Private Function Prototypes
+ =============================================================================*/
+
+static bool policyvm_fnTrackDeltas( void );
+static bool policyvm_fnInternSet( tzPolicyVMProgram *pVM,
+                                  uint32_t op,
+                                  uint32_t k );
+static double policyvm_fnValue( struct dp_t *pDp );
+static double policyvm_fnDelta( struct dp_t *pDp, double value );
+
+/*==============================================================================
+ Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Validate a condition program received with a policy rule
+
+    The program must end with a return, and every register, constant and
+    name list referred to by its instructions must exist.
+
+@param[in]
+    pWire
+        program as received in the policy message
+
+@return
+    a new program ready to run, or NULL if the program is invalid
+
+*/
+/*============================================================================*/
+tzPolicyProgram* POLICYVM_fnLoad( const tzPolicyProgram *pWire )
+{
+    tzPolicyVMProgram *pVM = NULL;
+    tzPolicyProgram *pProgram = NULL;
+    uint32_t insn;
+    uint32_t op;
+    uint32_t imm;
+    int i;
+    bool valid = true;
+
+    if( ( NULL == pWire ) ||
+        ( POLICY_PROGRAM_MAGIC != pWire->magic ) ||
+        ( 0 == pWire->numCode ) ||
+        ( pWire->numCode > POLICY_PROGRAM_MAX_CODE ) ||
+        ( pWire->numConst > POLICY_PROGRAM_MAX_CONST ) )
+    {
+        return NULL;
+    }
+
+    pVM = calloc( 1, sizeof(tzPolicyVMProgram) );
+    if( NULL == pVM )
+    {
+        return NULL;
+    }
+
+    pProgram = &pVM->program;
+    memcpy( pProgram, pWire, sizeof(tzPolicyProgram) );
+    pProgram->names[ POLICY_PROGRAM_NAMES_LENGTH - 1 ] = '\0';
+    pProgram->flags = 0u;
+
+    for( i = 0; ( true == valid ) && ( i < pProgram->numCode ); i++ )
+    {
+        insn = pProgram->code[i];
+        op = POLICY_INSN_OP( insn );
+        imm = POLICY_INSN_IMM16( insn );
+
+        if( ( op >= POLICY_OP_COUNT ) ||
+            ( POLICY_INSN_A( insn ) >= POLICY_PROGRAM_REGISTERS ) )
+        {
+            valid = false;
+            continue;
+        }
+
+        switch( op )
+        {
+        case POLICY_OP_RET:
+        case POLICY_OP_LDVAL:
+        case POLICY_OP_LDAGE:
+            break;
+
+        case POLICY_OP_LDDELTA:
+            pProgram->flags |= POLICY_PROGRAM_FLAG_DELTA;
+            break;
+
+        case POLICY_OP_LDK:
+            valid = ( imm < pProgram->numConst );
+            break;
+
+        case POLICY_OP_NOT:
+            valid = ( POLICY_INSN_B( insn ) < POLICY_PROGRAM_REGISTERS );
+            break;
+
+        case POLICY_OP_INUSER:
+        case POLICY_OP_INGROUP:
+            /* move the name list offset to a new constant and intern
+             * the list into the set of the constant */
+            if( ( imm >= POLICY_PROGRAM_NAMES_LENGTH ) ||
+                ( pProgram->numConst >= POLICY_PROGRAM_MAX_CONST ) )
+            {
+                valid = false;
+            }
+            else
+            {
+                pProgram->konst[ pProgram->numConst ] = (double)imm;
+                pProgram->code[i] = POLICY_INSN_IMM( op,
+                                                     POLICY_INSN_A( insn ),
+                                                     pProgram->numConst );
+                pProgram->numConst++;
+                valid = policyvm_fnInternSet( pVM,
+                                              op,
+                                              pProgram->numConst - 1u );
+            }
+            break;
+
+        default:
+            /* three register instructions */
+            valid = ( POLICY_INSN_B( insn ) < POLICY_PROGRAM_REGISTERS ) &&
+                    ( POLICY_INSN_C( insn ) < POLICY_PROGRAM_REGISTERS );
+            break;
+        }
+    }
+
+    /* a program always ends with a return */
+    if( ( true == valid ) &&
+        ( POLICY_OP_RET !=
+          POLICY_INSN_OP( pProgram->code[ pProgram->numCode - 1 ] ) ) )
+    {
+        valid = false;
+    }
+
+    if( ( true == valid ) &&
+        ( 0u != ( pProgram->flags & POLICY_PROGRAM_FLAG_DELTA ) ) )
+    {
+        valid = policyvm_fnTrackDeltas();
+    }
+
+    if( false == valid )
+    {
+        fprintf( stderr, "%s: invalid policy condition program\n", __func__ );
+        POLICYVM_fnFree( pProgram );
+        pProgram = NULL;
+    }
+
+    return pProgram;
+}
+
+/*============================================================================*/
+/*!
+
+    Copy a condition program saved from a loaded rule
+
+    The user and group tests of a loaded program refer to constants
+    holding the offsets of their name lists, it is not loaded again.  The
+    saved program is checked the way POLICYVM_fnLoad checks a program and
+    its name lists are interned again.
+
+@param[in]
+    pSaved
+        program of a rule as kept by the server
+
+@return
+    a new program ready to run, or NULL if the program is invalid
+
+*/
+/*============================================================================*/
+tzPolicyProgram* POLICYVM_fnRestore( const tzPolicyProgram *pSaved )
+{
+    tzPolicyVMProgram *pVM = NULL;
+    tzPolicyProgram *pProgram = NULL;
+    bool interned[ POLICY_PROGRAM_MAX_CONST ] = { false };
+    uint32_t insn;
+    uint32_t op;
+    uint32_t k;
+    int i;
+    bool valid = true;
+
+    if( ( NULL == pSaved ) ||
+        ( POLICY_PROGRAM_MAGIC != pSaved->magic ) ||
+        ( 0 == pSaved->numCode ) ||
+        ( pSaved->numCode > POLICY_PROGRAM_MAX_CODE ) ||
+        ( pSaved->numConst > POLICY_PROGRAM_MAX_CONST ) )
+    {
+        return NULL;
+    }
+
+    pVM = calloc( 1, sizeof(tzPolicyVMProgram) );
+    if( NULL == pVM )
+    {
+        return NULL;
+    }
+
+    pProgram = &pVM->program;
+    memcpy( pProgram, pSaved, sizeof(tzPolicyProgram) );
+    pProgram->names[ POLICY_PROGRAM_NAMES_LENGTH - 1 ] = '\0';
+    pProgram->flags = 0u;
+
+    for( i = 0; ( true == valid ) && ( i < pProgram->numCode ); i++ )
+    {
+        insn = pProgram->code[i];
+        op = POLICY_INSN_OP( insn );
+
+        if( ( op >= POLICY_OP_COUNT ) ||
+            ( POLICY_INSN_A( insn ) >= POLICY_PROGRAM_REGISTERS ) )
+        {
+            valid = false;
+            continue;
+        }
+
+        switch( op )
+        {
+        case POLICY_OP_RET:
+        case POLICY_OP_LDVAL:
+        case POLICY_OP_LDAGE:
+            break;
+
+        case POLICY_OP_LDDELTA:
+            pProgram->flags |= POLICY_PROGRAM_FLAG_DELTA;
+            break;
+
+        case POLICY_OP_LDK:
+            valid = ( POLICY_INSN_IMM16( insn ) < pProgram->numConst );
+            break;
+
+        case POLICY_OP_INUSER:
+        case POLICY_OP_INGROUP:
+            k = POLICY_INSN_IMM16( insn );
+            if( k >= pProgram->numConst )
+            {
+                valid = false;
+            }
+            else if( false == interned[k] )
+            {
+                interned[k] = true;
+                valid = policyvm_fnInternSet( pVM, op, k );
+            }
+            break;
+
+        case POLICY_OP_NOT:
+            valid = ( POLICY_INSN_B( insn ) < POLICY_PROGRAM_REGISTERS );
+            break;
+
+        default:
+            valid = ( POLICY_INSN_B( insn ) < POLICY_PROGRAM_REGISTERS ) &&
+                    ( POLICY_INSN_C( insn ) < POLICY_PROGRAM_REGISTERS );
+            break;
+        }
+    }
+
+    if( ( true == valid ) &&
+        ( POLICY_OP_RET !=
+          POLICY_INSN_OP( pProgram->code[ pProgram->numCode - 1 ] ) ) )
+    {
+        valid = false;
+    }
+
+    if( ( true == valid ) &&
+        ( 0u != ( pProgram->flags & POLICY_PROGRAM_FLAG_DELTA ) ) )
+    {
+        valid = policyvm_fnTrackDeltas();
+    }
+
+    if( false == valid )
+    {
+        fprintf( stderr, "%s: invalid policy condition program\n", __func__ );
+        POLICYVM_fnFree( pProgram );
+        pProgram = NULL;
+    }
+
+    return pProgram;
+}
+
+/*============================================================================*/
+/*!
+
+    Release a program returned by POLICYVM_fnLoad or POLICYVM_fnRestore
+
+@param[in]
+    pProgram
+        the program, may be NULL
+
+*/
+/*============================================================================*/
+void POLICYVM_fnFree( tzPolicyProgram *pProgram )
+{
+    tzPolicyVMProgram *pVM = (tzPolicyVMProgram *)pProgram;
+    int k;
+
+    if( NULL != pVM )
+    {
+        for( k = 0; k < POLICY_PROGRAM_MAX_CONST; k++ )
+        {
+            SUBJECT_fnFreeSet( &pVM->sets[k] );
+        }
+        free( pVM );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Run the condition program of a rule on a data point
+
+    A value which is not a number (strings, arrays) makes every comparison
+    with it false.
+
+@param[in]
+    pProgram
+        program returned by POLICYVM_fnLoad
+
+@param[in]
+    pDp
+        data point structure
+
+@param[in]
+    pUsers
+        subjects of the user tags of the data point
+
+@param[in]
+    pGroups
+        subjects of the group tags of the data point
+
+@return
+    true if the condition holds, otherwise false
+
+*/
+/*============================================================================*/
+bool POLICYVM_fnRun( const tzPolicyProgram *pProgram,
+                     struct dp_t *pDp,
+                     const tzSubjectIds *pUsers,
+                     const tzSubjectIds *pGroups )
+{
+    const tzPolicyVMProgram *pVM = (const tzPolicyVMProgram *)pProgram;
+    double R[ POLICY_PROGRAM_REGISTERS ] = { 0.0 };
+    double value;
+    struct timespec now;
+    const uint32_t *pc = pProgram->code;
+    const uint32_t *end = pProgram->code + pProgram->numCode;
+    uint32_t insn;
+
+    value = policyvm_fnValue( pDp );
+
+    while( pc < end )
+    {
+        insn = *pc++;
+
+        switch( POLICY_INSN_OP( insn ) )
+        {
+        case POLICY_OP_RET:
+            return ( 0.0 != R[ POLICY_INSN_A( insn ) ] );
+
+        case POLICY_OP_LDK:
+            R[ POLICY_INSN_A( insn ) ] =
+                    pProgram->konst[ POLICY_INSN_IMM16( insn ) ];
+            break;
+
+        case POLICY_OP_LDVAL:
+            R[ POLICY_INSN_A( insn ) ] = value;
+            break;
+
+        case POLICY_OP_LDAGE:
+            clock_gettime( CLOCK_REALTIME, &now );
+            R[ POLICY_INSN_A( insn ) ] =
+                    (double)( now.tv_sec - pDp->dpdata.timestamp.tv_sec ) +
+                    (double)( now.tv_nsec - pDp->dpdata.timestamp.tv_nsec )
+                    / 1e9;
+            break;
+
+        case POLICY_OP_LDDELTA:
+            R[ POLICY_INSN_A( insn ) ] = policyvm_fnDelta( pDp, value );
+            break;
+
+        case POLICY_OP_LT:
+            R[ POLICY_INSN_A( insn ) ] =
+                    R[ POLICY_INSN_B( insn ) ] < R[ POLICY_INSN_C( insn ) ];
+            break;
+
+        case POLICY_OP_LE:
+            R[ POLICY_INSN_A( insn ) ] =
+                    R[ POLICY_INSN_B( insn ) ] <= R[ POLICY_INSN_C( insn ) ];
+            break;
+
+        case POLICY_OP_GT:
+            R[ POLICY_INSN_A( insn ) ] =
+                    R[ POLICY_INSN_B( insn ) ] > R[ POLICY_INSN_C( insn ) ];
+            break;
+
+        case POLICY_OP_GE:
+            R[ POLICY_INSN_A( insn ) ] =
+                    R[ POLICY_INSN_B( insn ) ] >= R[ POLICY_INSN_C( insn ) ];
+            break;
+
+        case POLICY_OP_EQ:
+            R[ POLICY_INSN_A( insn ) ] =
+                    R[ POLICY_INSN_B( insn ) ] == R[ POLICY_INSN_C( insn ) ];
+            break;
+
+        case POLICY_OP_NE:
+            /* false when either side is not a number, like the others */
+            R[ POLICY_INSN_A( insn ) ] =
+                    ( R[ POLICY_INSN_B( insn ) ] < R[ POLICY_INSN_C( insn ) ] ) ||
+                    ( R[ POLICY_INSN_B( insn ) ] > R[ POLICY_INSN_C( insn ) ] );
+            break;
+
+        case POLICY_OP_AND:
+            R[ POLICY_INSN_A( insn ) ] =
+                    ( 0.0 != R[ POLICY_INSN_B( insn ) ] ) &&
+                    ( 0.0 != R[ POLICY_INSN_C( insn ) ] );
+            break;
+
+        case POLICY_OP_OR:
+            R[ POLICY_INSN_A( insn ) ] =
+                    ( 0.0 != R[ POLICY_INSN_B( insn ) ] ) ||
+                    ( 0.0 != R[ POLICY_INSN_C( insn ) ] );
+            break;
+
+        case POLICY_OP_NOT:
+            R[ POLICY_INSN_A( insn ) ] = ( 0.0 == R[ POLICY_INSN_B( insn ) ] );
+            break;
+
+        case POLICY_OP_INUSER:
+            R[ POLICY_INSN_A( insn ) ] = SUBJECT_MATCH(
+                    &pVM->sets[ POLICY_INSN_IMM16( insn ) ],
+                    pUsers );
+            break;
+
+        case POLICY_OP_INGROUP:
+            R[ POLICY_INSN_A( insn ) ] = SUBJECT_MATCH(
+                    &pVM->sets[ POLICY_INSN_IMM16( insn ) ],
+                    pGroups );
+            break;
+
+        default:
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/*============================================================================*/
+/*!
+
+    Intern the name list of a user or group test into the set of its
+    constant
+
+@param[in]
+    pVM
+        program being loaded
+
+@param[in]
+    op
+        POLICY_OP_INUSER or POLICY_OP_INGROUP
+
+@param[in]
+    k
+        constant of the test, it holds the offset of the name list
+
+@return
+    true if the list was interned, false if its offset is invalid or a
+    name of the list is refused
+
+*/
+/*============================================================================*/
+static bool policyvm_fnInternSet( tzPolicyVMProgram *pVM,
+                                  uint32_t op,
+                                  uint32_t k )
+{
+    double offset = pVM->program.konst[k];
+    teSubjectKind kind = ( POLICY_OP_INUSER == op ) ? eSubjectUser
+                                                    : eSubjectGroup;
+
+    /* a saved constant is checked like a name list immediate */
+    if( !( offset >= 0.0 ) ||
+        ( offset >= (double)POLICY_PROGRAM_NAMES_LENGTH ) ||
+        ( offset != (double)(uint32_t)offset ) )
+    {
+        return false;
+    }
+
+    return ( EOK == SUBJECT_fnInternSet( kind,
+                                         &pVM->program.names[ (int)offset ],
+                                         &pVM->sets[k] ) );
+}
+
+/*============================================================================*/
+/*!
+
+    Create the table of the previous values the first time a program uses
+    the change of a value
+
+@return
+    true if the table exists
+
+*/
+/*============================================================================*/
+static bool policyvm_fnTrackDeltas( void )
+{
+    bool ready;
+
+    pthread_mutex_lock( &previousLock );
+    if( NULL == previous )
+    {
+        previous = cfuhash_new_with_initial_size( ESTIMATED_NUM_DELTA_DPS );
+        if( NULL != previous )
+        {
+            cfuhash_set_flag( previous, CFUHASH_NO_LOCKING );
+        }
+    }
+    ready = ( NULL != previous );
+    pthread_mutex_unlock( &previousLock );
+
+    return ready;
+}
+
+/*============================================================================*/
+/*!
+
+    Return the value of a data point as a number
+
+@param[in]
+    pDp
+        data point structure
+
+@return
+    value of the data point, NAN if the data point is not a number
+
+*/
+/*============================================================================*/
+static double policyvm_fnValue( struct dp_t *pDp )
+{
+    double value = NAN;
+
+    switch( pDp->dpdata.type )
+    {
+    case DP_TYPE_UINT16:
+        value = (double)pDp->dpdata.val.uiVal;
+        break;
+
+    case DP_TYPE_SINT16:
+        value = (double)pDp->dpdata.val.siVal;
+        break;
+
+    case DP_TYPE_UINT32:
+        value = (double)pDp->dpdata.val.ulVal;
+        break;
+
+    case DP_TYPE_SINT32:
+        value = (double)pDp->dpdata.val.slVal;
+        break;
+
+    case DP_TYPE_FLOAT32:
+        value = (double)pDp->dpdata.val.fVal;
+        break;
+
+    default:
+        break;
+    }
+
+    return value;
+}
+
+/*============================================================================*/
+/*!
+
+    Return the change of a data point value since its previous check
+
+    The value becomes the previous value of the next check.  The first
+    check of a data point has no change.
+
+@param[in]
+    pDp
+        data point structure
+
+@param[in]
+    value
+        current value of the data point
+
+@return
+    value - previous value
+
+*/
+/*============================================================================*/
+static double policyvm_fnDelta( struct dp_t *pDp, double value )
+{
+    double *pPrevious = NULL;
+    size_t size = 0;
+    double delta = 0.0;
+
+    pthread_mutex_lock( &previousLock );
+
+    if( NULL == previous )
+    {
+        /* no program uses a delta */
+    }
+    else if( cfuhash_get_data( previous,
+                          &pDp,
+                          sizeof(pDp),
+                          (void **)&pPrevious,
+                          &size ) )
+    {
+        delta = value - *pPrevious;
+        *pPrevious = value;
+    }
+    else
+    {
+        pPrevious = malloc( sizeof(double) );
+        if( NULL != pPrevious )
+        {
+            *pPrevious = value;
+            cfuhash_put_data( previous,
+                              &pDp,
+                              sizeof(pDp),
+                              pPrevious,
+                              sizeof(double),
+                              NULL );
+        }
+    }
+
+    pthread_mutex_unlock( &previousLock );
+
+    return delta;
+}
+
+/*!
+ * @} // policyvm
+ */
@@ -0,0 +1,55 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef POLICYVM_H_
+#define POLICYVM_H_
+
+/*!
+ * @file policyvm.h
+ * @brief Public APIs for running the policy condition programs
+ *
+ * The policyvm.h file contains the public APIs for loading and running
+ * the condition programs of the policy rules.
+ *
+ * @defgroup policyvm Policy Condition Machine
+ * @brief Policy condition interpreter
+ *
+ * A rule condition arrives with the rule as a tzPolicyProgram.  It is
+ * validated and its subject lists are interned when the rule is created,
+ * it is run by the policy check once the other checks of the rule have
+ * passed, and released with POLICYVM_fnFree with the rule.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "dp.h"
+#include "policyprog.h"
+#include "subject.h"
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+tzPolicyProgram* POLICYVM_fnLoad( const tzPolicyProgram *pWire );
+tzPolicyProgram* POLICYVM_fnRestore( const tzPolicyProgram *pSaved );
+void POLICYVM_fnFree( tzPolicyProgram *pProgram );
+bool POLICYVM_fnRun( const tzPolicyProgram *pProgram,
+                     struct dp_t *pDp,
+                     const tzSubjectIds *pUsers,
+                     const tzSubjectIds *pGroups );
+
+/*! @} */
+
+#endif /* POLICYVM_H_ */
@@ -0,0 +1,913 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup snapshot
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  snapshot.c
+
+ @brief
+    Server snapshot and write-ahead log
+
+    The snapshot is mapped privately and every section is handed to its
+    module as a writable slice of the mapping, so a module decodes its
+    records where they are and copies only what it keeps.  The log entries
+    are replayed the same way from a mapping of the log.
+
+    A change holds the snapshot lock shared from SNAPSHOT_fnBegin to
+    SNAPSHOT_fnEnd, SNAPSHOT_fnSave holds it exclusively, so a snapshot
+    never misses a change whose log entry it drops.  The log entries are
+    numbered; a snapshot records the number of the last entry it contains
+    and the entries up to it are skipped if the log could not be emptied.
+
+    The log is written with one writev per entry and is not synchronised,
+    it survives a crash of the server, not a crash of the system.
+
+ */
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "policy.h"
+#include "policydelta.h"
+#include "dpbulk.h"
+#include "snapshot.h"
+
+/*=============================================================================
+ 	 	 	 	 	 	 	 	 Structures
+ =============================================================================*/
+
+/*! section of a module */
+typedef struct zSnapshotOwner
+{
+    /*! SNAPSHOT_SECTION_ identifier */
+    uint32_t id;
+
+    /*! writes the section */
+    tfnSnapshotSave pfnSave;
+
+    /*! restores the section */
+    tfnSnapshotLoad pfnLoad;
+
+    /*! argument of the functions */
+    void *pContext;
+
+} tzSnapshotOwner;
+
+/*! replay of a log entry type */
+typedef struct zSnapshotReplay
+{
+    /*! applies the entry again */
+    tfnSnapshotReplay pfnReplay;
+
+    /*! argument of the function */
+    void *pContext;
+
+} tzSnapshotReplay;
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Variables
+ =============================================================================*/
+
+/*! sections in the order they are saved */
+static tzSnapshotOwner owners[ SNAPSHOT_MAX_SECTIONS ];
+
+/*! number of sections */
+static int numOwners = 0;
+
+/*! replay of the log entries by type */
+static tzSnapshotReplay replays[ SNAPSHOT_MAX_LOG_TYPES ];
+
+/*! shared by the changes, held exclusively by a save */
+static pthread_rwlock_t snapshotLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/*! orders the log entries */
+static pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*! path of the snapshot, NULL until SNAPSHOT_fnOpen */
+static char *pSnapshotPath = NULL;
+
+/*! write-ahead log, -1 until SNAPSHOT_fnOpen */
+static int logFd = -1;
+
+/*! length of the valid entries of the log */
+static off_t logLength = 0;
+
+/*! sequence number of the last log entry */
+static uint64_t lastSequence = 0;
+
+/*! the log is being replayed, the changes are not logged again */
+static bool replaying = false;
+
+/*==============================================================================
+ 	 	 	 	 	 	 Local/Private Function Prototypes
+ =============================================================================*/
+
+static int snapshot_fnLoad( const char *pPath, uint64_t *pSequence );
+static int snapshot_fnReplayLog( const char *pLogPath, uint64_t sequence );
+static int snapshot_fnWrite( const char *pTmpPath );
+static int snapshot_fnPad( FILE *fp );
+static uint64_t snapshot_fnCheck( tzSnapshotLogEntry entry,
+                                  const void *pData );
+static int snapshot_fnReplayCreate( void *pData,
+                                    size_t length,
+                                    void *pContext );
+static int snapshot_fnReplayCommit( void *pData,
+                                    size_t length,
+                                    void *pContext );
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+    Register a section of the snapshot
+
+    Called when the server starts, before SNAPSHOT_fnOpen.  The policy
+    section is registered by SNAPSHOT_fnOpen.
+
+@param[in]
+    id
+        SNAPSHOT_SECTION_ identifier of the section
+
+@param[in]
+    pfnSave
+        function writing the section
+
+@param[in]
+    pfnLoad
+        function restoring the section
+
+@param[in]
+    pContext
+        argument of the functions
+
+@return
+    EOK : the section is saved by the next snapshot
+    EEXIST : the section is already registered
+    ENOSPC : there are SNAPSHOT_MAX_SECTIONS sections already
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int SNAPSHOT_fnAddSection( uint32_t id,
+                           tfnSnapshotSave pfnSave,
+                           tfnSnapshotLoad pfnLoad,
+                           void *pContext )
+{
+    int i;
+
+    if( ( 0u == id ) || ( NULL == pfnSave ) || ( NULL == pfnLoad ) )
+    {
+        return EINVAL;
+    }
+
+    for( i = 0; i < numOwners; i++ )
+    {
+        if( id == owners[i].id )
+        {
+            return EEXIST;
+        }
+    }
+
+    if( numOwners >= SNAPSHOT_MAX_SECTIONS )
+    {
+        return ENOSPC;
+    }
+
+    owners[ numOwners ].id = id;
+    owners[ numOwners ].pfnSave = pfnSave;
+    owners[ numOwners ].pfnLoad = pfnLoad;
+    owners[ numOwners ].pContext = pContext;
+    numOwners++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+    Attach the replay of a log entry type
+
+    Called when the server starts, before SNAPSHOT_fnOpen.  The policy and
+    bulk data point entries are attached by SNAPSHOT_fnOpen.
+
+@param[in]
+    type
+        SNAPSHOT_LOG_ type
+
+@param[in]
+    pfnReplay
+        function applying an entry of the type again
+
+@param[in]
+    pContext
+        argument of the function
+
+@return
+    EOK on success, EINVAL if the type is out of range
+
+*/
+/*============================================================================*/
+int SNAPSHOT_fnAttach( uint16_t type,
+                       tfnSnapshotReplay pfnReplay,
+                       void *pContext )
+{
+    if( type >= SNAPSHOT_MAX_LOG_TYPES )
+    {
+        return EINVAL;
+    }
+
+    replays[ type ].pfnReplay = pfnReplay;
+    replays[ type ].pContext = pContext;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+    Restore the server from its snapshot and its log, then log the changes
+
+    Called once when the server starts, after the sections and the log
+    entry types were registered and before the messages are received.  A
+    missing snapshot or log is an empty one.  A torn entry at the end of
+    the log is cut off, an entry which fails to replay is reported and
+    skipped like its message failed before the restart.
+
+@param[in]
+    pPath
+        path of the snapshot, the log is the same path with
+        SNAPSHOT_LOG_SUFFIX
+
+@return
+    EOK : the server was restored and logs its changes
+    EBADMSG : the snapshot is not a snapshot of this server
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int SNAPSHOT_fnOpen( const char *pPath )
+{
+    char *pLogPath;
+    uint64_t sequence = 0;
+    int ret;
+
+    if( ( NULL == pPath ) || ( '\0' == pPath[0] ) )
+    {
+        return EINVAL;
+    }
+
+    if( NULL != pSnapshotPath )
+    {
+        return EALREADY;
+    }
+
+    SNAPSHOT_fnAddSection( SNAPSHOT_SECTION_POLICY,
+                           POLICY_fnSnapshotSave,
+                           POLICY_fnSnapshotLoad,
+                           NULL );
+    SNAPSHOT_fnAttach( SNAPSHOT_LOG_POLICY_CREATE,
+                       snapshot_fnReplayCreate,
+                       NULL );
+    SNAPSHOT_fnAttach( SNAPSHOT_LOG_POLICY_COMMIT,
+                       snapshot_fnReplayCommit,
+                       NULL );
+    SNAPSHOT_fnAttach( SNAPSHOT_LOG_DP_BULK, DPBULK_fnReplay, NULL );
+
+    pLogPath = malloc( strlen( pPath ) + sizeof(SNAPSHOT_LOG_SUFFIX) );
+    pSnapshotPath = strdup( pPath );
+    if( ( NULL == pLogPath ) || ( NULL == pSnapshotPath ) )
+    {
+        free( pLogPath );
+        free( pSnapshotPath );
+        pSnapshotPath = NULL;
+        return ENOMEM;
+    }
+
+    strcpy( pLogPath, pPath );
+    strcat( pLogPath, SNAPSHOT_LOG_SUFFIX );
+
+    replaying = true;
+
+    ret = snapshot_fnLoad( pPath, &sequence );
+    if( EOK == ret )
+    {
+        ret = snapshot_fnReplayLog( pLogPath, sequence );
+    }
+
+    replaying = false;
+
+    if( EOK != ret )
+    {
+        fprintf( stderr,
+                 "%s: cannot restore %s: %s\n",
+                 __func__,
+                 pPath,
+                 strerror( ret ) );
+
+        if( -1 != logFd )
+        {
+            close( logFd );
+            logFd = -1;
+        }
+
+        free( pSnapshotPath );
+        pSnapshotPath = NULL;
+    }
+
+    free( pLogPath );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Save a snapshot of the server and empty the log
+
+    The changes in progress are finished first, the changes arriving
+    meanwhile wait for the snapshot.  The old snapshot is replaced only
+    once the new one is complete on disk.
+
+@return
+    EOK : the snapshot was saved
+    ENOTSUP : the server was not opened with a snapshot
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int SNAPSHOT_fnSave( void )
+{
+    char *pTmpPath;
+    int ret;
+
+    if( NULL == pSnapshotPath )
+    {
+        return ENOTSUP;
+    }
+
+    pTmpPath = malloc( strlen( pSnapshotPath ) + sizeof(".tmp") );
+    if( NULL == pTmpPath )
+    {
+        return ENOMEM;
+    }
+
+    strcpy( pTmpPath, pSnapshotPath );
+    strcat( pTmpPath, ".tmp" );
+
+    pthread_rwlock_wrlock( &snapshotLock );
+
+    ret = snapshot_fnWrite( pTmpPath );
+    if( ( EOK == ret ) && ( 0 != rename( pTmpPath, pSnapshotPath ) ) )
+    {
+        ret = errno;
+    }
+
+    if( EOK == ret )
+    {
+        /* a log which could not be emptied is skipped by its numbers */
+        if( 0 == ftruncate( logFd, 0 ) )
+        {
+            logLength = 0;
+        }
+    }
+    else
+    {
+        unlink( pTmpPath );
+    }
+
+    pthread_rwlock_unlock( &snapshotLock );
+
+    free( pTmpPath );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Log a change before it is applied
+
+    Every call is followed by SNAPSHOT_fnEnd once the change was applied,
+    whether the change could be logged or not.  Nothing is logged before
+    SNAPSHOT_fnOpen or while the log is replayed.
+
+@param[in]
+    type
+        SNAPSHOT_LOG_ type of the change
+
+@param[in]
+    pData
+        data replayed for the change
+
+@param[in]
+    length
+        length of the data
+
+@return
+    EOK : the change is logged, apply it
+    any other value specifies an error code (see errno.h), the change must
+    not be applied
+
+*/
+/*============================================================================*/
+int SNAPSHOT_fnBegin( uint16_t type, const void *pData, size_t length )
+{
+    static const char padding[ SNAPSHOT_ALIGN ] = { 0 };
+    tzSnapshotLogEntry entry;
+    struct iovec iov[3];
+    size_t total;
+    ssize_t written;
+    int ret = EOK;
+
+    pthread_rwlock_rdlock( &snapshotLock );
+
+    if( ( -1 == logFd ) || ( true == replaying ) )
+    {
+        return EOK;
+    }
+
+    if( ( ( NULL == pData ) && ( 0u != length ) ) || ( length > UINT32_MAX ) )
+    {
+        return EINVAL;
+    }
+
+    memset( &entry, 0, sizeof(entry) );
+    entry.length = (uint32_t)length;
+    entry.type = type;
+
+    iov[0].iov_base = &entry;
+    iov[0].iov_len = sizeof(entry);
+    iov[1].iov_base = (void *)pData;
+    iov[1].iov_len = length;
+    iov[2].iov_base = (void *)padding;
+    iov[2].iov_len = ( SNAPSHOT_ALIGN - ( length % SNAPSHOT_ALIGN ) ) %
+                     SNAPSHOT_ALIGN;
+    total = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+    pthread_mutex_lock( &logLock );
+
+    entry.sequence = lastSequence + 1u;
+    entry.check = snapshot_fnCheck( entry, pData );
+
+    written = writev( logFd, iov, 3 );
+    if( (ssize_t)total == written )
+    {
+        lastSequence = entry.sequence;
+        logLength += (off_t)total;
+    }
+    else
+    {
+        ret = ( written < 0 ) ? errno : EIO;
+
+        /* the next entry must not follow a torn one */
+        if( 0 != ftruncate( logFd, logLength ) )
+        {
+            fprintf( stderr, "%s: the log is torn\n", __func__ );
+        }
+    }
+
+    pthread_mutex_unlock( &logLock );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    End a change started with SNAPSHOT_fnBegin
+
+*/
+/*============================================================================*/
+void SNAPSHOT_fnEnd( void )
+{
+    pthread_rwlock_unlock( &snapshotLock );
+}
+
+/*============================================================================*/
+/*!
+    Map a snapshot and hand its sections to their modules
+
+@param[in]
+    pPath
+        path of the snapshot
+
+@param[out]
+    pSequence
+        sequence number of the last log entry the snapshot contains, 0 if
+        there is no snapshot
+
+@return
+    EOK on success, EBADMSG if the file is not a snapshot, or any other
+    error code from errno.h
+
+*/
+/*============================================================================*/
+static int snapshot_fnLoad( const char *pPath, uint64_t *pSequence )
+{
+    tzSnapshotHeader header;
+    tzSnapshotSection *pSection;
+    struct stat st;
+    char *pBase;
+    uint32_t i;
+    int j;
+    int fd;
+    int ret = EOK;
+
+    fd = open( pPath, O_RDONLY );
+    if( -1 == fd )
+    {
+        return ( ENOENT == errno ) ? EOK : errno;
+    }
+
+    if( 0 != fstat( fd, &st ) )
+    {
+        ret = errno;
+    }
+    else if( (size_t)st.st_size < sizeof(header) )
+    {
+        ret = EBADMSG;
+    }
+
+    pBase = MAP_FAILED;
+    if( EOK == ret )
+    {
+        pBase = mmap( NULL,
+                      (size_t)st.st_size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE,
+                      fd,
+                      0 );
+        if( MAP_FAILED == pBase )
+        {
+            ret = errno;
+        }
+    }
+
+    close( fd );
+
+    if( EOK != ret )
+    {
+        return ret;
+    }
+
+    memcpy( &header, pBase, sizeof(header) );
+    if( ( 0 != memcmp( header.magic, SNAPSHOT_MAGIC, sizeof(header.magic) ) ) ||
+        ( SNAPSHOT_VERSION != header.version ) ||
+        ( header.numSections > SNAPSHOT_MAX_SECTIONS ) )
+    {
+        ret = EBADMSG;
+    }
+
+    for( i = 0; ( EOK == ret ) && ( i < header.numSections ); i++ )
+    {
+        pSection = &header.sections[i];
+        if( ( pSection->offset > (uint64_t)st.st_size ) ||
+            ( pSection->length > (uint64_t)st.st_size - pSection->offset ) ||
+            ( 0u != ( pSection->offset % SNAPSHOT_ALIGN ) ) )
+        {
+            ret = EBADMSG;
+            break;
+        }
+
+        for( j = 0; ( j < numOwners ) && ( owners[j].id != pSection->id ); j++ )
+        {
+        }
+
+        if( j == numOwners )
+        {
+            fprintf( stderr,
+                     "%s: no module for section %u\n",
+                     __func__,
+                     (unsigned)pSection->id );
+            continue;
+        }
+
+        ret = owners[j].pfnLoad( pBase + pSection->offset,
+                                 (size_t)pSection->length,
+                                 owners[j].pContext );
+    }
+
+    *pSequence = header.sequence;
+
+    munmap( pBase, (size_t)st.st_size );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Open the log, replay its entries made after the snapshot and cut off a
+    torn end
+
+@param[in]
+    pLogPath
+        path of the log
+
+@param[in]
+    sequence
+        sequence number of the last log entry the snapshot contains
+
+@return
+    EOK on success, or an error code from errno.h
+
+*/
+/*============================================================================*/
+static int snapshot_fnReplayLog( const char *pLogPath, uint64_t sequence )
+{
+    tzSnapshotLogEntry entry;
+    tzSnapshotReplay *pReplay;
+    struct stat st;
+    char *pBase = NULL;
+    size_t offset = 0;
+    size_t size;
+    size_t total;
+    uint64_t check;
+    int ret;
+
+    logFd = open( pLogPath, O_RDWR | O_CREAT | O_APPEND, 0644 );
+    if( -1 == logFd )
+    {
+        return errno;
+    }
+
+    if( 0 != fstat( logFd, &st ) )
+    {
+        return errno;
+    }
+
+    size = (size_t)st.st_size;
+    if( size > 0u )
+    {
+        pBase = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, logFd, 0 );
+        if( MAP_FAILED == pBase )
+        {
+            return errno;
+        }
+    }
+
+    lastSequence = sequence;
+
+    while( size - offset >= sizeof(entry) )
+    {
+        memcpy( &entry, pBase + offset, sizeof(entry) );
+        if( entry.length > size - offset - sizeof(entry) )
+        {
+            break;
+        }
+
+        total = sizeof(entry) +
+                ( ( entry.length + SNAPSHOT_ALIGN - 1u ) & ~( SNAPSHOT_ALIGN - 1u ) );
+
+        check = entry.check;
+        entry.check = 0u;
+        if( ( check != snapshot_fnCheck( entry, pBase + offset + sizeof(entry) ) ) ||
+            ( total > size - offset ) )
+        {
+            break;
+        }
+
+        /* the entries up to the snapshot are in it already */
+        if( entry.sequence > sequence )
+        {
+            if( entry.sequence != lastSequence + 1u )
+            {
+                break;
+            }
+
+            pReplay = ( entry.type < SNAPSHOT_MAX_LOG_TYPES )
+                      ? &replays[ entry.type ]
+                      : NULL;
+            ret = ( ( NULL != pReplay ) && ( NULL != pReplay->pfnReplay ) )
+                  ? pReplay->pfnReplay( pBase + offset + sizeof(entry),
+                                        entry.length,
+                                        pReplay->pContext )
+                  : ENOSYS;
+            if( ( EOK != ret ) && ( EEXIST != ret ) )
+            {
+                fprintf( stderr,
+                         "%s: entry %llu of type %u: %s\n",
+                         __func__,
+                         (unsigned long long)entry.sequence,
+                         (unsigned)entry.type,
+                         strerror( ret ) );
+            }
+
+            lastSequence = entry.sequence;
+        }
+
+        offset += total;
+    }
+
+    if( NULL != pBase )
+    {
+        munmap( pBase, size );
+    }
+
+    if( offset < size )
+    {
+        fprintf( stderr,
+                 "%s: %s is torn at %zu bytes, the rest is dropped\n",
+                 __func__,
+                 pLogPath,
+                 offset );
+
+        if( 0 != ftruncate( logFd, (off_t)offset ) )
+        {
+            return errno;
+        }
+    }
+
+    logLength = (off_t)offset;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+    Write the sections of the snapshot to a new file, called with the
+    snapshot lock held exclusively
+
+@param[in]
+    pTmpPath
+        path of the new file
+
+@return
+    EOK on success, or an error code from errno.h
+
+*/
+/*============================================================================*/
+static int snapshot_fnWrite( const char *pTmpPath )
+{
+    tzSnapshotHeader header;
+    tzSnapshotSection *pSection;
+    FILE *fp;
+    off_t offset;
+    int i;
+    int ret = EOK;
+
+    fp = fopen( pTmpPath, "wb" );
+    if( NULL == fp )
+    {
+        return errno;
+    }
+
+    memset( &header, 0, sizeof(header) );
+    memcpy( header.magic, SNAPSHOT_MAGIC, sizeof(header.magic) );
+    header.version = SNAPSHOT_VERSION;
+    header.sequence = lastSequence;
+
+    /* the header is written again once the sections are placed */
+    if( 1u != fwrite( &header, sizeof(header), 1u, fp ) )
+    {
+        ret = EIO;
+    }
+
+    for( i = 0; ( EOK == ret ) && ( i < numOwners ); i++ )
+    {
+        ret = snapshot_fnPad( fp );
+        if( EOK != ret )
+        {
+            break;
+        }
+
+        pSection = &header.sections[ header.numSections++ ];
+        pSection->id = owners[i].id;
+        offset = ftello( fp );
+
+        ret = owners[i].pfnSave( fp, owners[i].pContext );
+
+        pSection->offset = (uint64_t)offset;
+        pSection->length = (uint64_t)( ftello( fp ) - offset );
+    }
+
+    errno = 0;
+    if( ( EOK == ret ) &&
+        ( ( 0 != fseeko( fp, 0, SEEK_SET ) ) ||
+          ( 1u != fwrite( &header, sizeof(header), 1u, fp ) ) ||
+          ( 0 != fflush( fp ) ) ||
+          ( 0 != fsync( fileno( fp ) ) ) ) )
+    {
+        ret = ( 0 != errno ) ? errno : EIO;
+    }
+
+    if( ( 0 != fclose( fp ) ) && ( EOK == ret ) )
+    {
+        ret = errno;
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Pad a snapshot to the alignment of the next section
+
+@param[in]
+    fp
+        the snapshot
+
+@return
+    EOK or EIO
+
+*/
+/*============================================================================*/
+static int snapshot_fnPad( FILE *fp )
+{
+    static const char padding[ SNAPSHOT_ALIGN ] = { 0 };
+    off_t offset = ftello( fp );
+    size_t pad;
+
+    if( offset < 0 )
+    {
+        return EIO;
+    }
+
+    pad = ( SNAPSHOT_ALIGN - ( (size_t)offset % SNAPSHOT_ALIGN ) ) %
+          SNAPSHOT_ALIGN;
+
+    return ( pad == fwrite( padding, 1u, pad, fp ) ) ? EOK : EIO;
+}
+
+/*============================================================================*/
+/*!
+    Hash a log entry
+
+@param[in]
+    entry
+        header of the entry, its check is 0
+
+@param[in]
+    pData
+        data of the entry
+
+@return
+    FNV-1a hash of the header and the data
+
+*/
+/*============================================================================*/
+static uint64_t snapshot_fnCheck( tzSnapshotLogEntry entry,
+                                  const void *pData )
+{
+    uint64_t hash = POLICY_DELTA_FNV_BASIS;
+
+    hash = POLICYDELTA_fnHash( hash, &entry, sizeof(entry) );
+    if( entry.length > 0u )
+    {
+        hash = POLICYDELTA_fnHash( hash, pData, entry.length );
+    }
+
+    return hash;
+}
+
+/*============================================================================*/
+/*!
+    Replay a rule registration, see tfnSnapshotReplay
+
+*/
+/*============================================================================*/
+static int snapshot_fnReplayCreate( void *pData,
+                                    size_t length,
+                                    void *pContext )
+{
+    (void)pContext;
+
+    return POLICY_fnCreateReplay( pData, length );
+}
+
+/*============================================================================*/
+/*!
+    Replay a rule commit, see tfnSnapshotReplay
+
+*/
+/*============================================================================*/
+static int snapshot_fnReplayCommit( void *pData,
+                                    size_t length,
+                                    void *pContext )
+{
+    (void)pContext;
+
+    return POLICY_fnHouseKeepReplay( pData, length );
+}
+
+/*! @} */
@@ -0,0 +1,193 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+/*!
+ * @file snapshot.h
+ * @brief Public APIs of the server snapshot and its write-ahead log
+ *
+ * The snapshot.h file contains the public APIs the server uses to save its
+ * state to a binary snapshot and to log the changes made since then.
+ *
+ * @defgroup snapshot Server Snapshot
+ * @brief Warm start of the server from a snapshot and a log
+ *
+ * A server restarted with a large data point file and a large policy spent
+ * its start up parsing XML and handling one message per data point, alias
+ * and rule.  With a snapshot the server maps the file written by the last
+ * SNAPSHOT_fnSave and hands each section to the module owning it, which
+ * decodes its records in place, then replays the write-ahead log of the
+ * changes made after that snapshot.
+ *
+ * The snapshot is a tzSnapshotHeader followed by its sections.  A section
+ * is saved and loaded by the module which registered it with
+ * SNAPSHOT_fnAddSection, the policy rules and subjects are a section of
+ * policy.c, the data points a section of the data point store.
+ *
+ * A change is logged by its module between SNAPSHOT_fnBegin and
+ * SNAPSHOT_fnEnd, before it is applied.  Every log entry is a
+ * tzSnapshotLogEntry followed by its data; it is replayed by the function
+ * attached to its type with SNAPSHOT_fnAttach.  SNAPSHOT_fnSave waits for
+ * the changes in progress, writes the new snapshot next to the old one,
+ * renames it over the old one and empties the log.
+ *
+ * The snapshot holds the structures of the server as they are in memory,
+ * it is read back by a server built for the same target only.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*==============================================================================
+                                 Defines
+ =============================================================================*/
+
+/*! first bytes of a snapshot */
+#define SNAPSHOT_MAGIC                 "DPACSNP1"
+
+/*! version of the snapshot layout */
+#define SNAPSHOT_VERSION               ( 1u )
+
+/*! most sections of a snapshot */
+#define SNAPSHOT_MAX_SECTIONS          ( 8 )
+
+/*! number of log entry types */
+#define SNAPSHOT_MAX_LOG_TYPES         ( 32 )
+
+/*! alignment of the sections and of the log entries */
+#define SNAPSHOT_ALIGN                 ( 8u )
+
+/*! suffix of the write-ahead log, added to the path of the snapshot */
+#define SNAPSHOT_LOG_SUFFIX            ".wal"
+
+/*! section of the policy rules and subjects, see policy.c */
+#define SNAPSHOT_SECTION_POLICY        ( 1u )
+
+/*! section of the data point store */
+#define SNAPSHOT_SECTION_STORE         ( 2u )
+
+/*! log entry of a MSG_DP_POLICY_REGISTER message */
+#define SNAPSHOT_LOG_POLICY_CREATE     ( 1u )
+
+/*! log entry of a housekeeping message committing the rules */
+#define SNAPSHOT_LOG_POLICY_COMMIT     ( 2u )
+
+/*! log entry of the records of a POLICY_HOUSEKEEP_DP_BULK message */
+#define SNAPSHOT_LOG_DP_BULK           ( 3u )
+
+/*! first log entry type of the data point store */
+#define SNAPSHOT_LOG_STORE             ( 16u )
+
+/*==============================================================================
+                                Structures
+ =============================================================================*/
+
+/*! entry of the section table */
+typedef struct zSnapshotSection
+{
+    /*! SNAPSHOT_SECTION_ identifier, 0 for an unused entry */
+    uint32_t id;
+
+    /*! unused */
+    uint32_t reserved;
+
+    /*! offset of the section in the snapshot */
+    uint64_t offset;
+
+    /*! length of the section */
+    uint64_t length;
+
+} tzSnapshotSection;
+
+/*! first bytes of a snapshot */
+typedef struct zSnapshotHeader
+{
+    /*! SNAPSHOT_MAGIC */
+    char magic[8];
+
+    /*! SNAPSHOT_VERSION */
+    uint32_t version;
+
+    /*! number of used entries of the section table */
+    uint32_t numSections;
+
+    /*! sequence number of the last log entry the snapshot contains */
+    uint64_t sequence;
+
+    /*! section table */
+    tzSnapshotSection sections[ SNAPSHOT_MAX_SECTIONS ];
+
+} tzSnapshotHeader;
+
+/*! header of a log entry, the data follows it and is padded to
+ *  SNAPSHOT_ALIGN */
+typedef struct zSnapshotLogEntry
+{
+    /*! length of the data */
+    uint32_t length;
+
+    /*! SNAPSHOT_LOG_ type */
+    uint16_t type;
+
+    /*! unused */
+    uint16_t reserved;
+
+    /*! sequence number, one more than the entry before */
+    uint64_t sequence;
+
+    /*! FNV-1a hash of the entry with this field 0 and of the data, an entry
+     *  torn by a crash is not replayed */
+    uint64_t check;
+
+} tzSnapshotLogEntry;
+
+/*==============================================================================
+                                  Types
+ =============================================================================*/
+
+/*! writes a section to the snapshot, returns EOK or an errno */
+typedef int (*tfnSnapshotSave)( FILE *fp, void *pContext );
+
+/*! restores a section from the mapping of the snapshot, the data is
+ *  writable and is unmapped once the sections are loaded, returns EOK or an
+ *  errno */
+typedef int (*tfnSnapshotLoad)( void *pData, size_t length, void *pContext );
+
+/*! applies a log entry again, the data is writable and aligned to
+ *  SNAPSHOT_ALIGN, returns EOK or an errno */
+typedef int (*tfnSnapshotReplay)( void *pData, size_t length, void *pContext );
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int SNAPSHOT_fnAddSection( uint32_t id,
+                           tfnSnapshotSave pfnSave,
+                           tfnSnapshotLoad pfnLoad,
+                           void *pContext );
+int SNAPSHOT_fnAttach( uint16_t type,
+                       tfnSnapshotReplay pfnReplay,
+                       void *pContext );
+int SNAPSHOT_fnOpen( const char *pPath );
+int SNAPSHOT_fnSave( void );
+int SNAPSHOT_fnBegin( uint16_t type, const void *pData, size_t length );
+void SNAPSHOT_fnEnd( void );
+
+/*! @} */
+
+#endif /* SNAPSHOT_H_ */
@@ -0,0 +1,744 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+/*!
+ * @addtogroup subject
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+
+ @file  subject.c
+
+ @brief
+    Policy user and group interning
+
+ @details
+    This module interns the user and group names of the policy rules to
+    bit positions.  The rule subjects are kept as bit sets which grow with
+    the number of names, so the policy check of a data point user or group
+    is a bit test per tag of the data point.
+
+    The names known by the earlier versions of the policy files are
+    interned first and in the order of their USER_CODE and GROUP_CODE
+    values, so the legacy single code messages keep their meaning.
+
+*/
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	Includes
+ =============================================================================*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "cfuhash.h"
+#include "minicloudmsg.h"
+#include "subject.h"
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Defines
+==============================================================================*/
+
+/*! maximum length of a comma separated subject list */
+#define SUBJECT_LIST_LENGTH    ( 512 )
+
+/*! number of names the tables are created for, they grow beyond it */
+#define SUBJECT_INITIAL_IDS    ( 32 )
+
+/*! list separator */
+#define SUBJECT_SEPARATOR      ","
+
+/*! number of bits of a set word */
+#define SUBJECT_WORD_BITS      ( 64u )
+
+/*=============================================================================
+ 	 	 	 	 	 	 	 	 Structures
+ =============================================================================*/
+
+/*! legacy name to code mapping */
+typedef struct zSubjectCode
+{
+    /*! legacy USER_CODE or GROUP_CODE value */
+    uint32_t code;
+
+    /*! name as written in the policy and in the data point tags */
+    const char *pName;
+
+} tzSubjectCode;
+
+/*! interned names of one subject kind */
+typedef struct zSubjectTable
+{
+    /*! hash table mapping the lower case name to its identifier + 1 */
+    cfuhash_table_t *pHash;
+
+    /*! lookups share the lock, interning takes it exclusively */
+    pthread_rwlock_t lock;
+
+    /*! number of interned names */
+    int count;
+
+    /*! number of entries of the names array */
+    int capacity;
+
+    /*! interned names by identifier, for the snapshot of the server */
+    char **ppNames;
+
+} tzSubjectTable;
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 Local/Private Variables
+ =============================================================================*/
+
+/*! legacy user codes */
+static const tzSubjectCode userCodes[] =
+{
+    { USER_CODE_GUS,    "gus"    },
+    { USER_CODE_DOUG,   "doug"   },
+    { USER_CODE_MIKE,   "mike"   },
+    { USER_CODE_TOM,    "tom"    },
+    { USER_CODE_JACKIE, "jackie" },
+    { USER_CODE_LILLI,  "lilli"  },
+    { USER_CODE_BOB,    "bob"    },
+    { USER_CODE_MADI,   "madi"   },
+    { 0,                NULL     }
+};
+
+/*! legacy group codes */
+static const tzSubjectCode groupCodes[] =
+{
+    { GROUP_CODE_MANAGER,  "manager"     },
+    { GROUP_CODE_ENG,      "engineering" },
+    { GROUP_CODE_TECH,     "technician"  },
+    { GROUP_CODE_CUSTOMER, "customer"    },
+    { 0,                   NULL          }
+};
+
+/*! legacy codes per subject kind */
+static const tzSubjectCode *subjectCodes[ eSubjectKinds ] =
+{
+    userCodes,
+    groupCodes
+};
+
+/*! interned names per subject kind */
+static tzSubjectTable subjects[ eSubjectKinds ];
+
+/*==============================================================================
+ Local/Private Function Prototypes
+ =============================================================================*/
+
+static int subject_fnAdd( tzSubjectSet *pSet, uint32_t id );
+static size_t subject_fnNormalise( const char *pName,
+                                   char *pKey,
+                                   size_t keyLen );
+
+/*==============================================================================
+ Function Definitions
+ =============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    initialise the subject tables
+
+    The SUBJECT_fnSetup function creates the user and group tables and
+    interns the legacy names.
+
+@return
+    None
+
+*/
+/*============================================================================*/
+void SUBJECT_fnSetup( void )
+{
+    uint32_t id;
+    int kind;
+    int i;
+
+    for( kind = 0; kind < eSubjectKinds; kind++ )
+    {
+        subjects[kind].pHash =
+                cfuhash_new_with_initial_size( SUBJECT_INITIAL_IDS );
+        subjects[kind].count = 0;
+        subjects[kind].capacity = 0;
+        subjects[kind].ppNames = NULL;
+        pthread_rwlock_init( &subjects[kind].lock, NULL );
+        if( NULL != subjects[kind].pHash )
+        {
+            cfuhash_set_flag( subjects[kind].pHash, CFUHASH_NO_LOCKING );
+        }
+
+        for( i = 0; NULL != subjectCodes[kind][i].pName; i++ )
+        {
+            SUBJECT_fnIntern( (teSubjectKind)kind,
+                              subjectCodes[kind][i].pName,
+                              &id );
+        }
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Intern a comma separated list of names and build its set
+
+    Every name of the list is interned (if not already) and its bit is added
+    to the set.  Names are case insensitive and white space around them is
+    ignored.
+
+@param[in]
+    kind
+        subject kind of the names
+
+@param[in]
+    pList
+        comma separated list of names, e.g. "bob, gus"
+
+@param[out]
+    pSet
+        the wild card if the list is empty, otherwise the set of the listed
+        names, release it with SUBJECT_fnFreeSet
+
+@return
+    EOK on success, EINVAL if the list or one of its names is too long,
+    ENOMEM if the set or a name could not be stored
+
+*/
+/*============================================================================*/
+int SUBJECT_fnInternSet( teSubjectKind kind,
+                         const char *pList,
+                         tzSubjectSet *pSet )
+{
+    char list[ SUBJECT_LIST_LENGTH ];
+    char *pSave = NULL;
+    char *token = NULL;
+    uint32_t id;
+    int ret = EOK;
+
+    if( ( NULL == pSet ) || ( kind >= eSubjectKinds ) )
+    {
+        return EINVAL;
+    }
+
+    memset( pSet, 0, sizeof(tzSubjectSet) );
+
+    if( NULL == pList )
+    {
+        pSet->any = true;
+        return EOK;
+    }
+
+    if( strlen( pList ) >= sizeof(list) )
+    {
+        return EINVAL;
+    }
+    strcpy( list, pList );
+
+    for( token = strtok_r( list, SUBJECT_SEPARATOR, &pSave );
+         ( EOK == ret ) && ( token != NULL );
+         token = strtok_r( NULL, SUBJECT_SEPARATOR, &pSave ) )
+    {
+        ret = SUBJECT_fnIntern( kind, token, &id );
+        if( EOK == ret )
+        {
+            ret = subject_fnAdd( pSet, id );
+        }
+        else if( ENOENT == ret )
+        {
+            /* an empty name between two separators */
+            ret = EOK;
+        }
+    }
+
+    if( EOK != ret )
+    {
+        SUBJECT_fnFreeSet( pSet );
+    }
+    else if( 0u == pSet->numWords )
+    {
+        /* nothing listed means a wild card */
+        pSet->any = true;
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Convert a legacy user or group code to a subject set
+
+@param[in]
+    kind
+        subject kind of the code
+
+@param[in]
+    code
+        USER_CODE or GROUP_CODE value
+
+@param[out]
+    pSet
+        the single name set of the code, or the wild card if the code is
+        invalid meaning not specified in the policy rule, release it with
+        SUBJECT_fnFreeSet
+
+@return
+    EOK on success, ENOMEM if the set could not be stored
+
+*/
+/*============================================================================*/
+int SUBJECT_fnCodeToSet( teSubjectKind kind,
+                         uint32_t code,
+                         tzSubjectSet *pSet )
+{
+    uint32_t id;
+    int ret = EOK;
+    int i;
+
+    if( ( NULL == pSet ) || ( kind >= eSubjectKinds ) )
+    {
+        return EINVAL;
+    }
+
+    memset( pSet, 0, sizeof(tzSubjectSet) );
+    pSet->any = true;
+
+    for( i = 0; NULL != subjectCodes[kind][i].pName; i++ )
+    {
+        if( code == subjectCodes[kind][i].code )
+        {
+            pSet->any = false;
+            ret = SUBJECT_fnIntern( kind, subjectCodes[kind][i].pName, &id );
+            if( EOK == ret )
+            {
+                ret = subject_fnAdd( pSet, id );
+            }
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+    Release the words of a subject set
+
+@param[in]
+    pSet
+        set built by SUBJECT_fnInternSet or SUBJECT_fnCodeToSet, it is left
+        empty
+
+*/
+/*============================================================================*/
+void SUBJECT_fnFreeSet( tzSubjectSet *pSet )
+{
+    if( NULL != pSet )
+    {
+        free( pSet->pWords );
+        pSet->pWords = NULL;
+        pSet->numWords = 0u;
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Intern a name and return its identifier
+
+    A name is never removed, interning the names in the order of their
+    identifiers in an empty table gives them the same identifiers again.
+
+@param[in]
+    kind
+        subject kind of the name
+
+@param[in]
+    pName
+        name of the user or the group
+
+@param[out]
+    pId
+        identifier of the name, its bit in the sets
+
+@return
+    EOK on success, ENOENT if the name is empty, EINVAL if it is longer
+    than SUBJECT_NAME_LENGTH - 1, ENOMEM if it could not be stored
+
+*/
+/*============================================================================*/
+int SUBJECT_fnIntern( teSubjectKind kind, const char *pName, uint32_t *pId )
+{
+    char key[ SUBJECT_NAME_LENGTH ];
+    tzSubjectTable *pTable;
+    char **ppNames;
+    char *pCopy;
+    uintptr_t id;
+    size_t len;
+    int capacity;
+
+    if( ( kind >= eSubjectKinds ) || ( NULL == pId ) )
+    {
+        return EINVAL;
+    }
+
+    pTable = &subjects[kind];
+
+    len = subject_fnNormalise( pName, key, sizeof(key) );
+    if( 0 == len )
+    {
+        return ENOENT;
+    }
+
+    if( len >= sizeof(key) )
+    {
+        /* distinct long names must not become the same subject */
+        fprintf( stderr,
+                 "%s: subject name longer than %d characters\n",
+                 __func__,
+                 SUBJECT_NAME_LENGTH - 1 );
+        return EINVAL;
+    }
+
+    if( NULL == pTable->pHash )
+    {
+        return ENOMEM;
+    }
+
+    pthread_rwlock_wrlock( &pTable->lock );
+
+    id = (uintptr_t)cfuhash_get( pTable->pHash, key );
+    if( 0 == id )
+    {
+        if( pTable->count == pTable->capacity )
+        {
+            capacity = ( 0 == pTable->capacity ) ? SUBJECT_INITIAL_IDS
+                                                 : 2 * pTable->capacity;
+            ppNames = realloc( pTable->ppNames, capacity * sizeof(char *) );
+            if( NULL != ppNames )
+            {
+                pTable->ppNames = ppNames;
+                pTable->capacity = capacity;
+            }
+        }
+
+        pCopy = ( pTable->count < pTable->capacity ) ? strdup( key ) : NULL;
+        if( NULL != pCopy )
+        {
+            pTable->ppNames[ pTable->count ] = pCopy;
+            id = (uintptr_t)( ++pTable->count );
+            cfuhash_put( pTable->pHash, key, (void *)id );
+        }
+    }
+
+    pthread_rwlock_unlock( &pTable->lock );
+
+    if( 0 == id )
+    {
+        fprintf( stderr, "%s: cannot intern %s\n", __func__, key );
+        return ENOMEM;
+    }
+
+    *pId = (uint32_t)( id - 1 );
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Look up a data point user or group and add it to the data point subjects
+
+    This function is used on the policy check path and never interns a
+    name, a name which no rule mentions cannot be permitted by any rule
+    other than the wild card.
+
+@param[in]
+    kind
+        subject kind of the name
+
+@param[in]
+    pName
+        name of the user or the group
+
+@param[in,out]
+    pIds
+        subjects of the data point, the identifier of the name is added
+
+@return
+    EOK on success, ENOENT if the name is not interned, ENOSPC if the data
+    point has SUBJECT_MAX_DP_IDS subjects already
+
+*/
+/*============================================================================*/
+int SUBJECT_fnLookup( teSubjectKind kind,
+                      const char *pName,
+                      tzSubjectIds *pIds )
+{
+    char key[ SUBJECT_NAME_LENGTH ];
+    uintptr_t id;
+    size_t len;
+    int i;
+
+    if( ( kind >= eSubjectKinds ) ||
+        ( NULL == subjects[kind].pHash ) ||
+        ( NULL == pIds ) )
+    {
+        return EINVAL;
+    }
+
+    /* a name too long for a rule is not interned either */
+    len = subject_fnNormalise( pName, key, sizeof(key) );
+    if( ( 0 == len ) || ( len >= sizeof(key) ) )
+    {
+        return ENOENT;
+    }
+
+    pthread_rwlock_rdlock( &subjects[kind].lock );
+    id = (uintptr_t)cfuhash_get( subjects[kind].pHash, key );
+    pthread_rwlock_unlock( &subjects[kind].lock );
+
+    if( 0 == id )
+    {
+        return ENOENT;
+    }
+
+    for( i = 0; i < pIds->count; i++ )
+    {
+        if( pIds->ids[i] == (uint32_t)( id - 1 ) )
+        {
+            return EOK;
+        }
+    }
+
+    if( pIds->count >= SUBJECT_MAX_DP_IDS )
+    {
+        return ENOSPC;
+    }
+
+    pIds->ids[ pIds->count++ ] = (uint32_t)( id - 1 );
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Return one of the subjects of a rule set as the subjects of a data point
+
+@param[in]
+    pSet
+        subject set of a rule
+
+@param[out]
+    pIds
+        the lowest identifier of the set, no identifier for the wild card
+
+*/
+/*============================================================================*/
+void SUBJECT_fnFirst( const tzSubjectSet *pSet, tzSubjectIds *pIds )
+{
+    uint32_t i;
+
+    pIds->count = 0;
+
+    for( i = 0u; ( false == pSet->any ) && ( i < pSet->numWords ); i++ )
+    {
+        if( 0u != pSet->pWords[i] )
+        {
+            pIds->ids[0] = i * SUBJECT_WORD_BITS +
+                           (uint32_t)__builtin_ctzll( pSet->pWords[i] );
+            pIds->count = 1;
+            break;
+        }
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Return the number of interned names of a subject kind
+
+@param[in]
+    kind
+        subject kind
+
+@return
+    number of names, their identifiers are 0 to the count - 1
+
+*/
+/*============================================================================*/
+int SUBJECT_fnCount( teSubjectKind kind )
+{
+    int count = 0;
+
+    if( kind < eSubjectKinds )
+    {
+        pthread_rwlock_rdlock( &subjects[kind].lock );
+        count = subjects[kind].count;
+        pthread_rwlock_unlock( &subjects[kind].lock );
+    }
+
+    return count;
+}
+
+/*============================================================================*/
+/*!
+
+    Return an interned name by its identifier
+
+@param[in]
+    kind
+        subject kind
+
+@param[in]
+    position
+        identifier of the name, below SUBJECT_fnCount
+
+@return
+    the lower case name, NULL if the identifier is not used
+
+*/
+/*============================================================================*/
+const char* SUBJECT_fnName( teSubjectKind kind, int position )
+{
+    const char *pName = NULL;
+
+    if( ( kind < eSubjectKinds ) && ( position >= 0 ) )
+    {
+        pthread_rwlock_rdlock( &subjects[kind].lock );
+        if( position < subjects[kind].count )
+        {
+            /* the names are never released, only their array moves */
+            pName = subjects[kind].ppNames[ position ];
+        }
+        pthread_rwlock_unlock( &subjects[kind].lock );
+    }
+
+    return pName;
+}
+
+/*============================================================================*/
+/*!
+
+    Add an identifier to a rule set, growing its words
+
+@param[in,out]
+    pSet
+        subject set of a rule
+
+@param[in]
+    id
+        identifier of a name
+
+@return
+    EOK on success, ENOMEM if the set could not grow
+
+*/
+/*============================================================================*/
+static int subject_fnAdd( tzSubjectSet *pSet, uint32_t id )
+{
+    uint32_t numWords = id / SUBJECT_WORD_BITS + 1u;
+    uint64_t *pWords;
+
+    if( numWords > pSet->numWords )
+    {
+        pWords = realloc( pSet->pWords, numWords * sizeof(uint64_t) );
+        if( NULL == pWords )
+        {
+            return ENOMEM;
+        }
+
+        memset( &pWords[ pSet->numWords ],
+                0,
+                ( numWords - pSet->numWords ) * sizeof(uint64_t) );
+        pSet->pWords = pWords;
+        pSet->numWords = numWords;
+    }
+
+    pSet->pWords[ id / SUBJECT_WORD_BITS ] |=
+            1ull << ( id % SUBJECT_WORD_BITS );
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Build the lower case, white space trimmed key of a name
+
+@param[in]
+    pName
+        name of the user or the group
+
+@param[out]
+    pKey
+        buffer receiving the key
+
+@param[in]
+    keyLen
+        size of the key buffer
+
+@return
+    length of the key, 0 if the name is empty, keyLen if the name does not
+    fit the buffer, the key is not usable then
+
+*/
+/*============================================================================*/
+static size_t subject_fnNormalise( const char *pName,
+                                   char *pKey,
+                                   size_t keyLen )
+{
+    size_t len = 0;
+    size_t end;
+
+    if( ( NULL == pName ) || ( NULL == pKey ) || ( 0 == keyLen ) )
+    {
+        return 0;
+    }
+
+    while( isspace( (unsigned char)*pName ) )
+    {
+        pName++;
+    }
+
+    end = strlen( pName );
+    while( ( end > 0 ) && isspace( (unsigned char)pName[end-1] ) )
+    {
+        end--;
+    }
+
+    if( end >= keyLen )
+    {
+        pKey[0] = '\0';
+        return keyLen;
+    }
+
+    for( len = 0; len < end; len++ )
+    {
+        pKey[len] = (char)tolower( (unsigned char)pName[len] );
+    }
+
+    pKey[len] = '\0';
+
+    return len;
+}
+
+/*!
+ * @} // subject
+ */
@@ -0,0 +1,170 @@
+/*=============================================================================
+
+University of British Columbia (UBC)
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Mini Cloud Server Project.
+
+==============================================================================*/
+
+#ifndef SUBJECT_H_
+#define SUBJECT_H_
+
+/*!
+ * @file subject.h
+ * @brief Public APIs for interning policy users and groups
+ *
+ * The subject.h file contains the public APIs, types, and
+ * data structures for managing the policy subjects (users and groups).
+ *
+ * @defgroup subject Policy Subject Sets
+ * @brief Policy user and group sets
+ *
+ * Every user and group name seen in a policy rule is interned to an
+ * identifier which is used as a bit position.  A policy rule keeps the set of
+ * its users and the set of its groups as bit sets of as many 64-bit words as
+ * its highest identifier needs, and a data point carries the identifiers of
+ * its own user and group tags, so that matching a rule subject tests one bit
+ * per tag of the data point.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Includes
+ =============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Defines
+==============================================================================*/
+
+/*! maximum number of user or group names of a data point, the names after
+ *  them are not matched */
+#define SUBJECT_MAX_DP_IDS     ( 16 )
+
+/*! size of a user or a group name with its terminator, a longer name is
+ *  refused */
+#define SUBJECT_NAME_LENGTH    ( 64 )
+
+/*! test if a data point subject set is permitted by a rule subject set */
+#define SUBJECT_MATCH( pRuleSet, pDpIds )  \
+            SUBJECT_fnMatch( (pRuleSet), (pDpIds) )
+
+/*==============================================================================
+ 	 	 	 	 	 	 	 	 	 Enums
+==============================================================================*/
+
+/*! subject kinds, each kind has its own name space */
+typedef enum eSubjectKind
+{
+    /*! user names */
+    eSubjectUser = 0,
+
+    /*! group names */
+    eSubjectGroup,
+
+    /*! number of subject kinds */
+    eSubjectKinds
+
+} teSubjectKind;
+
+/*=============================================================================
+                              Structures
+==============================================================================*/
+
+/*! subject set of a rule */
+typedef struct zSubjectSet
+{
+    /*! the set is a wild card, it matches every data point */
+    bool any;
+
+    /*! number of words of the set */
+    uint32_t numWords;
+
+    /*! bits of the set, the name of identifier id is bit id % 64 of word
+     *  id / 64 */
+    uint64_t *pWords;
+
+} tzSubjectSet;
+
+/*! subjects of a data point */
+typedef struct zSubjectIds
+{
+    /*! number of identifiers, 0 if no user or group of the data point is
+     *  named by a rule, only the wild card matches it then */
+    int count;
+
+    /*! identifiers of the interned names of the data point */
+    uint32_t ids[ SUBJECT_MAX_DP_IDS ];
+
+} tzSubjectIds;
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+void SUBJECT_fnSetup( void );
+int SUBJECT_fnInternSet( teSubjectKind kind,
+                         const char *pList,
+                         tzSubjectSet *pSet );
+int SUBJECT_fnCodeToSet( teSubjectKind kind,
+                         uint32_t code,
+                         tzSubjectSet *pSet );
+void SUBJECT_fnFreeSet( tzSubjectSet *pSet );
+int SUBJECT_fnIntern( teSubjectKind kind, const char *pName, uint32_t *pId );
+int SUBJECT_fnLookup( teSubjectKind kind,
+                      const char *pName,
+                      tzSubjectIds *pIds );
+void SUBJECT_fnFirst( const tzSubjectSet *pSet, tzSubjectIds *pIds );
+int SUBJECT_fnCount( teSubjectKind kind );
+const char* SUBJECT_fnName( teSubjectKind kind, int position );
+
+/*============================================================================*/
+/*!
+
+    Test if a data point subject set is permitted by a rule subject set
+
+@param[in]
+    pSet
+        subject set of the rule
+
+@param[in]
+    pIds
+        subjects of the data point
+
+@return
+    true if the rule set is a wild card or holds one of the data point
+    subjects
+
+*/
+/*============================================================================*/
+static inline bool SUBJECT_fnMatch( const tzSubjectSet *pSet,
+                                    const tzSubjectIds *pIds )
+{
+    uint32_t id;
+    int i;
+
+    if( true == pSet->any )
+    {
+        return true;
+    }
+
+    for( i = 0; i < pIds->count; i++ )
+    {
+        id = pIds->ids[i];
+        if( ( ( id / 64u ) < pSet->numWords ) &&
+            ( 0u != ( pSet->pWords[ id / 64u ] & ( 1ull << ( id % 64u ) ) ) ) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*! @} */
+
+#endif /* SUBJECT_H_ */
@@ -11,6 +11,10 @@ Define Data Point Application.
 
 #include "minicloud.h"
 #include "minicloudpolicy.h"
+#include "policymsg.h"
+#include "policyasync.h"
+#include "policybulk.h"
+#include "xmlmap.h"
 #include <stdbool.h>
 
 typedef void (*PARSE_fnEndElementHandler)( void *userData,
@@ -28,8 +32,15 @@ typedef void (*PARSE_fnStartElementHandler)( void *userData,
 
 #define PARSE_MAX_ALIAS               ( 20 )
 
-/*! string length of the time - ISO 8601 - 35 characters */
-#define TIME_STR_LENGTH ( strlen( "YYYY-MM-DDThh:mm:ss.nnnnnnnnn-zzzz#" ) )
+/*! maximum length of a policy rule condition */
+#define PARSE_CONDITION_LENGTH        ( 512 )
+
+/*! entries of the time cache of a parse, a power of two */
+#define PARSE_TIME_CACHE_SIZE         ( 16u )
+
+/*! longest ISO 8601 time kept in the time cache, with its terminator -
+ *  "YYYY-MM-DDThh:mm:ss.nnnnnnnnn-zz:zz" */
+#define PARSE_TIME_TEXT_LENGTH        ( 40 )
 
 /*============================================================================*/
 
@@ -40,16 +51,14 @@ typedef struct zUserData
     /*! handle to the Data Point Manager */
     DP_HANDLE hDPRM;
 
-    /*! character data buffer used to store all XML element data */
-    char char_data_buffer[1024];
-
-    /*! current offset within the char_data_buffer */
-    size_t offset;
+    /*! character data of the XML elements, sliced from the mapped file */
+    tzXmlText text;
 
-    /*! the start offset in the character buffer for the current XML element */
-    size_t start_offset;
+    /*! text of the element being ended, for the external end element
+     *  handler */
+    char *pElementData;
 
-    /*! flag indicating if a buffer overflow has occurred during processing */
+    /*! flag indicating if an allocation failed during processing */
     bool overflow;
 
     /*! original instance identifier requested for the data point */
@@ -82,8 +91,13 @@ typedef struct zUserData
     /*! number of aliases we have seen so far for this point */
     int aliasIndex;
 
-    /*! pointer to meta data */
-    tzDataPointMetaData *pMetaData;
+    /*! data points waiting to be created, with the meta data pairs of the
+     *  data point being parsed */
+    tzDpBulk bulk;
+
+    /*! the data points are created in batches, cleared when the server
+     *  cannot create them in bulk */
+    bool bulkRegister;
 
     /*! flag to indicate if we are currently processing meta data */
     bool processingMeta;
@@ -114,6 +128,20 @@ typedef struct zUserData
 } tzUserData;
 
 
+/*! time of a rule converted before, see PARSE_fnPolicyTime() */
+typedef struct zTimeCacheEntry
+{
+    /*! text of the <time> element */
+    char text[ PARSE_TIME_TEXT_LENGTH ];
+
+    /*! length of the text, 0 for an unused entry */
+    size_t len;
+
+    /*! seconds since the epoch of the text */
+    int64_t seconds;
+
+} tzTimeCacheEntry;
+
 /*! the tzPolicyData structure is passed to all Policy XML element and character
  *  processing callback functions by the XML parser */
 typedef struct zPolicyData
@@ -121,26 +149,29 @@ typedef struct zPolicyData
 	/*! handle to the Data Point Manager */
 	DP_HANDLE hDPRM;
 
-    /*! character data buffer used to store all XML element data */
-    char char_data_policy_buffer[1024];
+    /*! character data of the XML elements, sliced from the mapped file */
+    tzXmlText text;
 
-    /*! current offset within the char_data_buffer */
-    size_t offset;
-
-    /*! the start offset in the character buffer for the current XML element */
-    size_t start_offset;
-
-    /*! flag indicating if a buffer overflow has occurred during processing */
+    /*! flag indicating if an allocation failed during processing */
     bool overflow;
 
     /*! policy attributes are collected here ready to be sent to the server */
     struct zPOLICY policy;
 
-    /*! container that converts the string ISO8601 time to the tm struct */
-    struct tm tm_time;
+    /*! times of the rules parsed so far */
+    tzTimeCacheEntry timeCache[ PARSE_TIME_CACHE_SIZE ];
+
+    /*! comma separated list of the rule users, empty for a wild card */
+    char userList[ POLICY_SUBJECT_LIST_LENGTH ];
+
+    /*! comma separated list of the rule groups, empty for a wild card */
+    char groupList[ POLICY_SUBJECT_LIST_LENGTH ];
 
-    /*! container for holding the string time */
-    char timeString[ 128 ];
+    /*! condition of the rule, compiled when the rule is complete */
+    char condition[ PARSE_CONDITION_LENGTH ];
+
+    /*! compiled condition of the rule */
+    tzPolicyProgram program;
 
     /*! pointer to an external start element handler */
     PARSE_fnStartElementHandler start_element_handler;
@@ -150,6 +181,63 @@ typedef struct zPolicyData
 
 } tzPolicyData;
 
+/*! what an incremental policy reload sent, see PARSE_fnDeltaApply() */
+typedef struct zDeltaSummary
+{
+    /*! rules the server did not have */
+    uint32_t added;
+
+    /*! rules the server had with a different content */
+    uint32_t changed;
+
+    /*! rules the server had with the same content, not sent */
+    uint32_t unchanged;
+
+    /*! rules of the server not in the policy file */
+    uint32_t removed;
+
+} tzDeltaSummary;
+
+/*! elements of the <policyFile> schema, see PARSE_fnPolicyTag() */
+typedef enum ePolicyTag
+{
+    /*! element outside the schema, ignored */
+    POLICY_TAG_OTHER = 0,
+
+    /*! <policy>, one rule */
+    POLICY_TAG_POLICY,
+
+    /*! <rule min="" max="">comparator|access</rule> */
+    POLICY_TAG_RULE,
+
+    /*! <type>, the data point type */
+    POLICY_TAG_TYPE,
+
+    /*! <vendor>, the location of the rule */
+    POLICY_TAG_VENDOR,
+
+    /*! <time>, ISO 8601 time of the rule */
+    POLICY_TAG_TIME,
+
+    /*! <user>, comma separated users */
+    POLICY_TAG_USER,
+
+    /*! <group>, comma separated groups */
+    POLICY_TAG_GROUP,
+
+    /*! <condition>, condition expression */
+    POLICY_TAG_CONDITION
+
+} tePolicyTag;
+
+/*! policy file parser, PARSE_fnPolicyCreate(), PARSEPULL_fnPolicyCreate()
+ *  or PARSEXACML_fnPolicyCreate() */
+typedef int (*PARSE_fnPolicyParser)( DP_HANDLE hDPRM, char *filename );
+
+/*! handler of a complete policy rule, see PARSE_fnSetRuleHandler() */
+typedef int (*PARSE_fnRuleHandler)( tzPolicyData *ptzPolicyData,
+                                    void *pContext );
+
 
 int PARSE_fnCreate( DP_HANDLE hDPRM,
 		              uint32_t instanceID,
@@ -163,7 +251,41 @@ int PARSE_fnCreate( DP_HANDLE hDPRM,
 
 
 int PARSE_fnPolicyCreate(DP_HANDLE hDPRM, char *filename);
+tePolicyTag PARSE_fnPolicyTag( const char *name, size_t len );
+void PARSE_fnPolicyStart( tzPolicyData *ptzPolicyData,
+                          tePolicyTag tag,
+                          const char **atts );
+void PARSE_fnPolicyEnd( tzPolicyData *ptzPolicyData,
+                        tePolicyTag tag,
+                        char *pElementData );
+int PARSEPULL_fnPolicyCreate( DP_HANDLE hDPRM, char *filename );
+int PARSEPULL_fnBenchmark( char *filename, int iterations );
+void PARSE_fnCopySubjects( char *pList,
+                           size_t listLen,
+                           const char *pElementData,
+                           const char *element );
+int PARSE_fnCompileCondition( const char *pText,
+                              struct zPOLICY *pPolicy,
+                              tzPolicyProgram *pProgram );
 int PARSEXACML_fnPolicyCreate( DP_HANDLE hDPRM, char *filename);
+int PARSE_fnIsoTime( const char *pText, size_t len, int64_t *pSeconds );
+int PARSE_fnPolicyTime( tzPolicyData *ptzPolicyData, const char *pText );
+void PARSE_fnSetRuleHandler( PARSE_fnRuleHandler pHandler, void *pContext );
+bool PARSE_fnHasRuleHandler( void );
+int PARSE_fnRegisterRule( tzPolicyData *ptzPolicyData );
+int PARSE_fnCodegenRule( tzPolicyData *ptzPolicyData, void *pContext );
+int PARSE_fnCodegenWrite( const char *pOutFile, const char *pSource );
+int PARSE_fnDeltaRule( tzPolicyData *ptzPolicyData, void *pContext );
+int PARSE_fnDeltaApply( DP_HANDLE hDPRM, tzDeltaSummary *pSummary );
+int PARSE_fnDeltaReload( DP_HANDLE hDPRM,
+                         PARSE_fnPolicyParser pfnParse,
+                         char *filename,
+                         tzDeltaSummary *pSummary );
+int PARSE_fnWatchPolicy( DP_HANDLE hDPRM,
+                         PARSE_fnPolicyParser pfnParse,
+                         char *filename,
+                         uint32_t debounceMs,
+                         bool verbose );
 int DP_fnPolicyHouseKeeping( DP_HANDLE hDPRM );
 
 #endif /* DEFDP_H_ */
@@ -0,0 +1,82 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+#ifndef POLICYSET_H_
+#define POLICYSET_H_
+
+/*!
+ * @file policyset.h
+ * @brief In-process policy loading
+ *
+ * The policyset.h file contains the APIs which let a program register
+ * policy files the way "defdp -p" does without running defdp.
+ *
+ * @defgroup policyset Policy Sets
+ * @brief Pre-parsed policy files applied in-process
+ *
+ * POLICYSET_fnOpen returns a handle kept for the life of the program.
+ * POLICYSET_fnLoad parses a policy file once into a policy set cached by
+ * the handle, POLICYSET_fnApply registers the rules of a set with the
+ * server and commits them, replacing the rules committed before.
+ * POLICYSET_fnLoadFiles parses several files on a pool of threads into one
+ * set holding their rules in the order of the files.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include "defdp.h"
+
+/*==============================================================================
+                                  Types
+ =============================================================================*/
+
+/*! parsed policy file */
+typedef struct zPolicySet tzPolicySet;
+
+/*! handle of the policy loader */
+typedef struct zPolicySetLoader *POLICYSET_HANDLE;
+
+/*! policy file of POLICYSET_fnLoadFiles */
+typedef struct zPolicyFile
+{
+    /*! parser of the policy file */
+    PARSE_fnPolicyParser pfnParse;
+
+    /*! policy file */
+    char *pFilename;
+
+} tzPolicyFile;
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+POLICYSET_HANDLE POLICYSET_fnOpen( DP_HANDLE hDPRM );
+void POLICYSET_fnClose( POLICYSET_HANDLE hPolicySet );
+int POLICYSET_fnLoad( POLICYSET_HANDLE hPolicySet,
+                      PARSE_fnPolicyParser pfnParse,
+                      char *filename,
+                      tzPolicySet **ppSet );
+int POLICYSET_fnLoadFiles( POLICYSET_HANDLE hPolicySet,
+                           const tzPolicyFile *pFiles,
+                           int numFiles,
+                           int numThreads,
+                           tzPolicySet **ppSet );
+int POLICYSET_fnApply( POLICYSET_HANDLE hPolicySet, tzPolicySet *pSet );
+int POLICYSET_fnApplyFile( POLICYSET_HANDLE hPolicySet,
+                           PARSE_fnPolicyParser pfnParse,
+                           char *filename );
+int POLICYSET_fnNumRules( tzPolicySet *pSet );
+
+/*! @} */
+
+#endif /* POLICYSET_H_ */
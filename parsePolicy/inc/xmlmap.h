@@ -0,0 +1,96 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+#ifndef XMLMAP_H_
+#define XMLMAP_H_
+
+/*!
+ * @file xmlmap.h
+ * @brief Memory mapped XML input
+ *
+ * The xmlmap.h file contains the APIs the defdp parsers use to feed an
+ * input file to expat and to collect the character data of the elements.
+ *
+ * @defgroup xmlmap Mapped XML Input
+ * @brief XML files parsed from a private mapping
+ *
+ * XMLMAP_fnParseFile maps the input file and parses it in one pass.  The
+ * text of an element is kept as a slice of the mapping, terminated in
+ * place, and stays valid until the parse ends.  Only text which the parser
+ * decodes (character references, entities, CR LF line ends, files not in
+ * UTF-8) is copied, and that copy stays valid until XMLMAP_fnRelease.
+ */
+
+ /*! @{ */
+
+/*==============================================================================
+                                 Includes
+ =============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*==============================================================================
+                                  Types
+ =============================================================================*/
+
+/*! expat parser, see expat.h */
+struct XML_ParserStruct;
+
+/*! element text decoded by the parser */
+typedef struct zXmlDecoded tzXmlDecoded;
+
+/*! character data of the element being parsed */
+typedef struct zXmlText
+{
+    /*! parser reporting the character data */
+    struct XML_ParserStruct *parser;
+
+    /*! private writable mapping of the input file */
+    char *pBase;
+
+    /*! size of the input file */
+    size_t size;
+
+    /*! the input file was read into the heap, it could not be mapped */
+    bool copied;
+
+    /*! offset of the text in the input file */
+    size_t start;
+
+    /*! length of the text in the input file */
+    size_t length;
+
+    /*! the text is being decoded into pDecoded */
+    bool decoding;
+
+    /*! decoded texts since the last release, the newest first */
+    tzXmlDecoded *pDecoded;
+
+    /*! text of an empty element */
+    char empty[1];
+
+} tzXmlText;
+
+/*==============================================================================
+                           Function Declarations
+==============================================================================*/
+
+int XMLMAP_fnParseFile( struct XML_ParserStruct *parser,
+                        tzXmlText *pText,
+                        const char *filename );
+int XMLMAP_fnOpen( tzXmlText *pText, const char *filename );
+void XMLMAP_fnClose( tzXmlText *pText );
+void XMLMAP_fnStartElement( tzXmlText *pText );
+int XMLMAP_fnCharData( tzXmlText *pText, const char *s, int len );
+char *XMLMAP_fnEndElement( tzXmlText *pText );
+void XMLMAP_fnRelease( tzXmlText *pText );
+
+/*! @} */
+
+#endif /* XMLMAP_H_ */
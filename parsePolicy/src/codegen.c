@@ -0,0 +1,889 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+/*============================================================================*/
+/*!
+
+@file  codegen.c
+
+@brief
+    Generate native code for a policy rule set
+
+@details
+
+    This module collects the rules of a policy file instead of registering
+    them and writes a C file deciding the rule set the way the server does.
+    The decision is a switch over the rule types, then a switch over the
+    FNV-1a hash of the location confirmed by a string compare, with the
+    time, range and subject checks of the rule inlined.  Rule conditions
+    are kept as programs and run by the condition machine of the server.
+
+    The C file is built into a shared object which the server loads, see
+    policynative.h:
+
+        defdp -g policy.c -p policy.xml
+        qcc -shared -fPIC -O2 -I<dynPolAC/serverSide> ... -o policy.so policy.c
+        defdp -p policy.xml -L /path/to/policy.so
+
+    Like the server, the last rule of a type and location wins and a rule
+    whose name does not match its type never matches a data point.
+
+*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include "minicloud.h"
+#include "defdp.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+/*! number of rules added to the rule table at a time */
+#define CODEGEN_RULE_CHUNK        ( 256 )
+
+/*! maximum number of rules decided by one generated function */
+#define CODEGEN_RULES_PER_FUNCTION  ( 128 )
+
+/*! FNV-1a offset basis, must match POLICY_NATIVE_FNV_BASIS */
+#define CODEGEN_FNV_BASIS         ( 2166136261u )
+
+/*! FNV-1a prime, must match POLICY_NATIVE_FNV_PRIME */
+#define CODEGEN_FNV_PRIME         ( 16777619u )
+
+/*==============================================================================
+                                Enums
+==============================================================================*/
+
+/*! per rule tables of the generated code */
+typedef enum eCodegenTable
+{
+    /*! user lists of the rules */
+    CODEGEN_USERS = 0,
+
+    /*! group lists of the rules */
+    CODEGEN_GROUPS,
+
+    /*! condition programs of the rules */
+    CODEGEN_PROGRAMS
+
+} teCodegenTable;
+
+/*==============================================================================
+                              Data Structures
+==============================================================================*/
+
+/*! rule collected for the code generation */
+typedef struct zCodegenRule
+{
+    /*! policy rule, the location in lower case */
+    struct zPOLICY policy;
+
+    /*! FNV-1a hash of the location */
+    uint32_t hash;
+
+    /*! order of the rule in the policy file */
+    int seq;
+
+    /*! comma separated user list, empty for a wild card */
+    char *pUsers;
+
+    /*! comma separated group list, empty for a wild card */
+    char *pGroups;
+
+    /*! condition program, NULL if the rule has none */
+    tzPolicyProgram *pProgram;
+
+} tzCodegenRule;
+
+/*! rules of one type decided by one generated function */
+typedef struct zCodegenGroup
+{
+    /*! first rule of the group */
+    int first;
+
+    /*! last rule of the group */
+    int last;
+
+} tzCodegenGroup;
+
+/*==============================================================================
+                        Local/Private Function Protoypes
+==============================================================================*/
+
+static int codegen_fnCompare( const void *p1, const void *p2 );
+static bool codegen_fnIsAccessType( int type );
+static void codegen_fnString( FILE *fp, const char *pStr, size_t len );
+static void codegen_fnProgram( FILE *fp, int index, tzPolicyProgram *pProgram );
+static void codegen_fnRule( FILE *fp, int index, tzCodegenRule *pRule );
+static void codegen_fnGroup( FILE *fp, int index, tzCodegenGroup *pGroup );
+static void codegen_fnSearch( FILE *fp,
+                              tzCodegenGroup *pGroups,
+                              int low,
+                              int high,
+                              int indent );
+static void codegen_fnTable( FILE *fp,
+                             const char *pType,
+                             const char *pName,
+                             teCodegenTable table );
+static void codegen_fnRelease( tzCodegenRule *pRule );
+static void codegen_fnFree( void );
+
+/*==============================================================================
+                           Local/Private Variables
+==============================================================================*/
+
+/*! collected rules */
+static tzCodegenRule *pRules = NULL;
+
+/*! number of collected rules */
+static int numRules = 0;
+
+/*! size of the rule table */
+static int maxRules = 0;
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+//fn  PARSE_fnCodegenRule
+/*!
+
+@brief
+    Collect a complete policy rule for the code generation
+
+    Installed with PARSE_fnSetRuleHandler() in place of the registration
+    of the rule with the server.
+
+@param[in]
+    ptzPolicyData
+        policy parser state holding the complete rule
+
+@param[in]
+    pContext
+        not used
+
+@return
+    EOK - rule collected
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+int PARSE_fnCodegenRule( tzPolicyData *ptzPolicyData, void *pContext )
+{
+    tzCodegenRule *pRule;
+    tzCodegenRule *pNew;
+    unsigned char *p;
+
+    (void)pContext;
+
+    if( NULL == ptzPolicyData )
+    {
+        return EINVAL;
+    }
+
+    if( numRules == maxRules )
+    {
+        pNew = realloc( pRules,
+                        ( maxRules + CODEGEN_RULE_CHUNK ) *
+                        sizeof(tzCodegenRule) );
+        if( NULL == pNew )
+        {
+            return ENOMEM;
+        }
+        pRules = pNew;
+        maxRules += CODEGEN_RULE_CHUNK;
+    }
+
+    pRule = &pRules[ numRules ];
+    memset( pRule, 0, sizeof(tzCodegenRule) );
+    memcpy( &pRule->policy, &ptzPolicyData->policy, sizeof(struct zPOLICY) );
+    pRule->seq = numRules;
+
+    /* the server matches the location in lower case */
+    pRule->hash = CODEGEN_FNV_BASIS;
+    for( p = (unsigned char *)pRule->policy.Location; '\0' != *p; p++ )
+    {
+        *p = (unsigned char)tolower( *p );
+        pRule->hash = ( pRule->hash ^ *p ) * CODEGEN_FNV_PRIME;
+    }
+
+    pRule->pUsers = strdup( ptzPolicyData->userList );
+    pRule->pGroups = strdup( ptzPolicyData->groupList );
+    if( 0 != ptzPolicyData->program.numCode )
+    {
+        pRule->pProgram = malloc( sizeof(tzPolicyProgram) );
+        if( NULL != pRule->pProgram )
+        {
+            memcpy( pRule->pProgram,
+                    &ptzPolicyData->program,
+                    sizeof(tzPolicyProgram) );
+            pRule->pProgram->magic = POLICY_PROGRAM_MAGIC;
+        }
+    }
+
+    if( ( NULL == pRule->pUsers ) ||
+        ( NULL == pRule->pGroups ) ||
+        ( ( 0 != ptzPolicyData->program.numCode ) &&
+          ( NULL == pRule->pProgram ) ) )
+    {
+        free( pRule->pUsers );
+        free( pRule->pGroups );
+        free( pRule->pProgram );
+        return ENOMEM;
+    }
+
+    numRules++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  PARSE_fnCodegenWrite
+/*!
+
+@brief
+    Write the native code of the collected rules
+
+    The collected rules are released, whether the code could be written
+    or not.
+
+@param[in]
+    pOutFile
+        name of the C file to write
+
+@param[in]
+    pSource
+        name of the policy file, for the file header
+
+@return
+    EOK - code written
+    EINVAL - invalid argument specified
+    EIO - the file could not be written
+
+*/
+/*============================================================================*/
+int PARSE_fnCodegenWrite( const char *pOutFile, const char *pSource )
+{
+    FILE *fp;
+    tzCodegenGroup *pGroups;
+    int numGroups;
+    int i;
+    int j;
+    int n;
+    int type;
+    uint32_t hash;
+    int ret = EOK;
+
+    if( NULL == pOutFile )
+    {
+        codegen_fnFree();
+        return EINVAL;
+    }
+
+    /* order by type, hash and location, the last duplicate wins */
+    if( numRules > 0 )
+    {
+        qsort( pRules, numRules, sizeof(tzCodegenRule), codegen_fnCompare );
+    }
+
+    /* the server looks the rule up by the name matching the type */
+    n = 0;
+    for( i = 0; i < numRules; i++ )
+    {
+        if( ( POLICY_TYPE_INVALID == pRules[i].policy.Type ) ||
+            ( pRules[i].policy.Name !=
+              ( codegen_fnIsAccessType( pRules[i].policy.Type )
+                ? POLICY_NAME_ACCESS
+                : POLICY_NAME_COMP ) ) )
+        {
+            codegen_fnRelease( &pRules[i] );
+            continue;
+        }
+
+        pRules[n++] = pRules[i];
+    }
+    numRules = n;
+
+    /* a later rule of the same type and location replaces the earlier */
+    n = 0;
+    for( i = 0; i < numRules; i++ )
+    {
+        if( ( i + 1 < numRules ) &&
+            ( pRules[i].policy.Type == pRules[i+1].policy.Type ) &&
+            ( 0 == strcmp( pRules[i].policy.Location,
+                           pRules[i+1].policy.Location ) ) )
+        {
+            codegen_fnRelease( &pRules[i] );
+            continue;
+        }
+
+        pRules[n++] = pRules[i];
+    }
+    numRules = n;
+
+    /* at most one group per rule */
+    pGroups = calloc( numRules + 1, sizeof(tzCodegenGroup) );
+    if( NULL == pGroups )
+    {
+        codegen_fnFree();
+        return ENOMEM;
+    }
+
+    fp = fopen( pOutFile, "w" );
+    if( NULL == fp )
+    {
+        fprintf( stderr, "unable to open %s\n", pOutFile );
+        free( pGroups );
+        codegen_fnFree();
+        return EIO;
+    }
+
+    fprintf( fp,
+             "/* native policy rule set generated by defdp -g from %s\n"
+             " * do not edit, regenerate it when the policy file changes */\n"
+             "\n"
+             "#include <stddef.h>\n"
+             "#include <string.h>\n"
+             "#include <errno.h>\n"
+             "#include \"policynative.h\"\n"
+             "\n"
+             "#define NUM_RULES ( %d )\n"
+             "\n"
+             "static const tzPolicyNativeHost *pHost = NULL;\n"
+             "static tzSubjectSet userSet[ NUM_RULES + 1 ];\n"
+             "static tzSubjectSet groupSet[ NUM_RULES + 1 ];\n"
+             "static tzPolicyProgram *pPrograms[ NUM_RULES + 1 ];\n"
+             "\n",
+             ( NULL != pSource ) ? pSource : "a policy file",
+             n );
+
+    /* same bound check as the server, the arrays are checked by the server */
+    fprintf( fp,
+             "static inline int native_fnInRange( const struct dp_t *pDp,\n"
+             "                                    int min,\n"
+             "                                    int max )\n"
+             "{\n"
+             "    switch( pDp->dpdata.type )\n"
+             "    {\n"
+             "    case DP_TYPE_UINT16:\n"
+             "        return ( pDp->dpdata.val.uiVal >= min ) &&\n"
+             "               ( pDp->dpdata.val.uiVal <= max );\n"
+             "    case DP_TYPE_SINT16:\n"
+             "        return ( pDp->dpdata.val.siVal >= min ) &&\n"
+             "               ( pDp->dpdata.val.siVal <= max );\n"
+             "    case DP_TYPE_UINT32:\n"
+             "        return ( pDp->dpdata.val.ulVal >= min ) &&\n"
+             "               ( pDp->dpdata.val.ulVal <= max );\n"
+             "    case DP_TYPE_SINT32:\n"
+             "        return ( pDp->dpdata.val.slVal >= min ) &&\n"
+             "               ( pDp->dpdata.val.slVal <= max );\n"
+             "    case DP_TYPE_FLOAT32:\n"
+             "        return ( pDp->dpdata.val.fVal >= min ) &&\n"
+             "               ( pDp->dpdata.val.fVal <= max );\n"
+             "    default:\n"
+             "        return pHost->pInRange( pDp, min, max );\n"
+             "    }\n"
+             "}\n"
+             "\n" );
+
+    for( i = 0; i < n; i++ )
+    {
+        if( NULL != pRules[i].pProgram )
+        {
+            codegen_fnProgram( fp, i, pRules[i].pProgram );
+        }
+    }
+
+    /* subject lists and conditions of the rules, NULL if they have none */
+    codegen_fnTable( fp, "const char * const", "userLists", CODEGEN_USERS );
+    codegen_fnTable( fp, "const char * const", "groupLists", CODEGEN_GROUPS );
+    codegen_fnTable( fp,
+                     "const tzPolicyProgram * const",
+                     "programInit",
+                     CODEGEN_PROGRAMS );
+
+    /* intern the subjects and load the conditions, a rule refused by the
+     * server fails the load, and release them when unloaded */
+    fprintf( fp,
+             "static int native_fnInit( const tzPolicyNativeHost *pH )\n"
+             "{\n"
+             "    int i;\n"
+             "    pHost = pH;\n"
+             "    for( i = 0; i < NUM_RULES; i++ )\n"
+             "    {\n"
+             "        if( ( NULL != userLists[i] ) &&\n"
+             "            ( EOK != pH->pInternSet( eSubjectUser, userLists[i], &userSet[i] ) ) )\n"
+             "            return EINVAL;\n"
+             "        if( ( NULL != groupLists[i] ) &&\n"
+             "            ( EOK != pH->pInternSet( eSubjectGroup, groupLists[i], &groupSet[i] ) ) )\n"
+             "            return EINVAL;\n"
+             "        if( NULL != programInit[i] )\n"
+             "        {\n"
+             "            pPrograms[i] = pH->pLoadProgram( programInit[i] );\n"
+             "            if( NULL == pPrograms[i] ) return EINVAL;\n"
+             "        }\n"
+             "    }\n"
+             "    return EOK;\n"
+             "}\n"
+             "\n"
+             "static void native_fnFini( void )\n"
+             "{\n"
+             "    int i;\n"
+             "    for( i = 0; ( NULL != pHost ) && ( i < NUM_RULES ); i++ )\n"
+             "    {\n"
+             "        pHost->pFreeSet( &userSet[i] );\n"
+             "        pHost->pFreeSet( &groupSet[i] );\n"
+             "        if( NULL != pPrograms[i] )\n"
+             "        {\n"
+             "            pHost->pFreeProgram( pPrograms[i] );\n"
+             "            pPrograms[i] = NULL;\n"
+             "        }\n"
+             "    }\n"
+             "}\n"
+             "\n" );
+
+    /* the rules of a type are split by location hash into functions of a
+     * bounded size, the compile time grows faster than the function size */
+    numGroups = 0;
+    for( i = 0; i < numRules; )
+    {
+        pGroups[ numGroups ].first = i;
+        type = pRules[i].policy.Type;
+        while( ( i < numRules ) && ( type == pRules[i].policy.Type ) )
+        {
+            hash = pRules[i].hash;
+            while( ( i < numRules ) &&
+                   ( type == pRules[i].policy.Type ) &&
+                   ( hash == pRules[i].hash ) )
+            {
+                i++;
+            }
+
+            if( i - pGroups[ numGroups ].first >= CODEGEN_RULES_PER_FUNCTION )
+            {
+                break;
+            }
+        }
+        pGroups[ numGroups ].last = i - 1;
+        codegen_fnGroup( fp, numGroups, &pGroups[ numGroups ] );
+        numGroups++;
+    }
+
+    /* the decision, a switch over the types then a search of the groups */
+    fprintf( fp,
+             "static int native_fnDecide( const tzPolicyNativeQuery *q )\n"
+             "{\n"
+             "    switch( q->typeInt )\n"
+             "    {\n" );
+    for( i = 0; i < numGroups; i = j )
+    {
+        type = pRules[ pGroups[i].first ].policy.Type;
+        j = i + 1;
+        while( ( j < numGroups ) &&
+               ( type == pRules[ pGroups[j].first ].policy.Type ) )
+        {
+            j++;
+        }
+
+        fprintf( fp, "    case %d:\n", type );
+        codegen_fnSearch( fp, pGroups, i, j - 1, 2 );
+    }
+    fprintf( fp,
+             "    }\n"
+             "    return EACCES;\n"
+             "}\n"
+             "\n"
+             "const tzPolicyNative policy_native =\n"
+             "{\n"
+             "    POLICY_NATIVE_ABI,\n"
+             "    NUM_RULES,\n"
+             "    native_fnInit,\n"
+             "    native_fnFini,\n"
+             "    native_fnDecide\n"
+             "};\n" );
+
+    if( 0 != fclose( fp ) )
+    {
+        ret = EIO;
+    }
+
+    free( pGroups );
+    codegen_fnFree();
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Order the rules by type, location hash, location and file order
+
+*/
+/*============================================================================*/
+static int codegen_fnCompare( const void *p1, const void *p2 )
+{
+    const tzCodegenRule *pRule1 = p1;
+    const tzCodegenRule *pRule2 = p2;
+    int cmp;
+
+    if( pRule1->policy.Type != pRule2->policy.Type )
+    {
+        return ( pRule1->policy.Type < pRule2->policy.Type ) ? -1 : 1;
+    }
+
+    if( pRule1->hash != pRule2->hash )
+    {
+        return ( pRule1->hash < pRule2->hash ) ? -1 : 1;
+    }
+
+    cmp = strcmp( pRule1->policy.Location, pRule2->policy.Location );
+    if( 0 != cmp )
+    {
+        return cmp;
+    }
+
+    return pRule1->seq - pRule2->seq;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Test if the server checks a type with the accessor rule
+
+*/
+/*============================================================================*/
+static bool codegen_fnIsAccessType( int type )
+{
+    return ( POLICY_TYPE_PASS == type ) ||
+           ( POLICY_TYPE_HEAD == type ) ||
+           ( POLICY_TYPE_FUEL == type );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Write a C string literal, the characters are escaped in octal
+
+*/
+/*============================================================================*/
+static void codegen_fnString( FILE *fp, const char *pStr, size_t len )
+{
+    size_t i;
+    unsigned char c;
+
+    fputc( '"', fp );
+    for( i = 0; i < len; i++ )
+    {
+        c = (unsigned char)pStr[i];
+        if( isalnum( c ) || ( ' ' == c ) || ( ',' == c ) || ( '.' == c ) ||
+            ( '_' == c ) || ( '-' == c ) || ( ':' == c ) || ( '/' == c ) )
+        {
+            fputc( c, fp );
+        }
+        else
+        {
+            fprintf( fp, "\\%03o", c );
+        }
+    }
+    fputc( '"', fp );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Write the initializer of a condition program
+
+*/
+/*============================================================================*/
+static void codegen_fnProgram( FILE *fp, int index, tzPolicyProgram *pProgram )
+{
+    size_t namesLen = sizeof(pProgram->names);
+    int i;
+
+    fprintf( fp,
+             "static const tzPolicyProgram program%d =\n"
+             "{\n"
+             "    0x%08Xu, %u, %u, 0u,\n"
+             "    {",
+             index,
+             (unsigned)pProgram->magic,
+             (unsigned)pProgram->numCode,
+             (unsigned)pProgram->numConst );
+
+    for( i = 0; i < pProgram->numCode; i++ )
+    {
+        fprintf( fp, "%s0x%08Xu", ( i > 0 ) ? ", " : " ", pProgram->code[i] );
+    }
+    fprintf( fp, " },\n    {" );
+
+    for( i = 0; i < pProgram->numConst; i++ )
+    {
+        fprintf( fp, "%s%.17g", ( i > 0 ) ? ", " : " ", pProgram->konst[i] );
+    }
+    if( 0 == pProgram->numConst )
+    {
+        fprintf( fp, " 0.0" );
+    }
+    fprintf( fp, " },\n    " );
+
+    /* the name lists are nul separated, keep up to the last one */
+    while( ( namesLen > 0 ) && ( '\0' == pProgram->names[ namesLen - 1 ] ) )
+    {
+        namesLen--;
+    }
+    codegen_fnString( fp, pProgram->names, namesLen );
+
+    fprintf( fp,
+             "\n"
+             "};\n"
+             "\n" );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Write the function deciding a group of rules, a switch over the
+    location hashes
+
+*/
+/*============================================================================*/
+static void codegen_fnGroup( FILE *fp, int index, tzCodegenGroup *pGroup )
+{
+    uint32_t hash;
+    int i;
+
+    fprintf( fp,
+             "static int native_fnDecide%d( const tzPolicyNativeQuery *q )\n"
+             "{\n"
+             "    switch( q->locationHash )\n"
+             "    {\n",
+             index );
+
+    for( i = pGroup->first; i <= pGroup->last; )
+    {
+        hash = pRules[i].hash;
+        fprintf( fp, "    case 0x%08Xu:\n", hash );
+        while( ( i <= pGroup->last ) && ( hash == pRules[i].hash ) )
+        {
+            codegen_fnRule( fp, i, &pRules[i] );
+            i++;
+        }
+        fprintf( fp, "        break;\n" );
+    }
+
+    fprintf( fp,
+             "    }\n"
+             "    return EACCES;\n"
+             "}\n"
+             "\n" );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Write a binary search of the groups of a type by the location hash
+
+*/
+/*============================================================================*/
+static void codegen_fnSearch( FILE *fp,
+                              tzCodegenGroup *pGroups,
+                              int low,
+                              int high,
+                              int indent )
+{
+    int mid;
+
+    if( low == high )
+    {
+        fprintf( fp,
+                 "%*sreturn native_fnDecide%d( q );\n",
+                 indent * 4, "",
+                 low );
+        return;
+    }
+
+    mid = ( low + high ) / 2;
+    fprintf( fp,
+             "%*sif( q->locationHash <= 0x%08Xu )\n"
+             "%*s{\n",
+             indent * 4, "",
+             pRules[ pGroups[mid].last ].hash,
+             indent * 4, "" );
+    codegen_fnSearch( fp, pGroups, low, mid, indent + 1 );
+    fprintf( fp, "%*s}\n", indent * 4, "" );
+    codegen_fnSearch( fp, pGroups, mid + 1, high, indent );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Write the inlined checks of a rule, in the order of the server
+
+*/
+/*============================================================================*/
+static void codegen_fnRule( FILE *fp, int index, tzCodegenRule *pRule )
+{
+    fprintf( fp, "        if( 0 == strcmp( q->location, " );
+    codegen_fnString( fp,
+                      pRule->policy.Location,
+                      strlen( pRule->policy.Location ) );
+    fprintf( fp, " ) )\n        {\n" );
+
+    if( 0 != pRule->policy.time.tv_sec )
+    {
+        fprintf( fp,
+                 "            if( q->dpTime < (time_t)%lld ) "
+                 "return EACCES;\n",
+                 (long long)pRule->policy.time.tv_sec );
+    }
+
+    if( ( POLICY_NAME_COMP == pRule->policy.Name ) &&
+        ( 0 != pRule->policy.min ) &&
+        ( 0 != pRule->policy.max ) )
+    {
+        fprintf( fp,
+                 "            if( !native_fnInRange( q->pDp, %d, %d ) ) "
+                 "return EACCES;\n",
+                 (int)pRule->policy.min,
+                 (int)pRule->policy.max );
+    }
+
+    if( '\0' != pRule->pUsers[0] )
+    {
+        fprintf( fp,
+                 "            if( !SUBJECT_MATCH( &userSet[%d], "
+                 "q->pUsers ) ) return EACCES;\n",
+                 index );
+    }
+
+    if( '\0' != pRule->pGroups[0] )
+    {
+        fprintf( fp,
+                 "            if( !SUBJECT_MATCH( &groupSet[%d], "
+                 "q->pGroups ) ) return EACCES;\n",
+                 index );
+    }
+
+    if( NULL != pRule->pProgram )
+    {
+        fprintf( fp,
+                 "            if( !pHost->pRunProgram( pPrograms[%d], "
+                 "q->pDp, q->pUsers, q->pGroups ) ) return EACCES;\n",
+                 index );
+    }
+
+    fprintf( fp,
+             "            return EOK;\n"
+             "        }\n" );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Write a per rule table, the entry of a rule without the data is NULL
+
+*/
+/*============================================================================*/
+static void codegen_fnTable( FILE *fp,
+                             const char *pType,
+                             const char *pName,
+                             teCodegenTable table )
+{
+    tzCodegenRule *pRule;
+    int i;
+
+    fprintf( fp, "static %s %s[ NUM_RULES + 1 ] =\n{\n", pType, pName );
+
+    for( i = 0; i < numRules; i++ )
+    {
+        pRule = &pRules[i];
+        fprintf( fp, "    " );
+
+        if( ( CODEGEN_USERS == table ) && ( '\0' != pRule->pUsers[0] ) )
+        {
+            codegen_fnString( fp, pRule->pUsers, strlen( pRule->pUsers ) );
+        }
+        else if( ( CODEGEN_GROUPS == table ) &&
+                 ( '\0' != pRule->pGroups[0] ) )
+        {
+            codegen_fnString( fp, pRule->pGroups, strlen( pRule->pGroups ) );
+        }
+        else if( ( CODEGEN_PROGRAMS == table ) && ( NULL != pRule->pProgram ) )
+        {
+            fprintf( fp, "&program%d", i );
+        }
+        else
+        {
+            fprintf( fp, "NULL" );
+        }
+
+        fprintf( fp, ",\n" );
+    }
+
+    fprintf( fp, "    NULL\n};\n\n" );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Release the lists and the program of a rule
+
+*/
+/*============================================================================*/
+static void codegen_fnRelease( tzCodegenRule *pRule )
+{
+    free( pRule->pUsers );
+    free( pRule->pGroups );
+    free( pRule->pProgram );
+    pRule->pUsers = NULL;
+    pRule->pGroups = NULL;
+    pRule->pProgram = NULL;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Release the collected rules
+
+*/
+/*============================================================================*/
+static void codegen_fnFree( void )
+{
+    int i;
+
+    for( i = 0; i < numRules; i++ )
+    {
+        codegen_fnRelease( &pRules[i] );
+    }
+
+    free( pRules );
+    pRules = NULL;
+    numRules = 0;
+    maxRules = 0;
+}
@@ -0,0 +1,830 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+/*============================================================================*/
+/*!
+
+@file  condition.c
+
+@brief
+    Compile policy rule conditions
+
+@details
+
+    This module compiles the <condition> element of a policy rule into the
+    bytecode program described in policyprog.h.  The condition grammar is:
+
+        condition  := and { "or" and }
+        and        := unary { "and" unary }
+        unary      := "not" unary
+                    | "(" condition ")"
+                    | subject "in" "(" name { "," name } ")"
+                    | operand relation operand
+        subject    := "user" | "group"
+        operand    := "value" | "age" | "delta" | number
+        relation   := "lt" | "le" | "gt" | "ge" | "eq" | "ne"
+                    | "<"  | "<=" | ">"  | ">=" | "==" | "!="
+
+    age is the age of the data point value in seconds and delta is the
+    change of the value since the previous check of the data point.
+    The word relations avoid escaping '<' in the XML file, e.g.
+
+        <condition>value ge 10 and value le 20 and age lt 60</condition>
+
+    A condition which is only "value ge A and value le B" with non zero
+    integers is folded into the min and max of a comparator rule, so the
+    server checks it with the plain bound check instead of a program.
+
+*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include "minicloud.h"
+#include "defdp.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+/*! maximum number of nodes of a condition syntax tree */
+#define COND_MAX_NODES    ( 64 )
+
+/*! no node */
+#define COND_NONE         ( -1 )
+
+/*==============================================================================
+                                Enums
+==============================================================================*/
+
+/*! condition syntax tree node kinds */
+typedef enum eCondKind
+{
+    eCondNumber = 0,
+    eCondValue,
+    eCondAge,
+    eCondDelta,
+    eCondCompare,
+    eCondAnd,
+    eCondOr,
+    eCondNot,
+    eCondUser,
+    eCondGroup
+
+} teCondKind;
+
+/*=============================================================================
+                              Structures
+==============================================================================*/
+
+/*! condition syntax tree node */
+typedef struct zCondNode
+{
+    /*! node kind */
+    teCondKind kind;
+
+    /*! POLICY_OP_xx relation of a comparison */
+    int op;
+
+    /*! value of a number */
+    double number;
+
+    /*! offset of the name list of a subject test */
+    uint16_t names;
+
+    /*! left operand or the only operand */
+    int left;
+
+    /*! right operand */
+    int right;
+
+} tzCondNode;
+
+/*! condition compiler state */
+typedef struct zCondParser
+{
+    /*! next character of the condition text */
+    const char *p;
+
+    /*! syntax tree nodes */
+    tzCondNode nodes[ COND_MAX_NODES ];
+
+    /*! number of syntax tree nodes */
+    int numNodes;
+
+    /*! program being compiled */
+    tzPolicyProgram *pProgram;
+
+    /*! used length of the program name lists */
+    size_t namesLen;
+
+    /*! description of the first error, NULL if none */
+    const char *pError;
+
+} tzCondParser;
+
+/*! relation keyword */
+typedef struct zCondRelation
+{
+    /*! keyword of the relation */
+    const char *pWord;
+
+    /*! POLICY_OP_xx of the relation */
+    int op;
+
+} tzCondRelation;
+
+/*==============================================================================
+                        Local/Private Function Protoypes
+==============================================================================*/
+
+static int cond_fnOr( tzCondParser *pParser );
+static int cond_fnAnd( tzCondParser *pParser );
+static int cond_fnUnary( tzCondParser *pParser );
+static int cond_fnOperand( tzCondParser *pParser );
+static int cond_fnSubject( tzCondParser *pParser, teCondKind kind );
+static int cond_fnNode( tzCondParser *pParser,
+                        teCondKind kind,
+                        int left,
+                        int right );
+static bool cond_fnAccept( tzCondParser *pParser, const char *pWord );
+static void cond_fnSkipSpace( tzCondParser *pParser );
+static bool cond_fnEmit( tzCondParser *pParser, int node, int reg );
+static bool cond_fnFold( tzCondParser *pParser,
+                         int node,
+                         struct zPOLICY *pPolicy );
+static bool cond_fnBound( tzCondParser *pParser,
+                          int node,
+                          bool lower,
+                          double *pBound );
+static void cond_fnDeny( tzPolicyProgram *pProgram );
+
+/*==============================================================================
+                           Local/Private Constants
+==============================================================================*/
+
+/*! relations, the two character symbols are before their one character
+ *  prefixes */
+static const tzCondRelation relations[] =
+{
+    { "<=", POLICY_OP_LE },
+    { ">=", POLICY_OP_GE },
+    { "==", POLICY_OP_EQ },
+    { "!=", POLICY_OP_NE },
+    { "<",  POLICY_OP_LT },
+    { ">",  POLICY_OP_GT },
+    { "lt", POLICY_OP_LT },
+    { "le", POLICY_OP_LE },
+    { "gt", POLICY_OP_GT },
+    { "ge", POLICY_OP_GE },
+    { "eq", POLICY_OP_EQ },
+    { "ne", POLICY_OP_NE },
+    { NULL, 0 }
+};
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+//fn  PARSE_fnCompileCondition
+/*!
+
+@brief
+    Compile the condition of a policy rule
+
+    On a syntax error the program is set to always fail, so a rule whose
+    condition cannot be compiled never permits more than intended.
+
+@param[in]
+    pText
+        condition text of the <condition> element
+
+@param[in,out]
+    pPolicy
+        policy rule, its min and max receive a folded value range
+
+@param[out]
+    pProgram
+        compiled program, numCode is 0 if the condition was folded or empty
+
+@return
+    EOK - condition compiled
+    EINVAL - syntax error in the condition
+
+*/
+/*============================================================================*/
+int PARSE_fnCompileCondition( const char *pText,
+                              struct zPOLICY *pPolicy,
+                              tzPolicyProgram *pProgram )
+{
+    tzCondParser parser;
+    int root;
+
+    if( ( NULL == pText ) || ( NULL == pPolicy ) || ( NULL == pProgram ) )
+    {
+        return EINVAL;
+    }
+
+    memset( pProgram, 0, sizeof(tzPolicyProgram) );
+    memset( &parser, 0, sizeof(parser) );
+    parser.p = pText;
+    parser.pProgram = pProgram;
+
+    /* an empty condition is no condition */
+    cond_fnSkipSpace( &parser );
+    if( '\0' == *parser.p )
+    {
+        return EOK;
+    }
+
+    root = cond_fnOr( &parser );
+    cond_fnSkipSpace( &parser );
+    if( ( NULL == parser.pError ) && ( '\0' != *parser.p ) )
+    {
+        parser.pError = "unexpected text";
+    }
+
+    if( NULL == parser.pError )
+    {
+        if( false == cond_fnFold( &parser, root, pPolicy ) )
+        {
+            if( cond_fnEmit( &parser, root, 0 ) &&
+                ( pProgram->numCode < POLICY_PROGRAM_MAX_CODE ) )
+            {
+                pProgram->code[ pProgram->numCode++ ] =
+                        POLICY_INSN( POLICY_OP_RET, 0, 0, 0 );
+            }
+            else if( NULL == parser.pError )
+            {
+                parser.pError = "condition too complex";
+            }
+        }
+    }
+
+    if( NULL != parser.pError )
+    {
+        fprintf( stderr,
+                 "condition error: %s at \"%s\"\n",
+                 parser.pError,
+                 parser.p );
+        cond_fnDeny( pProgram );
+        return EINVAL;
+    }
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    condition := and { "or" and }
+
+*/
+/*============================================================================*/
+static int cond_fnOr( tzCondParser *pParser )
+{
+    int node = cond_fnAnd( pParser );
+
+    while( ( NULL == pParser->pError ) && cond_fnAccept( pParser, "or" ) )
+    {
+        node = cond_fnNode( pParser, eCondOr, node, cond_fnAnd( pParser ) );
+    }
+
+    return node;
+}
+
+/*============================================================================*/
+/*!
+
+    and := unary { "and" unary }
+
+*/
+/*============================================================================*/
+static int cond_fnAnd( tzCondParser *pParser )
+{
+    int node = cond_fnUnary( pParser );
+
+    while( ( NULL == pParser->pError ) && cond_fnAccept( pParser, "and" ) )
+    {
+        node = cond_fnNode( pParser, eCondAnd, node, cond_fnUnary( pParser ) );
+    }
+
+    return node;
+}
+
+/*============================================================================*/
+/*!
+
+    unary := "not" unary | "(" condition ")" | subject test | comparison
+
+*/
+/*============================================================================*/
+static int cond_fnUnary( tzCondParser *pParser )
+{
+    int node = COND_NONE;
+    int i;
+
+    if( cond_fnAccept( pParser, "not" ) )
+    {
+        node = cond_fnNode( pParser,
+                            eCondNot,
+                            cond_fnUnary( pParser ),
+                            COND_NONE );
+    }
+    else if( cond_fnAccept( pParser, "(" ) )
+    {
+        node = cond_fnOr( pParser );
+        if( false == cond_fnAccept( pParser, ")" ) )
+        {
+            pParser->pError = "missing )";
+        }
+    }
+    else if( cond_fnAccept( pParser, "user" ) )
+    {
+        node = cond_fnSubject( pParser, eCondUser );
+    }
+    else if( cond_fnAccept( pParser, "group" ) )
+    {
+        node = cond_fnSubject( pParser, eCondGroup );
+    }
+    else
+    {
+        node = cond_fnNode( pParser,
+                            eCondCompare,
+                            cond_fnOperand( pParser ),
+                            COND_NONE );
+
+        for( i = 0; NULL != relations[i].pWord; i++ )
+        {
+            if( cond_fnAccept( pParser, relations[i].pWord ) )
+            {
+                break;
+            }
+        }
+
+        if( NULL == relations[i].pWord )
+        {
+            pParser->pError = "expected a relation";
+        }
+        else if( COND_NONE != node )
+        {
+            pParser->nodes[node].op = relations[i].op;
+            pParser->nodes[node].right = cond_fnOperand( pParser );
+        }
+    }
+
+    return node;
+}
+
+/*============================================================================*/
+/*!
+
+    operand := "value" | "age" | "delta" | number
+
+*/
+/*============================================================================*/
+static int cond_fnOperand( tzCondParser *pParser )
+{
+    int node = COND_NONE;
+    char *pEnd = NULL;
+    double number;
+
+    if( cond_fnAccept( pParser, "value" ) )
+    {
+        node = cond_fnNode( pParser, eCondValue, COND_NONE, COND_NONE );
+    }
+    else if( cond_fnAccept( pParser, "age" ) )
+    {
+        node = cond_fnNode( pParser, eCondAge, COND_NONE, COND_NONE );
+    }
+    else if( cond_fnAccept( pParser, "delta" ) )
+    {
+        node = cond_fnNode( pParser, eCondDelta, COND_NONE, COND_NONE );
+    }
+    else
+    {
+        cond_fnSkipSpace( pParser );
+        number = strtod( pParser->p, &pEnd );
+        if( pEnd == pParser->p )
+        {
+            pParser->pError = "expected value, age, delta or a number";
+        }
+        else
+        {
+            pParser->p = pEnd;
+            node = cond_fnNode( pParser, eCondNumber, COND_NONE, COND_NONE );
+            if( COND_NONE != node )
+            {
+                pParser->nodes[node].number = number;
+            }
+        }
+    }
+
+    return node;
+}
+
+/*============================================================================*/
+/*!
+
+    subject "in" "(" name { "," name } ")"
+
+    The names are stored in the program name lists as a comma separated
+    list which the server interns to a subject set.
+
+*/
+/*============================================================================*/
+static int cond_fnSubject( tzCondParser *pParser, teCondKind kind )
+{
+    tzPolicyProgram *pProgram = pParser->pProgram;
+    int node = COND_NONE;
+    size_t start = pParser->namesLen;
+    size_t len;
+
+    if( ( false == cond_fnAccept( pParser, "in" ) ) ||
+        ( false == cond_fnAccept( pParser, "(" ) ) )
+    {
+        pParser->pError = "expected in (";
+        return COND_NONE;
+    }
+
+    do
+    {
+        cond_fnSkipSpace( pParser );
+        len = 0;
+        while( isalnum( (unsigned char)pParser->p[len] ) ||
+               ( NULL != strchr( "_.-@", pParser->p[len] ) &&
+                 ( '\0' != pParser->p[len] ) ) )
+        {
+            len++;
+        }
+
+        if( 0 == len )
+        {
+            pParser->pError = "expected a name";
+            return COND_NONE;
+        }
+
+        /* room for the name, a comma or the terminator */
+        if( pParser->namesLen + len + 1 >= POLICY_PROGRAM_NAMES_LENGTH )
+        {
+            pParser->pError = "too many names";
+            return COND_NONE;
+        }
+
+        if( pParser->namesLen > start )
+        {
+            pProgram->names[ pParser->namesLen - 1 ] = ',';
+        }
+        memcpy( &pProgram->names[ pParser->namesLen ], pParser->p, len );
+        pParser->namesLen += len;
+        pProgram->names[ pParser->namesLen++ ] = '\0';
+        pParser->p += len;
+
+    } while( cond_fnAccept( pParser, "," ) );
+
+    if( false == cond_fnAccept( pParser, ")" ) )
+    {
+        pParser->pError = "missing )";
+        return COND_NONE;
+    }
+
+    node = cond_fnNode( pParser, kind, COND_NONE, COND_NONE );
+    if( COND_NONE != node )
+    {
+        pParser->nodes[node].names = (uint16_t)start;
+    }
+
+    return node;
+}
+
+/*============================================================================*/
+/*!
+
+    Allocate a syntax tree node
+
+@return
+    index of the node, COND_NONE on error
+
+*/
+/*============================================================================*/
+static int cond_fnNode( tzCondParser *pParser,
+                        teCondKind kind,
+                        int left,
+                        int right )
+{
+    tzCondNode *pNode;
+
+    if( NULL != pParser->pError )
+    {
+        return COND_NONE;
+    }
+
+    if( pParser->numNodes >= COND_MAX_NODES )
+    {
+        pParser->pError = "condition too long";
+        return COND_NONE;
+    }
+
+    pNode = &pParser->nodes[ pParser->numNodes ];
+    memset( pNode, 0, sizeof(tzCondNode) );
+    pNode->kind = kind;
+    pNode->left = left;
+    pNode->right = right;
+
+    return pParser->numNodes++;
+}
+
+/*============================================================================*/
+/*!
+
+    Consume a keyword or a symbol if it is next in the condition
+
+    Keywords are case insensitive and must not be followed by a letter or
+    a digit.
+
+@return
+    true if the keyword or symbol was consumed
+
+*/
+/*============================================================================*/
+static bool cond_fnAccept( tzCondParser *pParser, const char *pWord )
+{
+    size_t len = strlen( pWord );
+
+    cond_fnSkipSpace( pParser );
+
+    if( 0 != strncasecmp( pParser->p, pWord, len ) )
+    {
+        return false;
+    }
+
+    if( isalpha( (unsigned char)pWord[0] ) &&
+        ( isalnum( (unsigned char)pParser->p[len] ) ||
+          ( '_' == pParser->p[len] ) ) )
+    {
+        return false;
+    }
+
+    pParser->p += len;
+
+    return true;
+}
+
+/*============================================================================*/
+/*!
+
+    Skip the white space of the condition
+
+*/
+/*============================================================================*/
+static void cond_fnSkipSpace( tzCondParser *pParser )
+{
+    while( isspace( (unsigned char)*pParser->p ) )
+    {
+        pParser->p++;
+    }
+}
+
+/*============================================================================*/
+/*!
+
+    Emit the instructions of a syntax tree node
+
+    The result of the node is left in the register reg, the operands use
+    the registers above it.
+
+@return
+    true on success, false if the program or the registers are exhausted
+
+*/
+/*============================================================================*/
+static bool cond_fnEmit( tzCondParser *pParser, int node, int reg )
+{
+    tzPolicyProgram *pProgram = pParser->pProgram;
+    tzCondNode *pNode;
+    uint32_t insn = 0;
+    int op = 0;
+    int k;
+
+    if( ( COND_NONE == node ) ||
+        ( reg + 1 >= POLICY_PROGRAM_REGISTERS ) ||
+        ( pProgram->numCode >= POLICY_PROGRAM_MAX_CODE ) )
+    {
+        return false;
+    }
+
+    pNode = &pParser->nodes[node];
+
+    switch( pNode->kind )
+    {
+    case eCondNumber:
+        /* share equal constants */
+        for( k = 0; k < pProgram->numConst; k++ )
+        {
+            if( pProgram->konst[k] == pNode->number )
+            {
+                break;
+            }
+        }
+
+        if( k == pProgram->numConst )
+        {
+            if( k >= POLICY_PROGRAM_MAX_CONST )
+            {
+                return false;
+            }
+            pProgram->konst[ pProgram->numConst++ ] = pNode->number;
+        }
+        insn = POLICY_INSN_IMM( POLICY_OP_LDK, reg, k );
+        break;
+
+    case eCondValue:
+        insn = POLICY_INSN( POLICY_OP_LDVAL, reg, 0, 0 );
+        break;
+
+    case eCondAge:
+        insn = POLICY_INSN( POLICY_OP_LDAGE, reg, 0, 0 );
+        break;
+
+    case eCondDelta:
+        insn = POLICY_INSN( POLICY_OP_LDDELTA, reg, 0, 0 );
+        break;
+
+    case eCondUser:
+        insn = POLICY_INSN_IMM( POLICY_OP_INUSER, reg, pNode->names );
+        break;
+
+    case eCondGroup:
+        insn = POLICY_INSN_IMM( POLICY_OP_INGROUP, reg, pNode->names );
+        break;
+
+    case eCondNot:
+        if( false == cond_fnEmit( pParser, pNode->left, reg ) )
+        {
+            return false;
+        }
+        insn = POLICY_INSN( POLICY_OP_NOT, reg, reg, 0 );
+        break;
+
+    case eCondCompare:
+    case eCondAnd:
+    case eCondOr:
+        if( ( false == cond_fnEmit( pParser, pNode->left, reg ) ) ||
+            ( false == cond_fnEmit( pParser, pNode->right, reg + 1 ) ) )
+        {
+            return false;
+        }
+
+        op = ( eCondAnd == pNode->kind ) ? POLICY_OP_AND
+           : ( eCondOr == pNode->kind )  ? POLICY_OP_OR
+           : pNode->op;
+        insn = POLICY_INSN( op, reg, reg, reg + 1 );
+        break;
+
+    default:
+        return false;
+    }
+
+    if( pProgram->numCode >= POLICY_PROGRAM_MAX_CODE )
+    {
+        return false;
+    }
+
+    pProgram->code[ pProgram->numCode++ ] = insn;
+
+    return true;
+}
+
+/*============================================================================*/
+/*!
+
+    Fold a plain value range condition into the rule min and max
+
+    Only a comparator rule without bounds whose condition is the
+    conjunction of a non zero integer lower bound and upper bound of the
+    value is folded, zero bounds mean a wild card on the server.
+
+@return
+    true if the condition was folded into the rule
+
+*/
+/*============================================================================*/
+static bool cond_fnFold( tzCondParser *pParser,
+                         int node,
+                         struct zPOLICY *pPolicy )
+{
+    tzCondNode *pNode = &pParser->nodes[node];
+    double min;
+    double max;
+
+    if( ( POLICY_NAME_COMP != pPolicy->Name ) ||
+        ( 0 != pPolicy->min ) ||
+        ( 0 != pPolicy->max ) ||
+        ( eCondAnd != pNode->kind ) )
+    {
+        return false;
+    }
+
+    if( !( ( cond_fnBound( pParser, pNode->left, true, &min ) &&
+             cond_fnBound( pParser, pNode->right, false, &max ) ) ||
+           ( cond_fnBound( pParser, pNode->right, true, &min ) &&
+             cond_fnBound( pParser, pNode->left, false, &max ) ) ) )
+    {
+        return false;
+    }
+
+    if( ( 0.0 == min ) || ( 0.0 == max ) ||
+        ( min != (double)(int)min ) || ( max != (double)(int)max ) )
+    {
+        return false;
+    }
+
+    pPolicy->min = (int)min;
+    pPolicy->max = (int)max;
+
+    return true;
+}
+
+/*============================================================================*/
+/*!
+
+    Test if a node is an inclusive bound of the value
+
+@param[in]
+    lower
+        true for "value ge N" (or "N le value"), false for "value le N"
+        (or "N ge value")
+
+@param[out]
+    pBound
+        the bound N
+
+@return
+    true if the node is the requested bound
+
+*/
+/*============================================================================*/
+static bool cond_fnBound( tzCondParser *pParser,
+                          int node,
+                          bool lower,
+                          double *pBound )
+{
+    tzCondNode *pNode = &pParser->nodes[node];
+    tzCondNode *pLeft;
+    tzCondNode *pRight;
+
+    if( eCondCompare != pNode->kind )
+    {
+        return false;
+    }
+
+    pLeft = &pParser->nodes[ pNode->left ];
+    pRight = &pParser->nodes[ pNode->right ];
+
+    if( ( eCondValue == pLeft->kind ) && ( eCondNumber == pRight->kind ) &&
+        ( pNode->op == ( lower ? POLICY_OP_GE : POLICY_OP_LE ) ) )
+    {
+        *pBound = pRight->number;
+        return true;
+    }
+
+    if( ( eCondNumber == pLeft->kind ) && ( eCondValue == pRight->kind ) &&
+        ( pNode->op == ( lower ? POLICY_OP_LE : POLICY_OP_GE ) ) )
+    {
+        *pBound = pLeft->number;
+        return true;
+    }
+
+    return false;
+}
+
+/*============================================================================*/
+/*!
+
+    Set a program which always fails
+
+*/
+/*============================================================================*/
+static void cond_fnDeny( tzPolicyProgram *pProgram )
+{
+    memset( pProgram, 0, sizeof(tzPolicyProgram) );
+    pProgram->numConst = 1;
+    pProgram->konst[0] = 0.0;
+    pProgram->numCode = 2;
+    pProgram->code[0] = POLICY_INSN_IMM( POLICY_OP_LDK, 0, 0 );
+    pProgram->code[1] = POLICY_INSN( POLICY_OP_RET, 0, 0, 0 );
+}
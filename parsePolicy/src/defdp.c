@@ -65,13 +65,17 @@ The Application for defining Data Points.
 #include <ctype.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <syslog.h>
 #include <stdbool.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include <sys/neutrino.h>
 #include <sys/syspage.h>
 
 #include "defdp.h"
+#include "policyset.h"
 
 /*==============================================================================
                               Local variables
@@ -107,6 +111,17 @@ int main(int argc, char *argv[]);
 void defdp_fnCallback( DP_tzINFO *ptzInfo,
                           uint32_t instanceID,
                           void *userData );
+static int defdp_fnAddPath( char *path, char ***pppNames, int *pNumNames );
+static int defdp_fnAddPolicy( PARSE_fnPolicyParser pfnParse,
+                              char *path,
+                              tzPolicyFile **ppFiles,
+                              int *pNumFiles );
+static int defdp_fnCompareNames( const void *pA, const void *pB );
+static int defdp_fnLoadPolicies( DP_HANDLE hDPRM,
+                                 tzPolicyFile *pFiles,
+                                 int numFiles,
+                                 int numThreads,
+                                 bool verbose );
 
 /*==============================================================================
                            Function Definitions
@@ -167,11 +182,28 @@ int main(int argc, char *argv[])
     uint32_t instanceID = 0;
     int c;
     int errflag = 0;
-    char* dpFile = (char*) NULL;
+    char** ppDpFiles = (char**) NULL;
+    int numDpFiles = 0;
     char* policyFile = (char*) NULL;
+    tzPolicyFile *pPolicyFiles = NULL;
+    int numPolicyFiles = 0;
+    int numThreads = 0;
+    int i;
+    char* codegenFile = (char*) NULL;
+    char* nativeFile = (char*) NULL;
+    int benchmark = 0;
+    int engine = -1;
+    int parseBenchmark = 0;
     tzdefdpUserData userData;
     uint32_t options = PARSE_OPT_NONE;
     bool verbose = false;
+    bool asyncOpen = false;
+    bool delta = false;
+    bool committed = false;
+    bool watch = false;
+    bool snapshot = false;
+    uint32_t debounceMs = 0;
+    tzDeltaSummary summary;
 
     /* timing characterisation for policy time measurement before and after */
 	uint64_t cps = 0;
@@ -188,6 +220,16 @@ int main(int argc, char *argv[])
                 "[-f <dpfilename> for example /etc/bigfile.xml] "
                 "[-i <instance ID>] "
                 "[-p <policy_filepath> for example /etc/policy_file.xml] "
+                "[-t <policy_filepath>] "
+                "[-j <threads>] "
+                "[-d] "
+                "[-w <debounce ms>] "
+                "[-g <native_rules.c>] "
+                "[-L <native_rules.so>] "
+                "[-E <hash|dd|native>] "
+                "[-B <iterations>] "
+                "[-T <iterations>] "
+                "[-S] "
                 "[-G] "
                 "<datapointfile>\n"
                 "where flags may be one of:\n"
@@ -201,9 +243,10 @@ int main(int argc, char *argv[])
 
     /* Initialise the UserData structure */
     memset( &userData, 0, sizeof( userData ));
+    memset( &summary, 0, sizeof( summary ));
 
     /* parse the command line options */
-    while( ( c = getopt( argc, argv, "p:P:a:i:f:Gv" ) ) != -1 )
+    while( ( c = getopt( argc, argv, "p:P:t:j:a:i:f:g:L:E:B:T:SGdw:v" ) ) != -1 )
     {
         switch( c )
         {
@@ -215,8 +258,12 @@ int main(int argc, char *argv[])
                 instanceID = atoi(optarg);
                 break;
 
+            /* a data point file, or a directory of them */
             case 'f':
-            	dpFile = strdup(optarg);
+            	if( EOK != defdp_fnAddPath( optarg, &ppDpFiles, &numDpFiles ) )
+            	{
+            		++errflag;
+            	}
                 break;
 
 //            case 'G':
@@ -225,14 +272,97 @@ int main(int argc, char *argv[])
 
             /* XML parsing */
             case 'p':
-            	policyFile = strdup(optarg);
-            	pPolicyFCN = PARSE_fnPolicyCreate;
+            	if( EOK != defdp_fnAddPolicy( PARSE_fnPolicyCreate,
+            	                              optarg,
+            	                              &pPolicyFiles,
+            	                              &numPolicyFiles ) )
+            	{
+            		++errflag;
+            	}
+            	break;
+
+            /* XML parsing with the pull tokenizer */
+            case 't':
+            	if( EOK != defdp_fnAddPolicy( PARSEPULL_fnPolicyCreate,
+            	                              optarg,
+            	                              &pPolicyFiles,
+            	                              &numPolicyFiles ) )
+            	{
+            		++errflag;
+            	}
             	break;
 
             /* XACML parsing */
             case 'P':
-            	policyFile = strdup(optarg);
-            	pPolicyFCN = PARSEXACML_fnPolicyCreate;
+            	if( EOK != defdp_fnAddPolicy( PARSEXACML_fnPolicyCreate,
+            	                              optarg,
+            	                              &pPolicyFiles,
+            	                              &numPolicyFiles ) )
+            	{
+            		++errflag;
+            	}
+            	break;
+
+            /* threads parsing several policy files */
+            case 'j':
+            	numThreads = atoi(optarg);
+            	break;
+
+            /* generate native code instead of registering the rules */
+            case 'g':
+            	codegenFile = strdup(optarg);
+            	break;
+
+            /* load a native rule set after the policy housekeeping */
+            case 'L':
+            	nativeFile = strdup(optarg);
+            	break;
+
+            /* send only the rules which differ from the server */
+            case 'd':
+            	delta = true;
+            	break;
+
+            /* keep running and reload the policy file when it changes */
+            case 'w':
+            	watch = true;
+            	debounceMs = (uint32_t)atoi(optarg);
+            	break;
+
+            /* engine of the policy checks of the server */
+            case 'E':
+            	if( 0 == strcasecmp( optarg, "hash" ) )
+            	{
+            		engine = POLICY_ENGINE_ID_HASH;
+            	}
+            	else if( 0 == strcasecmp( optarg, "dd" ) )
+            	{
+            		engine = POLICY_ENGINE_ID_DD;
+            	}
+            	else if( 0 == strcasecmp( optarg, "native" ) )
+            	{
+            		engine = POLICY_ENGINE_ID_NATIVE;
+            	}
+            	else
+            	{
+            		fprintf(stderr,"Unknown policy engine %s\n", optarg );
+            		++errflag;
+            	}
+            	break;
+
+            /* benchmark the policy check engines of the server */
+            case 'B':
+            	benchmark = atoi(optarg);
+            	break;
+
+            /* benchmark the policy file parsers */
+            case 'T':
+            	parseBenchmark = atoi(optarg);
+            	break;
+
+            /* ask the server for a snapshot once done */
+            case 'S':
+            	snapshot = true;
             	break;
 
             case 'v':
@@ -249,6 +379,57 @@ int main(int argc, char *argv[])
         }
     }
 
+    if( errflag > 0 )
+    {
+    	return EXIT_FAILURE;
+    }
+
+    /* the single file modes work on the first policy file */
+    if( numPolicyFiles > 0 )
+    {
+    	policyFile = pPolicyFiles[0].pFilename;
+    	pPolicyFCN = pPolicyFiles[0].pfnParse;
+    }
+
+    if( ( numPolicyFiles > 1 ) &&
+        ( ( (char*)NULL != codegenFile ) || ( true == delta ) ||
+          ( true == watch ) || ( parseBenchmark > 0 ) ) )
+    {
+    	fprintf(stderr,"-g, -d, -w and -T take a single policy file\n" );
+    	return EXIT_FAILURE;
+    }
+
+    /* time the policy file parsers, nothing is sent to the server */
+    if( ( parseBenchmark > 0 ) && ( (char*)NULL != policyFile ) )
+    {
+    	if( EOK != PARSEPULL_fnBenchmark( policyFile, parseBenchmark ) )
+    	{
+    		fprintf(stderr,"Policy parsers disagree or benchmark failed\n" );
+    		return EXIT_FAILURE;
+    	}
+    	return EXIT_SUCCESS;
+    }
+
+    /* generate the native code of the policy rules, nothing is sent to the
+     * server */
+    if( ( (char*)NULL != codegenFile ) && ( (char*)NULL != policyFile ) )
+    {
+    	PARSE_fnSetRuleHandler( PARSE_fnCodegenRule, NULL );
+    	pPolicyFCN( NULL, policyFile );
+    	PARSE_fnSetRuleHandler( NULL, NULL );
+
+    	if( EOK != PARSE_fnCodegenWrite( codegenFile, policyFile ) )
+    	{
+    		fprintf(stderr,"Failed to generate %s\n", codegenFile );
+    		return EXIT_FAILURE;
+    	}
+    	if( verbose )
+    	{
+    		printf("Generated %s.\n", codegenFile );
+    	}
+    	return EXIT_SUCCESS;
+    }
+
     /* get a handle to the data point manager */
     userData.hDPRM = DP_fnOpen();
     if( userData.hDPRM == NULL )
@@ -256,20 +437,24 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    /* register data points with the minicloud server */
-    if( (char*)NULL != dpFile )
+    /* register data points with the minicloud server, in the order of the
+     * files */
+    if( numDpFiles > 0 )
     {
     	if( verbose )
     	{
     		printf("Registering data points in the MiniCloud Server->\n");
     	}
-        PARSE_fnCreate( userData.hDPRM,
-                          instanceID,
-                          dpFile,
-                          flags,
-                          defdp_fnCallback,
-                          &userData,
-                          options );
+    	for( i = 0; i < numDpFiles; i++ )
+    	{
+            PARSE_fnCreate( userData.hDPRM,
+                              instanceID,
+                              ppDpFiles[i],
+                              flags,
+                              defdp_fnCallback,
+                              &userData,
+                              options );
+    	}
         if( verbose )
         {
         	printf("Done DP registrations.\n");
@@ -287,8 +472,59 @@ int main(int argc, char *argv[])
     	/* snap the time */
     	cycle1 = ClockCycles( );
 
-    	/* virtual function pointer for when the XACML or XML is used */
-    	pPolicyFCN( userData.hDPRM, policyFile );
+    	/* the rules are queued and sent while the parser goes on, the
+    	 * registrations are synchronous if the sender cannot start */
+    	asyncOpen = ( EOK == DP_fnPolicyAsyncOpen( userData.hDPRM, 0 ) );
+
+    	if( true == delta )
+    	{
+    		/* collect the rules, then send the difference with the server */
+    		if( EOK != PARSE_fnDeltaReload( userData.hDPRM,
+    		                                pPolicyFCN,
+    		                                policyFile,
+    		                                &summary ) )
+    		{
+    			syslog( LOG_ERR, "Failed to reload policy." );
+    			fprintf(stderr,"Failed to reload policy\n" );
+    		}
+    		if( verbose )
+    		{
+    			printf("Policy delta: %u added, %u changed, %u unchanged, "
+    			       "%u removed.\n",
+    			       summary.added,
+    			       summary.changed,
+    			       summary.unchanged,
+    			       summary.removed );
+    		}
+    		committed = true;
+    	}
+    	else if( numPolicyFiles > 1 )
+    	{
+    		/* parse the files concurrently, then register and commit their
+    		 * rules in the order of the files */
+    		if( EOK != defdp_fnLoadPolicies( userData.hDPRM,
+    		                                 pPolicyFiles,
+    		                                 numPolicyFiles,
+    		                                 numThreads,
+    		                                 verbose ) )
+    		{
+    			syslog( LOG_ERR, "Failed to load policy files." );
+    			fprintf(stderr,"Failed to load policy files\n" );
+    		}
+    		committed = true;
+    	}
+    	else
+    	{
+    		/* virtual function pointer for when the XACML or XML is used */
+    		pPolicyFCN( userData.hDPRM, policyFile );
+    	}
+
+    	/* the rules are registered once the queue drained */
+    	if( true == asyncOpen )
+    	{
+    		DP_fnPolicyAsyncWait( userData.hDPRM, POLICY_ASYNC_ALL, NULL );
+    		DP_fnPolicyAsyncClose( userData.hDPRM );
+    	}
 
 
     	/* snap the time again */
@@ -304,7 +540,10 @@ int main(int argc, char *argv[])
         	printf("policy housekeeping->\n");
     	}
 
-		if( EOK != DP_fnPolicyHousekeeping( userData.hDPRM ) )
+		/* the delta reload and the policy sets committed the rules
+		 * already */
+		if( ( false == committed ) &&
+		    ( EOK != DP_fnPolicyHousekeeping( userData.hDPRM ) ) )
 		{
 			syslog( LOG_ERR, "Failed to housekeep policy." );
 			fprintf(stderr,"Failed to housekeep policy\n" );
@@ -315,6 +554,59 @@ int main(int argc, char *argv[])
     	}
 	}
 
+    /* swap in the native rule set, it must match the rules just committed */
+    if( (char*)NULL != nativeFile )
+    {
+		if( EOK != DP_fnPolicyLoadNative( userData.hDPRM, nativeFile ) )
+		{
+			syslog( LOG_ERR, "Failed to load native policy." );
+			fprintf(stderr,"Failed to load native policy %s\n", nativeFile );
+		}
+    }
+
+    /* after the native rule set, loading it selects the native engine */
+    if( engine >= 0 )
+    {
+		if( EOK != DP_fnPolicySelectEngine( userData.hDPRM, engine ) )
+		{
+			syslog( LOG_ERR, "Failed to select the policy engine." );
+			fprintf(stderr,"Failed to select the policy engine\n" );
+		}
+    }
+
+    /* the server prints the time per decision of each engine */
+    if( benchmark > 0 )
+    {
+		if( EOK != DP_fnPolicyBenchmark( userData.hDPRM, benchmark ) )
+		{
+			fprintf(stderr,"Policy engines disagree or benchmark failed\n" );
+		}
+    }
+
+    /* the server restarts from the snapshot instead of the files */
+    if( true == snapshot )
+    {
+		if( EOK != DP_fnPolicySnapshot( userData.hDPRM ) )
+		{
+			syslog( LOG_ERR, "Failed to save the server snapshot." );
+			fprintf(stderr,"Failed to save the server snapshot\n" );
+		}
+    }
+
+    /* serve the policy file changes until stopped by a signal */
+    if( ( true == watch ) && ( (char*)NULL != policyFile ) )
+    {
+		if( EOK != PARSE_fnWatchPolicy( userData.hDPRM,
+		                                pPolicyFCN,
+		                                policyFile,
+		                                debounceMs,
+		                                verbose ) )
+		{
+			syslog( LOG_ERR, "Failed to watch policy." );
+			fprintf(stderr,"Failed to watch policy %s\n", policyFile );
+		}
+    }
+
     /* close the data point manager */
     DP_fnClose( userData.hDPRM );
 
@@ -377,4 +669,273 @@ void defdp_fnCallback( DP_tzINFO *ptzInfo,
     }
 }
 
+/*============================================================================*/
+/*!
+    Add a file, or the XML files of a directory, to a list of files
+
+    The files of a directory are added sorted by name, so that the order of
+    the files, and of their rules, does not depend on the file system.
+
+@param[in]
+    path
+        file or directory
+
+@param[in,out]
+    pppNames
+        list of file names, grown as needed
+
+@param[in,out]
+    pNumNames
+        number of file names in the list
+
+@return
+    EOK - the files were added
+    ENOENT - the path does not exist
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+static int defdp_fnAddPath( char *path, char ***pppNames, int *pNumNames )
+{
+    struct stat st;
+    struct dirent *pEntry;
+    DIR *pDir;
+    char **ppNames;
+    char *pName;
+    size_t len;
+    int first = *pNumNames;
+    int ret = EOK;
+
+    if( 0 != stat( path, &st ) )
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror( errno ) );
+        return ENOENT;
+    }
+
+    if( !S_ISDIR( st.st_mode ) )
+    {
+        ppNames = realloc( *pppNames, ( *pNumNames + 1 ) * sizeof(char *) );
+        if( NULL == ppNames )
+        {
+            return ENOMEM;
+        }
+        *pppNames = ppNames;
+
+        ppNames[ *pNumNames ] = strdup( path );
+        if( NULL == ppNames[ *pNumNames ] )
+        {
+            return ENOMEM;
+        }
+        (*pNumNames)++;
+
+        return EOK;
+    }
+
+    pDir = opendir( path );
+    if( NULL == pDir )
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror( errno ) );
+        return ENOENT;
+    }
+
+    while( ( EOK == ret ) && ( NULL != ( pEntry = readdir( pDir ) ) ) )
+    {
+        len = strlen( pEntry->d_name );
+        if( ( len <= 4 ) ||
+            ( 0 != strcasecmp( &pEntry->d_name[ len - 4 ], ".xml" ) ) )
+        {
+            continue;
+        }
+
+        pName = malloc( strlen( path ) + len + 2 );
+        if( NULL == pName )
+        {
+            ret = ENOMEM;
+            break;
+        }
+        sprintf( pName, "%s/%s", path, pEntry->d_name );
+
+        /* sub directories are not searched */
+        if( ( 0 != stat( pName, &st ) ) || !S_ISREG( st.st_mode ) )
+        {
+            free( pName );
+            continue;
+        }
+
+        ppNames = realloc( *pppNames, ( *pNumNames + 1 ) * sizeof(char *) );
+        if( NULL == ppNames )
+        {
+            free( pName );
+            ret = ENOMEM;
+            break;
+        }
+        *pppNames = ppNames;
+        ppNames[ (*pNumNames)++ ] = pName;
+    }
+
+    closedir( pDir );
+
+    if( *pNumNames > first )
+    {
+        qsort( &(*pppNames)[ first ],
+               *pNumNames - first,
+               sizeof(char *),
+               defdp_fnCompareNames );
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    Add a policy file, or the XML files of a directory, to the policy files
+
+@param[in]
+    pfnParse
+        parser of the files
+
+@param[in]
+    path
+        policy file or directory
+
+@param[in,out]
+    ppFiles
+        list of policy files, grown as needed
+
+@param[in,out]
+    pNumFiles
+        number of policy files in the list
+
+@return
+    EOK - the files were added
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+static int defdp_fnAddPolicy( PARSE_fnPolicyParser pfnParse,
+                              char *path,
+                              tzPolicyFile **ppFiles,
+                              int *pNumFiles )
+{
+    tzPolicyFile *pFiles;
+    char **ppNames = NULL;
+    int numNames = 0;
+    int ret;
+    int i;
+
+    ret = defdp_fnAddPath( path, &ppNames, &numNames );
+    if( ( EOK == ret ) && ( numNames > 0 ) )
+    {
+        pFiles = realloc( *ppFiles,
+                          ( *pNumFiles + numNames ) * sizeof(tzPolicyFile) );
+        if( NULL == pFiles )
+        {
+            ret = ENOMEM;
+        }
+        else
+        {
+            *ppFiles = pFiles;
+            for( i = 0; i < numNames; i++ )
+            {
+                pFiles[ *pNumFiles ].pfnParse = pfnParse;
+                pFiles[ *pNumFiles ].pFilename = ppNames[i];
+                (*pNumFiles)++;
+            }
+            numNames = 0;
+        }
+    }
+
+    for( i = 0; i < numNames; i++ )
+    {
+        free( ppNames[i] );
+    }
+    free( ppNames );
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+    qsort comparison of two file names
+
+*/
+/*============================================================================*/
+static int defdp_fnCompareNames( const void *pA, const void *pB )
+{
+    return strcmp( *(char * const *)pA, *(char * const *)pB );
+}
+
+/*============================================================================*/
+/*!
+    Parse several policy files concurrently and commit their rules
+
+    The files are parsed on a pool of threads, see POLICYSET_fnLoadFiles,
+    then their rules are registered in the order of the files, queued on
+    the sender of the connection when it has one, and committed.
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager
+
+@param[in]
+    pFiles
+        policy files
+
+@param[in]
+    numFiles
+        number of policy files
+
+@param[in]
+    numThreads
+        number of threads parsing the files, 0 for one per CPU
+
+@param[in]
+    verbose
+        print the number of rules
+
+@return
+    EOK - the rules of all the files are committed
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+static int defdp_fnLoadPolicies( DP_HANDLE hDPRM,
+                                 tzPolicyFile *pFiles,
+                                 int numFiles,
+                                 int numThreads,
+                                 bool verbose )
+{
+    POLICYSET_HANDLE hPolicySet;
+    tzPolicySet *pSet = NULL;
+    int ret;
+
+    hPolicySet = POLICYSET_fnOpen( hDPRM );
+    if( NULL == hPolicySet )
+    {
+        return ENOMEM;
+    }
+
+    ret = POLICYSET_fnLoadFiles( hPolicySet,
+                                 pFiles,
+                                 numFiles,
+                                 numThreads,
+                                 &pSet );
+    if( EOK == ret )
+    {
+        if( verbose )
+        {
+            printf("Parsed %d rules from %d policy files.\n",
+                   POLICYSET_fnNumRules( pSet ),
+                   numFiles );
+        }
+
+        /* nothing is committed unless every file parsed */
+        ret = POLICYSET_fnApply( hPolicySet, pSet );
+    }
+
+    POLICYSET_fnClose( hPolicySet );
+
+    return ret;
+}
+
 //EoF
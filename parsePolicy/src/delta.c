@@ -0,0 +1,612 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+/*============================================================================*/
+/*!
+
+@file  delta.c
+
+@brief
+    Reload a policy file by sending only the rules that changed
+
+@details
+
+    This module collects the rules of a policy file instead of registering
+    them, then compares them with the fingerprints of the rules committed
+    on the server, see policydelta.h:
+
+        - a rule whose key the server does not have is added
+        - a rule whose fingerprint differs from the server is replaced
+        - a rule the server has with the same fingerprint is not sent
+        - a server rule whose key is not in the file is removed
+
+    The new and changed rules are registered, then a delta commit removes
+    the others and compiles the rule set, leaving the unchanged rules of
+    the server in place:
+
+        defdp -d -p policy.xml
+
+    Like the server, the last rule of a name, type and location wins.  If
+    the server cannot report its fingerprints every rule is registered and
+    committed by the policy housekeeping.
+
+*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include "minicloud.h"
+#include "defdp.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+/*! number of rules added to the rule table at a time */
+#define DELTA_RULE_CHUNK          ( 256 )
+
+/*! length of the location sent to the server, see policy_fnSend */
+#define DELTA_LOCATION_LENGTH     ( 256 )
+
+/*==============================================================================
+                              Data Structures
+==============================================================================*/
+
+/*! rule collected for the delta */
+typedef struct zDeltaRule
+{
+    /*! policy rule as parsed */
+    struct zPOLICY policy;
+
+    /*! key of the rule, see POLICYDELTA_fnKey */
+    uint64_t key;
+
+    /*! fingerprint of the rule as it is sent */
+    uint64_t fingerprint;
+
+    /*! order of the rule in the policy file */
+    int seq;
+
+    /*! comma separated user list, empty for a wild card */
+    char *pUsers;
+
+    /*! comma separated group list, empty for a wild card */
+    char *pGroups;
+
+    /*! condition program, NULL if the rule has none */
+    tzPolicyProgram *pProgram;
+
+} tzDeltaRule;
+
+/*==============================================================================
+                        Local/Private Function Protoypes
+==============================================================================*/
+
+static int delta_fnCompareRule( const void *p1, const void *p2 );
+static int delta_fnCompareFingerprint( const void *p1, const void *p2 );
+static int delta_fnSend( DP_HANDLE hDPRM, tzDeltaRule *pRule );
+static int delta_fnDrain( DP_HANDLE hDPRM );
+static void delta_fnFree( void );
+
+/*==============================================================================
+                           Local/Private Variables
+==============================================================================*/
+
+/*! collected rules */
+static tzDeltaRule *pRules = NULL;
+
+/*! number of collected rules */
+static int numRules = 0;
+
+/*! size of the rule table */
+static int maxRules = 0;
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+//fn  PARSE_fnDeltaRule
+/*!
+
+@brief
+    Collect a complete policy rule for the delta
+
+    Installed with PARSE_fnSetRuleHandler() in place of the registration
+    of the rule with the server.
+
+@param[in]
+    ptzPolicyData
+        policy parser state holding the complete rule
+
+@param[in]
+    pContext
+        not used
+
+@return
+    EOK - rule collected
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+int PARSE_fnDeltaRule( tzPolicyData *ptzPolicyData, void *pContext )
+{
+    tzDeltaRule *pRule;
+    tzDeltaRule *pNew;
+    char location[ DELTA_LOCATION_LENGTH ];
+
+    (void)pContext;
+
+    if( NULL == ptzPolicyData )
+    {
+        return EINVAL;
+    }
+
+    if( numRules == maxRules )
+    {
+        pNew = realloc( pRules,
+                        ( maxRules + DELTA_RULE_CHUNK ) *
+                        sizeof(tzDeltaRule) );
+        if( NULL == pNew )
+        {
+            return ENOMEM;
+        }
+        pRules = pNew;
+        maxRules += DELTA_RULE_CHUNK;
+    }
+
+    pRule = &pRules[ numRules ];
+    memset( pRule, 0, sizeof(tzDeltaRule) );
+    memcpy( &pRule->policy, &ptzPolicyData->policy, sizeof(struct zPOLICY) );
+    pRule->seq = numRules;
+
+    pRule->pUsers = strdup( ptzPolicyData->userList );
+    pRule->pGroups = strdup( ptzPolicyData->groupList );
+    if( 0 != ptzPolicyData->program.numCode )
+    {
+        pRule->pProgram = malloc( sizeof(tzPolicyProgram) );
+        if( NULL != pRule->pProgram )
+        {
+            memcpy( pRule->pProgram,
+                    &ptzPolicyData->program,
+                    sizeof(tzPolicyProgram) );
+        }
+    }
+
+    if( ( NULL == pRule->pUsers ) ||
+        ( NULL == pRule->pGroups ) ||
+        ( ( 0 != ptzPolicyData->program.numCode ) &&
+          ( NULL == pRule->pProgram ) ) )
+    {
+        free( pRule->pUsers );
+        free( pRule->pGroups );
+        free( pRule->pProgram );
+        return ENOMEM;
+    }
+
+    /* the server hashes the fields of the message, so hash the location
+     * as the registration truncates it */
+    memset( location, 0, sizeof(location) );
+    strncpy( location, pRule->policy.Location, sizeof(location) - 1 );
+
+    pRule->key = POLICYDELTA_fnKey( pRule->policy.Name,
+                                    pRule->policy.Type,
+                                    location );
+    pRule->fingerprint = POLICYDELTA_fnFingerprint( pRule->policy.Name,
+                                                    pRule->policy.Type,
+                                                    pRule->policy.max,
+                                                    pRule->policy.min,
+                                                    (int64_t)pRule->policy.time.tv_sec,
+                                                    pRule->policy.user,
+                                                    pRule->policy.group,
+                                                    location,
+                                                    pRule->pUsers,
+                                                    pRule->pGroups,
+                                                    pRule->pProgram );
+
+    numRules++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  PARSE_fnDeltaApply
+/*!
+
+@brief
+    Send the difference between the collected rules and the server
+
+    The collected rules are released, whether the delta could be applied
+    or not.
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager
+
+@param[out]
+    pSummary
+        what was sent, may be NULL
+
+@return
+    EOK - the server committed the rule set of the file
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int PARSE_fnDeltaApply( DP_HANDLE hDPRM, tzDeltaSummary *pSummary )
+{
+    tzPolicyFingerprint *pServer = NULL;
+    tzPolicyFingerprint *pFound;
+    tzPolicyFingerprint probe;
+    tzDeltaSummary summary;
+    uint64_t *pRemove = NULL;
+    bool *pMatched = NULL;
+    uint32_t numServer = 0;
+    uint32_t numRemove = 0;
+    uint32_t j;
+    int i;
+    int n;
+    int res;
+    int ret = EOK;
+
+    memset( &summary, 0, sizeof(summary) );
+
+    if( NULL == hDPRM )
+    {
+        delta_fnFree();
+        return EINVAL;
+    }
+
+    /* order by key, the last duplicate wins like the policy hash */
+    if( numRules > 0 )
+    {
+        qsort( pRules, numRules, sizeof(tzDeltaRule), delta_fnCompareRule );
+    }
+
+    n = 0;
+    for( i = 0; i < numRules; i++ )
+    {
+        if( ( i + 1 < numRules ) && ( pRules[i].key == pRules[i+1].key ) )
+        {
+            free( pRules[i].pUsers );
+            free( pRules[i].pGroups );
+            free( pRules[i].pProgram );
+            continue;
+        }
+
+        pRules[n++] = pRules[i];
+    }
+    numRules = n;
+
+    pServer = malloc( POLICY_DELTA_MAX_RULES * sizeof(tzPolicyFingerprint) );
+    pMatched = calloc( POLICY_DELTA_MAX_RULES, sizeof(bool) );
+    pRemove = malloc( POLICY_DELTA_MAX_RULES * sizeof(uint64_t) );
+    if( ( NULL == pServer ) || ( NULL == pMatched ) || ( NULL == pRemove ) )
+    {
+        ret = ENOMEM;
+    }
+    else if( EOK != DP_fnPolicyFingerprints( hDPRM,
+                                             pServer,
+                                             POLICY_DELTA_MAX_RULES,
+                                             &numServer ) )
+    {
+        /* the server cannot tell what it has, reload the whole file */
+        for( i = 0; i < numRules; i++ )
+        {
+            res = delta_fnSend( hDPRM, &pRules[i] );
+            if( EOK != res )
+            {
+                ret = res;
+            }
+            summary.added++;
+        }
+
+        res = delta_fnDrain( hDPRM );
+        if( EOK != res )
+        {
+            ret = res;
+        }
+
+        res = DP_fnPolicyHousekeeping( hDPRM );
+        if( EOK != res )
+        {
+            ret = res;
+        }
+    }
+    else
+    {
+        qsort( pServer,
+               numServer,
+               sizeof(tzPolicyFingerprint),
+               delta_fnCompareFingerprint );
+
+        for( i = 0; i < numRules; i++ )
+        {
+            probe.key = pRules[i].key;
+            pFound = bsearch( &probe,
+                              pServer,
+                              numServer,
+                              sizeof(tzPolicyFingerprint),
+                              delta_fnCompareFingerprint );
+            if( NULL != pFound )
+            {
+                pMatched[ pFound - pServer ] = true;
+                if( pFound->fingerprint == pRules[i].fingerprint )
+                {
+                    summary.unchanged++;
+                    continue;
+                }
+                summary.changed++;
+            }
+            else
+            {
+                summary.added++;
+            }
+
+            res = delta_fnSend( hDPRM, &pRules[i] );
+            if( EOK != res )
+            {
+                ret = res;
+            }
+        }
+
+        for( j = 0; j < numServer; j++ )
+        {
+            if( false == pMatched[j] )
+            {
+                pRemove[ numRemove++ ] = pServer[j].key;
+            }
+        }
+        summary.removed = numRemove;
+
+        /* the queued rules must reach the server before the commit */
+        res = delta_fnDrain( hDPRM );
+        if( EOK != res )
+        {
+            ret = res;
+        }
+
+        res = DP_fnPolicyDeltaCommit( hDPRM, pRemove, numRemove );
+        if( EOK != res )
+        {
+            ret = res;
+        }
+    }
+
+    if( NULL != pSummary )
+    {
+        *pSummary = summary;
+    }
+
+    free( pServer );
+    free( pMatched );
+    free( pRemove );
+    delta_fnFree();
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  PARSE_fnDeltaReload
+/*!
+
+@brief
+    Parse a policy file and send its difference with the server
+
+    Nothing is sent if the file cannot be parsed, so a file caught half
+    written does not remove the rules of the server.
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager
+
+@param[in]
+    pfnParse
+        parser of the policy file
+
+@param[in]
+    filename
+        policy file
+
+@param[out]
+    pSummary
+        what was sent, may be NULL
+
+@return
+    EOK - the server committed the rule set of the file
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int PARSE_fnDeltaReload( DP_HANDLE hDPRM,
+                         PARSE_fnPolicyParser pfnParse,
+                         char *filename,
+                         tzDeltaSummary *pSummary )
+{
+    int ret;
+
+    if( ( NULL == hDPRM ) || ( NULL == pfnParse ) || ( NULL == filename ) )
+    {
+        return EINVAL;
+    }
+
+    PARSE_fnSetRuleHandler( PARSE_fnDeltaRule, NULL );
+    ret = pfnParse( hDPRM, filename );
+    PARSE_fnSetRuleHandler( NULL, NULL );
+
+    if( EOK != ret )
+    {
+        delta_fnFree();
+        return ret;
+    }
+
+    return PARSE_fnDeltaApply( hDPRM, pSummary );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Register a rule, queued if the connection has a sender
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager
+
+@param[in]
+    pRule
+        rule to register
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+static int delta_fnSend( DP_HANDLE hDPRM, tzDeltaRule *pRule )
+{
+    int ret;
+
+    ret = DP_fnRegisterPolicyAsync( hDPRM,
+                                    &pRule->policy,
+                                    pRule->pUsers,
+                                    pRule->pGroups,
+                                    pRule->pProgram,
+                                    NULL,
+                                    NULL,
+                                    NULL );
+    if( ENOTCONN != ret )
+    {
+        return ret;
+    }
+
+    return DP_fnRegisterPolicyProgram( hDPRM,
+                                       &pRule->policy,
+                                       pRule->pUsers,
+                                       pRule->pGroups,
+                                       pRule->pProgram );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Wait until the queued rules were registered by the server
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager
+
+@return
+    EOK if every queued rule was registered or nothing was queued, else
+    the first error of the queued rules
+
+*/
+/*============================================================================*/
+static int delta_fnDrain( DP_HANDLE hDPRM )
+{
+    int status = EOK;
+
+    /* ENOENT, the connection has no sender and the rules were sent */
+    if( EOK != DP_fnPolicyAsyncWait( hDPRM, POLICY_ASYNC_ALL, &status ) )
+    {
+        return EOK;
+    }
+
+    return status;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Order the rules by key, then by their order in the policy file
+
+@param[in]
+    p1
+        first rule
+
+@param[in]
+    p2
+        second rule
+
+@return
+    less than, equal to or greater than zero
+
+*/
+/*============================================================================*/
+static int delta_fnCompareRule( const void *p1, const void *p2 )
+{
+    const tzDeltaRule *pA = p1;
+    const tzDeltaRule *pB = p2;
+
+    if( pA->key != pB->key )
+    {
+        return ( pA->key < pB->key ) ? -1 : 1;
+    }
+
+    return pA->seq - pB->seq;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Order the server fingerprints by key
+
+@param[in]
+    p1
+        first fingerprint
+
+@param[in]
+    p2
+        second fingerprint
+
+@return
+    less than, equal to or greater than zero
+
+*/
+/*============================================================================*/
+static int delta_fnCompareFingerprint( const void *p1, const void *p2 )
+{
+    const tzPolicyFingerprint *pA = p1;
+    const tzPolicyFingerprint *pB = p2;
+
+    return ( pA->key > pB->key ) - ( pA->key < pB->key );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Release the collected rules
+
+*/
+/*============================================================================*/
+static void delta_fnFree( void )
+{
+    int i;
+
+    for( i = 0; i < numRules; i++ )
+    {
+        free( pRules[i].pUsers );
+        free( pRules[i].pGroups );
+        free( pRules[i].pProgram );
+    }
+
+    free( pRules );
+    pRules = NULL;
+    numRules = 0;
+    maxRules = 0;
+}
@@ -0,0 +1,500 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+/*============================================================================*/
+/*!
+
+@file  isotime.c
+
+@brief
+    Convert the ISO 8601 time of a policy rule to seconds since the epoch
+
+@details
+
+    The <time> element of a rule holds a date and time in the ISO 8601
+    extended format:
+
+        YYYY-MM-DD[(T| )hh[:mm[:ss[.fff]]]][Z|(+|-)hh[[:]mm]]
+
+    '/' is also taken between the date fields.  A time without a zone is
+    UTC, so a rule has the same time whatever the TZ of the host parsing
+    it.  The time is computed from the calendar fields, without mktime
+    and its time zone database, and the fraction of a second is dropped.
+
+    A policy file repeats the same few times over its rules, the seconds
+    of the recent ones are kept in the time cache of the parse.
+
+*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include "minicloud.h"
+#include "defdp.h"
+
+/*==============================================================================
+                        Local/Private Function Protoypes
+==============================================================================*/
+
+static bool isotime_fnNumber( const char **pp,
+                              const char *pEnd,
+                              size_t minDigits,
+                              size_t maxDigits,
+                              int32_t *pValue );
+static int64_t isotime_fnDays( int32_t year, int32_t month, int32_t day );
+static int32_t isotime_fnMonthDays( int32_t year, int32_t month );
+static int isotime_fnZone( const char *p, const char *pEnd, int32_t *pOffset );
+static uint32_t isotime_fnHash( const char *pText, size_t len );
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*!
+
+    Convert an ISO 8601 date and time to seconds since the epoch
+
+@param[in]
+    pText
+        the date and time, white space around it is skipped
+
+@param[in]
+    len
+        length of pText
+
+@param[out]
+    pSeconds
+        seconds since 1970-01-01T00:00:00Z
+
+@retval EOK    - pSeconds holds the time
+@retval EINVAL - the text is not a date and time of the format above, or a
+                 field is out of its range
+
+*/
+/*============================================================================*/
+int PARSE_fnIsoTime( const char *pText, size_t len, int64_t *pSeconds )
+{
+    const char *p = pText;
+    const char *pEnd;
+    int32_t year;
+    int32_t month;
+    int32_t day;
+    int32_t hour = 0;
+    int32_t minute = 0;
+    int32_t second = 0;
+    int32_t offset = 0;
+    char sep;
+
+    if( ( NULL == pText ) || ( NULL == pSeconds ) )
+    {
+        return EINVAL;
+    }
+
+    pEnd = pText + len;
+    while( ( p < pEnd ) && ( ( ' ' == *p ) || ( '\t' == *p ) ||
+                             ( '\r' == *p ) || ( '\n' == *p ) ) )
+    {
+        p++;
+    }
+
+    while( ( pEnd > p ) && ( ( ' ' == pEnd[-1] ) || ( '\t' == pEnd[-1] ) ||
+                             ( '\r' == pEnd[-1] ) || ( '\n' == pEnd[-1] ) ) )
+    {
+        pEnd--;
+    }
+
+    /* YYYY-MM-DD, the separators must match */
+    if( ( false == isotime_fnNumber( &p, pEnd, 4u, 4u, &year ) ) ||
+        ( p >= pEnd ) || ( ( '-' != *p ) && ( '/' != *p ) ) )
+    {
+        return EINVAL;
+    }
+
+    sep = *p++;
+    if( ( false == isotime_fnNumber( &p, pEnd, 1u, 2u, &month ) ) ||
+        ( p >= pEnd ) || ( sep != *p++ ) ||
+        ( false == isotime_fnNumber( &p, pEnd, 1u, 2u, &day ) ) ||
+        ( month < 1 ) || ( month > 12 ) ||
+        ( day < 1 ) || ( day > isotime_fnMonthDays( year, month ) ) )
+    {
+        return EINVAL;
+    }
+
+    /* hh[:mm[:ss[.fff]]] */
+    if( ( p < pEnd ) && ( ( 'T' == *p ) || ( 't' == *p ) || ( ' ' == *p ) ) )
+    {
+        p++;
+        if( false == isotime_fnNumber( &p, pEnd, 1u, 2u, &hour ) )
+        {
+            return EINVAL;
+        }
+
+        if( ( p < pEnd ) && ( ':' == *p ) )
+        {
+            p++;
+            if( false == isotime_fnNumber( &p, pEnd, 2u, 2u, &minute ) )
+            {
+                return EINVAL;
+            }
+
+            if( ( p < pEnd ) && ( ':' == *p ) )
+            {
+                p++;
+                if( false == isotime_fnNumber( &p, pEnd, 2u, 2u, &second ) )
+                {
+                    return EINVAL;
+                }
+
+                if( ( p < pEnd ) && ( ( '.' == *p ) || ( ',' == *p ) ) )
+                {
+                    p++;
+                    if( ( p >= pEnd ) || ( *p < '0' ) || ( *p > '9' ) )
+                    {
+                        return EINVAL;
+                    }
+
+                    while( ( p < pEnd ) && ( *p >= '0' ) && ( *p <= '9' ) )
+                    {
+                        p++;
+                    }
+                }
+            }
+        }
+
+        /* a leap second is the first second of the next minute */
+        if( ( hour > 23 ) || ( minute > 59 ) || ( second > 60 ) )
+        {
+            return EINVAL;
+        }
+    }
+
+    if( EOK != isotime_fnZone( p, pEnd, &offset ) )
+    {
+        return EINVAL;
+    }
+
+    *pSeconds = isotime_fnDays( year, month, day ) * 86400 +
+                hour * 3600 + minute * 60 + second - offset;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Set the time of the rule being parsed from its <time> element
+
+    The seconds of the text are taken from the time cache of the parse when
+    the same text was converted before.
+
+@param[in]
+    ptzPolicyData
+        the parse, its policy gets the time
+
+@param[in]
+    pText
+        the text of the <time> element
+
+@retval EOK    - the rule has the time
+@retval EINVAL - the text is not an ISO 8601 time, the rule has no time
+
+*/
+/*============================================================================*/
+int PARSE_fnPolicyTime( tzPolicyData *ptzPolicyData, const char *pText )
+{
+    tzTimeCacheEntry *pEntry = NULL;
+    int64_t seconds;
+    size_t len;
+    int result;
+
+    if( ( NULL == ptzPolicyData ) || ( NULL == pText ) )
+    {
+        return EINVAL;
+    }
+
+    len = strlen( pText );
+    if( len < sizeof( pEntry->text ) )
+    {
+        pEntry = &ptzPolicyData->timeCache[ isotime_fnHash( pText, len ) &
+                                            ( PARSE_TIME_CACHE_SIZE - 1u ) ];
+        if( ( 0u != len ) &&
+            ( pEntry->len == len ) && ( 0 == memcmp( pEntry->text,
+                                                     pText,
+                                                     len ) ) )
+        {
+            ptzPolicyData->policy.time.tv_sec = (time_t)pEntry->seconds;
+            return EOK;
+        }
+    }
+
+    result = PARSE_fnIsoTime( pText, len, &seconds );
+    if( EOK != result )
+    {
+        ptzPolicyData->policy.time.tv_sec = 0;
+        return result;
+    }
+
+    if( NULL != pEntry )
+    {
+        memcpy( pEntry->text, pText, len );
+        pEntry->len = len;
+        pEntry->seconds = seconds;
+    }
+
+    ptzPolicyData->policy.time.tv_sec = (time_t)seconds;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    Read a decimal field
+
+@param[in,out]
+    pp
+        the first digit, set past the last one
+
+@param[in]
+    pEnd
+        end of the text
+
+@param[in]
+    minDigits
+        fewest digits of the field
+
+@param[in]
+    maxDigits
+        most digits of the field
+
+@param[out]
+    pValue
+        value of the field
+
+@return
+    true if the field has from minDigits to maxDigits digits
+
+*/
+/*============================================================================*/
+static bool isotime_fnNumber( const char **pp,
+                              const char *pEnd,
+                              size_t minDigits,
+                              size_t maxDigits,
+                              int32_t *pValue )
+{
+    const char *p = *pp;
+    int32_t value = 0;
+    size_t n = 0;
+
+    while( ( p < pEnd ) && ( n < maxDigits ) && ( *p >= '0' ) && ( *p <= '9' ) )
+    {
+        value = value * 10 + ( *p++ - '0' );
+        n++;
+    }
+
+    /* a longer field fails on the separator expected after it */
+    if( n < minDigits )
+    {
+        return false;
+    }
+
+    *pp = p;
+    *pValue = value;
+
+    return true;
+}
+
+/*============================================================================*/
+/*!
+
+    Days from 1970-01-01 to a date of the proleptic Gregorian calendar
+
+    The year is counted from March, so the leap day is the last day of its
+    year, and split in 400 year eras of 146097 days.
+
+@param[in]
+    year
+        year
+
+@param[in]
+    month
+        month, from 1
+
+@param[in]
+    day
+        day of the month, from 1
+
+@return
+    the number of days, negative before 1970
+
+*/
+/*============================================================================*/
+static int64_t isotime_fnDays( int32_t year, int32_t month, int32_t day )
+{
+    int64_t era;
+    int64_t yearOfEra;
+    int64_t dayOfYear;
+    int64_t dayOfEra;
+
+    if( month <= 2 )
+    {
+        year--;
+    }
+
+    era = ( year >= 0 ? year : year - 399 ) / 400;
+    yearOfEra = year - era * 400;
+    dayOfYear = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 +
+                day - 1;
+    dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    /* 719468 days from 0000-03-01 to 1970-01-01 */
+    return era * 146097 + dayOfEra - 719468;
+}
+
+/*============================================================================*/
+/*!
+
+    Number of days of a month
+
+@param[in]
+    year
+        year
+
+@param[in]
+    month
+        month, from 1 to 12
+
+@return
+    the number of days
+
+*/
+/*============================================================================*/
+static int32_t isotime_fnMonthDays( int32_t year, int32_t month )
+{
+    static const int32_t days[ 12 ] =
+        { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = ( ( 0 == ( year % 4 ) ) && ( 0 != ( year % 100 ) ) ) ||
+                ( 0 == ( year % 400 ) );
+
+    return days[ month - 1 ] + ( ( ( 2 == month ) && leap ) ? 1 : 0 );
+}
+
+/*============================================================================*/
+/*!
+
+    Read the zone designator ending a time
+
+@param[in]
+    p
+        the designator
+
+@param[in]
+    pEnd
+        end of the text
+
+@param[out]
+    pOffset
+        seconds the local time is ahead of UTC, 0 without a designator
+
+@retval EOK    - pOffset holds the offset
+@retval EINVAL - the designator is malformed or text follows it
+
+*/
+/*============================================================================*/
+static int isotime_fnZone( const char *p, const char *pEnd, int32_t *pOffset )
+{
+    int32_t hours;
+    int32_t minutes = 0;
+    int32_t sign;
+
+    *pOffset = 0;
+    if( p >= pEnd )
+    {
+        return EOK;
+    }
+
+    if( ( 'Z' == *p ) || ( 'z' == *p ) )
+    {
+        return ( p + 1 == pEnd ) ? EOK : EINVAL;
+    }
+
+    if( ( '+' != *p ) && ( '-' != *p ) )
+    {
+        return EINVAL;
+    }
+
+    sign = ( '-' == *p++ ) ? -1 : 1;
+    if( false == isotime_fnNumber( &p, pEnd, 2u, 2u, &hours ) )
+    {
+        return EINVAL;
+    }
+
+    if( p < pEnd )
+    {
+        if( ':' == *p )
+        {
+            p++;
+        }
+
+        if( false == isotime_fnNumber( &p, pEnd, 2u, 2u, &minutes ) )
+        {
+            return EINVAL;
+        }
+    }
+
+    if( ( p != pEnd ) || ( hours > 23 ) || ( minutes > 59 ) )
+    {
+        return EINVAL;
+    }
+
+    *pOffset = sign * ( hours * 3600 + minutes * 60 );
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+    FNV-1a hash of a time text, picks its time cache entry
+
+@param[in]
+    pText
+        the text
+
+@param[in]
+    len
+        length of the text
+
+@return
+    the hash
+
+*/
+/*============================================================================*/
+static uint32_t isotime_fnHash( const char *pText, size_t len )
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for( i = 0; i < len; i++ )
+    {
+        hash ^= (uint8_t)pText[ i ];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//EoF
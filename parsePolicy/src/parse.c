@@ -19,6 +19,10 @@ Parse Data Points.
     This module provides a mechanism to create data points dynamically
     at run time based on data point descriptors read from a file
 
+    The data points are collected with their aliases, tags and meta data
+    and created in batches of DP_BULK_MAX_POINTS with DP_fnRegisterBulk.
+    A server which cannot create them in bulk gets the single calls.
+
 */
 
 /*==============================================================================
@@ -83,6 +87,10 @@ char *parse_fnAssignInstanceID( char *name,
                         size_t destlen );
 static int parse_fnAddTags( tzUserData *ptzUserData, char *pTags );
 static int parse_fnSetExtData( tzUserData *ptzUserData );
+static void parse_fnQueuePoint( tzUserData *ptzUserData );
+static int parse_fnFlushPoints( tzUserData *ptzUserData, bool single );
+static int parse_fnRegisterPoint( tzUserData *ptzUserData,
+                                  tzDpBulkPoint *pPoint );
 
 /*==============================================================================
                            Local/Private Variables
@@ -148,6 +156,7 @@ tzUserData userData;
     EOK - parse were created OK
     EINVAL - invalid argument specified
     ENOENT - input file could not be opened
+    ENOMEM - out of memory
     EIO - XML parsing error
 
 */
@@ -162,10 +171,8 @@ int PARSE_fnCreate( DP_HANDLE hDPRM,
                       void *pcbData,
                       uint32_t options )
 {
-    char buf[BUFSIZ];
-    int done = 0;
-    FILE *fp;
     XML_Parser parse;
+    int ret;
 
     /* open the data point manager */
     if( hDPRM == NULL )
@@ -184,19 +191,15 @@ int PARSE_fnCreate( DP_HANDLE hDPRM,
     userData.pcbData = pcbData;
     userData.extdata = false;
     userData.options = options;
-
-    /* open the input file */
-    fp = fopen( filename, "r" );
-    if( fp == NULL )
-    {
-        fprintf(stderr,
-                "unable to open data point input file %s\n",
-                filename);
-        return ENOENT;
-    }
+    userData.bulkRegister = true;
+    DP_fnBulkInit( &userData.bulk );
 
     /* create the XML parse */
     parse = XML_ParserCreate(NULL);
+    if( parse == NULL )
+    {
+        return ENOMEM;
+    }
 
     /* set the user data structure to be passed to the callback functions */
     XML_SetUserData(parse, &userData);
@@ -207,31 +210,24 @@ int PARSE_fnCreate( DP_HANDLE hDPRM,
     /* set up the character data callback handler */
     XML_SetCharacterDataHandler(parse, char_data);
 
-    /* process the input file in BUFSIZ chunks */
-    do
+    /* map the input file and parse it in one pass */
+    ret = XMLMAP_fnParseFile( parse, &userData.text, filename );
+    if( ret == ENOENT )
     {
-        /* read a chunk of the input file */
-        int len = (int)fread(buf, 1, sizeof(buf), fp);
-        done = len < sizeof(buf);
+        fprintf(stderr,
+                "unable to open data point input file %s\n",
+                filename);
+    }
 
-        /* pass the buffer to the XML parse */
-        if (XML_Parse(parse, buf, len, done) == XML_STATUS_ERROR)
-        {
-            fprintf(stderr,
-                  "%s at line %" XML_FMT_INT_MOD "u\n",
-                  XML_ErrorString(XML_GetErrorCode(parse)),
-                  XML_GetCurrentLineNumber(parse));
-            return EIO;
-        }
-    } while (!done);
+    /* create the data points still waiting, also those read before an
+     * error in the file */
+    parse_fnFlushPoints( &userData, false );
+    DP_fnBulkFree( &userData.bulk );
 
     /* close the parse */
     XML_ParserFree(parse);
 
-    /* close the input file */
-    fclose( fp );
-
-    return EOK;
+    return ret;
 }
 
 /*============================================================================*/
@@ -243,9 +239,9 @@ int PARSE_fnCreate( DP_HANDLE hDPRM,
 
     The char_data function is invoked by the XML parse when XML element
     character data is encountered.  This function may be invoked multiple times
-    for each XML element so the function needs to store the XML character data
-    into a character buffer for later processing (when the end_element callback
-    is invoked).
+    for each XML element so the function needs to record the XML character data
+    for later processing (when the end_element callback is invoked), see
+    XMLMAP_fnCharData.
 
 @param[in]
     userData
@@ -269,18 +265,10 @@ static void char_data (void *userData, const XML_Char *s, int len)
     {
         if (!ptzUserData->overflow)
         {
-            if (len + ptzUserData->offset >=
-                sizeof(ptzUserData->char_data_buffer) )
+            if( XMLMAP_fnCharData( &ptzUserData->text, s, len ) != EOK )
             {
                 ptzUserData->overflow = true;
             }
-            else
-            {
-                memcpy(ptzUserData->char_data_buffer + ptzUserData->offset,
-                       s,
-                       len);
-                ptzUserData->offset += len;
-            }
         }
     }
 }
@@ -327,7 +315,7 @@ static void start_element(void *userData,
         return;
     }
 
-    ptzUserData->start_offset = ptzUserData->offset;
+    XMLMAP_fnStartElement( &ptzUserData->text );
 
     if( ptzUserData->extdata == true )
     {
@@ -336,8 +324,6 @@ static void start_element(void *userData,
     else if( strcmp(element, "point") == 0 )
     {
         /* setup to begin parsing a data point creation record */
-        ptzUserData->offset = 0;
-        ptzUserData->start_offset = 0;
         ptzUserData->instanceID = ptzUserData->requestedInstanceID;
         ptzUserData->processingMeta = false;
         for(i=0;i<PARSE_MAX_ALIAS;i++)
@@ -347,10 +333,10 @@ static void start_element(void *userData,
 
         ptzUserData->aliasIndex = 0;
 
-        /* clear the character data buffer */
-        memset( ptzUserData->char_data_buffer,
-                0,
-                sizeof( ptzUserData->char_data_buffer ) );
+        /* release the text of the previous data point, it was copied
+         * into the batch */
+        XMLMAP_fnRelease( &ptzUserData->text );
+        DP_fnBulkDropMeta( &ptzUserData->bulk );
 
         /* clear the systemv variable information structure */
         memset( ptzUserData->dpInfo,
@@ -365,11 +351,8 @@ static void start_element(void *userData,
     }
     else if( strcmp( element, "meta") == 0 )
     {
-        /* start processing meta data */
-        ptzUserData->pMetaData = DP_fnMetaDataInit( ptzUserData->hDPRM,
-                                                        DP_OPTIONS_NONE );
-
-        /* indicate that meta data processing is in progress */
+        /* indicate that meta data processing is in progress, the pairs are
+         * kept with the data point in the batch */
         ptzUserData->processingMeta = true;
     }
     else if( strcmp( element, "extdata")  == 0 )
@@ -415,24 +398,24 @@ static void end_element(void *userData, const char *element)
     tzUserData *ptzUserData = userData;
     char *pElementData;
     static char namebuf[256];
-    char aliasbuf[256];
-    DP_HANDLE hDataPoint;
-    int rc;
-    int i;
+    tzDatapointExtData *pExtData;
 
     if( ptzUserData == NULL )
     {
         return;
     }
 
-    pElementData = &ptzUserData->char_data_buffer[ptzUserData->start_offset];
+    /* null terminated character data of the element */
+    pElementData = XMLMAP_fnEndElement( &ptzUserData->text );
+    if( pElementData == NULL )
+    {
+        ptzUserData->overflow = true;
+    }
 
-    /* null terminate the character data */
-    char_data(ptzUserData, "\0", 1);
     if( ptzUserData->overflow == true )
     {
-        fprintf(stderr, "data overflow processing element: %s\n", element );
-        /* we have a data overflow on our input buffer - we cannot
+        fprintf(stderr, "out of memory processing element: %s\n", element );
+        /* we ran out of memory for the character data - we cannot
          * do any further processing */
         return;
     }
@@ -446,17 +429,12 @@ static void end_element(void *userData, const char *element)
     /* process meta data */
     if( ptzUserData->processingMeta == true )
     {
-        if( ptzUserData->pMetaData != NULL )
+        /* try to add the element and its data as a key/value meta data pair */
+        if( DP_fnBulkAddMeta( &ptzUserData->bulk,
+                              element,
+                              pElementData ) != EOK )
         {
-            /* try to add the element and its data as a key/value meta data pair */
-            if( DP_fnMetaDataAdd( ptzUserData->hDPRM,
-                                  ptzUserData->pMetaData,
-                                  (char *)element,
-                                  pElementData,
-                                  DP_OPTIONS_NONE ) != EOK )
-            {
-                syslog(LOG_ERR, "Error adding meta data for %s : %s", element, pElementData);
-            }
+            syslog(LOG_ERR, "Error adding meta data for %s : %s", element, pElementData);
         }
     }
 
@@ -466,6 +444,7 @@ static void end_element(void *userData, const char *element)
     }
     else if( ptzUserData->extdata == true )
     {
+        ptzUserData->pElementData = pElementData;
         ptzUserData->end_element_handler( userData, element );
     }
     else if( strcmp(element, "id") == 0 )
@@ -624,135 +603,311 @@ static void end_element(void *userData, const char *element)
                         "Missing value for data point: %s\n",
                         ptzUserData->dpInfo[0].pName );
             }
-            else
+            else if( ptzUserData->pExtData != NULL )
             {
-                /* student is permitted to do anything, this is a back door */
-                /*ptzUserData->dpInfo[0].permissions.read |=
-                    PermissionBitmapGet( "student" );
-                ptzUserData->dpInfo[0].permissions.write |=
-                    PermissionBitmapGet( "student" );
-                ptzUserData->dpInfo[0].permissions.execute |=
-                    PermissionBitmapGet( "student" );*/
-
-                /* create the data point */
-                int res = DP_fnRegister( ptzUserData->hDPRM,
-                                   	   	     ptzUserData->instanceID,
-                                   	   	     &ptzUserData->dpInfo[0] );
-
-                if( res != EOK )
+                /* the extended data objects need the handle of the data
+                 * point, it is created on its own after the batch */
+                parse_fnFlushPoints( ptzUserData, false );
+                parse_fnQueuePoint( ptzUserData );
+                if( parse_fnFlushPoints( ptzUserData, true ) != EOK )
                 {
-//                	fprintf(stderr,"Failed to DP_fnRegister( %s )\n",
-//                			ptzUserData->dpInfo[0].pName );
-                	fprintf(stderr,".");
-                }
-                else
-                {
-                    /* get a handle to the variable we just added */
-                    hDataPoint = DP_fnFindByName( ptzUserData->hDPRM,
-                                                ptzUserData->dpInfo[0].pName);
-                    if( hDataPoint == NULL )
+                    /* the objects are not kept for the next data point */
+                    while( ptzUserData->pExtData != NULL )
                     {
-                        syslog( LOG_ERR,
-                                "Cannot get handle for %s",
-                                ptzUserData->dpInfo[0].pName );
+                        pExtData = ptzUserData->pExtData;
+                        ptzUserData->pExtData = pExtData->pNext;
+                        free( pExtData );
                     }
+                }
+                else if( parse_fnSetExtData( ptzUserData ) != EOK )
+                {
+                    syslog( LOG_ERR,
+                            "cannot set extended data objects for %s",
+                            ptzUserData->dpInfo[0].pName );
+                }
+            }
+            else
+            {
+                parse_fnQueuePoint( ptzUserData );
+            }
+        }
 
-                    /* create the alias */
-                    for(i=0;i<ptzUserData->aliasIndex;i++)
-                    {
-                        if( ptzUserData->pAlias[i] != NULL )
-                        {
-                            /* insert the instance identifier into the
-                             * alias (if applicable) */
-                            ptzUserData->instanceID =
-                                    ptzUserData->requestedInstanceID;
-                            parse_fnAssignInstanceID(ptzUserData->pAlias[i],
-                                             &(ptzUserData->instanceID),
-                                             aliasbuf,
-                                             sizeof(aliasbuf));
-
-                            rc = DP_fnAlias( ptzUserData->hDPRM,
-                                                 hDataPoint,
-                                                 aliasbuf,
-                                                 DP_OPTIONS_NONE );
-                            if( rc != EOK )
-                            {
-                                syslog( LOG_ERR,
-                                        "unable to create alias %s",
-                                        aliasbuf );
-                            }
-                        }
-                    }
+        /* the tags and meta data were copied into the batch */
+        free( ptzUserData->pTags );
+        ptzUserData->pTags = NULL;
+        DP_fnBulkDropMeta( &ptzUserData->bulk );
+    }
+}
 
-                    /* insert any extended data objects (if applicable) */
-                    if( ptzUserData->pExtData != NULL )
-                    {
-                        if( parse_fnSetExtData( ptzUserData ) != EOK )
-                        {
-                            syslog( LOG_ERR,
-                                    "cannot set extended data objects for %s",
-                                    ptzUserData->dpInfo[0].pName );
-                        }
-                    }
+/*============================================================================*/
+//fn  parse_fnQueuePoint
+/*!
 
-                    /* apply tags (if any) */
-                    if( ptzUserData->pTags != NULL )
-                    {
-                        /* set data point tags/attributes */
-                        if( DP_fnSetTagsByName( ptzUserData->hDPRM,
-                                                ptzUserData->dpInfo[0].pName,
-                                                ptzUserData->pTags,
-                                                0 ) != EOK )
-                        {
-                            syslog( LOG_ERR,
-                                    "cannot set tags for variable: %s",
-                                    ptzUserData->dpInfo[0].pName );
-                        }
-
-                        /* free the tags */
-                        free( ptzUserData->pTags );
-                        ptzUserData->pTags = NULL;
-                    }
+@brief
+    Add the data point which has been parsed to the batch
 
-                    /* invoke (trigger) the datapoint creation
-                     * callback function */
-                    if( ptzUserData->pCallback != NULL )
-                    {
-                        ptzUserData->pCallback( &ptzUserData->dpInfo[0],
-                                                ptzUserData->instanceID,
-                                                ptzUserData->pcbData );
-                    }
+    The aliases get the instance identifier, the batch is sent when it is
+    full.
 
-                    /* apply the meta data if any */
-                    if( ( ptzUserData->pMetaData != NULL ) &&
-                        ( hDataPoint != NULL ) )
-                    {
-                        /* assign the meta data to the data point */
-                        rc = DP_fnMetaDataAssign( ptzUserData->hDPRM,
-                                                     hDataPoint,
-                                                     ptzUserData->pMetaData,
-                                                     DP_OPTIONS_NONE );
-                        if( rc != EOK )
-                        {
-                            syslog(LOG_ERR,
-                                   "Cannot assign meta data to %s",
-                                   ptzUserData->dpInfo[0].pName);
-                        }
-
-                        /* clear meta data */
-                        ptzUserData->pMetaData = NULL;
-                    }
-                }
-            }
+@param[in]
+    ptzUserData
+        pointer to the tzUserData structure
+
+*/
+/*============================================================================*/
+static void parse_fnQueuePoint( tzUserData *ptzUserData )
+{
+    static char aliasbuf[PARSE_MAX_ALIAS][256];
+    char *pAliases[PARSE_MAX_ALIAS];
+    uint32_t instanceID = ptzUserData->instanceID;
+    int rc;
+    int i;
+
+    for(i=0;i<ptzUserData->aliasIndex;i++)
+    {
+        pAliases[i] = NULL;
+        if( ptzUserData->pAlias[i] != NULL )
+        {
+            /* insert the instance identifier into the alias
+             * (if applicable) */
+            ptzUserData->instanceID = ptzUserData->requestedInstanceID;
+            pAliases[i] = parse_fnAssignInstanceID( ptzUserData->pAlias[i],
+                                                    &(ptzUserData->instanceID),
+                                                    aliasbuf[i],
+                                                    sizeof(aliasbuf[i]) );
         }
     }
-    else
+
+    ptzUserData->instanceID = instanceID;
+
+    rc = DP_fnBulkAdd( &ptzUserData->bulk,
+                       instanceID,
+                       &ptzUserData->dpInfo[0],
+                       pAliases,
+                       ptzUserData->aliasIndex,
+                       ptzUserData->pTags );
+    if( rc == ENOSPC )
     {
-        /* We do not recognize this tag.
-         * Reset the offset to where it was before we started
-         * processing this tag */
-        ptzUserData->offset = ptzUserData->start_offset;
+        parse_fnFlushPoints( ptzUserData, false );
+        rc = DP_fnBulkAdd( &ptzUserData->bulk,
+                           instanceID,
+                           &ptzUserData->dpInfo[0],
+                           pAliases,
+                           ptzUserData->aliasIndex,
+                           ptzUserData->pTags );
     }
+
+    if( rc != EOK )
+    {
+        fprintf( stderr,
+                 "Cannot create data point %s: %s\n",
+                 ptzUserData->dpInfo[0].pName,
+                 strerror( rc ) );
+    }
+}
+
+/*============================================================================*/
+//fn  parse_fnFlushPoints
+/*!
+
+@brief
+    Create the data points of the batch
+
+    The batch is sent in one message.  When the server cannot create data
+    points in bulk (ENOSYS), or single is set, the data points are created
+    one at a time and the batches which follow are not sent either.  The
+    creation callback is invoked for every data point created.
+
+@param[in]
+    ptzUserData
+        pointer to the tzUserData structure
+
+@param[in]
+    single
+        create the data points one at a time
+
+@return
+    EOK if every data point was created, otherwise the error of the last
+    one which was not
+
+*/
+/*============================================================================*/
+static int parse_fnFlushPoints( tzUserData *ptzUserData, bool single )
+{
+    static int32_t results[DP_BULK_MAX_POINTS];
+    tzDpBulkPoint point;
+    size_t offset = 0;
+    uint32_t i = 0;
+    int ret = EOK;
+    int rc = ENOSYS;
+    int res;
+
+    if( ptzUserData->bulk.numPoints == 0 )
+    {
+        return EOK;
+    }
+
+    if( ( ptzUserData->bulkRegister == true ) && ( single == false ) )
+    {
+        rc = DP_fnRegisterBulk( ptzUserData->hDPRM,
+                                &ptzUserData->bulk,
+                                results );
+        if( rc == ENOSYS )
+        {
+            ptzUserData->bulkRegister = false;
+        }
+    }
+
+    while( DP_fnBulkNext( ptzUserData->bulk.pBuf,
+                          ptzUserData->bulk.length,
+                          &offset,
+                          &point ) == EOK )
+    {
+        if( rc == ENOSYS )
+        {
+            res = parse_fnRegisterPoint( ptzUserData, &point );
+        }
+        else
+        {
+            res = ( rc == EOK ) ? results[i] : rc;
+        }
+
+        if( res != EOK )
+        {
+//            fprintf(stderr,"Failed to DP_fnRegister( %s )\n",
+//                    point.info.pName );
+            fprintf(stderr,".");
+            ret = res;
+        }
+        else if( ptzUserData->pCallback != NULL )
+        {
+            /* invoke (trigger) the datapoint creation callback function */
+            ptzUserData->pCallback( &point.info,
+                                    point.instanceID,
+                                    ptzUserData->pcbData );
+        }
+
+        i++;
+    }
+
+    DP_fnBulkClear( &ptzUserData->bulk );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  parse_fnRegisterPoint
+/*!
+
+@brief
+    Create a data point of the batch with the single calls
+
+@param[in]
+    ptzUserData
+        pointer to the tzUserData structure
+
+@param[in]
+    pPoint
+        the data point, decoded from the batch
+
+@return
+    the result of DP_fnRegister
+
+*/
+/*============================================================================*/
+static int parse_fnRegisterPoint( tzUserData *ptzUserData,
+                                  tzDpBulkPoint *pPoint )
+{
+    tzDataPointMetaData *pMetaData;
+    DP_HANDLE hDataPoint;
+    char *pAlias;
+    char *pKey;
+    int res;
+    int rc;
+    int i;
+
+    /* create the data point */
+    res = DP_fnRegister( ptzUserData->hDPRM,
+                         pPoint->instanceID,
+                         &pPoint->info );
+    if( res != EOK )
+    {
+        return res;
+    }
+
+    /* get a handle to the variable we just added */
+    hDataPoint = DP_fnFindByName( ptzUserData->hDPRM, pPoint->info.pName );
+    if( hDataPoint == NULL )
+    {
+        syslog( LOG_ERR, "Cannot get handle for %s", pPoint->info.pName );
+    }
+
+    /* create the aliases */
+    pAlias = pPoint->pAliases;
+    for(i=0;i<pPoint->numAliases;i++)
+    {
+        rc = DP_fnAlias( ptzUserData->hDPRM,
+                         hDataPoint,
+                         pAlias,
+                         DP_OPTIONS_NONE );
+        if( rc != EOK )
+        {
+            syslog( LOG_ERR, "unable to create alias %s", pAlias );
+        }
+
+        pAlias += strlen( pAlias ) + 1;
+    }
+
+    /* apply tags (if any) */
+    if( pPoint->pTags != NULL )
+    {
+        /* set data point tags/attributes */
+        if( DP_fnSetTagsByName( ptzUserData->hDPRM,
+                                pPoint->info.pName,
+                                pPoint->pTags,
+                                0 ) != EOK )
+        {
+            syslog( LOG_ERR,
+                    "cannot set tags for variable: %s",
+                    pPoint->info.pName );
+        }
+    }
+
+    /* apply the meta data if any */
+    if( ( pPoint->numMeta > 0 ) && ( hDataPoint != NULL ) )
+    {
+        pMetaData = DP_fnMetaDataInit( ptzUserData->hDPRM, DP_OPTIONS_NONE );
+        pKey = pPoint->pMeta;
+        for(i=0;( i<pPoint->numMeta ) && ( pMetaData != NULL );i++)
+        {
+            /* the value follows its key */
+            pAlias = pKey + strlen( pKey ) + 1;
+            if( DP_fnMetaDataAdd( ptzUserData->hDPRM,
+                                  pMetaData,
+                                  pKey,
+                                  pAlias,
+                                  DP_OPTIONS_NONE ) != EOK )
+            {
+                syslog(LOG_ERR, "Error adding meta data for %s : %s", pKey, pAlias);
+            }
+
+            pKey = pAlias + strlen( pAlias ) + 1;
+        }
+
+        /* assign the meta data to the data point */
+        if( ( pMetaData == NULL ) ||
+            ( DP_fnMetaDataAssign( ptzUserData->hDPRM,
+                                   hDataPoint,
+                                   pMetaData,
+                                   DP_OPTIONS_NONE ) != EOK ) )
+        {
+            syslog(LOG_ERR,
+                   "Cannot assign meta data to %s",
+                   pPoint->info.pName);
+        }
+    }
+
+    return EOK;
 }
 
 /*============================================================================*/
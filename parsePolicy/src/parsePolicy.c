@@ -39,10 +39,21 @@ Parse Policy File.
                 <type>password</type>
                 <location></location>
                 <time></time>
-                <user>Ekta</user>
+                <user>Ekta,Bob</user>
                 <group>Eng</group>
             </attributes>
         </policy>
+        <policy>
+            <rule>comparator</rule>
+            <attributes>
+                <type>speed</type>
+                <location>vancouver</location>
+                <condition>
+                    value ge 10 and value le 80 and age lt 60
+                    or user in (bob, gus) and delta lt 5
+                </condition>
+            </attributes>
+        </policy>
     </policyFile>
 
     Date: Feb 28, 2017
@@ -66,6 +77,7 @@ Parse Policy File.
 #include <stdbool.h>
 #include <dlfcn.h>
 #include <syslog.h>
+#include <pthread.h>
 #include "minicloud.h"
 #include "defdp.h"
 #include "expat.h"
@@ -85,6 +97,9 @@ Parse Policy File.
 #define XML_FMT_INT_MOD "l"
 #endif
 
+/*! slots of the element name lookup, a power of two */
+#define POLICY_TAG_SLOT_MASK    ( 31u )
+
 /*==============================================================================
                                Macros
 ==============================================================================*/
@@ -97,6 +112,23 @@ Parse Policy File.
                               Structures
 ==============================================================================*/
 
+/*! slot of the element name lookup */
+typedef struct zPolicyTagSlot
+{
+    /*! element name, in lower case */
+    const char *name;
+
+    /*! length of the name, 0 for an empty slot */
+    size_t len;
+
+    /*! the name matches in lower case only */
+    bool exact;
+
+    /*! tag of the element */
+    tePolicyTag tag;
+
+} tzPolicyTagSlot;
+
 /*==============================================================================
                         Local/Private Function Protoypes
 ==============================================================================*/
@@ -106,17 +138,39 @@ static void XMLCALL PolicyStartElementCallback(void *policyData,
                           const char **attribute);
 static void XMLCALL PolicyEndElementCallback( void *policyData,
                                               const char *element);
-static int parse_fnDateString2Tm( char* dateStr, struct tm *date );
-static int policy_fnTimeTokenizer( char* timeStr, struct tm *date );
+static void parse_fnRuleDone( DP_TICKET ticket, int status, void *pArg );
+static void parse_fnRuleHandlerKeys( void );
 /*==============================================================================
                            Local/Private Variables
 ==============================================================================*/
-tzPolicyData policyData;
+/*! creates the rule handler keys once */
+static pthread_once_t ruleHandlerOnce = PTHREAD_ONCE_INIT;
+
+/*! handler of the complete rules of a thread, NULL to register them with
+ *  the server */
+static pthread_key_t ruleHandlerKey;
+
+/*! context passed to the rule handler of a thread */
+static pthread_key_t ruleContextKey;
 
 /*==============================================================================
                            Local/Private Constants
 ==============================================================================*/
 
+/*! element names of the <policyFile> schema by slot, ( name[0] + name[1] )
+ *  folded to lower case, modulo 32 */
+static const tzPolicyTagSlot policyTagSlots[ POLICY_TAG_SLOT_MASK + 1u ] =
+{
+    [  7 ] = { "rule",      4, false, POLICY_TAG_RULE },
+    [  8 ] = { "user",      4, false, POLICY_TAG_USER },
+    [ 13 ] = { "type",      4, false, POLICY_TAG_TYPE },
+    [ 18 ] = { "condition", 9, false, POLICY_TAG_CONDITION },
+    [ 25 ] = { "group",     5, false, POLICY_TAG_GROUP },
+    [ 27 ] = { "vendor",    6, false, POLICY_TAG_VENDOR },
+    [ 29 ] = { "time",      4, false, POLICY_TAG_TIME },
+    [ 31 ] = { "policy",    6, true,  POLICY_TAG_POLICY },
+};
+
 /*==============================================================================
                            Function Definitions
 ==============================================================================*/
@@ -145,43 +199,43 @@ tzPolicyData policyData;
     EOK - parse were created OK
     EINVAL - invalid argument specified
     ENOENT - input file could not be opened
+    ENOMEM - out of memory
     EIO - XML parsing error
 
 */
 /*============================================================================*/
 int PARSE_fnPolicyCreate( DP_HANDLE hDPRM, char *filename)
 {
-    char buf[BUFSIZ];
-    int done = 0;
-    FILE *fp;
     XML_Parser parse;
+    tzPolicyData *pPolicyData;
+    int ret;
 
-    /* open the minicloud resource manager */
-    if( hDPRM == NULL )
+    /* open the minicloud resource manager, not needed by a rule handler */
+    if( ( hDPRM == NULL ) && ( false == PARSE_fnHasRuleHandler() ) )
     {
         fprintf(stderr, "Unable to open minicloud Resource Manager\n");
         return EINVAL;
     }
 
-    /* populate the policyData structure */
-    memset(&policyData, 0, sizeof(policyData) );
-    policyData.hDPRM = hDPRM;
-
-    /* open the input file */
-    fp = fopen( filename, "r" );
-    if( fp == NULL )
+    /* populate the policyData structure, one per parse so that files can
+     * be parsed concurrently */
+    pPolicyData = calloc( 1, sizeof(tzPolicyData) );
+    if( pPolicyData == NULL )
     {
-        fprintf(stderr,
-                "unable to open data point input file %s\n",
-                filename);
-        return ENOENT;
+        return ENOMEM;
     }
+    pPolicyData->hDPRM = hDPRM;
 
     /* create the XML parse */
     parse = XML_ParserCreate(NULL);
+    if( parse == NULL )
+    {
+        free( pPolicyData );
+        return ENOMEM;
+    }
 
     /* set the user data structure to be passed to the callback functions */
-    XML_SetUserData(parse, &policyData);
+    XML_SetUserData(parse, pPolicyData);
 
     /* set up the start and end element callback handlers */
     XML_SetElementHandler( parse,
@@ -191,31 +245,20 @@ int PARSE_fnPolicyCreate( DP_HANDLE hDPRM, char *filename)
     /* set up the character data callback handler */
     XML_SetCharacterDataHandler(parse, char_data);
 
-    /* process the input file in BUFSIZ chunks */
-    do
+    /* map the input file and parse it in one pass */
+    ret = XMLMAP_fnParseFile( parse, &pPolicyData->text, filename );
+    if( ret == ENOENT )
     {
-        /* read a chunk of the input file */
-        int len = (int)fread(buf, 1, sizeof(buf), fp);
-        done = len < sizeof(buf);
-
-        /* pass the buffer to the XML parse */
-        if (XML_Parse(parse, buf, len, done) == XML_STATUS_ERROR)
-        {
-            fprintf(stderr,
-                  "%s at line %" XML_FMT_INT_MOD "u\n",
-                  XML_ErrorString(XML_GetErrorCode(parse)),
-                  XML_GetCurrentLineNumber(parse));
-            return EIO;
-        }
-    } while (!done);
+        fprintf(stderr,
+                "unable to open data point input file %s\n",
+                filename);
+    }
 
     /* close the parse */
     XML_ParserFree(parse);
+    free( pPolicyData );
 
-    /* close the input file */
-    fclose( fp );
-
-    return EOK;
+    return ret;
 }
 
 /*============================================================================*/
@@ -252,7 +295,7 @@ static void XMLCALL PolicyStartElementCallback(void *policyData,
                           const char *name,
                           const char **atts)
 {
-    int i = 0;
+    tePolicyTag tag;
 
     tzPolicyData *ptzPolicyData = policyData;
     if( ptzPolicyData == NULL )
@@ -260,39 +303,16 @@ static void XMLCALL PolicyStartElementCallback(void *policyData,
         return;
     }
 
-    ptzPolicyData->start_offset = ptzPolicyData->offset;
-
-    if( strcmp( name, "policy" ) == 0 )
-    {
-        /* setup to begin parsing a policy block */
-        ptzPolicyData->offset = 0;
-        ptzPolicyData->start_offset = 0;
-
-        /* clear the character data buffer */
-        memset( ptzPolicyData->char_data_policy_buffer,
-                0,
-                sizeof( ptzPolicyData->char_data_policy_buffer ) );
+    XMLMAP_fnStartElement( &ptzPolicyData->text );
 
-        /* clear the entire policy data structure */
-        memset( &ptzPolicyData->policy,
-                0,
-                sizeof( struct zPOLICY ) );
-    }
-    else if( strcasecmp(name, "rule") == 0 )
+    tag = PARSE_fnPolicyTag( name, strlen( name ) );
+    if( tag == POLICY_TAG_POLICY )
     {
-        while( atts[i] != NULL )
-        {
-            if( (strcasecmp( atts[ i ], "min" ) == 0) )
-            {
-                ptzPolicyData->policy.min = atoi(atts[i+1]);
-            }
-            else if((strcasecmp( atts[ i ], "max" ) == 0))
-            {
-                ptzPolicyData->policy.max = atoi(atts[i+1]);
-            }
-            i+=2;
-        }
+        /* release the text of the previous policy block */
+        XMLMAP_fnRelease( &ptzPolicyData->text );
     }
+
+    PARSE_fnPolicyStart( ptzPolicyData, tag, atts );
 }
 
 /*============================================================================*/
@@ -329,20 +349,174 @@ static void XMLCALL PolicyEndElementCallback( void *policyData,
         return;
     }
 
-    pElementData =
-        &ptzPolicyData->char_data_policy_buffer[ptzPolicyData->start_offset];
+    /* null terminated character data of the element */
+    pElementData = XMLMAP_fnEndElement( &ptzPolicyData->text );
+    if( pElementData == NULL )
+    {
+        ptzPolicyData->overflow = true;
+    }
 
-    /* null terminate the character data */
-    char_data(ptzPolicyData, "\0", 1);
     if( ptzPolicyData->overflow == true )
     {
-        fprintf(stderr, "data overflow processing element: %s\n", element );
-        /* we have a data overflow on our input buffer - we cannot
+        fprintf(stderr, "out of memory processing element: %s\n", element );
+        /* we ran out of memory for the character data - we cannot
          * do any further processing */
         return;
     }
 
-    if( stricmp(element, "rule") == 0 )
+    PARSE_fnPolicyEnd( ptzPolicyData,
+                       PARSE_fnPolicyTag( element, strlen( element ) ),
+                       pElementData );
+}
+
+/*============================================================================*/
+//fn  PARSE_fnPolicyTag
+/*!
+
+@brief
+    Look up an element of the <policyFile> schema
+
+    The element names of the schema are placed in a table of 32 slots by
+    the sum of their first two characters, folded to lower case, so a name
+    is found with one slot and one string compare.  "policy" matches in
+    lower case only, the other names in any case.
+
+@param[in]
+    name
+        element name, not necessarily NUL terminated
+
+@param[in]
+    len
+        length of the name
+
+@return
+    tag of the element, POLICY_TAG_OTHER if not part of the schema
+
+*/
+/*============================================================================*/
+tePolicyTag PARSE_fnPolicyTag( const char *name, size_t len )
+{
+    const tzPolicyTagSlot *pSlot;
+    unsigned int slot;
+
+    if( ( NULL == name ) || ( len < 2 ) )
+    {
+        return POLICY_TAG_OTHER;
+    }
+
+    slot = ( (unsigned char)( name[0] | 0x20 ) +
+             (unsigned char)( name[1] | 0x20 ) ) & POLICY_TAG_SLOT_MASK;
+
+    pSlot = &policyTagSlots[ slot ];
+    if( ( pSlot->len != len ) ||
+        ( ( true == pSlot->exact ) ?
+              ( 0 != memcmp( name, pSlot->name, len ) ) :
+              ( 0 != strncasecmp( name, pSlot->name, len ) ) ) )
+    {
+        return POLICY_TAG_OTHER;
+    }
+
+    return pSlot->tag;
+}
+
+/*============================================================================*/
+//fn  PARSE_fnPolicyStart
+/*!
+
+@brief
+    Process the start of a <policyFile> element
+
+    Shared by the expat callbacks and the pull tokenizer, see parsePull.c.
+
+@param[in]
+    ptzPolicyData
+        policy parser state
+
+@param[in]
+    tag
+        element which starts
+
+@param[in]
+    atts
+        NULL terminated array of attribute name and value pairs: in here,
+        used for min and max assignment of the 'comparator rule':
+        <rule min = "25" max = "60">comparator</rule>
+
+*/
+/*============================================================================*/
+void PARSE_fnPolicyStart( tzPolicyData *ptzPolicyData,
+                          tePolicyTag tag,
+                          const char **atts )
+{
+    int i = 0;
+
+    if( tag == POLICY_TAG_POLICY )
+    {
+        /* clear the entire policy data structure */
+        memset( &ptzPolicyData->policy,
+                0,
+                sizeof( struct zPOLICY ) );
+
+        /* no users and groups means wild card */
+        memset( ptzPolicyData->userList,
+                0,
+                sizeof( ptzPolicyData->userList ) );
+        memset( ptzPolicyData->groupList,
+                0,
+                sizeof( ptzPolicyData->groupList ) );
+
+        /* no condition */
+        memset( ptzPolicyData->condition,
+                0,
+                sizeof( ptzPolicyData->condition ) );
+    }
+    else if( tag == POLICY_TAG_RULE )
+    {
+        while( atts[i] != NULL )
+        {
+            if( (strcasecmp( atts[ i ], "min" ) == 0) )
+            {
+                ptzPolicyData->policy.min = atoi(atts[i+1]);
+            }
+            else if((strcasecmp( atts[ i ], "max" ) == 0))
+            {
+                ptzPolicyData->policy.max = atoi(atts[i+1]);
+            }
+            i+=2;
+        }
+    }
+}
+
+/*============================================================================*/
+//fn  PARSE_fnPolicyEnd
+/*!
+
+@brief
+    Process the end of a <policyFile> element
+
+    Populates the policy rule from the character data of the element and
+    hands the rule over at the end of a <policy>.  Shared by the expat
+    callbacks and the pull tokenizer, see parsePull.c.
+
+@param[in]
+    ptzPolicyData
+        policy parser state
+
+@param[in]
+    tag
+        element which ends
+
+@param[in]
+    pElementData
+        NUL terminated character data of the element, may be edited
+
+*/
+/*============================================================================*/
+void PARSE_fnPolicyEnd( tzPolicyData *ptzPolicyData,
+                        tePolicyTag tag,
+                        char *pElementData )
+{
+    if( tag == POLICY_TAG_RULE )
     {
         if( stricmp(pElementData, "comparator" ) == 0 )
         {
@@ -357,7 +531,7 @@ static void XMLCALL PolicyEndElementCallback( void *policyData,
             ptzPolicyData->policy.Name = POLICY_NAME_INVALID;
         }
     }
-    else if( stricmp(element, "type") == 0 )
+    else if( tag == POLICY_TAG_TYPE )
     {
         if( stricmp(pElementData, "temperature" ) == 0 )
         {
@@ -415,99 +589,63 @@ static void XMLCALL PolicyEndElementCallback( void *policyData,
     /* July 17, 2017 -- note that the name of the location changed to vendor
      * as per Ekta's request to cope with dynamic environments policy
      * constructions. */
-    else if( stricmp(element, "vendor") == 0 )
+    else if( tag == POLICY_TAG_VENDOR )
     {
-        strcpy(ptzPolicyData->policy.Location, strlwr( pElementData) );
+        /* the policy block is cleared, the copy stays terminated */
+        strncpy( ptzPolicyData->policy.Location,
+                 strlwr( pElementData ),
+                 sizeof( ptzPolicyData->policy.Location ) - 1 );
     }
-    else if( stricmp(element, "time") == 0 )
+    else if( tag == POLICY_TAG_TIME )
     {
-        /* convert time string to timespec only if not null and not empty("") */
+        /* convert the ISO 8601 time only if not null and not empty("") */
         if( (NULL != pElementData) && ( 0 != strcmp(EMPTY, pElementData) ) )
         {
-            strncpy( ptzPolicyData->timeString,
-                     pElementData,
-                     strlen(pElementData)+1 );
-
-            if( EOK != parse_fnDateString2Tm( ptzPolicyData->timeString,
-                                              &ptzPolicyData->tm_time ) )
+            if( EOK != PARSE_fnPolicyTime( ptzPolicyData, pElementData ) )
             {
-                printf("cannot tokenize the date");
+                fprintf(stderr, "cannot convert the time %s\n", pElementData );
             }
-            time_t t_t = mktime( &ptzPolicyData->tm_time );
-            ptzPolicyData->policy.time.tv_sec = t_t;
         }
-
-        memset(ptzPolicyData->timeString, 0, TIME_STR_LENGTH);
-        memset(&ptzPolicyData->tm_time, 0, sizeof(struct tm));
-
     }
-    else if( stricmp(element, "user") == 0 )
+    else if( tag == POLICY_TAG_USER )
     {
-        if( 0 == stricmp(pElementData, "gus") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_GUS;
-        }
-        else if( 0 == stricmp(pElementData, "doug") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_DOUG;
-        }
-        else if( 0 == stricmp(pElementData, "mike") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_MIKE;
-        }
-        else if( 0 == stricmp(pElementData, "tom") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_TOM;
-        }
-        else if( 0 == stricmp(pElementData, "jackie") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_JACKIE;
-        }
-        else if( 0 == stricmp(pElementData, "lilli") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_LILLI;
-        }
-        else if( 0 == stricmp(pElementData, "bob") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_BOB;
-        }
-        else if( 0 == stricmp(pElementData, "madi") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_MADI;
-        }
-        else
-        {
-            ptzPolicyData->policy.user = USER_CODE_INVALID;
-        }
+        /* comma separated users, the server interns them to a user set */
+        PARSE_fnCopySubjects( ptzPolicyData->userList,
+                              sizeof( ptzPolicyData->userList ),
+                              pElementData,
+                              "user" );
     }
-    else if( stricmp(element, "group") == 0 )
+    else if( tag == POLICY_TAG_GROUP )
     {
-        if( 0 == stricmp(pElementData, "manager") )
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_MANAGER;
-        }
-        else if( 0 == stricmp(pElementData, "engineering") )
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_ENG;
-        }
-        else if( 0 == stricmp(pElementData, "technician") )
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_TECH;
-        }
-        else if( 0 == stricmp(pElementData, "customer") )
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_CUSTOMER;
-        }
-        else
+        /* comma separated groups, the server interns them to a group set */
+        PARSE_fnCopySubjects( ptzPolicyData->groupList,
+                              sizeof( ptzPolicyData->groupList ),
+                              pElementData,
+                              "group" );
+    }
+    else if( tag == POLICY_TAG_CONDITION )
+    {
+        /* compiled with the complete rule, the rule name may follow */
+        strncpy( ptzPolicyData->condition,
+                 pElementData,
+                 sizeof( ptzPolicyData->condition ) - 1 );
+        if( strlen( pElementData ) >= sizeof( ptzPolicyData->condition ) )
         {
-            ptzPolicyData->policy.group = GROUP_CODE_INVALID;
+            /* a cut condition could permit more, an unbalanced one fails to
+             * compile and the rule denies */
+            strcpy( ptzPolicyData->condition, "(" );
+            fprintf(stderr, "condition too long\n" );
         }
     }
-    else if( strcmp(element, "policy") == 0 )
+    else if( tag == POLICY_TAG_POLICY )
     {
+        /* compile the condition, a plain value range becomes min max */
+        PARSE_fnCompileCondition( ptzPolicyData->condition,
+                                  &ptzPolicyData->policy,
+                                  &ptzPolicyData->program );
+
         /* create the policy */
-        int res = DP_fnRegisterPolicy( ptzPolicyData->hDPRM,
-                                       &ptzPolicyData->policy );
+        int res = PARSE_fnRegisterRule( ptzPolicyData );
         if( res != EOK )
         {
             syslog( LOG_ERR, "Failed to create DP_fnRegisterPolicy" );
@@ -520,15 +658,11 @@ static void XMLCALL PolicyEndElementCallback( void *policyData,
          * the reseting below has been done at the start of each policy rule
          * in the start element and here is redundant, remove it in future */
         memset( &ptzPolicyData->policy, 0, sizeof(struct zPOLICY ) );
+        memset( ptzPolicyData->userList, 0, sizeof(ptzPolicyData->userList) );
+        memset( ptzPolicyData->groupList, 0, sizeof(ptzPolicyData->groupList) );
+        memset( ptzPolicyData->condition, 0, sizeof(ptzPolicyData->condition) );
 
     }
-    else
-    {
-        /* We do not recognise this tag.
-         * Reset the offset to where it was before we started
-         * processing this tag */
-        ptzPolicyData->offset = ptzPolicyData->start_offset;
-    }
 }
 
 /*============================================================================*/
@@ -540,9 +674,9 @@ static void XMLCALL PolicyEndElementCallback( void *policyData,
 
     The char_data function is invoked by the XML parse when XML element
     character data is encountered.  This function may be invoked multiple times
-    for each XML element so the function needs to store the XML character data
-    into a character buffer for later processing (when the end_element callback
-    is invoked).
+    for each XML element so the function needs to record the XML character data
+    for later processing (when the end_element callback is invoked), see
+    XMLMAP_fnCharData.
 
 @param[in]
     policyData
@@ -566,260 +700,221 @@ static void char_data (void *policyData, const XML_Char *s, int len)
     {
         if (!ptzPolicyData->overflow)
         {
-            if (len + ptzPolicyData->offset >=
-                sizeof(ptzPolicyData->char_data_policy_buffer) )
+            if( XMLMAP_fnCharData( &ptzPolicyData->text, s, len ) != EOK )
             {
                 ptzPolicyData->overflow = true;
             }
-            else
-            {
-                memcpy( ptzPolicyData->char_data_policy_buffer +
-                        ptzPolicyData->offset,
-                        s,
-                        len );
-                ptzPolicyData->offset += len;
-            }
         }
     }
 }
 
 /*============================================================================*/
+//fn  PARSE_fnCopySubjects
 /*!
 
-    get date as string and return each date item as in tm structure
+@brief
+    Copy a comma separated user or group list of a policy rule
+
+    The <user> and <group> elements may list several names separated by
+    commas, e.g. <user>bob,gus</user>.  The list is kept as text and sent
+    to the server which interns every name to a bit of the rule subject
+    set.  An empty element is a wild card.
 
-    get date in "YYYY-MM-DD HH:MM:SS" or "YYYY-MM-DDTHH:MM:SS" format
-    tokenize and return each item as in tm structure.
+@param[out]
+    pList
+        buffer receiving the list
 
 @param[in]
-    dateStr
-     "<YYYY-MM-DD>T<HH:MM:SS>" format
-     or
-     "<YYYY-MM-DD> <HH:MM:SS>" format
+    listLen
+        size of the list buffer
 
-@param[out]
-    date
-        The extracted values from dateStr in "struct tm" format.
+@param[in]
+    pElementData
+        character data of the element
 
-@retval EOK    - if conversion successful
-@retval EINVAL - If null pointer detected
+@param[in]
+    element
+        name of the element, used for reporting
 
 */
 /*============================================================================*/
-static int parse_fnDateString2Tm( char* dateStr, struct tm *date )
+void PARSE_fnCopySubjects( char *pList,
+                           size_t listLen,
+                           const char *pElementData,
+                           const char *element )
 {
-    time_t      timenow     = 0;
-    struct tm * tm_timenow  = NULL;
-    /* should be year since 1900 (from 0); will subtract (2016 - 1900 )*/
-    char YYYY[ DATE_STRING_LEN ]        = "1900";
-    char MM[ DATE_STRING_LEN ]          = "00"; //  month of the year (from 0)
-    char DD[ DATE_STRING_LEN ]          = "01"; // day of the month (from 1)
-    char pYYYYMMDD[ DATE_STRING_LEN ]   = "0";
-    char pHHMMSSmmm[ DATE_STRING_LEN ]  = "0";
-    char *token         = NULL;
-    char dateStrCopy[TIME_STR_LENGTH];
-    int notime          = 0;
-    int retval          = EOK;
-
-    timenow = time(NULL);
-    tm_timenow = localtime(&timenow);
-
-    memset(dateStrCopy, 0, sizeof(dateStrCopy));
-
-    if( ( NULL == dateStr ) || ( NULL == date ) )
+    char *pComma = NULL;
+
+    if( ( NULL == pList ) || ( 0 == listLen ) || ( NULL == pElementData ) )
     {
-        retval = EINVAL;
+        return;
     }
-    else
-    {
-        /* strtok function modifies its input string,
-         * make a working copy to play with*/
-        strncpy(dateStrCopy, dateStr, strlen(dateStr)+1 );
 
-        /* get first token, it is yyyy-mm-dd */
-        token = strtok( dateStrCopy, TIMETAGSPACE );
-        if( !token )
+    strncpy( pList, pElementData, listLen - 1 );
+    pList[ listLen - 1 ] = '\0';
+
+    if( strlen( pElementData ) >= listLen )
+    {
+        /* never send a partial name, it could match another subject */
+        pComma = strrchr( pList, ',' );
+        if( NULL != pComma )
         {
-            /* todo March 22 2017 - Mehdi - change this to 1970 from beginning of time */
-            memcpy(date, tm_timenow, sizeof(struct tm) );
+            *pComma = '\0';
         }
-        else
-        {
-            strcpy( pYYYYMMDD, token );
 
-            /* get second token, it is Time. */
-            token = strtok( NULL, TIMETAGSPACE );
-            if( token )
-            {
-                strcpy( pHHMMSSmmm, token );
-            }
-            else
-            {
-                notime = 1;
-            }
-
-            /* get YYYY */
-            token = strtok( pYYYYMMDD, DASHSLASH );
-            if( !token )
-            {
-                retval = EINVAL;
-            }
-            else
-            {
-                strcpy( YYYY, token );
-
-                /* get second token, it is Month. */
-                token = strtok( NULL, DASHSLASH );
-                if( !token )
-                {
-                    retval = EINVAL;
-                }
-                else
-                {
-                    strcpy( MM, token );
-
-                    /* get Day token. */
-                    token = strtok( NULL, DASHSLASH );
-                    /* check Month token is not null */
-                    if( !token )
-                    {
-                        retval = EINVAL;
-                    }
-                    else
-                    {
-                        strcpy( DD, token );
-
-                        /* pre-populate the date first for the sake
-                         * of offset and timezone */
-                        memcpy( date, tm_timenow, sizeof( struct tm ) );
-
-                        /* change the year month and day based on
-                         * the incoming requested time */
-                        date->tm_year = atoi( YYYY ) - 1900;
-                        // years since 1900 (from 0)
-                        date->tm_mon  = atoi( MM ) - 1;
-                        // months since January -- [0,11]
-                        date->tm_mday = atoi( DD );
-
-                        if( notime )
-                        {
-                            date->tm_hour = 00;
-                            date->tm_min = 00;
-                            date->tm_sec = 00;
-                        }
-                        else
-                        {
-                            retval = policy_fnTimeTokenizer (pHHMMSSmmm, date);
-                        }
-                    }
-                }
-            }
-        }
+        fprintf(stderr, "%s list too long, truncated: %s\n",
+                element,
+                pList );
     }
-    return retval;
 }
 
 /*============================================================================*/
+//fn  PARSE_fnSetRuleHandler
 /*!
 
-    get time as string and return each time item as in tm structure
+@brief
+    Install the handler of the complete policy rules
 
-    get time in "HH:MM:SS" format and
-    tokenize and return each item as in tm structure.
+    By default the rules are registered with the server, "defdp -g" installs
+    the code generator instead.  The handler applies to the parses of the
+    calling thread only, so that threads can parse files concurrently each
+    with its own handler.
 
 @param[in]
-    timeStr
-     "HH:MM:SS" format. This string is modified by the function
+    pHandler
+        rule handler, NULL to register the rules with the server
 
 @param[in]
-    startFlag
-        if considerations to be made for tokenizing a start date search
+    pContext
+        context passed to the handler
 
-@param[in]
-    endFlag
-        if considerations to be made for tokenizing an end date search
+*/
+/*============================================================================*/
+void PARSE_fnSetRuleHandler( PARSE_fnRuleHandler pHandler, void *pContext )
+{
+    pthread_once( &ruleHandlerOnce, parse_fnRuleHandlerKeys );
 
-@param[out]
-    date
-        The extracted values from dateStr in "struct tm" format.
+    pthread_setspecific( ruleHandlerKey, (void *)pHandler );
+    pthread_setspecific( ruleContextKey, pContext );
+}
 
-@retval EOK    - if conversion successful
-@retval EINVAL - If null pointer detected
+/*============================================================================*/
+//fn  PARSE_fnHasRuleHandler
+/*!
+
+@brief
+    Test if a rule handler replaces the registration with the server
+
+@return
+    true if a rule handler is installed for the calling thread
 
 */
 /*============================================================================*/
-static int policy_fnTimeTokenizer( char* timeStr, struct tm *date )
+bool PARSE_fnHasRuleHandler( void )
 {
-    char HH[ DATE_STRING_LEN ]    = "0"; // hour of the day (from 0)
-    char mm[ DATE_STRING_LEN ]    = "0"; // minutes after the hour (from 0)
-    char SSmmm[ DATE_STRING_LEN ] = "0";
-    char SS[ DATE_STRING_LEN ]    = "0"; // seconds after the minute (from 0)
-    char nullSSmmm[ DATE_STRING_LEN ] = "00.000";
-    char nullmm[ DATE_STRING_LEN ]    = "00";
-    char nullHH[ DATE_STRING_LEN ]    = "00";
-    char nullSS[ DATE_STRING_LEN ]    = "00";
-    char *token           = NULL;
-    int  retval           = EOK;
-
-    if( ( NULL == timeStr ) || ( NULL == date ) )
+    pthread_once( &ruleHandlerOnce, parse_fnRuleHandlerKeys );
+
+    return ( NULL != pthread_getspecific( ruleHandlerKey ) );
+}
+
+/*============================================================================*/
+//fn  PARSE_fnRegisterRule
+/*!
+
+@brief
+    Hand a complete policy rule to the rule handler
+
+    Used by the XML and the XACML policy parsers at the end of a rule.
+
+@param[in]
+    ptzPolicyData
+        policy parser state holding the complete rule
+
+@return
+    EOK on success, any other standard error code on failure
+
+*/
+/*============================================================================*/
+int PARSE_fnRegisterRule( tzPolicyData *ptzPolicyData )
+{
+    PARSE_fnRuleHandler pHandler;
+    int ret;
+
+    pthread_once( &ruleHandlerOnce, parse_fnRuleHandlerKeys );
+
+    pHandler = (PARSE_fnRuleHandler)pthread_getspecific( ruleHandlerKey );
+    if( NULL != pHandler )
     {
-        retval = EINVAL;
+        return pHandler( ptzPolicyData,
+                         pthread_getspecific( ruleContextKey ) );
     }
-    else
+
+    /* queue the rule if the connection has a sender, the parser goes on
+     * with the next rule while the server registers this one */
+    ret = DP_fnRegisterPolicyAsync( ptzPolicyData->hDPRM,
+                                    &ptzPolicyData->policy,
+                                    ptzPolicyData->userList,
+                                    ptzPolicyData->groupList,
+                                    &ptzPolicyData->program,
+                                    parse_fnRuleDone,
+                                    (void *)(intptr_t)ptzPolicyData->policy.Name,
+                                    NULL );
+    if( ENOTCONN != ret )
     {
-        /* get HH */
-        token = strtok( timeStr, COLON );
-        if( token )
-        {
-            strcpy( HH, token );
-        }
-        else
-        {
-            strcpy( HH, nullHH );
-        }
+        return ret;
+    }
 
-        /* minutes token */
-        token = strtok( NULL, COLON );
-        if( token )
-        {
-            strcpy( mm, token );
+    return DP_fnRegisterPolicyProgram( ptzPolicyData->hDPRM,
+                                       &ptzPolicyData->policy,
+                                       ptzPolicyData->userList,
+                                       ptzPolicyData->groupList,
+                                       &ptzPolicyData->program );
+}
 
-        }
-        else
-        {
-            strcpy( mm, nullmm );
-        }
+/*============================================================================*/
+/*!
 
-        /* seconds token */
-        token = strtok( NULL, COLON );
-        if( token )
-        {
-            strcpy( SSmmm, token );
-        }
-        else
-        {
-            strcpy( SSmmm, nullSSmmm );
-        }
+    Create the thread specific keys of the rule handler, see
+    PARSE_fnSetRuleHandler
 
-        /* get SS */
-        token = strtok( SSmmm, DOT );
-        if( token )
-        {
-            strcpy( SS, token );
-        }
-        else
-        {
-            strcpy( SS, nullSS );
-        }
+*/
+/*============================================================================*/
+static void parse_fnRuleHandlerKeys( void )
+{
+    pthread_key_create( &ruleHandlerKey, NULL );
+    pthread_key_create( &ruleContextKey, NULL );
+}
 
-        date->tm_hour  = atoi( HH );
-        date->tm_min   = atoi( mm );
-        date->tm_sec   = atoi( SS );
-        date->tm_wday  = -1;
-        date->tm_yday  = -1;
-    }
+/*============================================================================*/
+/*!
+
+    Report a queued rule the server failed to register
+
+@param[in]
+    ticket
+        ticket of the registration
+
+@param[in]
+    status
+        result of the registration
 
-    return retval;
+@param[in]
+    pArg
+        rule name of the policy
+
+*/
+/*============================================================================*/
+static void parse_fnRuleDone( DP_TICKET ticket, int status, void *pArg )
+{
+    (void)ticket;
+
+    if( ( EOK != status ) && ( EEXIST != status ) )
+    {
+        syslog( LOG_ERR, "Failed to create DP_fnRegisterPolicy" );
+        fprintf( stderr,
+                 "Failed to create DP_fnRegisterPolicy#%d\n",
+                 (int)(intptr_t)pArg );
+    }
 }
 
 //EoF
@@ -0,0 +1,1610 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+/*============================================================================*/
+/*!
+
+@file  parsePull.c
+
+@brief
+    Parse a policy file with a pull tokenizer specialised for the schema
+
+@details
+
+    The <policyFile> schema is small and fixed:
+
+        <policyFile>
+            <policy>
+                <rule min="25" max="60">comparator</rule>
+                <attributes>
+                    <type>temperature</type>
+                    <vendor>surrey</vendor>
+                    <time></time>
+                    <user></user>
+                    <group></group>
+                    <condition></condition>
+                </attributes>
+            </policy>
+        </policyFile>
+
+    PARSEPULL_fnPolicyCreate reads the same files as PARSE_fnPolicyCreate
+    without expat.  The mapped file (see xmlmap.c) is scanned by a pull
+    tokenizer which returns one start tag, end tag or piece of text at a
+    time; a start or end tag is dispatched on its element name with
+    PARSE_fnPolicyTag, one table slot and one compare, and handed to the
+    element processing shared with the expat parser, PARSE_fnPolicyStart
+    and PARSE_fnPolicyEnd, so both produce the same rules.
+
+    Element text and attribute values are decoded and NUL terminated in
+    place in the private mapping.  The tokenizer checks what the schema
+    needs to be read safely: UTF-8 (or ASCII) input, balanced and matching
+    tags, a single root element, well formed attributes, comments, CDATA
+    sections and character references.  Malformed input is rejected with
+    its line number and nothing after it is processed.  Document type
+    declarations are not supported, files using them must be parsed with
+    expat (defdp -p).
+
+    PARSEPULL_fnBenchmark times both parsers on a file, see defdp -T.
+
+*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <time.h>
+#include "minicloud.h"
+#include "defdp.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+/*! deepest element nesting accepted */
+#define PULL_MAX_DEPTH            ( 32 )
+
+/*! most attributes of an element */
+#define PULL_MAX_ATTS             ( 16 )
+
+/*==============================================================================
+                                Enums
+==============================================================================*/
+
+/*! tokens of the pull tokenizer */
+typedef enum ePullToken
+{
+    /*! malformed input, see tzPull.pError */
+    PULL_TOKEN_ERROR = -1,
+
+    /*! end of the input */
+    PULL_TOKEN_EOF = 0,
+
+    /*! start tag, tzPull.pName and tzPull.atts */
+    PULL_TOKEN_START,
+
+    /*! end tag, tzPull.pName */
+    PULL_TOKEN_END,
+
+    /*! piece of element text, tzPull.pText */
+    PULL_TOKEN_TEXT
+
+} tePullToken;
+
+/*==============================================================================
+                              Data Structures
+==============================================================================*/
+
+/*! open element */
+typedef struct zPullElement
+{
+    /*! element name in the input, not NUL terminated */
+    const char *pName;
+
+    /*! length of the name */
+    size_t len;
+
+} tzPullElement;
+
+/*! state of the pull tokenizer */
+typedef struct zPull
+{
+    /*! start of the input, for the line numbers */
+    char *pBase;
+
+    /*! next byte to read */
+    char *p;
+
+    /*! end of the input */
+    char *pEnd;
+
+    /*! the root element was seen */
+    bool seenRoot;
+
+    /*! the last start tag was an empty element, its end is the next token */
+    bool pendingEnd;
+
+    /*! open elements */
+    tzPullElement stack[ PULL_MAX_DEPTH ];
+
+    /*! number of open elements */
+    int depth;
+
+    /*! name of the current start or end tag */
+    const char *pName;
+
+    /*! length of the name */
+    size_t nameLen;
+
+    /*! attribute names and values of the start tag, NULL terminated */
+    const char *atts[ 2 * PULL_MAX_ATTS + 1 ];
+
+    /*! current piece of text, decoded in place */
+    char *pText;
+
+    /*! length of the piece of text */
+    size_t textLen;
+
+    /*! input before this position is counted in line, the tokenizer
+     *  decodes and terminates in place only after it */
+    const char *pCounted;
+
+    /*! line of pCounted, from 1 */
+    unsigned long line;
+
+    /*! description of the error */
+    const char *pError;
+
+    /*! line of the error */
+    unsigned long errorLine;
+
+} tzPull;
+
+/*! result of a parser in the benchmark */
+typedef struct zPullBench
+{
+    /*! rules seen by the last parse */
+    uint32_t rules;
+
+    /*! hash of the rules seen by the last parse, in order */
+    uint64_t hash;
+
+} tzPullBench;
+
+/*==============================================================================
+                        Local/Private Function Protoypes
+==============================================================================*/
+
+static int pull_fnRun( tzPull *pPull, tzPolicyData *ptzPolicyData );
+static tePullToken pull_fnNext( tzPull *pPull );
+static tePullToken pull_fnMarkup( tzPull *pPull );
+static tePullToken pull_fnStartTag( tzPull *pPull );
+static tePullToken pull_fnEndTag( tzPull *pPull );
+static tePullToken pull_fnDeclaration( tzPull *pPull );
+static char *pull_fnName( char *p, char *pEnd );
+static char *pull_fnSkipSpace( char *p, char *pEnd );
+static bool pull_fnDecode( tzPull *pPull,
+                           char *pStart,
+                           char *pStop,
+                           bool references,
+                           bool attribute,
+                           size_t *pLen );
+static int pull_fnReference( tzPull *pPull, char **pp, char *pStop, char *pOut );
+static char *pull_fnFind( char *p,
+                          const char *pEnd,
+                          const char *pString,
+                          size_t len );
+static const char *pull_fnCheckChars( const char *p, const char *pEnd );
+static tePullToken pull_fnError( tzPull *pPull,
+                                 const char *pError,
+                                 const char *pAt );
+static void pull_fnCount( tzPull *pPull, const char *pAt );
+static int pull_fnBenchRule( tzPolicyData *ptzPolicyData, void *pContext );
+static double pull_fnNow( void );
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+//fn  PARSEPULL_fnPolicyCreate
+/*!
+
+@brief
+    Parse Policy file with the pull tokenizer
+
+    Reads the files of PARSE_fnPolicyCreate and hands the rules to the
+    same rule handler, without expat.
+
+@param[in]
+    hDPRM
+        MiniCloud Resource Manager Handle (handle created by DP_fnOpen() and
+        is being passed to this function)
+
+@param[in]
+    filename
+        pointer to the dynamic policy filename
+
+@return
+    EOK - parse were created OK
+    EINVAL - invalid argument specified
+    ENOENT - input file could not be opened
+    ENOMEM - out of memory
+    EIO - XML parsing error
+
+*/
+/*============================================================================*/
+int PARSEPULL_fnPolicyCreate( DP_HANDLE hDPRM, char *filename )
+{
+    tzPolicyData *pPolicyData;
+    tzPull pull;
+    int ret;
+
+    /* open the minicloud resource manager, not needed by a rule handler */
+    if( ( hDPRM == NULL ) && ( false == PARSE_fnHasRuleHandler() ) )
+    {
+        fprintf(stderr, "Unable to open minicloud Resource Manager\n");
+        return EINVAL;
+    }
+
+    /* populate the policyData structure, one per parse so that files can
+     * be parsed concurrently */
+    pPolicyData = calloc( 1, sizeof(tzPolicyData) );
+    if( pPolicyData == NULL )
+    {
+        return ENOMEM;
+    }
+    pPolicyData->hDPRM = hDPRM;
+
+    /* map the input file */
+    ret = XMLMAP_fnOpen( &pPolicyData->text, filename );
+    if( ret == ENOENT )
+    {
+        fprintf(stderr,
+                "unable to open data point input file %s\n",
+                filename);
+    }
+
+    if( ret != EOK )
+    {
+        free( pPolicyData );
+        return ret;
+    }
+
+    memset( &pull, 0, sizeof(pull) );
+    pull.pBase = pPolicyData->text.pBase;
+    pull.p = pull.pBase;
+    pull.pEnd = pull.pBase + pPolicyData->text.size;
+    pull.pCounted = pull.pBase;
+    pull.line = 1;
+
+    ret = pull_fnRun( &pull, pPolicyData );
+    if( ret == EIO )
+    {
+        fprintf(stderr,
+                "%s at line %lu\n",
+                pull.pError,
+                pull.errorLine);
+    }
+
+    XMLMAP_fnClose( &pPolicyData->text );
+    free( pPolicyData );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  PARSEPULL_fnBenchmark
+/*!
+
+@brief
+    Time the expat and the pull parsers on a policy file
+
+    Each parser parses the file the given number of times with a rule
+    handler which only hashes the rules, nothing is sent to the server.
+    The time per parse of each parser is printed, and whether both found
+    the same rules.
+
+@param[in]
+    filename
+        policy file
+
+@param[in]
+    iterations
+        number of parses of each parser
+
+@return
+    EOK - both parsers parsed the file and agree
+    EINVAL - invalid argument specified
+    EIO - a parser failed or the parsers disagree
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int PARSEPULL_fnBenchmark( char *filename, int iterations )
+{
+    static const struct
+    {
+        const char *pName;
+        PARSE_fnPolicyParser pfnParse;
+    } parsers[] =
+    {
+        { "expat", PARSE_fnPolicyCreate },
+        { "pull",  PARSEPULL_fnPolicyCreate }
+    };
+    tzPullBench bench[ 2 ];
+    double start;
+    double ms;
+    size_t i;
+    int n;
+    int ret = EOK;
+
+    if( ( NULL == filename ) || ( iterations <= 0 ) )
+    {
+        return EINVAL;
+    }
+
+    memset( bench, 0, sizeof(bench) );
+
+    for( i = 0; ( i < 2u ) && ( EOK == ret ); i++ )
+    {
+        PARSE_fnSetRuleHandler( pull_fnBenchRule, &bench[ i ] );
+
+        start = pull_fnNow();
+        for( n = 0; ( n < iterations ) && ( EOK == ret ); n++ )
+        {
+            bench[ i ].rules = 0;
+            bench[ i ].hash = POLICY_DELTA_FNV_BASIS;
+            ret = parsers[ i ].pfnParse( NULL, filename );
+        }
+        ms = ( pull_fnNow() - start ) * 1000.0 / iterations;
+
+        PARSE_fnSetRuleHandler( NULL, NULL );
+
+        if( EOK == ret )
+        {
+            printf( "%-6s %u rules, %.3f ms per parse, %.0f rules/s\n",
+                    parsers[ i ].pName,
+                    bench[ i ].rules,
+                    ms,
+                    ( ms > 0.0 ) ? bench[ i ].rules * 1000.0 / ms : 0.0 );
+        }
+    }
+
+    if( EOK != ret )
+    {
+        fprintf( stderr, "%s parser failed on %s\n",
+                 parsers[ i - 1u ].pName,
+                 filename );
+        return ret;
+    }
+
+    if( ( bench[ 0 ].rules != bench[ 1 ].rules ) ||
+        ( bench[ 0 ].hash != bench[ 1 ].hash ) )
+    {
+        fprintf( stderr, "Parsers disagree on %s\n", filename );
+        return EIO;
+    }
+
+    printf( "Parsers agree.\n" );
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Pull the tokens of the file and process the elements
+
+    The pieces of text of an element, split by comments or CDATA sections,
+    are moved together in place, over the markup already read.
+
+@param[in]
+    pPull
+        tokenizer over the mapped file
+
+@param[in]
+    ptzPolicyData
+        policy parser state
+
+@return
+    EOK - the file was parsed
+    EIO - malformed input, see pPull->pError
+
+*/
+/*============================================================================*/
+static int pull_fnRun( tzPull *pPull, tzPolicyData *ptzPolicyData )
+{
+    char empty[ 1 ];
+    char *pText = NULL;
+    size_t textLen = 0;
+    tePullToken token;
+    tePolicyTag tag;
+    const char *pBad;
+
+    /* skip a byte order mark */
+    if( ( pPull->pEnd - pPull->p >= 3 ) &&
+        ( 0 == memcmp( pPull->p, "\xEF\xBB\xBF", 3 ) ) )
+    {
+        pPull->p += 3;
+        pPull->pBase = pPull->p;
+        pPull->pCounted = pPull->p;
+    }
+
+    /* the declaration first, a file in another encoding is reported as
+     * such rather than by its first invalid character */
+    if( ( pPull->pEnd - pPull->p >= 2 ) &&
+        ( 0 == memcmp( pPull->p, "<?", 2 ) ) &&
+        ( PULL_TOKEN_ERROR == pull_fnDeclaration( pPull ) ) )
+    {
+        return EIO;
+    }
+
+    /* the characters are checked once, the tokenizer then looks for the
+     * markup only */
+    pBad = pull_fnCheckChars( pPull->pBase, pPull->pEnd );
+    if( NULL != pBad )
+    {
+        pull_fnError( pPull, "not well-formed (invalid token)", pBad );
+        return EIO;
+    }
+
+    while( ( token = pull_fnNext( pPull ) ) > PULL_TOKEN_EOF )
+    {
+        switch( token )
+        {
+            case PULL_TOKEN_START:
+                pText = NULL;
+                textLen = 0;
+                tag = PARSE_fnPolicyTag( pPull->pName, pPull->nameLen );
+                PARSE_fnPolicyStart( ptzPolicyData, tag, pPull->atts );
+                break;
+
+            case PULL_TOKEN_TEXT:
+                if( NULL == pText )
+                {
+                    pText = pPull->pText;
+                }
+                else if( pText + textLen != pPull->pText )
+                {
+                    pull_fnCount( pPull, pPull->pText + pPull->textLen );
+                    memmove( pText + textLen, pPull->pText, pPull->textLen );
+                }
+                textLen += pPull->textLen;
+                break;
+
+            case PULL_TOKEN_END:
+                /* the byte after the text is markup already read */
+                if( NULL == pText )
+                {
+                    empty[ 0 ] = '\0';
+                    pText = empty;
+                }
+                pText[ textLen ] = '\0';
+
+                tag = PARSE_fnPolicyTag( pPull->pName, pPull->nameLen );
+                PARSE_fnPolicyEnd( ptzPolicyData, tag, pText );
+
+                pText = NULL;
+                textLen = 0;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return ( PULL_TOKEN_ERROR == token ) ? EIO : EOK;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Read the next token
+
+@param[in]
+    pPull
+        tokenizer
+
+@return
+    the token, PULL_TOKEN_EOF at the end of a well formed input
+
+*/
+/*============================================================================*/
+static tePullToken pull_fnNext( tzPull *pPull )
+{
+    tzPullElement *pElement;
+    char *pStart;
+    char *pStop;
+    tePullToken token;
+
+    if( true == pPull->pendingEnd )
+    {
+        pPull->pendingEnd = false;
+        pElement = &pPull->stack[ --pPull->depth ];
+        pPull->pName = pElement->pName;
+        pPull->nameLen = pElement->len;
+        return PULL_TOKEN_END;
+    }
+
+    for( ;; )
+    {
+        if( pPull->p >= pPull->pEnd )
+        {
+            if( ( pPull->depth > 0 ) || ( false == pPull->seenRoot ) )
+            {
+                return pull_fnError( pPull, "no element found", pPull->pEnd );
+            }
+
+            return PULL_TOKEN_EOF;
+        }
+
+        if( '<' == *pPull->p )
+        {
+            token = pull_fnMarkup( pPull );
+            if( PULL_TOKEN_EOF != token )
+            {
+                return token;
+            }
+
+            /* a comment or a processing instruction */
+            continue;
+        }
+
+        pStart = pPull->p;
+        pStop = memchr( pStart, '<', pPull->pEnd - pStart );
+        if( NULL == pStop )
+        {
+            pStop = pPull->pEnd;
+        }
+        pPull->p = pStop;
+
+        if( 0 == pPull->depth )
+        {
+            /* only white space outside the root element */
+            if( pull_fnSkipSpace( pStart, pStop ) != pStop )
+            {
+                return pull_fnError( pPull,
+                                     ( true == pPull->seenRoot ) ?
+                                         "junk after document element" :
+                                         "syntax error",
+                                     pull_fnSkipSpace( pStart, pStop ) );
+            }
+            continue;
+        }
+
+        if( false == pull_fnDecode( pPull,
+                                    pStart,
+                                    pStop,
+                                    true,
+                                    false,
+                                    &pPull->textLen ) )
+        {
+            return PULL_TOKEN_ERROR;
+        }
+
+        pPull->pText = pStart;
+        return PULL_TOKEN_TEXT;
+    }
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Read the markup at a '<'
+
+@param[in]
+    pPull
+        tokenizer, at a '<'
+
+@return
+    the token, PULL_TOKEN_EOF for markup without a token (comment,
+    processing instruction)
+
+*/
+/*============================================================================*/
+static tePullToken pull_fnMarkup( tzPull *pPull )
+{
+    char *p = pPull->p;
+    size_t left = pPull->pEnd - p;
+    char *pStop;
+
+    if( ( left >= 2 ) && ( '/' == p[1] ) )
+    {
+        return pull_fnEndTag( pPull );
+    }
+
+    if( ( left >= 2 ) && ( '?' == p[1] ) )
+    {
+        return pull_fnDeclaration( pPull );
+    }
+
+    if( ( left >= 4 ) && ( 0 == memcmp( p, "<!--", 4 ) ) )
+    {
+        pStop = pull_fnFind( p + 4, pPull->pEnd, "-->", 3 );
+        if( NULL == pStop )
+        {
+            return pull_fnError( pPull, "unclosed token", p );
+        }
+
+        pPull->p = pStop + 3;
+        return PULL_TOKEN_EOF;
+    }
+
+    if( ( left >= 9 ) && ( 0 == memcmp( p, "<![CDATA[", 9 ) ) )
+    {
+        if( 0 == pPull->depth )
+        {
+            return pull_fnError( pPull, "syntax error", p );
+        }
+
+        pStop = pull_fnFind( p + 9, pPull->pEnd, "]]>", 3 );
+        if( NULL == pStop )
+        {
+            return pull_fnError( pPull, "unclosed CDATA section", p );
+        }
+
+        pPull->p = pStop + 3;
+        pPull->pText = p + 9;
+
+        /* no references in a CDATA section, only the line ends */
+        if( false == pull_fnDecode( pPull,
+                                    p + 9,
+                                    pStop,
+                                    false,
+                                    false,
+                                    &pPull->textLen ) )
+        {
+            return PULL_TOKEN_ERROR;
+        }
+
+        return PULL_TOKEN_TEXT;
+    }
+
+    if( ( left >= 2 ) && ( '!' == p[1] ) )
+    {
+        return pull_fnError( pPull,
+                             ( ( left >= 9 ) &&
+                               ( 0 == memcmp( p, "<!DOCTYPE", 9 ) ) ) ?
+                                 "document type declaration not supported" :
+                                 "syntax error",
+                             p );
+    }
+
+    return pull_fnStartTag( pPull );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Read a start tag, or an empty element tag
+
+    The attribute names and values are NUL terminated in place, the values
+    decoded and their white space normalised as expat does.
+
+@param[in]
+    pPull
+        tokenizer, at a '<'
+
+@return
+    PULL_TOKEN_START, or PULL_TOKEN_ERROR
+
+*/
+/*============================================================================*/
+static tePullToken pull_fnStartTag( tzPull *pPull )
+{
+    char *pName = pPull->p + 1;
+    char *pEnd = pPull->pEnd;
+    char *pAttName;
+    char *pAttEnd;
+    char *pValue;
+    char *pQuote;
+    char *p;
+    size_t len;
+    int numAtts = 0;
+    int i;
+
+    p = pull_fnName( pName, pEnd );
+    if( p == pName )
+    {
+        return pull_fnError( pPull, "not well-formed (invalid token)", pName );
+    }
+
+    if( ( 0 == pPull->depth ) && ( true == pPull->seenRoot ) )
+    {
+        return pull_fnError( pPull, "junk after document element", pPull->p );
+    }
+
+    if( pPull->depth >= PULL_MAX_DEPTH )
+    {
+        return pull_fnError( pPull, "elements nested too deeply", pPull->p );
+    }
+
+    pPull->pName = pName;
+    pPull->nameLen = p - pName;
+
+    for( ;; )
+    {
+        pAttName = pull_fnSkipSpace( p, pEnd );
+        if( pAttName >= pEnd )
+        {
+            return pull_fnError( pPull, "unclosed token", pPull->p );
+        }
+
+        if( '>' == *pAttName )
+        {
+            p = pAttName + 1;
+            break;
+        }
+
+        if( '/' == *pAttName )
+        {
+            if( ( pAttName + 1 >= pEnd ) || ( '>' != pAttName[1] ) )
+            {
+                return pull_fnError( pPull,
+                                     "not well-formed (invalid token)",
+                                     pAttName );
+            }
+
+            p = pAttName + 2;
+            pPull->pendingEnd = true;
+            break;
+        }
+
+        /* attributes are separated by white space */
+        pAttEnd = pull_fnName( pAttName, pEnd );
+        if( ( pAttName == p ) || ( pAttEnd == pAttName ) )
+        {
+            return pull_fnError( pPull,
+                                 "not well-formed (invalid token)",
+                                 pAttName );
+        }
+
+        if( numAtts >= PULL_MAX_ATTS )
+        {
+            return pull_fnError( pPull, "too many attributes", pAttName );
+        }
+
+        p = pull_fnSkipSpace( pAttEnd, pEnd );
+        if( ( p >= pEnd ) || ( '=' != *p ) )
+        {
+            return pull_fnError( pPull, "not well-formed (invalid token)", p );
+        }
+
+        p = pull_fnSkipSpace( p + 1, pEnd );
+        if( ( p >= pEnd ) || ( ( '"' != *p ) && ( '\'' != *p ) ) )
+        {
+            return pull_fnError( pPull, "not well-formed (invalid token)", p );
+        }
+
+        pValue = p + 1;
+        pQuote = memchr( pValue, *p, pEnd - pValue );
+        if( NULL == pQuote )
+        {
+            return pull_fnError( pPull, "unclosed token", pPull->p );
+        }
+
+        if( NULL != memchr( pValue, '<', pQuote - pValue ) )
+        {
+            return pull_fnError( pPull,
+                                 "not well-formed (invalid token)",
+                                 memchr( pValue, '<', pQuote - pValue ) );
+        }
+
+        /* the name ends before the '=', already read */
+        pull_fnCount( pPull, pAttEnd + 1 );
+        *pAttEnd = '\0';
+
+        for( i = 0; i < numAtts; i++ )
+        {
+            if( 0 == strcmp( pPull->atts[ 2 * i ], pAttName ) )
+            {
+                return pull_fnError( pPull, "duplicate attribute", pAttName );
+            }
+        }
+
+        if( false == pull_fnDecode( pPull, pValue, pQuote, true, true, &len ) )
+        {
+            return PULL_TOKEN_ERROR;
+        }
+        pValue[ len ] = '\0';
+
+        pPull->atts[ 2 * numAtts ] = pAttName;
+        pPull->atts[ 2 * numAtts + 1 ] = pValue;
+        numAtts++;
+
+        p = pQuote + 1;
+    }
+
+    pPull->atts[ 2 * numAtts ] = NULL;
+
+    pPull->stack[ pPull->depth ].pName = pPull->pName;
+    pPull->stack[ pPull->depth ].len = pPull->nameLen;
+    pPull->depth++;
+    pPull->seenRoot = true;
+
+    pPull->p = p;
+
+    return PULL_TOKEN_START;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Read an end tag
+
+@param[in]
+    pPull
+        tokenizer, at a "</"
+
+@return
+    PULL_TOKEN_END, or PULL_TOKEN_ERROR
+
+*/
+/*============================================================================*/
+static tePullToken pull_fnEndTag( tzPull *pPull )
+{
+    char *pName = pPull->p + 2;
+    tzPullElement *pElement;
+    char *p;
+
+    p = pull_fnName( pName, pPull->pEnd );
+    if( p == pName )
+    {
+        return pull_fnError( pPull, "not well-formed (invalid token)", pName );
+    }
+
+    if( 0 == pPull->depth )
+    {
+        return pull_fnError( pPull, "junk after document element", pPull->p );
+    }
+
+    pElement = &pPull->stack[ pPull->depth - 1 ];
+    if( ( pElement->len != (size_t)( p - pName ) ) ||
+        ( 0 != memcmp( pElement->pName, pName, pElement->len ) ) )
+    {
+        return pull_fnError( pPull, "mismatched tag", pPull->p );
+    }
+
+    p = pull_fnSkipSpace( p, pPull->pEnd );
+    if( p >= pPull->pEnd )
+    {
+        return pull_fnError( pPull, "unclosed token", pPull->p );
+    }
+
+    if( '>' != *p )
+    {
+        return pull_fnError( pPull, "not well-formed (invalid token)", p );
+    }
+
+    pPull->depth--;
+    pPull->pName = pName;
+    pPull->nameLen = pElement->len;
+    pPull->p = p + 1;
+
+    return PULL_TOKEN_END;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Read the XML declaration or a processing instruction
+
+    The declaration must be at the start of the file and name UTF-8 or
+    ASCII, if it names an encoding.  Processing instructions are skipped.
+
+@param[in]
+    pPull
+        tokenizer, at a "<?"
+
+@return
+    PULL_TOKEN_EOF, or PULL_TOKEN_ERROR
+
+*/
+/*============================================================================*/
+static tePullToken pull_fnDeclaration( tzPull *pPull )
+{
+    char *pTarget = pPull->p + 2;
+    char *pStop;
+    char *p;
+    char *pValue;
+    char *pQuote;
+    size_t len;
+
+    pStop = pull_fnFind( pTarget, pPull->pEnd, "?>", 2 );
+    if( NULL == pStop )
+    {
+        return pull_fnError( pPull, "unclosed token", pPull->p );
+    }
+
+    p = pull_fnName( pTarget, pStop );
+    if( p == pTarget )
+    {
+        return pull_fnError( pPull,
+                             "not well-formed (invalid token)",
+                             pTarget );
+    }
+
+    if( ( 3 == p - pTarget ) && ( 0 == strncasecmp( pTarget, "xml", 3 ) ) )
+    {
+        if( pPull->p != pPull->pBase )
+        {
+            return pull_fnError( pPull,
+                                 "XML or text declaration not at start of "
+                                 "entity",
+                                 pPull->p );
+        }
+
+        p = pull_fnFind( p, pStop, "encoding", 8 );
+        if( NULL != p )
+        {
+            p = pull_fnSkipSpace( p + 8, pStop );
+            if( ( p < pStop ) && ( '=' == *p ) )
+            {
+                p = pull_fnSkipSpace( p + 1, pStop );
+            }
+
+            pValue = p + 1;
+            pQuote = ( p < pStop ) ? memchr( pValue, *p, pStop - pValue ) :
+                                     NULL;
+            len = ( NULL != pQuote ) ? (size_t)( pQuote - pValue ) : 0u;
+
+            if( !( ( 5 == len ) && ( 0 == strncasecmp( pValue, "utf-8", 5 ) ) ) &&
+                !( ( 4 == len ) && ( 0 == strncasecmp( pValue, "utf8", 4 ) ) ) &&
+                !( ( 8 == len ) && ( 0 == strncasecmp( pValue, "us-ascii", 8 ) ) ) )
+            {
+                return pull_fnError( pPull,
+                                     "encoding not supported, "
+                                     "parse the file with expat",
+                                     pPull->p );
+            }
+        }
+    }
+
+    pPull->p = pStop + 2;
+
+    return PULL_TOKEN_EOF;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Decode the text of an element or an attribute value in place
+
+    "\r\n" and "\r" become "\n", and the references are replaced by their
+    characters.  In an attribute value tab, new line and carriage return
+    then become spaces.  The input is counted before it is changed, so the
+    line numbers stay those of the file.
+
+@param[in]
+    pPull
+        tokenizer
+
+@param[in]
+    pStart
+        start of the text
+
+@param[in]
+    pStop
+        end of the text
+
+@param[in]
+    references
+        decode the references, false in a CDATA section
+
+@param[in]
+    attribute
+        normalise the white space of an attribute value
+
+@param[out]
+    pLen
+        length of the decoded text
+
+@return
+    true if decoded, false on a malformed reference
+
+*/
+/*============================================================================*/
+static bool pull_fnDecode( tzPull *pPull,
+                           char *pStart,
+                           char *pStop,
+                           bool references,
+                           bool attribute,
+                           size_t *pLen )
+{
+    char *pIn = pStart;
+    char *pOut = pStart;
+    char *pSpecial;
+    int n;
+
+    pull_fnCount( pPull, pStart );
+
+    for( ;; )
+    {
+        /* copy up to the next byte which needs decoding */
+        pSpecial = pIn;
+        while( ( pSpecial < pStop ) &&
+               ( '\r' != *pSpecial ) &&
+               ( ( false == references ) || ( '&' != *pSpecial ) ) &&
+               ( ( false == attribute ) ||
+                 ( ( '\n' != *pSpecial ) && ( '\t' != *pSpecial ) ) ) )
+        {
+            pSpecial++;
+        }
+
+        if( pSpecial >= pStop )
+        {
+            if( pOut != pIn )
+            {
+                pull_fnCount( pPull, pStop );
+                memmove( pOut, pIn, pStop - pIn );
+            }
+            pOut += pStop - pIn;
+            break;
+        }
+
+        if( '&' == *pSpecial )
+        {
+            /* a reference stops at its ';', the error is reported where it
+             * starts, still unchanged */
+            pull_fnCount( pPull, pSpecial );
+            if( pOut != pIn )
+            {
+                memmove( pOut, pIn, pSpecial - pIn );
+            }
+            pOut += pSpecial - pIn;
+            pIn = pSpecial;
+
+            n = pull_fnReference( pPull, &pIn, pStop, pOut );
+            if( n < 0 )
+            {
+                return false;
+            }
+            pOut += n;
+
+            /* a reference has no line end, it may have been overwritten by
+             * its character */
+            pPull->pCounted = pIn;
+            continue;
+        }
+
+        n = ( ( '\r' == *pSpecial ) &&
+              ( pSpecial + 1 < pStop ) &&
+              ( '\n' == pSpecial[1] ) ) ? 2 : 1;
+        pull_fnCount( pPull, pSpecial + n );
+
+        if( pOut != pIn )
+        {
+            memmove( pOut, pIn, pSpecial - pIn );
+        }
+        pOut += pSpecial - pIn;
+        pIn = pSpecial + n;
+
+        *pOut++ = ( true == attribute ) ? ' ' : '\n';
+    }
+
+    *pLen = pOut - pStart;
+
+    return true;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Decode a reference
+
+    The output is never longer than the reference, so it is written in
+    place.
+
+@param[in]
+    pPull
+        tokenizer
+
+@param[in,out]
+    pp
+        the reference, moved past it
+
+@param[in]
+    pStop
+        end of the text
+
+@param[out]
+    pOut
+        receives the UTF-8 of the referenced character
+
+@return
+    number of bytes written, -1 on a malformed reference
+
+*/
+/*============================================================================*/
+static int pull_fnReference( tzPull *pPull, char **pp, char *pStop, char *pOut )
+{
+    static const struct
+    {
+        const char *pName;
+        size_t len;
+        char c;
+    } entities[] =
+    {
+        { "lt", 2, '<' },
+        { "gt", 2, '>' },
+        { "amp", 3, '&' },
+        { "apos", 4, '\'' },
+        { "quot", 4, '"' }
+    };
+    char *p = *pp + 1;
+    char *pSemi;
+    unsigned long code = 0;
+    size_t len;
+    size_t i;
+    int digit;
+
+    pSemi = memchr( p, ';', pStop - p );
+    if( NULL == pSemi )
+    {
+        pull_fnError( pPull, "not well-formed (invalid token)", *pp );
+        return -1;
+    }
+
+    len = pSemi - p;
+    *pp = pSemi + 1;
+
+    if( ( len >= 2 ) && ( '#' == p[0] ) )
+    {
+        if( ( 'x' == p[1] ) && ( len >= 3 ) )
+        {
+            for( i = 2; i < len; i++ )
+            {
+                digit = ( ( p[i] >= '0' ) && ( p[i] <= '9' ) ) ? p[i] - '0' :
+                        ( ( p[i] | 0x20 ) >= 'a' ) && ( ( p[i] | 0x20 ) <= 'f' ) ?
+                            ( p[i] | 0x20 ) - 'a' + 10 : -1;
+                if( ( digit < 0 ) || ( code > 0x10FFFFul ) )
+                {
+                    code = ~0ul;
+                    break;
+                }
+                code = code * 16u + (unsigned long)digit;
+            }
+        }
+        else
+        {
+            for( i = 1; i < len; i++ )
+            {
+                if( ( p[i] < '0' ) || ( p[i] > '9' ) || ( code > 0x10FFFFul ) )
+                {
+                    code = ~0ul;
+                    break;
+                }
+                code = code * 10u + (unsigned long)( p[i] - '0' );
+            }
+        }
+
+        if( !( ( 0x9 == code ) || ( 0xA == code ) || ( 0xD == code ) ||
+               ( ( code >= 0x20 ) && ( code <= 0xD7FF ) ) ||
+               ( ( code >= 0xE000 ) && ( code <= 0xFFFD ) ) ||
+               ( ( code >= 0x10000 ) && ( code <= 0x10FFFF ) ) ) )
+        {
+            pull_fnError( pPull,
+                          "reference to invalid character number",
+                          p - 1 );
+            return -1;
+        }
+
+        if( code < 0x80 )
+        {
+            pOut[0] = (char)code;
+            return 1;
+        }
+
+        if( code < 0x800 )
+        {
+            pOut[0] = (char)( 0xC0 | ( code >> 6 ) );
+            pOut[1] = (char)( 0x80 | ( code & 0x3F ) );
+            return 2;
+        }
+
+        if( code < 0x10000 )
+        {
+            pOut[0] = (char)( 0xE0 | ( code >> 12 ) );
+            pOut[1] = (char)( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+            pOut[2] = (char)( 0x80 | ( code & 0x3F ) );
+            return 3;
+        }
+
+        pOut[0] = (char)( 0xF0 | ( code >> 18 ) );
+        pOut[1] = (char)( 0x80 | ( ( code >> 12 ) & 0x3F ) );
+        pOut[2] = (char)( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+        pOut[3] = (char)( 0x80 | ( code & 0x3F ) );
+        return 4;
+    }
+
+    for( i = 0; i < sizeof(entities) / sizeof(entities[0]); i++ )
+    {
+        if( ( entities[i].len == len ) &&
+            ( 0 == memcmp( entities[i].pName, p, len ) ) )
+        {
+            pOut[0] = entities[i].c;
+            return 1;
+        }
+    }
+
+    pull_fnError( pPull, "undefined entity", p - 1 );
+    return -1;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Read an XML name
+
+@param[in]
+    p
+        start of the name
+
+@param[in]
+    pEnd
+        end of the input
+
+@return
+    the byte after the name, p if there is no name
+
+*/
+/*============================================================================*/
+static char *pull_fnName( char *p, char *pEnd )
+{
+    char *pStart = p;
+    unsigned char c;
+
+    while( p < pEnd )
+    {
+        c = (unsigned char)*p;
+        if( ( ( c | 0x20 ) >= 'a' && ( c | 0x20 ) <= 'z' ) ||
+            ( '_' == c ) || ( ':' == c ) || ( c >= 0x80 ) ||
+            ( ( p > pStart ) &&
+              ( ( ( c >= '0' ) && ( c <= '9' ) ) ||
+                ( '-' == c ) || ( '.' == c ) ) ) )
+        {
+            p++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Skip XML white space
+
+@param[in]
+    p
+        start
+
+@param[in]
+    pEnd
+        end of the input
+
+@return
+    the first byte which is not white space, or pEnd
+
+*/
+/*============================================================================*/
+static char *pull_fnSkipSpace( char *p, char *pEnd )
+{
+    while( ( p < pEnd ) &&
+           ( ( ' ' == *p ) || ( '\n' == *p ) ||
+             ( '\t' == *p ) || ( '\r' == *p ) ) )
+    {
+        p++;
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Find a string in the input
+
+@param[in]
+    p
+        start of the search
+
+@param[in]
+    pEnd
+        end of the search
+
+@param[in]
+    pString
+        string to find
+
+@param[in]
+    len
+        length of the string
+
+@return
+    the string in the input, NULL if not found
+
+*/
+/*============================================================================*/
+static char *pull_fnFind( char *p,
+                          const char *pEnd,
+                          const char *pString,
+                          size_t len )
+{
+    while( ( pEnd - p >= (ptrdiff_t)len ) &&
+           ( NULL != ( p = memchr( p, pString[0], pEnd - p ) ) ) )
+    {
+        if( ( pEnd - p >= (ptrdiff_t)len ) &&
+            ( 0 == memcmp( p, pString, len ) ) )
+        {
+            return p;
+        }
+        p++;
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Check that the input is UTF-8 without control characters
+
+@param[in]
+    p
+        start of the input
+
+@param[in]
+    pEnd
+        end of the input
+
+@return
+    the first invalid byte, NULL if the input is valid
+
+*/
+/*============================================================================*/
+static const char *pull_fnCheckChars( const char *p, const char *pEnd )
+{
+    const unsigned char *s = (const unsigned char *)p;
+    const unsigned char *e = (const unsigned char *)pEnd;
+    uint32_t code;
+    int more;
+    int i;
+
+    while( s < e )
+    {
+        if( *s >= 0x20 && *s < 0x80 )
+        {
+            s++;
+            continue;
+        }
+
+        if( *s < 0x20 )
+        {
+            if( ( '\t' != *s ) && ( '\n' != *s ) && ( '\r' != *s ) )
+            {
+                return (const char *)s;
+            }
+            s++;
+            continue;
+        }
+
+        if( ( *s & 0xE0 ) == 0xC0 )
+        {
+            code = *s & 0x1F;
+            more = 1;
+        }
+        else if( ( *s & 0xF0 ) == 0xE0 )
+        {
+            code = *s & 0x0F;
+            more = 2;
+        }
+        else if( ( *s & 0xF8 ) == 0xF0 )
+        {
+            code = *s & 0x07;
+            more = 3;
+        }
+        else
+        {
+            return (const char *)s;
+        }
+
+        if( e - s <= more )
+        {
+            return (const char *)s;
+        }
+
+        for( i = 1; i <= more; i++ )
+        {
+            if( ( s[i] & 0xC0 ) != 0x80 )
+            {
+                return (const char *)s;
+            }
+            code = ( code << 6 ) | ( s[i] & 0x3F );
+        }
+
+        /* overlong forms, surrogates and non characters */
+        if( ( ( 1 == more ) && ( code < 0x80 ) ) ||
+            ( ( 2 == more ) && ( code < 0x800 ) ) ||
+            ( ( 3 == more ) && ( code < 0x10000 ) ) ||
+            ( ( code >= 0xD800 ) && ( code <= 0xDFFF ) ) ||
+            ( 0xFFFE == code ) || ( 0xFFFF == code ) ||
+            ( code > 0x10FFFF ) )
+        {
+            return (const char *)s;
+        }
+
+        s += more + 1;
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Record an error of the input
+
+@param[in]
+    pPull
+        tokenizer
+
+@param[in]
+    pError
+        description of the error
+
+@param[in]
+    pAt
+        position of the error
+
+@return
+    PULL_TOKEN_ERROR
+
+*/
+/*============================================================================*/
+static tePullToken pull_fnError( tzPull *pPull,
+                                 const char *pError,
+                                 const char *pAt )
+{
+    /* the first error is the one reported */
+    if( NULL == pPull->pError )
+    {
+        /* an error inside input already counted, such as in a multi line
+         * start tag, is reported on the last line counted */
+        pull_fnCount( pPull, pAt );
+        pPull->pError = pError;
+        pPull->errorLine = pPull->line;
+    }
+
+    return PULL_TOKEN_ERROR;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Count the lines of the input up to a position
+
+    The lines are counted lazily, just before the tokenizer changes the
+    input in place, and when an error is reported.
+
+@param[in]
+    pPull
+        tokenizer
+
+@param[in]
+    pAt
+        position, nothing is counted if it was already
+
+*/
+/*============================================================================*/
+static void pull_fnCount( tzPull *pPull, const char *pAt )
+{
+    const char *p = pPull->pCounted;
+
+    if( pAt <= p )
+    {
+        return;
+    }
+
+    while( NULL != ( p = memchr( p, '\n', pAt - p ) ) )
+    {
+        pPull->line++;
+        p++;
+    }
+
+    pPull->pCounted = pAt;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Rule handler of the benchmark, hashes the rule in order
+
+@param[in]
+    ptzPolicyData
+        policy parser state holding the complete rule
+
+@param[in]
+    pContext
+        tzPullBench of the parser
+
+@return
+    EOK
+
+*/
+/*============================================================================*/
+static int pull_fnBenchRule( tzPolicyData *ptzPolicyData, void *pContext )
+{
+    tzPullBench *pBench = pContext;
+    uint64_t fingerprint;
+
+    fingerprint = POLICYDELTA_fnFingerprint( ptzPolicyData->policy.Name,
+                                             ptzPolicyData->policy.Type,
+                                             ptzPolicyData->policy.max,
+                                             ptzPolicyData->policy.min,
+                                             (int64_t)ptzPolicyData->policy.time.tv_sec,
+                                             ptzPolicyData->policy.user,
+                                             ptzPolicyData->policy.group,
+                                             ptzPolicyData->policy.Location,
+                                             ptzPolicyData->userList,
+                                             ptzPolicyData->groupList,
+                                             &ptzPolicyData->program );
+
+    pBench->hash = POLICYDELTA_fnHash( pBench->hash,
+                                       &fingerprint,
+                                       sizeof(fingerprint) );
+    pBench->rules++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Monotonic time in seconds
+
+@return
+    seconds
+
+*/
+/*============================================================================*/
+static double pull_fnNow( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
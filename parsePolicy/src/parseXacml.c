@@ -134,6 +134,23 @@ Parse XACML Policy File.
                               Structures
 ==============================================================================*/
 
+/*! state of an XACML parse, passed to the callback functions */
+typedef struct zXacmlData
+{
+    /*! policy parser state */
+    tzPolicyData policyData;
+
+    /*! processing a <Subject> element */
+    bool subject;
+
+    /*! processing a <Resource> element */
+    bool resource;
+
+    /*! processing an <Action> element */
+    bool action;
+
+} tzXacmlData;
+
 /*==============================================================================
                         Local/Private Function Protoypes
 ==============================================================================*/
@@ -143,17 +160,6 @@ static void XMLCALL policyXacml_fnPolicyStartElementCallback(void *policyData,
                           const char **attribute);
 static void XMLCALL policyXacml_fnPolicyEndElementCallback( void *policyData,
                                               const char *element);
-static int policyXacml_fnDateString2Tm( char* dateStr, struct tm *date );
-static int policyXacml_fnTimeTokenizer( char* timeStr, struct tm *date );
-/*==============================================================================
-                           Local/Private Variables
-==============================================================================*/
-tzPolicyData policyData;
-
-static bool subject;
-static bool resource;
-static bool action;
-
 /*==============================================================================
                            Local/Private Constants
 ==============================================================================*/
@@ -186,47 +192,43 @@ static bool action;
     EOK - parse were created OK
     EINVAL - invalid argument specified
     ENOENT - input file could not be opened
+    ENOMEM - out of memory
     EIO - XML parsing error
 
 */
 /*============================================================================*/
 int PARSEXACML_fnPolicyCreate( DP_HANDLE hDPRM, char *filename)
 {
-    char buf[BUFSIZ];
-    int done = 0;
-    FILE *fp;
     XML_Parser parse;
+    tzXacmlData *pXacmlData;
+    int ret;
 
-    subject = false;
-    resource = false;
-    action = false;
-
-    /* open the minicloud resource manager */
-    if( hDPRM == NULL )
+    /* open the minicloud resource manager, not needed by a rule handler */
+    if( ( hDPRM == NULL ) && ( false == PARSE_fnHasRuleHandler() ) )
     {
         fprintf(stderr, "Unable to open minicloud Resource Manager\n");
         return EINVAL;
     }
 
-    /* populate the policyData structure */
-    memset(&policyData, 0, sizeof(policyData) );
-    policyData.hDPRM = hDPRM;
-
-    /* open the input file */
-    fp = fopen( filename, "r" );
-    if( fp == NULL )
+    /* populate the policyData structure, one per parse so that files can
+     * be parsed concurrently */
+    pXacmlData = calloc( 1, sizeof(tzXacmlData) );
+    if( pXacmlData == NULL )
     {
-        fprintf(stderr,
-                "unable to open data point input file %s\n",
-                filename);
-        return ENOENT;
+        return ENOMEM;
     }
+    pXacmlData->policyData.hDPRM = hDPRM;
 
     /* create the XML parse */
     parse = XML_ParserCreate(NULL);
+    if( parse == NULL )
+    {
+        free( pXacmlData );
+        return ENOMEM;
+    }
 
     /* set the user data structure to be passed to the callback functions */
-    XML_SetUserData(parse, &policyData);
+    XML_SetUserData(parse, pXacmlData);
 
     /* set up the start and end element callback handlers */
     XML_SetElementHandler( parse,
@@ -236,31 +238,20 @@ int PARSEXACML_fnPolicyCreate( DP_HANDLE hDPRM, char *filename)
     /* set up the character data callback handler */
     XML_SetCharacterDataHandler(parse, char_data);
 
-    /* process the input file in BUFSIZ chunks */
-    do
+    /* map the input file and parse it in one pass */
+    ret = XMLMAP_fnParseFile( parse, &pXacmlData->policyData.text, filename );
+    if( ret == ENOENT )
     {
-        /* read a chunk of the input file */
-        int len = (int)fread(buf, 1, sizeof(buf), fp);
-        done = len < sizeof(buf);
-
-        /* pass the buffer to the XML parse */
-        if (XML_Parse(parse, buf, len, done) == XML_STATUS_ERROR)
-        {
-            fprintf(stderr,
-                  "%s at line %" XML_FMT_INT_MOD "u\n",
-                  XML_ErrorString(XML_GetErrorCode(parse)),
-                  XML_GetCurrentLineNumber(parse));
-            return EIO;
-        }
-    } while (!done);
+        fprintf(stderr,
+                "unable to open data point input file %s\n",
+                filename);
+    }
 
     /* close the parse */
     XML_ParserFree(parse);
+    free( pXacmlData );
 
-    /* close the input file */
-    fclose( fp );
-
-    return EOK;
+    return ret;
 }
 
 /*============================================================================*/
@@ -299,29 +290,33 @@ static void XMLCALL policyXacml_fnPolicyStartElementCallback(void *policyData,
 {
     int i = 0;
 
-    tzPolicyData *ptzPolicyData = policyData;
-    if( ptzPolicyData == NULL )
+    tzXacmlData *pXacmlData = policyData;
+    tzPolicyData *ptzPolicyData;
+    if( pXacmlData == NULL )
     {
         return;
     }
+    ptzPolicyData = &pXacmlData->policyData;
 
-    ptzPolicyData->start_offset = ptzPolicyData->offset;
+    XMLMAP_fnStartElement( &ptzPolicyData->text );
 
     if( stricmp( name, "policy" ) == 0 )
     {
-        /* setup to begin parsing a policy block */
-        ptzPolicyData->offset = 0;
-        ptzPolicyData->start_offset = 0;
-
-        /* clear the character data buffer */
-        memset( ptzPolicyData->char_data_policy_buffer,
-                0,
-                sizeof( ptzPolicyData->char_data_policy_buffer ) );
+        /* release the text of the previous policy block */
+        XMLMAP_fnRelease( &ptzPolicyData->text );
 
         /* clear the entire policy data structure */
         memset( &ptzPolicyData->policy,
                 0,
                 sizeof( struct zPOLICY ) );
+
+        /* no users and groups means wild card */
+        memset( ptzPolicyData->userList,
+                0,
+                sizeof( ptzPolicyData->userList ) );
+        memset( ptzPolicyData->groupList,
+                0,
+                sizeof( ptzPolicyData->groupList ) );
     }
     else if( strcasecmp(name, "rule") == 0 )
     {
@@ -343,21 +338,21 @@ static void XMLCALL policyXacml_fnPolicyStartElementCallback(void *policyData,
     }
     else if( strcasecmp(name, "subject") == 0 )
     {
-        subject  = true;
-        resource = false;
-        action   = false;
+        pXacmlData->subject  = true;
+        pXacmlData->resource = false;
+        pXacmlData->action   = false;
     }
     else if( strcasecmp(name, "resource") == 0 )
     {
-        subject  = false;
-        resource = true;
-        action   = false;
+        pXacmlData->subject  = false;
+        pXacmlData->resource = true;
+        pXacmlData->action   = false;
     }
     else if( strcasecmp(name, "action") == 0 )
     {
-        subject  = false;
-        resource = false;
-        action   = true;
+        pXacmlData->subject  = false;
+        pXacmlData->resource = false;
+        pXacmlData->action   = true;
     }
 }
 
@@ -387,23 +382,27 @@ static void XMLCALL policyXacml_fnPolicyStartElementCallback(void *policyData,
 static void XMLCALL policyXacml_fnPolicyEndElementCallback( void *policyData,
                                               const char *element)
 {
-    tzPolicyData *ptzPolicyData = policyData;
+    tzXacmlData *pXacmlData = policyData;
+    tzPolicyData *ptzPolicyData;
     char *pElementData;
 
-    if( ptzPolicyData == NULL )
+    if( pXacmlData == NULL )
     {
         return;
     }
+    ptzPolicyData = &pXacmlData->policyData;
 
-    pElementData =
-        &ptzPolicyData->char_data_policy_buffer[ptzPolicyData->start_offset];
+    /* null terminated character data of the element */
+    pElementData = XMLMAP_fnEndElement( &ptzPolicyData->text );
+    if( pElementData == NULL )
+    {
+        ptzPolicyData->overflow = true;
+    }
 
-    /* null terminate the character data */
-    char_data(ptzPolicyData, "\0", 1);
     if( ptzPolicyData->overflow == true )
     {
-        fprintf(stderr, "data overflow processing element: %s\n", element );
-        /* we have a data overflow on our input buffer - we cannot
+        fprintf(stderr, "out of memory processing element: %s\n", element );
+        /* we ran out of memory for the character data - we cannot
          * do any further processing */
         return;
     }
@@ -425,7 +424,7 @@ static void XMLCALL policyXacml_fnPolicyEndElementCallback( void *policyData,
     }
     else if( stricmp(element, "AttributeValue") == 0 )
     {
-        if( subject )
+        if( pXacmlData->subject )
         {
             if( stricmp(pElementData, "temperature" ) == 0 )
             {
@@ -480,110 +479,55 @@ static void XMLCALL policyXacml_fnPolicyEndElementCallback( void *policyData,
                 ptzPolicyData->policy.Type = POLICY_TYPE_INVALID;
             }
 
-            subject = false;
+            pXacmlData->subject = false;
 
         }
-        else if( resource )
+        else if( pXacmlData->resource )
         {
-            strcpy(ptzPolicyData->policy.Location, strlwr( pElementData) );
+            /* the policy block is cleared, the copy stays terminated */
+            strncpy( ptzPolicyData->policy.Location,
+                     strlwr( pElementData ),
+                     sizeof( ptzPolicyData->policy.Location ) - 1 );
 
-            resource = false;
+            pXacmlData->resource = false;
         }
-        else if( action )
+        else if( pXacmlData->action )
         {
-            action   = false;
+            pXacmlData->action   = false;
         }
     }
     else if( stricmp(element, "time") == 0 )
     {
-        /* convert time string to timespec only if not null and not empty("") */
+        /* convert the ISO 8601 time only if not null and not empty("") */
         if( (NULL != pElementData) && ( 0 != strcmp(EMPTY, pElementData) ) )
         {
-            strncpy( ptzPolicyData->timeString,
-                     pElementData,
-                     strlen(pElementData)+1 );
-
-            if( EOK != policyXacml_fnDateString2Tm( ptzPolicyData->timeString,
-                                              &ptzPolicyData->tm_time ) )
+            if( EOK != PARSE_fnPolicyTime( ptzPolicyData, pElementData ) )
             {
-                printf("cannot tokenize the date");
+                fprintf(stderr, "cannot convert the time %s\n", pElementData );
             }
-            time_t t_t = mktime( &ptzPolicyData->tm_time );
-            ptzPolicyData->policy.time.tv_sec = t_t;
         }
-
-        memset(ptzPolicyData->timeString, 0, TIME_STR_LENGTH);
-        memset(&ptzPolicyData->tm_time, 0, sizeof(struct tm));
-
     }
     else if( stricmp(element, "user") == 0 )
     {
-        if( 0 == stricmp(pElementData, "gus") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_GUS;
-        }
-        else if( 0 == stricmp(pElementData, "doug") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_DOUG;
-        }
-        else if( 0 == stricmp(pElementData, "mike") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_MIKE;
-        }
-        else if( 0 == stricmp(pElementData, "tom") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_TOM;
-        }
-        else if( 0 == stricmp(pElementData, "jackie") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_JACKIE;
-        }
-        else if( 0 == stricmp(pElementData, "lilli") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_LILLI;
-        }
-        else if( 0 == stricmp(pElementData, "bob") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_BOB;
-        }
-        else if( 0 == stricmp(pElementData, "madi") )
-        {
-            ptzPolicyData->policy.user = USER_CODE_MADI;
-        }
-        else
-        {
-            ptzPolicyData->policy.user = USER_CODE_INVALID;
-        }
+        /* comma separated users, the server interns them to a user set */
+        PARSE_fnCopySubjects( ptzPolicyData->userList,
+                              sizeof( ptzPolicyData->userList ),
+                              pElementData,
+                              element );
     }
     else if( stricmp(element, "group") == 0 )
     {
-        if( 0 == stricmp(pElementData, "manager") )
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_MANAGER;
-        }
-        else if( 0 == stricmp(pElementData, "engineering") )
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_ENG;
-        }
-        else if( 0 == stricmp(pElementData, "technician") )
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_TECH;
-        }
-        else if( 0 == stricmp(pElementData, "customer") )
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_CUSTOMER;
-        }
-        else
-        {
-            ptzPolicyData->policy.group = GROUP_CODE_INVALID;
-        }
+        /* comma separated groups, the server interns them to a group set */
+        PARSE_fnCopySubjects( ptzPolicyData->groupList,
+                              sizeof( ptzPolicyData->groupList ),
+                              pElementData,
+                              element );
     }
     /* we do or do not want to register for now todo */
     else if( stricmp(element, "policy") == 0 )
     {
         /* create the policy */
-        int res = DP_fnRegisterPolicy( ptzPolicyData->hDPRM,
-                                       &ptzPolicyData->policy );
+        int res = PARSE_fnRegisterRule( ptzPolicyData );
         if( res != EOK )
         {
             syslog( LOG_ERR, "Failed to create DP_fnRegisterPolicy" );
@@ -596,15 +540,10 @@ static void XMLCALL policyXacml_fnPolicyEndElementCallback( void *policyData,
          * the reseting below has been done at the start of each policy rule
          * in the start element and here is redundant, remove it in future */
         memset( &ptzPolicyData->policy, 0, sizeof(struct zPOLICY ) );
+        memset( ptzPolicyData->userList, 0, sizeof(ptzPolicyData->userList) );
+        memset( ptzPolicyData->groupList, 0, sizeof(ptzPolicyData->groupList) );
 
     }
-    else
-    {
-        /* We do not recognise this tag.
-         * Reset the offset to where it was before we started
-         * processing this tag */
-        ptzPolicyData->offset = ptzPolicyData->start_offset;
-    }
 }
 
 /*============================================================================*/
@@ -616,9 +555,9 @@ static void XMLCALL policyXacml_fnPolicyEndElementCallback( void *policyData,
 
     The char_data function is invoked by the XML parse when XML element
     character data is encountered.  This function may be invoked multiple times
-    for each XML element so the function needs to store the XML character data
-    into a character buffer for later processing (when the end_element callback
-    is invoked).
+    for each XML element so the function needs to record the XML character data
+    for later processing (when the end_element callback is invoked), see
+    XMLMAP_fnCharData.
 
 @param[in]
     policyData
@@ -636,266 +575,19 @@ static void XMLCALL policyXacml_fnPolicyEndElementCallback( void *policyData,
 /*============================================================================*/
 static void char_data (void *policyData, const XML_Char *s, int len)
 {
+    /* the policy parser state is the first member of the XACML state */
     tzPolicyData *ptzPolicyData = policyData;
 
     if( policyData != NULL && s != NULL )
     {
         if (!ptzPolicyData->overflow)
         {
-            if (len + ptzPolicyData->offset >=
-                sizeof(ptzPolicyData->char_data_policy_buffer) )
+            if( XMLMAP_fnCharData( &ptzPolicyData->text, s, len ) != EOK )
             {
                 ptzPolicyData->overflow = true;
             }
-            else
-            {
-                memcpy( ptzPolicyData->char_data_policy_buffer +
-                        ptzPolicyData->offset,
-                        s,
-                        len );
-                ptzPolicyData->offset += len;
-            }
         }
     }
 }
 
-/*============================================================================*/
-/*!
-    get date as string and return each date item as in tm structure
-
-    get date in "YYYY-MM-DD HH:MM:SS" or "YYYY-MM-DDTHH:MM:SS" format
-    tokenize and return each item as in tm structure.
-
-@param[in]
-    dateStr
-     "<YYYY-MM-DD>T<HH:MM:SS>" format
-     or
-     "<YYYY-MM-DD> <HH:MM:SS>" format
-
-@param[out]
-    date
-        The extracted values from dateStr in "struct tm" format.
-
-@retval EOK    - if conversion successful
-@retval EINVAL - If null pointer detected
-
-*/
-/*============================================================================*/
-static int policyXacml_fnDateString2Tm( char* dateStr, struct tm *date )
-{
-    time_t      timenow     = 0;
-    struct tm * tm_timenow  = NULL;
-    /* should be year since 1900 (from 0); will subtract (2016 - 1900 )*/
-    char YYYY[ DATE_STRING_LEN ]        = "1900";
-    char MM[ DATE_STRING_LEN ]          = "00"; //  month of the year (from 0)
-    char DD[ DATE_STRING_LEN ]          = "01"; // day of the month (from 1)
-    char pYYYYMMDD[ DATE_STRING_LEN ]   = "0";
-    char pHHMMSSmmm[ DATE_STRING_LEN ]  = "0";
-    char *token         = NULL;
-    char dateStrCopy[TIME_STR_LENGTH];
-    int notime          = 0;
-    int retval          = EOK;
-
-    timenow = time(NULL);
-    tm_timenow = localtime(&timenow);
-
-    memset(dateStrCopy, 0, sizeof(dateStrCopy));
-
-    if( ( NULL == dateStr ) || ( NULL == date ) )
-    {
-        retval = EINVAL;
-    }
-    else
-    {
-        /* strtok function modifies its input string,
-         * make a working copy to play with*/
-        strncpy(dateStrCopy, dateStr, strlen(dateStr)+1 );
-
-        /* get first token, it is yyyy-mm-dd */
-        token = strtok( dateStrCopy, TIMETAGSPACE );
-        if( !token )
-        {
-            /* todo March 22 2017 - Mehdi - change this to 1970 from beginning
-             *  of time */
-            memcpy(date, tm_timenow, sizeof(struct tm) );
-        }
-        else
-        {
-            strcpy( pYYYYMMDD, token );
-
-            /* get second token, it is Time. */
-            token = strtok( NULL, TIMETAGSPACE );
-            if( token )
-            {
-                strcpy( pHHMMSSmmm, token );
-            }
-            else
-            {
-                notime = 1;
-            }
-
-            /* get YYYY */
-            token = strtok( pYYYYMMDD, DASHSLASH );
-            if( !token )
-            {
-                retval = EINVAL;
-            }
-            else
-            {
-                strcpy( YYYY, token );
-
-                /* get second token, it is Month. */
-                token = strtok( NULL, DASHSLASH );
-                if( !token )
-                {
-                    retval = EINVAL;
-                }
-                else
-                {
-                    strcpy( MM, token );
-
-                    /* get Day token. */
-                    token = strtok( NULL, DASHSLASH );
-                    /* check Month token is not null */
-                    if( !token )
-                    {
-                        retval = EINVAL;
-                    }
-                    else
-                    {
-                        strcpy( DD, token );
-
-                        /* pre-populate the date first for the sake
-                         * of offset and timezone */
-                        memcpy( date, tm_timenow, sizeof( struct tm ) );
-
-                        /* change the year month and day based on
-                         * the incoming requested time */
-                        date->tm_year = atoi( YYYY ) - 1900;
-                        // years since 1900 (from 0)
-                        date->tm_mon  = atoi( MM ) - 1;
-                        // months since January -- [0,11]
-                        date->tm_mday = atoi( DD );
-
-                        if( notime )
-                        {
-                            date->tm_hour = 00;
-                            date->tm_min = 00;
-                            date->tm_sec = 00;
-                        }
-                        else
-                        {
-                            retval = policyXacml_fnTimeTokenizer (pHHMMSSmmm, date);
-                        }
-                    }
-                }
-            }
-        }
-    }
-    return retval;
-}
-
-/*============================================================================*/
-/*!
-
-    get time as string and return each time item as in tm structure
-
-    get time in "HH:MM:SS" format and
-    tokenize and return each item as in tm structure.
-
-@param[in]
-    timeStr
-     "HH:MM:SS" format. This string is modified by the function
-
-@param[in]
-    startFlag
-        if considerations to be made for tokenizing a start date search
-
-@param[in]
-    endFlag
-        if considerations to be made for tokenizing an end date search
-
-@param[out]
-    date
-        The extracted values from dateStr in "struct tm" format.
-
-@retval EOK    - if conversion successful
-@retval EINVAL - If null pointer detected
-
-*/
-/*============================================================================*/
-static int policyXacml_fnTimeTokenizer( char* timeStr, struct tm *date )
-{
-    char HH[ DATE_STRING_LEN ]    = "0"; // hour of the day (from 0)
-    char mm[ DATE_STRING_LEN ]    = "0"; // minutes after the hour (from 0)
-    char SSmmm[ DATE_STRING_LEN ] = "0";
-    char SS[ DATE_STRING_LEN ]    = "0"; // seconds after the minute (from 0)
-    char nullSSmmm[ DATE_STRING_LEN ] = "00.000";
-    char nullmm[ DATE_STRING_LEN ]    = "00";
-    char nullHH[ DATE_STRING_LEN ]    = "00";
-    char nullSS[ DATE_STRING_LEN ]    = "00";
-    char *token           = NULL;
-    int  retval           = EOK;
-
-    if( ( NULL == timeStr ) || ( NULL == date ) )
-    {
-        retval = EINVAL;
-    }
-    else
-    {
-        /* get HH */
-        token = strtok( timeStr, COLON );
-        if( token )
-        {
-            strcpy( HH, token );
-        }
-        else
-        {
-            strcpy( HH, nullHH );
-        }
-
-        /* minutes token */
-        token = strtok( NULL, COLON );
-        if( token )
-        {
-            strcpy( mm, token );
-
-        }
-        else
-        {
-            strcpy( mm, nullmm );
-        }
-
-        /* seconds token */
-        token = strtok( NULL, COLON );
-        if( token )
-        {
-            strcpy( SSmmm, token );
-        }
-        else
-        {
-            strcpy( SSmmm, nullSSmmm );
-        }
-
-        /* get SS */
-        token = strtok( SSmmm, DOT );
-        if( token )
-        {
-            strcpy( SS, token );
-        }
-        else
-        {
-            strcpy( SS, nullSS );
-        }
-
-        date->tm_hour  = atoi( HH );
-        date->tm_min   = atoi( mm );
-        date->tm_sec   = atoi( SS );
-        date->tm_wday  = -1;
-        date->tm_yday  = -1;
-    }
-
-    return retval;
-}
-
 //EoF
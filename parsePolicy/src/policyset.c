@@ -0,0 +1,928 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+/*============================================================================*/
+/*!
+
+@file  policyset.c
+
+@brief
+    Register pre-parsed policy files in-process
+
+@details
+
+    A program which switches between policy files, like the simulator,
+    used to run "defdp -p <file>" for every switch, paying for a process,
+    a connection and a parse each time.  This module keeps the connection
+    and the parsed rules instead:
+
+        hPolicySet = POLICYSET_fnOpen( hDPRM );
+        POLICYSET_fnLoad( hPolicySet, PARSE_fnPolicyCreate, "a.xml", &pSet );
+        ...
+        POLICYSET_fnApply( hPolicySet, pSet );
+
+    A policy set is parsed once, with a rule handler collecting the rules
+    instead of registering them.  Applying it registers every rule, queued
+    on the sender of the connection when it has one, and commits them with
+    the policy housekeeping, so the server ends up with the rules of the
+    set only, as after "defdp -p".
+
+    POLICYSET_fnLoadFiles parses several policy files concurrently, each
+    on a worker thread with its own parser state and rule handler, and
+    merges their rules into one set in the order of the files, so that
+    applying it registers the same rules in the same order whatever the
+    number of threads.
+
+*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "minicloud.h"
+#include "policyset.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+/*! number of rules added to the rule table of a set at a time */
+#define POLICYSET_RULE_CHUNK      ( 64 )
+
+/*! most worker threads of POLICYSET_fnLoadFiles */
+#define POLICYSET_MAX_THREADS     ( 64 )
+
+/*==============================================================================
+                              Data Structures
+==============================================================================*/
+
+/*! rule of a policy set */
+typedef struct zPolicySetRule
+{
+    /*! policy rule as parsed */
+    struct zPOLICY policy;
+
+    /*! comma separated user list, empty for a wild card */
+    char *pUsers;
+
+    /*! comma separated group list, empty for a wild card */
+    char *pGroups;
+
+    /*! condition program, NULL if the rule has none */
+    tzPolicyProgram *pProgram;
+
+} tzPolicySetRule;
+
+/*! parsed policy file */
+struct zPolicySet
+{
+    /*! policy file the set was parsed from */
+    char *pFilename;
+
+    /*! parser of the policy file */
+    PARSE_fnPolicyParser pfnParse;
+
+    /*! rules in the order of the file */
+    tzPolicySetRule *pRules;
+
+    /*! number of rules */
+    int numRules;
+
+    /*! size of the rule table */
+    int maxRules;
+
+    /*! next set of the loader */
+    struct zPolicySet *pNext;
+};
+
+/*! policy loader */
+struct zPolicySetLoader
+{
+    /*! handle to the Data Point Manager */
+    DP_HANDLE hDPRM;
+
+    /*! the loader started the sender of the connection */
+    bool asyncOpen;
+
+    /*! sets loaded so far */
+    tzPolicySet *pSets;
+};
+
+/*! policy files parsed by the workers of POLICYSET_fnLoadFiles */
+typedef struct zPolicySetJob
+{
+    /*! handle to the Data Point Manager */
+    DP_HANDLE hDPRM;
+
+    /*! policy files */
+    const tzPolicyFile *pFiles;
+
+    /*! number of policy files */
+    int numFiles;
+
+    /*! policy set of each file, NULL until parsed */
+    tzPolicySet **ppSets;
+
+    /*! result of the parse of each file */
+    int *pResults;
+
+    /*! protects next */
+    pthread_mutex_t lock;
+
+    /*! next file to parse */
+    int next;
+
+} tzPolicySetJob;
+
+/*==============================================================================
+                        Local/Private Function Protoypes
+==============================================================================*/
+
+static int policyset_fnParse( DP_HANDLE hDPRM,
+                              PARSE_fnPolicyParser pfnParse,
+                              char *filename,
+                              tzPolicySet **ppSet );
+static void *policyset_fnWorker( void *pArg );
+static int policyset_fnMerge( tzPolicySetJob *pJob, tzPolicySet **ppSet );
+static int policyset_fnRule( tzPolicyData *ptzPolicyData, void *pContext );
+static int policyset_fnDrain( DP_HANDLE hDPRM );
+static void policyset_fnFree( tzPolicySet *pSet );
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+//fn  POLICYSET_fnOpen
+/*!
+
+@brief
+    Open a policy loader on a connection
+
+    The rules are queued on a sender thread of the connection, see
+    policyasync.h, unless the connection cannot have one.
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager, kept open by the caller
+
+@return
+    handle of the loader, NULL if out of memory
+
+*/
+/*============================================================================*/
+POLICYSET_HANDLE POLICYSET_fnOpen( DP_HANDLE hDPRM )
+{
+    struct zPolicySetLoader *pLoader;
+
+    if( NULL == hDPRM )
+    {
+        return NULL;
+    }
+
+    pLoader = calloc( 1, sizeof(struct zPolicySetLoader) );
+    if( NULL != pLoader )
+    {
+        pLoader->hDPRM = hDPRM;
+        pLoader->asyncOpen = ( EOK == DP_fnPolicyAsyncOpen( hDPRM, 0 ) );
+    }
+
+    return pLoader;
+}
+
+/*============================================================================*/
+//fn  POLICYSET_fnClose
+/*!
+
+@brief
+    Close a policy loader and release its policy sets
+
+    The rules committed on the server stay in place.
+
+@param[in]
+    hPolicySet
+        handle of the loader
+
+*/
+/*============================================================================*/
+void POLICYSET_fnClose( POLICYSET_HANDLE hPolicySet )
+{
+    tzPolicySet *pSet;
+
+    if( NULL == hPolicySet )
+    {
+        return;
+    }
+
+    if( true == hPolicySet->asyncOpen )
+    {
+        DP_fnPolicyAsyncClose( hPolicySet->hDPRM );
+    }
+
+    while( NULL != hPolicySet->pSets )
+    {
+        pSet = hPolicySet->pSets;
+        hPolicySet->pSets = pSet->pNext;
+        policyset_fnFree( pSet );
+    }
+
+    free( hPolicySet );
+}
+
+/*============================================================================*/
+//fn  POLICYSET_fnLoad
+/*!
+
+@brief
+    Parse a policy file into a policy set
+
+    A file loaded before with the same parser returns the set parsed then,
+    the file is not read again.
+
+@param[in]
+    hPolicySet
+        handle of the loader
+
+@param[in]
+    pfnParse
+        parser of the policy file, PARSE_fnPolicyCreate or
+        PARSEXACML_fnPolicyCreate
+
+@param[in]
+    filename
+        policy file
+
+@param[out]
+    ppSet
+        policy set, owned by the loader
+
+@return
+    EOK - the policy set is ready
+    EINVAL - invalid argument specified
+    ENOMEM - out of memory
+    any other value is the error of the parser
+
+*/
+/*============================================================================*/
+int POLICYSET_fnLoad( POLICYSET_HANDLE hPolicySet,
+                      PARSE_fnPolicyParser pfnParse,
+                      char *filename,
+                      tzPolicySet **ppSet )
+{
+    tzPolicySet *pSet;
+    int ret;
+
+    if( ( NULL == hPolicySet ) || ( NULL == pfnParse ) ||
+        ( NULL == filename ) || ( NULL == ppSet ) )
+    {
+        return EINVAL;
+    }
+
+    for( pSet = hPolicySet->pSets; NULL != pSet; pSet = pSet->pNext )
+    {
+        if( ( pfnParse == pSet->pfnParse ) &&
+            ( 0 == strcmp( filename, pSet->pFilename ) ) )
+        {
+            *ppSet = pSet;
+            return EOK;
+        }
+    }
+
+    ret = policyset_fnParse( hPolicySet->hDPRM, pfnParse, filename, &pSet );
+    if( EOK != ret )
+    {
+        return ret;
+    }
+
+    pSet->pNext = hPolicySet->pSets;
+    hPolicySet->pSets = pSet;
+    *ppSet = pSet;
+
+    return EOK;
+}
+
+/*============================================================================*/
+//fn  POLICYSET_fnLoadFiles
+/*!
+
+@brief
+    Parse several policy files concurrently into one policy set
+
+    The files are handed out to a pool of worker threads, the calling
+    thread being one of them.  Each file is parsed with its own parser
+    state into its own set, then the sets are merged in the order of the
+    files.  The merged set is not cached, every call parses the files.
+
+@param[in]
+    hPolicySet
+        handle of the loader
+
+@param[in]
+    pFiles
+        policy files and their parsers
+
+@param[in]
+    numFiles
+        number of policy files
+
+@param[in]
+    numThreads
+        number of threads parsing the files, 0 for one per CPU
+
+@param[out]
+    ppSet
+        policy set with the rules of all the files, owned by the loader
+
+@return
+    EOK - the policy set is ready
+    EINVAL - invalid argument specified
+    ENOMEM - out of memory
+    any other value is the error of the parser of the first file in error,
+    every file in error is reported
+
+*/
+/*============================================================================*/
+int POLICYSET_fnLoadFiles( POLICYSET_HANDLE hPolicySet,
+                           const tzPolicyFile *pFiles,
+                           int numFiles,
+                           int numThreads,
+                           tzPolicySet **ppSet )
+{
+    pthread_t threads[ POLICYSET_MAX_THREADS ];
+    tzPolicySetJob job;
+    int numStarted = 0;
+    int ret;
+    int i;
+
+    if( ( NULL == hPolicySet ) || ( NULL == pFiles ) ||
+        ( numFiles <= 0 ) || ( NULL == ppSet ) )
+    {
+        return EINVAL;
+    }
+
+    for( i = 0; i < numFiles; i++ )
+    {
+        if( ( NULL == pFiles[i].pfnParse ) || ( NULL == pFiles[i].pFilename ) )
+        {
+            return EINVAL;
+        }
+    }
+
+    if( numThreads <= 0 )
+    {
+        numThreads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    }
+
+    if( numThreads > numFiles )
+    {
+        numThreads = numFiles;
+    }
+
+    if( numThreads > POLICYSET_MAX_THREADS )
+    {
+        numThreads = POLICYSET_MAX_THREADS;
+    }
+
+    memset( &job, 0, sizeof(job) );
+    job.hDPRM = hPolicySet->hDPRM;
+    job.pFiles = pFiles;
+    job.numFiles = numFiles;
+    job.ppSets = calloc( numFiles, sizeof(tzPolicySet *) );
+    job.pResults = calloc( numFiles, sizeof(int) );
+    if( ( NULL == job.ppSets ) || ( NULL == job.pResults ) )
+    {
+        free( job.ppSets );
+        free( job.pResults );
+        return ENOMEM;
+    }
+    pthread_mutex_init( &job.lock, NULL );
+
+    /* the calling thread parses too, a worker which cannot be started
+     * leaves its files to the others */
+    while( ( numStarted < numThreads - 1 ) &&
+           ( EOK == pthread_create( &threads[ numStarted ],
+                                    NULL,
+                                    policyset_fnWorker,
+                                    &job ) ) )
+    {
+        numStarted++;
+    }
+
+    policyset_fnWorker( &job );
+
+    for( i = 0; i < numStarted; i++ )
+    {
+        pthread_join( threads[i], NULL );
+    }
+
+    pthread_mutex_destroy( &job.lock );
+
+    ret = policyset_fnMerge( &job, ppSet );
+    if( EOK == ret )
+    {
+        (*ppSet)->pNext = hPolicySet->pSets;
+        hPolicySet->pSets = *ppSet;
+    }
+
+    free( job.ppSets );
+    free( job.pResults );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  POLICYSET_fnApply
+/*!
+
+@brief
+    Register the rules of a policy set and commit them
+
+    The rules committed before which are not in the set are removed, like
+    "defdp -p" does.  The rules are committed when the function returns.
+
+@param[in]
+    hPolicySet
+        handle of the loader
+
+@param[in]
+    pSet
+        policy set loaded by this loader
+
+@return
+    EOK - the rules of the set are committed
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int POLICYSET_fnApply( POLICYSET_HANDLE hPolicySet, tzPolicySet *pSet )
+{
+    tzPolicySetRule *pRule;
+    int res;
+    int ret = EOK;
+    int i;
+
+    if( ( NULL == hPolicySet ) || ( NULL == pSet ) )
+    {
+        return EINVAL;
+    }
+
+    for( i = 0; i < pSet->numRules; i++ )
+    {
+        pRule = &pSet->pRules[i];
+
+        res = DP_fnRegisterPolicyAsync( hPolicySet->hDPRM,
+                                        &pRule->policy,
+                                        pRule->pUsers,
+                                        pRule->pGroups,
+                                        pRule->pProgram,
+                                        NULL,
+                                        NULL,
+                                        NULL );
+        if( ENOTCONN == res )
+        {
+            res = DP_fnRegisterPolicyProgram( hPolicySet->hDPRM,
+                                              &pRule->policy,
+                                              pRule->pUsers,
+                                              pRule->pGroups,
+                                              pRule->pProgram );
+        }
+
+        if( ( EOK != res ) && ( EOK == ret ) )
+        {
+            ret = res;
+        }
+    }
+
+    /* the queued rules must reach the server before the housekeeping */
+    res = policyset_fnDrain( hPolicySet->hDPRM );
+    if( ( EOK != res ) && ( EOK == ret ) )
+    {
+        ret = res;
+    }
+
+    res = DP_fnPolicyHousekeeping( hPolicySet->hDPRM );
+    if( ( EOK != res ) && ( EOK == ret ) )
+    {
+        ret = res;
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  POLICYSET_fnApplyFile
+/*!
+
+@brief
+    Load a policy file unless it was loaded before, and apply it
+
+@param[in]
+    hPolicySet
+        handle of the loader
+
+@param[in]
+    pfnParse
+        parser of the policy file
+
+@param[in]
+    filename
+        policy file
+
+@return
+    EOK - the rules of the file are committed
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int POLICYSET_fnApplyFile( POLICYSET_HANDLE hPolicySet,
+                           PARSE_fnPolicyParser pfnParse,
+                           char *filename )
+{
+    tzPolicySet *pSet = NULL;
+    int ret;
+
+    ret = POLICYSET_fnLoad( hPolicySet, pfnParse, filename, &pSet );
+    if( EOK == ret )
+    {
+        ret = POLICYSET_fnApply( hPolicySet, pSet );
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  POLICYSET_fnNumRules
+/*!
+
+@brief
+    Number of rules of a policy set
+
+@param[in]
+    pSet
+        policy set
+
+@return
+    number of rules, 0 if pSet is NULL
+
+*/
+/*============================================================================*/
+int POLICYSET_fnNumRules( tzPolicySet *pSet )
+{
+    return ( NULL != pSet ) ? pSet->numRules : 0;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Parse a policy file into a new policy set
+
+    The rules are collected by a rule handler of the calling thread.
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager
+
+@param[in]
+    pfnParse
+        parser of the policy file
+
+@param[in]
+    filename
+        policy file
+
+@param[out]
+    ppSet
+        new policy set, not linked to a loader
+
+@return
+    EOK - the policy set is ready
+    ENOMEM - out of memory
+    any other value is the error of the parser
+
+*/
+/*============================================================================*/
+static int policyset_fnParse( DP_HANDLE hDPRM,
+                              PARSE_fnPolicyParser pfnParse,
+                              char *filename,
+                              tzPolicySet **ppSet )
+{
+    tzPolicySet *pSet;
+    int ret;
+
+    pSet = calloc( 1, sizeof(tzPolicySet) );
+    if( NULL == pSet )
+    {
+        return ENOMEM;
+    }
+
+    pSet->pfnParse = pfnParse;
+    pSet->pFilename = strdup( filename );
+    if( NULL == pSet->pFilename )
+    {
+        free( pSet );
+        return ENOMEM;
+    }
+
+    /* collect the rules instead of registering them */
+    PARSE_fnSetRuleHandler( policyset_fnRule, pSet );
+    ret = pfnParse( hDPRM, filename );
+    PARSE_fnSetRuleHandler( NULL, NULL );
+
+    if( EOK != ret )
+    {
+        policyset_fnFree( pSet );
+        return ret;
+    }
+
+    *ppSet = pSet;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Worker of POLICYSET_fnLoadFiles, parses files until none is left
+
+@param[in]
+    pArg
+        tzPolicySetJob shared by the workers
+
+@return
+    NULL
+
+*/
+/*============================================================================*/
+static void *policyset_fnWorker( void *pArg )
+{
+    tzPolicySetJob *pJob = (tzPolicySetJob *)pArg;
+    const tzPolicyFile *pFile;
+    int i;
+
+    for( ;; )
+    {
+        pthread_mutex_lock( &pJob->lock );
+        i = pJob->next++;
+        pthread_mutex_unlock( &pJob->lock );
+
+        if( i >= pJob->numFiles )
+        {
+            break;
+        }
+
+        /* each file has its own slot, the workers share nothing else */
+        pFile = &pJob->pFiles[i];
+        pJob->pResults[i] = policyset_fnParse( pJob->hDPRM,
+                                               pFile->pfnParse,
+                                               pFile->pFilename,
+                                               &pJob->ppSets[i] );
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Merge the policy sets of the files in the order of the files
+
+    The rules are moved into the merged set, the sets of the files are
+    released.
+
+@param[in]
+    pJob
+        parsed files
+
+@param[out]
+    ppSet
+        merged policy set, not linked to a loader
+
+@return
+    EOK - the policy set is ready
+    ENOMEM - out of memory
+    any other value is the error of the parser of the first file in error
+
+*/
+/*============================================================================*/
+static int policyset_fnMerge( tzPolicySetJob *pJob, tzPolicySet **ppSet )
+{
+    tzPolicySet *pSet = NULL;
+    tzPolicySet *pFileSet;
+    int numRules = 0;
+    int ret = EOK;
+    int i;
+
+    for( i = 0; i < pJob->numFiles; i++ )
+    {
+        if( EOK != pJob->pResults[i] )
+        {
+            fprintf( stderr,
+                     "Failed to parse policy file %s: %s\n",
+                     pJob->pFiles[i].pFilename,
+                     strerror( pJob->pResults[i] ) );
+            if( EOK == ret )
+            {
+                ret = pJob->pResults[i];
+            }
+        }
+        else
+        {
+            numRules += pJob->ppSets[i]->numRules;
+        }
+    }
+
+    if( EOK == ret )
+    {
+        pSet = calloc( 1, sizeof(tzPolicySet) );
+        if( NULL != pSet )
+        {
+            pSet->pRules = malloc( ( numRules + 1 ) * sizeof(tzPolicySetRule) );
+            if( NULL == pSet->pRules )
+            {
+                free( pSet );
+                pSet = NULL;
+            }
+        }
+
+        ret = ( NULL == pSet ) ? ENOMEM : EOK;
+    }
+
+    for( i = 0; i < pJob->numFiles; i++ )
+    {
+        pFileSet = pJob->ppSets[i];
+        if( NULL == pFileSet )
+        {
+            continue;
+        }
+
+        if( EOK == ret )
+        {
+            /* the strings and programs of the rules move with them */
+            memcpy( &pSet->pRules[ pSet->numRules ],
+                    pFileSet->pRules,
+                    pFileSet->numRules * sizeof(tzPolicySetRule) );
+            pSet->numRules += pFileSet->numRules;
+            pFileSet->numRules = 0;
+        }
+
+        policyset_fnFree( pFileSet );
+    }
+
+    if( EOK == ret )
+    {
+        pSet->maxRules = numRules + 1;
+        *ppSet = pSet;
+    }
+
+    return ret;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Collect a complete policy rule into a policy set
+
+@param[in]
+    ptzPolicyData
+        policy parser state holding the complete rule
+
+@param[in]
+    pContext
+        policy set
+
+@return
+    EOK - rule collected
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+static int policyset_fnRule( tzPolicyData *ptzPolicyData, void *pContext )
+{
+    tzPolicySet *pSet = (tzPolicySet *)pContext;
+    tzPolicySetRule *pRule;
+    tzPolicySetRule *pNew;
+
+    if( ( NULL == ptzPolicyData ) || ( NULL == pSet ) )
+    {
+        return EINVAL;
+    }
+
+    if( pSet->numRules == pSet->maxRules )
+    {
+        pNew = realloc( pSet->pRules,
+                        ( pSet->maxRules + POLICYSET_RULE_CHUNK ) *
+                        sizeof(tzPolicySetRule) );
+        if( NULL == pNew )
+        {
+            return ENOMEM;
+        }
+        pSet->pRules = pNew;
+        pSet->maxRules += POLICYSET_RULE_CHUNK;
+    }
+
+    pRule = &pSet->pRules[ pSet->numRules ];
+    memset( pRule, 0, sizeof(tzPolicySetRule) );
+    memcpy( &pRule->policy, &ptzPolicyData->policy, sizeof(struct zPOLICY) );
+
+    pRule->pUsers = strdup( ptzPolicyData->userList );
+    pRule->pGroups = strdup( ptzPolicyData->groupList );
+    if( 0 != ptzPolicyData->program.numCode )
+    {
+        pRule->pProgram = malloc( sizeof(tzPolicyProgram) );
+        if( NULL != pRule->pProgram )
+        {
+            memcpy( pRule->pProgram,
+                    &ptzPolicyData->program,
+                    sizeof(tzPolicyProgram) );
+        }
+    }
+
+    if( ( NULL == pRule->pUsers ) ||
+        ( NULL == pRule->pGroups ) ||
+        ( ( 0 != ptzPolicyData->program.numCode ) &&
+          ( NULL == pRule->pProgram ) ) )
+    {
+        free( pRule->pUsers );
+        free( pRule->pGroups );
+        free( pRule->pProgram );
+        return ENOMEM;
+    }
+
+    pSet->numRules++;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Wait until the queued rules were registered by the server
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager
+
+@return
+    EOK if every queued rule was registered or nothing was queued, else
+    the first error of the queued rules
+
+*/
+/*============================================================================*/
+static int policyset_fnDrain( DP_HANDLE hDPRM )
+{
+    int status = EOK;
+
+    /* ENOENT, the connection has no sender and the rules were sent */
+    if( EOK != DP_fnPolicyAsyncWait( hDPRM, POLICY_ASYNC_ALL, &status ) )
+    {
+        return EOK;
+    }
+
+    return status;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Release a policy set
+
+@param[in]
+    pSet
+        policy set
+
+*/
+/*============================================================================*/
+static void policyset_fnFree( tzPolicySet *pSet )
+{
+    int i;
+
+    for( i = 0; i < pSet->numRules; i++ )
+    {
+        free( pSet->pRules[i].pUsers );
+        free( pSet->pRules[i].pGroups );
+        free( pSet->pRules[i].pProgram );
+    }
+
+    free( pSet->pRules );
+    free( pSet->pFilename );
+    free( pSet );
+}
@@ -0,0 +1,479 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+/*============================================================================*/
+/*!
+
+@file  watch.c
+
+@brief
+    Keep the server rules in step with a policy file
+
+@details
+
+    defdp -w keeps its connection to the server open after the policy file
+    was registered and reloads the file whenever it changes:
+
+        defdp -p /etc/policy.xml -w 200 -v
+
+    The directory of the file is watched with inotify, so a file replaced
+    by a rename is seen as well as a file written in place.  Changes are
+    debounced: the file is reloaded once no change was seen for the
+    debounce time, so an editor saving in several writes causes a single
+    reload.  If inotify is not available (QNX without fsevmgr) the file is
+    polled with stat() every debounce time instead.
+
+    A reload parses the file and sends only the difference with the rules
+    of the server, see delta.c.  A file which does not parse is not sent.
+    SIGHUP forces a reload, SIGINT and SIGTERM stop the watch.
+
+*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "minicloud.h"
+#include "defdp.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+/*! size of the inotify event buffer */
+#define WATCH_EVENT_BUFFER        ( 4096 )
+
+/*! maximum length of the watched directory */
+#define WATCH_PATH_LENGTH         ( 1024 )
+
+/*! longest wait in milliseconds, bounds how late a signal arriving just
+ *  before the poll is seen */
+#define WATCH_IDLE_MS             ( 1000 )
+
+/*! shortest interval in milliseconds of the polling without inotify */
+#define WATCH_POLL_MIN_MS         ( 10 )
+
+/*! changes of the watched file which cause a reload */
+#define WATCH_EVENTS              ( IN_MODIFY | IN_CLOSE_WRITE | \
+                                    IN_MOVED_TO | IN_CREATE )
+
+/*==============================================================================
+                        Local/Private Function Protoypes
+==============================================================================*/
+
+static void watch_fnSignal( int signo );
+static uint64_t watch_fnNow( void );
+static bool watch_fnEvents( int fd, const char *pName );
+static bool watch_fnChanged( const char *filename, struct stat *pLast );
+static void watch_fnReload( DP_HANDLE hDPRM,
+                            PARSE_fnPolicyParser pfnParse,
+                            char *filename,
+                            bool verbose );
+
+/*==============================================================================
+                           Local/Private Variables
+==============================================================================*/
+
+/*! set by SIGINT and SIGTERM */
+static volatile sig_atomic_t watchStop = 0;
+
+/*! set by SIGHUP */
+static volatile sig_atomic_t watchReload = 0;
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+//fn  PARSE_fnWatchPolicy
+/*!
+
+@brief
+    Reload a policy file whenever it changes, until SIGINT or SIGTERM
+
+    The rules of the file are expected to be registered already, the
+    first reload happens on the first change.
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager, kept open by the watch
+
+@param[in]
+    pfnParse
+        parser of the policy file
+
+@param[in]
+    filename
+        policy file
+
+@param[in]
+    debounceMs
+        time in milliseconds without a change before the file is reloaded
+
+@param[in]
+    verbose
+        print every reload
+
+@return
+    EOK - the watch was stopped by a signal
+    any other value specifies an error code (see errno.h)
+
+*/
+/*============================================================================*/
+int PARSE_fnWatchPolicy( DP_HANDLE hDPRM,
+                         PARSE_fnPolicyParser pfnParse,
+                         char *filename,
+                         uint32_t debounceMs,
+                         bool verbose )
+{
+    char directory[ WATCH_PATH_LENGTH ];
+    struct sigaction action;
+    struct pollfd pfd;
+    struct stat last;
+    const char *pName;
+    const char *pSlash;
+    uint64_t deadline = 0;
+    uint64_t now;
+    bool pending = false;
+    bool asyncOpen;
+    int timeout;
+    int fd;
+    int n;
+
+    if( ( NULL == hDPRM ) || ( NULL == pfnParse ) || ( NULL == filename ) )
+    {
+        return EINVAL;
+    }
+
+    /* the events name the file within its directory */
+    pSlash = strrchr( filename, '/' );
+    if( NULL == pSlash )
+    {
+        strcpy( directory, "." );
+        pName = filename;
+    }
+    else if( (size_t)( pSlash - filename ) >= sizeof(directory) )
+    {
+        return ENAMETOOLONG;
+    }
+    else
+    {
+        memcpy( directory, filename, pSlash - filename );
+        directory[ pSlash - filename ] = '\0';
+        if( '\0' == directory[0] )
+        {
+            strcpy( directory, "/" );
+        }
+        pName = pSlash + 1;
+    }
+
+    /* the signals interrupt the poll, they are not restarted */
+    memset( &action, 0, sizeof(action) );
+    action.sa_handler = watch_fnSignal;
+    sigemptyset( &action.sa_mask );
+    sigaction( SIGINT, &action, NULL );
+    sigaction( SIGTERM, &action, NULL );
+    sigaction( SIGHUP, &action, NULL );
+
+    fd = inotify_init();
+    if( ( fd >= 0 ) &&
+        ( inotify_add_watch( fd, directory, WATCH_EVENTS ) < 0 ) )
+    {
+        close( fd );
+        fd = -1;
+    }
+
+    if( fd < 0 )
+    {
+        syslog( LOG_WARNING, "inotify unavailable, polling %s", filename );
+    }
+
+    memset( &last, 0, sizeof(last) );
+    (void)watch_fnChanged( filename, &last );
+
+    /* the reloads are queued while the difference is computed */
+    asyncOpen = ( EOK == DP_fnPolicyAsyncOpen( hDPRM, 0 ) );
+
+    if( verbose )
+    {
+        printf( "Watching %s->\n", filename );
+    }
+
+    while( 0 == watchStop )
+    {
+        if( true == pending )
+        {
+            now = watch_fnNow();
+            timeout = ( deadline > now ) ? (int)( deadline - now ) : 0;
+        }
+        else
+        {
+            timeout = ( fd >= 0 ) ? WATCH_IDLE_MS :
+                      ( debounceMs > WATCH_POLL_MIN_MS ) ? (int)debounceMs :
+                                                           WATCH_POLL_MIN_MS;
+        }
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        n = poll( &pfd, ( fd < 0 ) ? 0 : 1, timeout );
+        if( ( n < 0 ) && ( EINTR != errno ) )
+        {
+            fprintf( stderr, "%s: %s\n", __func__, strerror( errno ) );
+            break;
+        }
+
+        if( ( n > 0 ) && ( true == watch_fnEvents( fd, pName ) ) )
+        {
+            pending = true;
+            deadline = watch_fnNow() + debounceMs;
+        }
+
+        if( ( fd < 0 ) && ( true == watch_fnChanged( filename, &last ) ) )
+        {
+            pending = true;
+            deadline = watch_fnNow() + debounceMs;
+        }
+
+        if( 0 != watchReload )
+        {
+            watchReload = 0;
+            pending = true;
+            deadline = 0;
+        }
+
+        if( ( true == pending ) && ( watch_fnNow() >= deadline ) &&
+            ( 0 == watchStop ) )
+        {
+            pending = false;
+            watch_fnReload( hDPRM, pfnParse, filename, verbose );
+        }
+    }
+
+    if( true == asyncOpen )
+    {
+        DP_fnPolicyAsyncClose( hDPRM );
+    }
+
+    if( fd >= 0 )
+    {
+        close( fd );
+    }
+
+    if( verbose )
+    {
+        printf( "Done watching %s.\n", filename );
+    }
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Reload the policy file and report the result
+
+@param[in]
+    hDPRM
+        handle to the Data Point Manager
+
+@param[in]
+    pfnParse
+        parser of the policy file
+
+@param[in]
+    filename
+        policy file
+
+@param[in]
+    verbose
+        print the reload
+
+*/
+/*============================================================================*/
+static void watch_fnReload( DP_HANDLE hDPRM,
+                            PARSE_fnPolicyParser pfnParse,
+                            char *filename,
+                            bool verbose )
+{
+    tzDeltaSummary summary;
+    uint64_t start;
+    int ret;
+
+    memset( &summary, 0, sizeof(summary) );
+
+    start = watch_fnNow();
+    ret = PARSE_fnDeltaReload( hDPRM, pfnParse, filename, &summary );
+    if( EOK != ret )
+    {
+        syslog( LOG_ERR, "Failed to reload policy %s.", filename );
+        fprintf( stderr,
+                 "Failed to reload policy %s: %s\n",
+                 filename,
+                 strerror( ret ) );
+    }
+    else if( verbose )
+    {
+        printf( "Reloaded %s in %llu ms: %u added, %u changed, "
+                "%u unchanged, %u removed.\n",
+                filename,
+                (unsigned long long)( watch_fnNow() - start ),
+                summary.added,
+                summary.changed,
+                summary.unchanged,
+                summary.removed );
+    }
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Drain the inotify events
+
+@param[in]
+    fd
+        inotify instance
+
+@param[in]
+    pName
+        name of the watched file in its directory
+
+@return
+    true if an event concerns the file or events were lost
+
+*/
+/*============================================================================*/
+static bool watch_fnEvents( int fd, const char *pName )
+{
+    char buf[ WATCH_EVENT_BUFFER ]
+        __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+    const struct inotify_event *pEvent;
+    bool changed = false;
+    ssize_t len;
+    char *p;
+
+    len = read( fd, buf, sizeof(buf) );
+    for( p = buf; ( len > 0 ) && ( p < buf + len );
+         p += sizeof(struct inotify_event) + pEvent->len )
+    {
+        pEvent = (const struct inotify_event *)p;
+
+        if( 0 != ( pEvent->mask & IN_Q_OVERFLOW ) )
+        {
+            changed = true;
+        }
+        else if( ( pEvent->len > 0 ) &&
+                 ( 0 == strcmp( pEvent->name, pName ) ) )
+        {
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Check whether the file changed since the last check, for the polling
+    without inotify
+
+@param[in]
+    filename
+        policy file
+
+@param[in,out]
+    pLast
+        status of the file at the last check
+
+@return
+    true if the file was modified or replaced
+
+*/
+/*============================================================================*/
+static bool watch_fnChanged( const char *filename, struct stat *pLast )
+{
+    struct stat st;
+    bool changed;
+
+    if( 0 != stat( filename, &st ) )
+    {
+        /* a missing file is reloaded once it is back */
+        memset( pLast, 0, sizeof(struct stat) );
+        return false;
+    }
+
+    changed = ( st.st_mtime != pLast->st_mtime ) ||
+              ( st.st_size != pLast->st_size ) ||
+              ( st.st_ino != pLast->st_ino );
+
+    *pLast = st;
+
+    return changed;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Monotonic time in milliseconds
+
+@return
+    milliseconds
+
+*/
+/*============================================================================*/
+static uint64_t watch_fnNow( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)( ts.tv_nsec / 1000000 );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Stop the watch on SIGINT and SIGTERM, reload on SIGHUP
+
+@param[in]
+    signo
+        signal number
+
+*/
+/*============================================================================*/
+static void watch_fnSignal( int signo )
+{
+    if( SIGHUP == signo )
+    {
+        watchReload = 1;
+    }
+    else
+    {
+        watchStop = 1;
+    }
+}
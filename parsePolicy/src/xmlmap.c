@@ -0,0 +1,716 @@
+/*=============================================================================
+
+University of British Columbia (UBC) 2017
+Electrical and Computer Engineering (ECE)
+Internet of Things Group (IoT)
+Parse Policy File.
+
+==============================================================================*/
+/*============================================================================*/
+/*!
+
+@file  xmlmap.c
+
+@brief
+    Parse an XML file from a private mapping
+
+@details
+
+    The parsers used to fread the input file into a BUFSIZ stack buffer,
+    pass it to expat chunk by chunk and copy the character data again into
+    a fixed 1 KB buffer, giving up on longer element text.  Here the file
+    is mapped once and handed to expat in one pass:
+
+        parse = XML_ParserCreate( NULL );
+        XML_SetUserData( parse, &policyData );
+        ...
+        ret = XMLMAP_fnParseFile( parse, &policyData.text, filename );
+
+    The character data handler passes the text to XMLMAP_fnCharData, which
+    records where the text lies in the mapping instead of copying it, and
+    the end element handler gets the text from XMLMAP_fnEndElement, NUL
+    terminated in place.  The mapping is private and writable so the
+    terminators and any in place edit of the text (strlwr) stay in this
+    process; expat parses its own buffer, filled with XML_GetBuffer, so it
+    never sees them.
+
+    Text the parser decodes differs from the bytes of the file and is
+    copied to the heap, see tzXmlDecoded.  Files which cannot be mapped
+    (pipes, character devices) are read into the heap instead.
+
+*/
+
+/*==============================================================================
+                              Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "expat.h"
+#include "xmlmap.h"
+
+/*==============================================================================
+                              Defines
+==============================================================================*/
+
+#ifdef XML_LARGE_SIZE
+#if defined(XML_USE_MSC_EXTENSIONS) && _MSC_VER < 1400
+#define XML_FMT_INT_MOD "I64"
+#else
+#define XML_FMT_INT_MOD "ll"
+#endif
+#else
+#define XML_FMT_INT_MOD "l"
+#endif
+
+#ifndef EOK
+#define EOK 0
+#endif
+
+/*! most bytes passed to expat at a time, bounds the expat buffer */
+#define XMLMAP_CHUNK_SIZE         ( 16u * 1024u * 1024u )
+
+/*! initial size of the heap copy of a file which cannot be mapped */
+#define XMLMAP_READ_SIZE          ( 8192u )
+
+/*! initial size of a decoded text */
+#define XMLMAP_DECODED_SIZE       ( 64u )
+
+/*==============================================================================
+                              Data Structures
+==============================================================================*/
+
+/*! element text decoded by the parser */
+struct zXmlDecoded
+{
+    /*! older decoded text */
+    struct zXmlDecoded *pNext;
+
+    /*! length of the text so far */
+    size_t length;
+
+    /*! size of the text buffer */
+    size_t size;
+
+    /*! the text */
+    char text[];
+};
+
+/*==============================================================================
+                        Local/Private Function Protoypes
+==============================================================================*/
+
+static int xmlmap_fnMap( int fd, tzXmlText *pText );
+static int xmlmap_fnRead( int fd, tzXmlText *pText );
+static void xmlmap_fnUnmap( tzXmlText *pText );
+static int xmlmap_fnDecode( tzXmlText *pText );
+static int xmlmap_fnAppend( tzXmlText *pText, const char *s, size_t len );
+
+/*==============================================================================
+                           Function Definitions
+==============================================================================*/
+
+/*============================================================================*/
+//fn  XMLMAP_fnParseFile
+/*!
+
+@brief
+    Parse an XML file in one pass
+
+    The element handlers of the parser must be set by the caller, and must
+    pass the character data and the element boundaries to pText.
+
+@param[in]
+    parser
+        expat parser
+
+@param[in]
+    pText
+        character data of the parse, initialised here
+
+@param[in]
+    filename
+        XML file
+
+@return
+    EOK - the file was parsed
+    EINVAL - invalid argument specified
+    ENOENT - the file could not be opened
+    ENOMEM - out of memory
+    EIO - XML parsing error
+
+*/
+/*============================================================================*/
+int XMLMAP_fnParseFile( XML_Parser parser,
+                        tzXmlText *pText,
+                        const char *filename )
+{
+    enum XML_Status status;
+    size_t offset = 0;
+    size_t chunk;
+    void *pBuf;
+    int isFinal;
+    int ret;
+
+    if( NULL == parser )
+    {
+        return EINVAL;
+    }
+
+    ret = XMLMAP_fnOpen( pText, filename );
+    if( EOK != ret )
+    {
+        return ret;
+    }
+
+    pText->parser = parser;
+
+    do
+    {
+        chunk = pText->size - offset;
+        if( chunk > XMLMAP_CHUNK_SIZE )
+        {
+            chunk = XMLMAP_CHUNK_SIZE;
+        }
+
+        isFinal = ( offset + chunk == pText->size );
+
+        /* expat gets its own copy, the mapping is edited by the handlers */
+        if( chunk > 0u )
+        {
+            pBuf = XML_GetBuffer( parser, (int)chunk );
+            if( NULL == pBuf )
+            {
+                ret = ENOMEM;
+                break;
+            }
+
+            memcpy( pBuf, pText->pBase + offset, chunk );
+            offset += chunk;
+
+            status = XML_ParseBuffer( parser, (int)chunk, isFinal );
+        }
+        else
+        {
+            /* an empty file, expat reports the missing element */
+            status = XML_Parse( parser, "", 0, isFinal );
+        }
+
+        if( status == XML_STATUS_ERROR )
+        {
+            fprintf(stderr,
+                  "%s at line %" XML_FMT_INT_MOD "u\n",
+                  XML_ErrorString(XML_GetErrorCode(parser)),
+                  XML_GetCurrentLineNumber(parser));
+            ret = EIO;
+            break;
+        }
+    } while( !isFinal );
+
+    XMLMAP_fnClose( pText );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  XMLMAP_fnOpen
+/*!
+
+@brief
+    Map an input file without parsing it, for a parser reading the
+    mapping itself
+
+    The file is at pText->pBase, pText->size bytes, private and writable.
+
+@param[in]
+    pText
+        character data of the parse, initialised here
+
+@param[in]
+    filename
+        input file
+
+@return
+    EOK - the file is mapped
+    EINVAL - invalid argument specified
+    ENOENT - the file could not be opened
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+int XMLMAP_fnOpen( tzXmlText *pText, const char *filename )
+{
+    int ret;
+    int fd;
+
+    if( ( NULL == pText ) || ( NULL == filename ) )
+    {
+        return EINVAL;
+    }
+
+    memset( pText, 0, sizeof(tzXmlText) );
+
+    fd = open( filename, O_RDONLY );
+    if( fd < 0 )
+    {
+        return ENOENT;
+    }
+
+    ret = xmlmap_fnMap( fd, pText );
+    close( fd );
+
+    return ret;
+}
+
+/*============================================================================*/
+//fn  XMLMAP_fnClose
+/*!
+
+@brief
+    Release the input file and the decoded texts
+
+@param[in]
+    pText
+        character data of the parse
+
+*/
+/*============================================================================*/
+void XMLMAP_fnClose( tzXmlText *pText )
+{
+    if( NULL != pText )
+    {
+        XMLMAP_fnRelease( pText );
+        xmlmap_fnUnmap( pText );
+    }
+}
+
+/*============================================================================*/
+//fn  XMLMAP_fnStartElement
+/*!
+
+@brief
+    Start the text of an element
+
+    Text seen before, the text of the parent ahead of this element, is
+    dropped.
+
+@param[in]
+    pText
+        character data of the parse
+
+*/
+/*============================================================================*/
+void XMLMAP_fnStartElement( tzXmlText *pText )
+{
+    if( NULL != pText )
+    {
+        pText->length = 0;
+        pText->decoding = false;
+    }
+}
+
+/*============================================================================*/
+//fn  XMLMAP_fnCharData
+/*!
+
+@brief
+    Add character data to the text of the current element
+
+    Data which is the bytes of the file following the text so far only
+    extends the slice of the mapping.  Other data, or data following a
+    gap, turns the text into a decoded copy.
+
+@param[in]
+    pText
+        character data of the parse
+
+@param[in]
+    s
+        character data reported by the parser
+
+@param[in]
+    len
+        length of the character data
+
+@return
+    EOK - the data was added
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+int XMLMAP_fnCharData( tzXmlText *pText, const char *s, int len )
+{
+    XML_Index index;
+    int count;
+    int ret;
+
+    if( ( NULL == pText ) || ( NULL == s ) || ( len <= 0 ) )
+    {
+        return EOK;
+    }
+
+    if( false == pText->decoding )
+    {
+        index = XML_GetCurrentByteIndex( pText->parser );
+        count = XML_GetCurrentByteCount( pText->parser );
+
+        /* the byte following the text must exist for the terminator */
+        if( ( index >= 0 ) && ( count == len ) &&
+            ( (size_t)index + (size_t)len < pText->size ) &&
+            ( 0 == memcmp( pText->pBase + index, s, len ) ) )
+        {
+            if( 0u == pText->length )
+            {
+                pText->start = (size_t)index;
+                pText->length = (size_t)len;
+                return EOK;
+            }
+
+            if( (size_t)index == pText->start + pText->length )
+            {
+                pText->length += (size_t)len;
+                return EOK;
+            }
+        }
+
+        ret = xmlmap_fnDecode( pText );
+        if( EOK != ret )
+        {
+            return ret;
+        }
+    }
+
+    return xmlmap_fnAppend( pText, s, (size_t)len );
+}
+
+/*============================================================================*/
+//fn  XMLMAP_fnEndElement
+/*!
+
+@brief
+    End the text of an element
+
+    A text in the mapping stays valid until the end of the parse, a decoded
+    text until XMLMAP_fnRelease.  Either may be edited in place within its
+    length.
+
+@param[in]
+    pText
+        character data of the parse
+
+@return
+    NUL terminated text of the element, NULL if out of memory
+
+*/
+/*============================================================================*/
+char *XMLMAP_fnEndElement( tzXmlText *pText )
+{
+    char *pData;
+
+    if( NULL == pText )
+    {
+        return NULL;
+    }
+
+    if( true == pText->decoding )
+    {
+        pData = ( EOK == xmlmap_fnAppend( pText, "", 1u ) ) ?
+                pText->pDecoded->text : NULL;
+    }
+    else if( 0u == pText->length )
+    {
+        pText->empty[0] = '\0';
+        pData = pText->empty;
+    }
+    else
+    {
+        pData = pText->pBase + pText->start;
+        pData[ pText->length ] = '\0';
+    }
+
+    pText->length = 0;
+    pText->decoding = false;
+
+    return pData;
+}
+
+/*============================================================================*/
+//fn  XMLMAP_fnRelease
+/*!
+
+@brief
+    Free the decoded texts, at the start of a record whose texts are no
+    longer needed
+
+@param[in]
+    pText
+        character data of the parse
+
+*/
+/*============================================================================*/
+void XMLMAP_fnRelease( tzXmlText *pText )
+{
+    tzXmlDecoded *pDecoded;
+
+    if( NULL == pText )
+    {
+        return;
+    }
+
+    while( NULL != pText->pDecoded )
+    {
+        pDecoded = pText->pDecoded;
+        pText->pDecoded = pDecoded->pNext;
+        free( pDecoded );
+    }
+
+    pText->decoding = false;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Map the input file, or read it when it cannot be mapped
+
+@param[in]
+    fd
+        input file
+
+@param[in]
+    pText
+        character data of the parse, receives the file
+
+@return
+    EOK - the file is in pText
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+static int xmlmap_fnMap( int fd, tzXmlText *pText )
+{
+    struct stat st;
+    void *p;
+
+    if( ( 0 == fstat( fd, &st ) ) && S_ISREG( st.st_mode ) &&
+        ( st.st_size > 0 ) && ( (uintmax_t)st.st_size <= SIZE_MAX ) )
+    {
+        p = mmap( NULL,
+                  (size_t)st.st_size,
+                  PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE,
+                  fd,
+                  0 );
+        if( MAP_FAILED != p )
+        {
+            pText->pBase = p;
+            pText->size = (size_t)st.st_size;
+            return EOK;
+        }
+    }
+
+    return xmlmap_fnRead( fd, pText );
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Read the input file into the heap
+
+@param[in]
+    fd
+        input file
+
+@param[in]
+    pText
+        character data of the parse, receives the file
+
+@return
+    EOK - the file is in pText
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+static int xmlmap_fnRead( int fd, tzXmlText *pText )
+{
+    size_t size = XMLMAP_READ_SIZE;
+    size_t length = 0;
+    char *pBase;
+    char *p;
+    ssize_t n;
+
+    pBase = malloc( size );
+    if( NULL == pBase )
+    {
+        return ENOMEM;
+    }
+
+    for( ;; )
+    {
+        if( length == size )
+        {
+            p = realloc( pBase, size * 2u );
+            if( NULL == p )
+            {
+                free( pBase );
+                return ENOMEM;
+            }
+
+            pBase = p;
+            size *= 2u;
+        }
+
+        n = read( fd, pBase + length, size - length );
+        if( ( n < 0 ) && ( EINTR == errno ) )
+        {
+            continue;
+        }
+
+        /* a read error ends the input, as fread did */
+        if( n <= 0 )
+        {
+            break;
+        }
+
+        length += (size_t)n;
+    }
+
+    pText->pBase = pBase;
+    pText->size = length;
+    pText->copied = true;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Release the input file
+
+@param[in]
+    pText
+        character data of the parse
+
+*/
+/*============================================================================*/
+static void xmlmap_fnUnmap( tzXmlText *pText )
+{
+    if( true == pText->copied )
+    {
+        free( pText->pBase );
+    }
+    else if( NULL != pText->pBase )
+    {
+        munmap( pText->pBase, pText->size );
+    }
+
+    pText->pBase = NULL;
+    pText->size = 0;
+    pText->copied = false;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Turn the text of the current element into a decoded copy
+
+@param[in]
+    pText
+        character data of the parse
+
+@return
+    EOK - the text is decoded from now on
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+static int xmlmap_fnDecode( tzXmlText *pText )
+{
+    tzXmlDecoded *pDecoded;
+    size_t size = XMLMAP_DECODED_SIZE;
+
+    while( size <= pText->length )
+    {
+        size *= 2u;
+    }
+
+    pDecoded = malloc( sizeof(tzXmlDecoded) + size );
+    if( NULL == pDecoded )
+    {
+        return ENOMEM;
+    }
+
+    pDecoded->length = pText->length;
+    pDecoded->size = size;
+    memcpy( pDecoded->text, pText->pBase + pText->start, pText->length );
+
+    pDecoded->pNext = pText->pDecoded;
+    pText->pDecoded = pDecoded;
+    pText->decoding = true;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*!
+
+@brief
+    Append data to the decoded text of the current element
+
+@param[in]
+    pText
+        character data of the parse, decoding
+
+@param[in]
+    s
+        data to append
+
+@param[in]
+    len
+        length of the data
+
+@return
+    EOK - the data was appended
+    ENOMEM - out of memory
+
+*/
+/*============================================================================*/
+static int xmlmap_fnAppend( tzXmlText *pText, const char *s, size_t len )
+{
+    tzXmlDecoded *pDecoded = pText->pDecoded;
+    size_t size = pDecoded->size;
+
+    if( pDecoded->length + len > size )
+    {
+        while( pDecoded->length + len > size )
+        {
+            size *= 2u;
+        }
+
+        /* the current text is the newest, nothing points to it yet */
+        pDecoded = realloc( pDecoded, sizeof(tzXmlDecoded) + size );
+        if( NULL == pDecoded )
+        {
+            return ENOMEM;
+        }
+
+        pDecoded->size = size;
+        pText->pDecoded = pDecoded;
+    }
+
+    memcpy( pDecoded->text + pDecoded->length, s, len );
+    pDecoded->length += len;
+
+    return EOK;
+}
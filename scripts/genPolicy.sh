@@ -0,0 +1,30 @@
+#!/bin/sh
+# generate a policy file of n comparator rules with distinct locations
+# usage: genPolicy.sh <n> > policy.xml
+n=${1:-10000}
+types="temperature voltage current frequency power speed altitude positionX positionY"
+
+echo '<?xml version="1.0" encoding="utf-8"?>'
+echo '<policyFile>'
+a=0
+while [ $a -lt $n ]
+do
+   for t in $types
+   do
+      if [ $a -lt $n ]
+      then
+         echo "    <policy>"
+         echo "        <rule min=\"1\" max=\"`expr $a % 500 + 100`\">comparator</rule>"
+         echo "        <attributes>"
+         echo "            <type>$t</type>"
+         echo "            <vendor>site$a</vendor>"
+         echo "            <time>2016-07-16T23:20:30</time>"
+         echo "            <user></user>"
+         echo "            <group></group>"
+         echo "        </attributes>"
+         echo "    </policy>"
+      fi
+      a=`expr $a + 1`
+   done
+done
+echo '</policyFile>'
@@ -0,0 +1,18 @@
+#!/bin/sh
+# compile a policy file to a native rule set, commit the policy file to the
+# server, swap the native rule set in and benchmark the policy engines
+# usage: nativePolicy.sh <policy.xml> [iterations]
+# CC and CFLAGS select the compiler, CFLAGS must name the include paths of
+# dynPolAC/serverSide, dynPolAC/clientSide and the minicloud headers
+# DPRMLOCAL_NATIVE_DIR is the directory the server loads native rule sets from
+policy=$1
+iterations=${2:-1000}
+name=`basename $policy .xml`
+DPRMLOCAL_NATIVE_DIR=${DPRMLOCAL_NATIVE_DIR:-/tmp/dpac.native}
+export DPRMLOCAL_NATIVE_DIR
+mkdir -p $DPRMLOCAL_NATIVE_DIR || exit 1
+out=$DPRMLOCAL_NATIVE_DIR/$name.native
+
+defdp -g $out.c -p $policy || exit 1
+${CC:-qcc} -shared -fPIC -O2 $CFLAGS -o $out.so $out.c || exit 1
+defdp -v -p $policy -L $out.so -B $iterations
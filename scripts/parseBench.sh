@@ -0,0 +1,21 @@
+#!/bin/sh
+# time the expat and the pull tokenizer policy parsers of defdp on the
+# sample policies and on a generated policy file
+# usage: parseBench.sh [iterations] [rules]
+iterations=${1:-100}
+rules=${2:-100000}
+dir=`dirname $0`
+big=/tmp/parseBench.$rules.xml
+
+for policy in $dir/../samplePolicies/*.xml
+do
+   echo $policy
+   defdp -t $policy -T $iterations || exit 1
+done
+
+if [ ! -f $big ]
+then
+   $dir/genPolicy.sh $rules > $big || exit 1
+fi
+echo $big
+defdp -t $big -T `expr $iterations / 50 + 1`